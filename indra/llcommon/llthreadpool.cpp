@@ -0,0 +1,161 @@
+/** 
+ * @file llthreadpool.cpp
+ * @brief Fork-join pool of worker threads
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llthreadpool.h"
+
+#include "llstring.h"
+#include "lltimer.h"
+
+class LLThreadPool::Worker : public LLThread
+{
+public:
+	Worker(const std::string& name, LLThreadPool* pool)
+	:	LLThread(name),
+		mPool(pool)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		LLCondition& condition = mPool->mCondition;
+		condition.lock();
+		while (!mPool->mQuitting)
+		{
+			Job* job = mPool->claimJob();
+			if (!job)
+			{
+				condition.wait();
+				continue;
+			}
+
+			condition.unlock();
+			job->run();
+			condition.lock();
+
+			mPool->finishJob();
+		}
+		condition.unlock();
+	}
+
+private:
+	LLThreadPool* mPool;
+};
+
+LLThreadPool::LLThreadPool(const std::string& name, U32 num_threads)
+:	mCondition(NULL),
+	mJobs(NULL),
+	mNextJob(0),
+	mPendingJobs(0),
+	mQuitting(false)
+{
+	for (U32 i = 0; i < num_threads; ++i)
+	{
+		Worker* worker = new Worker(llformat("%s %u", name.c_str(), i), this);
+		mThreads.push_back(worker);
+		worker->start();
+	}
+}
+
+LLThreadPool::~LLThreadPool()
+{
+	mCondition.lock();
+	mQuitting = true;
+	mCondition.broadcast();
+	mCondition.unlock();
+
+	for (std::vector<Worker*>::iterator iter = mThreads.begin(); iter != mThreads.end(); ++iter)
+	{
+		// A worker that hasn't got to run() yet must not find itself half
+		// destroyed when it does.
+		while (!(*iter)->isStopped())
+		{
+			ms_sleep(1);
+		}
+		delete *iter;
+	}
+	mThreads.clear();
+}
+
+void LLThreadPool::run(const job_list_t& jobs)
+{
+	if (jobs.empty())
+	{
+		return;
+	}
+
+	if (mThreads.empty() || jobs.size() == 1)
+	{
+		for (job_list_t::const_iterator iter = jobs.begin(); iter != jobs.end(); ++iter)
+		{
+			(*iter)->run();
+		}
+		return;
+	}
+
+	mCondition.lock();
+	llassert(!mJobs);
+	mJobs = &jobs;
+	mNextJob = 0;
+	mPendingJobs = (U32)jobs.size();
+	mCondition.broadcast();
+
+	// Help out rather than sit idle
+	while (Job* job = claimJob())
+	{
+		mCondition.unlock();
+		job->run();
+		mCondition.lock();
+		finishJob();
+	}
+
+	while (mPendingJobs > 0)
+	{
+		mCondition.wait();
+	}
+	mJobs = NULL;
+	mCondition.unlock();
+}
+
+LLThreadPool::Job* LLThreadPool::claimJob()
+{
+	if (!mJobs || mNextJob >= mJobs->size())
+	{
+		return NULL;
+	}
+	return (*mJobs)[mNextJob++];
+}
+
+void LLThreadPool::finishJob()
+{
+	if (--mPendingJobs == 0)
+	{
+		// Wakes run(), and any idle worker goes back to sleep
+		mCondition.broadcast();
+	}
+}
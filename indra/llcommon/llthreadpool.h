@@ -0,0 +1,81 @@
+/** 
+ * @file llthreadpool.h
+ * @brief Fork-join pool of worker threads
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTHREADPOOL_H
+#define LL_LLTHREADPOOL_H
+
+#include "llthread.h"
+
+#include <vector>
+
+// A fixed set of threads for splitting one piece of work into independent
+// jobs and waiting for all of them: run() hands the jobs out, runs some on
+// the calling thread as well and returns once every job has finished.
+// Jobs must not touch anything another job of the same run() touches.
+class LL_COMMON_API LLThreadPool
+{
+public:
+	class LL_COMMON_API Job
+	{
+	public:
+		virtual ~Job() {}
+		// Called on the thread that calls run() or on one of the pool's.
+		virtual void run() = 0;
+	};
+	typedef std::vector<Job*> job_list_t;
+
+	// A pool of 0 threads runs all jobs on the calling thread.
+	LLThreadPool(const std::string& name, U32 num_threads);
+	~LLThreadPool();
+
+	// Runs every job and returns when they are all done. Jobs start in list
+	// order but may finish in any order. Not reentrant.
+	void run(const job_list_t& jobs);
+
+	U32 getThreadCount() const { return (U32)mThreads.size(); }
+
+private:
+	class Worker;
+	friend class Worker;
+
+	// Returns the next job nobody has claimed, or NULL. Call with
+	// mCondition locked.
+	Job* claimJob();
+	// Call with mCondition locked.
+	void finishJob();
+
+	std::vector<Worker*>	mThreads;
+
+	// Guards everything below, and is signalled when there are jobs to
+	// take, when the last job finishes and when the pool is shut down.
+	LLCondition				mCondition;
+	const job_list_t*		mJobs;
+	U32						mNextJob;
+	U32						mPendingJobs;
+	bool					mQuitting;
+};
+
+#endif // LL_LLTHREADPOOL_H
@@ -313,6 +313,13 @@ struct lluuid_less
 
 typedef std::set<LLUUID, lluuid_less> uuid_list_t;
 
+// Hash for boost::unordered_map and friends, found through ADL.
+// UUIDs are random so summing the words is good enough.
+inline size_t hash_value(const LLUUID& id)
+{
+	return (size_t)id.getCRC32();
+}
+
 /*
  * Sub-classes for keeping transaction IDs and asset IDs
  * straight.
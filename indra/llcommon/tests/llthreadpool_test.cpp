@@ -0,0 +1,231 @@
+/** 
+ * @file llthreadpool_test.cpp
+ * @brief Tests for LLThreadPool
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ * 
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ * 
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ * 
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llthreadpool.h"
+#include "../lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	class CountJob : public LLThreadPool::Job
+	{
+	public:
+		CountJob() : mRuns(0) {}
+		/*virtual*/ void run()		{ ++mRuns; }
+		S32 mRuns;
+	};
+
+	// A stand-in for one spatial partition of a recorded scene: a list of
+	// boxes, culled against six planes into a list of visible box indices.
+	struct ScenePartition
+	{
+		std::vector<F32> mCenters;	// x, y, z per box
+		std::vector<F32> mRadii;	// x, y, z per box
+	};
+
+	struct ScenePlane
+	{
+		F32 mN[3];
+		F32 mD;
+	};
+
+	void cull_partition(const ScenePartition& part, const ScenePlane* planes, std::vector<S32>& visible)
+	{
+		S32 count = (S32)part.mRadii.size()/3;
+		for (S32 i = 0; i < count; ++i)
+		{
+			const F32* c = &part.mCenters[i*3];
+			const F32* r = &part.mRadii[i*3];
+			bool inside = true;
+			for (S32 p = 0; p < 6 && inside; ++p)
+			{
+				const ScenePlane& plane = planes[p];
+				F32 d = plane.mN[0]*c[0] + plane.mN[1]*c[1] + plane.mN[2]*c[2] + plane.mD;
+				F32 extent = fabsf(plane.mN[0])*r[0] + fabsf(plane.mN[1])*r[1] + fabsf(plane.mN[2])*r[2];
+				inside = d + extent >= 0.f;
+			}
+			if (inside)
+			{
+				visible.push_back(i);
+			}
+		}
+	}
+
+	class CullJob : public LLThreadPool::Job
+	{
+	public:
+		CullJob(const ScenePartition& part, const ScenePlane* planes)
+		:	mPart(part), mPlanes(planes) {}
+
+		/*virtual*/ void run()
+		{
+			mVisible.clear();
+			cull_partition(mPart, mPlanes, mVisible);
+		}
+
+		const ScenePartition& mPart;
+		const ScenePlane* mPlanes;
+		std::vector<S32> mVisible;
+	};
+}
+
+namespace tut
+{
+	struct threadpool_test
+	{
+		threadpool_test()
+		{
+			// Regions times partitions, with a few large ones standing in for
+			// bridge heavy regions so the jobs are uneven.
+			const S32 PARTITIONS = 64;
+			U32 seed = 1;
+			mScene.resize(PARTITIONS);
+			for (S32 i = 0; i < PARTITIONS; ++i)
+			{
+				S32 boxes = (i % 8 == 0) ? 20000 : 2000;
+				ScenePartition& part = mScene[i];
+				for (S32 j = 0; j < boxes*3; ++j)
+				{
+					seed = seed*1664525 + 1013904223;
+					part.mCenters.push_back((F32)(seed >> 8) / (F32)(1 << 24) * 512.f - 256.f);
+					seed = seed*1664525 + 1013904223;
+					part.mRadii.push_back((F32)(seed >> 8) / (F32)(1 << 24) * 4.f);
+				}
+			}
+
+			// A box shaped frustum around the origin, 100m on each side
+			for (S32 p = 0; p < 6; ++p)
+			{
+				ScenePlane& plane = mPlanes[p];
+				plane.mN[0] = plane.mN[1] = plane.mN[2] = 0.f;
+				plane.mN[p/2] = (p & 1) ? -1.f : 1.f;
+				plane.mD = 50.f;
+			}
+		}
+
+		std::vector<ScenePartition> mScene;
+		ScenePlane mPlanes[6];
+
+		// Culls the scene with the pool and merges the results in job order.
+		void cull(LLThreadPool& pool, std::vector<S32>& merged)
+		{
+			std::vector<CullJob*> cull_jobs;
+			LLThreadPool::job_list_t jobs;
+			for (U32 i = 0; i < mScene.size(); ++i)
+			{
+				cull_jobs.push_back(new CullJob(mScene[i], mPlanes));
+				jobs.push_back(cull_jobs.back());
+			}
+			pool.run(jobs);
+
+			merged.clear();
+			for (U32 i = 0; i < cull_jobs.size(); ++i)
+			{
+				merged.push_back(-1);
+				merged.insert(merged.end(), cull_jobs[i]->mVisible.begin(), cull_jobs[i]->mVisible.end());
+				delete cull_jobs[i];
+			}
+		}
+	};
+	typedef test_group<threadpool_test> threadpool_group_t;
+	typedef threadpool_group_t::object threadpool_object_t;
+	tut::threadpool_group_t threadpool_instance("LLThreadPool");
+
+	template<> template<>
+	void threadpool_object_t::test<1>()
+	{
+		set_test_name("every job runs once");
+		const S32 JOBS = 100;
+		for (U32 threads = 0; threads < 4; ++threads)
+		{
+			LLThreadPool pool("test pool", threads);
+			ensure_equals("thread count", pool.getThreadCount(), threads);
+
+			std::vector<CountJob> count_jobs(JOBS);
+			LLThreadPool::job_list_t jobs;
+			for (S32 i = 0; i < JOBS; ++i)
+			{
+				jobs.push_back(&count_jobs[i]);
+			}
+
+			// Reusing the pool must work as well as the first time
+			for (S32 pass = 1; pass <= 3; ++pass)
+			{
+				pool.run(jobs);
+				for (S32 i = 0; i < JOBS; ++i)
+				{
+					ensure_equals("runs", count_jobs[i].mRuns, pass);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void threadpool_object_t::test<2>()
+	{
+		set_test_name("empty job list");
+		LLThreadPool pool("test pool", 2);
+		pool.run(LLThreadPool::job_list_t());
+	}
+
+	template<> template<>
+	void threadpool_object_t::test<3>()
+	{
+		set_test_name("parallel cull merges like a serial one");
+		LLThreadPool serial("serial", 0);
+		LLThreadPool parallel("parallel", 3);
+
+		std::vector<S32> expected;
+		std::vector<S32> merged;
+		cull(serial, expected);
+		cull(parallel, merged);
+		ensure("something visible", expected.size() > mScene.size());
+		ensure("same result", merged == expected);
+	}
+
+	template<> template<>
+	void threadpool_object_t::test<4>()
+	{
+		set_test_name("cull benchmark");
+		const S32 FRAMES = 20;
+		std::vector<S32> merged;
+		for (U32 threads = 0; threads < 4; ++threads)
+		{
+			LLThreadPool pool("benchmark", threads);
+			LLTimer timer;
+			for (S32 frame = 0; frame < FRAMES; ++frame)
+			{
+				cull(pool, merged);
+			}
+			llinfos << "Culled " << mScene.size() << " partitions with " << threads
+					<< " worker threads: " << timer.getElapsedTimeF64()*1000.0/FRAMES
+					<< " ms per frame" << llendl;
+		}
+	}
+}
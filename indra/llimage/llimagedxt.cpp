@@ -27,6 +27,13 @@
 
 #include "llimagedxt.h"
 
+#if defined(__SSE2__) || (LL_MSVC && (_M_IX86_FP >= 2 || defined(_M_X64)))
+#include <emmintrin.h>
+#define LL_DXT_SSE2 1
+#else
+#define LL_DXT_SSE2 0
+#endif
+
 //static
 void LLImageDXT::checkMinWidthHeight(EFileFormat format, S32& width, S32& height)
 {
@@ -503,3 +510,539 @@ void LLImageDXT::extractMip(const U8 *indata, U8* mipdata, int width, int height
 }
 
 //============================================================================
+
+// Block compression
+//
+// Endpoints are the corners of the block's colour bounding box, inset by a
+// sixteenth of its extent so the interpolated colours land on the bulk of the
+// texels rather than on outliers. Texels are then projected onto the line
+// between the endpoints to pick their index. Alpha endpoints are not inset,
+// so fully transparent and fully opaque texels stay exact for alpha masks.
+
+static const S32 BLOCK_TEXELS = 16;
+
+// Gathers a 4x4 block as RGBA, clamping at the image edges so mips smaller
+// than a block repeat their last row and column.
+static void load_block(const U8* data, S32 width, S32 height, S32 ncomponents,
+					   S32 block_x, S32 block_y, U8* block)
+{
+	for (S32 y = 0; y < 4; y++)
+	{
+		S32 row = llmin(block_y + y, height - 1);
+		for (S32 x = 0; x < 4; x++)
+		{
+			S32 col = llmin(block_x + x, width - 1);
+			const U8* texel = data + (row * width + col) * ncomponents;
+			U8* out = block + (y * 4 + x) * 4;
+			out[0] = texel[0];
+			out[1] = texel[1];
+			out[2] = texel[2];
+			out[3] = ncomponents == 4 ? texel[3] : 255;
+		}
+	}
+}
+
+static void get_min_max(const U8* block, U8* min_color, U8* max_color)
+{
+#if LL_DXT_SSE2
+	__m128i t0 = _mm_loadu_si128((const __m128i*) block);
+	__m128i t1 = _mm_loadu_si128((const __m128i*) (block + 16));
+	__m128i t2 = _mm_loadu_si128((const __m128i*) (block + 32));
+	__m128i t3 = _mm_loadu_si128((const __m128i*) (block + 48));
+	__m128i lo = _mm_min_epu8(_mm_min_epu8(t0, t1), _mm_min_epu8(t2, t3));
+	__m128i hi = _mm_max_epu8(_mm_max_epu8(t0, t1), _mm_max_epu8(t2, t3));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+	lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+	hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	U32 lo_texel = (U32) _mm_cvtsi128_si32(lo);
+	U32 hi_texel = (U32) _mm_cvtsi128_si32(hi);
+	memcpy(min_color, &lo_texel, 4);	/* Flawfinder: ignore */
+	memcpy(max_color, &hi_texel, 4);	/* Flawfinder: ignore */
+#else
+	for (S32 c = 0; c < 4; c++)
+	{
+		min_color[c] = 255;
+		max_color[c] = 0;
+	}
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const U8* texel = block + i * 4;
+		for (S32 c = 0; c < 4; c++)
+		{
+			min_color[c] = llmin(min_color[c], texel[c]);
+			max_color[c] = llmax(max_color[c], texel[c]);
+		}
+	}
+#endif
+}
+
+// Projection of each texel's colour onto dir, relative to origin.
+static void project_colors(const U8* block, const S32* origin, const S32* dir, S32* dots)
+{
+#if LL_DXT_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset = _mm_set_epi16(0, (S16) origin[2], (S16) origin[1], (S16) origin[0],
+										 0, (S16) origin[2], (S16) origin[1], (S16) origin[0]);
+	const __m128i axis = _mm_set_epi16(0, (S16) dir[2], (S16) dir[1], (S16) dir[0],
+									   0, (S16) dir[2], (S16) dir[1], (S16) dir[0]);
+	for (S32 i = 0; i < BLOCK_TEXELS; i += 4)
+	{
+		__m128i texels = _mm_loadu_si128((const __m128i*) (block + i * 4));
+		// two texels per register as 16 bit channels, then r*x + g*y and
+		// b*z + a*0 per texel
+		__m128i lo = _mm_madd_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(texels, zero), offset), axis);
+		__m128i hi = _mm_madd_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(texels, zero), offset), axis);
+		// gather the even and odd halves and add them
+		__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+		__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_si128((__m128i*) (dots + i), _mm_add_epi32(even, odd));
+	}
+#else
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const U8* texel = block + i * 4;
+		dots[i] = (texel[0] - origin[0]) * dir[0] +
+				  (texel[1] - origin[1]) * dir[1] +
+				  (texel[2] - origin[2]) * dir[2];
+	}
+#endif
+}
+
+// rounds to the nearest value unpack_565() gives back
+static U16 pack_565(const S32* color)
+{
+	S32 r = (color[0] * 31 + 127) / 255;
+	S32 g = (color[1] * 63 + 127) / 255;
+	S32 b = (color[2] * 31 + 127) / 255;
+	return (U16) ((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(U16 packed, S32* color)
+{
+	S32 r = (packed >> 11) & 0x1f;
+	S32 g = (packed >> 5) & 0x3f;
+	S32 b = packed & 0x1f;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+static void encode_color_block(const U8* block, U8* out)
+{
+	U8 min_color[4];
+	U8 max_color[4];
+	get_min_max(block, min_color, max_color);
+
+	S32 lo[3];
+	S32 hi[3];
+	for (S32 c = 0; c < 3; c++)
+	{
+		S32 inset = (max_color[c] - min_color[c]) >> 4;
+		lo[c] = min_color[c] + inset;
+		hi[c] = max_color[c] - inset;
+	}
+
+	// the box has four diagonals; pick the one that follows the correlation
+	// of green and blue with red
+	S32 mid[3] = { (lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2, (lo[2] + hi[2]) / 2 };
+	S32 cov_rg = 0;
+	S32 cov_rb = 0;
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const U8* texel = block + i * 4;
+		S32 r = texel[0] - mid[0];
+		cov_rg += r * (texel[1] - mid[1]);
+		cov_rb += r * (texel[2] - mid[2]);
+	}
+	if (cov_rg < 0)
+	{
+		std::swap(lo[1], hi[1]);
+	}
+	if (cov_rb < 0)
+	{
+		std::swap(lo[2], hi[2]);
+	}
+
+	// color0 > color1 keeps the block in four colour mode, equal endpoints
+	// need no indices at all
+	U16 color0 = pack_565(hi);
+	U16 color1 = pack_565(lo);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+	U32 indices = 0;
+	if (color0 != color1)
+	{
+		S32 end0[3];
+		S32 end1[3];
+		unpack_565(color0, end0);
+		unpack_565(color1, end1);
+		S32 dir[3] = { end0[0] - end1[0], end0[1] - end1[1], end0[2] - end1[2] };
+		S32 length2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+
+		S32 dots[BLOCK_TEXELS];
+		project_colors(block, end1, dir, dots);
+
+		// palette order is color0, color1, 2/3 color0, 1/3 color0
+		static const U32 index_from_step[4] = { 1, 3, 2, 0 };
+		for (S32 i = 0; i < BLOCK_TEXELS; i++)
+		{
+			S32 step = llclamp((dots[i] * 3 + length2 / 2) / length2, 0, 3);
+			indices |= index_from_step[step] << (i * 2);
+		}
+	}
+
+	out[0] = (U8) (color0 & 0xff);
+	out[1] = (U8) (color0 >> 8);
+	out[2] = (U8) (color1 & 0xff);
+	out[3] = (U8) (color1 >> 8);
+	out[4] = (U8) (indices & 0xff);
+	out[5] = (U8) ((indices >> 8) & 0xff);
+	out[6] = (U8) ((indices >> 16) & 0xff);
+	out[7] = (U8) (indices >> 24);
+}
+
+static void encode_alpha_block(const U8* block, U8* out)
+{
+	U8 alpha0 = 0;
+	U8 alpha1 = 255;
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		alpha0 = llmax(alpha0, block[i * 4 + 3]);
+		alpha1 = llmin(alpha1, block[i * 4 + 3]);
+	}
+
+	U64 indices = 0;
+	S32 range = alpha0 - alpha1;
+	if (range > 0)
+	{
+		// eight value mode: alpha0, alpha1, then six steps from alpha0
+		// towards alpha1
+		for (S32 i = 0; i < BLOCK_TEXELS; i++)
+		{
+			S32 step = ((block[i * 4 + 3] - alpha1) * 7 + range / 2) / range;
+			U64 index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+			indices |= index << (i * 3);
+		}
+	}
+
+	out[0] = alpha0;
+	out[1] = alpha1;
+	for (S32 i = 0; i < 6; i++)
+	{
+		out[2 + i] = (U8) ((indices >> (i * 8)) & 0xff);
+	}
+}
+
+static void decode_color_block(const U8* in, BOOL four_colors, U8* block)
+{
+	U16 color0 = in[0] | (in[1] << 8);
+	U16 color1 = in[2] | (in[3] << 8);
+	U32 indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((U32) in[7] << 24);
+
+	S32 palette[4][4];
+	unpack_565(color0, palette[0]);
+	unpack_565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+	for (S32 c = 0; c < 3; c++)
+	{
+		if (four_colors || color0 > color1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = (four_colors || color0 > color1) ? 255 : 0;
+
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		const S32* color = palette[(indices >> (i * 2)) & 3];
+		U8* texel = block + i * 4;
+		texel[0] = (U8) color[0];
+		texel[1] = (U8) color[1];
+		texel[2] = (U8) color[2];
+		texel[3] = (U8) color[3];
+	}
+}
+
+static void decode_alpha_block(const U8* in, U8* block)
+{
+	S32 alpha[8];
+	alpha[0] = in[0];
+	alpha[1] = in[1];
+	if (alpha[0] > alpha[1])
+	{
+		for (S32 i = 1; i < 7; i++)
+		{
+			alpha[i + 1] = ((7 - i) * alpha[0] + i * alpha[1]) / 7;
+		}
+	}
+	else
+	{
+		for (S32 i = 1; i < 5; i++)
+		{
+			alpha[i + 1] = ((5 - i) * alpha[0] + i * alpha[1]) / 5;
+		}
+		alpha[6] = 0;
+		alpha[7] = 255;
+	}
+
+	U64 indices = 0;
+	for (S32 i = 0; i < 6; i++)
+	{
+		indices |= (U64) in[2 + i] << (i * 8);
+	}
+	for (S32 i = 0; i < BLOCK_TEXELS; i++)
+	{
+		block[i * 4 + 3] = (U8) alpha[(indices >> (i * 3)) & 7];
+	}
+}
+
+//static
+void LLImageDXT::compressBlocks(EFileFormat format, const U8* data, S32 width, S32 height,
+								S32 ncomponents, U8* blocks)
+{
+	BOOL alpha = (format == FORMAT_DXT5 || format == FORMAT_DXR5);
+	llassert(alpha || format == FORMAT_DXT1 || format == FORMAT_DXR1);
+
+	U8 block[BLOCK_TEXELS * 4];
+	for (S32 y = 0; y < height; y += 4)
+	{
+		for (S32 x = 0; x < width; x += 4)
+		{
+			load_block(data, width, height, ncomponents, x, y, block);
+			if (alpha)
+			{
+				encode_alpha_block(block, blocks);
+				blocks += 8;
+			}
+			encode_color_block(block, blocks);
+			blocks += 8;
+		}
+	}
+}
+
+//static
+void LLImageDXT::decompressBlocks(EFileFormat format, const U8* blocks, S32 width, S32 height,
+								  S32 ncomponents, U8* data)
+{
+	BOOL alpha = (format == FORMAT_DXT5 || format == FORMAT_DXR5);
+	llassert(alpha || format == FORMAT_DXT1 || format == FORMAT_DXR1);
+
+	U8 block[BLOCK_TEXELS * 4];
+	for (S32 y = 0; y < height; y += 4)
+	{
+		for (S32 x = 0; x < width; x += 4)
+		{
+			if (alpha)
+			{
+				decode_color_block(blocks + 8, TRUE, block);
+				decode_alpha_block(blocks, block);
+				blocks += 16;
+			}
+			else
+			{
+				decode_color_block(blocks, FALSE, block);
+				blocks += 8;
+			}
+
+			S32 rows = llmin(4, height - y);
+			S32 cols = llmin(4, width - x);
+			for (S32 by = 0; by < rows; by++)
+			{
+				U8* out = data + ((y + by) * width + x) * ncomponents;
+				for (S32 bx = 0; bx < cols; bx++)
+				{
+					memcpy(out, block + (by * 4 + bx) * 4, ncomponents);	/* Flawfinder: ignore */
+					out += ncomponents;
+				}
+			}
+		}
+	}
+}
+
+BOOL LLImageDXT::compress(const LLImageRaw* raw_image)
+{
+	llassert_always(raw_image);
+
+	S32 ncomponents = raw_image->getComponents();
+	EFileFormat format;
+	switch (ncomponents)
+	{
+	  case 3:
+		format = FORMAT_DXR1;
+		break;
+	  case 4:
+		format = FORMAT_DXR5;
+		break;
+	  default:
+		setLastError("LLImageDXT can only compress RGB and RGBA images");
+		return FALSE;
+	}
+
+	S32 width = raw_image->getWidth();
+	S32 height = raw_image->getHeight();
+	if (width <= 0 || height <= 0 || (width & (width - 1)) || (height & (height - 1)))
+	{
+		setLastError("LLImageDXT can only compress power of two images");
+		return FALSE;
+	}
+
+	setSize(width, height, ncomponents);
+	mHeaderSize = sizeof(dxtfile_header_t);
+	mFileFormat = format;
+
+	S32 nmips = calcNumMips(width, height);
+	S32 totbytes = mHeaderSize;
+	for (S32 mip = 0; mip < nmips; mip++)
+	{
+		totbytes += formatBytes(format, width >> mip, height >> mip);
+	}
+	if (!allocateData(totbytes))
+	{
+		return FALSE;
+	}
+
+	U8* data = getData();
+	dxtfile_header_t* header = (dxtfile_header_t*)data;
+	memset(header, 0, mHeaderSize);
+	header->fourcc = 0x20534444;
+	header->pixel_fmt.fourcc = getFourCC(format);
+	header->num_mips = nmips;
+	header->maxwidth = width;
+	header->maxheight = height;
+
+	// each mip is box filtered from the one above it
+	std::vector<U8> mips[2];
+	const U8* mipdata = raw_image->getData();
+	for (S32 mip = 0; mip < nmips; mip++)
+	{
+		S32 w = width >> mip;
+		S32 h = height >> mip;
+		if (mip > 0)
+		{
+			std::vector<U8>& next = mips[mip & 1];
+			next.resize(w * h * ncomponents);
+			generateMip(mipdata, &next[0], w, h, ncomponents);
+			mipdata = &next[0];
+		}
+		compressBlocks(format, mipdata, w, h, ncomponents, data + getMipOffset(mip));
+	}
+
+	setDiscardLevel(0);
+	return TRUE;
+}
+
+void LLImageDXT::discardMips(S32 discard)
+{
+	llassert_always(mFileFormat >= FORMAT_DXR1 && mHeaderSize == sizeof(dxtfile_header_t));
+
+	S32 width = getWidth();
+	S32 height = getHeight();
+	S32 nmips = calcNumMips(width, height);
+	discard = llclamp(discard, 0, nmips - 1);
+	if (discard == 0)
+	{
+		return;
+	}
+
+	// the smaller mips come first, so the new image is a prefix of this one
+	S32 size = getMipOffset(discard) + formatBytes(mFileFormat, width >> discard, height >> discard);
+	width >>= discard;
+	height >>= discard;
+
+	dxtfile_header_t* header = (dxtfile_header_t*)getData();
+	header->maxwidth = width;
+	header->maxheight = height;
+	header->num_mips = nmips - discard;
+	reallocateData(size);
+	setSize(width, height, getComponents());
+	setDiscardLevel(0);
+}
+
+static const U32 CACHE_MAGIC = 0x43424c4c; // "LLBC"
+static const U32 CACHE_VERSION = 1;
+
+//static
+void LLImageDXT::initCacheHeader(cache_header_t& header, S32 discard)
+{
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.discard = discard;
+}
+
+//static
+BOOL LLImageDXT::checkCacheHeader(const cache_header_t& header, S32 data_size)
+{
+	return header.magic == CACHE_MAGIC && header.version == CACHE_VERSION &&
+		header.discard >= 0 && header.discard <= MAX_DISCARD_LEVEL &&
+		data_size > (S32)sizeof(dxtfile_header_t);
+}
+
+BOOL LLImageDXT::updateCacheData()
+{
+	resetLastError();
+
+	S32 data_size = getDataSize();
+	if (!getData() || data_size < (S32)sizeof(dxtfile_header_t))
+	{
+		setLastError("LLImageDXT cache record too short");
+		return FALSE;
+	}
+
+	// updateData() trusts the header, so check it first
+	const dxtfile_header_t* header = (const dxtfile_header_t*)getData();
+	EFileFormat format = getFormat(header->pixel_fmt.fourcc);
+	S32 width = header->maxwidth;
+	S32 height = header->maxheight;
+	if (header->fourcc != 0x20534444 ||
+		(format != FORMAT_DXR1 && format != FORMAT_DXR5) ||
+		width <= 0 || height <= 0 || width > MAX_IMAGE_SIZE || height > MAX_IMAGE_SIZE ||
+		(width & (width - 1)) || (height & (height - 1)) ||
+		header->num_mips != calcNumMips(width, height))
+	{
+		setLastError("LLImageDXT cache record has a bad header");
+		return FALSE;
+	}
+
+	S32 image_size = sizeof(dxtfile_header_t);
+	for (S32 mip = 0; mip < header->num_mips; mip++)
+	{
+		image_size += formatBytes(format, width >> mip, height >> mip);
+	}
+	if (data_size != image_size)
+	{
+		setLastError("LLImageDXT cache record is the wrong size");
+		return FALSE;
+	}
+
+	return updateData() && getDiscardLevel() == 0;
+}
+
+BOOL LLImageDXT::decompressMip(S32 discard, LLPointer<LLImageRaw>& raw)
+{
+	if (mFileFormat != FORMAT_DXR1 && mFileFormat != FORMAT_DXR5)
+	{
+		setLastError("LLImageDXT can only decompress DXR1 and DXR5 images");
+		return FALSE;
+	}
+
+	S32 nmips = calcNumMips(getWidth(), getHeight());
+	discard = llclamp(discard, 0, nmips - 1);
+	S32 width = getWidth() >> discard;
+	S32 height = getHeight() >> discard;
+	raw = new LLImageRaw(width, height, getComponents());
+	decompressBlocks(mFileFormat, getData() + getMipOffset(discard), width, height,
+					 getComponents(), raw->getData());
+	return TRUE;
+}
+
+//============================================================================
@@ -116,6 +116,38 @@ public:
 	bool isCompressed() { return (mFileFormat >= FORMAT_DXT1 && mFileFormat <= FORMAT_DXR5); }
 
 	bool convertToDXR(); // convert from DXT to DXR
+
+	// Compresses raw_image and a box filtered mip chain into DXR1 blocks
+	// for 3 components or DXR5 blocks for 4. Dimensions must be powers of 2.
+	BOOL compress(const LLImageRaw* raw_image);
+	// Drops the mips larger than discard from a DXR image.
+	void discardMips(S32 discard);
+	// Decodes the blocks of one mip of a DXR1 or DXR5 image.
+	BOOL decompressMip(S32 discard, LLPointer<LLImageRaw>& raw);
+
+	// BC1 (DXT1) or BC3 (DXT5) blocks from and to width x height texels,
+	// packed with ncomponents bytes each. 3 component texels are opaque.
+	static void compressBlocks(EFileFormat format, const U8* data, S32 width, S32 height,
+							   S32 ncomponents, U8* blocks);
+	static void decompressBlocks(EFileFormat format, const U8* blocks, S32 width, S32 height,
+								 S32 ncomponents, U8* data);
+
+	// Header of a compressed texture cache record, ahead of an image from
+	// compress() that holds discard and the mips below it.
+	struct cache_header_t
+	{
+		U32 magic;
+		U32 version;
+		S32 discard;
+	};
+	static void initCacheHeader(cache_header_t& header, S32 discard);
+	// FALSE unless header came from initCacheHeader() in this version and
+	// data_size bytes are enough for an image after it.
+	static BOOL checkCacheHeader(const cache_header_t& header, S32 data_size);
+	// updateData() for the image read after a cache header. FALSE unless it
+	// is a whole DXR1 or DXR5 mip chain as compress() and discardMips()
+	// leave it.
+	BOOL updateCacheData();
 	
 	static void checkMinWidthHeight(EFileFormat format, S32& width, S32& height);
 	static S32 formatBits(EFileFormat format);
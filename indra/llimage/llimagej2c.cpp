@@ -53,6 +53,8 @@ LLImageJ2CImpl* fallbackCreateLLImageJ2CImpl();
 void fallbackDestroyLLImageJ2CImpl(LLImageJ2CImpl* impl);
 const char* fallbackEngineInfoLLImageJ2CImpl();
 
+LLMutex* LLImageJ2CImpl::sMutex = NULL;
+
 // Test data gathering handle
 LLImageCompressionTester* LLImageJ2C::sTesterp = NULL ;
 const std::string sTesterName("ImageCompressionTester");
@@ -61,6 +63,11 @@ const std::string sTesterName("ImageCompressionTester");
 //Loads the required "create", "destroy" and "engineinfo" functions needed
 void LLImageJ2C::openDSO()
 {
+	if (!LLImageJ2CImpl::sMutex)
+	{
+		LLImageJ2CImpl::sMutex = new LLMutex(NULL);
+	}
+
 	//attempt to load a DSO and get some functions from it
 	std::string dso_name;
 	std::string dso_path;
@@ -163,6 +170,9 @@ void LLImageJ2C::closeDSO()
 {
 	if ( j2cimpl_dso_handle ) apr_dso_unload(j2cimpl_dso_handle);
 	if (j2cimpl_dso_memory_pool) apr_pool_destroy(j2cimpl_dso_memory_pool);
+
+	delete LLImageJ2CImpl::sMutex;
+	LLImageJ2CImpl::sMutex = NULL;
 }
 
 //static
@@ -178,7 +188,11 @@ LLImageJ2C::LLImageJ2C() : 	LLImageFormatted(IMG_CODEC_J2C),
 							mMaxBytes(0),
 							mRawDiscardLevel(-1),
 							mRate(0.0f),
+							mDecodeReused(FALSE),
 							mReversible(FALSE),
+							mPreviewQuality(FALSE),
+							mEncodeTileSize(0),
+							mEncodeThreadPool(NULL),
 							mAreaUsedForDataSizeCalcs(0)
 {
 	//We assume here that if we wanted to create via
@@ -315,6 +329,7 @@ BOOL LLImageJ2C::decodeChannels(LLImageRaw *raw_imagep, F32 decode_time, S32 fir
 		// Update the raw discard level
 		updateRawDiscardLevel();
 		mDecoding = TRUE;
+		mDecodeReused = FALSE;
 		res = mImpl->decodeImpl(*this, *raw_imagep, decode_time, first_channel, max_channel_count);
 	}
 	
@@ -343,7 +358,9 @@ BOOL LLImageJ2C::decodeChannels(LLImageRaw *raw_imagep, F32 decode_time, S32 fir
 		// Note that we *do not* take into account the decompression failures data so we might overestimate the time spent processing
 
 		// Always add the decompression time to the stat
-		tester->updateDecompressionStats(elapsed.getElapsedTimeF32()) ;
+		F32 decode_time_spent = elapsed.getElapsedTimeF32();
+		tester->updateDecompressionStats(decode_time_spent) ;
+		tester->updateDecompressionLevelStats(mRawDiscardLevel, decode_time_spent, res && mDecodeReused) ;
 		if (res)
 		{
 			// The whole data stream is finally decompressed when res is returned as TRUE
@@ -601,6 +618,15 @@ LLImageCompressionTester::LLImageCompressionTester() : LLMetricPerformanceTester
 	addMetric("Volume Out Decompression (kB)");
 	addMetric("Decompression Ratio (x:1)");
 	addMetric("Perf Decompression (kB/s)");
+	for (S32 i = 0; i <= MAX_DISCARD_LEVEL; i++)
+	{
+		addMetric(llformat("Time Decompression Discard %d (s)", i));
+		addMetric(llformat("Decompressions Discard %d", i));
+		mTimeDecompressionLevel[i] = 0.0f;
+		mCountDecompressionLevel[i] = 0;
+	}
+	addMetric("Decompressions Reused");
+	mCountDecompressionReused = 0;
 
 	addMetric("Time Compression (s)");
 	addMetric("Volume In Compression (kB)");
@@ -662,6 +688,12 @@ void LLImageCompressionTester::outputTestRecord(LLSD *sd)
 	(*sd)[currentLabel]["Volume Out Decompression (kB)"]= (LLSD::Real)totalkBOutDecompression;
 	(*sd)[currentLabel]["Decompression Ratio (x:1)"]	= (LLSD::Real)decompressionRate;
 	(*sd)[currentLabel]["Perf Decompression (kB/s)"]	= (LLSD::Real)decompressionPerf;
+	for (S32 i = 0; i <= MAX_DISCARD_LEVEL; i++)
+	{
+		(*sd)[currentLabel][llformat("Time Decompression Discard %d (s)", i)]	= (LLSD::Real)mTimeDecompressionLevel[i];
+		(*sd)[currentLabel][llformat("Decompressions Discard %d", i)]		= (LLSD::Integer)mCountDecompressionLevel[i];
+	}
+	(*sd)[currentLabel]["Decompressions Reused"]		= (LLSD::Integer)mCountDecompressionReused;
 
 	(*sd)[currentLabel]["Time Compression (s)"]			= (LLSD::Real)mTotalTimeCompression;
 	(*sd)[currentLabel]["Volume In Compression (kB)"]	= (LLSD::Real)totalkBInCompression;
@@ -694,6 +726,19 @@ void LLImageCompressionTester::updateDecompressionStats(const F32 deltaTime)
 	mTotalTimeDecompression += deltaTime;
 }
 
+void LLImageCompressionTester::updateDecompressionLevelStats(const S32 discardLevel, const F32 deltaTime, const BOOL reused) 
+{
+	if (discardLevel >= 0 && discardLevel <= MAX_DISCARD_LEVEL)
+	{
+		mTimeDecompressionLevel[discardLevel] += deltaTime;
+		mCountDecompressionLevel[discardLevel]++;
+	}
+	if (reused)
+	{
+		mCountDecompressionReused++;
+	}
+}
+
 void LLImageCompressionTester::updateDecompressionStats(const S32 bytesIn, const S32 bytesOut) 
 {
 	mTotalBytesInDecompression += bytesIn;
@@ -33,6 +33,7 @@
 
 class LLImageJ2CImpl;
 class LLImageCompressionTester ;
+class LLThreadPool;
 
 class LLImageJ2C : public LLImageFormatted
 {
@@ -68,6 +69,14 @@ public:
 	void setRate(F32 rate);
 	void setMaxBytes(S32 max_bytes);
 	S32 getMaxBytes() const { return mMaxBytes; }
+	// Trades quality for encode speed, for images that will soon be
+	// replaced.
+	void setPreviewQuality(BOOL preview) { mPreviewQuality = preview; }
+	// Encodes tile_size square tiles in parallel on pool. Images that are
+	// not a whole number of tiles larger than one are encoded as usual.
+	// Tiled codestreams can't be partially decoded as well: the first bytes
+	// only hold the first tiles.
+	void setEncodeTiles(S32 tile_size, LLThreadPool* pool) { mEncodeTileSize = tile_size; mEncodeThreadPool = pool; }
 
 	static S32 calcHeaderSizeJ2C();
 	static S32 calcDataSizeJ2C(S32 w, S32 h, S32 comp, S32 discard_level, F32 rate = 0.f);
@@ -92,6 +101,10 @@ protected:
 	S8  mRawDiscardLevel;
 	F32 mRate;
 	BOOL mReversible;
+	BOOL mPreviewQuality;
+	S32 mEncodeTileSize;
+	LLThreadPool* mEncodeThreadPool;
+	BOOL mDecodeReused;	// set by the impl when the last decode reused earlier work
 	LLImageJ2CImpl *mImpl;
 	std::string mLastError;
 
@@ -120,6 +133,10 @@ protected:
 	virtual BOOL encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, const char* comment_text, F32 encode_time=0.0,
 							BOOL reversible=FALSE) = 0;
 
+	// Guards state implementations share between images, such as decode
+	// caches. NULL until LLImageJ2C::openDSO().
+	static LLMutex* sMutex;
+
 	friend class LLImageJ2C;
 };
 
@@ -138,6 +155,7 @@ class LLImageCompressionTester : public LLMetricPerformanceTesterBasic
         
         void updateDecompressionStats(const F32 deltaTime) ;
         void updateDecompressionStats(const S32 bytesIn, const S32 bytesOut) ;
+        void updateDecompressionLevelStats(const S32 discardLevel, const F32 deltaTime, const BOOL reused) ;
         void updateCompressionStats(const F32 deltaTime) ;
         void updateCompressionStats(const S32 bytesIn, const S32 bytesOut) ;
     
@@ -159,6 +177,12 @@ class LLImageCompressionTester : public LLMetricPerformanceTesterBasic
         //
         F32 mTotalTimeDecompression;        // Total time spent in computing decompression
         F32 mTotalTimeCompression;          // Total time spent in computing compression
+        //
+        // Per discard level decompression
+        //
+        F32 mTimeDecompressionLevel[MAX_DISCARD_LEVEL+1];   // Time spent decoding to each level
+        U32 mCountDecompressionLevel[MAX_DISCARD_LEVEL+1];  // Decodes to each level
+        U32 mCountDecompressionReused;                      // Decodes served from kept decoder state
     };
 
 #endif
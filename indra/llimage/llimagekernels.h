@@ -0,0 +1,77 @@
+/**
+ * @file llimagekernels.h
+ * @brief Pixel loops behind LLImageRaw mips, scaling, swizzles and compositing
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGEKERNELS_H
+#define LL_LLIMAGEKERNELS_H
+
+#include "stdtypes.h"
+
+// A table of the inner loops LLImageRaw and LLImageBase spend their time
+// in. The scalar table is the reference; the SSE2 table produces the same
+// bytes and is picked at startup when the CPU has SSE2. Kernels a table
+// has no faster version of, such as mips of 2 or 3 channel images, fall
+// back to the scalar ones.
+//
+// The SSE2 kernels live in llimagekernels_sse2.cpp, which is the only
+// file built with SSE2 code generation, so nothing runs SSE2 code before
+// the CPU has been checked.
+struct LLImageKernels
+{
+	// Box filters in, of 2*width by 2*height pixels, into out.
+	void (*mGenerateMip)(const U8* in, U8* out, S32 width, S32 height, S32 components);
+
+	// Area resamples in_len pixels into out_len pixels. Steps are in pixels
+	// so that columns can be scaled in place.
+	void (*mScaleLine)(const U8* in, U8* out, S32 in_len, S32 out_len,
+					   S32 in_step, S32 out_step, S32 components);
+
+	// As mScaleLine for an RGBA row, alpha blending the result over an RGB
+	// row.
+	void (*mCompositeLineScaled4onto3)(const U8* in, U8* out, S32 in_len, S32 out_len);
+
+	// RGB to RGBA with opaque alpha, and back.
+	void (*mCopy3onto4)(const U8* in, U8* out, S32 pixels);
+	void (*mCopy4onto3)(const U8* in, U8* out, S32 pixels);
+
+	// Alpha blends RGBA pixels over RGB ones.
+	void (*mComposite4onto3)(const U8* in, U8* out, S32 pixels);
+
+	const char* mName;
+
+	// Picks the table used by LLImageRaw. Called from LLImage::initClass().
+	static void initClass(BOOL use_sse2);
+
+	static const LLImageKernels& get()		{ return *sCurrent; }
+
+	static const LLImageKernels& getScalar();
+	// NULL when the library was built without the SSE2 kernels.
+	static const LLImageKernels* getSSE2();
+
+private:
+	static const LLImageKernels* sCurrent;
+};
+
+#endif // LL_LLIMAGEKERNELS_H
@@ -0,0 +1,311 @@
+/**
+ * @file llimagekernels_sse2.cpp
+ * @brief SSE2 image kernels
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+// Keep the includes down to what the kernels need: any header global
+// initialized here would be initialized with SSE2 code before the CPU
+// has been checked. See llv4math.h.
+#include "linden_common.h"
+
+#include "llimagekernels.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#define LL_IMAGE_KERNELS_SSE2 1
+#else
+#define LL_IMAGE_KERNELS_SSE2 0
+#endif
+
+#if LL_IMAGE_KERNELS_SSE2
+
+#include <emmintrin.h>
+
+// Spreads the 4 RGB pixels in the low 12 bytes of v to 4 byte spacing. The
+// bytes between them are 0.
+static inline __m128i expand_rgb(__m128i v)
+{
+	__m128i r = _mm_and_si128(v, _mm_set_epi32(0, 0, 0, 0x00ffffff));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_slli_si128(v, 1), _mm_set_epi32(0, 0, 0x00ffffff, 0)));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_slli_si128(v, 2), _mm_set_epi32(0, 0x00ffffff, 0, 0)));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_slli_si128(v, 3), _mm_set_epi32(0x00ffffff, 0, 0, 0)));
+	return r;
+}
+
+// The reverse of expand_rgb(), dropping every fourth byte. The top 4 bytes
+// are 0.
+static inline __m128i pack_rgb(__m128i v)
+{
+	__m128i r = _mm_and_si128(v, _mm_set_epi32(0, 0, 0, 0x00ffffff));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_srli_si128(v, 1), _mm_set_epi32(0, 0, 0x0000ffff, (S32)0xff000000)));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_srli_si128(v, 2), _mm_set_epi32(0, 0x000000ff, (S32)0xffff0000, 0)));
+	r = _mm_or_si128(r, _mm_and_si128(_mm_srli_si128(v, 3), _mm_set_epi32(0, (S32)0xffffff00, 0, 0)));
+	return r;
+}
+
+static inline void store_rgb(U8* out, __m128i v)
+{
+	_mm_storel_epi64((__m128i*)out, v);
+	S32 tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	memcpy(out + 8, &tail, 4);
+}
+
+// a * b / 255, rounded, on 16 bit lanes. Same as fast_fractional_mult().
+static inline __m128i fractional_mult(__m128i a, __m128i b)
+{
+	__m128i i = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(i, _mm_srli_epi16(i, 8)), 8);
+}
+
+// Blends the RGBA pixels of src over those of dst, both as 16 bit lanes.
+// The formula without the scalar code's special cases gives the same
+// result for alpha 0 and 255.
+static inline __m128i blend(__m128i src, __m128i dst)
+{
+	__m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+	__m128i transparency = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+	__m128i r = _mm_add_epi16(fractional_mult(dst, transparency), fractional_mult(src, alpha));
+	// The scalar code adds as U8
+	return _mm_and_si128(r, _mm_set1_epi16(0xff));
+}
+
+static inline __m128 load_pixel(const U8* p)
+{
+	S32 pixel;
+	memcpy(&pixel, p, 4);
+	__m128i zero = _mm_setzero_si128();
+	__m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero);
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+}
+
+// llround() of non negative lanes, truncated to U8 like the scalar casts.
+static inline S32 round_pixel(__m128 v)
+{
+	__m128i i = _mm_cvttps_epi32(_mm_add_ps(v, _mm_set1_ps(0.5f)));
+	i = _mm_and_si128(i, _mm_set1_epi32(0xff));
+	i = _mm_packs_epi32(i, i);
+	return _mm_cvtsi128_si32(_mm_packus_epi16(i, i));
+}
+
+// Area sample of output pixel x, in the same order of operations as the
+// scalar code so the sums round the same way.
+static inline S32 sample_pixel(const U8* in, S32 x, F32 ratio, F32 norm_factor, S32 in_len, S32 in_step)
+{
+	const F32 sample0 = x * ratio;
+	const F32 sample1 = (x+1) * ratio;
+	const S32 index0 = S32(sample0);
+	const S32 index1 = S32(sample1);
+	const F32 fract0 = 1.f - (sample0 - F32(index0));
+	const F32 fract1 = sample1 - F32(index1);
+
+	S32 result;
+	if (index0 == index1)
+	{
+		memcpy(&result, in + index0 * in_step * 4, 4);
+		return result;
+	}
+
+	__m128 sum = _mm_mul_ps(load_pixel(in + index0 * in_step * 4), _mm_set1_ps(fract0));
+	for (S32 u = index0 + 1; u < index1; u++)
+	{
+		sum = _mm_add_ps(sum, load_pixel(in + u * in_step * 4));
+	}
+	if (fract1 && index1 < in_len)
+	{
+		sum = _mm_add_ps(sum, _mm_mul_ps(load_pixel(in + index1 * in_step * 4), _mm_set1_ps(fract1)));
+	}
+	return round_pixel(_mm_mul_ps(sum, _mm_set1_ps(norm_factor)));
+}
+
+static void generate_mip_sse2(const U8* indata, U8* mipdata, S32 width, S32 height, S32 nchannels)
+{
+	if (nchannels != 4 && nchannels != 1)
+	{
+		LLImageKernels::getScalar().mGenerateMip(indata, mipdata, width, height, nchannels);
+		return;
+	}
+
+	llassert(width > 0 && height > 0);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i low_bytes = _mm_set1_epi16(0xff);
+	const S32 in_row = width * 2 * nchannels;
+	for (S32 h = 0; h < height; h++)
+	{
+		const U8* row0 = indata + h * 2 * in_row;
+		const U8* row1 = row0 + in_row;
+		U8* out = mipdata + h * width * nchannels;
+		S32 w = 0;
+		if (nchannels == 4)
+		{
+			// 4 input pixels to 2 output pixels
+			for (; w + 2 <= width; w += 2)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w * 8));
+				__m128i c = _mm_loadu_si128((const __m128i*)(row1 + w * 8));
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(c, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(c, zero));
+				__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+				sum = _mm_srli_epi16(sum, 2);
+				_mm_storel_epi64((__m128i*)(out + w * 4), _mm_packus_epi16(sum, sum));
+			}
+			for (; w < width; w++)
+			{
+				for (S32 i = 0; i < 4; i++)
+				{
+					out[w*4 + i] = (U8)(((U32)row0[w*8 + i] + row0[w*8 + 4 + i] + row1[w*8 + i] + row1[w*8 + 4 + i]) >> 2);
+				}
+			}
+		}
+		else
+		{
+			// 16 input pixels to 8 output pixels
+			for (; w + 8 <= width; w += 8)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(row0 + w * 2));
+				__m128i c = _mm_loadu_si128((const __m128i*)(row1 + w * 2));
+				__m128i sum = _mm_add_epi16(_mm_and_si128(a, low_bytes), _mm_srli_epi16(a, 8));
+				sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(c, low_bytes), _mm_srli_epi16(c, 8)));
+				sum = _mm_srli_epi16(sum, 2);
+				_mm_storel_epi64((__m128i*)(out + w), _mm_packus_epi16(sum, sum));
+			}
+			for (; w < width; w++)
+			{
+				out[w] = (U8)(((U32)row0[w*2] + row0[w*2 + 1] + row1[w*2] + row1[w*2 + 1]) >> 2);
+			}
+		}
+	}
+}
+
+static void scale_line_sse2(const U8* in, U8* out, S32 in_len, S32 out_len, S32 in_step, S32 out_step, S32 components)
+{
+	if (components != 4)
+	{
+		LLImageKernels::getScalar().mScaleLine(in, out, in_len, out_len, in_step, out_step, components);
+		return;
+	}
+
+	const F32 ratio = F32(in_len) / out_len;
+	const F32 norm_factor = 1.f / ratio;
+	for (S32 x = 0; x < out_len; x++)
+	{
+		S32 pixel = sample_pixel(in, x, ratio, norm_factor, in_len, in_step);
+		memcpy(out + x * out_step * 4, &pixel, 4);
+	}
+}
+
+static void composite_line_scaled_4onto3_sse2(const U8* in, U8* out, S32 in_len, S32 out_len)
+{
+	const F32 ratio = F32(in_len) / out_len;
+	const F32 norm_factor = 1.f / ratio;
+	const __m128i zero = _mm_setzero_si128();
+	for (S32 x = 0; x < out_len; x++, out += 3)
+	{
+		S32 pixel = sample_pixel(in, x, ratio, norm_factor, in_len, 1);
+		U8 alpha = U8((U32)pixel >> 24);
+		if (!alpha)
+		{
+			continue;
+		}
+		if (alpha == 255)
+		{
+			memcpy(out, &pixel, 3);
+			continue;
+		}
+		S32 dst = out[0] | (out[1] << 8) | (out[2] << 16);
+		__m128i r = blend(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pixel), zero),
+						  _mm_unpacklo_epi8(_mm_cvtsi32_si128(dst), zero));
+		dst = _mm_cvtsi128_si32(_mm_packus_epi16(r, r));
+		memcpy(out, &dst, 3);
+	}
+}
+
+static void copy_3onto4_sse2(const U8* in, U8* out, S32 pixels)
+{
+	const __m128i alpha = _mm_set1_epi32((S32)0xff000000);
+	S32 i = 0;
+	// Loads read 16 of the 12 bytes used, so stop while 16 are left.
+	for (; pixels - i >= 6; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i * 3));
+		_mm_storeu_si128((__m128i*)(out + i * 4), _mm_or_si128(expand_rgb(v), alpha));
+	}
+	LLImageKernels::getScalar().mCopy3onto4(in + i * 3, out + i * 4, pixels - i);
+}
+
+static void copy_4onto3_sse2(const U8* in, U8* out, S32 pixels)
+{
+	S32 i = 0;
+	for (; pixels - i >= 4; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + i * 4));
+		store_rgb(out + i * 3, pack_rgb(v));
+	}
+	LLImageKernels::getScalar().mCopy4onto3(in + i * 4, out + i * 3, pixels - i);
+}
+
+static void composite_4onto3_sse2(const U8* in, U8* out, S32 pixels)
+{
+	const __m128i zero = _mm_setzero_si128();
+	S32 i = 0;
+	// As copy_3onto4_sse2(), the loads from out read 4 bytes ahead.
+	for (; pixels - i >= 6; i += 4)
+	{
+		__m128i src = _mm_loadu_si128((const __m128i*)(in + i * 4));
+		__m128i dst = expand_rgb(_mm_loadu_si128((const __m128i*)(out + i * 3)));
+		__m128i lo = blend(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero));
+		__m128i hi = blend(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero));
+		store_rgb(out + i * 3, pack_rgb(_mm_packus_epi16(lo, hi)));
+	}
+	LLImageKernels::getScalar().mComposite4onto3(in + i * 4, out + i * 3, pixels - i);
+}
+
+static const LLImageKernels sSSE2Kernels =
+{
+	generate_mip_sse2,
+	scale_line_sse2,
+	composite_line_scaled_4onto3_sse2,
+	copy_3onto4_sse2,
+	copy_4onto3_sse2,
+	composite_4onto3_sse2,
+	"SSE2"
+};
+
+//static
+const LLImageKernels* LLImageKernels::getSSE2()
+{
+	return &sSSE2Kernels;
+}
+
+#else // LL_IMAGE_KERNELS_SSE2
+
+//static
+const LLImageKernels* LLImageKernels::getSSE2()
+{
+	return NULL;
+}
+
+#endif // LL_IMAGE_KERNELS_SSE2
@@ -28,6 +28,7 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "llthreadpool.h"
 
 //----------------------------------------------------------------------------
 
@@ -171,3 +172,135 @@ bool LLImageDecodeThread::ImageRequest::tut_isOK()
 {
 	return mResponder.notNull();
 }
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLImageEncodeThread::LLImageEncodeThread(U32 tile_threads, bool threaded)
+	: LLQueuedThread("imageencode", threaded)
+{
+	mCreationMutex = new LLMutex(getAPRPool());
+	mCompletionMutex = new LLMutex(getAPRPool());
+	// Unthreaded, the encodes run in update() and so do the tiles
+	mTilePool = new LLThreadPool("imageencodetiles", threaded ? tile_threads : 0);
+}
+
+// MAIN THREAD
+LLImageEncodeThread::~LLImageEncodeThread()
+{
+	// Stop the thread before the pool its request may be using goes away
+	shutdown();
+	delete mTilePool;
+	mTilePool = NULL;
+	mCreationList.clear();
+	mCompletionList.clear();
+	delete mCreationMutex;
+	delete mCompletionMutex;
+}
+
+// MAIN THREAD
+// virtual
+S32 LLImageEncodeThread::update(U32 max_time_ms)
+{
+	{
+		LLMutexLock lock(mCreationMutex);
+		for (creation_list_t::iterator iter = mCreationList.begin();
+			 iter != mCreationList.end(); ++iter)
+		{
+			creation_info& info = *iter;
+			EncodeRequest* req = new EncodeRequest(info.handle, this, info.raw, info.comment,
+												   info.reversible, info.preview, info.tile_size,
+												   info.responder);
+			bool res = addRequest(req);
+			if (!res)
+			{
+				llerrs << "request added after LLImageEncodeThread::shutdown()" << llendl;
+			}
+		}
+		mCreationList.clear();
+	}
+	S32 res = LLQueuedThread::update(max_time_ms);
+
+	completion_list_t completed;
+	{
+		LLMutexLock lock(mCompletionMutex);
+		completed.swap(mCompletionList);
+	}
+	for (completion_list_t::iterator iter = completed.begin();
+		 iter != completed.end(); ++iter)
+	{
+		iter->responder->completed(iter->success, iter->image);
+	}
+	return res;
+}
+
+LLImageEncodeThread::handle_t LLImageEncodeThread::encodeImage(LLImageRaw* raw, const std::string& comment,
+	BOOL reversible, BOOL preview, S32 tile_size, Responder* responder)
+{
+	LLMutexLock lock(mCreationMutex);
+	handle_t handle = generateHandle();
+	mCreationList.push_back(creation_info(handle, raw, comment, reversible, preview, tile_size, responder));
+	return handle;
+}
+
+void LLImageEncodeThread::addCompletion(bool success, LLImageJ2C* image, Responder* responder)
+{
+	LLMutexLock lock(mCompletionMutex);
+	mCompletionList.push_back(completion_info(success, image, responder));
+}
+
+LLImageEncodeThread::Responder::~Responder()
+{
+}
+
+//----------------------------------------------------------------------------
+
+LLImageEncodeThread::EncodeRequest::EncodeRequest(handle_t handle, LLImageEncodeThread* thread, LLImageRaw* raw,
+												  const std::string& comment, BOOL reversible, BOOL preview,
+												  S32 tile_size, LLImageEncodeThread::Responder* responder)
+	: LLQueuedThread::QueuedRequest(handle, LLQueuedThread::PRIORITY_NORMAL, FLAG_AUTO_COMPLETE),
+	  mThread(thread),
+	  mRawImage(raw),
+	  mComment(comment),
+	  mReversible(reversible),
+	  mPreview(preview),
+	  mTileSize(tile_size),
+	  mResponder(responder)
+{
+}
+
+LLImageEncodeThread::EncodeRequest::~EncodeRequest()
+{
+	mRawImage = NULL;
+	mEncodedImage = NULL;
+}
+
+// ENCODE THREAD
+bool LLImageEncodeThread::EncodeRequest::processRequest()
+{
+	if (mRawImage.isNull())
+	{
+		return true; // done (failed)
+	}
+	mEncodedImage = new LLImageJ2C;
+	mEncodedImage->setReversible(mReversible);
+	mEncodedImage->setPreviewQuality(mPreview);
+	mEncodedImage->setEncodeTiles(mTileSize, mThread->mTilePool);
+	if (!mEncodedImage->encode(mRawImage, mComment.c_str()))
+	{
+		mEncodedImage = NULL;
+	}
+	return true;
+}
+
+void LLImageEncodeThread::EncodeRequest::finishRequest(bool completed)
+{
+	// Passed to the main thread rather than called here
+	if (mResponder.notNull())
+	{
+		bool success = completed && mEncodedImage.notNull();
+		mThread->addCompletion(success, success ? mEncodedImage.get() : NULL, mResponder);
+	}
+	mRawImage = NULL;
+	// Will automatically be deleted
+}
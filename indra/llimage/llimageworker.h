@@ -28,9 +28,12 @@
 #define LL_LLIMAGEWORKER_H
 
 #include "llimage.h"
+#include "llimagej2c.h"
 #include "llpointer.h"
 #include "llworkerthread.h"
 
+class LLThreadPool;
+
 class LLImageDecodeThread : public LLQueuedThread
 {
 public:
@@ -99,4 +102,92 @@ private:
 	LLMutex* mCreationMutex;
 };
 
+// Encodes raw images to J2C off the main thread, splitting large images
+// into tiles that are encoded in parallel on a pool of tile_threads.
+class LLImageEncodeThread : public LLQueuedThread
+{
+public:
+	class Responder : public LLThreadSafeRefCount
+	{
+	protected:
+		virtual ~Responder();
+	public:
+		// Called on the main thread, from update(). image is NULL on failure.
+		virtual void completed(bool success, LLImageJ2C* image) = 0;
+	};
+
+	class EncodeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~EncodeRequest(); // use deleteRequest()
+
+	public:
+		EncodeRequest(handle_t handle, LLImageEncodeThread* thread, LLImageRaw* raw,
+					  const std::string& comment, BOOL reversible, BOOL preview, S32 tile_size,
+					  LLImageEncodeThread::Responder* responder);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+	private:
+		LLImageEncodeThread* mThread;
+		// input
+		LLPointer<LLImageRaw> mRawImage;
+		std::string mComment;
+		BOOL mReversible;
+		BOOL mPreview;
+		S32 mTileSize;
+		// output
+		LLPointer<LLImageJ2C> mEncodedImage;
+		LLPointer<LLImageEncodeThread::Responder> mResponder;
+	};
+
+public:
+	LLImageEncodeThread(U32 tile_threads, bool threaded = true);
+	~LLImageEncodeThread();
+
+	// raw must not change until the responder is called. A tile_size of 0
+	// encodes the image whole.
+	handle_t encodeImage(LLImageRaw* raw, const std::string& comment,
+						 BOOL reversible, BOOL preview, S32 tile_size,
+						 Responder* responder);
+	// Also calls the responders of finished encodes.
+	S32 update(U32 max_time_ms);
+
+private:
+	struct completion_info
+	{
+		bool success;
+		LLPointer<LLImageJ2C> image;
+		LLPointer<Responder> responder;
+		completion_info(bool s, LLImageJ2C* i, Responder* r)
+			: success(s), image(i), responder(r)
+		{}
+	};
+	typedef std::list<completion_info> completion_list_t;
+
+	void addCompletion(bool success, LLImageJ2C* image, Responder* responder);
+
+	struct creation_info
+	{
+		handle_t handle;
+		LLPointer<LLImageRaw> raw;
+		std::string comment;
+		BOOL reversible;
+		BOOL preview;
+		S32 tile_size;
+		LLPointer<Responder> responder;
+		creation_info(handle_t h, LLImageRaw* i, const std::string& c, BOOL rev, BOOL p, S32 t, Responder* r)
+			: handle(h), raw(i), comment(c), reversible(rev), preview(p), tile_size(t), responder(r)
+		{}
+	};
+	typedef std::list<creation_info> creation_list_t;
+
+	creation_list_t mCreationList;
+	LLMutex* mCreationMutex;
+	completion_list_t mCompletionList;
+	LLMutex* mCompletionMutex;
+	LLThreadPool* mTilePool;	// only used on the encode thread
+};
+
 #endif
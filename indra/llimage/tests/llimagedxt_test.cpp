@@ -0,0 +1,260 @@
+/**
+ * @file llimagedxt_test.cpp
+ * @brief DXT block compression and compressed cache record tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagedxt.h"
+#include "../llimage.h"
+#include "llpointer.h"
+
+#include "../test/lltut.h"
+
+#include <cmath>
+
+namespace
+{
+	// Smooth gradients with some detail, different in every channel, like
+	// the textures the cache holds.
+	LLPointer<LLImageRaw> make_image(S32 width, S32 height, S32 components)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		for (S32 y = 0; y < height; y++)
+		{
+			for (S32 x = 0; x < width; x++)
+			{
+				for (S32 c = 0; c < components; c++)
+				{
+					F32 wave = 20.f * sinf((x * (c + 1) + y * 2) * 0.05f);
+					S32 value = (x * 2 + y + 48 * c) + (S32) wave;
+					*data++ = (U8) llclamp(value, 0, 255);
+				}
+			}
+		}
+		return raw;
+	}
+
+	// Largest and mean absolute difference per channel value.
+	void compare(const U8* a, const U8* b, S32 size, S32& max_error, F32& mean_error)
+	{
+		max_error = 0;
+		F64 total = 0.0;
+		for (S32 i = 0; i < size; i++)
+		{
+			S32 error = abs((S32) a[i] - (S32) b[i]);
+			max_error = llmax(max_error, error);
+			total += error;
+		}
+		mean_error = (F32) (total / size);
+	}
+}
+
+namespace tut
+{
+	struct imagedxt_data
+	{
+		imagedxt_data()
+		{
+			LLImage::initClass();
+		}
+
+		~imagedxt_data()
+		{
+			LLImage::cleanupClass();
+		}
+
+		// A cache record's image as read back from disk.
+		LLPointer<LLImageDXT> readBack(const LLImageDXT* image, S32 size)
+		{
+			LLPointer<LLImageDXT> copy = new LLImageDXT();
+			U8* data = copy->allocateData(size);
+			memcpy(data, image->getData(), llmin(size, image->getDataSize()));	/* Flawfinder: ignore */
+			return copy;
+		}
+	};
+	typedef test_group<imagedxt_data> imagedxt_t;
+	typedef imagedxt_t::object imagedxt_object_t;
+	tut::imagedxt_t tut_imagedxt("LLImageDXT");
+
+	// Blocks decode to within the 5:6:5 endpoint and interpolation error
+	// of the source, and flat blocks come back almost exactly.
+	template<> template<>
+	void imagedxt_object_t::test<1>()
+	{
+		set_test_name("block round trip");
+
+		const S32 SIZE = 32;
+		LLPointer<LLImageRaw> rgb = make_image(SIZE, SIZE, 3);
+		std::vector<U8> blocks(LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXT1, SIZE, SIZE));
+		std::vector<U8> decoded(SIZE * SIZE * 3);
+		LLImageDXT::compressBlocks(LLImageDXT::FORMAT_DXT1, rgb->getData(), SIZE, SIZE, 3, &blocks[0]);
+		LLImageDXT::decompressBlocks(LLImageDXT::FORMAT_DXT1, &blocks[0], SIZE, SIZE, 3, &decoded[0]);
+		S32 max_error;
+		F32 mean_error;
+		compare(rgb->getData(), &decoded[0], rgb->getDataSize(), max_error, mean_error);
+		ensure("DXT1 max error", max_error <= 16);
+		ensure("DXT1 mean error", mean_error <= 4.f);
+
+		LLPointer<LLImageRaw> rgba = make_image(SIZE, SIZE, 4);
+		blocks.resize(LLImageDXT::formatBytes(LLImageDXT::FORMAT_DXT5, SIZE, SIZE));
+		decoded.resize(SIZE * SIZE * 4);
+		LLImageDXT::compressBlocks(LLImageDXT::FORMAT_DXT5, rgba->getData(), SIZE, SIZE, 4, &blocks[0]);
+		LLImageDXT::decompressBlocks(LLImageDXT::FORMAT_DXT5, &blocks[0], SIZE, SIZE, 4, &decoded[0]);
+		compare(rgba->getData(), &decoded[0], rgba->getDataSize(), max_error, mean_error);
+		ensure("DXT5 max error", max_error <= 16);
+		ensure("DXT5 mean error", mean_error <= 4.f);
+		S32 alpha_error = 0;
+		for (S32 i = 3; i < rgba->getDataSize(); i += 4)
+		{
+			alpha_error = llmax(alpha_error, abs((S32) rgba->getData()[i] - (S32) decoded[i]));
+		}
+		// eight alpha steps between the block's own extremes
+		ensure("DXT5 alpha error", alpha_error <= 4);
+
+		// a flat block only loses the bits 5:6:5 can't hold
+		U8 flat[4 * 4 * 3];
+		for (S32 i = 0; i < 16; i++)
+		{
+			flat[i * 3] = 200;
+			flat[i * 3 + 1] = 100;
+			flat[i * 3 + 2] = 50;
+		}
+		U8 flat_block[8];
+		U8 flat_decoded[4 * 4 * 3];
+		LLImageDXT::compressBlocks(LLImageDXT::FORMAT_DXT1, flat, 4, 4, 3, flat_block);
+		LLImageDXT::decompressBlocks(LLImageDXT::FORMAT_DXT1, flat_block, 4, 4, 3, flat_decoded);
+		compare(flat, flat_decoded, sizeof(flat), max_error, mean_error);
+		ensure("flat block", max_error <= 4);
+	}
+
+	// compress() builds the whole mip chain, and each mip decodes close to
+	// the box filtered source.
+	template<> template<>
+	void imagedxt_object_t::test<2>()
+	{
+		set_test_name("compress");
+
+		LLPointer<LLImageRaw> raw = make_image(64, 32, 4);
+		LLPointer<LLImageDXT> dxt = new LLImageDXT();
+		ensure("compressed", dxt->compress(raw));
+		ensure_equals("format", dxt->getFileFormat(), LLImageDXT::FORMAT_DXR5);
+		ensure_equals("width", (S32) dxt->getWidth(), 64);
+		ensure_equals("height", (S32) dxt->getHeight(), 32);
+
+		LLPointer<LLImageRaw> decoded;
+		ensure("decompressed", dxt->decompressMip(0, decoded));
+		S32 max_error;
+		F32 mean_error;
+		compare(raw->getData(), decoded->getData(), raw->getDataSize(), max_error, mean_error);
+		ensure("top mip max error", max_error <= 16);
+		ensure("top mip mean error", mean_error <= 4.f);
+
+		LLPointer<LLImageRaw> half = new LLImageRaw(32, 16, 4);
+		LLImageBase::generateMip(raw->getData(), half->getData(), 32, 16, 4);
+		ensure("second mip", dxt->decompressMip(1, decoded));
+		ensure_equals("second mip width", (S32) decoded->getWidth(), 32);
+		compare(half->getData(), decoded->getData(), half->getDataSize(), max_error, mean_error);
+		ensure("second mip mean error", mean_error <= 4.f);
+
+		// only power of two RGB and RGBA images are compressed
+		LLPointer<LLImageDXT> bad = new LLImageDXT();
+		ensure("odd size", !bad->compress(make_image(48, 32, 3)));
+		ensure("luminance", !bad->compress(make_image(32, 32, 1)));
+	}
+
+	// Records written with initCacheHeader() are accepted; anything from
+	// another version or not a record at all is not.
+	template<> template<>
+	void imagedxt_object_t::test<3>()
+	{
+		set_test_name("cache header");
+
+		const S32 data_size = 1024;
+		LLImageDXT::cache_header_t header;
+		LLImageDXT::initCacheHeader(header, 2);
+		ensure("valid", LLImageDXT::checkCacheHeader(header, data_size));
+		ensure("no image after it", !LLImageDXT::checkCacheHeader(header, sizeof(LLImageDXT::dxtfile_header_t)));
+
+		LLImageDXT::cache_header_t bad = header;
+		bad.magic ^= 1;
+		ensure("magic", !LLImageDXT::checkCacheHeader(bad, data_size));
+		bad = header;
+		bad.version++;
+		ensure("version", !LLImageDXT::checkCacheHeader(bad, data_size));
+		bad = header;
+		bad.discard = -1;
+		ensure("negative discard", !LLImageDXT::checkCacheHeader(bad, data_size));
+		bad.discard = MAX_DISCARD_LEVEL + 1;
+		ensure("discard too high", !LLImageDXT::checkCacheHeader(bad, data_size));
+	}
+
+	// The image after the header is only used when it is a whole mip chain
+	// from compress(), so a truncated or corrupted file is dropped rather
+	// than uploaded.
+	template<> template<>
+	void imagedxt_object_t::test<4>()
+	{
+		set_test_name("cache image");
+
+		LLPointer<LLImageDXT> dxt = new LLImageDXT();
+		ensure("compressed", dxt->compress(make_image(64, 64, 3)));
+		S32 size = dxt->getDataSize();
+
+		LLPointer<LLImageDXT> copy = readBack(dxt, size);
+		ensure("whole image", copy->updateCacheData());
+		ensure_equals("read format", copy->getFileFormat(), LLImageDXT::FORMAT_DXR1);
+		ensure_equals("read width", (S32) copy->getWidth(), 64);
+
+		copy->discardMips(2);
+		LLPointer<LLImageDXT> trimmed = readBack(copy, copy->getDataSize());
+		ensure("trimmed image", trimmed->updateCacheData());
+		ensure_equals("trimmed width", (S32) trimmed->getWidth(), 16);
+
+		ensure("truncated", !readBack(dxt, size - 8)->updateCacheData());
+		ensure("too long", !readBack(dxt, size + 8)->updateCacheData());
+		ensure("header only", !readBack(dxt, sizeof(LLImageDXT::dxtfile_header_t) - 4)->updateCacheData());
+
+		LLPointer<LLImageDXT> bad = readBack(dxt, size);
+		LLImageDXT::dxtfile_header_t* header = (LLImageDXT::dxtfile_header_t*) bad->getData();
+		header->pixel_fmt.fourcc = LLImageDXT::getFourCC(LLImageDXT::FORMAT_DXT1);
+		ensure("old format", !bad->updateCacheData());
+
+		bad = readBack(dxt, size);
+		header = (LLImageDXT::dxtfile_header_t*) bad->getData();
+		header->maxwidth = 48;
+		ensure("odd width", !bad->updateCacheData());
+
+		bad = readBack(dxt, size);
+		header = (LLImageDXT::dxtfile_header_t*) bad->getData();
+		header->maxwidth = 1 << 30;
+		ensure("huge width", !bad->updateCacheData());
+
+		bad = readBack(dxt, size);
+		header = (LLImageDXT::dxtfile_header_t*) bad->getData();
+		header->num_mips--;
+		ensure("mip count", !bad->updateCacheData());
+	}
+}
@@ -0,0 +1,203 @@
+/**
+ * @file llimagej2c_test.cpp
+ * @brief Round trip tests for tiled JPEG2000 encoding
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagej2c.h"
+#include "../llimage.h"
+#include "llpointer.h"
+#include "llthreadpool.h"
+
+#include "../test/lltut.h"
+
+#include <cmath>
+
+namespace
+{
+	const S32 TILE_SIZE = 256;
+
+	// A texture-like image: smooth gradients with some detail, different
+	// in every channel so swapped tiles or channels show up.
+	LLPointer<LLImageRaw> make_image(S32 width, S32 height, S32 components)
+	{
+		LLPointer<LLImageRaw> raw = new LLImageRaw(width, height, components);
+		U8* data = raw->getData();
+		for (S32 y = 0; y < height; y++)
+		{
+			for (S32 x = 0; x < width; x++)
+			{
+				for (S32 c = 0; c < components; c++)
+				{
+					F32 wave = 40.f * sinf((x * (c + 1) + y * 2) * 0.02f);
+					S32 value = (x + 2 * y + 64 * c) / 4 + (S32) wave;
+					*data++ = (U8) llclamp(value, 0, 255);
+				}
+			}
+		}
+		return raw;
+	}
+
+	// Mean absolute difference per channel value, or -1 if the images
+	// differ in size.
+	F32 mean_error(const LLImageRaw* a, const LLImageRaw* b)
+	{
+		if (a->getWidth() != b->getWidth() || a->getHeight() != b->getHeight()
+			|| a->getComponents() != b->getComponents())
+		{
+			return -1.f;
+		}
+		S32 size = a->getDataSize();
+		const U8* ap = a->getData();
+		const U8* bp = b->getData();
+		F64 total = 0.0;
+		for (S32 i = 0; i < size; i++)
+		{
+			total += llabs((S32) ap[i] - (S32) bp[i]);
+		}
+		return (F32) (total / size);
+	}
+
+	U32 read_u32(const U8* p)
+	{
+		return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	}
+
+	// Tile width from the SIZ marker segment, which follows SOC.
+	U32 codestream_tile_width(const LLImageJ2C* j2c)
+	{
+		return read_u32(j2c->getData() + 24);
+	}
+}
+
+namespace tut
+{
+	struct imagej2c_data
+	{
+		imagej2c_data()
+		:	mPool("imagej2ctest", 2)
+		{
+			LLImage::initClass();
+		}
+
+		~imagej2c_data()
+		{
+			LLImage::cleanupClass();
+		}
+
+		// Encodes raw with the given settings and decodes it again.
+		LLPointer<LLImageRaw> roundTrip(const LLImageRaw* raw, LLImageJ2C* j2c)
+		{
+			ensure("encoded", j2c->encode(raw, 0.f));
+			ensure_equals("encoded width", j2c->getWidth(), raw->getWidth());
+			ensure_equals("encoded height", j2c->getHeight(), raw->getHeight());
+
+			LLPointer<LLImageRaw> decoded = new LLImageRaw();
+			ensure("decoded", j2c->decode(decoded, 0.f) && decoded->getData());
+			return decoded;
+		}
+
+		LLThreadPool mPool;
+	};
+	typedef test_group<imagej2c_data> imagej2c_t;
+	typedef imagej2c_t::object imagej2c_object_t;
+	tut::imagej2c_t tut_imagej2c("LLImageJ2C");
+
+	// Lossless tiles put back together give the source image exactly.
+	template<> template<>
+	void imagej2c_object_t::test<1>()
+	{
+		set_test_name("reversible tiled round trip");
+
+		LLPointer<LLImageRaw> raw = make_image(2 * TILE_SIZE, 3 * TILE_SIZE, 3);
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+		j2c->setReversible(TRUE);
+		j2c->setEncodeTiles(TILE_SIZE, &mPool);
+
+		LLPointer<LLImageRaw> decoded = roundTrip(raw, j2c);
+		ensure_equals("tiled", codestream_tile_width(j2c), (U32) TILE_SIZE);
+		ensure_equals("identical", mean_error(raw, decoded), 0.f);
+	}
+
+	// Lossy tiles decode as close to the source as the untiled encode does,
+	// alpha included.
+	template<> template<>
+	void imagej2c_object_t::test<2>()
+	{
+		set_test_name("lossy tiled round trip");
+
+		LLPointer<LLImageRaw> raw = make_image(2 * TILE_SIZE, 2 * TILE_SIZE, 4);
+
+		LLPointer<LLImageJ2C> whole = new LLImageJ2C();
+		LLPointer<LLImageRaw> whole_decoded = roundTrip(raw, whole);
+		ensure_equals("not tiled", codestream_tile_width(whole), (U32) (2 * TILE_SIZE));
+		F32 whole_error = mean_error(raw, whole_decoded);
+
+		LLPointer<LLImageJ2C> tiled = new LLImageJ2C();
+		tiled->setEncodeTiles(TILE_SIZE, &mPool);
+		LLPointer<LLImageRaw> tiled_decoded = roundTrip(raw, tiled);
+		ensure_equals("tiled", codestream_tile_width(tiled), (U32) TILE_SIZE);
+		F32 tiled_error = mean_error(raw, tiled_decoded);
+
+		ensure("same size", whole_error >= 0.f && tiled_error >= 0.f);
+		ensure("close to the source", tiled_error < 4.f);
+		// tile edges cost a little, swapped or misplaced tiles a lot
+		ensure("close to the untiled encode", tiled_error < whole_error * 1.5f + 0.5f);
+	}
+
+	// The preview settings used for interim avatar bakes round trip tiled too.
+	template<> template<>
+	void imagej2c_object_t::test<3>()
+	{
+		set_test_name("preview tiled round trip");
+
+		LLPointer<LLImageRaw> raw = make_image(2 * TILE_SIZE, 2 * TILE_SIZE, 3);
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+		j2c->setPreviewQuality(TRUE);
+		j2c->setEncodeTiles(TILE_SIZE, &mPool);
+
+		LLPointer<LLImageRaw> decoded = roundTrip(raw, j2c);
+		ensure_equals("tiled", codestream_tile_width(j2c), (U32) TILE_SIZE);
+		F32 error = mean_error(raw, decoded);
+		ensure("same size", error >= 0.f);
+		ensure("close to the source", error < 8.f);
+	}
+
+	// Sizes the tiles don't divide are encoded whole.
+	template<> template<>
+	void imagej2c_object_t::test<4>()
+	{
+		set_test_name("untileable size");
+
+		LLPointer<LLImageRaw> raw = make_image(TILE_SIZE + 64, TILE_SIZE, 3);
+		LLPointer<LLImageJ2C> j2c = new LLImageJ2C();
+		j2c->setReversible(TRUE);
+		j2c->setEncodeTiles(TILE_SIZE, &mPool);
+
+		LLPointer<LLImageRaw> decoded = roundTrip(raw, j2c);
+		ensure_equals("not tiled", codestream_tile_width(j2c), (U32) (TILE_SIZE + 64));
+		ensure_equals("identical", mean_error(raw, decoded), 0.f);
+	}
+}
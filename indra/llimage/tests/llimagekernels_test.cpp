@@ -0,0 +1,288 @@
+/**
+ * @file llimagekernels_test.cpp
+ * @brief Golden image tests and timings for the image kernels
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llimagekernels.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace
+{
+	typedef std::vector<U8> image_t;
+
+	// Same noise on every run and platform.
+	image_t noise(S32 size, U32 seed)
+	{
+		image_t image(size);
+		for (S32 i = 0; i < size; i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			image[i] = U8(seed >> 24);
+		}
+		return image;
+	}
+
+	// Alpha at 0, 255 and in between, which the kernels treat differently.
+	image_t noise_rgba(S32 pixels, U32 seed)
+	{
+		image_t image = noise(pixels * 4, seed);
+		for (S32 i = 0; i < pixels; i++)
+		{
+			switch (i % 4)
+			{
+			  case 0: image[i*4 + 3] = 0; break;
+			  case 1: image[i*4 + 3] = 255; break;
+			  default: break;
+			}
+		}
+		return image;
+	}
+
+	S32 max_difference(const image_t& a, const image_t& b)
+	{
+		S32 diff = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			diff = llmax(diff, abs((S32)a[i] - (S32)b[i]));
+		}
+		return diff;
+	}
+}
+
+namespace tut
+{
+	struct imagekernels
+	{
+		imagekernels()
+		:	mScalar(LLImageKernels::getScalar()),
+			mSSE2(LLImageKernels::getSSE2())
+		{
+		}
+
+		const LLImageKernels& mScalar;
+		const LLImageKernels* mSSE2;
+
+		// Both tables on the same input, with sizes that leave a scalar tail.
+		void compareMips(const LLImageKernels& kernels, S32 components)
+		{
+			for (S32 width = 1; width < 20; width += 3)
+			{
+				S32 height = 3;
+				image_t in = noise(width * height * 4 * components, width);
+				image_t expected(width * height * components);
+				image_t out(width * height * components);
+				mScalar.mGenerateMip(&in[0], &expected[0], width, height, components);
+				kernels.mGenerateMip(&in[0], &out[0], width, height, components);
+				ensure("mip matches", out == expected);
+			}
+		}
+
+		void compareScale(const LLImageKernels& kernels, S32 in_len, S32 out_len)
+		{
+			image_t in = noise(in_len * 4, in_len);
+			image_t expected(out_len * 4);
+			image_t out(out_len * 4);
+			mScalar.mScaleLine(&in[0], &expected[0], in_len, out_len, 1, 1, 4);
+			kernels.mScaleLine(&in[0], &out[0], in_len, out_len, 1, 1, 4);
+			// Equal when the scalar code does its float math with SSE, as
+			// all 64 bit builds do; x87 may round the sums differently.
+			ensure("scaled line close", max_difference(out, expected) <= 1);
+
+			in = noise_rgba(in_len, out_len);
+			expected = noise(out_len * 3, in_len);
+			out = expected;
+			mScalar.mCompositeLineScaled4onto3(&in[0], &expected[0], in_len, out_len);
+			kernels.mCompositeLineScaled4onto3(&in[0], &out[0], in_len, out_len);
+			ensure("composited line close", max_difference(out, expected) <= 1);
+		}
+
+		void compareSwizzles(const LLImageKernels& kernels, S32 pixels)
+		{
+			image_t rgb = noise(pixels * 3, pixels);
+			image_t rgba = noise_rgba(pixels, pixels + 1);
+
+			image_t expected(pixels * 4);
+			image_t out(pixels * 4);
+			mScalar.mCopy3onto4(&rgb[0], &expected[0], pixels);
+			kernels.mCopy3onto4(&rgb[0], &out[0], pixels);
+			ensure("RGB to RGBA matches", out == expected);
+
+			expected.resize(pixels * 3);
+			out.resize(pixels * 3);
+			mScalar.mCopy4onto3(&rgba[0], &expected[0], pixels);
+			kernels.mCopy4onto3(&rgba[0], &out[0], pixels);
+			ensure("RGBA to RGB matches", out == expected);
+
+			expected = rgb;
+			out = rgb;
+			mScalar.mComposite4onto3(&rgba[0], &expected[0], pixels);
+			kernels.mComposite4onto3(&rgba[0], &out[0], pixels);
+			ensure("composite matches", out == expected);
+		}
+	};
+	typedef test_group<imagekernels> imagekernels_t;
+	typedef imagekernels_t::object imagekernels_object_t;
+	tut::imagekernels_t tut_imagekernels("LLImageKernels");
+
+	template<> template<>
+	void imagekernels_object_t::test<1>()
+	{
+		set_test_name("scalar kernels against golden images");
+
+		// 4x2 RGBA to a 2x1 mip
+		const U8 rgba[] =
+		{
+			0, 10, 20, 255,		4, 14, 24, 255,		100, 0, 0, 0,		101, 1, 1, 1,
+			8, 18, 28, 255,		12, 22, 32, 255,	102, 2, 2, 2,		103, 3, 3, 3
+		};
+		const U8 rgba_mip[] = { 6, 16, 26, 255,		101, 1, 1, 1 };
+		U8 mip[8];
+		mScalar.mGenerateMip(rgba, mip, 2, 1, 4);
+		ensure("RGBA mip", memcmp(mip, rgba_mip, sizeof(mip)) == 0);
+
+		// 4x2 grey to a 2x1 mip
+		const U8 grey[] = { 0, 4, 255, 255,		8, 12, 255, 254 };
+		const U8 grey_mip[] = { 6, 254 };
+		mScalar.mGenerateMip(grey, mip, 2, 1, 1);
+		ensure("grey mip", memcmp(mip, grey_mip, sizeof(grey_mip)) == 0);
+
+		// Halving a line averages pairs, doubling it repeats pixels
+		const U8 line[] = { 0, 0, 0, 0,		100, 50, 20, 255,	200, 200, 200, 200,		255, 255, 255, 255 };
+		const U8 halved[] = { 50, 25, 10, 128,		228, 228, 228, 228 };
+		U8 out[32];
+		mScalar.mScaleLine(line, out, 4, 2, 1, 1, 4);
+		ensure("halved line", memcmp(out, halved, sizeof(halved)) == 0);
+		mScalar.mScaleLine(line, out, 4, 8, 1, 1, 4);
+		ensure("doubled line", memcmp(out, line, 4) == 0 && memcmp(out + 4, line, 4) == 0
+							   && memcmp(out + 24, line + 12, 4) == 0 && memcmp(out + 28, line + 12, 4) == 0);
+
+		// Swizzles
+		const U8 rgb[] = { 1, 2, 3,		4, 5, 6 };
+		const U8 rgb_to_rgba[] = { 1, 2, 3, 255,	4, 5, 6, 255 };
+		mScalar.mCopy3onto4(rgb, out, 2);
+		ensure("RGB to RGBA", memcmp(out, rgb_to_rgba, sizeof(rgb_to_rgba)) == 0);
+		mScalar.mCopy4onto3(rgba, out, 2);
+		ensure("RGBA to RGB", memcmp(out, rgba, 3) == 0 && memcmp(out + 3, rgba + 4, 3) == 0);
+
+		// Transparent, opaque and half transparent white over grey
+		const U8 over[] = { 255, 255, 255, 0,	255, 255, 255, 255,		255, 255, 255, 128 };
+		U8 under[] = { 100, 100, 100,	100, 100, 100,		100, 100, 100 };
+		const U8 composited[] = { 100, 100, 100,	255, 255, 255,		178, 178, 178 };
+		mScalar.mComposite4onto3(over, under, 3);
+		ensure("composite", memcmp(under, composited, sizeof(composited)) == 0);
+
+		// Doubling while compositing keeps the colors of the source
+		U8 row[] = { 0, 0, 0,	0, 0, 0,	0, 0, 0,	0, 0, 0 };
+		const U8 source[] = { 10, 20, 30, 255,		40, 50, 60, 255 };
+		const U8 doubled[] = { 10, 20, 30,	10, 20, 30,		40, 50, 60,		40, 50, 60 };
+		mScalar.mCompositeLineScaled4onto3(source, row, 2, 4);
+		ensure("doubled composite", memcmp(row, doubled, sizeof(doubled)) == 0);
+	}
+
+	template<> template<>
+	void imagekernels_object_t::test<2>()
+	{
+		set_test_name("SSE2 kernels match the scalar ones");
+		if (!mSSE2)
+		{
+			return;	// built without the SSE2 kernels
+		}
+
+		for (S32 components = 1; components <= 4; components++)
+		{
+			compareMips(*mSSE2, components);
+		}
+		compareScale(*mSSE2, 512, 256);
+		compareScale(*mSSE2, 512, 37);
+		compareScale(*mSSE2, 37, 512);
+		compareScale(*mSSE2, 100, 100);
+		for (S32 pixels = 1; pixels < 40; pixels++)
+		{
+			compareSwizzles(*mSSE2, pixels);
+		}
+	}
+
+	template<> template<>
+	void imagekernels_object_t::test<3>()
+	{
+		set_test_name("image kernel benchmark");
+		const S32 SIZE = 512;
+		const S32 RUNS = 20;
+		const S32 PIXELS = SIZE * SIZE;
+		image_t rgba = noise_rgba(PIXELS, 1);
+		image_t rgb = noise(PIXELS * 3, 2);
+		image_t out(PIXELS * 4);
+
+		const LLImageKernels* tables[] = { &mScalar, mSSE2 };
+		for (S32 t = 0; t < 2; t++)
+		{
+			const LLImageKernels* kernels = tables[t];
+			if (!kernels)
+			{
+				continue;
+			}
+
+			LLTimer timer;
+			for (S32 i = 0; i < RUNS; i++)
+			{
+				kernels->mGenerateMip(&rgba[0], &out[0], SIZE/2, SIZE/2, 4);
+			}
+			F64 mip_time = timer.getElapsedTimeAndResetF64();
+
+			for (S32 i = 0; i < RUNS; i++)
+			{
+				for (S32 row = 0; row < SIZE/4; row++)
+				{
+					kernels->mScaleLine(&rgba[row * SIZE * 4], &out[row * SIZE], SIZE, SIZE/4, 1, 1, 4);
+				}
+			}
+			F64 scale_time = timer.getElapsedTimeAndResetF64();
+
+			for (S32 i = 0; i < RUNS; i++)
+			{
+				kernels->mCopy3onto4(&rgb[0], &out[0], PIXELS);
+				kernels->mCopy4onto3(&rgba[0], &out[0], PIXELS);
+			}
+			F64 swizzle_time = timer.getElapsedTimeAndResetF64();
+
+			for (S32 i = 0; i < RUNS; i++)
+			{
+				kernels->mComposite4onto3(&rgba[0], &rgb[0], PIXELS);
+			}
+			F64 composite_time = timer.getElapsedTimeAndResetF64();
+
+			llinfos << kernels->mName << " kernels on " << SIZE << "x" << SIZE
+					<< ": mip " << mip_time*1000.0/RUNS
+					<< " ms, scale " << scale_time*1000.0/RUNS
+					<< " ms, swizzles " << swizzle_time*1000.0/RUNS
+					<< " ms, composite " << composite_time*1000.0/RUNS << " ms" << llendl;
+		}
+	}
+}
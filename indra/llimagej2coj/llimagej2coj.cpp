@@ -30,6 +30,7 @@
 // this is defined so that we get static linking.
 #include "openjpeg.h"
 
+#include "llthreadpool.h"
 #include "lltimer.h"
 //#include "llmemory.h"
 
@@ -91,14 +92,163 @@ void info_callback(const char* msg, void*)
 }
 
 
+// Returns the length of the main header, from the SOC marker up to the
+// first SOT marker, or 0 if it isn't all there.
+static S32 main_header_length(const U8* data, S32 size)
+{
+	if (size < 2 || data[0] != 0xff || data[1] != 0x4f)
+	{
+		return 0;
+	}
+	S32 pos = 2;
+	while (pos + 4 <= size)
+	{
+		if (data[pos] != 0xff)
+		{
+			return 0;
+		}
+		if (data[pos + 1] == 0x90)
+		{
+			return pos;
+		}
+		pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+	}
+	return 0;
+}
+
+// Copies channels first_channel on of interleaved src pixels to dst.
+static void copy_channels(const U8* src, S32 src_components, S32 first_channel,
+						  U8* dst, S32 channels, S32 pixels)
+{
+	src += first_channel;
+	for (S32 i = 0; i < pixels; i++)
+	{
+		for (S32 c = 0; c < channels; c++)
+		{
+			dst[c] = src[c];
+		}
+		dst += channels;
+		src += src_components;
+	}
+}
+
+LLImageJ2COJ::kept_list_t LLImageJ2COJ::sKeptList;
+S32 LLImageJ2COJ::sKeptBytes = 0;
+
 LLImageJ2COJ::LLImageJ2COJ()
-	: LLImageJ2CImpl()
+	: LLImageJ2CImpl(),
+	mHeaderWidth(0),
+	mHeaderHeight(0),
+	mHeaderComponents(0),
+	mKeptWidth(0),
+	mKeptHeight(0),
+	mKeptComponents(0),
+	mKeptDiscard(-1),
+	mKeptDataSize(0),
+	mKeptDataHash(0)
 {
 }
 
 
 LLImageJ2COJ::~LLImageJ2COJ()
 {
+	if (sMutex)
+	{
+		LLMutexLock lock(sMutex);
+		releaseDecode();
+	}
+}
+
+//static
+U32 LLImageJ2COJ::hashData(LLImageJ2C &base)
+{
+	// The fetcher only ever appends to the codestream, so the size and
+	// both ends of it are enough to tell a changed one.
+	const S32 SAMPLE_BYTES = 256;
+	const U8* data = base.getData();
+	S32 size = base.getDataSize();
+	S32 head = llmin(size, SAMPLE_BYTES);
+	S32 tail = llmax(head, size - SAMPLE_BYTES);
+
+	U32 hash = 2166136261U;
+	for (S32 i = 0; i < head; i++)
+	{
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+	for (S32 i = tail; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+	return hash;
+}
+
+BOOL LLImageJ2COJ::reuseDecode(LLImageJ2C &base, LLImageRaw &raw_image, S32 first_channel, S32 max_channel_count)
+{
+	if (!sMutex)
+	{
+		return FALSE;
+	}
+	LLMutexLock lock(sMutex);
+	if (mKeptDiscard != base.getRawDiscardLevel() ||
+		mKeptDataSize != base.getDataSize() ||
+		mKeptComponents <= first_channel ||
+		mKeptDataHash != hashData(base))
+	{
+		return FALSE;
+	}
+
+	// most recently used
+	sKeptList.splice(sKeptList.begin(), sKeptList, mKeptIter);
+
+	S32 channels = llmin(mKeptComponents - first_channel, max_channel_count);
+	raw_image.resize(mKeptWidth, mKeptHeight, channels);
+	copy_channels(&mKeptPixels[0], mKeptComponents, first_channel,
+				  raw_image.getData(), channels, mKeptWidth * mKeptHeight);
+	return TRUE;
+}
+
+void LLImageJ2COJ::keepDecode(LLImageJ2C &base, std::vector<U8>& pixels, S32 width, S32 height, S32 components)
+{
+	if (!sMutex)
+	{
+		return;
+	}
+	LLMutexLock lock(sMutex);
+	releaseDecode();
+
+	S32 bytes = (S32)pixels.size();
+	if (bytes > MAX_KEPT_DECODE_BYTES / 4)
+	{
+		return; // would push out too many others
+	}
+
+	mKeptPixels.swap(pixels);
+	mKeptWidth = width;
+	mKeptHeight = height;
+	mKeptComponents = components;
+	mKeptDiscard = base.getRawDiscardLevel();
+	mKeptDataSize = base.getDataSize();
+	mKeptDataHash = hashData(base);
+	sKeptList.push_front(this);
+	mKeptIter = sKeptList.begin();
+	sKeptBytes += bytes;
+
+	while (sKeptBytes > MAX_KEPT_DECODE_BYTES)
+	{
+		sKeptList.back()->releaseDecode();
+	}
+}
+
+void LLImageJ2COJ::releaseDecode()
+{
+	if (mKeptDiscard < 0)
+	{
+		return;
+	}
+	sKeptBytes -= (S32)mKeptPixels.size();
+	sKeptList.erase(mKeptIter);
+	std::vector<U8>().swap(mKeptPixels);
+	mKeptDiscard = -1;
 }
 
 
@@ -110,6 +260,12 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 
 	LLTimer decode_timer;
 
+	if (reuseDecode(base, raw_image, first_channel, max_channel_count))
+	{
+		base.mDecodeReused = TRUE;
+		return TRUE; // done
+	}
+
 	opj_dparameters_t parameters;	/* decompression parameters */
 	opj_event_mgr_t event_mgr;		/* event manager */
 	opj_image_t *image = NULL;
@@ -216,6 +372,35 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 	raw_image.resize(width, height, channels);
 	U8 *rawp = raw_image.getData();
 
+	// Keep every channel, so that decoding the aux channel or the same data
+	// again is only a copy.
+	BOOL keep = sMutex != NULL;
+	for (S32 comp = 0; comp < img_components; comp++)
+	{
+		keep = keep && image->comps[comp].data != NULL;
+	}
+	if (keep)
+	{
+		std::vector<U8> pixels(width * height * img_components);
+		for (S32 comp = 0; comp < img_components; comp++)
+		{
+			S32 offset = comp;
+			for (S32 y = (height - 1); y >= 0; y--)
+			{
+				for (S32 x = 0; x < width; x++)
+				{
+					pixels[offset] = image->comps[comp].data[y*comp_width + x];
+					offset += img_components;
+				}
+			}
+		}
+		opj_image_destroy(image);
+
+		copy_channels(&pixels[0], img_components, first_channel, rawp, channels, width * height);
+		keepDecode(base, pixels, width, height, img_components);
+		return TRUE; // done
+	}
+
 	// first_channel is what channel to start copying from
 	// dest is what channel to copy to.  first_channel comes from the
 	// argument, dest always starts writing at channel zero.
@@ -250,13 +435,15 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 }
 
 
-BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, const char* comment_text, F32 encode_time, BOOL reversible)
+// Encodes the width by height region of raw_image at x0, y0, counted from
+// the top row down like the codestream, into a codestream of its own.
+static bool encode_region(const opj_cparameters_t& default_parameters, const LLImageRaw& raw_image,
+						  S32 x0, S32 y0, S32 width, S32 height, std::vector<U8>& codestream)
 {
 	const S32 MAX_COMPS = 5;
-	opj_cparameters_t parameters;	/* compression parameters */
+	opj_cparameters_t parameters = default_parameters;
 	opj_event_mgr_t event_mgr;		/* event manager */
 
-
 	/* 
 	configure the event callbacks (not required)
 	setting of each callback is optional 
@@ -266,41 +453,6 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 	event_mgr.warning_handler = warning_callback;
 	event_mgr.info_handler = info_callback;
 
-	/* set encoding parameters to default values */
-	opj_set_default_encoder_parameters(&parameters);
-	parameters.cod_format = 0;
-	parameters.cp_disto_alloc = 1;
-
-	if (reversible)
-	{
-		parameters.tcp_numlayers = 1;
-		parameters.tcp_rates[0] = 0.0f;
-	}
-	else
-	{
-		parameters.tcp_numlayers = 5;
-                parameters.tcp_rates[0] = 1920.0f;
-                parameters.tcp_rates[1] = 480.0f;
-                parameters.tcp_rates[2] = 120.0f;
-                parameters.tcp_rates[3] = 30.0f;
-		parameters.tcp_rates[4] = 10.0f;
-		parameters.irreversible = 1;
-		if (raw_image.getComponents() >= 3)
-		{
-			parameters.tcp_mct = 1;
-		}
-	}
-
-	if (!comment_text)
-	{
-		parameters.cp_comment = (char *) "";
-	}
-	else
-	{
-		// Awful hacky cast, too lazy to copy right now.
-		parameters.cp_comment = (char *) comment_text;
-	}
-
 	//
 	// Fill in the source image from our raw image
 	//
@@ -308,8 +460,8 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 	opj_image_cmptparm_t cmptparm[MAX_COMPS];
 	opj_image_t * image = NULL;
 	S32 numcomps = raw_image.getComponents();
-	S32 width = raw_image.getWidth();
-	S32 height = raw_image.getHeight();
+	S32 raw_width = raw_image.getWidth();
+	S32 raw_height = raw_image.getHeight();
 
 	memset(&cmptparm[0], 0, MAX_COMPS * sizeof(opj_image_cmptparm_t));
 	for(S32 c = 0; c < numcomps; c++) {
@@ -330,11 +482,11 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 
 	S32 i = 0;
 	const U8 *src_datap = raw_image.getData();
-	for (S32 y = height - 1; y >= 0; y--)
+	for (S32 y = raw_height - 1 - y0; y >= raw_height - y0 - height; y--)
 	{
-		for (S32 x = 0; x < width; x++)
+		for (S32 x = x0; x < x0 + width; x++)
 		{
-			const U8 *pixel = src_datap + (y*width + x) * numcomps;
+			const U8 *pixel = src_datap + (y*raw_width + x) * numcomps;
 			for (S32 c = 0; c < numcomps; c++)
 			{
 				image->comps[c].data[i] = *pixel;
@@ -344,12 +496,9 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 		}
 	}
 
-
-
 	/* encode the destination image */
 	/* ---------------------------- */
 
-	int codestream_length;
 	opj_cio_t *cio = NULL;
 
 	/* get a J2K compressor handle */
@@ -366,17 +515,11 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 	cio = opj_cio_open((opj_common_ptr)cinfo, NULL, 0);
 
 	/* encode the image */
-	bool bSuccess = opj_encode(cinfo, cio, image, NULL);
-	if (!bSuccess)
+	bool success = opj_encode(cinfo, cio, image, NULL);
+	if (success)
 	{
-		opj_cio_close(cio);
-		LL_DEBUGS("Texture") << "Failed to encode image." << LL_ENDL;
-		return FALSE;
+		codestream.assign(cio->buffer, cio->buffer + cio_tell(cio));
 	}
-	codestream_length = cio_tell(cio);
-
-	base.copyData(cio->buffer, codestream_length);
-	base.updateData(); // set width, height
 
 	/* close and free the byte stream */
 	opj_cio_close(cio);
@@ -384,12 +527,205 @@ BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, con
 	/* free remaining compression structures */
 	opj_destroy_compress(cinfo);
 
-
-	/* free user parameters structure */
-	if(parameters.cp_matrice) free(parameters.cp_matrice);
-
 	/* free image data */
 	opj_image_destroy(image);
+	return success;
+}
+
+static U32 read_u32(const U8* p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void write_u32(U8* p, U32 value)
+{
+	p[0] = U8(value >> 24);
+	p[1] = U8(value >> 16);
+	p[2] = U8(value >> 8);
+	p[3] = U8(value);
+}
+
+// Joins single tile codestreams of the same settings, in raster order, into
+// a codestream tiled tile_size by tile_size. Tiles are coded independently,
+// so this is what the encoder would have written with tiling on.
+static bool join_tiles(const std::vector<std::vector<U8> >& tiles, S32 width, S32 height, S32 tile_size,
+					   std::vector<U8>& codestream)
+{
+	// Offsets into SIZ, which follows SOC, and SOT
+	const S32 SIZ_XSIZ = 8;
+	const S32 SIZ_YSIZ = 12;
+	const S32 SIZ_XTSIZ = 24;
+	const S32 SIZ_YTSIZ = 28;
+	const S32 SOT_ISOT = 4;
+	const S32 SOT_PSOT = 6;
+	const S32 SOT_TNSOT = 11;
+
+	codestream.clear();
+	for (U32 i = 0; i < tiles.size(); i++)
+	{
+		const std::vector<U8>& tile = tiles[i];
+		S32 size = (S32)tile.size();
+		S32 header = main_header_length(&tile[0], size);
+		if (!header || header < SIZ_YTSIZ + 4 || tile[2] != 0xff || tile[3] != 0x51
+			|| read_u32(&tile[SIZ_XTSIZ]) != (U32)tile_size || read_u32(&tile[SIZ_YTSIZ]) != (U32)tile_size
+			|| size < header + 14 || tile[size - 2] != 0xff || tile[size - 1] != 0xd9)
+		{
+			return false;
+		}
+		// A single tile-part holding all of the tile
+		const U8* sot = &tile[header];
+		S32 tile_part = size - 2 - header;
+		if (read_u32(sot + SOT_PSOT) != (U32)tile_part || sot[SOT_TNSOT] > 1)
+		{
+			return false;
+		}
+
+		if (i == 0)
+		{
+			codestream.assign(tile.begin(), tile.begin() + header);
+			write_u32(&codestream[SIZ_XSIZ], width);
+			write_u32(&codestream[SIZ_YSIZ], height);
+		}
+		S32 pos = (S32)codestream.size();
+		codestream.insert(codestream.end(), sot, sot + tile_part);
+		codestream[pos + SOT_ISOT] = U8(i >> 8);
+		codestream[pos + SOT_ISOT + 1] = U8(i);
+	}
+	codestream.push_back(0xff);
+	codestream.push_back(0xd9);
+	return true;
+}
+
+namespace
+{
+	class TileEncodeJob : public LLThreadPool::Job
+	{
+	public:
+		TileEncodeJob(const opj_cparameters_t& parameters, const LLImageRaw& raw_image, S32 x0, S32 y0, S32 size,
+					  std::vector<U8>& codestream)
+		:	mParameters(parameters), mRawImage(raw_image), mX(x0), mY(y0), mSize(size),
+			mCodestream(codestream), mSuccess(false)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			mSuccess = encode_region(mParameters, mRawImage, mX, mY, mSize, mSize, mCodestream);
+		}
+
+		const opj_cparameters_t& mParameters;
+		const LLImageRaw& mRawImage;
+		S32 mX;
+		S32 mY;
+		S32 mSize;
+		std::vector<U8>& mCodestream;
+		bool mSuccess;
+	};
+}
+
+// Encodes the image a tile per job on pool. Returns false if it can't be
+// tiled or a tile fails.
+static bool encode_tiled(const opj_cparameters_t& parameters, const LLImageRaw& raw_image, S32 tile_size,
+						 LLThreadPool* pool, std::vector<U8>& codestream)
+{
+	// Smaller tiles cost more in headers and edge artifacts than they save
+	const S32 MIN_TILE_SIZE = 64;
+	S32 width = raw_image.getWidth();
+	S32 height = raw_image.getHeight();
+	if (!pool || tile_size < MIN_TILE_SIZE
+		|| width % tile_size || height % tile_size
+		|| (width == tile_size && height == tile_size))
+	{
+		return false;
+	}
+
+	S32 tiles_x = width / tile_size;
+	S32 tiles_y = height / tile_size;
+	std::vector<std::vector<U8> > tiles(tiles_x * tiles_y);
+	std::vector<TileEncodeJob*> jobs;
+	LLThreadPool::job_list_t job_list;
+	for (S32 ty = 0; ty < tiles_y; ty++)
+	{
+		for (S32 tx = 0; tx < tiles_x; tx++)
+		{
+			TileEncodeJob* job = new TileEncodeJob(parameters, raw_image, tx * tile_size, ty * tile_size,
+												   tile_size, tiles[ty * tiles_x + tx]);
+			jobs.push_back(job);
+			job_list.push_back(job);
+		}
+	}
+	pool->run(job_list);
+
+	bool success = true;
+	for (U32 i = 0; i < jobs.size(); i++)
+	{
+		success = success && jobs[i]->mSuccess;
+		delete jobs[i];
+	}
+	return success && join_tiles(tiles, width, height, tile_size, codestream);
+}
+
+BOOL LLImageJ2COJ::encodeImpl(LLImageJ2C &base, const LLImageRaw &raw_image, const char* comment_text, F32 encode_time, BOOL reversible)
+{
+	opj_cparameters_t parameters;	/* compression parameters */
+
+	/* set encoding parameters to default values */
+	opj_set_default_encoder_parameters(&parameters);
+	parameters.cod_format = 0;
+	parameters.cp_disto_alloc = 1;
+
+	if (base.mPreviewQuality)
+	{
+		// A single quality layer and the integer wavelet: rate allocation
+		// runs once and the transform needs no floating point. Truncating
+		// to the rate still makes it lossy.
+		parameters.tcp_numlayers = 1;
+		parameters.tcp_rates[0] = 30.0f;
+		if (raw_image.getComponents() >= 3)
+		{
+			parameters.tcp_mct = 1;
+		}
+	}
+	else if (reversible)
+	{
+		parameters.tcp_numlayers = 1;
+		parameters.tcp_rates[0] = 0.0f;
+	}
+	else
+	{
+		parameters.tcp_numlayers = 5;
+                parameters.tcp_rates[0] = 1920.0f;
+                parameters.tcp_rates[1] = 480.0f;
+                parameters.tcp_rates[2] = 120.0f;
+                parameters.tcp_rates[3] = 30.0f;
+		parameters.tcp_rates[4] = 10.0f;
+		parameters.irreversible = 1;
+		if (raw_image.getComponents() >= 3)
+		{
+			parameters.tcp_mct = 1;
+		}
+	}
+
+	if (!comment_text)
+	{
+		parameters.cp_comment = (char *) "";
+	}
+	else
+	{
+		// Awful hacky cast, too lazy to copy right now.
+		parameters.cp_comment = (char *) comment_text;
+	}
+
+	std::vector<U8> codestream;
+	if (!encode_tiled(parameters, raw_image, base.mEncodeTileSize, base.mEncodeThreadPool, codestream)
+		&& !encode_region(parameters, raw_image, 0, 0, raw_image.getWidth(), raw_image.getHeight(), codestream))
+	{
+		LL_DEBUGS("Texture") << "Failed to encode image." << LL_ENDL;
+		return FALSE;
+	}
+
+	base.copyData(&codestream[0], (S32)codestream.size());
+	base.updateData(); // set width, height
 	return TRUE;
 }
 
@@ -402,6 +738,15 @@ BOOL LLImageJ2COJ::getMetadata(LLImageJ2C &base)
 	// Update the raw discard level
 	base.updateRawDiscardLevel();
 
+	// The main header doesn't change as more of the codestream arrives
+	S32 header_length = main_header_length(base.getData(), base.getDataSize());
+	if (header_length > 0 && header_length == (S32)mHeader.size() &&
+		!memcmp(base.getData(), &mHeader[0], header_length))
+	{
+		base.setSize(mHeaderWidth, mHeaderHeight, mHeaderComponents);
+		return TRUE;
+	}
+
 	opj_dparameters_t parameters;	/* decompression parameters */
 	opj_event_mgr_t event_mgr;		/* event manager */
 	opj_image_t *image = NULL;
@@ -468,6 +813,14 @@ BOOL LLImageJ2COJ::getMetadata(LLImageJ2C &base)
 	height = image->y1 - image->y0;
 	base.setSize(width, height, img_components);
 
+	if (header_length > 0)
+	{
+		mHeader.assign(base.getData(), base.getData() + header_length);
+		mHeaderWidth = width;
+		mHeaderHeight = height;
+		mHeaderComponents = img_components;
+	}
+
 	/* free image data structure */
 	opj_image_destroy(image);
 	return TRUE;
@@ -29,12 +29,18 @@
 
 #include "llimagej2c.h"
 
+#include <list>
+#include <vector>
+
 class LLImageJ2COJ : public LLImageJ2CImpl
 {	
 public:
 	LLImageJ2COJ();
 	virtual ~LLImageJ2COJ();
 
+	// Total size of the decodes kept by all images, in bytes.
+	static const S32 MAX_KEPT_DECODE_BYTES = 16 * 1024 * 1024;
+
 protected:
 	/*virtual*/ BOOL getMetadata(LLImageJ2C &base);
 	/*virtual*/ BOOL decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decode_time, S32 first_channel, S32 max_channel_count);
@@ -45,6 +51,34 @@ protected:
 		// Divide a by b to the power of 2 and round upwards.
 		return (a + (1 << b) - 1) >> b;
 	}
+
+private:
+	// The texture fetcher keeps one LLImageJ2C per texture and decodes it
+	// again as data arrives, and a second time for the aux channel. Keep
+	// the parsed main header, and the last decode with all its channels,
+	// so that work isn't repeated while the codestream is unchanged.
+	BOOL reuseDecode(LLImageJ2C &base, LLImageRaw &raw_image, S32 first_channel, S32 max_channel_count);
+	void keepDecode(LLImageJ2C &base, std::vector<U8>& pixels, S32 width, S32 height, S32 components);
+	void releaseDecode(); // call with sMutex locked
+	static U32 hashData(LLImageJ2C &base);
+
+	std::vector<U8> mHeader;	// main header, SOC up to the first SOT
+	S32 mHeaderWidth;
+	S32 mHeaderHeight;
+	S32 mHeaderComponents;
+
+	std::vector<U8> mKeptPixels;	// interleaved, bottom row first like LLImageRaw
+	S32 mKeptWidth;
+	S32 mKeptHeight;
+	S32 mKeptComponents;
+	S32 mKeptDiscard;			// -1 when nothing is kept
+	S32 mKeptDataSize;
+	U32 mKeptDataHash;
+
+	typedef std::list<LLImageJ2COJ*> kept_list_t;
+	kept_list_t::iterator mKeptIter;
+	static kept_list_t sKeptList;	// most recently used first
+	static S32 sKeptBytes;
 };
 
 #endif
@@ -58,6 +58,27 @@ static const std::string INV_CREATION_DATE_LABEL("created_at");
 static const std::string INV_ASSET_TYPE_LABEL_WS("type_default");
 static const std::string INV_FOLDER_ID_LABEL_WS("category_id");
 
+// Item descriptions repeat a lot across an inventory ("(No Description)",
+// upload dates, creator boilerplate), so items share one copy of each.
+// Descriptions are only released by LLInventoryItem::cleanupClass(); like
+// the item names they are bounded by the size of the inventory.
+// The table has no lock, items are only created and edited on the main
+// thread.
+static LLStdStringTable* sDescriptionTable = NULL;
+
+static LLStdStringHandle intern_description(const std::string& desc)
+{
+	if (desc.empty())
+	{
+		return NULL;
+	}
+	if (!sDescriptionTable)
+	{
+		sDescriptionTable = new LLStdStringTable(4096);
+	}
+	return sDescriptionTable->insert(desc);
+}
+
 ///----------------------------------------------------------------------------
 /// Local function declarations, constants, enums, and typedefs
 ///----------------------------------------------------------------------------
@@ -296,14 +317,13 @@ LLInventoryItem::LLInventoryItem(const LLUUID& uuid,
 	LLInventoryObject(uuid, parent_uuid, type, name),
 	mPermissions(permissions),
 	mAssetUUID(asset_uuid),
-	mDescription(desc),
+	mDescription(NULL),
 	mSaleInfo(sale_info),
 	mInventoryType(inv_type),
 	mFlags(flags),
 	mCreationDate(creation_date_utc)
 {
-	LLStringUtil::replaceNonstandardASCII(mDescription, ' ');
-	LLStringUtil::replaceChar(mDescription, '|', ' ');
+	setDescription(desc);
 	mPermissions.initMasks(inv_type);
 }
 
@@ -311,7 +331,7 @@ LLInventoryItem::LLInventoryItem() :
 	LLInventoryObject(),
 	mPermissions(),
 	mAssetUUID(),
-	mDescription(),
+	mDescription(NULL),
 	mSaleInfo(),
 	mInventoryType(LLInventoryType::IT_NONE),
 	mFlags(0),
@@ -329,6 +349,13 @@ LLInventoryItem::~LLInventoryItem()
 {
 }
 
+// static
+void LLInventoryItem::cleanupClass()
+{
+	delete sDescriptionTable;
+	sDescriptionTable = NULL;
+}
+
 // virtual
 void LLInventoryItem::copyItem(const LLInventoryItem* other)
 {
@@ -378,7 +405,7 @@ void LLInventoryItem::setAssetUUID(const LLUUID& asset_id)
 
 const std::string& LLInventoryItem::getDescription() const
 {
-	return mDescription;
+	return mDescription ? *mDescription : LLStringUtil::null;
 }
 
 time_t LLInventoryItem::getCreationDate() const
@@ -418,10 +445,7 @@ void LLInventoryItem::setDescription(const std::string& d)
 	std::string new_desc(d);
 	LLStringUtil::replaceNonstandardASCII(new_desc, ' ');
 	LLStringUtil::replaceChar(new_desc, '|', ' ');
-	if( new_desc != mDescription )
-	{
-		mDescription = new_desc;
-	}
+	mDescription = intern_description(new_desc);
 }
 
 void LLInventoryItem::setPermissions(const LLPermissions& perm)
@@ -522,7 +546,7 @@ void LLInventoryItem::packMessage(LLMessageSystem* msg) const
 	msg->addU32Fast(_PREHASH_Flags, mFlags);
 	mSaleInfo.packMessage(msg);
 	msg->addStringFast(_PREHASH_Name, mName);
-	msg->addStringFast(_PREHASH_Description, mDescription);
+	msg->addStringFast(_PREHASH_Description, LLInventoryItem::getDescription());
 	msg->addS32Fast(_PREHASH_CreationDate, mCreationDate);
 	U32 crc = getCRC32();
 	msg->addU32Fast(_PREHASH_CRC, crc);
@@ -550,8 +574,10 @@ BOOL LLInventoryItem::unpackMessage(LLMessageSystem* msg, const char* block, S32
 	msg->getStringFast(block, _PREHASH_Name, mName, block_num);
 	LLStringUtil::replaceNonstandardASCII(mName, ' ');
 
-	msg->getStringFast(block, _PREHASH_Description, mDescription, block_num);
-	LLStringUtil::replaceNonstandardASCII(mDescription, ' ');
+	std::string desc;
+	msg->getStringFast(block, _PREHASH_Description, desc, block_num);
+	LLStringUtil::replaceNonstandardASCII(desc, ' ');
+	mDescription = intern_description(desc);
 
 	S32 date;
 	msg->getS32(block, "CreationDate", date, block_num);
@@ -700,8 +726,9 @@ BOOL LLInventoryItem::importFile(LLFILE* fp)
 				valuestr[0] = '\000';
 			}
 
-			mDescription.assign(valuestr);
-			LLStringUtil::replaceNonstandardASCII(mDescription, ' ');
+			std::string desc(valuestr);
+			LLStringUtil::replaceNonstandardASCII(desc, ' ');
+			mDescription = intern_description(desc);
 			/* TODO -- ask Ian about this code
 			const char *donkey = mDescription.c_str();
 			if (donkey[0] == '|')
@@ -779,7 +806,7 @@ BOOL LLInventoryItem::exportFile(LLFILE* fp, BOOL include_asset_key) const
 	fprintf(fp, "\t\tflags\t%08x\n", mFlags);
 	mSaleInfo.exportFile(fp);
 	fprintf(fp, "\t\tname\t%s|\n", mName.c_str());
-	fprintf(fp, "\t\tdesc\t%s|\n", mDescription.c_str());
+	fprintf(fp, "\t\tdesc\t%s|\n", LLInventoryItem::getDescription().c_str());
 	fprintf(fp, "\t\tcreation_date\t%d\n", (S32) mCreationDate);
 	fprintf(fp,"\t}\n");
 	return TRUE;
@@ -906,8 +933,9 @@ BOOL LLInventoryItem::importLegacyStream(std::istream& input_stream)
 				valuestr[0] = '\000';
 			}
 
-			mDescription.assign(valuestr);
-			LLStringUtil::replaceNonstandardASCII(mDescription, ' ');
+			std::string desc(valuestr);
+			LLStringUtil::replaceNonstandardASCII(desc, ' ');
+			mDescription = intern_description(desc);
 			/* TODO -- ask Ian about this code
 			const char *donkey = mDescription.c_str();
 			if (donkey[0] == '|')
@@ -988,7 +1016,7 @@ BOOL LLInventoryItem::exportLegacyStream(std::ostream& output_stream, BOOL inclu
 	output_stream << buffer;
 	mSaleInfo.exportLegacyStream(output_stream);
 	output_stream << "\t\tname\t" << mName.c_str() << "|\n";
-	output_stream << "\t\tdesc\t" << mDescription.c_str() << "|\n";
+	output_stream << "\t\tdesc\t" << LLInventoryItem::getDescription().c_str() << "|\n";
 	output_stream << "\t\tcreation_date\t" << mCreationDate << "\n";
 	output_stream << "\t}\n";
 	return TRUE;
@@ -1032,7 +1060,7 @@ void LLInventoryItem::asLLSD( LLSD& sd ) const
 	sd[INV_FLAGS_LABEL] = ll_sd_from_U32(mFlags);
 	sd[INV_SALE_INFO_LABEL] = mSaleInfo;
 	sd[INV_NAME_LABEL] = mName;
-	sd[INV_DESC_LABEL] = mDescription;
+	sd[INV_DESC_LABEL] = LLInventoryItem::getDescription();
 	sd[INV_CREATION_DATE_LABEL] = (S32) mCreationDate;
 }
 
@@ -1144,8 +1172,9 @@ bool LLInventoryItem::fromLLSD(const LLSD& sd)
 	w = INV_DESC_LABEL;
 	if (sd.has(w))
 	{
-		mDescription = sd[w].asString();
-		LLStringUtil::replaceNonstandardASCII(mDescription, ' ');
+		std::string desc = sd[w].asString();
+		LLStringUtil::replaceNonstandardASCII(desc, ' ');
+		mDescription = intern_description(desc);
 	}
 	w = INV_CREATION_DATE_LABEL;
 	if (sd.has(w))
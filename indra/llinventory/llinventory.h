@@ -35,6 +35,7 @@
 #include "llrefcount.h"
 #include "llsaleinfo.h"
 #include "llsd.h"
+#include "llstringtable.h"
 #include "lluuid.h"
 
 class LLMessageSystem;
@@ -148,6 +149,10 @@ public:
 	LLInventoryItem(const LLInventoryItem* other);
 	virtual void copyItem(const LLInventoryItem* other); // LLRefCount requires custom copy
 	void generateUUID() { mUUID.generate(); }
+
+	// Frees the shared descriptions. Call at shutdown, once no items
+	// are left.
+	static void cleanupClass();
 protected:
 	~LLInventoryItem(); // ref counted
 	
@@ -220,7 +225,7 @@ public:
 protected:
 	LLPermissions mPermissions;
 	LLUUID mAssetUUID;
-	std::string mDescription;
+	LLStdStringHandle mDescription; // interned, NULL if empty
 	LLSaleInfo mSaleInfo;
 	LLInventoryType::EType mInventoryType;
 	U32 mFlags;
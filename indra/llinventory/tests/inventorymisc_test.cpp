@@ -30,9 +30,13 @@
 #include "llsd.h"
 
 #include "../llinventory.h"
+#include "lltimer.h"
 
 #include "../test/lltut.h"
 
+#include <boost/unordered_map.hpp>
+#include <set>
+
 
 #if LL_WINDOWS
 // disable unreachable code warnings
@@ -505,4 +509,117 @@ namespace tut
 		ensure_equals("5.name::getName() failed", src1->getName(), src2->getName());
 			
 	}
+
+	template<> template<>
+	void inventory_object::test<15>()
+	{
+		LLPointer<LLInventoryItem> src1 = create_random_inventory_item();
+		LLPointer<LLInventoryItem> src2 = create_random_inventory_item();
+		ensure("1.equal descriptions are shared", &src1->getDescription() == &src2->getDescription());
+
+		src2->setDescription(std::string("Something|else"));
+		ensure_equals("2.setDescription() failed", src2->getDescription(), std::string("Something else"));
+		ensure_equals("3.shared description changed", src1->getDescription(), std::string("Used for Testing"));
+
+		src2->setDescription(std::string());
+		ensure("4.empty description failed", src2->getDescription().empty());
+
+		LLSD sd = src1->asLLSD();
+		LLPointer<LLInventoryItem> dst = new LLInventoryItem();
+		dst->fromLLSD(sd);
+		ensure("5.fromLLSD() did not share description", &dst->getDescription() == &src1->getDescription());
+	}
+
+	// The inventory model keys its maps by id through hash_value(LLUUID)
+	template<> template<>
+	void inventory_object::test<16>()
+	{
+		const S32 ITEM_COUNT = 10000;
+		std::vector<LLPointer<LLInventoryItem> > items;
+		boost::unordered_map<LLUUID, LLPointer<LLInventoryItem> > hashed_map;
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			LLPointer<LLInventoryItem> item = create_random_inventory_item();
+			items.push_back(item);
+			hashed_map[item->getUUID()] = item;
+		}
+		ensure_equals("1.ids collided", (S32)hashed_map.size(), ITEM_COUNT);
+
+		LLUUID copy = items[0]->getUUID();
+		ensure_equals("2.equal ids hash differently", hash_value(copy), hash_value(items[0]->getUUID()));
+
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			ensure("3.lookup failed", hashed_map[items[i]->getUUID()] == items[i]);
+		}
+		LLUUID unknown;
+		unknown.generate();
+		ensure("4.found unknown id", hashed_map.find(unknown) == hashed_map.end());
+
+		hashed_map.erase(items[0]->getUUID());
+		ensure("5.erase failed", hashed_map.find(items[0]->getUUID()) == hashed_map.end());
+		ensure("6.erase removed another id", hashed_map.find(items[1]->getUUID()) != hashed_map.end());
+	}
+
+	// Benchmark for the log: lookups in the model's old std::map against
+	// the hashed map, and what sharing descriptions saves.
+	template<> template<>
+	void inventory_object::test<17>()
+	{
+		const S32 ITEM_COUNT = 100000;
+		const S32 DISTINCT_DESCRIPTIONS = 100;
+		std::vector<LLPointer<LLInventoryItem> > items;
+		items.reserve(ITEM_COUNT);
+		std::map<LLUUID, LLPointer<LLInventoryItem> > ordered_map;
+		boost::unordered_map<LLUUID, LLPointer<LLInventoryItem> > hashed_map;
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			LLPointer<LLInventoryItem> item = create_random_inventory_item();
+			item->setDescription(llformat("Uploaded batch %d", i % DISTINCT_DESCRIPTIONS));
+			items.push_back(item);
+			ordered_map[item->getUUID()] = item;
+			hashed_map[item->getUUID()] = item;
+		}
+
+		LLTimer timer;
+		S32 found = 0;
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			found += (S32)ordered_map.count(items[i]->getUUID());
+		}
+		F64 ordered_time = timer.getElapsedTimeF64();
+		ensure_equals("1.std::map lookup failed", found, ITEM_COUNT);
+
+		timer.reset();
+		found = 0;
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			found += (S32)hashed_map.count(items[i]->getUUID());
+		}
+		F64 hashed_time = timer.getElapsedTimeF64();
+		ensure_equals("2.boost::unordered_map lookup failed", found, ITEM_COUNT);
+
+		// one std::string per item before, one handle per item and one
+		// string per distinct text now
+		std::set<const std::string*> shared;
+		size_t text_bytes = 0;
+		size_t shared_bytes = 0;
+		for (S32 i = 0; i < ITEM_COUNT; ++i)
+		{
+			const std::string& desc = items[i]->getDescription();
+			text_bytes += desc.capacity() + 1;
+			if (shared.insert(&desc).second)
+			{
+				shared_bytes += sizeof(std::string) + desc.capacity() + 1;
+			}
+		}
+		ensure_equals("3.descriptions not shared", (S32)shared.size(), DISTINCT_DESCRIPTIONS);
+		size_t unshared_bytes = ITEM_COUNT * sizeof(std::string) + text_bytes;
+		shared_bytes += ITEM_COUNT * sizeof(LLStdStringHandle);
+
+		llinfos << ITEM_COUNT << " lookups: std::map " << ordered_time * 1000.0
+				<< " ms, boost::unordered_map " << hashed_time * 1000.0 << " ms" << llendl;
+		llinfos << ITEM_COUNT << " descriptions: " << unshared_bytes / 1024
+				<< " KB as strings, " << shared_bytes / 1024 << " KB shared" << llendl;
+	}
 }
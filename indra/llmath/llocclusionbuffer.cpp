@@ -0,0 +1,275 @@
+/**
+ * @file llocclusionbuffer.cpp
+ * @brief Small CPU depth buffer for conservative occlusion tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llocclusionbuffer.h"
+
+#include "llmath.h"
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#include <algorithm>
+
+// A rectangle must be this much farther than the occluders, as a fraction
+// of 1/depth, to be occluded.
+const F32 OCCLUSION_BIAS = 0.99f;
+
+LLOcclusionBuffer::LLOcclusionBuffer(BOOL vectorize)
+:	mVectorize(vectorize)
+{
+}
+
+void LLOcclusionBuffer::clear()
+{
+	if (mRaster.empty())
+	{
+		mRaster.resize(WIDTH * HEIGHT);
+		for (U32 i = 0; i < NUM_LEVELS; ++i)
+		{
+			mLevels[i].resize((WIDTH >> i) * (HEIGHT >> i));
+		}
+	}
+	std::fill(mRaster.begin(), mRaster.end(), 0.f);
+}
+
+void LLOcclusionBuffer::rasterizeTriangle(const F32* v0, const F32* v1, const F32* v2)
+{
+	F32 area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+	if (fabsf(area) < 0.0001f)
+	{
+		return;
+	}
+	if (area < 0.f)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	S32 min_x = llmax((S32) floorf(llmin(v0[0], v1[0], v2[0])), 0);
+	S32 max_x = llmin((S32) ceilf(llmax(v0[0], v1[0], v2[0])), (S32) WIDTH - 1);
+	S32 min_y = llmax((S32) floorf(llmin(v0[1], v1[1], v2[1])), 0);
+	S32 max_y = llmin((S32) ceilf(llmax(v0[1], v1[1], v2[1])), (S32) HEIGHT - 1);
+	if (min_x > max_x || min_y > max_y)
+	{
+		return;
+	}
+	min_x &= ~3;
+
+	// Edge functions a*x + b*y + c, positive inside. Each one, divided by
+	// the area, is the weight of the vertex opposite the edge.
+	const F32* edge_from[3] = { v1, v2, v0 };
+	const F32* edge_to[3] = { v2, v0, v1 };
+	F32 a[3], b[3], c[3];
+	for (U32 i = 0; i < 3; ++i)
+	{
+		a[i] = edge_from[i][1] - edge_to[i][1];
+		b[i] = edge_to[i][0] - edge_from[i][0];
+		c[i] = -(a[i] * edge_from[i][0] + b[i] * edge_from[i][1]);
+	}
+
+	// 1/depth is d[0]*x + d[1]*y + d[2]
+	F32 inv_area = 1.f / area;
+	F32 d[3];
+	d[0] = (a[0] * v0[2] + a[1] * v1[2] + a[2] * v2[2]) * inv_area;
+	d[1] = (b[0] * v0[2] + b[1] * v1[2] + b[2] * v2[2]) * inv_area;
+	d[2] = (c[0] * v0[2] + c[1] * v1[2] + c[2] * v2[2]) * inv_area;
+
+	if (mVectorize)
+	{
+		rasterizeSSE(a, b, c, d, min_x, max_x, min_y, max_y);
+	}
+	else
+	{
+		rasterizeScalar(a, b, c, d, min_x, max_x, min_y, max_y);
+	}
+}
+
+// Both rasterisers add the row terms first and the x term last, in the
+// same order, so they agree texel for texel.
+void LLOcclusionBuffer::rasterizeScalar(const F32* a, const F32* b, const F32* c, const F32* d,
+										S32 min_x, S32 max_x, S32 min_y, S32 max_y)
+{
+	for (S32 y = min_y; y <= max_y; ++y)
+	{
+		F32 center_y = y + 0.5f;
+		F32 row0 = b[0] * center_y + c[0];
+		F32 row1 = b[1] * center_y + c[1];
+		F32 row2 = b[2] * center_y + c[2];
+		F32 rowd = d[1] * center_y + d[2];
+		F32* row = &mRaster[y * WIDTH];
+
+		for (S32 x = min_x; x <= max_x; ++x)
+		{
+			F32 center_x = x + 0.5f;
+			if (a[0] * center_x + row0 >= 0.f &&
+				a[1] * center_x + row1 >= 0.f &&
+				a[2] * center_x + row2 >= 0.f)
+			{
+				row[x] = llmax(row[x], d[0] * center_x + rowd);
+			}
+		}
+	}
+}
+
+#if LL_VECTORIZE
+void LLOcclusionBuffer::rasterizeSSE(const F32* a, const F32* b, const F32* c, const F32* d,
+									 S32 min_x, S32 max_x, S32 min_y, S32 max_y)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 a0 = _mm_set1_ps(a[0]);
+	const __m128 a1 = _mm_set1_ps(a[1]);
+	const __m128 a2 = _mm_set1_ps(a[2]);
+	const __m128 ad = _mm_set1_ps(d[0]);
+
+	for (S32 y = min_y; y <= max_y; ++y)
+	{
+		F32 center_y = y + 0.5f;
+		const __m128 row0 = _mm_set1_ps(b[0] * center_y + c[0]);
+		const __m128 row1 = _mm_set1_ps(b[1] * center_y + c[1]);
+		const __m128 row2 = _mm_set1_ps(b[2] * center_y + c[2]);
+		const __m128 rowd = _mm_set1_ps(d[1] * center_y + d[2]);
+		F32* row = &mRaster[y * WIDTH];
+
+		// min_x is a multiple of 4, and so is WIDTH
+		for (S32 x = min_x; x <= max_x; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((F32) x), offsets);
+			__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero),
+								_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero),
+											_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero)));
+			__m128 depth = _mm_add_ps(_mm_mul_ps(ad, px), rowd);
+			__m128 old = _mm_loadu_ps(row + x);
+			__m128 nearest = _mm_max_ps(old, depth);
+			_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+#else
+void LLOcclusionBuffer::rasterizeSSE(const F32* a, const F32* b, const F32* c, const F32* d,
+									 S32 min_x, S32 max_x, S32 min_y, S32 max_y)
+{
+	rasterizeScalar(a, b, c, d, min_x, max_x, min_y, max_y);
+}
+#endif
+
+void LLOcclusionBuffer::buildHierarchy()
+{
+	// Erode by a texel: a texel is only as near as the farthest of its
+	// neighbours. Coverage was sampled at texel centres, so this is what
+	// makes an edge texel that is only partly covered count as empty, and
+	// covers the depth change across a texel. Off screen counts as empty.
+	std::vector<F32>& eroded = mLevels[0];
+	for (S32 y = 0; y < HEIGHT; ++y)
+	{
+		const F32* src = &mRaster[y * WIDTH];
+		F32* dst = &eroded[y * WIDTH];
+		dst[0] = dst[WIDTH - 1] = 0.f;
+		for (S32 x = 1; x < WIDTH - 1; ++x)
+		{
+			dst[x] = llmin(src[x - 1], src[x], src[x + 1]);
+		}
+	}
+	for (S32 y = 0; y < HEIGHT; ++y)
+	{
+		F32* dst = &mRaster[y * WIDTH];
+		if (y == 0 || y == HEIGHT - 1)
+		{
+			std::fill(dst, dst + WIDTH, 0.f);
+			continue;
+		}
+		const F32* above = &eroded[(y - 1) * WIDTH];
+		const F32* src = &eroded[y * WIDTH];
+		const F32* below = &eroded[(y + 1) * WIDTH];
+		for (S32 x = 0; x < WIDTH; ++x)
+		{
+			dst[x] = llmin(above[x], src[x], below[x]);
+		}
+	}
+	mLevels[0].swap(mRaster);
+
+	// each coarser texel keeps the farthest of the four below it
+	for (U32 level = 1; level < NUM_LEVELS; ++level)
+	{
+		const S32 src_width = WIDTH >> (level - 1);
+		const S32 width = WIDTH >> level;
+		const S32 height = HEIGHT >> level;
+		const F32* src = &mLevels[level - 1][0];
+		F32* dst = &mLevels[level][0];
+
+		for (S32 y = 0; y < height; ++y)
+		{
+			const F32* row0 = src + (y * 2) * src_width;
+			const F32* row1 = row0 + src_width;
+			for (S32 x = 0; x < width; ++x)
+			{
+				dst[y * width + x] = llmin(row0[x * 2], row0[x * 2 + 1], row1[x * 2], row1[x * 2 + 1]);
+			}
+		}
+	}
+}
+
+BOOL LLOcclusionBuffer::isRectOccluded(F32 min_x, F32 min_y, F32 max_x, F32 max_y, F32 nearest) const
+{
+	// nothing was drawn off screen, so anything reaching off it is visible
+	if (min_x < 0.f || min_y < 0.f || max_x >= (F32) WIDTH || max_y >= (F32) HEIGHT)
+	{
+		return FALSE;
+	}
+
+	S32 x0 = (S32) min_x;
+	S32 x1 = (S32) max_x;
+	S32 y0 = (S32) min_y;
+	S32 y1 = (S32) max_y;
+
+	// the finest level where the rectangle covers at most 2x2 texels
+	U32 level = 0;
+	while (level < NUM_LEVELS - 1 &&
+		((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+	{
+		level++;
+	}
+
+	const S32 width = WIDTH >> level;
+	const F32* depth = &mLevels[level][0];
+	for (S32 y = y0 >> level; y <= (y1 >> level); ++y)
+	{
+		for (S32 x = x0 >> level; x <= (x1 >> level); ++x)
+		{
+			if (nearest >= depth[y * width + x] * OCCLUSION_BIAS)
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+F32 LLOcclusionBuffer::getDepth(U32 level, S32 x, S32 y) const
+{
+	return mLevels[level][y * (WIDTH >> level) + x];
+}
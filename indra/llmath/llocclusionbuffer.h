@@ -0,0 +1,86 @@
+/**
+ * @file llocclusionbuffer.h
+ * @brief Small CPU depth buffer for conservative occlusion tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOCCLUSIONBUFFER_H
+#define LL_LLOCCLUSIONBUFFER_H
+
+#include "stdtypes.h"
+
+#include <vector>
+
+// A small depth buffer that occluder triangles are rasterised into, and a
+// min depth mip chain of it for testing screen rectangles against.
+//
+// Depth is stored as 1/depth, which is linear in screen space, with 0
+// where nothing was drawn, so larger is nearer. Coverage is sampled at
+// texel centres and eroded by a texel before the mip chain is built, so a
+// texel that is only partly covered never occludes anything.
+//
+// Rasterising writes to the buffer, testing only reads it, so once
+// buildHierarchy() is done any number of threads may test at once.
+class LLOcclusionBuffer
+{
+public:
+	enum
+	{
+		WIDTH = 256,	// a multiple of 4, rows are rasterised 4 texels at a time
+		HEIGHT = 128,
+		NUM_LEVELS = 6
+	};
+
+	// With vectorize the SSE rasteriser is used when the build has it.
+	// The scalar one covers the same texels with the same depths.
+	LLOcclusionBuffer(BOOL vectorize = TRUE);
+
+	void clear();
+
+	// Vertices are screen x and y in texels, and 1/depth. Either winding.
+	void rasterizeTriangle(const F32* v0, const F32* v1, const F32* v2);
+
+	// Erodes the coverage and builds the mip chain. Call once everything
+	// is rasterised, before testing.
+	void buildHierarchy();
+
+	// TRUE if the screen rectangle is behind what was drawn all over it.
+	// nearest is the 1/depth of the nearest point of what is tested.
+	// Rectangles reaching off screen are never occluded.
+	BOOL isRectOccluded(F32 min_x, F32 min_y, F32 max_x, F32 max_y, F32 nearest) const;
+
+	// 1/depth of a texel of a mip level, after buildHierarchy().
+	F32 getDepth(U32 level, S32 x, S32 y) const;
+
+private:
+	void rasterizeScalar(const F32* a, const F32* b, const F32* c, const F32* d,
+						 S32 min_x, S32 max_x, S32 min_y, S32 max_y);
+	void rasterizeSSE(const F32* a, const F32* b, const F32* c, const F32* d,
+					  S32 min_x, S32 max_x, S32 min_y, S32 max_y);
+
+	std::vector<F32> mLevels[NUM_LEVELS];
+	std::vector<F32> mRaster;	// level 0 before erosion
+	BOOL mVectorize;
+};
+
+#endif // LL_LLOCCLUSIONBUFFER_H
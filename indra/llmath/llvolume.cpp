@@ -1658,17 +1658,20 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+LLAtomicS32 LLVolume::sNumMeshPoints;
 
-LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
+LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique,
+				   const BOOL defer_build)
 	: mParams(params)
 {
 	LLMemType m1(LLMemType::MTYPE_VOLUME);
 	
 	mUnique = is_unique;
+	mReady = !defer_build;
 	mFaceMask = 0x0;
 	mDetail = detail;
 	mSculptLevel = -2;
+	mSculptMap = NULL;
 	
 	// set defaults
 	if (mParams.getPathParams().getCurveType() == LL_PCODE_PATH_FLEXIBLE)
@@ -1683,17 +1686,40 @@ LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL ge
 
 	mGenerateSingleFace = generate_single_face;
 
+	if (!defer_build)
+	{
+		build();
+	}
+}
+
+void LLVolume::build()
+{
 	generate();
-	if (mParams.getSculptID().isNull() && params.getSculptType() == LL_SCULPT_TYPE_NONE)
+	if (mParams.getSculptID().isNull() && mParams.getSculptType() == LL_SCULPT_TYPE_NONE)
 	{
 		createVolumeFaces();
 	}
+	else if (mSculptMap)
+	{
+		sculpt(mSculptMap->mWidth, mSculptMap->mHeight, mSculptMap->mComponents,
+			   mSculptMap->mData.empty() ? NULL : &mSculptMap->mData[0], mSculptMap->mLevel);
+		delete mSculptMap;
+		mSculptMap = NULL;
+	}
+}
+
+void LLVolume::setSculptMap(const SculptMap& map)
+{
+	llassert(!mReady);
+	delete mSculptMap;
+	mSculptMap = new SculptMap(map);
 }
 
 void LLVolume::resizePath(S32 length)
 {
 	mPathp->resizePath(length);
 	mVolumeFaces.clear();
+	mFaceBVHs.clear();
 }
 
 void LLVolume::regen()
@@ -1710,6 +1736,7 @@ void LLVolume::genBinormals(S32 face)
 LLVolume::~LLVolume()
 {
 	sNumMeshPoints -= mMesh.size();
+	delete mSculptMap;
 	delete mPathp;
 
 	profile_delete_lock = 0 ;
@@ -1840,6 +1867,9 @@ void LLVolume::createVolumeFaces()
 {
 	LLMemType m1(LLMemType::MTYPE_VOLUME);
 
+	// Vertices move, even on a partial build
+	mFaceBVHs.clear();
+
 	if (mGenerateSingleFace)
 	{
 		// do nothing
@@ -3575,6 +3605,27 @@ void LLVolume::generateSilhouetteVertices(std::vector<LLVector3> &vertices,
 	}
 }
 
+const LLVolumeFaceBVH* LLVolume::getFaceBVH(S32 face)
+{
+	if (mFaceBVHs.size() != mVolumeFaces.size())
+	{
+		mFaceBVHs.clear();
+		mFaceBVHs.resize(mVolumeFaces.size());
+	}
+	if (mFaceBVHs[face].isNull())
+	{
+		mFaceBVHs[face] = new LLVolumeFaceBVH(mVolumeFaces[face]);
+	}
+	return mFaceBVHs[face];
+}
+
+// Interpolates a vertex attribute at the barycentric point a, b of a triangle
+template<class T>
+static inline T interpolate_hit(const T& v1, const T& v2, const T& v3, F32 a, F32 b)
+{
+	return (1.f - a - b) * v1 + a * v2 + b * v3;
+}
+
 S32 LLVolume::lineSegmentIntersect(const LLVector3& start, const LLVector3& end, 
 								   S32 face,
 								   LLVector3* intersection,LLVector2* tex_coord, LLVector3* normal, LLVector3* bi_normal)
@@ -3595,7 +3646,9 @@ S32 LLVolume::lineSegmentIntersect(const LLVector3& start, const LLVector3& end,
 		end_face = face;
 	}
 
-	LLVector3 dir = end - start;
+	LLVolumeFaceBVH::Ray ray;
+	ray.mStart = start;
+	ray.mDir = end - start;
 
 	F32 closest_t = 2.f; // must be larger than 1
 	
@@ -3606,70 +3659,105 @@ S32 LLVolume::lineSegmentIntersect(const LLVector3& start, const LLVector3& end,
 		LLVector3 box_center = (face.mExtents[0] + face.mExtents[1]) / 2.f;
 		LLVector3 box_size   = face.mExtents[1] - face.mExtents[0];
 
-        if (LLLineSegmentBoxIntersect(start, end, box_center, box_size))
+		if (!LLLineSegmentBoxIntersect(start, end, box_center, box_size))
 		{
-			if (bi_normal != NULL) // if the caller wants binormals, we may need to generate them
-			{
-				genBinormals(i);
-			}
-			
-			for (U32 tri = 0; tri < face.mIndices.size()/3; tri++) 
-			{
-				S32 index1 = face.mIndices[tri*3+0];
-				S32 index2 = face.mIndices[tri*3+1];
-				S32 index3 = face.mIndices[tri*3+2];
+			continue;
+		}
 
-				F32 a, b, t;
-			
-				if (LLTriangleRayIntersect(face.mVertices[index1].mPosition,
-										   face.mVertices[index2].mPosition,
-										   face.mVertices[index3].mPosition,
-										   start, dir, &a, &b, &t, FALSE))
-				{
-					if ((t >= 0.f) &&      // if hit is after start
-						(t <= 1.f) &&      // and before end
-						(t < closest_t))   // and this hit is closer
+		LLVolumeFaceBVH::Hit hit;
+		getFaceBVH(i)->intersect(ray, llmin(closest_t, 1.f), hit);
+		if (hit.mTriangle < 0 || hit.mT >= closest_t)
 		{
-						closest_t = t;
-						hit_face = i;
+			continue;
+		}
 
-						if (intersection != NULL)
-						{
-							*intersection = start + dir * closest_t;
-						}
-			
-						if (tex_coord != NULL)
-			{
-							*tex_coord = ((1.f - a - b)  * face.mVertices[index1].mTexCoord +
-										  a              * face.mVertices[index2].mTexCoord +
-										  b              * face.mVertices[index3].mTexCoord);
+		if (bi_normal != NULL) // if the caller wants binormals, we may need to generate them
+		{
+			genBinormals(i);
+		}
 
-						}
+		closest_t = hit.mT;
+		hit_face = i;
 
-						if (normal != NULL)
-				{
-							*normal    = ((1.f - a - b)  * face.mVertices[index1].mNormal + 
-										  a              * face.mVertices[index2].mNormal +
-										  b              * face.mVertices[index3].mNormal);
-						}
+		const LLVolumeFace::VertexData& v1 = face.mVertices[face.mIndices[hit.mTriangle*3+0]];
+		const LLVolumeFace::VertexData& v2 = face.mVertices[face.mIndices[hit.mTriangle*3+1]];
+		const LLVolumeFace::VertexData& v3 = face.mVertices[face.mIndices[hit.mTriangle*3+2]];
 
-						if (bi_normal != NULL)
-					{
-							*bi_normal = ((1.f - a - b)  * face.mVertices[index1].mBinormal + 
-										  a              * face.mVertices[index2].mBinormal +
-										  b              * face.mVertices[index3].mBinormal);
-						}
+		if (intersection != NULL)
+		{
+			*intersection = start + ray.mDir * closest_t;
+		}
 
-					}
-				}
-			}
-		}		
+		if (tex_coord != NULL)
+		{
+			*tex_coord = interpolate_hit(v1.mTexCoord, v2.mTexCoord, v3.mTexCoord, hit.mA, hit.mB);
+		}
+
+		if (normal != NULL)
+		{
+			*normal = interpolate_hit(v1.mNormal, v2.mNormal, v3.mNormal, hit.mA, hit.mB);
+		}
+
+		if (bi_normal != NULL)
+		{
+			*bi_normal = interpolate_hit(v1.mBinormal, v2.mBinormal, v3.mBinormal, hit.mA, hit.mB);
+		}
 	}
 	
-	
 	return hit_face;
 }
 
+void LLVolume::lineSegmentIntersect(U32 count, const LLVector3* starts, const LLVector3* ends,
+									S32 face, SegmentHit* hits)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	S32 start_face = (face == -1 ? 0 : face);
+	S32 end_face = (face == -1 ? getNumVolumeFaces() - 1 : face);
+
+	std::vector<LLVolumeFaceBVH::Ray> rays(count);
+	std::vector<LLVolumeFaceBVH::Hit> face_hits(count);
+	std::vector<F32> closest_t(count, 2.f);
+	for (U32 j = 0; j < count; j++)
+	{
+		rays[j].mStart = starts[j];
+		rays[j].mDir = ends[j] - starts[j];
+		hits[j].mFace = -1;
+	}
+
+	for (S32 i = start_face; i <= end_face; i++)
+	{
+		const LLVolumeFace& vf = getVolumeFace(i);
+		const LLVolumeFaceBVH* bvh = getFaceBVH(i);
+		for (U32 j = 0; j < count; j++)
+		{
+			face_hits[j].mT = llmin(closest_t[j], 1.f);
+		}
+		bvh->intersect(count, &rays[0], &face_hits[0]);
+
+		for (U32 j = 0; j < count; j++)
+		{
+			const LLVolumeFaceBVH::Hit& hit = face_hits[j];
+			if (hit.mTriangle < 0 || hit.mT >= closest_t[j])
+			{
+				continue;
+			}
+			closest_t[j] = hit.mT;
+
+			const LLVolumeFace::VertexData& v1 = vf.mVertices[vf.mIndices[hit.mTriangle*3+0]];
+			const LLVolumeFace::VertexData& v2 = vf.mVertices[vf.mIndices[hit.mTriangle*3+1]];
+			const LLVolumeFace::VertexData& v3 = vf.mVertices[vf.mIndices[hit.mTriangle*3+2]];
+			hits[j].mFace = i;
+			hits[j].mIntersection = starts[j] + rays[j].mDir * hit.mT;
+			hits[j].mTexCoord = interpolate_hit(v1.mTexCoord, v2.mTexCoord, v3.mTexCoord, hit.mA, hit.mB);
+			hits[j].mNormal = interpolate_hit(v1.mNormal, v2.mNormal, v3.mNormal, hit.mA, hit.mB);
+		}
+	}
+}
+
 class LLVertexIndexPair
 {
 public:
@@ -47,6 +47,9 @@ class LLVolume;
 #include "llstrider.h"
 #include "v4coloru.h"
 #include "llrefcount.h"
+#include "llpointer.h"
+#include "llvolumebvh.h"
+#include "llapr.h"
 #include "llfile.h"
 
 //============================================================================
@@ -846,6 +849,7 @@ private:
 class LLVolume : public LLRefCount
 {
 	friend class LLVolumeLODGroup;
+	friend class LLVolumeMgr;
 
 private:
 	LLVolume(const LLVolume&);  // Don't implement
@@ -866,7 +870,30 @@ public:
 		S32 mCountT;
 	};
 
-	LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE);
+	// A sculpt map copied for a volume built later, so that the texture
+	// it came from can go away in the meantime.
+	struct SculptMap
+	{
+		SculptMap() : mWidth(0), mHeight(0), mComponents(0), mLevel(-1) {}
+
+		U16 mWidth;
+		U16 mHeight;
+		S8 mComponents;
+		S32 mLevel;
+		std::vector<U8> mData;
+	};
+
+	// With defer_build the volume stays empty, and not ready, until build().
+	LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face = FALSE, const BOOL is_unique = FALSE,
+			 const BOOL defer_build = FALSE);
+
+	// Generates a volume created with defer_build, sculpting it with the
+	// map given to setSculptMap() if any. Safe on any thread as long as
+	// nothing else touches the volume until it is ready.
+	void build();
+	void setSculptMap(const SculptMap& map);
+	// False while a deferred volume waits to be built
+	BOOL isReady() const									{ return mReady; }
 	
 	U8 getProfileType()	const								{ return mParams.getProfileParams().getCurveType(); }
 	U8 getPathType() const									{ return mParams.getPathParams().getCurveType(); }
@@ -916,6 +943,23 @@ public:
 							 LLVector3* normal = NULL,               // return the surface normal at the intersection point
 							 LLVector3* bi_normal = NULL             // return the surface bi-normal at the intersection point
 		);
+
+	struct SegmentHit
+	{
+		S32 mFace;					// -1 when nothing was hit
+		LLVector3 mIntersection;
+		LLVector2 mTexCoord;
+		LLVector3 mNormal;
+	};
+
+	// The same for count line segments at once, such as the rays of a
+	// line of sight or area pick. Segments must be in volume space.
+	void lineSegmentIntersect(U32 count, const LLVector3* starts, const LLVector3* ends,
+							  S32 face, SegmentHit* hits);
+
+	// Ray cast hierarchy of a face, built on first use and kept until the
+	// faces are regenerated. Main thread only.
+	const LLVolumeFaceBVH* getFaceBVH(S32 face);
 	
 	// The following cleans up vertices and triangles,
 	// getting rid of degenerate triangles and duplicate vertices,
@@ -931,7 +975,7 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static LLAtomicS32 sNumMeshPoints;
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -955,8 +999,10 @@ protected:
 
  protected:
 	BOOL mUnique;
+	BOOL mReady;
 	F32 mDetail;
 	S32 mSculptLevel;
+	SculptMap* mSculptMap;
 	
 	LLVolumeParams mParams;
 	LLPath *mPathp;
@@ -966,6 +1012,7 @@ protected:
 	BOOL mGenerateSingleFace;
 	typedef std::vector<LLVolumeFace> face_list_t;
 	face_list_t mVolumeFaces;
+	std::vector<LLPointer<LLVolumeFaceBVH> > mFaceBVHs;
 };
 
 std::ostream& operator<<(std::ostream &s, const LLVolumeParams &volume_params);
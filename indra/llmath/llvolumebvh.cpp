@@ -0,0 +1,440 @@
+/**
+ * @file llvolumebvh.cpp
+ * @brief Bounding volume hierarchy for ray casts against volume faces
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumebvh.h"
+
+#include "llmath.h"
+#include "llvolume.h"
+
+#include <algorithm>
+
+// Pending nodes of a walk. Median splits keep the tree about
+// log2(triangles / BLOCK_SIZE) deep, a walk never has more than that
+// plus one pending.
+const S32 MAX_STACK_DEPTH = 64;
+// Rays walked together by the batched intersect()
+const U32 MAX_PACKET_SIZE = 32;
+
+// Same as LLTriangleRayIntersect() with two_sided FALSE, a lane at a time.
+static S32 intersect_block_scalar(const LLVolumeFaceBVH::TriangleBlock& block, const F32* start, const F32* dir,
+								  F32 max_t, F32& a, F32& b, F32& t)
+{
+	S32 hit = -1;
+	for (S32 i = 0; i < LLVolumeFaceBVH::BLOCK_SIZE; i++)
+	{
+		F32 e1x = block.mEdge1[0][i], e1y = block.mEdge1[1][i], e1z = block.mEdge1[2][i];
+		F32 e2x = block.mEdge2[0][i], e2y = block.mEdge2[1][i], e2z = block.mEdge2[2][i];
+
+		// pvec = dir x edge2
+		F32 px = dir[1] * e2z - dir[2] * e2y;
+		F32 py = dir[2] * e2x - dir[0] * e2z;
+		F32 pz = dir[0] * e2y - dir[1] * e2x;
+		F32 det = e1x * px + e1y * py + e1z * pz;
+		if (det < F_APPROXIMATELY_ZERO)
+		{
+			continue;
+		}
+
+		F32 tx = start[0] - block.mV0[0][i];
+		F32 ty = start[1] - block.mV0[1][i];
+		F32 tz = start[2] - block.mV0[2][i];
+		F32 u = tx * px + ty * py + tz * pz;
+		if (u < 0.f || u > det)
+		{
+			continue;
+		}
+
+		// qvec = tvec x edge1
+		F32 qx = ty * e1z - tz * e1y;
+		F32 qy = tz * e1x - tx * e1z;
+		F32 qz = tx * e1y - ty * e1x;
+		F32 v = dir[0] * qx + dir[1] * qy + dir[2] * qz;
+		if (v < 0.f || u + v > det)
+		{
+			continue;
+		}
+
+		F32 inv_det = 1.f / det;
+		F32 lane_t = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+		if (lane_t < 0.f || lane_t > max_t)
+		{
+			continue;
+		}
+
+		max_t = lane_t;
+		t = lane_t;
+		a = u * inv_det;
+		b = v * inv_det;
+		hit = i;
+	}
+	return hit;
+}
+
+LLVolumeFaceBVH::intersect_block_t LLVolumeFaceBVH::sKernel = intersect_block_scalar;
+
+// Whether the ray reaches the box with t in [0, max_t]
+static inline bool intersect_box(const F32* min, const F32* max, const F32* start, const F32* inv_dir, F32 max_t)
+{
+	F32 t_near = 0.f;
+	F32 t_far = max_t;
+	for (U32 i = 0; i < 3; i++)
+	{
+		F32 t1 = (min[i] - start[i]) * inv_dir[i];
+		F32 t2 = (max[i] - start[i]) * inv_dir[i];
+		t_near = llmax(t_near, llmin(t1, t2));
+		t_far = llmin(t_far, llmax(t1, t2));
+	}
+	return t_near <= t_far;
+}
+
+static inline void set_ray(const LLVolumeFaceBVH::Ray& ray, F32* start, F32* dir, F32* inv_dir)
+{
+	for (U32 i = 0; i < 3; i++)
+	{
+		start[i] = ray.mStart.mV[i];
+		dir[i] = ray.mDir.mV[i];
+		// Axis parallel rays get a huge rather than an infinite inverse, so
+		// that a start on a box plane gives no NaN
+		F32 d = dir[i];
+		if (fabsf(d) < 1e-20f)
+		{
+			d = (d < 0.f ? -1e-20f : 1e-20f);
+		}
+		inv_dir[i] = 1.f / d;
+	}
+}
+
+struct LLVolumeFaceBVH::CenterLess
+{
+	CenterLess(S32 axis) : mAxis(axis) {}
+
+	bool operator()(const BuildTriangle& lhs, const BuildTriangle& rhs) const
+	{
+		return lhs.mCenter[mAxis] < rhs.mCenter[mAxis];
+	}
+
+	S32 mAxis;
+};
+
+LLVolumeFaceBVH::LLVolumeFaceBVH(const LLVolumeFace& face) :
+	mNumTriangles((S32)face.mIndices.size() / 3)
+{
+	if (mNumTriangles == 0)
+	{
+		return;
+	}
+
+	std::vector<BuildTriangle> triangles(mNumTriangles);
+	for (S32 i = 0; i < mNumTriangles; i++)
+	{
+		const LLVector3& p0 = face.mVertices[face.mIndices[i * 3 + 0]].mPosition;
+		const LLVector3& p1 = face.mVertices[face.mIndices[i * 3 + 1]].mPosition;
+		const LLVector3& p2 = face.mVertices[face.mIndices[i * 3 + 2]].mPosition;
+		BuildTriangle& tri = triangles[i];
+		for (U32 j = 0; j < 3; j++)
+		{
+			tri.mMin[j] = llmin(p0.mV[j], p1.mV[j], p2.mV[j]);
+			tri.mMax[j] = llmax(p0.mV[j], p1.mV[j], p2.mV[j]);
+			tri.mCenter[j] = (tri.mMin[j] + tri.mMax[j]) * 0.5f;
+		}
+		tri.mIndex = i;
+	}
+
+	mNodes.reserve(2 * (mNumTriangles / BLOCK_SIZE + 1));
+	mBlocks.reserve(mNumTriangles / BLOCK_SIZE + 1);
+	mNodes.push_back(Node());
+	build(face, triangles, 0, 0, mNumTriangles);
+}
+
+void LLVolumeFaceBVH::build(const LLVolumeFace& face, std::vector<BuildTriangle>& triangles,
+							S32 node, S32 begin, S32 end)
+{
+	F32 min[3], max[3];
+	F32 center_min[3], center_max[3];
+	for (U32 j = 0; j < 3; j++)
+	{
+		min[j] = center_min[j] = F32_MAX;
+		max[j] = center_max[j] = -F32_MAX;
+	}
+	for (S32 i = begin; i < end; i++)
+	{
+		const BuildTriangle& tri = triangles[i];
+		for (U32 j = 0; j < 3; j++)
+		{
+			min[j] = llmin(min[j], tri.mMin[j]);
+			max[j] = llmax(max[j], tri.mMax[j]);
+			center_min[j] = llmin(center_min[j], tri.mCenter[j]);
+			center_max[j] = llmax(center_max[j], tri.mCenter[j]);
+		}
+	}
+	for (U32 j = 0; j < 3; j++)
+	{
+		// A little slack so that rounding in the box test can't miss a hit
+		// the triangle test finds, flat faces have boxes of no thickness
+		F32 slack = (max[j] - min[j]) * 0.0001f + 0.00001f;
+		mNodes[node].mMin[j] = min[j] - slack;
+		mNodes[node].mMax[j] = max[j] + slack;
+	}
+
+	S32 count = end - begin;
+	if (count <= BLOCK_SIZE)
+	{
+		mNodes[node].mChild = (S32)mBlocks.size();
+		mNodes[node].mCount = count;
+		mBlocks.push_back(TriangleBlock());
+		TriangleBlock& block = mBlocks.back();
+		for (S32 lane = 0; lane < BLOCK_SIZE; lane++)
+		{
+			if (lane < count)
+			{
+				S32 index = triangles[begin + lane].mIndex;
+				const LLVector3& p0 = face.mVertices[face.mIndices[index * 3 + 0]].mPosition;
+				const LLVector3& p1 = face.mVertices[face.mIndices[index * 3 + 1]].mPosition;
+				const LLVector3& p2 = face.mVertices[face.mIndices[index * 3 + 2]].mPosition;
+				for (U32 j = 0; j < 3; j++)
+				{
+					block.mV0[j][lane] = p0.mV[j];
+					block.mEdge1[j][lane] = p1.mV[j] - p0.mV[j];
+					block.mEdge2[j][lane] = p2.mV[j] - p0.mV[j];
+				}
+				block.mTriangle[lane] = index;
+			}
+			else
+			{
+				for (U32 j = 0; j < 3; j++)
+				{
+					block.mV0[j][lane] = 0.f;
+					block.mEdge1[j][lane] = 0.f;
+					block.mEdge2[j][lane] = 0.f;
+				}
+				block.mTriangle[lane] = -1;
+			}
+		}
+		return;
+	}
+
+	// Median split along the longest spread of the triangle centers
+	S32 axis = 0;
+	for (S32 j = 1; j < 3; j++)
+	{
+		if (center_max[j] - center_min[j] > center_max[axis] - center_min[axis])
+		{
+			axis = j;
+		}
+	}
+	S32 mid = begin + count / 2;
+	std::nth_element(triangles.begin() + begin, triangles.begin() + mid, triangles.begin() + end, CenterLess(axis));
+
+	S32 child = (S32)mNodes.size();
+	mNodes[node].mChild = child;
+	mNodes[node].mCount = 0;
+	mNodes.push_back(Node());
+	mNodes.push_back(Node());
+	build(face, triangles, child, begin, mid);
+	build(face, triangles, child + 1, mid, end);
+}
+
+void LLVolumeFaceBVH::intersect(const Ray& ray, F32 max_t, Hit& hit) const
+{
+	hit.mTriangle = -1;
+	hit.mT = max_t;
+	if (mNodes.empty())
+	{
+		return;
+	}
+
+	F32 start[3], dir[3], inv_dir[3];
+	set_ray(ray, start, dir, inv_dir);
+
+	S32 stack[MAX_STACK_DEPTH];
+	S32 depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0)
+	{
+		const Node& node = mNodes[stack[--depth]];
+		if (!intersect_box(node.mMin, node.mMax, start, inv_dir, hit.mT))
+		{
+			continue;
+		}
+
+		if (node.mCount > 0)
+		{
+			const TriangleBlock& block = mBlocks[node.mChild];
+			F32 a, b, t;
+			S32 lane = sKernel(block, start, dir, hit.mT, a, b, t);
+			if (lane >= 0)
+			{
+				hit.mTriangle = block.mTriangle[lane];
+				hit.mA = a;
+				hit.mB = b;
+				hit.mT = t;
+			}
+		}
+		else
+		{
+			// Nearer child on top, so that its hits cull the other one
+			const Node& first = mNodes[node.mChild];
+			const Node& second = mNodes[node.mChild + 1];
+			F32 along = 0.f;
+			for (U32 j = 0; j < 3; j++)
+			{
+				along += (second.mMin[j] + second.mMax[j] - first.mMin[j] - first.mMax[j]) * dir[j];
+			}
+			llassert(depth + 2 <= MAX_STACK_DEPTH);
+			stack[depth++] = along < 0.f ? node.mChild : node.mChild + 1;
+			stack[depth++] = along < 0.f ? node.mChild + 1 : node.mChild;
+		}
+	}
+}
+
+void LLVolumeFaceBVH::intersect(U32 count, const Ray* rays, Hit* hits) const
+{
+	// Rays heading into the same octant agree on which child is nearer,
+	// so only those are walked together
+	std::vector<U32> octant_rays[8];
+	for (U32 i = 0; i < count; i++)
+	{
+		const LLVector3& dir = rays[i].mDir;
+		U32 octant = (dir.mV[VX] < 0.f ? 1 : 0) | (dir.mV[VY] < 0.f ? 2 : 0) | (dir.mV[VZ] < 0.f ? 4 : 0);
+		octant_rays[octant].push_back(i);
+		hits[i].mTriangle = -1;
+	}
+	if (mNodes.empty())
+	{
+		return;
+	}
+
+	for (U32 octant = 0; octant < 8; octant++)
+	{
+		const std::vector<U32>& indices = octant_rays[octant];
+		for (U32 first = 0; first < indices.size(); first += MAX_PACKET_SIZE)
+		{
+			intersectPacket(llmin((U32)indices.size() - first, MAX_PACKET_SIZE), &indices[first], rays, hits);
+		}
+	}
+}
+
+void LLVolumeFaceBVH::intersectPacket(U32 size, const U32* indices, const Ray* rays, Hit* hits) const
+{
+	F32 start[MAX_PACKET_SIZE][3];
+	F32 dir[MAX_PACKET_SIZE][3];
+	F32 inv_dir[MAX_PACKET_SIZE][3];
+	Hit* packet_hits[MAX_PACKET_SIZE];
+	for (U32 i = 0; i < size; i++)
+	{
+		set_ray(rays[indices[i]], start[i], dir[i], inv_dir[i]);
+		packet_hits[i] = hits + indices[i];
+	}
+
+	// Each pending node keeps the rays that reached its parent
+	S32 stack[MAX_STACK_DEPTH];
+	U8 stack_rays[MAX_STACK_DEPTH][MAX_PACKET_SIZE];
+	U32 stack_count[MAX_STACK_DEPTH];
+	S32 depth = 0;
+	stack[depth] = 0;
+	for (U32 i = 0; i < size; i++)
+	{
+		stack_rays[depth][i] = (U8)i;
+	}
+	stack_count[depth++] = size;
+	while (depth > 0)
+	{
+		depth--;
+		const Node& node = mNodes[stack[depth]];
+
+		U8 node_rays[MAX_PACKET_SIZE];
+		U32 node_count = 0;
+		for (U32 k = 0; k < stack_count[depth]; k++)
+		{
+			U8 i = stack_rays[depth][k];
+			if (intersect_box(node.mMin, node.mMax, start[i], inv_dir[i], packet_hits[i]->mT))
+			{
+				node_rays[node_count++] = i;
+			}
+		}
+		if (!node_count)
+		{
+			continue;
+		}
+
+		if (node.mCount > 0)
+		{
+			const TriangleBlock& block = mBlocks[node.mChild];
+			for (U32 k = 0; k < node_count; k++)
+			{
+				U8 i = node_rays[k];
+				F32 a, b, t;
+				Hit& hit = *packet_hits[i];
+				S32 lane = sKernel(block, start[i], dir[i], hit.mT, a, b, t);
+				if (lane >= 0)
+				{
+					hit.mTriangle = block.mTriangle[lane];
+					hit.mA = a;
+					hit.mB = b;
+					hit.mT = t;
+				}
+			}
+		}
+		else
+		{
+			// Ordered along the first ray still in
+			const F32* lead_dir = dir[node_rays[0]];
+			const Node& first = mNodes[node.mChild];
+			const Node& second = mNodes[node.mChild + 1];
+			F32 along = 0.f;
+			for (U32 j = 0; j < 3; j++)
+			{
+				along += (second.mMin[j] + second.mMax[j] - first.mMin[j] - first.mMax[j]) * lead_dir[j];
+			}
+			llassert(depth + 2 <= MAX_STACK_DEPTH);
+			for (U32 c = 0; c < 2; c++)
+			{
+				stack[depth] = (along < 0.f) == (c == 0) ? node.mChild : node.mChild + 1;
+				memcpy(stack_rays[depth], node_rays, node_count);
+				stack_count[depth++] = node_count;
+			}
+		}
+	}
+}
+
+//static
+void LLVolumeFaceBVH::initClass(BOOL use_sse2)
+{
+	sKernel = getScalarKernel();
+	if (use_sse2 && getSSE2Kernel())
+	{
+		sKernel = getSSE2Kernel();
+	}
+	llinfos << "Using " << (sKernel == getScalarKernel() ? "scalar" : "SSE2") << " volume ray tests" << llendl;
+}
+
+//static
+LLVolumeFaceBVH::intersect_block_t LLVolumeFaceBVH::getScalarKernel()
+{
+	return intersect_block_scalar;
+}
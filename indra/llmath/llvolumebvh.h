@@ -0,0 +1,132 @@
+/**
+ * @file llvolumebvh.h
+ * @brief Bounding volume hierarchy for ray casts against volume faces
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMEBVH_H
+#define LL_LLVOLUMEBVH_H
+
+#include "llrefcount.h"
+#include "v3math.h"
+
+#include <vector>
+
+class LLVolumeFace;
+
+// Bounding box hierarchy over the triangles of an LLVolumeFace, so that a
+// ray cast visits the few boxes along the ray instead of every triangle.
+// Leaves hold up to four triangles laid out to be tested at once.
+//
+// The triangle test is picked at startup like LLImageKernels: the SSE2
+// version lives in llvolumebvh_sse2.cpp, the only file built with SSE2
+// code generation, and the scalar one is the reference.
+class LLVolumeFaceBVH : public LLRefCount
+{
+public:
+	static const S32 BLOCK_SIZE = 4;
+
+	// Up to BLOCK_SIZE triangles as structure of arrays. Unused lanes have
+	// zero edges, which no ray hits.
+	struct TriangleBlock
+	{
+		F32 mV0[3][BLOCK_SIZE];
+		F32 mEdge1[3][BLOCK_SIZE];
+		F32 mEdge2[3][BLOCK_SIZE];
+		S32 mTriangle[BLOCK_SIZE];	// index of the triangle in the face, -1 if unused
+	};
+
+	// Ray start + t * dir, hit from the front side only, like
+	// LLTriangleRayIntersect() with two_sided FALSE.
+	struct Ray
+	{
+		LLVector3 mStart;
+		LLVector3 mDir;
+	};
+
+	struct Hit
+	{
+		S32 mTriangle;	// -1 when nothing was hit
+		F32 mA;			// barycentric weights of the second and third vertex
+		F32 mB;
+		F32 mT;
+	};
+
+	// Tests a ray against the triangles of a block. Returns the lane of the
+	// closest hit with t in [0, max_t] and its a, b and t, -1 if none.
+	typedef S32 (*intersect_block_t)(const TriangleBlock& block, const F32* start, const F32* dir,
+									 F32 max_t, F32& a, F32& b, F32& t);
+
+	LLVolumeFaceBVH(const LLVolumeFace& face);
+
+	// Closest hit of the ray with t in [0, max_t].
+	void intersect(const Ray& ray, F32 max_t, Hit& hit) const;
+
+	// The same for count rays, walked through the hierarchy in packets.
+	// Rays that start close and go the same way share most of their boxes.
+	// hits hold the max t of each ray on the way in, as mT.
+	void intersect(U32 count, const Ray* rays, Hit* hits) const;
+
+	S32 getNumNodes() const						{ return (S32)mNodes.size(); }
+	S32 getNumTriangles() const					{ return mNumTriangles; }
+
+	// Picks the triangle test. Called at startup.
+	static void initClass(BOOL use_sse2);
+
+	static intersect_block_t getScalarKernel();
+	// NULL when the library was built without the SSE2 test.
+	static intersect_block_t getSSE2Kernel();
+	// For tests and benchmarks.
+	static void setKernel(intersect_block_t kernel)	{ sKernel = kernel; }
+
+private:
+	struct Node
+	{
+		F32 mMin[3];
+		F32 mMax[3];
+		S32 mChild;		// inner nodes: first of the two children. Leaves: block index.
+		S32 mCount;		// triangles of a leaf, 0 for inner nodes
+	};
+
+	struct BuildTriangle
+	{
+		F32 mMin[3];
+		F32 mMax[3];
+		F32 mCenter[3];
+		S32 mIndex;
+	};
+	struct CenterLess;
+
+	void build(const LLVolumeFace& face, std::vector<BuildTriangle>& triangles,
+			   S32 node, S32 begin, S32 end);
+	// Walks up to 32 rays, rays[indices[i]], through the hierarchy together
+	void intersectPacket(U32 size, const U32* indices, const Ray* rays, Hit* hits) const;
+
+	std::vector<Node> mNodes;
+	std::vector<TriangleBlock> mBlocks;
+	S32 mNumTriangles;
+
+	static intersect_block_t sKernel;
+};
+
+#endif // LL_LLVOLUMEBVH_H
@@ -0,0 +1,142 @@
+/**
+ * @file llvolumebvh_sse2.cpp
+ * @brief SSE2 ray test against a block of four triangles
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+// Keep the includes down to what the test needs, see llimagekernels_sse2.cpp.
+#include "linden_common.h"
+
+#include "llvolumebvh.h"
+
+#include "llmath.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#define LL_VOLUME_BVH_SSE2 1
+#else
+#define LL_VOLUME_BVH_SSE2 0
+#endif
+
+#if LL_VOLUME_BVH_SSE2
+
+#include <emmintrin.h>
+
+// The scalar test of llvolumebvh.cpp on all four lanes at once, with the
+// same operations in the same order so that both find the same hits.
+static S32 intersect_block_sse2(const LLVolumeFaceBVH::TriangleBlock& block, const F32* start, const F32* dir,
+								F32 max_t, F32& a, F32& b, F32& t)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dx = _mm_set1_ps(dir[0]);
+	const __m128 dy = _mm_set1_ps(dir[1]);
+	const __m128 dz = _mm_set1_ps(dir[2]);
+
+	const __m128 e1x = _mm_loadu_ps(block.mEdge1[0]);
+	const __m128 e1y = _mm_loadu_ps(block.mEdge1[1]);
+	const __m128 e1z = _mm_loadu_ps(block.mEdge1[2]);
+	const __m128 e2x = _mm_loadu_ps(block.mEdge2[0]);
+	const __m128 e2y = _mm_loadu_ps(block.mEdge2[1]);
+	const __m128 e2z = _mm_loadu_ps(block.mEdge2[2]);
+
+	// pvec = dir x edge2
+	__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	__m128 mask = _mm_cmpge_ps(det, _mm_set1_ps(F_APPROXIMATELY_ZERO));
+	if (!_mm_movemask_ps(mask))
+	{
+		return -1;
+	}
+
+	__m128 tx = _mm_sub_ps(_mm_set1_ps(start[0]), _mm_loadu_ps(block.mV0[0]));
+	__m128 ty = _mm_sub_ps(_mm_set1_ps(start[1]), _mm_loadu_ps(block.mV0[1]));
+	__m128 tz = _mm_sub_ps(_mm_set1_ps(start[2]), _mm_loadu_ps(block.mV0[2]));
+	__m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_mul_ps(ty, py)), _mm_mul_ps(tz, pz));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, det)));
+
+	// qvec = tvec x edge1
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+	__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), det)));
+	if (!_mm_movemask_ps(mask))
+	{
+		return -1;
+	}
+
+	__m128 inv_det = _mm_div_ps(_mm_set1_ps(1.f), det);
+	__m128 lane_t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)),
+							   inv_det);
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(lane_t, zero), _mm_cmple_ps(lane_t, _mm_set1_ps(max_t))));
+	S32 lanes = _mm_movemask_ps(mask);
+	if (!lanes)
+	{
+		return -1;
+	}
+
+	F32 t_lanes[LLVolumeFaceBVH::BLOCK_SIZE];
+	F32 u_lanes[LLVolumeFaceBVH::BLOCK_SIZE];
+	F32 v_lanes[LLVolumeFaceBVH::BLOCK_SIZE];
+	F32 inv_det_lanes[LLVolumeFaceBVH::BLOCK_SIZE];
+	_mm_storeu_ps(t_lanes, lane_t);
+	_mm_storeu_ps(u_lanes, u);
+	_mm_storeu_ps(v_lanes, v);
+	_mm_storeu_ps(inv_det_lanes, inv_det);
+
+	// Like the scalar test, a later lane wins a tie
+	S32 hit = -1;
+	for (S32 i = 0; i < LLVolumeFaceBVH::BLOCK_SIZE; i++)
+	{
+		if ((lanes & (1 << i)) && t_lanes[i] <= max_t)
+		{
+			max_t = t_lanes[i];
+			hit = i;
+		}
+	}
+	t = t_lanes[hit];
+	a = u_lanes[hit] * inv_det_lanes[hit];
+	b = v_lanes[hit] * inv_det_lanes[hit];
+	return hit;
+}
+
+//static
+LLVolumeFaceBVH::intersect_block_t LLVolumeFaceBVH::getSSE2Kernel()
+{
+	return intersect_block_sse2;
+}
+
+#else // LL_VOLUME_BVH_SSE2
+
+//static
+LLVolumeFaceBVH::intersect_block_t LLVolumeFaceBVH::getSSE2Kernel()
+{
+	return NULL;
+}
+
+#endif // LL_VOLUME_BVH_SSE2
@@ -27,8 +27,13 @@
 
 #include "llvolumemgr.h"
 #include "llmemtype.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
 #include "llvolume.h"
 
+#include <algorithm>
+#include <sstream>
+
 
 const F32 BASE_THRESHOLD = 0.03f;
 
@@ -44,92 +49,324 @@ F32 LLVolumeLODGroup::mDetailScales[NUM_LODS] = {1.f, 1.5f, 2.5f, 4.f};
 
 //============================================================================
 
+namespace
+{
+	void lock_stripe(LLMutex* mutex)
+	{
+		if (mutex)
+		{
+			mutex->lock();
+		}
+	}
+
+	void unlock_stripe(LLMutex* mutex)
+	{
+		if (mutex)
+		{
+			mutex->unlock();
+		}
+	}
+
+	// Equal params must hash the same, so only values compared exactly.
+	U32 hash_params(const LLVolumeParams& params)
+	{
+		const LLProfileParams& profile = params.getProfileParams();
+		const LLPathParams& path = params.getPathParams();
+		U32 hash = params.getSculptID().getCRC32();
+		hash = hash * 31 + profile.getCurveType();
+		hash = hash * 31 + path.getCurveType();
+		hash = hash * 31 + params.getSculptType();
+		hash = hash * 31 + (U32)llround(profile.getBegin() * 1000.f);
+		hash = hash * 31 + (U32)llround(profile.getEnd() * 1000.f);
+		hash = hash * 31 + (U32)llround(profile.getHollow() * 1000.f);
+		hash = hash * 31 + (U32)llround(path.getBegin() * 1000.f);
+		hash = hash * 31 + (U32)llround(path.getEnd() * 1000.f);
+		hash = hash * 31 + (U32)llround(path.getTwist() * 1000.f);
+		return hash ^ (hash >> 16);
+	}
+}
+
+class LLVolumeMgr::Worker : public LLThread
+{
+public:
+	Worker(const std::string& name, LLVolumeMgr* mgr)
+	:	LLThread(name),
+		mMgr(mgr)
+	{
+	}
+
+protected:
+	/*virtual*/ void run()
+	{
+		LLCondition* condition = mMgr->mBuildCondition;
+		condition->lock();
+		while (!mMgr->mQuitting)
+		{
+			if (mMgr->mBuildQueue.empty())
+			{
+				condition->wait();
+				continue;
+			}
+
+			LLVolume* volumep = mMgr->mBuildQueue.front();
+			mMgr->mBuildQueue.pop_front();
+			mMgr->mBuilding.insert(volumep);
+			condition->unlock();
+
+			volumep->build();
+
+			condition->lock();
+			mMgr->mBuilding.erase(volumep);
+			mMgr->mBuilt.push_back(volumep);
+			// Wakes anyone in waitForVolume()
+			condition->broadcast();
+		}
+		condition->unlock();
+	}
+
+private:
+	LLVolumeMgr* mMgr;
+};
+
 LLVolumeMgr::LLVolumeMgr()
-:	mDataMutex(NULL)
+:	mBuildCondition(NULL),
+	mQuitting(false),
+	mParamsTrace(NULL)
 {
 	// the LLMutex magic interferes with easy unit testing,
 	// so you now must manually call useMutex() to use it
-	//mDataMutex = new LLMutex(gAPRPoolp);
 }
 
 LLVolumeMgr::~LLVolumeMgr()
 {
 	cleanup();
 
-	delete mDataMutex;
-	mDataMutex = NULL;
+	for (S32 i = 0; i < NUM_STRIPES; i++)
+	{
+		delete mStripes[i].mMutex;
+		mStripes[i].mMutex = NULL;
+	}
+	delete mBuildCondition;
+	mBuildCondition = NULL;
 }
 
 BOOL LLVolumeMgr::cleanup()
 {
+	stopThreads();
+
 	BOOL no_refs = TRUE;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin(),
-			 end = mVolumeLODGroups.end();
-		 iter != end; iter++)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		if (volgroupp->cleanupRefs() == false)
+		Stripe& stripe = mStripes[i];
+		lock_stripe(stripe.mMutex);
+		for (volume_lod_group_map_t::iterator iter = stripe.mGroups.begin(),
+				 end = stripe.mGroups.end();
+			 iter != end; iter++)
 		{
-			no_refs = FALSE;
+			LLVolumeLODGroup *volgroupp = iter->second;
+			if (volgroupp->cleanupRefs() == false)
+			{
+				no_refs = FALSE;
+			}
+			delete volgroupp;
 		}
- 		delete volgroupp;
-	}
-	mVolumeLODGroups.clear();
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
+		stripe.mGroups.clear();
+		unlock_stripe(stripe.mMutex);
 	}
 	return no_refs;
 }
 
+LLVolumeMgr::Stripe& LLVolumeMgr::getStripe(const LLVolumeParams& volume_params)
+{
+	return mStripes[hash_params(volume_params) % NUM_STRIPES];
+}
+
+const LLVolumeMgr::Stripe& LLVolumeMgr::getStripe(const LLVolumeParams& volume_params) const
+{
+	return mStripes[hash_params(volume_params) % NUM_STRIPES];
+}
+
 // Always only ever store the results of refVolume in a LLPointer
 // Note however that LLVolumeLODGroup that contains the volume
 //  also holds a LLPointer so the volume will only go away after
 //  anything holding the volume and the LODGroup are destroyed
 LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32 detail)
 {
+	LLVolume* volumep = refVolumeAsync(volume_params, detail);
+	waitForVolume(volumep);
+	return volumep;
+}
+
+LLVolume* LLVolumeMgr::refVolumeAsync(const LLVolumeParams& volume_params, const S32 detail,
+									  const LLVolume::SculptMap* sculpt)
+{
+	Stripe& stripe = getStripe(volume_params);
+	lock_stripe(stripe.mMutex);
 	LLVolumeLODGroup* volgroupp;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volume_params);
-	if( iter == mVolumeLODGroups.end() )
+	volume_lod_group_map_t::iterator iter = stripe.mGroups.find(&volume_params);
+	if( iter == stripe.mGroups.end() )
 	{
 		volgroupp = createNewGroup(volume_params);
+		if (mParamsTrace)
+		{
+			LLSDSerialize::toNotation(volume_params.asLLSD(), *mParamsTrace);
+			*mParamsTrace << "\n";
+		}
 	}
 	else
 	{
 		volgroupp = iter->second;
 	}
-	if (mDataMutex)
+
+	BOOL created = FALSE;
+	LLVolume* volumep = volgroupp->refLOD(detail, &created);
+	if (created)
 	{
-		mDataMutex->unlock();
+		if (sculpt)
+		{
+			volumep->setSculptMap(*sculpt);
+		}
+		if (mThreads.empty())
+		{
+			volumep->build();
+			volumep->mReady = TRUE;
+		}
+		else
+		{
+			// Kept alive by the queue even if every LOD reference goes
+			volumep->ref();
+			mBuildCondition->lock();
+			mBuildQueue.push_back(volumep);
+			mBuildCondition->signal();
+			mBuildCondition->unlock();
+		}
 	}
-	return volgroupp->refLOD(detail);
+	unlock_stripe(stripe.mMutex);
+	return volumep;
 }
 
-// virtual
-LLVolumeLODGroup* LLVolumeMgr::getGroup( const LLVolumeParams& volume_params ) const
+void LLVolumeMgr::waitForVolume(LLVolume* volumep)
 {
-	LLVolumeLODGroup* volgroupp = NULL;
-	if (mDataMutex)
+	if (volumep->isReady() || !mBuildCondition)
 	{
-		mDataMutex->lock();
+		return;
 	}
-	volume_lod_group_map_t::const_iterator iter = mVolumeLODGroups.find(&volume_params);
-	if( iter != mVolumeLODGroups.end() )
+
+	mBuildCondition->lock();
+	while (mBuilding.find(volumep) != mBuilding.end())
 	{
-		volgroupp = iter->second;
+		mBuildCondition->wait();
+	}
+	std::deque<LLVolume*>::iterator iter = std::find(mBuildQueue.begin(), mBuildQueue.end(), volumep);
+	if (iter != mBuildQueue.end())
+	{
+		// Quicker to build it here than to wait for its turn
+		mBuildQueue.erase(iter);
+		mBuilding.insert(volumep);
+		mBuildCondition->unlock();
+
+		volumep->build();
+
+		mBuildCondition->lock();
+		mBuilding.erase(volumep);
+		// update() drops the queue's reference
+		mBuilt.push_back(volumep);
+		mBuildCondition->broadcast();
+		mBuildCondition->unlock();
+	}
+	else
+	{
+		// Either built and waiting for update(), or dropped by stopThreads()
+		bool dropped = std::find(mBuilt.begin(), mBuilt.end(), volumep) == mBuilt.end();
+		mBuildCondition->unlock();
+		if (dropped)
+		{
+			volumep->build();
+		}
 	}
-	if (mDataMutex)
+	volumep->mReady = TRUE;
+}
+
+void LLVolumeMgr::update()
+{
+	if (!mBuildCondition)
 	{
-		mDataMutex->unlock();
+		return;
 	}
+
+	std::vector<LLVolume*> built;
+	mBuildCondition->lock();
+	built.swap(mBuilt);
+	mBuildCondition->unlock();
+
+	for (std::vector<LLVolume*>::iterator iter = built.begin(); iter != built.end(); ++iter)
+	{
+		LLVolume* volumep = *iter;
+		volumep->mReady = TRUE;
+		volumep->unref();
+	}
+}
+
+void LLVolumeMgr::startThreads(U32 num_threads)
+{
+	llassert(mBuildCondition && mThreads.empty());
+	if (!mBuildCondition)
+	{
+		return;
+	}
+
+	mQuitting = false;
+	for (U32 i = 0; i < num_threads; i++)
+	{
+		Worker* worker = new Worker(llformat("Volume Builder %u", i), this);
+		mThreads.push_back(worker);
+		worker->start();
+	}
+}
+
+void LLVolumeMgr::stopThreads()
+{
+	if (mThreads.empty())
+	{
+		return;
+	}
+
+	mBuildCondition->lock();
+	mQuitting = true;
+	mBuildCondition->broadcast();
+	mBuildCondition->unlock();
+
+	for (std::vector<Worker*>::iterator iter = mThreads.begin(); iter != mThreads.end(); ++iter)
+	{
+		while (!(*iter)->isStopped())
+		{
+			ms_sleep(1);
+		}
+		delete *iter;
+	}
+	mThreads.clear();
+
+	// Nothing will build what is still queued
+	for (std::deque<LLVolume*>::iterator iter = mBuildQueue.begin(); iter != mBuildQueue.end(); ++iter)
+	{
+		(*iter)->unref();
+	}
+	mBuildQueue.clear();
+	update();
+}
+
+// virtual
+LLVolumeLODGroup* LLVolumeMgr::getGroup( const LLVolumeParams& volume_params ) const
+{
+	LLVolumeLODGroup* volgroupp = NULL;
+	const Stripe& stripe = getStripe(volume_params);
+	lock_stripe(stripe.mMutex);
+	volume_lod_group_map_t::const_iterator iter = stripe.mGroups.find(&volume_params);
+	if( iter != stripe.mGroups.end() )
+	{
+		volgroupp = iter->second;
+	}
+	unlock_stripe(stripe.mMutex);
 	return volgroupp;
 }
 
@@ -141,18 +378,13 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 		return;
 	}
 	const LLVolumeParams* params = &(volumep->getParams());
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(params);
-	if( iter == mVolumeLODGroups.end() )
+	Stripe& stripe = getStripe(*params);
+	lock_stripe(stripe.mMutex);
+	volume_lod_group_map_t::iterator iter = stripe.mGroups.find(params);
+	if( iter == stripe.mGroups.end() )
 	{
 		llerrs << "Warning! Tried to cleanup unknown volume type! " << *params << llendl;
-		if (mDataMutex)
-		{
-			mDataMutex->unlock();
-		}
+		unlock_stripe(stripe.mMutex);
 		return;
 	}
 	else
@@ -162,21 +394,17 @@ void LLVolumeMgr::unrefVolume(LLVolume *volumep)
 		volgroupp->derefLOD(volumep);
 		if (volgroupp->getNumRefs() == 0)
 		{
-			mVolumeLODGroups.erase(params);
+			stripe.mGroups.erase(params);
 			delete volgroupp;
 		}
 	}
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
-	}
-
+	unlock_stripe(stripe.mMutex);
 }
 
 // protected
 void LLVolumeMgr::insertGroup(LLVolumeLODGroup* volgroup)
 {
-	mVolumeLODGroups[volgroup->getVolumeParams()] = volgroup;
+	getStripe(*volgroup->getVolumeParams()).mGroups[volgroup->getVolumeParams()] = volgroup;
 }
 
 // protected
@@ -192,57 +420,61 @@ LLVolumeLODGroup* LLVolumeMgr::createNewGroup(const LLVolumeParams& volume_param
 void LLVolumeMgr::dump()
 {
 	F32 avg = 0.f;
-	if (mDataMutex)
-	{
-		mDataMutex->lock();
-	}
-	for (volume_lod_group_map_t::iterator iter = mVolumeLODGroups.begin(),
-			 end = mVolumeLODGroups.end();
-		 iter != end; iter++)
-	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		avg += volgroupp->dump();
+	int count = 0;
+	for (S32 i = 0; i < NUM_STRIPES; i++)
+	{
+		Stripe& stripe = mStripes[i];
+		lock_stripe(stripe.mMutex);
+		for (volume_lod_group_map_t::iterator iter = stripe.mGroups.begin(),
+				 end = stripe.mGroups.end();
+			 iter != end; iter++)
+		{
+			LLVolumeLODGroup *volgroupp = iter->second;
+			avg += volgroupp->dump();
+		}
+		count += (int)stripe.mGroups.size();
+		unlock_stripe(stripe.mMutex);
 	}
-	int count = (int)mVolumeLODGroups.size();
 	avg = count ? avg / (F32)count : 0.0f;
-	if (mDataMutex)
-	{
-		mDataMutex->unlock();
-	}
 	llinfos << "Average usage of LODs " << avg << llendl;
 }
 
 void LLVolumeMgr::useMutex()
 { 
-	if (!mDataMutex)
+	for (S32 i = 0; i < NUM_STRIPES; i++)
 	{
-		mDataMutex = new LLMutex(gAPRPoolp);
+		if (!mStripes[i].mMutex)
+		{
+			mStripes[i].mMutex = new LLMutex(gAPRPoolp);
+		}
+	}
+	if (!mBuildCondition)
+	{
+		mBuildCondition = new LLCondition(gAPRPoolp);
 	}
 }
 
 std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr)
 {
-	s << "{ numLODgroups=" << volume_mgr.mVolumeLODGroups.size() << ", ";
-
+	S32 num_groups = 0;
 	S32 total_refs = 0;
-	if (volume_mgr.mDataMutex)
-	{
-		volume_mgr.mDataMutex->lock();
-	}
-
-	for (LLVolumeMgr::volume_lod_group_map_t::const_iterator iter = volume_mgr.mVolumeLODGroups.begin();
-		 iter != volume_mgr.mVolumeLODGroups.end(); ++iter)
-	{
-		LLVolumeLODGroup *volgroupp = iter->second;
-		total_refs += volgroupp->getNumRefs();
-		s << ", " << (*volgroupp);
-	}
-
-	if (volume_mgr.mDataMutex)
+	std::ostringstream groups;
+	for (S32 i = 0; i < LLVolumeMgr::NUM_STRIPES; i++)
 	{
-		volume_mgr.mDataMutex->unlock();
+		const LLVolumeMgr::Stripe& stripe = volume_mgr.mStripes[i];
+		lock_stripe(stripe.mMutex);
+		for (LLVolumeMgr::volume_lod_group_map_t::const_iterator iter = stripe.mGroups.begin();
+			 iter != stripe.mGroups.end(); ++iter)
+		{
+			LLVolumeLODGroup *volgroupp = iter->second;
+			total_refs += volgroupp->getNumRefs();
+			groups << ", " << (*volgroupp);
+		}
+		num_groups += (S32)stripe.mGroups.size();
+		unlock_stripe(stripe.mMutex);
 	}
 
+	s << "{ numLODgroups=" << num_groups << ", " << groups.str();
 	s << ", total_refs=" << total_refs << " }";
 	return s;
 }
@@ -289,7 +521,7 @@ bool LLVolumeLODGroup::cleanupRefs()
 	return res;
 }
 
-LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
+LLVolume* LLVolumeLODGroup::refLOD(const S32 detail, BOOL* created)
 {
 	llassert(detail >=0 && detail < NUM_LODS);
 	mAccessCount[detail]++;
@@ -298,7 +530,11 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
 	if (mVolumeLODs[detail].isNull())
 	{
 		LLMemType m1(LLMemType::MTYPE_VOLUME);
-		mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail]);
+		mVolumeLODs[detail] = new LLVolume(mVolumeParams, mDetailScales[detail], FALSE, FALSE, created != NULL);
+		if (created)
+		{
+			*created = TRUE;
+		}
 	}
 	mLODRefs[detail]++;
 	return mVolumeLODs[detail];
@@ -27,7 +27,11 @@
 #ifndef LL_LLVOLUMEMGR_H
 #define LL_LLVOLUMEMGR_H
 
+#include <deque>
+#include <iosfwd>
 #include <map>
+#include <set>
+#include <vector>
 
 #include "llvolume.h"
 #include "llpointer.h"
@@ -54,7 +58,10 @@ public:
 	static void getDetailProximity(const F32 tan_angle, F32 &to_lower, F32& to_higher);
 	static F32 getVolumeScaleFromDetail(const S32 detail);
 
-	LLVolume* refLOD(const S32 detail);
+	// The volume it returns may not be built yet, see LLVolume::isReady().
+	// created is set when it had to make a new one, which the caller must
+	// then build or hand to LLVolumeMgr to build.
+	LLVolume* refLOD(const S32 detail, BOOL* created = NULL);
 	BOOL derefLOD(LLVolume *volumep);
 	S32 getNumRefs() const { return mRefs; }
 	
@@ -86,9 +93,30 @@ public:
 	// whatever calls getVolume() never owns the LLVolume* and
 	// cannot keep references for long since it may be deleted
 	// later.  For best results hold it in an LLPointer<LLVolume>.
+	// Returns a built volume, waiting for it if it is being built.
 	virtual LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail);
 	virtual void unrefVolume(LLVolume *volumep);
 
+	// As refVolume(), but a LOD nobody has built yet is queued for the
+	// generation threads and returned at once; poll LLVolume::isReady()
+	// before using it. sculpt, if given, is the map to sculpt it with.
+	// Without threads it is built right away.
+	LLVolume* refVolumeAsync(const LLVolumeParams& volume_params, const S32 detail,
+							 const LLVolume::SculptMap* sculpt = NULL);
+	// Builds volumep on this thread if it is still queued, or waits for
+	// the thread building it.
+	void waitForVolume(LLVolume* volumep);
+	// Marks the volumes the threads have built as ready. Call every frame.
+	void update();
+
+	// Starts threads to build volumes on. Needs useMutex().
+	void startThreads(U32 num_threads);
+	bool hasThreads() const							{ return !mThreads.empty(); }
+
+	// Writes the params of every new group to trace, a line of LLSD
+	// notation each, for replay by llvolumemgr_test. NULL to stop.
+	void setParamsTrace(std::ostream* trace)		{ mParamsTrace = trace; }
+
 	void dump();
 
 	// manually call this for mutex magic
@@ -97,15 +125,48 @@ public:
 	friend std::ostream& operator<<(std::ostream& s, const LLVolumeMgr& volume_mgr);
 
 protected:
+	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
+
+	// The groups are split over stripes by a hash of their params, each
+	// with its own lock, so lookups from several threads rarely contend.
+	enum { NUM_STRIPES = 16 };
+	struct Stripe
+	{
+		Stripe() : mMutex(NULL) {}
+
+		volume_lod_group_map_t mGroups;
+		LLMutex* mMutex;
+	};
+	Stripe& getStripe(const LLVolumeParams& volume_params);
+	const Stripe& getStripe(const LLVolumeParams& volume_params) const;
+
+	// Call with the stripe of volgroup locked.
 	void insertGroup(LLVolumeLODGroup* volgroup);
 	// Overridden in llphysics/abstract/utils/llphysicsvolumemanager.h
 	virtual LLVolumeLODGroup* createNewGroup(const LLVolumeParams& volume_params);
 
-protected:
-	typedef std::map<const LLVolumeParams*, LLVolumeLODGroup*, LLVolumeParams::compare> volume_lod_group_map_t;
-	volume_lod_group_map_t mVolumeLODGroups;
+private:
+	// Also drops whatever was still queued, which waitForVolume() then
+	// builds on the spot.
+	void stopThreads();
 
-	LLMutex* mDataMutex;
+protected:
+	Stripe mStripes[NUM_STRIPES];
+
+private:
+	class Worker;
+	friend class Worker;
+
+	std::vector<Worker*> mThreads;
+	// Guards the members below, and is signalled when a volume is queued,
+	// when one is built and on shut down.
+	LLCondition* mBuildCondition;
+	std::deque<LLVolume*> mBuildQueue;		// each holds a reference until update()
+	std::set<LLVolume*> mBuilding;
+	std::vector<LLVolume*> mBuilt;
+	bool mQuitting;
+
+	std::ostream* mParamsTrace;
 };
 
 #endif // LL_LLVOLUMEMGR_H
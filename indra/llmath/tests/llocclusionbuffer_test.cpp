@@ -0,0 +1,206 @@
+/**
+ * @file llocclusionbuffer_test.cpp
+ * @brief Tests for the occlusion depth buffer
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llocclusionbuffer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 WIDTH = LLOcclusionBuffer::WIDTH;
+	const S32 HEIGHT = LLOcclusionBuffer::HEIGHT;
+
+	// Two triangles covering [x0, x1] x [y0, y1] at one depth.
+	void draw_rect(LLOcclusionBuffer& buffer, F32 x0, F32 y0, F32 x1, F32 y1, F32 inv_depth)
+	{
+		F32 v[4][3] =
+		{
+			{ x0, y0, inv_depth },
+			{ x1, y0, inv_depth },
+			{ x1, y1, inv_depth },
+			{ x0, y1, inv_depth }
+		};
+		buffer.rasterizeTriangle(v[0], v[1], v[2]);
+		// the other winding
+		buffer.rasterizeTriangle(v[0], v[3], v[2]);
+	}
+
+	// Same sequence on every platform, so a failure can be reproduced.
+	class TestRandom
+	{
+	public:
+		TestRandom() : mState(12345) {}
+		F32 next(F32 min, F32 max)
+		{
+			mState = mState * 1664525 + 1013904223;
+			return min + (max - min) * (F32) (mState >> 8) / (F32) (1 << 24);
+		}
+	private:
+		U32 mState;
+	};
+}
+
+namespace tut
+{
+	struct occlusionbuffer_data
+	{
+		occlusionbuffer_data()
+		:	mBuffer(TRUE)
+		{
+			mBuffer.clear();
+		}
+
+		LLOcclusionBuffer mBuffer;
+	};
+	typedef test_group<occlusionbuffer_data> occlusionbuffer_t;
+	typedef occlusionbuffer_t::object occlusionbuffer_object_t;
+	tut::occlusionbuffer_t tut_occlusionbuffer("LLOcclusionBuffer");
+
+	template<> template<>
+	void occlusionbuffer_object_t::test<1>()
+	{
+		set_test_name("empty buffer");
+
+		mBuffer.buildHierarchy();
+		ensure("nothing occluded", !mBuffer.isRectOccluded(10.f, 10.f, 20.f, 20.f, 0.0001f));
+		ensure("whole screen", !mBuffer.isRectOccluded(0.f, 0.f, WIDTH - 1, HEIGHT - 1, 0.0001f));
+	}
+
+	// A rectangle is occluded only when it is farther than the occluder and
+	// inside its eroded coverage.
+	template<> template<>
+	void occlusionbuffer_object_t::test<2>()
+	{
+		set_test_name("occlusion");
+
+		draw_rect(mBuffer, 32.f, 16.f, 224.f, 112.f, 0.1f);
+		mBuffer.buildHierarchy();
+
+		ensure_approximately_equals("covered", mBuffer.getDepth(0, 100, 50), 0.1f, 16);
+		ensure_equals("edge texel eroded", mBuffer.getDepth(0, 32, 50), 0.f);
+		ensure_approximately_equals("next to the edge", mBuffer.getDepth(0, 33, 50), 0.1f, 16);
+		ensure_equals("outside", mBuffer.getDepth(0, 10, 50), 0.f);
+
+		ensure("behind", mBuffer.isRectOccluded(64.f, 32.f, 128.f, 64.f, 0.05f));
+		ensure("small and behind", mBuffer.isRectOccluded(100.2f, 50.2f, 100.8f, 50.8f, 0.05f));
+		ensure("in front", !mBuffer.isRectOccluded(64.f, 32.f, 128.f, 64.f, 0.2f));
+		ensure("within the bias", !mBuffer.isRectOccluded(64.f, 32.f, 128.f, 64.f, 0.0995f));
+		ensure("past the edge", !mBuffer.isRectOccluded(200.f, 32.f, 230.f, 64.f, 0.05f));
+		ensure("off screen", !mBuffer.isRectOccluded(-1.f, 32.f, 64.f, 64.f, 0.0001f));
+		ensure("off the far side", !mBuffer.isRectOccluded(64.f, 32.f, (F32) WIDTH, 64.f, 0.0001f));
+	}
+
+	// Where triangles overlap the nearest one is kept, and 1/depth is
+	// interpolated across a triangle.
+	template<> template<>
+	void occlusionbuffer_object_t::test<3>()
+	{
+		set_test_name("depth");
+
+		draw_rect(mBuffer, 16.f, 16.f, 240.f, 112.f, 0.1f);
+		draw_rect(mBuffer, 100.f, 40.f, 160.f, 80.f, 0.5f);
+		draw_rect(mBuffer, 20.f, 20.f, 236.f, 108.f, 0.05f);
+
+		// 1/depth from 0.1 at x = 0 to 0.3 at x = 256
+		F32 slope[3][3] =
+		{
+			{ 0.f, 0.f, 0.1f },
+			{ 256.f, 0.f, 0.3f },
+			{ 0.f, 128.f, 0.1f }
+		};
+		LLOcclusionBuffer gradient;
+		gradient.clear();
+		gradient.rasterizeTriangle(slope[0], slope[1], slope[2]);
+		gradient.buildHierarchy();
+		mBuffer.buildHierarchy();
+
+		ensure_approximately_equals("nearest kept", mBuffer.getDepth(0, 130, 60), 0.5f, 16);
+		ensure_approximately_equals("farther ignored", mBuffer.getDepth(0, 50, 60), 0.1f, 16);
+		// eroded texels take the farthest neighbour, x - 1 at its centre
+		ensure_approximately_equals("interpolated", gradient.getDepth(0, 20, 20), 0.1f + 0.2f * 19.5f / 256.f, 12);
+		ensure_approximately_equals("coarse texel inside", mBuffer.getDepth(2, 30, 15), 0.5f, 16);
+		ensure_approximately_equals("coarse texel across", mBuffer.getDepth(2, 24, 15), 0.1f, 16);
+		ensure_equals("coarse texel reaching past the edge", mBuffer.getDepth(LLOcclusionBuffer::NUM_LEVELS - 1, 0, 0), 0.f);
+	}
+
+	// The SSE rasteriser covers the same texels with the same depths as
+	// the scalar one. Without SSE in the build both are scalar.
+	template<> template<>
+	void occlusionbuffer_object_t::test<4>()
+	{
+		set_test_name("SSE matches scalar");
+
+		LLOcclusionBuffer scalar(FALSE);
+		scalar.clear();
+
+		TestRandom rand;
+		for (S32 i = 0; i < 200; ++i)
+		{
+			F32 v[3][3];
+			for (S32 j = 0; j < 3; ++j)
+			{
+				// some vertices off screen, to exercise the clamping
+				v[j][0] = rand.next(-20.f, WIDTH + 20.f);
+				v[j][1] = rand.next(-20.f, HEIGHT + 20.f);
+				v[j][2] = rand.next(0.01f, 1.f);
+			}
+			mBuffer.rasterizeTriangle(v[0], v[1], v[2]);
+			scalar.rasterizeTriangle(v[0], v[1], v[2]);
+		}
+		mBuffer.buildHierarchy();
+		scalar.buildHierarchy();
+
+		S32 covered = 0;
+		for (U32 level = 0; level < LLOcclusionBuffer::NUM_LEVELS; ++level)
+		{
+			for (S32 y = 0; y < (HEIGHT >> level); ++y)
+			{
+				for (S32 x = 0; x < (WIDTH >> level); ++x)
+				{
+					F32 sse_depth = mBuffer.getDepth(level, x, y);
+					F32 scalar_depth = scalar.getDepth(level, x, y);
+					ensure_equals("same coverage", sse_depth > 0.f, scalar_depth > 0.f);
+					ensure_approximately_equals("same depth", sse_depth, scalar_depth, 20);
+					covered += sse_depth > 0.f ? 1 : 0;
+				}
+			}
+		}
+		ensure("something drawn", covered > 0);
+
+		for (S32 i = 0; i < 200; ++i)
+		{
+			F32 x = rand.next(0.f, WIDTH - 16.f);
+			F32 y = rand.next(0.f, HEIGHT - 16.f);
+			F32 size = rand.next(0.f, 16.f);
+			F32 nearest = rand.next(0.01f, 1.f);
+			ensure_equals("same test result",
+				mBuffer.isRectOccluded(x, y, x + size, y + size, nearest),
+				scalar.isRectOccluded(x, y, x + size, y + size, nearest));
+		}
+	}
+}
@@ -0,0 +1,332 @@
+/**
+ * @file llvolumebvh_test.cpp
+ * @brief Tests and timings for ray casts against volume faces
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolumebvh.h"
+#include "../llvolumemgr.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef std::vector<LLVolumeFaceBVH::Ray> ray_list_t;
+	typedef std::vector<LLVolumeFaceBVH::Hit> hit_list_t;
+
+	// A box, a hollow cylinder, a twisted torus and a sphere
+	std::vector<LLVolumeParams> make_params()
+	{
+		std::vector<LLVolumeParams> list;
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		list.push_back(params);
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_LINE);
+		params.setHollow(0.5f);
+		list.push_back(params);
+		params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+		params.setRatio(1.f, 0.25f);
+		params.setHollow(0.f);
+		params.setTwistEnd(0.5f);
+		list.push_back(params);
+		params = LLVolumeParams();
+		params.setType(LL_PCODE_PROFILE_CIRCLE_HALF, LL_PCODE_PATH_CIRCLE);
+		list.push_back(params);
+		return list;
+	}
+
+	F32 random_coord()
+	{
+		return ll_frand(2.f) - 1.f;
+	}
+
+	// Segments between random points around the unit volume, so that
+	// about half of them go through it.
+	ray_list_t make_random_rays(U32 count)
+	{
+		ray_list_t rays(count);
+		for (U32 i = 0; i < count; i++)
+		{
+			rays[i].mStart.setVec(random_coord(), random_coord(), random_coord());
+			LLVector3 end(random_coord(), random_coord(), random_coord());
+			rays[i].mDir = end - rays[i].mStart;
+		}
+		return rays;
+	}
+
+	// Parallel segments through a grid, like an area pick
+	ray_list_t make_grid_rays(U32 size)
+	{
+		ray_list_t rays(size * size);
+		for (U32 x = 0; x < size; x++)
+		{
+			for (U32 y = 0; y < size; y++)
+			{
+				LLVolumeFaceBVH::Ray& ray = rays[x * size + y];
+				ray.mStart.setVec((F32)x / size - 0.5f, (F32)y / size - 0.5f, 1.f);
+				ray.mDir.setVec(0.1f, 0.05f, -2.f);
+			}
+		}
+		return rays;
+	}
+
+	// Closest hit with t in [0, 1] testing every triangle of the face
+	void brute_force_intersect(const LLVolumeFace& face, const LLVolumeFaceBVH::Ray& ray,
+							   LLVolumeFaceBVH::Hit& hit)
+	{
+		hit.mTriangle = -1;
+		hit.mT = 1.f;
+		for (U32 tri = 0; tri < face.mIndices.size() / 3; tri++)
+		{
+			F32 a, b, t;
+			if (LLTriangleRayIntersect(face.mVertices[face.mIndices[tri * 3 + 0]].mPosition,
+									   face.mVertices[face.mIndices[tri * 3 + 1]].mPosition,
+									   face.mVertices[face.mIndices[tri * 3 + 2]].mPosition,
+									   ray.mStart, ray.mDir, &a, &b, &t, FALSE) &&
+				t >= 0.f && t <= hit.mT)
+			{
+				hit.mTriangle = tri;
+				hit.mA = a;
+				hit.mB = b;
+				hit.mT = t;
+			}
+		}
+	}
+
+	// Hits on the same spot. Triangles sharing an edge may both claim it.
+	bool same_hit(const LLVolumeFaceBVH::Hit& a, const LLVolumeFaceBVH::Hit& b)
+	{
+		if (a.mTriangle < 0 || b.mTriangle < 0)
+		{
+			return a.mTriangle == b.mTriangle;
+		}
+		return fabsf(a.mT - b.mT) < 0.0001f;
+	}
+
+	// Rays through every face of the volumes, counting those that hit
+	S32 cast_all(const std::vector<LLPointer<LLVolume> >& volumes, const ray_list_t& rays, bool batched)
+	{
+		S32 hits = 0;
+		hit_list_t face_hits(rays.size());
+		for (U32 v = 0; v < volumes.size(); v++)
+		{
+			for (S32 f = 0; f < volumes[v]->getNumVolumeFaces(); f++)
+			{
+				const LLVolumeFaceBVH* bvh = volumes[v]->getFaceBVH(f);
+				if (batched)
+				{
+					for (U32 i = 0; i < rays.size(); i++)
+					{
+						face_hits[i].mT = 1.f;
+					}
+					bvh->intersect(rays.size(), &rays[0], &face_hits[0]);
+				}
+				for (U32 i = 0; i < rays.size(); i++)
+				{
+					if (!batched)
+					{
+						bvh->intersect(rays[i], 1.f, face_hits[i]);
+					}
+					hits += face_hits[i].mTriangle >= 0 ? 1 : 0;
+				}
+			}
+		}
+		return hits;
+	}
+}
+
+namespace tut
+{
+	struct volumebvh
+	{
+		volumebvh()
+		{
+			std::vector<LLVolumeParams> list = make_params();
+			for (U32 i = 0; i < list.size(); i++)
+			{
+				mVolumes.push_back(mMgr.refVolume(list[i], 3));
+			}
+		}
+
+		~volumebvh()
+		{
+			for (U32 i = 0; i < mVolumes.size(); i++)
+			{
+				mMgr.unrefVolume(mVolumes[i]);
+			}
+			mVolumes.clear();
+			mMgr.cleanup();
+			LLVolumeFaceBVH::setKernel(LLVolumeFaceBVH::getScalarKernel());
+		}
+
+		LLVolumeMgr mMgr;
+		std::vector<LLPointer<LLVolume> > mVolumes;
+	};
+	typedef test_group<volumebvh> volumebvh_t;
+	typedef volumebvh_t::object volumebvh_object_t;
+	tut::volumebvh_t tut_volumebvh("LLVolumeFaceBVH");
+
+	template<> template<>
+	void volumebvh_object_t::test<1>()
+	{
+		set_test_name("hierarchy finds the hits of every triangle");
+		ray_list_t rays = make_random_rays(500);
+		for (U32 v = 0; v < mVolumes.size(); v++)
+		{
+			for (S32 f = 0; f < mVolumes[v]->getNumVolumeFaces(); f++)
+			{
+				const LLVolumeFace& face = mVolumes[v]->getVolumeFace(f);
+				const LLVolumeFaceBVH* bvh = mVolumes[v]->getFaceBVH(f);
+				ensure_equals("all triangles", bvh->getNumTriangles(), (S32)face.mIndices.size() / 3);
+				ensure("cached", mVolumes[v]->getFaceBVH(f) == bvh);
+				for (U32 i = 0; i < rays.size(); i++)
+				{
+					LLVolumeFaceBVH::Hit expected, hit;
+					brute_force_intersect(face, rays[i], expected);
+					bvh->intersect(rays[i], 1.f, hit);
+					ensure("same hit", same_hit(expected, hit));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void volumebvh_object_t::test<2>()
+	{
+		set_test_name("SSE2 test finds the same hits");
+		if (!LLVolumeFaceBVH::getSSE2Kernel())
+		{
+			skip("built without the SSE2 test");
+		}
+		ray_list_t rays = make_random_rays(500);
+		for (U32 v = 0; v < mVolumes.size(); v++)
+		{
+			for (S32 f = 0; f < mVolumes[v]->getNumVolumeFaces(); f++)
+			{
+				const LLVolumeFaceBVH* bvh = mVolumes[v]->getFaceBVH(f);
+				for (U32 i = 0; i < rays.size(); i++)
+				{
+					LLVolumeFaceBVH::Hit scalar_hit, sse2_hit;
+					LLVolumeFaceBVH::setKernel(LLVolumeFaceBVH::getScalarKernel());
+					bvh->intersect(rays[i], 1.f, scalar_hit);
+					LLVolumeFaceBVH::setKernel(LLVolumeFaceBVH::getSSE2Kernel());
+					bvh->intersect(rays[i], 1.f, sse2_hit);
+					ensure("same hit", same_hit(scalar_hit, sse2_hit));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void volumebvh_object_t::test<3>()
+	{
+		set_test_name("batched casts find the same hits");
+		ray_list_t rays = make_random_rays(300);
+		ray_list_t grid = make_grid_rays(16);
+		rays.insert(rays.end(), grid.begin(), grid.end());
+
+		std::vector<LLVector3> starts, ends;
+		for (U32 i = 0; i < rays.size(); i++)
+		{
+			starts.push_back(rays[i].mStart);
+			ends.push_back(rays[i].mStart + rays[i].mDir);
+		}
+
+		for (U32 v = 0; v < mVolumes.size(); v++)
+		{
+			std::vector<LLVolume::SegmentHit> hits(rays.size());
+			mVolumes[v]->lineSegmentIntersect(rays.size(), &starts[0], &ends[0], -1, &hits[0]);
+			for (U32 i = 0; i < rays.size(); i++)
+			{
+				LLVector3 intersection;
+				LLVector3 normal;
+				S32 face = mVolumes[v]->lineSegmentIntersect(starts[i], ends[i], -1, &intersection, NULL, &normal);
+				ensure_equals("same face", hits[i].mFace, face);
+				if (face >= 0)
+				{
+					ensure("same point", dist_vec(hits[i].mIntersection, intersection) < 0.0001f);
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void volumebvh_object_t::test<4>()
+	{
+		set_test_name("ray cast benchmark");
+		ray_list_t random_rays = make_random_rays(4096);
+		ray_list_t grid_rays = make_grid_rays(64);
+
+		S32 triangles = 0;
+		for (U32 v = 0; v < mVolumes.size(); v++)
+		{
+			for (S32 f = 0; f < mVolumes[v]->getNumVolumeFaces(); f++)
+			{
+				triangles += mVolumes[v]->getFaceBVH(f)->getNumTriangles();
+			}
+		}
+
+		LLTimer timer;
+		U32 brute_rays = 256;
+		for (U32 v = 0; v < mVolumes.size(); v++)
+		{
+			for (S32 f = 0; f < mVolumes[v]->getNumVolumeFaces(); f++)
+			{
+				for (U32 i = 0; i < brute_rays; i++)
+				{
+					LLVolumeFaceBVH::Hit hit;
+					brute_force_intersect(mVolumes[v]->getVolumeFace(f), random_rays[i], hit);
+				}
+			}
+		}
+		F64 brute_time = timer.getElapsedTimeF64();
+		llinfos << triangles << " triangles, every triangle: " << brute_rays / brute_time << " rays/s" << llendl;
+
+		LLVolumeFaceBVH::intersect_block_t kernels[] = { LLVolumeFaceBVH::getScalarKernel(),
+														 LLVolumeFaceBVH::getSSE2Kernel() };
+		const char* kernel_names[] = { "scalar", "SSE2" };
+		for (U32 k = 0; k < LL_ARRAY_SIZE(kernels); k++)
+		{
+			if (!kernels[k])
+			{
+				continue;
+			}
+			LLVolumeFaceBVH::setKernel(kernels[k]);
+			for (S32 batched = 0; batched < 2; batched++)
+			{
+				timer.reset();
+				S32 random_hits = cast_all(mVolumes, random_rays, batched);
+				F64 random_time = timer.getElapsedTimeAndResetF64();
+				S32 grid_hits = cast_all(mVolumes, grid_rays, batched);
+				F64 grid_time = timer.getElapsedTimeF64();
+				llinfos << kernel_names[k] << (batched ? " batched" : " single") << ": random "
+						<< random_rays.size() / random_time << " rays/s (" << random_hits << " hits), grid "
+						<< grid_rays.size() / grid_time << " rays/s (" << grid_hits << " hits)" << llendl;
+			}
+		}
+	}
+}
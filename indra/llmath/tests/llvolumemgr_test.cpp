@@ -0,0 +1,293 @@
+/**
+ * @file llvolumemgr_test.cpp
+ * @brief Tests and timings for building volumes in the background
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolumemgr.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	typedef std::vector<LLVolumeParams> params_list_t;
+	// As in the viewer, callers hold on to their volumes with LLPointers
+	typedef std::vector<LLPointer<LLVolume> > volume_list_t;
+
+	// Boxes, cylinders, prisms, spheres and tori, with the cuts, hollows
+	// and twists that change how they are built.
+	params_list_t make_params()
+	{
+		const U8 profiles[] = { LL_PCODE_PROFILE_SQUARE, LL_PCODE_PROFILE_CIRCLE,
+								LL_PCODE_PROFILE_EQUALTRI, LL_PCODE_PROFILE_CIRCLE_HALF };
+		const U8 paths[] = { LL_PCODE_PATH_LINE, LL_PCODE_PATH_CIRCLE };
+		params_list_t list;
+		for (U32 profile = 0; profile < LL_ARRAY_SIZE(profiles); profile++)
+		{
+			for (U32 path = 0; path < LL_ARRAY_SIZE(paths); path++)
+			{
+				for (S32 variant = 0; variant < 8; variant++)
+				{
+					LLVolumeParams params;
+					params.setType(profiles[profile], paths[path]);
+					if (paths[path] == LL_PCODE_PATH_CIRCLE && profiles[profile] != LL_PCODE_PROFILE_CIRCLE_HALF)
+					{
+						params.setRatio(1.f, 0.25f);
+					}
+					params.setBeginAndEndS((variant & 1) ? 0.25f : 0.f, 1.f);
+					params.setHollow((variant & 2) ? 0.5f : 0.f);
+					params.setTwistEnd((variant & 4) ? 0.5f : 0.f);
+					list.push_back(params);
+				}
+			}
+		}
+		return list;
+	}
+
+	// A trace written with VolumeParamsTraceFile, if LL_VOLUME_PARAMS_TRACE
+	// names one.
+	bool read_trace(params_list_t& list)
+	{
+		const char* filename = getenv("LL_VOLUME_PARAMS_TRACE");
+		if (!filename)
+		{
+			return false;
+		}
+		std::ifstream trace(filename);
+		std::string line;
+		while (std::getline(trace, line))
+		{
+			std::istringstream str(line);
+			LLSD sd;
+			LLVolumeParams params;
+			if (LLSDSerialize::fromNotation(sd, str, (S32)line.size()) > 0 && params.fromLLSD(sd))
+			{
+				list.push_back(params);
+			}
+		}
+		return !list.empty();
+	}
+
+	bool same_geometry(const LLVolume* a, const LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces())
+		{
+			return false;
+		}
+		for (S32 i = 0; i < a->getNumVolumeFaces(); i++)
+		{
+			if (a->getVolumeFace(i).mVertices.size() != b->getVolumeFace(i).mVertices.size() ||
+				a->getVolumeFace(i).mIndices != b->getVolumeFace(i).mIndices)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Runs update() until every volume is ready. Returns false on a time out.
+	bool wait_until_ready(LLVolumeMgr& mgr, const volume_list_t& volumes)
+	{
+		LLTimer timer;
+		while (timer.getElapsedTimeF32() < 30.f)
+		{
+			mgr.update();
+			bool ready = true;
+			for (U32 i = 0; i < volumes.size(); i++)
+			{
+				ready = ready && volumes[i]->isReady();
+			}
+			if (ready)
+			{
+				return true;
+			}
+			ms_sleep(1);
+		}
+		return false;
+	}
+}
+
+namespace tut
+{
+	struct volumemgr
+	{
+	};
+	typedef test_group<volumemgr> volumemgr_t;
+	typedef volumemgr_t::object volumemgr_object_t;
+	tut::volumemgr_t tut_volumemgr("LLVolumeMgr");
+
+	template<> template<>
+	void volumemgr_object_t::test<1>()
+	{
+		set_test_name("refVolume builds at once and shares LODs");
+		LLVolumeMgr mgr;
+		LLVolumeParams params = make_params()[0];
+		LLPointer<LLVolume> volume = mgr.refVolume(params, 2);
+		ensure("ready", volume->isReady());
+		ensure("has faces", volume->getNumVolumeFaces() > 0);
+		ensure("shared", mgr.refVolume(params, 2) == volume);
+		ensure("other LOD", mgr.refVolume(params, 1) != volume);
+		ensure_equals("one group", mgr.getGroup(params)->getNumRefs(), 3);
+
+		// Without threads the async call builds at once too
+		LLPointer<LLVolume> async_volume = mgr.refVolumeAsync(params, 3);
+		ensure("async without threads ready", async_volume->isReady());
+		ensure_equals("four refs", mgr.getGroup(params)->getNumRefs(), 4);
+
+		mgr.unrefVolume(async_volume);
+		mgr.unrefVolume(volume);
+		mgr.unrefVolume(volume);
+		ensure_equals("one ref left", mgr.getGroup(params)->getNumRefs(), 1);
+		LLPointer<LLVolume> other_volume = mgr.refVolume(params, 1);
+		mgr.unrefVolume(other_volume);
+		ensure("group kept while referenced", mgr.getGroup(params) != NULL);
+		ensure("reported remaining refs", !mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object_t::test<2>()
+	{
+		set_test_name("threads build the same geometry");
+		params_list_t list = make_params();
+		LLVolumeMgr sync_mgr;
+		LLVolumeMgr async_mgr;
+		async_mgr.useMutex();
+		async_mgr.startThreads(2);
+
+		volume_list_t sync_volumes;
+		volume_list_t async_volumes;
+		for (U32 i = 0; i < list.size(); i++)
+		{
+			sync_volumes.push_back(sync_mgr.refVolume(list[i], 3));
+			async_volumes.push_back(async_mgr.refVolumeAsync(list[i], 3));
+		}
+		ensure("all built", wait_until_ready(async_mgr, async_volumes));
+		for (U32 i = 0; i < list.size(); i++)
+		{
+			ensure("same geometry", same_geometry(sync_volumes[i], async_volumes[i]));
+			sync_mgr.unrefVolume(sync_volumes[i]);
+			async_mgr.unrefVolume(async_volumes[i]);
+		}
+		ensure("sync refs released", sync_mgr.cleanup());
+		ensure("async refs released", async_mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object_t::test<3>()
+	{
+		set_test_name("waiting and dropping queued volumes");
+		params_list_t list = make_params();
+		LLVolumeMgr mgr;
+		mgr.useMutex();
+		mgr.startThreads(1);
+
+		volume_list_t volumes;
+		for (U32 i = 0; i < list.size(); i++)
+		{
+			volumes.push_back(mgr.refVolumeAsync(list[i], 0));
+		}
+		// The last one is likely still queued, and gets built right here
+		mgr.waitForVolume(volumes.back());
+		ensure("waited for volume ready", volumes.back()->isReady());
+		ensure("refVolume returns it built", mgr.refVolume(list.back(), 0) == volumes.back());
+		mgr.unrefVolume(volumes.back());
+
+		// Nobody wants them any more while they build
+		for (U32 i = 0; i < volumes.size(); i++)
+		{
+			mgr.unrefVolume(volumes[i]);
+		}
+		for (S32 i = 0; i < 10; i++)
+		{
+			mgr.update();
+			ms_sleep(1);
+		}
+		ensure("refs released", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumemgr_object_t::test<4>()
+	{
+		set_test_name("volume build benchmark");
+		// Replays the shapes of a recorded scene when given one, see
+		// VolumeParamsTraceFile.
+		params_list_t list;
+		if (!read_trace(list))
+		{
+			list = make_params();
+		}
+		const U32 THREADS = 4;
+
+		LLTimer timer;
+		{
+			LLVolumeMgr mgr;
+			volume_list_t volumes;
+			for (U32 i = 0; i < list.size(); i++)
+			{
+				for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+				{
+					volumes.push_back(mgr.refVolume(list[i], detail));
+				}
+			}
+			F64 sync_time = timer.getElapsedTimeAndResetF64();
+			for (U32 i = 0; i < volumes.size(); i++)
+			{
+				mgr.unrefVolume(volumes[i]);
+			}
+			llinfos << list.size() << " shapes, " << volumes.size() << " volumes built on the main thread in "
+					<< sync_time * 1000.0 << " ms" << llendl;
+		}
+
+		{
+			LLVolumeMgr mgr;
+			mgr.useMutex();
+			mgr.startThreads(THREADS);
+			timer.reset();
+			volume_list_t volumes;
+			for (U32 i = 0; i < list.size(); i++)
+			{
+				for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+				{
+					volumes.push_back(mgr.refVolumeAsync(list[i], detail));
+				}
+			}
+			F64 queue_time = timer.getElapsedTimeF64();
+			ensure("all built", wait_until_ready(mgr, volumes));
+			F64 async_time = timer.getElapsedTimeF64();
+			for (U32 i = 0; i < volumes.size(); i++)
+			{
+				mgr.unrefVolume(volumes[i]);
+			}
+			llinfos << volumes.size() << " volumes built on " << THREADS << " threads in "
+					<< async_time * 1000.0 << " ms, main thread busy for " << queue_time * 1000.0 << " ms" << llendl;
+		}
+	}
+}
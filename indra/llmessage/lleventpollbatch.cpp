@@ -0,0 +1,137 @@
+/**
+ * @file lleventpollbatch.cpp
+ * @brief Parsed event queue replies and the responder that reads them.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+#include "lleventpollbatch.h"
+
+#include "llbufferstream.h"
+#include "llhttpstatuscodes.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+
+static const std::string BINARY_CONTENT_TYPE("application/llsd+binary");
+static const std::string ACCEPT_EVENTS(BINARY_CONTENT_TYPE + ", application/llsd+xml;q=0.5");
+
+LLEventPollBatch::LLEventPollBatch() :
+	mReceivedTime(0.0),
+	mBinary(false),
+	mBodyBytes(0),
+	mParseSeconds(0.f)
+{
+}
+
+bool LLEventPollBatch::parse(const std::string& content_type,
+							 const LLChannelDescriptors& channels,
+							 const LLIOPipe::buffer_ptr_t& buffer)
+{
+	LLTimer parse_timer;
+	mBodyBytes = buffer->countAfter(channels.in(), NULL);
+	mBinary = (content_type.compare(0, BINARY_CONTENT_TYPE.size(), BINARY_CONTENT_TYPE) == 0);
+
+	LLSD reply;
+	LLBufferStream istr(channels, buffer.get());
+	bool parsed;
+	if (mBinary)
+	{
+		S32 max_bytes = mBodyBytes;
+		if (istr.peek() == '<')
+		{
+			// skip the optional <?llsd/binary?> header line
+			std::string header;
+			std::getline(istr, header);
+			max_bytes -= (S32)header.size() + 1;
+		}
+		parsed = (LLSDSerialize::fromBinary(reply, istr, max_bytes) != LLSDParser::PARSE_FAILURE);
+	}
+	else
+	{
+		parsed = (LLSDSerialize::fromXML(reply, istr) != LLSDParser::PARSE_FAILURE);
+	}
+	mParseSeconds = parse_timer.getElapsedTimeF32();
+
+	return parsed && setReply(reply);
+}
+
+bool LLEventPollBatch::setReply(const LLSD& reply)
+{
+	if (!reply.has("events") || !reply.has("id"))
+	{
+		return false;
+	}
+	mID = reply["id"];
+	mEvents = reply["events"];
+	return true;
+}
+
+//static
+void LLEventPollBatchResponder::post(const std::string& url,
+									 const LLSD& ack,
+									 bool done,
+									 LLHTTPClient::ResponderPtr responder)
+{
+	LLSD request;
+	request["ack"] = ack;
+	request["done"] = done;
+
+	LLSD headers;
+	headers["Accept"] = ACCEPT_EVENTS;
+	LLHTTPClient::post(url, request, responder, headers);
+}
+
+//virtual
+void LLEventPollBatchResponder::completedHeader(U32 status,
+												const std::string& reason,
+												const LLSD& content)
+{
+	// header names come through lower case
+	mContentType = content["content-type"].asString();
+}
+
+//virtual
+void LLEventPollBatchResponder::completedRaw(U32 status,
+											 const std::string& reason,
+											 const LLChannelDescriptors& channels,
+											 const LLIOPipe::buffer_ptr_t& buffer)
+{
+	if (!isGoodStatus(status))
+	{
+		// Error bodies, like the 502 that means there were no events,
+		// aren't event queue replies, don't try to parse them.
+		completed(status, reason, LLSD());
+		return;
+	}
+
+	LLEventPollBatch::ptr_t batch = new LLEventPollBatch();
+	batch->mReceivedTime = LLTimer::getTotalSeconds();
+	if (batch->parse(mContentType, channels, buffer))
+	{
+		batchReceived(batch);
+	}
+	else
+	{
+		badReply(status, reason);
+	}
+}
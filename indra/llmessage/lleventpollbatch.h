@@ -0,0 +1,109 @@
+/**
+ * @file lleventpollbatch.h
+ * @brief Parsed event queue replies and the responder that reads them.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLEVENTPOLLBATCH_H
+#define LL_LLEVENTPOLLBATCH_H
+
+#include "llhttpclient.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "llsd.h"
+#include <string>
+
+/**
+ * One event queue reply: the id to acknowledge and the events it carried,
+ * already parsed from the wire format.
+ */
+class LLEventPollBatch : public LLRefCount
+{
+public:
+	typedef LLPointer<LLEventPollBatch> ptr_t;
+
+	LLEventPollBatch();
+
+	/// Parses a reply body, as binary LLSD if content_type says so and as
+	/// XML otherwise. Returns false if it isn't a valid event queue reply.
+	bool parse(const std::string& content_type,
+			   const LLChannelDescriptors& channels,
+			   const LLIOPipe::buffer_ptr_t& buffer);
+
+	/// Takes an already parsed reply. Returns false if it has no "id" or
+	/// "events" key.
+	bool setReply(const LLSD& reply);
+
+	const LLSD& getID() const { return mID; }
+	const LLSD& getEvents() const { return mEvents; }
+	S32 getEventCount() const { return mEvents.size(); }
+
+	bool isBinary() const { return mBinary; }
+	S32 getBodyBytes() const { return mBodyBytes; }
+	F32 getParseSeconds() const { return mParseSeconds; }
+
+	/// Set by the poller when the reply arrives, used for latency accounting.
+	F64 mReceivedTime;
+
+private:
+	LLSD mID;
+	LLSD mEvents;
+	bool mBinary;
+	S32 mBodyBytes;
+	F32 mParseSeconds;
+};
+
+/**
+ * Responder for one event queue long-poll. The reply is parsed as soon
+ * as it has been read, whatever its format, and handed over whole to
+ * batchReceived(). Errors still go through error().
+ */
+class LLEventPollBatchResponder : public LLHTTPClient::Responder
+{
+public:
+	/// Posts an event queue request offering binary LLSD ahead of XML.
+	static void post(const std::string& url,
+					 const LLSD& ack,
+					 bool done,
+					 LLHTTPClient::ResponderPtr responder);
+
+	/*virtual*/ void completedHeader(U32 status,
+									 const std::string& reason,
+									 const LLSD& content);
+	/*virtual*/ void completedRaw(U32 status,
+								  const std::string& reason,
+								  const LLChannelDescriptors& channels,
+								  const LLIOPipe::buffer_ptr_t& buffer);
+
+protected:
+	/// Called with every reply that parsed.
+	virtual void batchReceived(LLEventPollBatch::ptr_t batch) = 0;
+
+	/// Called for a 2xx reply that didn't parse.
+	virtual void badReply(U32 status, const std::string& reason) = 0;
+
+private:
+	std::string mContentType;
+};
+
+#endif // LL_LLEVENTPOLLBATCH_H
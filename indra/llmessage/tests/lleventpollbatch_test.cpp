@@ -0,0 +1,167 @@
+/**
+ * @file   lleventpollbatch_test.cpp
+ * @brief  Test event queue replies served by a local stand-in.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Precompiled header
+#include "linden_common.h"
+// associated header
+#include "lleventpollbatch.h"
+// other Linden headers
+#include "../test/lltut.h"
+#include "llevents.h"
+#include "llhost.h"
+#include "stringize.h"
+#include "tests/networkio.h"
+
+namespace
+{
+	// Records what one poll came back with and wakes up the test.
+	class TestBatchResponder : public LLEventPollBatchResponder
+	{
+	public:
+		TestBatchResponder() : mStatus(0), mBadReply(false) {}
+
+		LLEventPollBatch::ptr_t mBatch;
+		U32 mStatus;
+		bool mBadReply;
+
+	protected:
+		/*virtual*/ void batchReceived(LLEventPollBatch::ptr_t batch)
+		{
+			mBatch = batch;
+			finish();
+		}
+		/*virtual*/ void badReply(U32 status, const std::string& reason)
+		{
+			mBadReply = true;
+			mStatus = status;
+			finish();
+		}
+		/*virtual*/ void error(U32 status, const std::string& reason)
+		{
+			mStatus = status;
+			finish();
+		}
+
+	private:
+		void finish()
+		{
+			LLEventPumps::instance().obtain("done").post(true);
+		}
+	};
+}
+
+/*****************************************************************************
+*   TUT
+*****************************************************************************/
+namespace tut
+{
+	struct lleventpollbatch_data
+	{
+		NetworkIO& netio;
+		std::string server;
+
+		lleventpollbatch_data():
+			netio(NetworkIO::instance()),
+			server(STRINGIZE("http://" << LLHost("127.0.0.1", 8002).getString() << "/"))
+		{
+		}
+
+		// Polls the stand-in once and waits for the reply.
+		boost::intrusive_ptr<TestBatchResponder> poll(const std::string& path, S32 ack)
+		{
+			boost::intrusive_ptr<TestBatchResponder> responder(new TestBatchResponder());
+			LLEventPollBatchResponder::post(server + path, LLSD(ack), false, responder.get());
+			ensure("stand-in replied", netio.pump());
+			return responder;
+		}
+
+		void ensure_canned_events(const LLEventPollBatch& batch, S32 ack)
+		{
+			ensure_equals("ack advanced", batch.getID().asInteger(), ack + 1);
+			ensure_equals("event count", batch.getEventCount(), 3);
+			const LLSD& events = batch.getEvents();
+			ensure_equals(events[0]["message"].asString(), std::string("EstablishAgentCommunication"));
+			ensure_equals(events[1]["message"].asString(), std::string("TeleportFinish"));
+			ensure_equals(events[1]["body"]["Info"][0]["SimPort"].asInteger(), 13005);
+			ensure_equals(events[2]["message"].asString(), std::string("CrossedRegion"));
+		}
+	};
+	typedef test_group<lleventpollbatch_data> lleventpollbatch_group;
+	typedef lleventpollbatch_group::object lleventpollbatch_object;
+	lleventpollbatch_group lleventpollbatchgrp("lleventpollbatch");
+
+	template<> template<>
+	void lleventpollbatch_object::test<1>()
+	{
+		set_test_name("XML reply");
+		boost::intrusive_ptr<TestBatchResponder> responder = poll("xml", 7);
+		ensure("parsed", responder->mBatch.notNull());
+		ensure("not binary", !responder->mBatch->isBinary());
+		ensure_canned_events(*responder->mBatch, 7);
+	}
+
+	template<> template<>
+	void lleventpollbatch_object::test<2>()
+	{
+		set_test_name("binary reply when accepted");
+		boost::intrusive_ptr<TestBatchResponder> responder = poll("binary", 41);
+		ensure("parsed", responder->mBatch.notNull());
+		ensure("binary", responder->mBatch->isBinary());
+		ensure("body counted", responder->mBatch->getBodyBytes() > 0);
+		ensure_canned_events(*responder->mBatch, 41);
+	}
+
+	template<> template<>
+	void lleventpollbatch_object::test<3>()
+	{
+		set_test_name("502 means no events");
+		boost::intrusive_ptr<TestBatchResponder> responder = poll("timeout", 1);
+		ensure("no batch", responder->mBatch.isNull());
+		ensure_equals(responder->mStatus, 502U);
+	}
+
+	template<> template<>
+	void lleventpollbatch_object::test<4>()
+	{
+		set_test_name("reply that isn't an event queue reply");
+		boost::intrusive_ptr<TestBatchResponder> responder = poll("noevents", 1);
+		ensure("no batch", responder->mBatch.isNull());
+		ensure("bad reply", responder->mBadReply);
+	}
+
+	template<> template<>
+	void lleventpollbatch_object::test<5>()
+	{
+		set_test_name("setReply");
+		LLEventPollBatch batch;
+		ensure("missing keys", !batch.setReply(LLSD::emptyMap()));
+		LLSD reply;
+		reply["id"] = 3;
+		reply["events"] = LLSD::emptyArray();
+		ensure("empty events", batch.setReply(reply));
+		ensure_equals(batch.getEventCount(), 0);
+	}
+}
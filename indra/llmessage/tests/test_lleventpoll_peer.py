@@ -0,0 +1,107 @@
+#!/usr/bin/python
+"""\
+@file   test_lleventpoll_peer.py
+@brief  This script asynchronously runs the executable (with args) specified on
+        the command line, returning its result code. While that executable is
+        running, we stand in for a simulator event queue, serving canned
+        replies to event poll requests.
+
+$LicenseInfo:firstyear=2010&license=viewerlgpl$
+Second Life Viewer Source Code
+Copyright (C) 2010, Linden Research, Inc.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation;
+version 2.1 of the License only.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+$/LicenseInfo$
+"""
+
+import os
+import sys
+from threading import Thread
+from BaseHTTPServer import HTTPServer, BaseHTTPRequestHandler
+
+mydir = os.path.dirname(__file__)       # expected to be .../indra/llmessage/tests/
+sys.path.insert(0, os.path.join(mydir, os.pardir, os.pardir, "lib", "python"))
+from indra.base import llsd
+from testrunner import run, debug
+
+def canned_events(ack):
+    """The reply a simulator might send during a teleport."""
+    return dict(id=ack + 1,
+                events=[dict(message="EstablishAgentCommunication",
+                             body=dict(seed_capability="http://127.0.0.1:8002/seed",
+                                       sim_ip_and_port="127.0.0.1:13005")),
+                        dict(message="TeleportFinish",
+                             body=dict(Info=[dict(SimPort=13005,
+                                                  RegionHandle=llsd.binary("\0\3\xe8\0\0\3\xe8\0"),
+                                                  TeleportFlags=16)])),
+                        dict(message="CrossedRegion",
+                             body=dict(RegionData=[dict(SimPort=13006)]))])
+
+class EventQueueHandler(BaseHTTPRequestHandler):
+    """Answers event poll POSTs. The path picks the canned reply:
+    /xml      events as XML whatever the request accepts
+    /binary   events as binary LLSD if the request accepts it
+    /timeout  the 502 a simulator sends when there were no events
+    /noevents a well formed reply that isn't an event queue reply
+    """
+    def read(self):
+        try:
+            size = int(self.headers["content-length"])
+        except (KeyError, ValueError):
+            return ""
+        return self.rfile.read(size)
+
+    def do_POST(self):
+        request = llsd.parse(self.read())
+        ack = request.get("ack") or 0
+        path = self.path.strip("/")
+        if path == "timeout":
+            self.send_error(502, "Upstream error: ")
+            return
+        if path == "noevents":
+            self.reply(llsd.format_xml(dict(reply="success")), "application/llsd+xml")
+            return
+        events = canned_events(ack)
+        if path == "binary" and "application/llsd+binary" in self.headers.get("accept", ""):
+            self.reply(llsd.format_binary(events), "application/llsd+binary")
+        else:
+            self.reply(llsd.format_xml(events), "application/llsd+xml")
+
+    def reply(self, body, content_type):
+        self.send_response(200)
+        self.send_header("Content-type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_request(self, code, size=None):
+        # For present purposes, we don't want the request splattered onto
+        # stderr, as it would upset devs watching the test run
+        pass
+
+    def log_error(self, format, *args):
+        # Suppress error output as well
+        pass
+
+class EventQueueServer(Thread):
+    def run(self):
+        httpd = HTTPServer(('127.0.0.1', 8002), EventQueueHandler)
+        debug("Starting event queue stand-in...\n")
+        httpd.serve_forever()
+
+if __name__ == "__main__":
+    sys.exit(run(server=EventQueueServer(name="eventqueue"), *sys.argv[1:]))
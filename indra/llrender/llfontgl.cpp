@@ -51,6 +51,8 @@ F32 LLFontGL::sHorizDPI = 96.f;
 F32 LLFontGL::sScaleX = 1.f;
 F32 LLFontGL::sScaleY = 1.f;
 BOOL LLFontGL::sDisplayFont = TRUE ;
+U32 LLFontGL::sGlyphRunHits = 0;
+U32 LLFontGL::sGlyphRunMisses = 0;
 std::string LLFontGL::sAppDir;
 
 LLColor4 LLFontGL::sShadowColor(0.f, 0.f, 0.f, 1.f);
@@ -68,6 +70,14 @@ const F32 PIXEL_CORRECTION_DISTANCE = 0.01f;
 const F32 PAD_UVY = 0.5f; // half of vertical padding between glyphs in the glyph texture
 const F32 DROP_SHADOW_SOFT_STRENGTH = 0.3f;
 
+// longest string kept in the glyph run cache, and runs per cache generation
+const S32 GLYPH_RUN_MAX_LENGTH = 256;
+const U32 GLYPH_RUN_GENERATION_SIZE = 1024;
+
+// quads per render() batch, and the most a single glyph can add (soft shadow)
+const S32 GLYPH_BATCH_SIZE = 256;
+const S32 MAX_QUADS_PER_GLYPH = 6;
+
 static F32 llfont_round_x(F32 x)
 {
 	//return llfloor((x-LLFontGL::sCurOrigin.mX)/LLFontGL::sScaleX+0.5f)*LLFontGL::sScaleX+LLFontGL::sCurOrigin.mX;
@@ -92,11 +102,14 @@ LLFontGL::~LLFontGL()
 
 void LLFontGL::reset()
 {
+	// the glyph infos the runs point to are deleted
+	clearGlyphRuns();
 	mFontFreetype->reset(sVertDPI, sHorizDPI);
 }
 
 void LLFontGL::destroyGL()
 {
+	clearGlyphRuns();
 	mFontFreetype->destroyGL();
 }
 
@@ -274,13 +287,14 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 
 	const LLFontGlyphInfo* next_glyph = NULL;
 
-	const S32 GLYPH_BATCH_SIZE = 30;
 	LLVector3 vertices[GLYPH_BATCH_SIZE * 4];
 	LLVector2 uvs[GLYPH_BATCH_SIZE * 4];
 	LLColor4U colors[GLYPH_BATCH_SIZE * 4];
 
 	LLColor4U text_color(color);
 
+	const GlyphRun* run = getGlyphRun(wstr.c_str() + begin_offset, length);
+
 	S32 bitmap_num = -1;
 	S32 glyph_count = 0;
 	for (i = begin_offset; i < begin_offset + length; i++)
@@ -289,7 +303,11 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 
 		const LLFontGlyphInfo* fgi = next_glyph;
 		next_glyph = NULL;
-		if(!fgi)
+		if (run)
+		{
+			fgi = run->mGlyphs[i - begin_offset];
+		}
+		else if(!fgi)
 		{
 			fgi = mFontFreetype->getGlyphInfo(wch);
 		}
@@ -302,6 +320,18 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 		S32 next_bitmap_num = fgi->mBitmapNum;
 		if (next_bitmap_num != bitmap_num)
 		{
+			// draw the quads batched so far with the texture they were batched for
+			if (glyph_count > 0)
+			{
+				gGL.begin(LLRender::QUADS);
+				{
+					gGL.vertexBatchPreTransformed(vertices, uvs, colors, glyph_count * 4);
+				}
+				gGL.end();
+
+				glyph_count = 0;
+			}
+
 			bitmap_num = next_bitmap_num;
 			LLImageGL *font_image = font_bitmap_cache->getImageGL(bitmap_num);
 			gGL.getTexUnit(0)->bind(font_image);
@@ -325,7 +355,7 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 				    llround(cur_render_x + (F32)fgi->mXBearing) + (F32)fgi->mWidth,
 				    llround(cur_render_y + (F32)fgi->mYBearing) - (F32)fgi->mHeight);
 		
-		if (glyph_count >= GLYPH_BATCH_SIZE)
+		if (glyph_count > GLYPH_BATCH_SIZE - MAX_QUADS_PER_GLYPH)
 		{
 			gGL.begin(LLRender::QUADS);
 			{
@@ -346,8 +376,15 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 		if (next_char && (next_char < LAST_CHARACTER))
 		{
 			// Kern this puppy.
-			next_glyph = mFontFreetype->getGlyphInfo(next_char);
-			cur_x += mFontFreetype->getXKerning(fgi, next_glyph);
+			if (run && (i + 1) < begin_offset + length)
+			{
+				cur_x += run->mKerning[i - begin_offset];
+			}
+			else
+			{
+				next_glyph = mFontFreetype->getGlyphInfo(next_char);
+				cur_x += mFontFreetype->getXKerning(fgi, next_glyph);
+			}
 		}
 
 		// Round after kerning.
@@ -361,11 +398,14 @@ S32 LLFontGL::render(const LLWString &wstr, S32 begin_offset, F32 x, F32 y, cons
 		cur_render_y = cur_y;
 	}
 
-	gGL.begin(LLRender::QUADS);
+	if (glyph_count > 0)
 	{
-		gGL.vertexBatchPreTransformed(vertices, uvs, colors, glyph_count * 4);
+		gGL.begin(LLRender::QUADS);
+		{
+			gGL.vertexBatchPreTransformed(vertices, uvs, colors, glyph_count * 4);
+		}
+		gGL.end();
 	}
-	gGL.end();
 
 
 	if (right_x)
@@ -489,6 +529,18 @@ F32 LLFontGL::getWidthF32(const llwchar* wchars, S32 begin_offset, S32 max_chars
 {
 	const S32 LAST_CHARACTER = LLFontFreetype::LAST_CHAR_FULL;
 
+	// measured runs end at the terminator
+	S32 length = 0;
+	while (length < max_chars && length <= GLYPH_RUN_MAX_LENGTH && wchars[begin_offset + length] != 0)
+	{
+		length++;
+	}
+	const GlyphRun* run = getGlyphRun(wchars + begin_offset, length);
+	if (run)
+	{
+		return run->mWidth / sScaleX;
+	}
+
 	F32 cur_x = 0;
 	const S32 max_index = begin_offset + max_chars;
 
@@ -558,7 +610,14 @@ S32 LLFontGL::maxDrawableChars(const llwchar* wchars, F32 max_pixels, S32 max_ch
 	F32 scaled_max_pixels =	ceil(max_pixels * sScaleX);
 	F32 width_padding = 0.f;
 	
-	LLFontGlyphInfo* next_glyph = NULL;
+	S32 length = 0;
+	while (length < max_chars && length <= GLYPH_RUN_MAX_LENGTH && wchars[length] != 0)
+	{
+		length++;
+	}
+	const GlyphRun* run = getGlyphRun(wchars, length);
+
+	const LLFontGlyphInfo* next_glyph = NULL;
 
 	S32 i;
 	for (i=0; (i < max_chars); i++)
@@ -602,9 +661,13 @@ S32 LLFontGL::maxDrawableChars(const llwchar* wchars, F32 max_pixels, S32 max_ch
 			}
 		}
 		
-		LLFontGlyphInfo* fgi = next_glyph;
+		const LLFontGlyphInfo* fgi = next_glyph;
 		next_glyph = NULL;
-		if(!fgi)
+		if (run)
+		{
+			fgi = run->mGlyphs[i];
+		}
+		else if(!fgi)
 		{
 			fgi = mFontFreetype->getGlyphInfo(wch);
 		}
@@ -626,8 +689,15 @@ S32 LLFontGL::maxDrawableChars(const llwchar* wchars, F32 max_pixels, S32 max_ch
 		if (((i+1) < max_chars) && wchars[i+1])
 		{
 			// Kern this puppy.
-			next_glyph = mFontFreetype->getGlyphInfo(wchars[i+1]);
-			cur_x += mFontFreetype->getXKerning(fgi, next_glyph);
+			if (run)
+			{
+				cur_x += run->mKerning[i];
+			}
+			else
+			{
+				next_glyph = mFontFreetype->getGlyphInfo(wchars[i+1]);
+				cur_x += mFontFreetype->getXKerning(fgi, next_glyph);
+			}
 		}
 
 		// Round after kerning.
@@ -1220,3 +1290,97 @@ void LLFontGL::drawGlyph(S32& glyph_count, LLVector3* vertex_out, LLVector2* uv_
 		glyph_count++;
 	}
 }
+
+static U32 hash_glyph_run(const llwchar* wchars, S32 length)
+{
+	// FNV-1a
+	U32 hash = 2166136261U;
+	for (S32 i = 0; i < length; i++)
+	{
+		hash = (hash ^ (U32)wchars[i]) * 16777619U;
+	}
+	return hash;
+}
+
+static bool glyph_run_matches(const LLWString& text, const llwchar* wchars, S32 length)
+{
+	return (S32)text.length() == length && text.compare(0, length, wchars, length) == 0;
+}
+
+const LLFontGL::GlyphRun* LLFontGL::getGlyphRun(const llwchar* wchars, S32 length) const
+{
+	if (length <= 0 || length > GLYPH_RUN_MAX_LENGTH)
+	{
+		return NULL;
+	}
+
+	U32 hash = hash_glyph_run(wchars, length);
+	glyph_run_map_t::iterator found = mRecentRuns.find(hash);
+	if (found != mRecentRuns.end() && glyph_run_matches(found->second.mText, wchars, length))
+	{
+		sGlyphRunHits++;
+		return &found->second;
+	}
+
+	if (mRecentRuns.size() >= GLYPH_RUN_GENERATION_SIZE)
+	{
+		// runs not used since the last time this happened are dropped
+		mOlderRuns.swap(mRecentRuns);
+		mRecentRuns.clear();
+	}
+	GlyphRun& run = mRecentRuns[hash];
+
+	glyph_run_map_t::iterator older = mOlderRuns.find(hash);
+	if (older != mOlderRuns.end() && glyph_run_matches(older->second.mText, wchars, length))
+	{
+		sGlyphRunHits++;
+		run.mText.swap(older->second.mText);
+		run.mGlyphs.swap(older->second.mGlyphs);
+		run.mKerning.swap(older->second.mKerning);
+		run.mWidth = older->second.mWidth;
+		mOlderRuns.erase(older);
+		return &run;
+	}
+
+	sGlyphRunMisses++;
+
+	run.mText.assign(wchars, length);
+	run.mGlyphs.resize(length);
+	run.mKerning.resize(length);
+	for (S32 i = 0; i < length; i++)
+	{
+		run.mGlyphs[i] = mFontFreetype->getGlyphInfo(wchars[i]);
+	}
+	for (S32 i = 0; i < length - 1; i++)
+	{
+		run.mKerning[i] = mFontFreetype->getXKerning(run.mGlyphs[i], run.mGlyphs[i + 1]);
+	}
+	run.mKerning[length - 1] = 0.f;
+
+	// same as the uncached getWidthF32()
+	const S32 LAST_CHARACTER = LLFontFreetype::LAST_CHAR_FULL;
+	F32 cur_x = 0.f;
+	F32 width_padding = 0.f;
+	for (S32 i = 0; i < length; i++)
+	{
+		const LLFontGlyphInfo* fgi = run.mGlyphs[i];
+		F32 advance = mFontFreetype->getXAdvance(fgi);
+		width_padding = llmax(0.f, width_padding - advance, (F32)(fgi->mWidth + fgi->mXBearing) - advance);
+		cur_x += advance;
+
+		if ((i + 1) < length && wchars[i + 1] && (wchars[i + 1] < LAST_CHARACTER))
+		{
+			cur_x += run.mKerning[i];
+		}
+		cur_x = (F32)llround(cur_x);
+	}
+	run.mWidth = cur_x + width_padding;
+
+	return &run;
+}
+
+void LLFontGL::clearGlyphRuns()
+{
+	mRecentRuns.clear();
+	mOlderRuns.clear();
+}
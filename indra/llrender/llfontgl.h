@@ -35,10 +35,13 @@
 #include "llrect.h"
 #include "v2math.h"
 
+#include <boost/unordered_map.hpp>
+
 class LLColor4;
 // Key used to request a font.
 class LLFontDescriptor;
 class LLFontFreetype;
+struct LLFontGlyphInfo;
 
 // Structure used to store previously requested fonts.
 class LLFontRegistry;
@@ -200,6 +203,10 @@ public:
 	static BOOL sDisplayFont ;
 	static std::string sAppDir;			// For loading fonts
 
+	// Glyph run cache lookups, for the viewer stats to read and clear.
+	static U32 sGlyphRunHits;
+	static U32 sGlyphRunMisses;
+
 private:
 	friend class LLFontRegistry;
 	friend class LLTextBillboard;
@@ -214,6 +221,27 @@ private:
 	void renderQuad(LLVector3* vertex_out, LLVector2* uv_out, LLColor4U* colors_out, const LLRectf& screen_rect, const LLRectf& uv_rect, const LLColor4U& color, F32 slant_amt) const;
 	void drawGlyph(S32& glyph_count, LLVector3* vertex_out, LLVector2* uv_out, LLColor4U* colors_out, const LLRectf& screen_rect, const LLRectf& uv_rect, const LLColor4U& color, U8 style, ShadowType shadow, F32 drop_shadow_fade) const;
 
+	// The glyphs and kerning of a string recently drawn or measured, so the
+	// same label drawn every frame skips the per character glyph lookups.
+	struct GlyphRun
+	{
+		LLWString mText;
+		std::vector<const LLFontGlyphInfo*> mGlyphs;
+		std::vector<F32> mKerning;	// between each glyph and the next, whatever the next character is
+		F32 mWidth;					// getWidthF32() of the whole run, before scaling
+	};
+	typedef boost::unordered_map<U32, GlyphRun> glyph_run_map_t;
+
+	// Returns NULL for empty runs and runs too long to be worth keeping. The
+	// run stays valid until the next lookup.
+	const GlyphRun* getGlyphRun(const llwchar* wchars, S32 length) const;
+	void clearGlyphRuns();
+
+	// Runs are looked up in mRecentRuns, then in mOlderRuns, which holds what
+	// mRecentRuns held when it last filled up.
+	mutable glyph_run_map_t mRecentRuns;
+	mutable glyph_run_map_t mOlderRuns;
+
 	// Registry holds all instantiated fonts.
 	static LLFontRegistry* sFontRegistry;
 };
@@ -182,9 +182,18 @@ PFNGLBLITFRAMEBUFFEREXTPROC glBlitFramebufferEXT = NULL;
 // GL_EXT_blend_func_separate
 PFNGLBLENDFUNCSEPARATEEXTPROC glBlendFuncSeparateEXT = NULL;
 
+// GL_EXT_multi_draw_arrays
+PFNGLMULTIDRAWELEMENTSEXTPROC glMultiDrawElementsEXT = NULL;
+
 // GL_ARB_draw_buffers
 PFNGLDRAWBUFFERSARBPROC glDrawBuffersARB = NULL;
 
+// GL_ARB_copy_buffer
+PFNGLCOPYBUFFERSUBDATAPROC glCopyBufferSubData = NULL;
+
+// GL_ARB_draw_instanced
+PFNGLDRAWELEMENTSINSTANCEDARBPROC glDrawElementsInstancedARB = NULL;
+
 //shader object prototypes
 PFNGLDELETEOBJECTARBPROC glDeleteObjectARB = NULL;
 PFNGLGETHANDLEARBPROC glGetHandleARB = NULL;
@@ -332,6 +341,9 @@ LLGLManager::LLGLManager() :
 	mHasPointParameters(FALSE),
 	mHasDrawBuffers(FALSE),
 	mHasTextureRectangle(FALSE),
+	mHasMultiDrawArrays(FALSE),
+	mHasCopyBuffer(FALSE),
+	mHasDrawInstanced(FALSE),
 
 	mHasAnisotropic(FALSE),
 	mHasARBEnvCombine(FALSE),
@@ -655,6 +667,13 @@ void LLGLManager::initExtensions()
 #else
 	mHasBlendFuncSeparate = FALSE;
 # endif
+# ifdef GL_EXT_multi_draw_arrays
+	mHasMultiDrawArrays = TRUE;
+#else
+	mHasMultiDrawArrays = FALSE;
+# endif
+	mHasCopyBuffer = FALSE;
+	mHasDrawInstanced = FALSE;
 	mHasMipMapGeneration = FALSE;
 	mHasSeparateSpecularColor = FALSE;
 	mHasAnisotropic = FALSE;
@@ -683,6 +702,11 @@ void LLGLManager::initExtensions()
 	mHasFramebufferMultisample = mHasFramebufferObject && ExtensionExists("GL_EXT_framebuffer_multisample", gGLHExts.mSysExts);
 	mHasDrawBuffers = ExtensionExists("GL_ARB_draw_buffers", gGLHExts.mSysExts);
 	mHasBlendFuncSeparate = ExtensionExists("GL_EXT_blend_func_separate", gGLHExts.mSysExts);
+	mHasMultiDrawArrays = ExtensionExists("GL_EXT_multi_draw_arrays", gGLHExts.mSysExts);
+#if !LL_DARWIN
+	mHasCopyBuffer = ExtensionExists("GL_ARB_copy_buffer", gGLHExts.mSysExts);
+	mHasDrawInstanced = ExtensionExists("GL_ARB_draw_instanced", gGLHExts.mSysExts);
+#endif
 	mHasTextureRectangle = ExtensionExists("GL_ARB_texture_rectangle", gGLHExts.mSysExts);
 #if !LL_DARWIN
 	mHasPointParameters = !mIsATI && ExtensionExists("GL_ARB_point_parameters", gGLHExts.mSysExts);
@@ -708,6 +732,9 @@ void LLGLManager::initExtensions()
 		mHasFramebufferMultisample = FALSE;
 		mHasDrawBuffers = FALSE;
 		mHasBlendFuncSeparate = FALSE;
+		mHasMultiDrawArrays = FALSE;
+		mHasCopyBuffer = FALSE;
+		mHasDrawInstanced = FALSE;
 		mHasMipMapGeneration = FALSE;
 		mHasSeparateSpecularColor = FALSE;
 		mHasAnisotropic = FALSE;
@@ -763,6 +790,9 @@ void LLGLManager::initExtensions()
 		if (strchr(blacklist,'t')) mHasTextureRectangle = FALSE;
 		if (strchr(blacklist,'u')) mHasBlendFuncSeparate = FALSE;//S
 		if (strchr(blacklist,'v')) mHasDepthClamp = FALSE;
+		if (strchr(blacklist,'w')) mHasMultiDrawArrays = FALSE;
+		if (strchr(blacklist,'x')) mHasCopyBuffer = FALSE;
+		if (strchr(blacklist,'y')) mHasDrawInstanced = FALSE;
 		
 	}
 #endif // LL_LINUX || LL_SOLARIS
@@ -819,6 +849,18 @@ void LLGLManager::initExtensions()
 	{
 		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_draw_buffers" << LL_ENDL;
 	}
+	if (!mHasMultiDrawArrays)
+	{
+		LL_INFOS("RenderInit") << "Couldn't initialize GL_EXT_multi_draw_arrays" << LL_ENDL;
+	}
+	if (!mHasCopyBuffer)
+	{
+		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_copy_buffer" << LL_ENDL;
+	}
+	if (!mHasDrawInstanced)
+	{
+		LL_INFOS("RenderInit") << "Couldn't initialize GL_ARB_draw_instanced" << LL_ENDL;
+	}
 
 	// Disable certain things due to known bugs
 	if (mIsIntel && mHasMipMapGeneration)
@@ -893,6 +935,30 @@ void LLGLManager::initExtensions()
 	{
 		glBlendFuncSeparateEXT = (PFNGLBLENDFUNCSEPARATEEXTPROC) GLH_EXT_GET_PROC_ADDRESS("glBlendFuncSeparateEXT");
 	}
+	if (mHasMultiDrawArrays)
+	{
+		glMultiDrawElementsEXT = (PFNGLMULTIDRAWELEMENTSEXTPROC) GLH_EXT_GET_PROC_ADDRESS("glMultiDrawElementsEXT");
+		if (!glMultiDrawElementsEXT)
+		{
+			mHasMultiDrawArrays = FALSE;
+		}
+	}
+	if (mHasCopyBuffer)
+	{
+		glCopyBufferSubData = (PFNGLCOPYBUFFERSUBDATAPROC) GLH_EXT_GET_PROC_ADDRESS("glCopyBufferSubData");
+		if (!glCopyBufferSubData)
+		{
+			mHasCopyBuffer = FALSE;
+		}
+	}
+	if (mHasDrawInstanced)
+	{
+		glDrawElementsInstancedARB = (PFNGLDRAWELEMENTSINSTANCEDARBPROC) GLH_EXT_GET_PROC_ADDRESS("glDrawElementsInstancedARB");
+		if (!glDrawElementsInstancedARB)
+		{
+			mHasDrawInstanced = FALSE;
+		}
+	}
 #if (!LL_LINUX && !LL_SOLARIS) || LL_LINUX_NV_GL_HEADERS
 	// This is expected to be a static symbol on Linux GL implementations, except if we use the nvidia headers - bah
 	glDrawRangeElements = (PFNGLDRAWRANGEELEMENTSPROC)GLH_EXT_GET_PROC_ADDRESS("glDrawRangeElements");
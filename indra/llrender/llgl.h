@@ -93,6 +93,9 @@ public:
 	BOOL mHasPointParameters;
 	BOOL mHasDrawBuffers;
 	BOOL mHasDepthClamp;
+	BOOL mHasMultiDrawArrays;
+	BOOL mHasCopyBuffer;
+	BOOL mHasDrawInstanced;
 	BOOL mHasTextureRectangle;
 
 	// Other extensions.
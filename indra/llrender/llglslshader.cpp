@@ -63,6 +63,8 @@ hasGamma(false), hasLighting(false), calculatesAtmospherics(false)
 //===============================
 // LLGLSL Shader implementation
 //===============================
+LLGLSLShader* LLGLSLShader::sCurBoundShaderPtr = NULL;
+
 LLGLSLShader::LLGLSLShader()
 	: mProgramObject(0), mActiveTextureChannels(0), mShaderLevel(0), mShaderGroup(SG_DEFAULT), mUniformsDirty(FALSE)
 {
@@ -342,6 +344,7 @@ void LLGLSLShader::bind()
 	if (gGLManager.mHasShaderObjects)
 	{
 		glUseProgramObjectARB(mProgramObject);
+		sCurBoundShaderPtr = this;
 
 		if (mUniformsDirty)
 		{
@@ -365,6 +368,7 @@ void LLGLSLShader::unbind()
 			}
 		}
 		glUseProgramObjectARB(0);
+		sCurBoundShaderPtr = NULL;
 		stop_glerror();
 	}
 }
@@ -372,6 +376,7 @@ void LLGLSLShader::unbind()
 void LLGLSLShader::bindNoShader(void)
 {
 	glUseProgramObjectARB(0);
+	sCurBoundShaderPtr = NULL;
 }
 
 S32 LLGLSLShader::enableTexture(S32 uniform, LLTexUnit::eTextureType mode)
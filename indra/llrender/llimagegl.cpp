@@ -33,6 +33,7 @@
 
 #include "llerror.h"
 #include "llimage.h"
+#include "llimagedxt.h"
 
 #include "llmath.h"
 #include "llgl.h"
@@ -692,6 +693,10 @@ void LLImageGL::setImage(const U8* data_in, BOOL data_hasmips)
  					S32 tex_size = dataFormatBytes(mFormatPrimary, w, h);
 					glCompressedTexImage2DARB(mTarget, gl_level, mFormatPrimary, w, h, 0, tex_size, (GLvoid *)data_in);
 					stop_glerror();
+					if (gl_level == 0)
+					{
+						analyzeCompressedAlpha(data_in, w, h);
+					}
 				}
 				else
 				{
@@ -843,6 +848,7 @@ void LLImageGL::setImage(const U8* data_in, BOOL data_hasmips)
 			S32 tex_size = dataFormatBytes(mFormatPrimary, w, h);
 			glCompressedTexImage2DARB(mTarget, 0, mFormatPrimary, w, h, 0, tex_size, (GLvoid *)data_in);
 			stop_glerror();
+			analyzeCompressedAlpha(data_in, w, h);
 		}
 		else
 		{
@@ -1302,6 +1308,49 @@ BOOL LLImageGL::createGLTexture(S32 discard_level, const U8* data_in, BOOL data_
 	return TRUE;
 }
 
+BOOL LLImageGL::createCompressedGLTexture(S32 discard_level, LLImageDXT* imagedxt, S32 usename, S32 category)
+{
+	if (gGLManager.mIsDisabled)
+	{
+		llwarns << "Trying to create a texture while GL is disabled!" << llendl;
+		return FALSE;
+	}
+
+	LLGLenum format;
+	switch (imagedxt->getFileFormat())
+	{
+	  case LLImageDXT::FORMAT_DXR1:
+		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+		break;
+	  case LLImageDXT::FORMAT_DXR5:
+		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		break;
+	  default:
+		llwarns << "Can't upload DXT format " << imagedxt->getFileFormat() << llendl;
+		return FALSE;
+	}
+
+	mGLTextureCreated = false ;
+	llassert(gGLManager.mInited);
+	stop_glerror();
+
+	discard_level = llclamp(discard_level, 0, (S32)MAX_DISCARD_LEVEL);
+	setSize(imagedxt->getWidth() << discard_level, imagedxt->getHeight() << discard_level,
+			imagedxt->getComponents());
+
+	// not an explicit format, so the next raw upload picks its own again
+	mHasExplicitFormat = FALSE;
+	mFormatInternal = format;
+	mFormatPrimary = format;
+	mFormatType = GL_UNSIGNED_BYTE;
+	mFormatSwapBytes = FALSE;
+	calcAlphaChannelOffsetAndStride() ;
+
+	setCategory(category) ;
+	// the largest mip is last, as createGLTexture() expects
+	return createGLTexture(discard_level, imagedxt->getData() + imagedxt->getMipOffset(0), TRUE, usename);
+}
+
 BOOL LLImageGL::readBackRaw(S32 discard_level, LLImageRaw* imageraw, bool compressed_ok) const
 {
 	llassert_always(sAllowReadBackRaw) ;
@@ -1615,10 +1664,12 @@ void LLImageGL::calcAlphaChannelOffsetAndStride()
 		mAlphaStride = 2;
 		break;
 	case GL_RGB:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: // only ever uploaded opaque
 		mNeedsAlphaAndPickMask = FALSE ;
 		mIsMask = FALSE;
 		return ; //no alpha channel.
 	case GL_RGBA:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: // analyzed once decompressed to RGBA
 		mAlphaStride = 4;
 		break;
 	case GL_BGRA_EXT:
@@ -1767,6 +1818,19 @@ void LLImageGL::analyzeAlpha(const void* data_in, U32 w, U32 h)
 	}
 }
 
+void LLImageGL::analyzeCompressedAlpha(const U8* data_in, S32 w, S32 h)
+{
+	if (!mNeedsAlphaAndPickMask || mFormatPrimary != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+	{
+		return;
+	}
+
+	std::vector<U8> rgba(w * h * 4);
+	LLImageDXT::decompressBlocks(LLImageDXT::FORMAT_DXR5, data_in, w, h, 4, &rgba[0]);
+	analyzeAlpha(&rgba[0], w, h);
+	updatePickMask(w, h, &rgba[0]);
+}
+
 //----------------------------------------------------------------------------
 void LLImageGL::updatePickMask(S32 width, S32 height, const U8* data_in)
 {
@@ -1780,7 +1844,7 @@ void LLImageGL::updatePickMask(S32 width, S32 height, const U8* data_in)
 	mPickMaskWidth = mPickMaskHeight = 0;
 
 	if (mFormatType != GL_UNSIGNED_BYTE ||
-	    mFormatPrimary != GL_RGBA)
+	    (mFormatPrimary != GL_RGBA && mFormatPrimary != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT))
 	{
 		//cannot generate a pick mask for this texture
 		return;
@@ -37,6 +37,7 @@
 
 #include "llrender.h"
 class LLTextureAtlas ;
+class LLImageDXT;
 #define BYTES_TO_MEGA_BYTES(x) ((x) >> 20)
 #define MEGA_BYTES_TO_BYTES(x) ((x) << 20)
 
@@ -87,6 +88,8 @@ protected:
 	virtual ~LLImageGL();
 
 	void analyzeAlpha(const void* data_in, U32 w, U32 h);
+	// analyzeAlpha() and updatePickMask() for a mip of DXT5 blocks
+	void analyzeCompressedAlpha(const U8* data_in, S32 w, S32 h);
 	void calcAlphaChannelOffsetAndStride();
 
 public:
@@ -105,6 +108,10 @@ public:
 	BOOL createGLTexture(S32 discard_level, const LLImageRaw* imageraw, S32 usename = 0, BOOL to_create = TRUE, 
 		S32 category = sMaxCatagories - 1);
 	BOOL createGLTexture(S32 discard_level, const U8* data, BOOL data_hasmips = FALSE, S32 usename = 0);
+	// Uploads the blocks of a DXR1 or DXR5 image, which holds the mips from
+	// discard_level down, without decompressing them.
+	BOOL createCompressedGLTexture(S32 discard_level, LLImageDXT* imagedxt, S32 usename = 0,
+		S32 category = sMaxCatagories - 1);
 	void setImage(const LLImageRaw* imageraw);
 	void setImage(const U8* data_in, BOOL data_hasmips = FALSE);
 	BOOL setSubImage(const LLImageRaw* imageraw, S32 x_pos, S32 y_pos, S32 width, S32 height, BOOL force_fast_update = FALSE);
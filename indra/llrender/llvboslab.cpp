@@ -0,0 +1,353 @@
+/**
+ * @file llvboslab.cpp
+ * @brief Shared GL buffers that static vertex and index data is packed into
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvboslab.h"
+
+#include "llglheaders.h"
+#include "llvertexbuffer.h"
+
+// Keeps vertex attribute and index offsets aligned for every data type.
+static const U32 SLAB_ALIGNMENT = 32;
+
+// A slab holding less than this fraction of its size gets compacted.
+static const F32 SLAB_COMPACT_RATIO = 0.25f;
+
+U32 LLVBOSlabPool::sSlabSize = 4*1024*1024;
+
+// Copies on the GPU, reading the block back would stall on every draw
+// still queued against the source slab.
+static void copy_block(U32 source, U32 offset, U32 dest, U32 new_offset, U32 size)
+{
+#if (LL_WINDOWS || LL_LINUX || LL_SOLARIS) && !LL_MESA
+	glBindBufferARB(GL_COPY_READ_BUFFER, source);
+	glBindBufferARB(GL_COPY_WRITE_BUFFER, dest);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, new_offset, size);
+	glBindBufferARB(GL_COPY_READ_BUFFER, 0);
+	glBindBufferARB(GL_COPY_WRITE_BUFFER, 0);
+	stop_glerror();
+#else
+	llerrs << "Vertex buffer slab compaction without GL_ARB_copy_buffer." << llendl;
+#endif
+}
+
+//============================================================================
+
+LLVBOSlab::LLVBOSlab(U32 target, U32 size)
+:	mName(0),
+	mTarget(target),
+	mSize(size),
+	mUsedBytes(0),
+	mRequestedBytes(0),
+	mFreeBytes(0)
+{
+	glGenBuffersARB(1, (GLuint*) &mName);
+	glBindBufferARB(mTarget, mName);
+	glBufferDataARB(mTarget, mSize, NULL, GL_STATIC_DRAW_ARB);
+	stop_glerror();
+	LLVertexBuffer::unbind();
+
+	addFree(0, mSize);
+}
+
+LLVBOSlab::~LLVBOSlab()
+{
+	if (!mUsedBlocks.empty())
+	{
+		llwarns << "Deleting vertex buffer slab with " << mUsedBlocks.size() << " blocks in use." << llendl;
+	}
+	glDeleteBuffersARB(1, (GLuint*) &mName);
+}
+
+S32 LLVBOSlab::allocate(U32 size, LLVBOSlabOwner* owner)
+{
+	U32 aligned = (size + SLAB_ALIGNMENT - 1) & ~(SLAB_ALIGNMENT - 1);
+
+	for (free_map_t::iterator iter = mFreeBlocks.begin(); iter != mFreeBlocks.end(); ++iter)
+	{
+		if (iter->second >= aligned)
+		{
+			U32 offset = iter->first;
+			U32 remaining = iter->second - aligned;
+			mFreeBlocks.erase(iter);
+			if (remaining)
+			{
+				mFreeBlocks[offset + aligned] = remaining;
+			}
+
+			Block& block = mUsedBlocks[offset];
+			block.mSize = aligned;
+			block.mRequested = size;
+			block.mOwner = owner;
+
+			mFreeBytes -= aligned;
+			mUsedBytes += aligned;
+			mRequestedBytes += size;
+			return (S32) offset;
+		}
+	}
+
+	return -1;
+}
+
+void LLVBOSlab::release(U32 offset)
+{
+	used_map_t::iterator iter = mUsedBlocks.find(offset);
+	if (iter == mUsedBlocks.end())
+	{
+		llerrs << "Released vertex buffer slab block that isn't in use: " << offset << llendl;
+	}
+
+	mUsedBytes -= iter->second.mSize;
+	mRequestedBytes -= iter->second.mRequested;
+	mReleased.push_back(std::make_pair(offset, iter->second.mSize));
+	mUsedBlocks.erase(iter);
+}
+
+void LLVBOSlab::flushReleased()
+{
+	for (U32 i = 0; i < mReleased.size(); ++i)
+	{
+		addFree(mReleased[i].first, mReleased[i].second);
+	}
+	mReleased.clear();
+}
+
+void LLVBOSlab::addFree(U32 offset, U32 size)
+{
+	mFreeBytes += size;
+
+	free_map_t::iterator next = mFreeBlocks.lower_bound(offset);
+	if (next != mFreeBlocks.end() && offset + size == next->first)
+	{ //merge with the following block
+		size += next->second;
+		mFreeBlocks.erase(next++);
+	}
+
+	if (next != mFreeBlocks.begin())
+	{
+		free_map_t::iterator prev = next;
+		--prev;
+		if (prev->first + prev->second == offset)
+		{ //merge with the preceding block
+			prev->second += size;
+			return;
+		}
+	}
+
+	mFreeBlocks[offset] = size;
+}
+
+//============================================================================
+
+LLVBOSlabPool::LLVBOSlabPool(U32 target)
+:	mTarget(target)
+{
+}
+
+LLVBOSlabPool::~LLVBOSlabPool()
+{
+	// GL objects must already be gone by now, see cleanup()
+}
+
+LLVBOSlab* LLVBOSlabPool::allocate(U32 size, LLVBOSlabOwner* owner, U32& offset)
+{
+	if (size == 0 || size > sSlabSize/4)
+	{
+		return NULL;
+	}
+
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		LLVBOSlab* slab = *iter;
+		if (slab->getFreeBytes() < size)
+		{
+			continue;
+		}
+
+		S32 block = slab->allocate(size, owner);
+		if (block >= 0)
+		{
+			offset = (U32) block;
+			return slab;
+		}
+	}
+
+	LLVBOSlab* slab = new LLVBOSlab(mTarget, sSlabSize);
+	mSlabs.push_back(slab);
+	offset = (U32) slab->allocate(size, owner);
+	return slab;
+}
+
+void LLVBOSlabPool::release(LLVBOSlab* slab, U32 offset)
+{
+	slab->release(offset);
+}
+
+void LLVBOSlabPool::update(U32 max_bytes)
+{
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		(*iter)->flushReleased();
+	}
+
+	compact(max_bytes);
+
+	// keep one empty slab around so a single rebuild doesn't create and
+	// delete a slab every frame
+	bool kept_empty = false;
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); )
+	{
+		LLVBOSlab* slab = *iter;
+		if (slab->isEmpty())
+		{
+			if (!kept_empty)
+			{
+				kept_empty = true;
+			}
+			else
+			{
+				delete slab;
+				iter = mSlabs.erase(iter);
+				continue;
+			}
+		}
+		++iter;
+	}
+}
+
+void LLVBOSlabPool::compact(U32 max_bytes)
+{
+	if (mSlabs.size() < 2 || max_bytes == 0)
+	{
+		return;
+	}
+
+	// empty the slab with the least data in it, if the others have room.
+	// Slabs with nothing in use have nothing to move, and are never
+	// moved into either: update() keeps one empty slab around, moving
+	// blocks into it would only empty the source to take its place.
+	LLVBOSlab* source = NULL;
+	U32 free_elsewhere = 0;
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		LLVBOSlab* slab = *iter;
+		if (!slab->mUsedBlocks.empty() &&
+			(!source || slab->getUsedBytes() < source->getUsedBytes()))
+		{
+			source = slab;
+		}
+	}
+
+	if (!source)
+	{
+		return;
+	}
+
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		if (*iter != source && !(*iter)->mUsedBlocks.empty())
+		{
+			free_elsewhere += (*iter)->getFreeBytes();
+		}
+	}
+
+	if (source->getUsedBytes() > (U32) (source->getSize() * SLAB_COMPACT_RATIO) ||
+		source->getUsedBytes() > free_elsewhere)
+	{
+		return;
+	}
+
+	U32 moved = 0;
+
+	LLVBOSlab::used_map_t blocks = source->mUsedBlocks;
+	for (LLVBOSlab::used_map_t::iterator iter = blocks.begin(); iter != blocks.end() && moved < max_bytes; ++iter)
+	{
+		U32 offset = iter->first;
+		const LLVBOSlab::Block& block = iter->second;
+		if (!block.mOwner->canRelocate())
+		{
+			continue;
+		}
+
+		U32 new_offset = 0;
+		LLVBOSlab* dest = NULL;
+		for (slab_list_t::iterator slab_iter = mSlabs.begin(); slab_iter != mSlabs.end() && !dest; ++slab_iter)
+		{
+			LLVBOSlab* slab = *slab_iter;
+			if (slab != source && !slab->mUsedBlocks.empty() &&
+				slab->getFreeBytes() >= block.mRequested)
+			{
+				S32 found = slab->allocate(block.mRequested, block.mOwner);
+				if (found >= 0)
+				{
+					dest = slab;
+					new_offset = (U32) found;
+				}
+			}
+		}
+
+		if (!dest)
+		{
+			break;
+		}
+
+		copy_block(source->getName(), offset, dest->getName(), new_offset, block.mRequested);
+		block.mOwner->relocate(source, dest, new_offset);
+		source->release(offset);
+		moved += block.mRequested;
+	}
+}
+
+void LLVBOSlabPool::cleanup()
+{
+	for (slab_list_t::iterator iter = mSlabs.begin(); iter != mSlabs.end(); )
+	{
+		LLVBOSlab* slab = *iter;
+		slab->flushReleased();
+		if (slab->isEmpty())
+		{
+			delete slab;
+			iter = mSlabs.erase(iter);
+		}
+		else
+		{
+			llwarns << "Vertex buffer slab still in use at cleanup." << llendl;
+			++iter;
+		}
+	}
+}
+
+U32 LLVBOSlabPool::getWastedBytes() const
+{
+	U32 wasted = 0;
+	for (slab_list_t::const_iterator iter = mSlabs.begin(); iter != mSlabs.end(); ++iter)
+	{
+		wasted += (*iter)->getSize() - (*iter)->getRequestedBytes();
+	}
+	return wasted;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file llvboslab.h
+ * @brief Shared GL buffers that static vertex and index data is packed into
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVBOSLAB_H
+#define LL_LLVBOSLAB_H
+
+#include <list>
+#include <map>
+#include <vector>
+
+class LLVBOSlab;
+
+// Whatever holds a slab block, told when compaction moves it.
+class LLVBOSlabOwner
+{
+public:
+	virtual ~LLVBOSlabOwner() {}
+
+	// FALSE while the block's data is still being filled in client memory.
+	virtual BOOL canRelocate() const = 0;
+	virtual void relocate(LLVBOSlab* slab, LLVBOSlab* new_slab, U32 new_offset) = 0;
+};
+
+//============================================================================
+// One large GL buffer object. Blocks are handed out first fit from an
+// offset ordered free list. A released block is only reused after the next
+// flushReleased(), so data that draw calls issued this frame still point at
+// isn't overwritten under them.
+
+class LLVBOSlab
+{
+public:
+	LLVBOSlab(U32 target, U32 size);
+	~LLVBOSlab();
+
+	// Returns the offset of a block of at least size bytes, or -1 if there
+	// is no room. owner is told when compaction moves the block.
+	S32 allocate(U32 size, LLVBOSlabOwner* owner);
+	void release(U32 offset);
+	void flushReleased();
+
+	U32 getName() const				{ return mName; }
+	U32 getTarget() const			{ return mTarget; }
+	U32 getSize() const				{ return mSize; }
+	U32 getUsedBytes() const		{ return mUsedBytes; }
+	U32 getRequestedBytes() const	{ return mRequestedBytes; }
+	U32 getFreeBytes() const		{ return mFreeBytes; }
+	BOOL isEmpty() const			{ return mUsedBlocks.empty() && mReleased.empty(); }
+
+private:
+	friend class LLVBOSlabPool;
+
+	struct Block
+	{
+		U32 mSize;
+		U32 mRequested;
+		LLVBOSlabOwner* mOwner;
+	};
+
+	typedef std::map<U32, U32> free_map_t;		// offset -> size
+	typedef std::map<U32, Block> used_map_t;	// offset -> block
+
+	void addFree(U32 offset, U32 size);
+
+	U32 mName;
+	U32 mTarget;
+	U32 mSize;
+	U32 mUsedBytes;
+	U32 mRequestedBytes;
+	U32 mFreeBytes;
+	free_map_t mFreeBlocks;
+	used_map_t mUsedBlocks;
+	std::vector<std::pair<U32, U32> > mReleased;
+};
+
+//============================================================================
+// All the slabs for one buffer target.
+
+class LLVBOSlabPool
+{
+public:
+	LLVBOSlabPool(U32 target);
+	~LLVBOSlabPool();
+
+	// Finds room for size bytes, making a new slab if needed. Returns NULL
+	// for blocks too big to be worth packing.
+	LLVBOSlab* allocate(U32 size, LLVBOSlabOwner* owner, U32& offset);
+	void release(LLVBOSlab* slab, U32 offset);
+
+	// Called once a frame: frees the blocks released since the last call,
+	// moves at most max_bytes out of a mostly empty slab and deletes empty
+	// slabs. Moving blocks needs GL_ARB_copy_buffer, pass 0 without it.
+	void update(U32 max_bytes);
+	void cleanup();
+
+	// Bytes held in slabs that no vertex buffer asked for.
+	U32 getWastedBytes() const;
+	U32 getSlabCount() const		{ return mSlabs.size(); }
+
+	static U32 sSlabSize;
+
+private:
+	void compact(U32 max_bytes);
+
+	typedef std::list<LLVBOSlab*> slab_list_t;
+	slab_list_t mSlabs;
+	U32 mTarget;
+};
+
+#endif // LL_LLVBOSLAB_H
@@ -41,14 +41,19 @@ LLVBOPool LLVertexBuffer::sStreamVBOPool;
 LLVBOPool LLVertexBuffer::sDynamicVBOPool;
 LLVBOPool LLVertexBuffer::sStreamIBOPool;
 LLVBOPool LLVertexBuffer::sDynamicIBOPool;
+LLVBOSlabPool LLVertexBuffer::sVertexSlabPool(GL_ARRAY_BUFFER_ARB);
+LLVBOSlabPool LLVertexBuffer::sIndexSlabPool(GL_ELEMENT_ARRAY_BUFFER_ARB);
 
 U32 LLVertexBuffer::sBindCount = 0;
 U32 LLVertexBuffer::sSetCount = 0;
+U32 LLVertexBuffer::sFrameBindCount = 0;
+U32 LLVertexBuffer::sSlabWastedBytes = 0;
 S32 LLVertexBuffer::sCount = 0;
 S32 LLVertexBuffer::sGLCount = 0;
 S32 LLVertexBuffer::sMappedCount = 0;
 BOOL LLVertexBuffer::sEnableVBOs = TRUE;
 U32 LLVertexBuffer::sGLRenderBuffer = 0;
+U32 LLVertexBuffer::sGLRenderOffset = 0;
 U32 LLVertexBuffer::sGLRenderIndices = 0;
 U32 LLVertexBuffer::sLastMask = 0;
 BOOL LLVertexBuffer::sVBOActive = FALSE;
@@ -56,6 +61,10 @@ BOOL LLVertexBuffer::sIBOActive = FALSE;
 U32 LLVertexBuffer::sAllocatedBytes = 0;
 BOOL LLVertexBuffer::sMapped = FALSE;
 BOOL LLVertexBuffer::sUseStreamDraw = TRUE;
+BOOL LLVertexBuffer::sUseSlabs = TRUE;
+
+// Most slab data copied by compaction each frame.
+static const U32 SLAB_COMPACT_BYTES = 256*1024;
 
 std::vector<U32> LLVertexBuffer::sDeleteList;
 
@@ -248,6 +257,109 @@ void LLVertexBuffer::drawRange(U32 mode, U32 start, U32 end, U32 count, U32 indi
 	stop_glerror();
 }
 
+void LLVertexBuffer::drawMultiRange(U32 mode, U32 start, U32 end, const std::vector<U32>& counts, const std::vector<U32>& indices_offsets) const
+{
+	llassert(mRequestedNumVerts >= 0);
+	llassert(counts.size() == indices_offsets.size());
+
+	if (start >= (U32) mRequestedNumVerts ||
+	    end >= (U32) mRequestedNumVerts)
+	{
+		llerrs << "Bad vertex buffer draw range: [" << start << ", " << end << "]" << llendl;
+	}
+
+	for (U32 i = 0; i < indices_offsets.size(); ++i)
+	{
+		if (indices_offsets[i] >= (U32) mRequestedNumIndices ||
+			indices_offsets[i] + counts[i] > (U32) mRequestedNumIndices)
+		{
+			llerrs << "Bad index buffer draw range: [" << indices_offsets[i] << ", " << indices_offsets[i]+counts[i] << "]" << llendl;
+		}
+	}
+
+	if (mGLIndices != sGLRenderIndices)
+	{
+		llerrs << "Wrong index buffer bound." << llendl;
+	}
+
+	if (mGLBuffer != sGLRenderBuffer)
+	{
+		llerrs << "Wrong vertex buffer bound." << llendl;
+	}
+
+	if (mode >= LLRender::NUM_MODES)
+	{
+		llerrs << "Invalid draw mode: " << mode << llendl;
+		return;
+	}
+
+	U16* indices = (U16*) getIndicesPointer();
+
+	stop_glerror();
+	if (gGLManager.mHasMultiDrawArrays)
+	{
+		// Only ever called from the render thread.
+		static std::vector<GLsizei> gl_counts;
+		static std::vector<const GLvoid*> gl_indices;
+
+		gl_counts.resize(counts.size());
+		gl_indices.resize(counts.size());
+		for (U32 i = 0; i < counts.size(); ++i)
+		{
+			gl_counts[i] = (GLsizei) counts[i];
+			gl_indices[i] = indices + indices_offsets[i];
+		}
+
+		glMultiDrawElementsEXT(sGLMode[mode], &gl_counts[0], GL_UNSIGNED_SHORT, &gl_indices[0], (GLsizei) counts.size());
+	}
+	else
+	{
+		for (U32 i = 0; i < counts.size(); ++i)
+		{
+			glDrawRangeElements(sGLMode[mode], start, end, counts[i], GL_UNSIGNED_SHORT, 
+				indices + indices_offsets[i]);
+		}
+	}
+	stop_glerror();
+}
+
+void LLVertexBuffer::drawInstanced(U32 mode, U32 count, U32 indices_offset, U32 instances) const
+{
+	llassert(mRequestedNumIndices >= 0);
+	llassert(gGLManager.mHasDrawInstanced);
+
+	if (indices_offset >= (U32) mRequestedNumIndices ||
+	    indices_offset + count > (U32) mRequestedNumIndices)
+	{
+		llerrs << "Bad index buffer draw range: [" << indices_offset << ", " << indices_offset+count << "]" << llendl;
+	}
+
+	if (mGLIndices != sGLRenderIndices)
+	{
+		llerrs << "Wrong index buffer bound." << llendl;
+	}
+
+	if (mGLBuffer != sGLRenderBuffer)
+	{
+		llerrs << "Wrong vertex buffer bound." << llendl;
+	}
+
+	if (mode >= LLRender::NUM_MODES)
+	{
+		llerrs << "Invalid draw mode: " << mode << llendl;
+		return;
+	}
+
+	stop_glerror();
+#if (LL_WINDOWS || LL_LINUX || LL_SOLARIS) && !LL_MESA
+	glDrawElementsInstancedARB(sGLMode[mode], count, GL_UNSIGNED_SHORT,
+		((U16*) getIndicesPointer()) + indices_offset, instances);
+#else
+	llerrs << "Instanced draw without GL_ARB_draw_instanced." << llendl;
+#endif
+	stop_glerror();
+}
+
 void LLVertexBuffer::draw(U32 mode, U32 count, U32 indices_offset) const
 {
 	llassert(mRequestedNumIndices >= 0);
@@ -329,6 +441,7 @@ void LLVertexBuffer::unbind()
 	}
 
 	sGLRenderBuffer = 0;
+	sGLRenderOffset = 0;
 	sGLRenderIndices = 0;
 
 	setupClientArrays(0);
@@ -340,6 +453,9 @@ void LLVertexBuffer::cleanupClass()
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_CLEANUP_CLASS);
 	unbind();
 	clientCopy(); // deletes GL buffers
+	sVertexSlabPool.cleanup();
+	sIndexSlabPool.cleanup();
+	sSlabWastedBytes = 0;
 }
 
 void LLVertexBuffer::clientCopy(F64 max_time)
@@ -351,6 +467,15 @@ void LLVertexBuffer::clientCopy(F64 max_time)
 	}
 }
 
+//static
+void LLVertexBuffer::updateSlabs()
+{
+	U32 compact_bytes = gGLManager.mHasCopyBuffer ? SLAB_COMPACT_BYTES : 0;
+	sVertexSlabPool.update(compact_bytes);
+	sIndexSlabPool.update(compact_bytes);
+	sSlabWastedBytes = sVertexSlabPool.getWastedBytes() + sIndexSlabPool.getWastedBytes();
+}
+
 //----------------------------------------------------------------------------
 
 LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
@@ -369,7 +494,11 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	mFilthy(FALSE),
 	mEmpty(TRUE),
 	mResized(FALSE),
-	mDynamicSize(FALSE)
+	mDynamicSize(FALSE),
+	mVertexSlab(NULL),
+	mIndexSlab(NULL),
+	mVertexSlabOffset(0),
+	mIndexSlabOffset(0)
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_CONSTRUCTOR);
 	if (!sEnableVBOs)
@@ -438,8 +567,20 @@ void LLVertexBuffer::genBuffer()
 	}
 	else
 	{
-		BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
-		glGenBuffersARB(1, (GLuint*)&mGLBuffer);
+		if (sUseSlabs)
+		{
+			mVertexSlab = sVertexSlabPool.allocate(getSize(), this, mVertexSlabOffset);
+		}
+
+		if (mVertexSlab)
+		{
+			mGLBuffer = mVertexSlab->getName();
+		}
+		else
+		{
+			BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
+			glGenBuffersARB(1, (GLuint*)&mGLBuffer);
+		}
 	}
 	sGLCount++;
 }
@@ -456,8 +597,20 @@ void LLVertexBuffer::genIndices()
 	}
 	else
 	{
-		BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
-		glGenBuffersARB(1, (GLuint*)&mGLIndices);
+		if (sUseSlabs)
+		{
+			mIndexSlab = sIndexSlabPool.allocate(getIndicesSize(), this, mIndexSlabOffset);
+		}
+
+		if (mIndexSlab)
+		{
+			mGLIndices = mIndexSlab->getName();
+		}
+		else
+		{
+			BOOST_STATIC_ASSERT(sizeof(mGLBuffer) == sizeof(GLuint));
+			glGenBuffersARB(1, (GLuint*)&mGLIndices);
+		}
 	}
 	sGLCount++;
 }
@@ -472,6 +625,12 @@ void LLVertexBuffer::releaseBuffer()
 	{
 		sDynamicVBOPool.release(mGLBuffer);
 	}
+	else if (mVertexSlab)
+	{ //the block is only reused after the next updateSlabs()
+		sVertexSlabPool.release(mVertexSlab, mVertexSlabOffset);
+		mVertexSlab = NULL;
+		mVertexSlabOffset = 0;
+	}
 	else
 	{
 		sDeleteList.push_back(mGLBuffer);
@@ -489,6 +648,12 @@ void LLVertexBuffer::releaseIndices()
 	{
 		sDynamicIBOPool.release(mGLIndices);
 	}
+	else if (mIndexSlab)
+	{
+		sIndexSlabPool.release(mIndexSlab, mIndexSlabOffset);
+		mIndexSlab = NULL;
+		mIndexSlabOffset = 0;
+	}
 	else
 	{
 		sDeleteList.push_back(mGLIndices);
@@ -843,12 +1008,26 @@ U8* LLVertexBuffer::mapBuffer(S32 access)
 			setBuffer(0);
 			mLocked = TRUE;
 			stop_glerror();	
-			mMappedData = (U8*) glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+			if (mVertexSlab)
+			{ //filled in client memory, copied into the slab on unmap
+				mMappedData = new U8[getSize()];
+			}
+			else
+			{
+				mMappedData = (U8*) glMapBufferARB(GL_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+			}
 			stop_glerror();
 		}
 		{
 			LLMemType mt_v(LLMemType::MTYPE_VERTEX_MAP_BUFFER_INDICES);
-			mMappedIndexData = (U8*) glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+			if (mIndexSlab)
+			{
+				mMappedIndexData = new U8[getIndicesSize()];
+			}
+			else
+			{
+				mMappedIndexData = (U8*) glMapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+			}
 			stop_glerror();
 		}
 
@@ -909,9 +1088,29 @@ void LLVertexBuffer::unmapBuffer()
 		if (useVBOs() && mLocked)
 		{
 			stop_glerror();
-			glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+			if (mVertexSlab)
+			{ //the slab may not be bound if another slab was created since mapping
+				glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
+				glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, mVertexSlabOffset, getSize(), mMappedData);
+				delete [] mMappedData;
+				sGLRenderBuffer = 0; // pointers must be set up again
+			}
+			else
+			{
+				glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+			}
 			stop_glerror();
-			glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+			if (mIndexSlab)
+			{
+				glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
+				glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mIndexSlabOffset, getIndicesSize(), mMappedIndexData);
+				delete [] mMappedIndexData;
+				sGLRenderIndices = 0;
+			}
+			else
+			{
+				glUnmapBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB);
+			}
 			stop_glerror();
 
 			/*if (!sMapped)
@@ -1023,6 +1222,26 @@ bool LLVertexBuffer::getClothWeightStrider(LLStrider<LLVector4>& strider, S32 in
 	return VertexBufferStrider<LLVector4,TYPE_CLOTHWEIGHT>::get(*this, strider, index);
 }
 
+void LLVertexBuffer::relocate(LLVBOSlab* slab, LLVBOSlab* new_slab, U32 new_offset)
+{
+	if (slab == mVertexSlab)
+	{
+		mVertexSlab = new_slab;
+		mVertexSlabOffset = new_offset;
+		mGLBuffer = new_slab->getName();
+	}
+	else if (slab == mIndexSlab)
+	{
+		mIndexSlab = new_slab;
+		mIndexSlabOffset = new_offset;
+		mGLIndices = new_slab->getName();
+	}
+	else
+	{
+		llerrs << "Vertex buffer relocated from a slab it doesn't use." << llendl;
+	}
+}
+
 void LLVertexBuffer::setStride(S32 type, S32 new_stride)
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_SET_STRIDE);
@@ -1063,9 +1282,14 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			glBindBufferARB(GL_ARRAY_BUFFER_ARB, mGLBuffer);
 			stop_glerror();
 			sBindCount++;
+			sFrameBindCount++;
 			sVBOActive = TRUE;
 			setup = TRUE; // ... or the bound buffer changed
 		}
+		else if (mGLBuffer && mVertexSlabOffset != sGLRenderOffset)
+		{
+			setup = TRUE; // ... or another block of the bound slab is used
+		}
 		if (mGLIndices && (mGLIndices != sGLRenderIndices || !sIBOActive))
 		{
 			/*if (sMapped)
@@ -1076,6 +1300,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mGLIndices);
 			stop_glerror();
 			sBindCount++;
+			sFrameBindCount++;
 			sIBOActive = TRUE;
 		}
 		
@@ -1152,13 +1377,14 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 				}
 			}
 
-			if (mGLBuffer)
+			// slab blocks are already allocated
+			if (mGLBuffer && !mVertexSlab)
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ARRAY_BUFFER_ARB, getSize(), NULL, mUsage);
 				stop_glerror();
 			}
-			if (mGLIndices)
+			if (mGLIndices && !mIndexSlab)
 			{
 				stop_glerror();
 				glBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, getIndicesSize(), NULL, mUsage);
@@ -1196,6 +1422,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			{
 				glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 				sBindCount++;
+				sFrameBindCount++;
 				sVBOActive = FALSE;
 				setup = TRUE; // ... or a VBO is deactivated
 			}
@@ -1212,6 +1439,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 			}*/
 			glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
 			sBindCount++;
+			sFrameBindCount++;
 			sIBOActive = FALSE;
 		}
 	}
@@ -1225,6 +1453,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 	if (mGLBuffer)
 	{
 		sGLRenderBuffer = mGLBuffer;
+		sGLRenderOffset = mVertexSlabOffset;
 		if (data_mask && setup)
 		{
 			setupVertexBuffer(data_mask); // subclass specific setup (virtual function)
@@ -1238,7 +1467,7 @@ void LLVertexBuffer::setupVertexBuffer(U32 data_mask) const
 {
 	LLMemType mt2(LLMemType::MTYPE_VERTEX_SETUP_VERTEX_BUFFER);
 	stop_glerror();
-	U8* base = useVBOs() ? NULL : mMappedData;
+	U8* base = getVerticesPointer();
 	S32 stride = mStride;
 
 	if ((data_mask & mTypeMask) != data_mask)
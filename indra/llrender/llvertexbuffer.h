@@ -33,6 +33,7 @@
 #include "v4math.h"
 #include "v4coloru.h"
 #include "llstrider.h"
+#include "llvboslab.h"
 #include "llrender.h"
 #include <set>
 #include <vector>
@@ -70,7 +71,7 @@ protected:
 //============================================================================
 // base class
 
-class LLVertexBuffer : public LLRefCount
+class LLVertexBuffer : public LLRefCount, public LLVBOSlabOwner
 {
 public:
 	static LLVBOPool sStreamVBOPool;
@@ -79,11 +80,17 @@ public:
 	static LLVBOPool sDynamicIBOPool;
 
 	static BOOL	sUseStreamDraw;
+	static BOOL	sUseSlabs;
+
+	// static vertex and index data packed into shared buffers when sUseSlabs is set
+	static LLVBOSlabPool sVertexSlabPool;
+	static LLVBOSlabPool sIndexSlabPool;
 
 	static void initClass(bool use_vbo);
 	static void cleanupClass();
 	static void setupClientArrays(U32 data_mask);
  	static void clientCopy(F64 max_time = 0.005); //copy data from client to GL
+	static void updateSlabs(); //free released slab blocks and compact slabs, once per frame
 	static void unbind(); //unbind any bound vertex buffer
 
 	//get the size of a vertex with the given typemask
@@ -140,6 +147,9 @@ protected:
 	void	updateNumIndices(S32 nindices); 
 	virtual BOOL	useVBOs() const;
 	void	unmapBuffer();
+	// LLVBOSlabOwner
+	/*virtual*/ BOOL canRelocate() const	{ return !mLocked; }
+	/*virtual*/ void relocate(LLVBOSlab* slab, LLVBOSlab* new_slab, U32 new_offset);
 		
 public:
 	LLVertexBuffer(U32 typemask, S32 usage);
@@ -176,8 +186,9 @@ public:
 	S32 getRequestedVerts() const			{ return mRequestedNumVerts; }
 	S32 getRequestedIndices() const			{ return mRequestedNumIndices; }
 
-	U8* getIndicesPointer() const			{ return useVBOs() ? NULL : mMappedIndexData; }
-	U8* getVerticesPointer() const			{ return useVBOs() ? NULL : mMappedData; }
+	// pointers to pass to GL, offsets into the bound buffer when using VBOs
+	U8* getIndicesPointer() const			{ return useVBOs() ? (U8*) NULL + mIndexSlabOffset : mMappedIndexData; }
+	U8* getVerticesPointer() const			{ return useVBOs() ? (U8*) NULL + mVertexSlabOffset : mMappedData; }
 	S32 getStride() const					{ return mStride; }
 	S32 getTypeMask() const					{ return mTypeMask; }
 	BOOL hasDataType(S32 type) const		{ return ((1 << type) & getTypeMask()) ? TRUE : FALSE; }
@@ -195,6 +206,12 @@ public:
 	void draw(U32 mode, U32 count, U32 indices_offset) const;
 	void drawArrays(U32 mode, U32 offset, U32 count) const;
 	void drawRange(U32 mode, U32 start, U32 end, U32 count, U32 indices_offset) const;
+	// Draws several index ranges within [start, end] with a single
+	// glMultiDrawElements call, or one call per range without the extension.
+	void drawMultiRange(U32 mode, U32 start, U32 end, const std::vector<U32>& counts, const std::vector<U32>& indices_offsets) const;
+	// Draws an index range instances times with GL_ARB_draw_instanced, the
+	// bound shader tells the instances apart by gl_InstanceIDARB.
+	void drawInstanced(U32 mode, U32 count, U32 indices_offset, U32 instances) const;
 
 protected:	
 	S32		mNumVerts;		// Number of vertices allocated
@@ -216,6 +233,10 @@ protected:
 	S32		mOffsets[TYPE_MAX];
 	BOOL	mResized;		// if TRUE, client buffer has been resized and GL buffer has not
 	BOOL	mDynamicSize;	// if TRUE, buffer has been resized at least once (and should be padded)
+	LLVBOSlab* mVertexSlab;	// slab holding the vertex data (NULL if it has its own GL buffer)
+	LLVBOSlab* mIndexSlab;	// slab holding the indices (NULL if they have their own GL buffer)
+	U32		mVertexSlabOffset;
+	U32		mIndexSlabOffset;
 
 	class DirtyRegion
 	{
@@ -244,6 +265,7 @@ public:
 	static S32 sTypeOffsets[TYPE_MAX];
 	static U32 sGLMode[LLRender::NUM_MODES];
 	static U32 sGLRenderBuffer;
+	static U32 sGLRenderOffset;	// vertex data offset into sGLRenderBuffer of the last buffer set
 	static U32 sGLRenderIndices;
 	static BOOL sVBOActive;
 	static BOOL sIBOActive;
@@ -251,6 +273,8 @@ public:
 	static U32 sAllocatedBytes;
 	static U32 sBindCount;
 	static U32 sSetCount;
+	static U32 sFrameBindCount;	// buffer binds this frame, reset by the pipeline
+	static U32 sSlabWastedBytes;	// slab bytes not holding requested data, as of the last updateSlabs()
 };
 
 
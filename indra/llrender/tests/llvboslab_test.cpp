@@ -0,0 +1,365 @@
+/**
+ * @file llvboslab_test.cpp
+ * @brief Allocate, release and compaction tests for the vertex buffer slabs
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvboslab.h"
+#include "../llglheaders.h"
+#include "../llvertexbuffer.h"
+
+#include "../test/lltut.h"
+
+#include <map>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Stubs: buffer objects live in client memory so the tests can check what
+// compaction copied.
+
+namespace
+{
+	typedef std::map<GLuint, std::vector<U8> > buffer_map_t;
+	buffer_map_t sBuffers;
+	std::map<GLenum, GLuint> sBound;
+	GLuint sNextName = 1;
+	U32 sBytesCopied = 0;
+
+	void APIENTRY fake_gen_buffers(GLsizei n, GLuint* buffers)
+	{
+		for (GLsizei i = 0; i < n; i++)
+		{
+			buffers[i] = sNextName++;
+			sBuffers[buffers[i]];
+		}
+	}
+
+	void APIENTRY fake_delete_buffers(GLsizei n, const GLuint* buffers)
+	{
+		for (GLsizei i = 0; i < n; i++)
+		{
+			sBuffers.erase(buffers[i]);
+		}
+	}
+
+	void APIENTRY fake_bind_buffer(GLenum target, GLuint buffer)
+	{
+		sBound[target] = buffer;
+	}
+
+	void APIENTRY fake_buffer_data(GLenum target, GLsizeiptrARB size, const GLvoid*, GLenum)
+	{
+		sBuffers[sBound[target]].assign(size, 0);
+	}
+
+#if !LL_DARWIN
+	void APIENTRY fake_copy_buffer_sub_data(GLenum read_target, GLenum write_target, GLintptr read_offset, GLintptr write_offset, GLsizeiptr size)
+	{
+		std::vector<U8>& src = sBuffers[sBound[read_target]];
+		std::vector<U8>& dst = sBuffers[sBound[write_target]];
+		memcpy(&dst[write_offset], &src[read_offset], size);
+		sBytesCopied += size;
+	}
+#endif
+}
+
+#if LL_DARWIN
+void glGenBuffersARB(GLsizei n, GLuint* buffers) { fake_gen_buffers(n, buffers); }
+void glDeleteBuffersARB(GLsizei n, const GLuint* buffers) { fake_delete_buffers(n, buffers); }
+void glBindBufferARB(GLenum target, GLuint buffer) { fake_bind_buffer(target, buffer); }
+void glBufferDataARB(GLenum target, GLsizeiptrARB size, const GLvoid* data, GLenum usage) { fake_buffer_data(target, size, data, usage); }
+#else
+PFNGLGENBUFFERSARBPROC glGenBuffersARB = fake_gen_buffers;
+PFNGLDELETEBUFFERSARBPROC glDeleteBuffersARB = fake_delete_buffers;
+PFNGLBINDBUFFERARBPROC glBindBufferARB = fake_bind_buffer;
+PFNGLBUFFERDATAARBPROC glBufferDataARB = fake_buffer_data;
+PFNGLCOPYBUFFERSUBDATAPROC glCopyBufferSubData = fake_copy_buffer_sub_data;
+#endif
+
+void assert_glerror() {}
+void LLVertexBuffer::unbind() {}
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+	// Stands in for an LLVertexBuffer, checks it is told where its block went.
+	class TestOwner : public LLVBOSlabOwner
+	{
+	public:
+		TestOwner() : mSlab(NULL), mOffset(0), mSize(0), mLocked(FALSE), mMoves(0) {}
+
+		/*virtual*/ BOOL canRelocate() const	{ return !mLocked; }
+		/*virtual*/ void relocate(LLVBOSlab* slab, LLVBOSlab* new_slab, U32 new_offset)
+		{
+			tut::ensure("relocated from the slab it is in", slab == mSlab);
+			mSlab = new_slab;
+			mOffset = new_offset;
+			mMoves++;
+		}
+
+		bool allocate(LLVBOSlabPool& pool, U32 size)
+		{
+			mSize = size;
+			mSlab = pool.allocate(size, this, mOffset);
+			return mSlab != NULL;
+		}
+
+		void release(LLVBOSlabPool& pool)
+		{
+			pool.release(mSlab, mOffset);
+			mSlab = NULL;
+		}
+
+		// Writes a pattern to the block, check() finds it wherever the block is now.
+		void fill(U8 seed)
+		{
+			std::vector<U8>& data = sBuffers[mSlab->getName()];
+			for (U32 i = 0; i < mSize; i++)
+			{
+				data[mOffset + i] = U8(seed + i);
+			}
+			mSeed = seed;
+		}
+
+		bool check() const
+		{
+			const std::vector<U8>& data = sBuffers[mSlab->getName()];
+			for (U32 i = 0; i < mSize; i++)
+			{
+				if (data[mOffset + i] != U8(mSeed + i))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		LLVBOSlab* mSlab;
+		U32 mOffset;
+		U32 mSize;
+		BOOL mLocked;
+		S32 mMoves;
+		U8 mSeed;
+	};
+
+	const U32 TEST_SLAB_SIZE = 4096;
+	const U32 TEST_BLOCK_SIZE = TEST_SLAB_SIZE/4;	// largest block the pool takes
+}
+
+namespace tut
+{
+	struct vboslab_data
+	{
+		vboslab_data()
+		:	mPool(GL_ARRAY_BUFFER_ARB)
+		{
+			LLVBOSlabPool::sSlabSize = TEST_SLAB_SIZE;
+			sBytesCopied = 0;
+		}
+
+		~vboslab_data()
+		{
+			mPool.cleanup();
+		}
+
+		LLVBOSlabPool mPool;
+	};
+	typedef test_group<vboslab_data> vboslab_t;
+	typedef vboslab_t::object vboslab_object_t;
+	tut::vboslab_t tut_vboslab("LLVBOSlab");
+
+	// Blocks are aligned, don't overlap and fill a slab before the next one.
+	template<> template<>
+	void vboslab_object_t::test<1>()
+	{
+		set_test_name("allocate");
+
+		TestOwner owners[8];
+		std::map<U32, U32> used;
+		for (S32 i = 0; i < 8; i++)
+		{
+			ensure("block allocated", owners[i].allocate(mPool, 100 + i*10));
+			ensure_equals("aligned", owners[i].mOffset % 32, (U32) 0);
+			ensure("same slab", owners[i].mSlab == owners[0].mSlab);
+			used[owners[i].mOffset] = owners[i].mSize;
+		}
+
+		U32 end = 0;
+		for (std::map<U32, U32>::iterator iter = used.begin(); iter != used.end(); ++iter)
+		{
+			ensure("no overlap", iter->first >= end);
+			end = iter->first + iter->second;
+		}
+
+		ensure_equals("one slab", mPool.getSlabCount(), (U32) 1);
+		ensure_equals("wasted bytes", mPool.getWastedBytes(), TEST_SLAB_SIZE - (100*8 + 10*28));
+
+		TestOwner big;
+		ensure("too big to pack", !big.allocate(mPool, TEST_BLOCK_SIZE + 1));
+		ensure("empty", !big.allocate(mPool, 0));
+
+		for (S32 i = 0; i < 8; i++)
+		{
+			owners[i].release(mPool);
+		}
+	}
+
+	// Released blocks are only reused after update(), and merge back into
+	// one free block.
+	template<> template<>
+	void vboslab_object_t::test<2>()
+	{
+		set_test_name("release");
+
+		TestOwner owners[4];
+		for (S32 i = 0; i < 4; i++)
+		{
+			ensure("block allocated", owners[i].allocate(mPool, TEST_BLOCK_SIZE));
+		}
+		LLVBOSlab* slab = owners[0].mSlab;
+		ensure_equals("slab full", slab->getFreeBytes(), (U32) 0);
+
+		owners[1].release(mPool);
+		owners[2].release(mPool);
+
+		TestOwner again;
+		ensure("block allocated", again.allocate(mPool, TEST_BLOCK_SIZE));
+		ensure("not reused before update", again.mSlab != slab);
+		again.release(mPool);
+
+		mPool.update(0);
+		ensure_equals("one slab kept", mPool.getSlabCount(), (U32) 2);
+
+		TestOwner merged;
+		ensure("block allocated", merged.allocate(mPool, TEST_BLOCK_SIZE));
+		ensure("reused after update", merged.mSlab == slab);
+		ensure_equals("first free block", merged.mOffset, TEST_BLOCK_SIZE);
+
+		merged.release(mPool);
+		owners[0].release(mPool);
+		owners[3].release(mPool);
+		mPool.update(0);
+		ensure_equals("empty slab kept", mPool.getSlabCount(), (U32) 1);
+		ensure("empty", slab->isEmpty());
+		ensure_equals("free blocks merged", slab->getFreeBytes(), TEST_SLAB_SIZE);
+	}
+
+	// A sparse slab is moved into the others past the spare empty slab, with
+	// the data intact.
+	template<> template<>
+	void vboslab_object_t::test<3>()
+	{
+		set_test_name("compact");
+
+#if LL_DARWIN
+		skip("no GL_ARB_copy_buffer stub on this platform");
+#endif
+
+		TestOwner full[8];
+		for (S32 i = 0; i < 8; i++)
+		{
+			ensure("block allocated", full[i].allocate(mPool, TEST_BLOCK_SIZE));
+			full[i].fill(U8(i * 16));
+		}
+		TestOwner sparse;
+		ensure("block allocated", sparse.allocate(mPool, 200));
+		sparse.fill(7);
+
+		LLVBOSlab* first = full[0].mSlab;
+		LLVBOSlab* second = full[4].mSlab;
+		LLVBOSlab* third = sparse.mSlab;
+		ensure("three slabs", first != second && second != third && first != third);
+
+		// half of the first slab and all of the second free
+		full[1].release(mPool);
+		full[2].release(mPool);
+		for (S32 i = 4; i < 8; i++)
+		{
+			full[i].release(mPool);
+		}
+
+		mPool.update(0);
+		ensure_equals("nothing moved without budget", sparse.mMoves, 0);
+
+		sparse.mLocked = TRUE;
+		mPool.update(TEST_SLAB_SIZE);
+		ensure_equals("locked block left alone", sparse.mMoves, 0);
+		sparse.mLocked = FALSE;
+
+		mPool.update(TEST_SLAB_SIZE);
+		ensure_equals("sparse block moved", sparse.mMoves, 1);
+		ensure("moved into the part full slab", sparse.mSlab == first);
+		ensure_equals("only the block copied", sBytesCopied, (U32) 200);
+		ensure("data copied", sparse.check());
+		ensure("other blocks intact", full[0].check() && full[3].check());
+		ensure_equals("source emptied", third->getUsedBytes(), (U32) 0);
+
+		// the emptied slab goes once its released block is flushed, the
+		// spare stays
+		mPool.update(TEST_SLAB_SIZE);
+		ensure_equals("one spare slab", mPool.getSlabCount(), (U32) 2);
+
+		sparse.release(mPool);
+		full[0].release(mPool);
+		full[3].release(mPool);
+	}
+
+	// A sparse slab next to only the spare empty slab stays where it is,
+	// rather than swapping places with the spare every update.
+	template<> template<>
+	void vboslab_object_t::test<4>()
+	{
+		set_test_name("compact with only a spare");
+
+		TestOwner full[4];
+		for (S32 i = 0; i < 4; i++)
+		{
+			ensure("block allocated", full[i].allocate(mPool, TEST_BLOCK_SIZE));
+		}
+		TestOwner sparse;
+		ensure("block allocated", sparse.allocate(mPool, 200));
+		sparse.fill(7);
+		LLVBOSlab* slab = sparse.mSlab;
+		ensure("second slab", slab != full[0].mSlab);
+
+		for (S32 i = 0; i < 4; i++)
+		{
+			full[i].release(mPool);
+		}
+
+		for (S32 i = 0; i < 4; i++)
+		{
+			mPool.update(TEST_SLAB_SIZE);
+		}
+		ensure_equals("sparse block not moved", sparse.mMoves, 0);
+		ensure_equals("nothing copied", sBytesCopied, (U32) 0);
+		ensure("same slab", sparse.mSlab == slab);
+		ensure("data intact", sparse.check());
+		ensure_equals("used slab and spare", mPool.getSlabCount(), (U32) 2);
+
+		sparse.release(mPool);
+	}
+}
@@ -3085,7 +3085,7 @@ bool LLFloater::buildFromFile(const std::string& filename, LLXMLNodePtr output_n
 			return false;
 		}
 	}
-	else if (!LLUICtrlFactory::getLayeredXMLNode(filename, root))
+	else if (!LLUICtrlFactory::getXUITemplate(filename, root))
 	{
 		llwarns << "Couldn't parse floater from: " << LLUI::getSkinPath() + gDirUtilp->getDirDelimiter() + filename << llendl;
 		return false;
@@ -1000,6 +1000,8 @@ LLView* LLMenuItemBranchGL::findChildView(const std::string& name, BOOL recurse)
 	LLMenuGL* branch = getBranch();
 	if (branch)
 	{
+		// the branch menu lives outside this item's tree
+		findChildLeftTree();
 		if (branch->getName() == name)
 		{
 			return branch;
@@ -526,7 +526,7 @@ BOOL LLPanel::initPanelXML(LLXMLNodePtr node, LLView *parent, LLXMLNodePtr outpu
 				return TRUE;
 			}
 		
-			if (!LLUICtrlFactory::getLayeredXMLNode(xml_filename, referenced_xml))
+			if (!LLUICtrlFactory::getXUITemplate(xml_filename, referenced_xml))
 			{
 				llwarns << "Couldn't parse panel from: " << xml_filename << llendl;
 
@@ -983,7 +983,7 @@ BOOL LLPanel::buildFromFile(const std::string& filename, LLXMLNodePtr output_nod
 			return didPost;
 		}
 	}
-	else if (!LLUICtrlFactory::getLayeredXMLNode(filename, root))
+	else if (!LLUICtrlFactory::getXUITemplate(filename, root))
 	{
 		llwarns << "Couldn't parse panel from: " << LLUI::getSkinPath() + gDirUtilp->getDirDelimiter() + filename << llendl;
 		return didPost;
@@ -35,6 +35,7 @@
 #include "llstl.h"
 #include "lltextparser.h"
 #include "lltextutil.h"
+#include "lltimer.h"
 #include "lltooltip.h"
 #include "lluictrl.h"
 #include "llurlaction.h"
@@ -46,13 +47,6 @@
 const F32	CURSOR_FLASH_DELAY = 1.0f;  // in seconds
 const S32	CURSOR_THICKNESS = 2;
 
-LLTextBase::line_info::line_info(S32 index_start, S32 index_end, LLRect rect, S32 line_num) 
-:	mDocIndexStart(index_start), 
-	mDocIndexEnd(index_end),
-	mRect(rect),
-	mLineNum(line_num)
-{}
-
 bool LLTextBase::compare_segment_end::operator()(const LLTextSegmentPtr& a, const LLTextSegmentPtr& b) const
 {
 	// sort empty spans (e.g. 11-11) after previous non-empty spans (e.g. 5-11)
@@ -190,6 +184,10 @@ LLTextBase::LLTextBase(const LLTextBase::Params &p)
 	mTextSelectedColor(p.text_selected_color),
 	mSelectedBGColor(p.bg_selected_color),
 	mReflowIndex(S32_MAX),
+	mReflowEnd(0),
+	mLineOffsetY(0),
+	mLayoutWidth(0),
+	mRewrapFrame(0),
 	mCursorPos( 0 ),
 	mScrollNeeded(FALSE),
 	mDesiredXPixel(-1),
@@ -278,7 +276,7 @@ bool LLTextBase::truncate()
 	if (getLength() >= S32(mMaxTextByteLength / 4))
 	{	
 		// Have to check actual byte size
-        LLWString text(getWText());
+		const LLWString& text = getWText();
 		S32 utf8_byte_size = wstring_utf8_length(text);
 		if ( utf8_byte_size > mMaxTextByteLength )
 		{
@@ -333,8 +331,8 @@ void LLTextBase::drawSelectionBackground()
 		LLRect content_display_rect = getVisibleDocumentRect();
 
 		// binary search for line that starts before top of visible buffer
-		line_list_t::const_iterator line_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), content_display_rect.mTop, compare_bottom());
-		line_list_t::const_iterator end_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), content_display_rect.mBottom, compare_top());
+		line_list_t::const_iterator line_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), content_display_rect.mTop - mLineOffsetY, compare_bottom());
+		line_list_t::const_iterator end_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), content_display_rect.mBottom - mLineOffsetY, compare_top());
 
 		bool done = false;
 
@@ -348,11 +346,8 @@ void LLTextBase::drawSelectionBackground()
 				S32 segment_offset;
 				getSegmentAndOffset(line_iter->mDocIndexStart, &segment_iter, &segment_offset);
 				
-				LLRect selection_rect;
-				selection_rect.mLeft = line_iter->mRect.mLeft;
-				selection_rect.mRight = line_iter->mRect.mLeft;
-				selection_rect.mBottom = line_iter->mRect.mBottom;
-				selection_rect.mTop = line_iter->mRect.mTop;
+				LLRect selection_rect = getLineRect(*line_iter);
+				selection_rect.mRight = selection_rect.mLeft;
 					
 				for(;segment_iter != mSegments.end(); ++segment_iter, segment_offset = 0)
 				{
@@ -534,7 +529,7 @@ void LLTextBase::drawText()
 	for (S32 cur_line = first_line; cur_line < last_line; cur_line++)
 	{
 		S32 next_line = cur_line + 1;
-		line_info& line = mLineInfoList[cur_line];
+		LLRect line_rect = getLineRect(mLineInfoList[cur_line]);
 
 		S32 next_start = -1;
 		S32 line_end = text_len;
@@ -545,10 +540,10 @@ void LLTextBase::drawText()
 			line_end = next_start;
 		}
 
-		LLRect text_rect(line.mRect.mLeft + mVisibleTextRect.mLeft - scrolled_view_rect.mLeft,
-						line.mRect.mTop - scrolled_view_rect.mBottom + mVisibleTextRect.mBottom,
-						llmin(mDocumentView->getRect().getWidth(), line.mRect.mRight) - scrolled_view_rect.mLeft,
-						line.mRect.mBottom - scrolled_view_rect.mBottom + mVisibleTextRect.mBottom);
+		LLRect text_rect(line_rect.mLeft + mVisibleTextRect.mLeft - scrolled_view_rect.mLeft,
+						line_rect.mTop - scrolled_view_rect.mBottom + mVisibleTextRect.mBottom,
+						llmin(mDocumentView->getRect().getWidth(), line_rect.mRight) - scrolled_view_rect.mLeft,
+						line_rect.mBottom - scrolled_view_rect.mBottom + mVisibleTextRect.mBottom);
 
 		// draw a single line of text
 		S32 seg_start = line_start;
@@ -592,8 +587,7 @@ void LLTextBase::drawText()
 
 S32 LLTextBase::insertStringNoUndo(S32 pos, const LLWString &wstr, LLTextBase::segment_vec_t* segments )
 {
-	LLWString text(getWText());
-	S32 old_len = text.length();		// length() returns character length
+	S32 old_len = getLength();
 	S32 insert_len = wstr.length();
 
 	pos = getEditableIndex(pos, true);
@@ -613,6 +607,8 @@ S32 LLTextBase::insertStringNoUndo(S32 pos, const LLWString &wstr, LLTextBase::s
 		return pos;
 	}
 
+	shiftLayout(pos, insert_len);
+
 	if (segmentp->canEdit())
 	{
 		segmentp->setEnd(segmentp->getEnd() + insert_len);
@@ -653,8 +649,9 @@ S32 LLTextBase::insertStringNoUndo(S32 pos, const LLWString &wstr, LLTextBase::s
 		}
 	}
 
-	text.insert(pos, wstr);
-    getViewModel()->setDisplay(text);
+	// edit in place, copying the whole text makes every append to a long
+	// document slower than the last
+	getViewModel()->getEditableDisplay().insert(pos, wstr);
 
 	if ( truncate() )
 	{
@@ -662,14 +659,13 @@ S32 LLTextBase::insertStringNoUndo(S32 pos, const LLWString &wstr, LLTextBase::s
 	}
 
 	onValueChange(pos, pos + insert_len);
-	needsReflow(pos);
+	needsReflow(pos, pos + insert_len);
 
 	return insert_len;
 }
 
 S32 LLTextBase::removeStringNoUndo(S32 pos, S32 length)
 {
-    LLWString text(getWText());
 	segment_set_t::iterator seg_iter = getSegIterContaining(pos);
 	while(seg_iter != mSegments.end())
 	{
@@ -715,14 +711,14 @@ S32 LLTextBase::removeStringNoUndo(S32 pos, S32 length)
 		++seg_iter;
 	}
 
-	text.erase(pos, length);
-    getViewModel()->setDisplay(text);
+	getViewModel()->getEditableDisplay().erase(pos, length);
+	shiftLayout(pos, -length);
 
 	// recreate default segment in case we erased everything
 	createDefaultSegment();
 
 	onValueChange(pos, pos);
-	needsReflow(pos);
+	needsReflow(pos, pos);
 
 	return -length;	// This will be wrong if someone calls removeStringNoUndo with an excessive length
 }
@@ -733,12 +729,10 @@ S32 LLTextBase::overwriteCharNoUndo(S32 pos, llwchar wc)
 	{
 		return 0;
 	}
-    LLWString text(getWText());
-	text[pos] = wc;
-    getViewModel()->setDisplay(text);
+	getViewModel()->getEditableDisplay()[pos] = wc;
 
 	onValueChange(pos, pos + 1);
-	needsReflow(pos);
+	needsReflow(pos, pos + 1);
 
 	return 1;
 }
@@ -834,7 +828,38 @@ void LLTextBase::insertSegment(LLTextSegmentPtr segment_to_insert)
 	}
 
 	// layout potentially changed
-	needsReflow(reflow_start_index);
+	needsReflow(reflow_start_index, segment_to_insert->getEnd());
+}
+
+// Folds the plain text segment starting at index into the one before it
+// when they share a style, so a long transcript appended a piece at a time
+// doesn't keep a segment for every piece.
+void LLTextBase::mergeWithPreviousSegment(S32 index)
+{
+	segment_set_t::iterator seg_iter = getSegIterContaining(index);
+	if (seg_iter == mSegments.end() || seg_iter == mSegments.begin())
+	{
+		return;
+	}
+	segment_set_t::iterator prev_iter = seg_iter;
+	--prev_iter;
+
+	LLTextSegmentPtr segmentp = *seg_iter;
+	LLTextSegmentPtr prev_segmentp = *prev_iter;
+	if (segmentp->getStart() != index
+		|| prev_segmentp->getEnd() != index
+		|| typeid(*segmentp) != typeid(LLNormalTextSegment)
+		|| typeid(*prev_segmentp) != typeid(LLNormalTextSegment))
+	{
+		return;
+	}
+
+	if (static_cast<LLNormalTextSegment*>(prev_segmentp.get())->canMergeWith(*static_cast<LLNormalTextSegment*>(segmentp.get())))
+	{
+		segmentp->unlinkFromDocument(this);
+		mSegments.erase(seg_iter);
+		prev_segmentp->setEnd(segmentp->getEnd());
+	}
 }
 
 BOOL LLTextBase::handleMouseDown(S32 x, S32 y, MASK mask)
@@ -978,7 +1003,7 @@ void LLTextBase::reshape(S32 width, S32 height, BOOL called_from_parent)
 		// up-to-date mVisibleTextRect
 		updateRects();
 		
-		needsReflow();
+		needsRewrap();
 	}
 }
 
@@ -1123,7 +1148,7 @@ void LLTextBase::reflow()
 
 	updateSegments();
 
-	if (mReflowIndex == S32_MAX)
+	if (mReflowIndex == S32_MAX && mStaleLayout.empty())
 	{
 		return;
 	}
@@ -1151,6 +1176,10 @@ void LLTextBase::reflow()
 	first_char_rect.mTop = mVisibleTextRect.mTop - first_char_rect.mTop;
 	first_char_rect.mBottom = mVisibleTextRect.mTop - first_char_rect.mBottom;
 
+	// first character whose line moved, and where the lines sat before
+	S32 layout_start = S32_MAX;
+	S32 old_line_offset = mLineOffsetY;
+
 	S32 reflow_count = 0;
 	while(mReflowIndex < S32_MAX)
 	{
@@ -1166,126 +1195,45 @@ void LLTextBase::reflow()
 		}
 	
 		S32 start_index = mReflowIndex;
+		S32 stop_index = mReflowEnd;
 		mReflowIndex = S32_MAX;
+		mReflowEnd = 0;
 
 		// shrink document to minimum size (visible portion of text widget)
 		// to force inlined widgets with follows set to shrink
 		mDocumentView->reshape(mVisibleTextRect.getWidth(), mDocumentView->getRect().getHeight());
 
-		S32 cur_top = 0;
-
-		segment_set_t::iterator seg_iter = mSegments.begin();
-		S32 seg_offset = 0;
-		S32 line_start_index = 0;
-		const S32 text_available_width = mVisibleTextRect.getWidth() - mHPad;  // reserve room for margin
-		S32 remaining_pixels = text_available_width;
-		S32 line_count = 0;
-
-		// find and erase line info structs starting at start_index and going to end of document
-		if (!mLineInfoList.empty())
-		{
-			// find first element whose end comes after start_index
-			line_list_t::iterator iter = std::upper_bound(mLineInfoList.begin(), mLineInfoList.end(), start_index, line_end_compare());
-			line_start_index = iter->mDocIndexStart;
-			line_count = iter->mLineNum;
-			cur_top = iter->mRect.mTop;
-			getSegmentAndOffset(iter->mDocIndexStart, &seg_iter, &seg_offset);
-			mLineInfoList.erase(iter, mLineInfoList.end());
-		}
-
-		S32 line_height = 0;
-
-		while(seg_iter != mSegments.end())
-		{
-			LLTextSegmentPtr segment = *seg_iter;
-
-			// track maximum height of any segment on this line
-			S32 cur_index = segment->getStart() + seg_offset;
+		// relayout from the paragraph containing start_index up to the first
+		// paragraph after the changed text, the lines after that are kept
+		S32 reflow_line = LLTextLines::findParagraphStart(mLineInfoList, start_index);
+		S32 first_char = mLineInfoList.empty() ? 0 : mLineInfoList[reflow_line].mDocIndexStart;
 
-			// ask segment how many character fit in remaining space
-			S32 character_count = segment->getNumChars(getWordWrap() ? llmax(0, remaining_pixels) : S32_MAX,
-														seg_offset, 
-														cur_index - line_start_index, 
-														S32_MAX);
-
-			S32 segment_width, segment_height;
-			bool force_newline = segment->getDimensions(seg_offset, character_count, segment_width, segment_height);
-			// grow line height as necessary based on reported height of this segment
-			line_height = llmax(line_height, segment_height);
-			remaining_pixels -= segment_width;
-
-			seg_offset += character_count;
-
-			S32 last_segment_char_on_line = segment->getStart() + seg_offset;
-
-			S32 text_actual_width = text_available_width - remaining_pixels;
-			S32 text_left = getLeftOffset(text_actual_width);
-			LLRect line_rect(text_left, 
-							cur_top, 
-							text_left + text_actual_width, 
-							cur_top - line_height);
-
-			// if we didn't finish the current segment...
-			if (last_segment_char_on_line < segment->getEnd())
-			{
-				// add line info and keep going
-				mLineInfoList.push_back(line_info(
-											line_start_index, 
-											last_segment_char_on_line, 
-											line_rect, 
-											line_count));
-
-				line_start_index = segment->getStart() + seg_offset;
-				cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
-				remaining_pixels = text_available_width;
-				line_height = 0;
-			}
-			// ...just consumed last segment..
-			else if (++segment_set_t::iterator(seg_iter) == mSegments.end())
-			{
-				mLineInfoList.push_back(line_info(
-											line_start_index, 
-											last_segment_char_on_line, 
-											line_rect, 
-											line_count));
-				cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
-				break;
-			}
-			// ...or finished a segment and there are segments remaining on this line
-			else
-			{
-				// subtract pixels used and increment segment
-				if (force_newline)
-				{
-					mLineInfoList.push_back(line_info(
-												line_start_index, 
-												last_segment_char_on_line, 
-												line_rect, 
-												line_count));
-					line_start_index = segment->getStart() + seg_offset;
-					cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
-					line_height = 0;
-					remaining_pixels = text_available_width;
-				}
-				++seg_iter;
-				seg_offset = 0;
-			}
-			if (force_newline) 
-			{
-				line_count++;
-			}
-		}
+		S32 laid_out_end = layoutLines(reflow_line, stop_index);
+		clearStaleLayout(first_char, laid_out_end);
+		layout_start = llmin(layout_start, first_char);
 
 		// calculate visible region for diplaying text
 		updateRects();
+	}
+
+	if (!mStaleLayout.empty())
+	{
+		layout_start = llmin(layout_start, rewrapStaleLines());
+		updateRects();
+	}
 
-		for (segment_set_t::iterator segment_it = mSegments.begin();
-			segment_it != mSegments.end();
-			++segment_it)
+	if (layout_start < S32_MAX || mLineOffsetY != old_line_offset)
+	{
+		// inline views are placed in document coordinates, so when the
+		// document changes height all of them move, otherwise only those
+		// after the text that was laid out
+		segment_set_t::iterator segment_it = mLineOffsetY != old_line_offset
+			? mSegments.begin()
+			: getSegIterContaining(layout_start);
+		for (; segment_it != mSegments.end(); ++segment_it)
 		{
 			LLTextSegmentPtr segmentp = *segment_it;
 			segmentp->updateLayout(*this);
-
 		}
 	}
 
@@ -1325,6 +1273,274 @@ void LLTextBase::reflow()
 	updateCursorXPos();
 }
 
+// Lays out the text from the start of line first_line up to the first hard
+// line break after stop_index, replacing the lines that held it and moving
+// the lines after them up or down to fit. Returns the index of the first
+// character not laid out, or S32_MAX at the end of the document.
+S32 LLTextBase::layoutLines(S32 first_line, S32 stop_index)
+{
+	S32 cur_top = 0;
+
+	segment_set_t::iterator seg_iter = mSegments.begin();
+	S32 seg_offset = 0;
+	S32 line_start_index = 0;
+	const S32 text_available_width = mVisibleTextRect.getWidth() - mHPad;  // reserve room for margin
+	S32 remaining_pixels = text_available_width;
+	S32 line_count = 0;
+
+	if (first_line < (S32)mLineInfoList.size())
+	{
+		const line_info& line = mLineInfoList[first_line];
+		line_start_index = line.mDocIndexStart;
+		line_count = line.mLineNum;
+		cur_top = line.mRect.mTop;
+		getSegmentAndOffset(line_start_index, &seg_iter, &seg_offset);
+	}
+	mLayoutWidth = text_available_width;
+
+	line_list_t new_lines;
+	S32 line_height = 0;
+	bool stopped = false;
+
+	while(seg_iter != mSegments.end())
+	{
+		LLTextSegmentPtr segment = *seg_iter;
+
+		// track maximum height of any segment on this line
+		S32 cur_index = segment->getStart() + seg_offset;
+
+		// ask segment how many character fit in remaining space
+		S32 character_count = segment->getNumChars(getWordWrap() ? llmax(0, remaining_pixels) : S32_MAX,
+													seg_offset, 
+													cur_index - line_start_index, 
+													S32_MAX);
+
+		S32 segment_width, segment_height;
+		bool force_newline = segment->getDimensions(seg_offset, character_count, segment_width, segment_height);
+		// grow line height as necessary based on reported height of this segment
+		line_height = llmax(line_height, segment_height);
+		remaining_pixels -= segment_width;
+
+		seg_offset += character_count;
+
+		S32 last_segment_char_on_line = segment->getStart() + seg_offset;
+
+		S32 text_actual_width = text_available_width - remaining_pixels;
+		S32 text_left = getLeftOffset(text_actual_width);
+		LLRect line_rect(text_left, 
+						cur_top, 
+						text_left + text_actual_width, 
+						cur_top - line_height);
+
+		// if we didn't finish the current segment...
+		if (last_segment_char_on_line < segment->getEnd())
+		{
+			// add line info and keep going
+			new_lines.push_back(line_info(
+										line_start_index, 
+										last_segment_char_on_line, 
+										line_rect, 
+										line_count));
+
+			line_start_index = segment->getStart() + seg_offset;
+			cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
+			remaining_pixels = text_available_width;
+			line_height = 0;
+		}
+		// ...just consumed last segment..
+		else if (++segment_set_t::iterator(seg_iter) == mSegments.end())
+		{
+			new_lines.push_back(line_info(
+										line_start_index, 
+										last_segment_char_on_line, 
+										line_rect, 
+										line_count));
+			cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
+			break;
+		}
+		// ...or finished a segment and there are segments remaining on this line
+		else
+		{
+			// subtract pixels used and increment segment
+			if (force_newline)
+			{
+				new_lines.push_back(line_info(
+											line_start_index, 
+											last_segment_char_on_line, 
+											line_rect, 
+											line_count));
+				line_start_index = segment->getStart() + seg_offset;
+				cur_top -= llround((F32)line_height * mLineSpacingMult) + mLineSpacingPixels;
+				line_height = 0;
+				remaining_pixels = text_available_width;
+			}
+			++seg_iter;
+			seg_offset = 0;
+		}
+		if (force_newline) 
+		{
+			line_count++;
+			// a hard line break in unchanged text starts a line in any
+			// layout, so the old lines from here on can stay
+			if (line_start_index > stop_index)
+			{
+				stopped = true;
+				break;
+			}
+		}
+	}
+
+	LLTextLines::replaceLines(mLineInfoList, first_line, new_lines,
+							  stopped ? line_start_index : S32_MAX, cur_top, line_count);
+
+	return stopped ? line_start_index : S32_MAX;
+}
+
+LLRect LLTextBase::getLineRect(const line_info& line) const
+{
+	LLRect rect = line.mRect;
+	rect.translate(0, mLineOffsetY);
+	return rect;
+}
+
+// Documents shorter than this rewrap all at once when their width changes.
+const S32 REWRAP_MIN_LINES = 1000;
+// Lines rewrapped in one step away from the viewport.
+const S32 REWRAP_CHUNK_LINES = 100;
+// Seconds a frame may spend rewrapping away from the viewport.
+const F32 REWRAP_TIME_LIMIT = 0.002f;
+
+void LLTextBase::needsRewrap()
+{
+	if (getLineCount() < REWRAP_MIN_LINES || mReflowIndex == 0)
+	{
+		needsReflow();
+	}
+	else if (mVisibleTextRect.getWidth() - mHPad != mLayoutWidth)
+	{
+		// the text around the viewport is rewrapped first, the rest a little
+		// at a time over the following frames
+		mStaleLayout.assign(1, std::make_pair(0, S32_MAX));
+	}
+}
+
+static LLFastTimer::DeclareTimer FTM_TEXT_REWRAP ("Text Rewrap");
+
+// Returns the first character whose line moved, S32_MAX if none did.
+S32 LLTextBase::rewrapStaleLines()
+{
+	LLFastTimer ft(FTM_TEXT_REWRAP);
+
+	S32 layout_start = S32_MAX;
+	if (mLineInfoList.empty())
+	{
+		mStaleLayout.clear();
+		return layout_start;
+	}
+
+	// the visible lines and a page either side of them first, so what is
+	// on screen is right this frame
+	LLRect visible_region = getVisibleDocumentRect();
+	S32 first_line = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop - mLineOffsetY, compare_bottom()) - mLineInfoList.begin();
+	S32 last_line = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mBottom - mLineOffsetY, compare_top()) - mLineInfoList.begin();
+	S32 margin = llmax(last_line - first_line, 20);
+	S32 view_start = getLineStart(first_line - margin);
+	S32 view_end = getLineEnd(last_line + margin);
+
+	for (doc_range_list_t::iterator iter = mStaleLayout.begin(); iter != mStaleLayout.end(); )
+	{
+		if (iter->second <= view_start || iter->first >= view_end)
+		{
+			++iter;
+			continue;
+		}
+		layout_start = llmin(layout_start, rewrapRange(llmax(iter->first, view_start), llmin(iter->second, view_end)));
+		// the ranges have changed, look again
+		iter = mStaleLayout.begin();
+	}
+
+	// then the rest, once a frame
+	if (mRewrapFrame == LLFrameTimer::getFrameCount())
+	{
+		return layout_start;
+	}
+	mRewrapFrame = LLFrameTimer::getFrameCount();
+
+	LLTimer timer;
+	while (!mStaleLayout.empty() && timer.getElapsedTimeF32() < REWRAP_TIME_LIMIT)
+	{
+		// text below the viewport first, as it doesn't move what's on screen
+		doc_range_list_t::iterator below = mStaleLayout.begin();
+		while (below != mStaleLayout.end() && below->first < view_end)
+		{
+			++below;
+		}
+
+		if (below != mStaleLayout.end())
+		{
+			S32 start = below->first;
+			S32 end = llmin(below->second, getLineEnd(getLineNumFromDocIndex(start) + REWRAP_CHUNK_LINES));
+			layout_start = llmin(layout_start, rewrapRange(start, end));
+		}
+		else
+		{
+			S32 start = mStaleLayout.back().first;
+			S32 end = mStaleLayout.back().second;
+			start = llmax(start, getLineStart(getLineNumFromDocIndex(end - 1) - REWRAP_CHUNK_LINES));
+			layout_start = llmin(layout_start, rewrapRange(start, end));
+		}
+	}
+
+	return layout_start;
+}
+
+// Rewraps the paragraphs holding [start, end) to the current width. Returns
+// the first character rewrapped.
+S32 LLTextBase::rewrapRange(S32 start, S32 end)
+{
+	line_list_t::iterator iter = std::upper_bound(mLineInfoList.begin(), mLineInfoList.end(), start, line_end_compare());
+	if (iter == mLineInfoList.end())
+	{
+		// past the end of the document
+		clearStaleLayout(start, S32_MAX);
+		return S32_MAX;
+	}
+
+	// back up to the start of the paragraph, as the text before start may
+	// wrap differently now
+	while (iter != mLineInfoList.begin() && (iter - 1)->mLineNum == iter->mLineNum)
+	{
+		--iter;
+	}
+	S32 paragraph_start = iter->mDocIndexStart;
+
+	S32 rewrapped_end = layoutLines(iter - mLineInfoList.begin(), end);
+	clearStaleLayout(paragraph_start, rewrapped_end);
+	return paragraph_start;
+}
+
+void LLTextBase::clearStaleLayout(S32 start, S32 end)
+{
+	if (mStaleLayout.empty())
+	{
+		return;
+	}
+
+	doc_range_list_t ranges;
+	for (doc_range_list_t::const_iterator iter = mStaleLayout.begin(); iter != mStaleLayout.end(); ++iter)
+	{
+		if (iter->first < start)
+		{
+			ranges.push_back(std::make_pair(iter->first, llmin(iter->second, start)));
+		}
+		if (iter->second > end)
+		{
+			ranges.push_back(std::make_pair(llmax(iter->first, end), iter->second));
+		}
+	}
+	mStaleLayout.swap(ranges);
+}
+
 LLRect LLTextBase::getTextBoundingRect()
 {
 	reflow();
@@ -1410,7 +1626,7 @@ S32	LLTextBase::getFirstVisibleLine() const
 	LLRect visible_region = getVisibleDocumentRect();
 
 	// binary search for line that starts before top of visible buffer
-	line_list_t::const_iterator iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop, compare_bottom());
+	line_list_t::const_iterator iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop - mLineOffsetY, compare_bottom());
 
 	return iter - mLineInfoList.begin();
 }
@@ -1426,13 +1642,13 @@ std::pair<S32, S32>	LLTextBase::getVisibleLines(bool fully_visible)
 
 	if (fully_visible)
 	{
-		first_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop, compare_top());
-		last_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mBottom, compare_bottom());
+		first_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop - mLineOffsetY, compare_top());
+		last_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mBottom - mLineOffsetY, compare_bottom());
 	}
 	else
 	{
-		first_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop, compare_bottom());
-		last_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mBottom, compare_top());
+		first_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mTop - mLineOffsetY, compare_bottom());
+		last_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), visible_region.mBottom - mLineOffsetY, compare_top());
 	}
 	return std::pair<S32, S32>(first_iter - mLineInfoList.begin(), last_iter - mLineInfoList.begin());
 }
@@ -1706,10 +1922,42 @@ void LLTextBase::appendText(const std::string &new_text, bool prepend_newline, c
 	appendTextImpl(new_text,input_params);
 }
 
-void LLTextBase::needsReflow(S32 index)
+void LLTextBase::needsReflow(S32 index, S32 end)
 {
 	lldebugs << "reflow on object " << (void*)this << " index = " << mReflowIndex << ", new index = " << index << llendl;
 	mReflowIndex = llmin(mReflowIndex, index);
+	mReflowEnd = llmax(mReflowEnd, end);
+}
+
+// Keeps the lines and pending layout ranges in step with an edit, so the
+// text after it isn't laid out again.
+void LLTextBase::shiftLayout(S32 pos, S32 delta)
+{
+	LLTextLines::shiftDocIndices(mLineInfoList, pos, delta);
+
+	if (mReflowIndex != S32_MAX)
+	{
+		if (mReflowIndex > pos)
+		{
+			mReflowIndex = llmax(pos, mReflowIndex + delta);
+		}
+		if (mReflowEnd > pos && mReflowEnd != S32_MAX)
+		{
+			mReflowEnd = llmax(pos, mReflowEnd + delta);
+		}
+	}
+
+	for (doc_range_list_t::iterator iter = mStaleLayout.begin(); iter != mStaleLayout.end(); ++iter)
+	{
+		if (iter->first > pos)
+		{
+			iter->first = llmax(pos, iter->first + delta);
+		}
+		if (iter->second > pos && iter->second != S32_MAX)
+		{
+			iter->second = llmax(pos, iter->second + delta);
+		}
+	}
 }
 
 void LLTextBase::appendLineBreakSegment(const LLStyle::Params& style_params)
@@ -1788,6 +2036,7 @@ void LLTextBase::appendAndHighlightTextImpl(const std::string &new_text, S32 hig
 			segment_vec_t segments;
 			segments.push_back(segmentp);
 			insertStringNoUndo(cur_length, wide_text, &segments);
+			mergeWithPreviousSegment(cur_length);
 		}
 	}
 	else
@@ -1812,6 +2061,7 @@ void LLTextBase::appendAndHighlightTextImpl(const std::string &new_text, S32 hig
 		}
 
 		insertStringNoUndo(getLength(), wide_text, &segments);
+		mergeWithPreviousSegment(segment_start);
 	}
 
 	// Set the cursor and scroll position
@@ -1939,7 +2189,8 @@ S32 LLTextBase::getDocIndexFromLocalCoord( S32 local_x, S32 local_y, BOOL round,
 	LLRect visible_region = getVisibleDocumentRect();
 	
 	// binary search for line that starts before local_y
-	line_list_t::const_iterator line_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), local_y - mVisibleTextRect.mBottom + visible_region.mBottom, compare_bottom());
+	S32 doc_y = local_y - mVisibleTextRect.mBottom + visible_region.mBottom;
+	line_list_t::const_iterator line_iter = std::lower_bound(mLineInfoList.begin(), mLineInfoList.end(), doc_y - mLineOffsetY, compare_bottom());
 
 	if (line_iter == mLineInfoList.end())
 	{
@@ -1969,7 +2220,7 @@ S32 LLTextBase::getDocIndexFromLocalCoord( S32 local_x, S32 local_y, BOOL round,
 		}
 
 		// if we've reached a line of text *below* the mouse cursor, doc index is first character on that line
-		if (hit_past_end_of_line && local_y - mVisibleTextRect.mBottom + visible_region.mBottom > line_iter->mRect.mTop)
+		if (hit_past_end_of_line && doc_y > line_iter->mRect.mTop + mLineOffsetY)
 		{
 			pos = segment_line_start;
 			break;
@@ -2028,9 +2279,10 @@ LLRect LLTextBase::getDocRectFromDocIndex(S32 pos) const
 	// find line that contains cursor
 	line_list_t::const_iterator line_iter = std::upper_bound(mLineInfoList.begin(), mLineInfoList.end(), pos, line_end_compare());
 
-	doc_rect.mLeft = line_iter->mRect.mLeft; 
-	doc_rect.mBottom = line_iter->mRect.mBottom;
-	doc_rect.mTop = line_iter->mRect.mTop;
+	LLRect line_rect = getLineRect(*line_iter);
+	doc_rect.mLeft = line_rect.mLeft; 
+	doc_rect.mBottom = line_rect.mBottom;
+	doc_rect.mTop = line_rect.mTop;
 
 	segment_set_t::iterator line_seg_iter;
 	S32 line_seg_offset;
@@ -2204,7 +2456,7 @@ void LLTextBase::changeLine( S32 delta )
 
 	LLRect visible_region = getVisibleDocumentRect();
 
-	S32 new_cursor_pos = getDocIndexFromLocalCoord(mDesiredXPixel, mLineInfoList[new_line].mRect.mBottom + mVisibleTextRect.mBottom - visible_region.mBottom, TRUE);
+	S32 new_cursor_pos = getDocIndexFromLocalCoord(mDesiredXPixel, getLineRect(mLineInfoList[new_line]).mBottom + mVisibleTextRect.mBottom - visible_region.mBottom, TRUE);
 	setCursorPos(new_cursor_pos, true);
 }
 
@@ -2314,25 +2566,15 @@ void LLTextBase::updateRects()
 	}
 	else
 	{
-		mTextBoundingRect = mLineInfoList.begin()->mRect;
-		for (line_list_t::const_iterator line_iter = ++mLineInfoList.begin();
-			line_iter != mLineInfoList.end();
-			++line_iter)
-		{
-			mTextBoundingRect.unionWith(line_iter->mRect);
-		}
+		mTextBoundingRect = mLineInfoList.back().mBounds;
 
 		mTextBoundingRect.mTop += mVPad;
 		// subtract a pixel off the bottom to deal with rounding errors in measuring font height
 		mTextBoundingRect.mBottom -= 1;
 
-		S32 delta_pos = -mTextBoundingRect.mBottom;
-		// move line segments to fit new document rect
-		for (line_list_t::iterator it = mLineInfoList.begin(); it != mLineInfoList.end(); ++it)
-		{
-			it->mRect.translate(0, delta_pos);
-		}
-		mTextBoundingRect.translate(0, delta_pos);
+		// move lines to fit new document rect, by offsetting them all at once
+		mLineOffsetY = -mTextBoundingRect.mBottom;
+		mTextBoundingRect.translate(0, mLineOffsetY);
 	}
 
 	// update document container dimensions according to text contents
@@ -2368,7 +2610,7 @@ void LLTextBase::updateRects()
 	}
 	if (mVisibleTextRect != old_text_rect)
 	{
-		needsReflow();
+		needsRewrap();
 	}
 
 	// update document container again, using new mVisibleTextRect (that has scrollbars enabled as needed)
@@ -2480,7 +2722,7 @@ LLNormalTextSegment::LLNormalTextSegment( LLStyleConstSP style, S32 start, S32 e
 	LLUIImagePtr image = mStyle->getImage();
 	if (image.notNull())
 	{
-		mImageLoadedConnection = image->addLoadedCallback(boost::bind(&LLTextBase::needsReflow, &mEditor, start));
+		mImageLoadedConnection = image->addLoadedCallback(boost::bind(&LLTextBase::needsReflow, &mEditor, start, end));
 	}
 }
 
@@ -2659,6 +2901,14 @@ BOOL LLNormalTextSegment::handleToolTip(S32 x, S32 y, MASK mask)
 	return FALSE;
 }
 
+bool LLNormalTextSegment::canMergeWith(const LLNormalTextSegment& next) const
+{
+	return !mToken && !next.mToken
+		&& mTooltip.empty() && next.mTooltip.empty()
+		&& !mStyle->isLink() && !mStyle->isImage()
+		&& (mStyle == next.mStyle || *mStyle == *next.mStyle);
+}
+
 void LLNormalTextSegment::setToolTip(const std::string& tooltip)
 {
 	// we cannot replace a keyword tooltip that's loaded from a file
@@ -33,6 +33,7 @@
 #include "llstyle.h"
 #include "llkeywords.h"
 #include "llpanel.h"
+#include "lltextlines.h"
 
 #include <string>
 #include <vector>
@@ -118,6 +119,8 @@ public:
 	/*virtual*/ void				setToken( LLKeywordToken* token )	{ mToken = token; }
 	/*virtual*/ LLKeywordToken*		getToken() const					{ return mToken; }
 	/*virtual*/ BOOL				getToolTip( std::string& msg ) const;
+	// true if next is plain text of the same style that can be folded into this segment
+	bool							canMergeWith(const LLNormalTextSegment& next) const;
 	/*virtual*/ void				setToolTip(const std::string& tooltip);
 	/*virtual*/ void				dump() const;
 
@@ -329,8 +332,8 @@ public:
 	const LLWString&       	getWText() const;
 
 	void					appendText(const std::string &new_text, bool prepend_newline, const LLStyle::Params& input_params = LLStyle::Params());
-	// force reflow of text
-	void					needsReflow(S32 index = 0);
+	// force reflow of the text from index, up to the paragraph after end
+	void					needsReflow(S32 index = 0, S32 end = S32_MAX);
 
 	S32						getLength() const { return getWText().length(); }
 	S32						getLineCount() const { return mLineInfoList.size(); }
@@ -428,15 +431,9 @@ protected:
 
 	// protected member variables
 	// List of offsets and segment index of the start of each line.  Always has at least one node (0).
-	struct line_info
-	{
-		line_info(S32 index_start, S32 index_end, LLRect rect, S32 line_num);
-		S32 mDocIndexStart;
-		S32 mDocIndexEnd;
-		LLRect mRect;
-		S32 mLineNum; // actual line count (ignoring soft newlines due to word wrap)
-	};
-	typedef std::vector<line_info> line_list_t;
+	typedef LLTextLineInfo line_info;
+	typedef LLTextLines::line_list_t line_list_t;
+	typedef std::vector<std::pair<S32, S32> > doc_range_list_t;
 
 	// member functions
 	LLTextBase(const Params &p);
@@ -466,6 +463,7 @@ protected:
 	void							createDefaultSegment();
 	virtual void					updateSegments();
 	void							insertSegment(LLTextSegmentPtr segment_to_insert);
+	void							mergeWithPreviousSegment(S32 index);
 	const LLStyle::Params&			getDefaultStyleParams();
 
 	//  manage lines
@@ -476,7 +474,14 @@ protected:
 	S32								getFirstVisibleLine() const;
 	std::pair<S32, S32>				getVisibleLines(bool fully_visible = false);
 	S32								getLeftOffset(S32 width);
+	LLRect							getLineRect(const line_info& line) const;
 	void							reflow();
+	S32								layoutLines(S32 first_line, S32 stop_index);
+	void							shiftLayout(S32 pos, S32 delta);
+	void							needsRewrap();
+	S32								rewrapStaleLines();
+	S32								rewrapRange(S32 start, S32 end);
+	void							clearStaleLayout(S32 start, S32 end);
 
 	// cursor
 	void							updateCursorXPos();
@@ -563,6 +568,11 @@ protected:
 
 	// transient state
 	S32							mReflowIndex;		// index at which to start reflow.  S32_MAX indicates no reflow needed.
+	S32							mReflowEnd;			// end of the text changed since the last reflow
+	S32							mLineOffsetY;		// added to line rects to place them in the document
+	S32							mLayoutWidth;		// width the lines outside mStaleLayout were wrapped to
+	doc_range_list_t			mStaleLayout;		// sorted ranges of text still wrapped to an old width
+	U32							mRewrapFrame;		// frame mStaleLayout was last worked through
 	bool						mScrollNeeded;		// need to change scroll region because of change to cursor position
 	S32							mScrollIndex;		// index of first character to keep visible in scroll region
 
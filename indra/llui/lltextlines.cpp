@@ -0,0 +1,148 @@
+/**
+ * @file lltextlines.cpp
+ * @brief Bookkeeping for the laid out lines of a text document
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltextlines.h"
+
+#include <algorithm>
+
+LLTextLineInfo::LLTextLineInfo(S32 index_start, S32 index_end, LLRect rect, S32 line_num)
+:	mDocIndexStart(index_start),
+	mDocIndexEnd(index_end),
+	mRect(rect),
+	mBounds(rect),
+	mLineNum(line_num)
+{}
+
+namespace
+{
+	struct line_end_less
+	{
+		bool operator()(const LLTextLineInfo& line, S32 pos) const
+		{
+			return line.mDocIndexEnd < pos;
+		}
+	};
+}
+
+void LLTextLines::shiftDocIndices(line_list_t& lines, S32 pos, S32 delta)
+{
+	// lines ending at or before pos don't change
+	line_list_t::iterator iter = std::lower_bound(lines.begin(), lines.end(), pos + 1, line_end_less());
+	for (; iter != lines.end(); ++iter)
+	{
+		if (iter->mDocIndexStart > pos)
+		{
+			iter->mDocIndexStart = llmax(pos, iter->mDocIndexStart + delta);
+		}
+		iter->mDocIndexEnd = llmax(pos, iter->mDocIndexEnd + delta);
+	}
+}
+
+S32 LLTextLines::findParagraphStart(const line_list_t& lines, S32 doc_index)
+{
+	if (lines.empty())
+	{
+		return 0;
+	}
+
+	// the first line reaching doc_index, a line ending on it may end
+	// differently now
+	line_list_t::const_iterator iter = std::lower_bound(lines.begin(), lines.end(), doc_index, line_end_less());
+	if (iter == lines.end())
+	{
+		--iter;
+	}
+
+	// earlier lines of the paragraph may wrap differently too
+	while (iter != lines.begin() && (iter - 1)->mLineNum == iter->mLineNum)
+	{
+		--iter;
+	}
+	return iter - lines.begin();
+}
+
+S32 LLTextLines::replaceLines(line_list_t& lines, S32 first_line, const line_list_t& new_lines,
+							  S32 next_index, S32 next_top, S32 next_line_num)
+{
+	S32 num_lines = lines.size();
+	S32 end_line = first_line;
+	while (end_line < num_lines && lines[end_line].mDocIndexStart < next_index)
+	{
+		++end_line;
+	}
+
+	S32 delta_y = 0;
+	S32 delta_line_num = 0;
+	if (end_line < num_lines)
+	{
+		delta_y = next_top - lines[end_line].mRect.mTop;
+		delta_line_num = next_line_num - lines[end_line].mLineNum;
+	}
+
+	S32 num_new_lines = new_lines.size();
+	if (num_new_lines == end_line - first_line)
+	{
+		std::copy(new_lines.begin(), new_lines.end(), lines.begin() + first_line);
+	}
+	else
+	{
+		lines.erase(lines.begin() + first_line, lines.begin() + end_line);
+		lines.insert(lines.begin() + first_line, new_lines.begin(), new_lines.end());
+	}
+
+	// move the lines that follow and bring the running bounds up to date
+	num_lines = lines.size();
+	for (S32 i = first_line; i < num_lines; ++i)
+	{
+		LLTextLineInfo& line = lines[i];
+		if (i >= first_line + num_new_lines)
+		{
+			if (delta_y == 0 && delta_line_num == 0)
+			{
+				LLRect bounds = line.mRect;
+				if (i > 0)
+				{
+					bounds.unionWith(lines[i - 1].mBounds);
+				}
+				if (bounds == line.mBounds)
+				{ //nothing from here on changed
+					break;
+				}
+			}
+			line.mRect.translate(0, delta_y);
+			line.mLineNum += delta_line_num;
+		}
+		line.mBounds = line.mRect;
+		if (i > 0)
+		{
+			line.mBounds.unionWith(lines[i - 1].mBounds);
+		}
+	}
+
+	return end_line - first_line;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file lltextlines.h
+ * @brief Bookkeeping for the laid out lines of a text document
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTLINES_H
+#define LL_LLTEXTLINES_H
+
+#include "llrect.h"
+
+#include <vector>
+
+// One line of an LLTextBase document, see LLTextBase::mLineInfoList.
+struct LLTextLineInfo
+{
+	LLTextLineInfo(S32 index_start, S32 index_end, LLRect rect, S32 line_num);
+	S32 mDocIndexStart;
+	S32 mDocIndexEnd;
+	LLRect mRect;	// laid out from a top of 0, see LLTextBase::mLineOffsetY
+	LLRect mBounds;	// union of the rects of this line and every line before it
+	S32 mLineNum; // actual line count (ignoring soft newlines due to word wrap)
+};
+
+// Keeps the line list in step with the text between layouts, so a reflow
+// only lays out the paragraphs an edit touched and moves the rest.
+namespace LLTextLines
+{
+	typedef std::vector<LLTextLineInfo> line_list_t;
+
+	// Moves the lines after pos by delta characters, for text inserted
+	// (delta > 0) or removed (delta < 0) at pos. Lines in removed text
+	// collapse onto pos until they are laid out again.
+	void shiftDocIndices(line_list_t& lines, S32 pos, S32 delta);
+
+	// Index of the first line of the paragraph holding doc_index, where a
+	// layout for an edit at doc_index has to start.
+	S32 findParagraphStart(const line_list_t& lines, S32 doc_index);
+
+	// Replaces the lines from first_line up to the one starting at
+	// next_index with new_lines, or all of them when next_index is S32_MAX.
+	// The lines kept after them move to next_top and are renumbered from
+	// next_line_num. Returns the number of old lines replaced.
+	S32 replaceLines(line_list_t& lines, S32 first_line, const line_list_t& new_lines,
+					 S32 next_index, S32 next_top, S32 next_line_num);
+}
+
+#endif // LL_LLTEXTLINES_H
@@ -73,11 +73,15 @@ static LLDefaultChildRegistry::Register<LLUICtrlLocate> r1("locate");
 // Build time optimization, generate this once in .cpp file
 template class LLUICtrlFactory* LLSingleton<class LLUICtrlFactory>::getInstance();
 
+// parsed XUI files kept for reuse, the least recently used go first
+const U32 MAX_XUI_TEMPLATES = 100;
+
 //-----------------------------------------------------------------------------
 // LLUICtrlFactory()
 //-----------------------------------------------------------------------------
 LLUICtrlFactory::LLUICtrlFactory()
-	: mDummyPanel(NULL) // instantiated when first needed
+	: mDummyPanel(NULL), // instantiated when first needed
+	mXUITemplates(MAX_XUI_TEMPLATES)
 {
 }
 
@@ -156,6 +160,31 @@ bool LLUICtrlFactory::getLayeredXMLNode(const std::string &xui_filename, LLXMLNo
 }
 
 
+static LLFastTimer::DeclareTimer FTM_XUI_TEMPLATE("XUI Templates");
+//-----------------------------------------------------------------------------
+// getXUITemplate()
+//-----------------------------------------------------------------------------
+bool LLUICtrlFactory::getXUITemplate(const std::string& xui_filename, LLXMLNodePtr& root)
+{
+	LLFastTimer timer(FTM_XUI_TEMPLATE);
+	const std::vector<std::string>& paths = LLUI::getXUIPaths();
+	LLXUITemplateCache& templates = instance().mXUITemplates;
+
+	root = templates.find(xui_filename, paths);
+	if (root.notNull())
+	{
+		return true;
+	}
+
+	if (!getLayeredXMLNode(xui_filename, root))
+	{
+		return false;
+	}
+
+	templates.add(xui_filename, paths, root);
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // getLocalizedXMLNode()
 //-----------------------------------------------------------------------------
@@ -31,6 +31,7 @@
 #include "llinitparam.h"
 #include "llregistry.h"
 #include "llxuiparser.h"
+#include "llxuitemplatecache.h"
 
 class LLView;
 
@@ -185,7 +186,7 @@ public:
 					goto fail;				
 				}
 			}
-			else if (!LLUICtrlFactory::getLayeredXMLNode(filename, root_node))
+			else if (!LLUICtrlFactory::getXUITemplate(filename, root_node))
 			{
 				llwarns << "Couldn't parse XUI file: " << skinned_filename << llendl;
 				goto fail;
@@ -222,6 +223,10 @@ fail:
 	static bool getLayeredXMLNode(const std::string &filename, LLXMLNodePtr& root);
 	static bool getLocalizedXMLNode(const std::string &xui_filename, LLXMLNodePtr& root);
 
+	// Like getLayeredXMLNode(), but each file is only parsed once. The nodes
+	// are shared by everything built from the file and must not be modified.
+	static bool getXUITemplate(const std::string& xui_filename, LLXMLNodePtr& root);
+
 private:
 	//NOTE: both friend declarations are necessary to keep both gcc and msvc happy
 	template <typename T> friend class LLChildRegistry;
@@ -310,6 +315,7 @@ private:
 
 	class LLPanel*		mDummyPanel;
 	std::vector<std::string>	mFileNames;
+	LLXUITemplateCache	mXUITemplates;
 };
 
 // this is here to make gcc happy with reference to LLUICtrlFactory
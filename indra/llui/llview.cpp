@@ -129,7 +129,9 @@ LLView::LLView(const LLView::Params& p)
 	mDefaultTabGroup(p.default_tab_group),
 	mLastTabGroup(0),
 	mToolTipMsg((LLStringExplicit)p.tool_tip()),
-	mDefaultWidgets(NULL)
+	mDefaultWidgets(NULL),
+	mTreeGeneration(0),
+	mChildLookupGeneration(0)
 {
 	// create rect first, as this will supply initial follows flags
 	setShape(p.rect);
@@ -236,6 +238,7 @@ void LLView::sendChildToFront(LLView* child)
 		{
 			mChildList.remove( child );
 			mChildList.push_front(child);
+			treeChanged();
 		}
 	}
 }
@@ -251,6 +254,7 @@ void LLView::sendChildToBack(LLView* child)
 		{
 			mChildList.remove( child );
 			mChildList.push_back(child);
+			treeChanged();
 		}
 	}
 }
@@ -291,6 +295,7 @@ bool LLView::addChild(LLView* child, S32 tab_group)
 
 	// add to front of child list, as normal
 	mChildList.push_front(child);
+	treeChanged();
 
 	// add to ctrl list if is LLUICtrl
 	if (child->isCtrl())
@@ -328,6 +333,7 @@ void LLView::removeChild(LLView* child)
 	{
 		mChildList.remove( child );
 		child->mParentView = NULL;
+		treeChanged();
 		if (child->isCtrl())
 		{
 			child_tab_order_t::iterator found = mCtrlOrder.find(static_cast<LLUICtrl*>(child));
@@ -1698,12 +1704,37 @@ LLView* LLView::getChildView(const std::string& name, BOOL recurse) const
 
 static LLFastTimer::DeclareTimer FTM_FIND_VIEWS("Find Widgets");
 
+// recursive findChildView() calls in progress
+static S32 sFindChildDepth = 0;
+// set when the current lookup searched views outside the tree it started in
+static bool sFindChildLeftTree = false;
+
 LLView* LLView::findChildView(const std::string& name, BOOL recurse) const
 {
 	LLFastTimer ft(FTM_FIND_VIEWS);
 	//richard: should we allow empty names?
 	//if(name.empty())
 	//	return NULL;
+
+	// only remember the outermost lookup, rather than the name in every
+	// view the search went through
+	bool remember = recurse && sFindChildDepth == 0;
+	if (remember)
+	{
+		if (mChildLookupGeneration != mTreeGeneration)
+		{
+			mChildLookups.clear();
+			mChildLookupGeneration = mTreeGeneration;
+		}
+		child_lookup_map_t::const_iterator found = mChildLookups.find(name);
+		if (found != mChildLookups.end())
+		{
+			return found->second;
+		}
+		sFindChildLeftTree = false;
+	}
+
+	LLView* result = NULL;
 	child_list_const_iter_t child_it;
 	// Look for direct children *first*
 	for ( child_it = mChildList.begin(); child_it != mChildList.end(); ++child_it)
@@ -1712,24 +1743,48 @@ LLView* LLView::findChildView(const std::string& name, BOOL recurse) const
 		llassert(childp);
 		if (childp->getName() == name)
 		{
-			return childp;
+			result = childp;
+			break;
 		}
 	}
-	if (recurse)
+	if (!result && recurse)
 	{
 		// Look inside each child as well.
+		sFindChildDepth++;
 		for ( child_it = mChildList.begin(); child_it != mChildList.end(); ++child_it)
 		{
 			LLView* childp = *child_it;
 			llassert(childp);
-			LLView* viewp = childp->findChildView(name, recurse);
-			if ( viewp )
+			result = childp->findChildView(name, recurse);
+			if ( result )
 			{
-				return viewp;
+				break;
 			}
 		}
+		sFindChildDepth--;
+	}
+
+	// changes outside this view's tree don't reach mTreeGeneration
+	if (remember && !sFindChildLeftTree)
+	{
+		mChildLookups[name] = result;
+	}
+	return result;
+}
+
+//static
+void LLView::findChildLeftTree()
+{
+	sFindChildLeftTree = true;
+}
+
+// Invalidates the child lookups of this view and every view above it.
+void LLView::treeChanged()
+{
+	for (LLView* viewp = this; viewp; viewp = viewp->mParentView)
+	{
+		viewp->mTreeGeneration++;
 	}
-	return NULL;
 }
 
 BOOL LLView::parentPointInView(S32 x, S32 y, EHitTestType type) const 
@@ -232,7 +232,7 @@ public:
 	void		setFollowsAll()					{ mReshapeFlags |= FOLLOWS_ALL; }
 
 	void        setSoundFlags(U8 flags)			{ mSoundFlags = flags; }
-	void		setName(std::string name)			{ mName = name; }
+	void		setName(std::string name)			{ mName = name; treeChanged(); }
 	void		setUseBoundingRect( BOOL use_bounding_rect );
 	BOOL		getUseBoundingRect() const;
 
@@ -335,7 +335,7 @@ public:
 	LLView*		findPrevSibling(LLView* child);
 	LLView*		findNextSibling(LLView* child);
 	S32			getChildCount()	const			{ return (S32)mChildList.size(); }
-	template<class _Pr3> void sortChildren(_Pr3 _Pred) { mChildList.sort(_Pred); }
+	template<class _Pr3> void sortChildren(_Pr3 _Pred) { mChildList.sort(_Pred); treeChanged(); }
 	BOOL		hasAncestor(const LLView* parentp) const;
 	BOOL		hasChild(const std::string& childname, BOOL recurse = FALSE) const;
 	BOOL 		childHasKeyboardFocus( const std::string& childname ) const;
@@ -520,6 +520,10 @@ public:
 	static const LLViewDrawContext& getDrawContext();
 
 protected:
+	// For findChildView() overrides that search views outside this one's
+	// tree, whose results can't be remembered.
+	static void		findChildLeftTree();
+
 	void			drawDebugRect();
 	void			drawChild(LLView* childp, S32 x_offset = 0, S32 y_offset = 0, BOOL force_draw = FALSE);
 	void			drawChildren();
@@ -589,6 +593,19 @@ private:
 
 	default_widget_map_t& getDefaultWidgetMap() const;
 
+	void treeChanged();
+
+	// Changes whenever a view in this one's tree is added, removed,
+	// reordered or renamed.
+	U32 mTreeGeneration;
+
+	// Results of recursive findChildView() calls made on this view, NULL for
+	// names that weren't found. Only valid while mChildLookupGeneration
+	// matches mTreeGeneration.
+	typedef std::map<std::string, LLView*> child_lookup_map_t;
+	mutable child_lookup_map_t mChildLookups;
+	mutable U32 mChildLookupGeneration;
+
 public:
 	// Depth in view hierarchy during rendering
 	static S32	sDepth;
@@ -99,6 +99,13 @@ void LLTextViewModel::setDisplay(const LLWString& value)
     mUpdateFromDisplay = true;
 }
 
+LLWString& LLTextViewModel::getEditableDisplay()
+{
+    mDirty = true;
+    mUpdateFromDisplay = true;
+    return mDisplay;
+}
+
 LLSD LLTextViewModel::getValue() const
 {
     // Has anyone called setDisplay() since the last setValue()? If so, have
@@ -109,6 +109,10 @@ public:
      * UTF-8 value.
      */
     void setDisplay(const LLWString& value);
+
+    /// Edit the display string in place, sparing long documents a copy of
+    /// the whole string per edit. Flags the value as changed, as setDisplay().
+    LLWString& getEditableDisplay();
 	
 private:
     /// To avoid converting every widget's stored value from LLSD to LLWString
@@ -0,0 +1,91 @@
+/**
+ * @file llxuitemplatecache.cpp
+ * @brief Parsed XUI files shared by the views built from them
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llxuitemplatecache.h"
+
+LLXUITemplateCache::LLXUITemplateCache(U32 max_templates)
+:	mMaxTemplates(max_templates),
+	mHits(0),
+	mMisses(0)
+{}
+
+LLXMLNodePtr LLXUITemplateCache::find(const std::string& filename, const path_list_t& paths)
+{
+	template_map_t::iterator found = mTemplates.find(filename);
+	if (found == mTemplates.end())
+	{
+		++mMisses;
+		return NULL;
+	}
+
+	// the paths change with the skin and language
+	if (found->second.mPaths != paths)
+	{
+		mLRU.erase(found->second.mLRUIter);
+		mTemplates.erase(found);
+		++mMisses;
+		return NULL;
+	}
+
+	++mHits;
+	mLRU.splice(mLRU.begin(), mLRU, found->second.mLRUIter);
+	return found->second.mRoot;
+}
+
+void LLXUITemplateCache::add(const std::string& filename, const path_list_t& paths, LLXMLNodePtr root)
+{
+	if (mMaxTemplates == 0)
+	{
+		return;
+	}
+
+	template_map_t::iterator found = mTemplates.find(filename);
+	if (found != mTemplates.end())
+	{
+		mLRU.erase(found->second.mLRUIter);
+		mTemplates.erase(found);
+	}
+
+	while (mTemplates.size() >= mMaxTemplates)
+	{
+		mTemplates.erase(mLRU.back());
+		mLRU.pop_back();
+	}
+
+	mLRU.push_front(filename);
+	XUITemplate& xui_template = mTemplates[filename];
+	xui_template.mPaths = paths;
+	xui_template.mRoot = root;
+	xui_template.mLRUIter = mLRU.begin();
+}
+
+void LLXUITemplateCache::clear()
+{
+	mTemplates.clear();
+	mLRU.clear();
+}
@@ -0,0 +1,75 @@
+/**
+ * @file llxuitemplatecache.h
+ * @brief Parsed XUI files shared by the views built from them
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLXUITEMPLATECACHE_H
+#define LL_LLXUITEMPLATECACHE_H
+
+#include "llxmlnode.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+// Node trees of recently parsed XUI files, keyed on the file name and the
+// XUI paths it was layered from. Holds at most max_templates files and
+// drops the least recently used one to make room.
+class LLXUITemplateCache
+{
+public:
+	typedef std::vector<std::string> path_list_t;
+
+	LLXUITemplateCache(U32 max_templates);
+
+	// The tree parsed from filename under paths, NULL if there isn't one.
+	LLXMLNodePtr find(const std::string& filename, const path_list_t& paths);
+	void add(const std::string& filename, const path_list_t& paths, LLXMLNodePtr root);
+	void clear();
+
+	U32 size() const	{ return mTemplates.size(); }
+	// finds that returned a template, and ones that didn't
+	U32 getHits() const		{ return mHits; }
+	U32 getMisses() const	{ return mMisses; }
+
+private:
+	typedef std::list<std::string> lru_list_t;
+
+	struct XUITemplate
+	{
+		path_list_t				mPaths;		// LLUI::getXUIPaths() when the file was parsed
+		LLXMLNodePtr			mRoot;
+		lru_list_t::iterator	mLRUIter;
+	};
+	typedef std::map<std::string, XUITemplate> template_map_t;
+
+	template_map_t	mTemplates;
+	lru_list_t		mLRU;			// file names, most recently used first
+	U32				mMaxTemplates;
+	U32				mHits;
+	U32				mMisses;
+};
+
+#endif // LL_LLXUITEMPLATECACHE_H
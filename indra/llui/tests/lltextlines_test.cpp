@@ -0,0 +1,236 @@
+/**
+ * @file lltextlines_test.cpp
+ * @brief Unit tests for the LLTextBase line bookkeeping
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../lltextlines.h"
+#include "lltut.h"
+
+#include "lltimer.h"
+
+namespace
+{
+	const S32 LINE_HEIGHT = 10;
+	const S32 LINE_WIDTH = 100;
+
+	// Lays out a paragraph of length chars, its newline included, wrapped
+	// every wrap chars the way LLTextBase::layoutLines() would. Returns the
+	// top of the next line.
+	S32 layout_paragraph(LLTextLines::line_list_t& lines, S32 start, S32 length, S32 wrap, S32 top, S32 line_num)
+	{
+		S32 end = start + length;
+		do
+		{
+			S32 line_end = llmin(start + wrap, end);
+			lines.push_back(LLTextLineInfo(start, line_end, LLRect(0, top, LINE_WIDTH, top - LINE_HEIGHT), line_num));
+			if (lines.size() > 1)
+			{
+				lines.back().mBounds.unionWith(lines[lines.size() - 2].mBounds);
+			}
+			start = line_end;
+			top -= LINE_HEIGHT;
+		}
+		while (start < end);
+		return top;
+	}
+
+	// Three paragraphs of 25 chars and a newline, two lines each.
+	void layout_document(LLTextLines::line_list_t& lines)
+	{
+		S32 top = 0;
+		for (S32 i = 0; i < 3; i++)
+		{
+			top = layout_paragraph(lines, i * 26, 26, 20, top, i);
+		}
+	}
+}
+
+namespace tut
+{
+	struct textlines_data
+	{
+		LLTextLines::line_list_t mLines;
+	};
+	typedef test_group<textlines_data> textlines_t;
+	typedef textlines_t::object textlines_object_t;
+	tut::textlines_t tut_textlines("LLTextLines");
+
+	// Inserting moves the lines after the edit, removing collapses the lines
+	// in the removed text onto it.
+	template<> template<>
+	void textlines_object_t::test<1>()
+	{
+		set_test_name("shiftDocIndices");
+
+		layout_document(mLines);
+
+		LLTextLines::shiftDocIndices(mLines, 30, 5);
+		ensure_equals("line before untouched", mLines[1].mDocIndexEnd, 26);
+		ensure_equals("edited line start kept", mLines[2].mDocIndexStart, 26);
+		ensure_equals("edited line end moved", mLines[2].mDocIndexEnd, 51);
+		ensure_equals("next line moved", mLines[3].mDocIndexStart, 51);
+		ensure_equals("last line moved", mLines[5].mDocIndexEnd, 83);
+
+		LLTextLines::shiftDocIndices(mLines, 30, -5);
+		ensure_equals("insert undone", mLines[3].mDocIndexStart, 46);
+
+		// remove the second paragraph and the start of the third
+		LLTextLines::shiftDocIndices(mLines, 26, -30);
+		ensure_equals("removed line start", mLines[2].mDocIndexStart, 26);
+		ensure_equals("removed line end", mLines[3].mDocIndexEnd, 26);
+		ensure_equals("partly removed line start", mLines[4].mDocIndexStart, 26);
+		ensure_equals("partly removed line end", mLines[4].mDocIndexEnd, 42);
+		ensure_equals("last line", mLines[5].mDocIndexStart, 42);
+	}
+
+	// A layout starts at the first line of the edited paragraph.
+	template<> template<>
+	void textlines_object_t::test<2>()
+	{
+		set_test_name("findParagraphStart");
+
+		ensure_equals("empty", LLTextLines::findParagraphStart(mLines, 10), 0);
+
+		layout_document(mLines);
+		ensure_equals("first line", LLTextLines::findParagraphStart(mLines, 0), 0);
+		ensure_equals("wrapped line", LLTextLines::findParagraphStart(mLines, 22), 0);
+		ensure_equals("newline", LLTextLines::findParagraphStart(mLines, 25), 0);
+		// the line ending on an edit may end differently after it
+		ensure_equals("after a newline", LLTextLines::findParagraphStart(mLines, 26), 0);
+		ensure_equals("second paragraph", LLTextLines::findParagraphStart(mLines, 27), 2);
+		ensure_equals("last line", LLTextLines::findParagraphStart(mLines, 70), 4);
+		ensure_equals("past the end", LLTextLines::findParagraphStart(mLines, 1000), 4);
+	}
+
+	// Appending replaces the last paragraph and leaves the rest alone.
+	template<> template<>
+	void textlines_object_t::test<3>()
+	{
+		set_test_name("replaceLines append");
+
+		layout_document(mLines);
+		LLTextLineInfo before = mLines[3];
+
+		// a 35 char paragraph appended, laid out from the last paragraph
+		LLTextLines::line_list_t new_lines;
+		S32 top = layout_paragraph(new_lines, 52, 26, 20, mLines[4].mRect.mTop, 2);
+		top = layout_paragraph(new_lines, 78, 35, 20, top, 3);
+		ensure_equals("last paragraph replaced", LLTextLines::replaceLines(mLines, 4, new_lines, S32_MAX, top, 4), 2);
+
+		ensure_equals("line count", mLines.size(), (size_t) 8);
+		ensure("earlier line kept", mLines[3].mRect == before.mRect && mLines[3].mLineNum == before.mLineNum);
+		ensure_equals("new line", mLines[7].mDocIndexStart, 98);
+		ensure_equals("new line number", mLines[7].mLineNum, 3);
+		ensure_equals("bounds", mLines[7].mBounds, LLRect(0, 0, LINE_WIDTH, -8 * LINE_HEIGHT));
+	}
+
+	// An edit in the middle keeps the paragraphs after it, moved down and
+	// renumbered for the lines the edit added.
+	template<> template<>
+	void textlines_object_t::test<4>()
+	{
+		set_test_name("replaceLines edit");
+
+		layout_document(mLines);
+
+		// a newline and 30 chars inserted at the end of the first paragraph
+		LLTextLines::shiftDocIndices(mLines, 25, 31);
+		S32 first_line = LLTextLines::findParagraphStart(mLines, 25);
+		ensure_equals("layout from the first line", first_line, 0);
+
+		LLTextLines::line_list_t new_lines;
+		S32 top = layout_paragraph(new_lines, 0, 26, 20, 0, 0);
+		top = layout_paragraph(new_lines, 26, 31, 20, top, 1);
+		// layout stops at the second paragraph, which starts where it did
+		ensure_equals("old lines replaced", LLTextLines::replaceLines(mLines, first_line, new_lines, 57, top, 2), 2);
+
+		ensure_equals("line count", mLines.size(), (size_t) 8);
+		ensure_equals("kept line start", mLines[4].mDocIndexStart, 57);
+		ensure_equals("kept line moved", mLines[4].mRect.mTop, -4 * LINE_HEIGHT);
+		ensure_equals("kept line renumbered", mLines[4].mLineNum, 2);
+		ensure_equals("last line renumbered", mLines[7].mLineNum, 3);
+		ensure_equals("bounds", mLines[7].mBounds, LLRect(0, 0, LINE_WIDTH, -8 * LINE_HEIGHT));
+
+		// an edit that lays out the same keeps everything after it as is
+		LLTextLineInfo last = mLines[7];
+		new_lines.clear();
+		top = layout_paragraph(new_lines, 0, 26, 20, 0, 0);
+		ensure_equals("same lines replaced", LLTextLines::replaceLines(mLines, 0, new_lines, 26, top, 1), 2);
+		ensure("last line untouched", mLines[7].mRect == last.mRect && mLines[7].mLineNum == last.mLineNum);
+	}
+
+	// Appending to a long transcript, laid out after each line as a chat
+	// floater would, only lays out the end of it. The time is logged; the
+	// Advanced > UI > Text Append Benchmark menu item times the same appends
+	// through LLTextEditor with styled text.
+	template<> template<>
+	void textlines_object_t::test<5>()
+	{
+		set_test_name("append benchmark");
+
+		const S32 NUM_PARAGRAPHS = 100000;
+		const S32 PARAGRAPH_LENGTH = 70;	// "Resident 12: the quick brown fox..."
+
+		LLTimer timer;
+		S32 doc_length = 0;
+		S32 lines_replaced = 0;
+		for (S32 i = 0; i < NUM_PARAGRAPHS; i++)
+		{
+			S32 pos = doc_length;
+			S32 length = (i > 0 ? 1 : 0) + PARAGRAPH_LENGTH;
+			LLTextLines::shiftDocIndices(mLines, pos, length);
+			doc_length += length;
+
+			S32 first_line = LLTextLines::findParagraphStart(mLines, pos);
+			S32 line_num = 0;
+			S32 start = 0;
+			S32 top = 0;
+			if (first_line < (S32) mLines.size())
+			{
+				line_num = mLines[first_line].mLineNum;
+				start = mLines[first_line].mDocIndexStart;
+				top = mLines[first_line].mRect.mTop;
+			}
+
+			LLTextLines::line_list_t new_lines;
+			while (start < doc_length)
+			{
+				S32 end = llmin(start + PARAGRAPH_LENGTH + 1, doc_length);
+				top = layout_paragraph(new_lines, start, end - start, 40, top, line_num++);
+				start = end;
+			}
+			lines_replaced += LLTextLines::replaceLines(mLines, first_line, new_lines, S32_MAX, top, line_num);
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+
+		ensure_equals("every paragraph laid out", mLines.size(), (size_t) (2 * NUM_PARAGRAPHS));
+		ensure_equals("last line number", mLines.back().mLineNum, NUM_PARAGRAPHS - 1);
+		// each append only lays out the paragraph before it again
+		ensure_equals("lines replaced", lines_replaced, 2 * (NUM_PARAGRAPHS - 1));
+		llinfos << "Appended " << NUM_PARAGRAPHS << " paragraphs in " << elapsed << "s, "
+				<< lines_replaced << " lines laid out again" << llendl;
+	}
+}
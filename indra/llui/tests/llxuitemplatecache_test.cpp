@@ -0,0 +1,172 @@
+/**
+ * @file llxuitemplatecache_test.cpp
+ * @brief Unit tests for LLXUITemplateCache
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llxuitemplatecache.h"
+#include "lltut.h"
+
+#include "lltimer.h"
+
+namespace
+{
+	LLXMLNodePtr make_node(const char* name)
+	{
+		return new LLXMLNode(name, FALSE);
+	}
+
+	// A floater about the size of the larger ones in the skin.
+	std::string make_floater_xml(S32 num_widgets)
+	{
+		std::string xml = "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\" ?>\n"
+			"<floater name=\"test\" title=\"Test\" width=\"400\" height=\"600\">\n";
+		for (S32 i = 0; i < num_widgets; i++)
+		{
+			xml += llformat(" <button name=\"button_%d\" label=\"Button %d\" left=\"10\" top=\"%d\""
+							" width=\"100\" height=\"20\" follows=\"left|top\" tool_tip=\"Does thing %d\" />\n",
+							i, i, i * 25, i);
+		}
+		xml += "</floater>\n";
+		return xml;
+	}
+}
+
+namespace tut
+{
+	struct xuitemplatecache_data
+	{
+		xuitemplatecache_data()
+		{
+			mPaths.push_back("default/xui/en");
+			mOtherPaths = mPaths;
+			mOtherPaths.push_back("default/xui/fr");
+		}
+
+		LLXUITemplateCache::path_list_t mPaths;
+		LLXUITemplateCache::path_list_t mOtherPaths;
+	};
+	typedef test_group<xuitemplatecache_data> xuitemplatecache_t;
+	typedef xuitemplatecache_t::object xuitemplatecache_object_t;
+	tut::xuitemplatecache_t tut_xuitemplatecache("LLXUITemplateCache");
+
+	// Templates are found for the paths they were parsed under only.
+	template<> template<>
+	void xuitemplatecache_object_t::test<1>()
+	{
+		set_test_name("find");
+
+		LLXUITemplateCache cache(10);
+		ensure("empty", cache.find("floater_a.xml", mPaths).isNull());
+
+		LLXMLNodePtr node = make_node("floater");
+		cache.add("floater_a.xml", mPaths, node);
+		ensure("found", cache.find("floater_a.xml", mPaths) == node);
+		ensure("other file", cache.find("floater_b.xml", mPaths).isNull());
+
+		// a skin or language change parses again
+		ensure("other paths", cache.find("floater_a.xml", mOtherPaths).isNull());
+		ensure_equals("stale template dropped", cache.size(), (U32) 0);
+
+		LLXMLNodePtr other = make_node("floater");
+		cache.add("floater_a.xml", mOtherPaths, other);
+		cache.add("floater_a.xml", mOtherPaths, node);
+		ensure("replaced", cache.find("floater_a.xml", mOtherPaths) == node);
+		ensure_equals("one template", cache.size(), (U32) 1);
+
+		ensure_equals("hits", cache.getHits(), (U32) 2);
+		ensure_equals("misses", cache.getMisses(), (U32) 3);
+
+		cache.clear();
+		ensure("cleared", cache.find("floater_a.xml", mOtherPaths).isNull());
+	}
+
+	// The least recently used template makes room for a new one.
+	template<> template<>
+	void xuitemplatecache_object_t::test<2>()
+	{
+		set_test_name("eviction");
+
+		LLXUITemplateCache cache(3);
+		cache.add("a.xml", mPaths, make_node("a"));
+		cache.add("b.xml", mPaths, make_node("b"));
+		cache.add("c.xml", mPaths, make_node("c"));
+		ensure("a found", cache.find("a.xml", mPaths).notNull());
+
+		cache.add("d.xml", mPaths, make_node("d"));
+		ensure_equals("capped", cache.size(), (U32) 3);
+		ensure("least recently used dropped", cache.find("b.xml", mPaths).isNull());
+		ensure("recently used kept", cache.find("a.xml", mPaths).notNull());
+		ensure("c kept", cache.find("c.xml", mPaths).notNull());
+		ensure("d kept", cache.find("d.xml", mPaths).notNull());
+
+		cache.add("e.xml", mPaths, make_node("e"));
+		ensure("a dropped next", cache.find("a.xml", mPaths).isNull());
+
+		LLXUITemplateCache disabled(0);
+		disabled.add("a.xml", mPaths, make_node("a"));
+		ensure_equals("nothing kept", disabled.size(), (U32) 0);
+	}
+
+	// Building from a template skips the parse the viewer used to do every
+	// time a floater or panel was opened. Logs both times.
+	template<> template<>
+	void xuitemplatecache_object_t::test<3>()
+	{
+		set_test_name("parse benchmark");
+
+		const S32 NUM_FILES = 50;
+		const S32 NUM_OPENS = 20;
+
+		std::string xml = make_floater_xml(100);
+		LLXUITemplateCache cache(NUM_FILES);
+
+		LLTimer timer;
+		for (S32 i = 0; i < NUM_FILES; i++)
+		{
+			LLXMLNodePtr root;
+			ensure("parsed", LLXMLNode::parseBuffer((U8*) xml.c_str(), xml.size(), root, NULL));
+			cache.add(llformat("floater_%d.xml", i), mPaths, root);
+		}
+		F32 parse_time = timer.getElapsedTimeF32();
+
+		timer.reset();
+		for (S32 open = 0; open < NUM_OPENS; open++)
+		{
+			for (S32 i = 0; i < NUM_FILES; i++)
+			{
+				LLXMLNodePtr root = cache.find(llformat("floater_%d.xml", i), mPaths);
+				ensure("template found", root.notNull());
+				ensure_equals("whole tree", root->getChildCount(), (U32) 100);
+			}
+		}
+		F32 lookup_time = timer.getElapsedTimeF32();
+
+		ensure_equals("every open found its template", cache.getHits(), (U32) (NUM_FILES * NUM_OPENS));
+		ensure_equals("no open parsed again", cache.getMisses(), (U32) 0);
+		llinfos << "Parsed " << NUM_FILES << " files in " << parse_time * 1000.f << "ms, opened each "
+				<< NUM_OPENS << " times from the cache in " << lookup_time * 1000.f << "ms" << llendl;
+	}
+}
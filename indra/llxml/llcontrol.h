@@ -414,6 +414,90 @@ private:
 	LLPointer<LLControlCache<T> > mCachedControlPtr;
 };
 
+// Typed copies of a fixed list of settings, read by their position in the
+// list instead of looked up by name. Generated enums name the positions,
+// see newview/llsettingsindex.h. Like LLCachedControl, the copies follow
+// the controls' commit signals.
+template <typename T, S32 COUNT>
+class LLControlIndex
+{
+public:
+	// until bind(), everything reads as zero and sets nothing
+	LLControlIndex()
+	{
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			mValues[i] = T();
+			mControls[i] = NULL;
+		}
+	}
+
+	~LLControlIndex()
+	{
+		unbind();
+	}
+
+	// names holds COUNT setting names, in index order.
+	void bind(LLControlGroup& group, const char* const* names)
+	{
+		unbind();
+		for (S32 i = 0; i < COUNT; ++i)
+		{
+			LLControlVariable* control = group.getControl(names[i]);
+			mControls[i] = control;
+			if (!control)
+			{
+				llwarns << "Indexed setting " << names[i] << " is not declared" << llendl;
+				mValues[i] = T();
+				continue;
+			}
+
+			mValues[i] = convert_from_llsd<T>(control->getValue(), control->type(), control->getName());
+			mConnections.push_back(control->getSignal()->connect(
+				boost::bind(&LLControlIndex<T, COUNT>::handleValueChange, &mValues[i], _1, _2)));
+		}
+	}
+
+	void unbind()
+	{
+		for (std::vector<boost::signals2::connection>::iterator iter = mConnections.begin();
+			 iter != mConnections.end(); ++iter)
+		{
+			iter->disconnect();
+		}
+		mConnections.clear();
+	}
+
+	const T& get(S32 index) const { return mValues[index]; }
+
+	// Goes through the control so listeners fire and the value saves.
+	void set(S32 index, const T& value)
+	{
+		if (mControls[index])
+		{
+			mControls[index]->setValue(convert_to_llsd(value));
+		}
+		else
+		{
+			llwarns << "Setting an undeclared indexed setting" << llendl;
+		}
+	}
+
+private:
+	// the signal connections point into mValues
+	LLControlIndex(const LLControlIndex&);
+	LLControlIndex& operator=(const LLControlIndex&);
+
+	static void handleValueChange(T* value, LLControlVariable* control, const LLSD& new_value)
+	{
+		*value = convert_from_llsd<T>(new_value, control->type(), control->getName());
+	}
+
+	T									mValues[COUNT];
+	LLControlVariable*					mControls[COUNT];	// NULL if the group didn't declare the setting
+	std::vector<boost::signals2::connection>	mConnections;
+};
+
 template <> eControlType get_control_type<U32>();
 template <> eControlType get_control_type<S32>();
 template <> eControlType get_control_type<F32>();
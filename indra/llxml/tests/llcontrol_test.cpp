@@ -32,6 +32,8 @@
 
 #include "../test/lltut.h"
 
+#include "lltimer.h"
+
 namespace tut
 {
 
@@ -152,4 +154,80 @@ namespace tut
 		ensure("listener fired on changed setting", mListenerFired);	   
 	}
 
+	//indexed settings follow their controls
+	template<> template<>
+	void control_group_t::test<5>()
+	{
+		mCG->declareBOOL("TestBOOL", TRUE, "Dummy setting used for testing");
+		mCG->declareU32("TestU32", 12, "Dummy setting used for testing");
+		mCG->declareString("TestString", "foo", "Dummy setting used for testing");
+
+		const char* const bool_names[] = { "TestBOOL", "MissingBOOL" };
+		const char* const u32_names[] = { "TestU32" };
+		const char* const string_names[] = { "TestString" };
+		LLControlIndex<bool, 2> bools;
+		LLControlIndex<U32, 1> u32s;
+		LLControlIndex<std::string, 1> strings;
+		ensure("unbound reads as zero", !bools.get(0));
+
+		bools.bind(*mCG, bool_names);
+		u32s.bind(*mCG, u32_names);
+		strings.bind(*mCG, string_names);
+		ensure("bound value", bools.get(0));
+		ensure("undeclared setting", !bools.get(1));
+		ensure_equals("bound U32", u32s.get(0), (U32) 12);
+		ensure_equals("bound string", strings.get(0), std::string("foo"));
+
+		mCG->setU32("TestU32", 13);
+		mCG->setString("TestString", "bar");
+		ensure_equals("follows the control", u32s.get(0), (U32) 13);
+		ensure_equals("follows the string", strings.get(0), std::string("bar"));
+
+		bools.set(0, false);
+		ensure("set through the control", !mCG->getBOOL("TestBOOL"));
+		ensure("index updated", !bools.get(0));
+
+		u32s.unbind();
+		mCG->setU32("TestU32", 14);
+		ensure_equals("unbound copy kept", u32s.get(0), (U32) 13);
+	}
+
+	//lookups through the index skip the name lookup and conversion, log
+	//how long each takes
+	template<> template<>
+	void control_group_t::test<6>()
+	{
+		const S32 NUM_SETTINGS = 1500;	// about as many as settings.xml
+		const S32 NUM_LOOKUPS = 1000000;
+
+		for (S32 i = 0; i < NUM_SETTINGS; ++i)
+		{
+			mCG->declareBOOL(llformat("TestBOOL%d", i), i % 2, "Dummy setting used for testing");
+		}
+		std::string name = llformat("TestBOOL%d", NUM_SETTINGS / 2 + 1);
+		const char* const names[] = { name.c_str() };
+		LLControlIndex<bool, 1> index;
+		index.bind(*mCG, names);
+
+		S32 by_name = 0;
+		LLTimer timer;
+		for (S32 i = 0; i < NUM_LOOKUPS; ++i)
+		{
+			by_name += mCG->getBOOL(name) ? 1 : 0;
+		}
+		F32 name_time = timer.getElapsedTimeF32();
+
+		S32 by_index = 0;
+		timer.reset();
+		for (S32 i = 0; i < NUM_LOOKUPS; ++i)
+		{
+			by_index += index.get(0) ? 1 : 0;
+		}
+		F32 index_time = timer.getElapsedTimeF32();
+
+		ensure_equals("same values", by_index, by_name);
+		ensure_equals("setting read", by_name, NUM_LOOKUPS);
+		llinfos << NUM_LOOKUPS << " reads from " << NUM_SETTINGS << " settings: by name "
+				<< name_time * 1000.f << "ms, by index " << index_time * 1000.f << "ms" << llendl;
+	}
 }
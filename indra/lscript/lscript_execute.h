@@ -32,6 +32,7 @@
 #include "lscript_library.h"
 
 class LLTimer;
+class LLScriptThreadedCode;
 
 // Return values for run() methods
 const U32 NO_DELETE_FLAG	= 0x0000;
@@ -144,6 +145,9 @@ BOOL run_print(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 BOOL run_calllib(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 BOOL run_calllib_two_byte(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 
+extern void (*binary_operations[LST_EOF][LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
+extern void (*unary_operations[LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
+
 void unknown_operation(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 void integer_integer_operation(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 void integer_float_operation(U8 *buffer, LSCRIPTOpCodesEnum opcode);
@@ -530,6 +534,11 @@ public:
 
 	void init();
 
+	// Runs straight-line code from a pre-decoded copy of the bytecode
+	// rather than decoding each instruction as it goes. Off by default.
+	void setThreadedCode(BOOL enable);
+	BOOL getThreadedCode() const { return mThreadedCode != NULL; }
+
 	BOOL (*mExecuteFuncs[0x100])(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 
 	U32						mInstructionCount;
@@ -539,6 +548,8 @@ public:
 	U32						mBytecodeSize;
 
 private:
+	LLScriptThreadedCode*	mThreadedCode;
+
 	S32 getMajorVersion() const;
 	void		recordBoundaryError( const LLUUID &id );
 	void		setStateEventOpcoodeStartSafely( S32 state, LSCRIPTStateEventType event, const LLUUID &id );
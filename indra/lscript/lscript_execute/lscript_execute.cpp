@@ -35,6 +35,7 @@
 #include "lscript_library.h"
 #include "lscript_heapruntime.h"
 #include "lscript_alloc.h"
+#include "lscript_threadedcode.h"
 #include "llstat.h"
 
 
@@ -42,6 +43,10 @@
 const	S32	DEFAULT_SCRIPT_TIMER_CHECK_SKIP = 4;
 S32		LLScriptExecute::sTimerCheckSkip = DEFAULT_SCRIPT_TIMER_CHECK_SKIP;
 
+// Most threaded code instructions run by one resumeEventHandler() call,
+// keeps runQuanta()'s time checks reasonably frequent.
+const	S32	MAX_THREADED_INSTRUCTIONS = 64;
+
 void (*binary_operations[LST_EOF][LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 void (*unary_operations[LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 
@@ -111,6 +116,7 @@ LLScriptExecuteLSL2::~LLScriptExecuteLSL2()
 {
 	delete[] mBuffer;
 	delete[] mBytecode;
+	delete mThreadedCode;
 }
 
 void LLScriptExecuteLSL2::init()
@@ -118,6 +124,7 @@ void LLScriptExecuteLSL2::init()
 	S32 i, j;
 
 	mInstructionCount = 0;
+	mThreadedCode = NULL;
 
 	for (i = 0; i < 256; i++)
 	{
@@ -313,8 +320,32 @@ void LLScriptExecuteLSL2::setStateEventOpcoodeStartSafely( S32 state, LSCRIPTSta
 
 S32 lscript_push_variable(LLScriptLibData *data, U8 *buffer);
 
+void LLScriptExecuteLSL2::setThreadedCode(BOOL enable)
+{
+	if (!enable)
+	{
+		delete mThreadedCode;
+		mThreadedCode = NULL;
+	}
+	else if (!mThreadedCode)
+	{
+		mThreadedCode = new LLScriptThreadedCode();
+	}
+}
+
 void LLScriptExecuteLSL2::resumeEventHandler(BOOL b_print, const LLUUID &id, F32 time_slice)
 {
+	if (mThreadedCode && !b_print)
+	{
+		S32 count = mThreadedCode->run(mBuffer, MAX_THREADED_INSTRUCTIONS);
+		if (count)
+		{
+			mInstructionCount += count;
+			return;
+		}
+		// otherwise the instruction at IP is one for the interpreter
+	}
+
 	//	call opcode run function pointer with buffer and IP
 	mInstructionCount++;
 	S32 value = get_register(mBuffer, LREG_IP);
@@ -660,6 +691,11 @@ S32 LLScriptExecuteLSL2::writeBytecode(U8 **dest)
 
 S32 LLScriptExecuteLSL2::readState(U8 *src)
 {
+	if (mThreadedCode)
+	{
+		mThreadedCode->clear();
+	}
+
 	// first, blitz heap and stack
 	S32 hr = get_register(mBuffer, LREG_HR);
 	S32 tm = get_register(mBuffer, LREG_TM);
@@ -727,6 +763,11 @@ void LLScriptExecuteLSL2::reset()
 	if (!src)
 		return;
 
+	if (mThreadedCode)
+	{
+		mThreadedCode->clear();
+	}
+
 	// first, blitz heap and stack
 	S32 hr = get_register(mBuffer, LREG_HR);
 	S32 tm = get_register(mBuffer, LREG_TM);
@@ -4043,6 +4084,8 @@ void lscript_run(const std::string& filename, BOOL b_debug)
 	}
 	if (execute)
 	{
+		// single stepping prints every instruction, which threaded code can't
+		execute->setThreadedCode(!b_debug);
 		timer.reset();
 		F32 time_slice = 3600.0f; // 1 hr.
 		U32 events_processed = 0;
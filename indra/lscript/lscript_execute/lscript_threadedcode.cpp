@@ -0,0 +1,509 @@
+/**
+ * @file lscript_threadedcode.cpp
+ * @brief Pre-decoded LSL2 bytecode for the script interpreter
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lscript_threadedcode.h"
+#include "lscript_execute.h"
+
+typedef LLScriptThreadedCode::LLScriptThreadedOp threaded_op_t;
+
+// Opcode for each instruction byte, LOPC_INVALID for bytes that aren't one.
+static LSCRIPTOpCodesEnum sOpcodes[0x100];
+static bool sOpcodesBuilt = false;
+
+static void build_opcodes()
+{
+	for (S32 i = 0; i < 0x100; i++)
+	{
+		sOpcodes[i] = LOPC_INVALID;
+	}
+	// LOPC_NOOP shares its byte with LOPC_INVALID and wins.
+	for (S32 i = LOPC_NOOP; i < LOPC_EOF; i++)
+	{
+		sOpcodes[LSCRIPTOpCodes[i]] = (LSCRIPTOpCodesEnum)i;
+	}
+	sOpcodesBuilt = true;
+}
+
+// Same as the interpreter, unknown types get unknown_operation.
+static U8 operand_type(U8 type)
+{
+	return type < LST_EOF ? type : LST_NULL;
+}
+
+//
+// Handlers, each does what the matching run_*() does once its operands
+// have been read.
+//
+
+static const threaded_op_t* op_noop(U8 *buffer, const threaded_op_t *op)
+{
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pop(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_poparg(buffer, LSCRIPTDataSize[LST_INTEGER]);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_poparg(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_poparg(buffer, op->mArg);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_push(U8 *buffer, const threaded_op_t *op)
+{
+	S32 value = lscript_local_get(buffer, op->mArg);
+	lscript_push(buffer, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pushg(U8 *buffer, const threaded_op_t *op)
+{
+	S32 value = lscript_global_get(buffer, op->mArg);
+	lscript_push(buffer, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pushe(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_pusharge(buffer, LSCRIPTDataSize[LST_INTEGER]);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pushargi(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_push(buffer, op->mArg);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pushargf(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_push(buffer, op->mFloatArg);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_pusharge(U8 *buffer, const threaded_op_t *op)
+{
+	lscript_pusharge(buffer, op->mArg);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_store(U8 *buffer, const threaded_op_t *op)
+{
+	S32 sp = get_register(buffer, LREG_SP);
+	S32 value = bytestream2integer(buffer, sp);
+	lscript_local_store(buffer, op->mArg, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_storeg(U8 *buffer, const threaded_op_t *op)
+{
+	S32 sp = get_register(buffer, LREG_SP);
+	S32 value = bytestream2integer(buffer, sp);
+	lscript_global_store(buffer, op->mArg, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_loadp(U8 *buffer, const threaded_op_t *op)
+{
+	S32 value = lscript_pop_int(buffer);
+	lscript_local_store(buffer, op->mArg, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_loadgp(U8 *buffer, const threaded_op_t *op)
+{
+	S32 value = lscript_pop_int(buffer);
+	lscript_global_store(buffer, op->mArg, value);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_operation(U8 *buffer, const threaded_op_t *op)
+{
+	op->mOperation(buffer, op->mOpcode);
+	return op->mNext;
+}
+
+static const threaded_op_t* op_jump(U8 *buffer, const threaded_op_t *op)
+{
+	return op->mTarget;
+}
+
+static const threaded_op_t* op_jumpif_integer(U8 *buffer, const threaded_op_t *op)
+{
+	S32 test = lscript_pop_int(buffer);
+	return test ? op->mTarget : op->mNext;
+}
+
+static const threaded_op_t* op_jumpnif_integer(U8 *buffer, const threaded_op_t *op)
+{
+	S32 test = lscript_pop_int(buffer);
+	return !test ? op->mTarget : op->mNext;
+}
+
+static const threaded_op_t* op_jumpif_float(U8 *buffer, const threaded_op_t *op)
+{
+	F32 test = lscript_pop_float(buffer);
+	return test ? op->mTarget : op->mNext;
+}
+
+static const threaded_op_t* op_jumpnif_float(U8 *buffer, const threaded_op_t *op)
+{
+	F32 test = lscript_pop_float(buffer);
+	return !test ? op->mTarget : op->mNext;
+}
+
+LLScriptThreadedCode::LLScriptThreadedCode()
+{
+	if (!sOpcodesBuilt)
+	{
+		build_opcodes();
+	}
+}
+
+LLScriptThreadedCode::~LLScriptThreadedCode()
+{
+}
+
+void LLScriptThreadedCode::clear()
+{
+	mOps.clear();
+	mOpAtOffset.clear();
+}
+
+S32 LLScriptThreadedCode::run(U8 *buffer, S32 max_instructions)
+{
+	const LLScriptThreadedOp *op = decode(buffer, get_register(buffer, LREG_IP));
+	if (!op || !op->mHandler)
+	{
+		return 0;
+	}
+
+	S32 offset = gLSCRIPTRegisterAddresses[LREG_ESR];
+	F32 energy = bytestream2float(buffer, offset);
+	if (!llfinite(energy))
+	{
+		// let the interpreter raise the fault
+		return 0;
+	}
+
+	// Every op with a handler has its successors decoded, so this only
+	// stops on a fault or at something for the interpreter.
+	S32 count = 0;
+	do
+	{
+		op = op->mHandler(buffer, op);
+		energy -= 0.1f;
+		count++;
+	}
+	while (op->mHandler && count < max_instructions && !get_register(buffer, LREG_FR));
+
+	set_register(buffer, LREG_IP, op->mOffset);
+	set_register_fp(buffer, LREG_ESR, energy);
+	return count;
+}
+
+const threaded_op_t* LLScriptThreadedCode::decode(const U8 *buffer, S32 offset)
+{
+	S32 gfr = get_register(buffer, LREG_GFR);
+	S32 hr = get_register(buffer, LREG_HR);
+	if (offset < gfr || offset >= hr)
+	{
+		return NULL;
+	}
+	if ((S32)mOpAtOffset.size() < hr)
+	{
+		mOpAtOffset.resize(hr, NULL);
+	}
+	if (mOpAtOffset[offset])
+	{
+		return mOpAtOffset[offset];
+	}
+
+	// Decode everything reachable from offset without leaving threaded
+	// code, then point each new op at its successors.
+	size_t first_new = mOps.size();
+	std::vector<S32> pending(1, offset);
+	while (!pending.empty())
+	{
+		S32 pos = pending.back();
+		pending.pop_back();
+		while (!mOpAtOffset[pos])
+		{
+			LLScriptThreadedOp *op = decodeInstruction(buffer, pos, gfr, hr);
+			if (!op->mHandler)
+			{
+				break;
+			}
+			if (op->mTargetOffset >= 0)
+			{
+				pending.push_back(op->mTargetOffset);
+			}
+			if (op->mNextOffset < 0)
+			{
+				break;
+			}
+			pos = op->mNextOffset;
+		}
+	}
+
+	for (size_t i = first_new; i < mOps.size(); i++)
+	{
+		LLScriptThreadedOp &op = mOps[i];
+		if (op.mNextOffset >= 0)
+		{
+			op.mNext = mOpAtOffset[op.mNextOffset];
+		}
+		if (op.mTargetOffset >= 0)
+		{
+			op.mTarget = mOpAtOffset[op.mTargetOffset];
+		}
+	}
+	return mOpAtOffset[offset];
+}
+
+threaded_op_t* LLScriptThreadedCode::decodeInstruction(const U8 *buffer, S32 offset, S32 gfr, S32 hr)
+{
+	mOps.push_back(LLScriptThreadedOp());
+	LLScriptThreadedOp *op = &mOps.back();
+	op->mHandler = NULL;
+	op->mNext = NULL;
+	op->mTarget = NULL;
+	op->mOperation = NULL;
+	op->mArg = 0;
+	op->mFloatArg = 0.f;
+	op->mOpcode = LOPC_INVALID;
+	op->mOffset = offset;
+	op->mNextOffset = -1;
+	op->mTargetOffset = -1;
+	mOpAtOffset[offset] = op;
+
+	S32 pos = offset;
+	LSCRIPTOpCodesEnum opcode = sOpcodes[bytestream2byte(buffer, pos)];
+
+	// Bytes the instruction takes after the opcode. Operands that run
+	// past the code are left to the interpreter, which faults on them.
+	S32 operand_size = -1;
+	switch (opcode)
+	{
+	case LOPC_NOOP:
+	case LOPC_POP:
+	case LOPC_PUSHE:
+	case LOPC_BITAND:
+	case LOPC_BITOR:
+	case LOPC_BITXOR:
+	case LOPC_BOOLAND:
+	case LOPC_BOOLOR:
+	case LOPC_SHL:
+	case LOPC_SHR:
+	case LOPC_BITNOT:
+	case LOPC_BOOLNOT:
+		operand_size = 0;
+		break;
+	case LOPC_ADD:
+	case LOPC_SUB:
+	case LOPC_MUL:
+	case LOPC_DIV:
+	case LOPC_MOD:
+	case LOPC_EQ:
+	case LOPC_NEQ:
+	case LOPC_LEQ:
+	case LOPC_GEQ:
+	case LOPC_LESS:
+	case LOPC_GREATER:
+	case LOPC_NEG:
+		operand_size = 1;
+		break;
+	case LOPC_POPARG:
+	case LOPC_PUSH:
+	case LOPC_PUSHG:
+	case LOPC_PUSHARGI:
+	case LOPC_PUSHARGF:
+	case LOPC_PUSHARGE:
+	case LOPC_STORE:
+	case LOPC_STOREG:
+	case LOPC_LOADP:
+	case LOPC_LOADGP:
+	case LOPC_JUMP:
+		operand_size = 4;
+		break;
+	case LOPC_JUMPIF:
+	case LOPC_JUMPNIF:
+		operand_size = 5;
+		break;
+	default:
+		break;
+	}
+	if (operand_size < 0 || pos + operand_size > hr)
+	{
+		return op;
+	}
+
+	op_handler_t handler = NULL;
+	switch (opcode)
+	{
+	case LOPC_NOOP:
+		handler = op_noop;
+		break;
+	case LOPC_POP:
+		handler = op_pop;
+		break;
+	case LOPC_PUSHE:
+		handler = op_pushe;
+		break;
+	case LOPC_POPARG:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_poparg;
+		break;
+	case LOPC_PUSH:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_push;
+		break;
+	case LOPC_PUSHG:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_pushg;
+		break;
+	case LOPC_PUSHARGI:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_pushargi;
+		break;
+	case LOPC_PUSHARGF:
+		op->mFloatArg = bytestream2float(buffer, pos);
+		if (llfinite(op->mFloatArg))
+		{
+			handler = op_pushargf;
+		}
+		break;
+	case LOPC_PUSHARGE:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_pusharge;
+		break;
+	case LOPC_STORE:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_store;
+		break;
+	case LOPC_STOREG:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_storeg;
+		break;
+	case LOPC_LOADP:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_loadp;
+		break;
+	case LOPC_LOADGP:
+		op->mArg = bytestream2integer(buffer, pos);
+		handler = op_loadgp;
+		break;
+	case LOPC_ADD:
+	case LOPC_SUB:
+	case LOPC_MUL:
+	case LOPC_DIV:
+	case LOPC_MOD:
+	case LOPC_EQ:
+	case LOPC_NEQ:
+	case LOPC_LEQ:
+	case LOPC_GEQ:
+	case LOPC_LESS:
+	case LOPC_GREATER:
+		{
+			U8 types = bytestream2byte(buffer, pos);
+			op->mOperation = binary_operations[operand_type(types >> 4)][operand_type(types & 0xf)];
+			handler = op_operation;
+		}
+		break;
+	case LOPC_BITAND:
+	case LOPC_BITOR:
+	case LOPC_BITXOR:
+	case LOPC_BOOLAND:
+	case LOPC_BOOLOR:
+	case LOPC_SHL:
+	case LOPC_SHR:
+		op->mOperation = binary_operations[LST_INTEGER][LST_INTEGER];
+		handler = op_operation;
+		break;
+	case LOPC_NEG:
+		op->mOperation = unary_operations[operand_type(bytestream2byte(buffer, pos))];
+		handler = op_operation;
+		break;
+	case LOPC_BITNOT:
+	case LOPC_BOOLNOT:
+		op->mOperation = unary_operations[LST_INTEGER];
+		handler = op_operation;
+		break;
+	case LOPC_JUMP:
+		op->mArg = bytestream2integer(buffer, pos);
+		op->mTargetOffset = pos + op->mArg;
+		handler = op_jump;
+		break;
+	case LOPC_JUMPIF:
+	case LOPC_JUMPNIF:
+		{
+			U8 type = bytestream2byte(buffer, pos);
+			op->mArg = bytestream2integer(buffer, pos);
+			op->mTargetOffset = pos + op->mArg;
+			if (type == LST_INTEGER)
+			{
+				handler = (opcode == LOPC_JUMPIF) ? op_jumpif_integer : op_jumpnif_integer;
+			}
+			else if (type == LST_FLOATINGPOINT)
+			{
+				handler = (opcode == LOPC_JUMPIF) ? op_jumpif_float : op_jumpnif_float;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	// Successors have to be somewhere set_ip() would accept.
+	if (opcode != LOPC_JUMP)
+	{
+		op->mNextOffset = pos;
+		if (pos >= hr)
+		{
+			handler = NULL;
+		}
+	}
+	bool branches = (opcode == LOPC_JUMP || opcode == LOPC_JUMPIF || opcode == LOPC_JUMPNIF);
+	if (branches && (op->mTargetOffset < gfr || op->mTargetOffset >= hr))
+	{
+		handler = NULL;
+	}
+	if (!handler)
+	{
+		op->mNextOffset = -1;
+		op->mTargetOffset = -1;
+		return op;
+	}
+
+	op->mOpcode = opcode;
+	op->mHandler = handler;
+	return op;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file lscript_threadedcode.h
+ * @brief Pre-decoded LSL2 bytecode for the script interpreter
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LSCRIPT_THREADEDCODE_H
+#define LL_LSCRIPT_THREADEDCODE_H
+
+#include "lscript_byteformat.h"
+
+#include <deque>
+#include <vector>
+
+// Threaded code for the instructions that are safe to run back to back:
+// stack, local and global moves, arithmetic and branches. Each one is
+// decoded once into an LLScriptThreadedOp with its operands read and its
+// successors resolved, so running it is a single indirect call. Anything
+// else (calls, returns, state changes, library calls, heap moves) stays
+// with the interpreter, which picks up where the threaded code stopped.
+class LLScriptThreadedCode
+{
+public:
+	struct LLScriptThreadedOp;
+	typedef const LLScriptThreadedOp* (*op_handler_t)(U8 *buffer, const LLScriptThreadedOp *op);
+	typedef void (*operation_t)(U8 *buffer, LSCRIPTOpCodesEnum opcode);
+
+	struct LLScriptThreadedOp
+	{
+		op_handler_t				mHandler;	// NULL when the interpreter has to run it
+		const LLScriptThreadedOp	*mNext;		// fall through
+		const LLScriptThreadedOp	*mTarget;	// branch target
+		operation_t					mOperation;	// binary or unary operation
+		S32							mArg;
+		F32							mFloatArg;
+		LSCRIPTOpCodesEnum			mOpcode;
+		S32							mOffset;	// of the instruction in the bytecode
+		S32							mNextOffset;
+		S32							mTargetOffset;
+	};
+
+	LLScriptThreadedCode();
+	~LLScriptThreadedCode();
+
+	// Runs at most max_instructions decoded instructions starting at the IP
+	// register, updating IP and the energy register as the interpreter would.
+	// Stops early after a fault or at an instruction the interpreter has to
+	// run. Returns the number of instructions run.
+	S32 run(U8 *buffer, S32 max_instructions);
+
+	// Forgets everything decoded, call whenever the bytecode is replaced.
+	void clear();
+
+	S32 getDecodedCount() const { return (S32)mOps.size(); }
+
+private:
+	const LLScriptThreadedOp* decode(const U8 *buffer, S32 offset);
+	LLScriptThreadedOp* decodeInstruction(const U8 *buffer, S32 offset, S32 gfr, S32 hr);
+
+	// A deque so ops never move while more are decoded.
+	std::deque<LLScriptThreadedOp>		mOps;
+	std::vector<LLScriptThreadedOp*>	mOpAtOffset;
+};
+
+#endif
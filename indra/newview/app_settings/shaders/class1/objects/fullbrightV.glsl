@@ -5,15 +5,35 @@
  * $/LicenseInfo$
  */
 
+#extension GL_ARB_draw_instanced : enable
+
 void calcAtmospherics(vec3 inPositionEye);
 
+#ifdef GL_ARB_draw_instanced
+// model matrices of instanced draws, see LLRenderPass::drawInstances()
+uniform mat4 instance_matrix[32];
+uniform float instanced;
+#endif
+
 void main()
 {
+	vec4 vert = gl_Vertex;
+
 	//transform vertex
-	gl_Position = ftransform();
+#ifdef GL_ARB_draw_instanced
+	if (instanced > 0.0)
+	{
+		vert = instance_matrix[gl_InstanceIDARB] * vert;
+		gl_Position = gl_ModelViewProjectionMatrix * vert;
+	}
+	else
+#endif
+	{
+		gl_Position = ftransform();
+	}
 	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
 	
-	vec4 pos = (gl_ModelViewMatrix * gl_Vertex);
+	vec4 pos = (gl_ModelViewMatrix * vert);
 
 	calcAtmospherics(pos.xyz);
 
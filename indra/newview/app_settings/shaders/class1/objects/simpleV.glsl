@@ -5,18 +5,41 @@
  * $/LicenseInfo$
  */
 
+#extension GL_ARB_draw_instanced : enable
+
 vec4 calcLighting(vec3 pos, vec3 norm, vec4 color, vec4 baseCol);
 void calcAtmospherics(vec3 inPositionEye);
 
+#ifdef GL_ARB_draw_instanced
+// model matrices of instanced draws, see LLRenderPass::drawInstances()
+uniform mat4 instance_matrix[32];
+uniform float instanced;
+#endif
+
 void main()
 {
+	vec4 vert = gl_Vertex;
+	vec3 normal = gl_Normal;
+
 	//transform vertex
-	gl_Position = ftransform();
+#ifdef GL_ARB_draw_instanced
+	if (instanced > 0.0)
+	{
+		mat4 mat = instance_matrix[gl_InstanceIDARB];
+		vert = mat * vert;
+		normal = mat3(mat[0].xyz, mat[1].xyz, mat[2].xyz) * normal;
+		gl_Position = gl_ModelViewProjectionMatrix * vert;
+	}
+	else
+#endif
+	{
+		gl_Position = ftransform();
+	}
 	gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
 	
-	vec4 pos = (gl_ModelViewMatrix * gl_Vertex);
+	vec4 pos = (gl_ModelViewMatrix * vert);
 	
-	vec3 norm = normalize(gl_NormalMatrix * gl_Normal);
+	vec3 norm = normalize(gl_NormalMatrix * normal);
 
 	calcAtmospherics(pos.xyz);
 
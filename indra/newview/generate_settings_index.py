@@ -0,0 +1,143 @@
+# @file generate_settings_index.py
+# @brief Generate the typed setting indices used by LLSettingsIndex from
+#        app_settings/settings.xml.
+#
+# $LicenseInfo:firstyear=2010&license=viewerlgpl$
+# Second Life Viewer Source Code
+# Copyright (C) 2010, Linden Research, Inc.
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation;
+# version 2.1 of the License only.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+# $/LicenseInfo$
+
+import sys, os, re
+from xml.dom.minidom import parse
+
+# settings.xml type -> suffix of the enum and accessors in LLSettingsIndex
+INDEXED_TYPES = [
+    ('Boolean', 'BOOL'),
+    ('S32', 'S32'),
+    ('U32', 'U32'),
+    ('F32', 'F32'),
+    ('String', 'String'),
+    ]
+
+HEADER = """// Generated from %(source)s by generate_settings_index.py.
+// Do not edit, add settings to settings.xml instead.
+
+#ifndef LL_LLSETTINGSINDICES_H
+#define LL_LLSETTINGSINDICES_H
+
+%(enums)s
+%(names)s
+#endif // LL_LLSETTINGSINDICES_H
+"""
+
+SOURCE = """// Generated from %(source)s by generate_settings_index.py.
+// Do not edit, add settings to settings.xml instead.
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llsettingsindices.h"
+
+%(names)s"""
+
+def element_children(node):
+    return [child for child in node.childNodes if child.nodeType == child.ELEMENT_NODE]
+
+def map_items(map_node):
+    """Yields the key and value nodes of an LLSD map. A key without a value,
+    which the LLSD parser tolerates, yields None."""
+    children = element_children(map_node)
+    i = 0
+    while i < len(children):
+        if children[i].tagName != 'key':
+            i += 1
+            continue
+        key = children[i].firstChild and children[i].firstChild.data or ''
+        if i + 1 < len(children) and children[i + 1].tagName != 'key':
+            yield key, children[i + 1]
+            i += 2
+        else:
+            yield key, None
+            i += 1
+
+def read_settings(filename):
+    """Returns (name, type) in file order. Like the LLSD parser, the last
+    declaration of a name wins."""
+    dom = parse(filename)
+    root_map = element_children(dom.getElementsByTagName('llsd')[0])[0]
+    order = []
+    types = {}
+    for name, value in map_items(root_map):
+        if value is None:
+            continue
+        setting_type = None
+        for key, field in map_items(value):
+            if key == 'Type' and field is not None:
+                setting_type = field.firstChild.data.strip()
+        if setting_type is None:
+            continue
+        if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', name):
+            sys.stderr.write("Skipping setting with a name that isn't an identifier: %s\n" % name)
+            continue
+        if name not in types:
+            order.append(name)
+        types[name] = setting_type
+    return [(name, types[name]) for name in order]
+
+def generate(settings_file, output_dir):
+    settings = read_settings(settings_file)
+    source = os.path.basename(settings_file)
+
+    enums = []
+    declarations = []
+    definitions = []
+    for xml_type, suffix in INDEXED_TYPES:
+        names = [name for name, setting_type in settings if setting_type == xml_type]
+        count = 'SETTING_%s_COUNT' % suffix.upper()
+        enums.append('enum ESetting%s\n{\n%s\t%s\n};\n' % (
+            suffix, ''.join(['\tSETTING_%s,\n' % name for name in names]), count))
+        declarations.append('extern const char* const gSetting%sNames[%s];\n' % (suffix, count))
+        definitions.append('const char* const gSetting%sNames[%s] =\n{\n%s};\n\n' % (
+            suffix, count, ''.join(['\t"%s",\n' % name for name in names])))
+
+    write_if_changed(os.path.join(output_dir, 'llsettingsindices.h'),
+                     HEADER % {'source': source, 'enums': '\n'.join(enums), 'names': ''.join(declarations)})
+    write_if_changed(os.path.join(output_dir, 'llsettingsindices.cpp'),
+                     SOURCE % {'source': source, 'names': ''.join(definitions)})
+
+def write_if_changed(filename, contents):
+    """Leaves the file alone when nothing changed, so settings.xml edits that
+    don't add or retype settings don't rebuild everything."""
+    if os.path.exists(filename):
+        existing = open(filename, 'r')
+        try:
+            if existing.read() == contents:
+                return
+        finally:
+            existing.close()
+    output = open(filename, 'w')
+    try:
+        output.write(contents)
+    finally:
+        output.close()
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        sys.stderr.write("Usage: %s <settings.xml> <output directory>\n" % sys.argv[0])
+        sys.exit(1)
+    generate(sys.argv[1], sys.argv[2])
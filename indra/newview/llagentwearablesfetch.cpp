@@ -331,10 +331,10 @@ void LLLibraryOutfitsFetch::folderDone()
 	// If Library->Clothing->Initial Outfits exists, use that.
 	LLNameCategoryCollector matchFolderFunctor("Initial Outfits");
 	cat_array.clear();
-	gInventory.collectDescendentsIf(mLibraryClothingID,
-									cat_array, wearable_array, 
-									LLInventoryModel::EXCLUDE_TRASH,
-									matchFolderFunctor);
+	gInventory.collectLoadedDescendentsIf(mLibraryClothingID,
+										cat_array, wearable_array, 
+										LLInventoryModel::EXCLUDE_TRASH,
+										matchFolderFunctor);
 	if (cat_array.count() > 0)
 	{
 		const LLViewerInventoryCategory *cat = cat_array.get(0);
@@ -395,10 +395,10 @@ void LLLibraryOutfitsFetch::outfitsDone()
 
 	// Check if you already have an "Imported Library Clothing" folder
 	LLNameCategoryCollector matchFolderFunctor(mImportedClothingName);
-	gInventory.collectDescendentsIf(mClothingID, 
-									cat_array, wearable_array, 
-									LLInventoryModel::EXCLUDE_TRASH,
-									matchFolderFunctor);
+	gInventory.collectLoadedDescendentsIf(mClothingID, 
+										cat_array, wearable_array, 
+										LLInventoryModel::EXCLUDE_TRASH,
+										matchFolderFunctor);
 	if (cat_array.size() > 0)
 	{
 		const LLViewerInventoryCategory *cat = cat_array.get(0);
@@ -482,10 +482,10 @@ void LLLibraryOutfitsFetch::libraryDone()
 		LLNameCategoryCollector matchFolderFunctor(cat->getName());
 		LLInventoryModel::cat_array_t cat_array;
 		LLInventoryModel::item_array_t wearable_array;
-		gInventory.collectDescendentsIf(mImportedClothingID, 
-										cat_array, wearable_array, 
-										LLInventoryModel::EXCLUDE_TRASH,
-										matchFolderFunctor);
+		gInventory.collectLoadedDescendentsIf(mImportedClothingID, 
+											cat_array, wearable_array, 
+											LLInventoryModel::EXCLUDE_TRASH,
+											matchFolderFunctor);
 		if (cat_array.size() > 0)
 		{
 			continue;
@@ -123,11 +123,11 @@ LLUUID findDescendentCategoryIDByName(const LLUUID& parent_id, const std::string
 	LLInventoryModel::cat_array_t cat_array;
 	LLInventoryModel::item_array_t item_array;
 	LLNameCategoryCollector has_name(name);
-	gInventory.collectDescendentsIf(parent_id,
-									cat_array,
-									item_array,
-									LLInventoryModel::EXCLUDE_TRASH,
-									has_name);
+	gInventory.collectLoadedDescendentsIf(parent_id,
+										cat_array,
+										item_array,
+										LLInventoryModel::EXCLUDE_TRASH,
+										has_name);
 	if (0 == cat_array.count())
 		return LLUUID();
 	else
@@ -1943,11 +1943,11 @@ void LLAppearanceMgr::wearOutfitByName(const std::string& name)
 	LLInventoryModel::cat_array_t cat_array;
 	LLInventoryModel::item_array_t item_array;
 	LLNameCategoryCollector has_name(name);
-	gInventory.collectDescendentsIf(gInventory.getRootFolderID(),
-									cat_array,
-									item_array,
-									LLInventoryModel::EXCLUDE_TRASH,
-									has_name);
+	gInventory.collectLoadedDescendentsIf(gInventory.getRootFolderID(),
+										cat_array,
+										item_array,
+										LLInventoryModel::EXCLUDE_TRASH,
+										has_name);
 	bool copy_items = false;
 	LLInventoryCategory* cat = NULL;
 	if (cat_array.count() > 0)
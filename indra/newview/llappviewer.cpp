@@ -41,6 +41,7 @@
 #include "llagentcamera.h"
 #include "llagentlanguage.h"
 #include "llagentwearables.h"
+#include "llinventory.h"
 #include "llwindow.h"
 #include "llviewerstats.h"
 #include "llmd5.h"
@@ -92,6 +93,7 @@
 #include "llurlaction.h"
 #include "llvfile.h"
 #include "llvfsthread.h"
+#include "llvolumebvh.h"
 #include "llvolumemgr.h"
 #include "llxfermanager.h"
 
@@ -116,6 +118,7 @@
 #include "llviewerkeyboard.h"
 #include "lllfsthread.h"
 #include "llworkerthread.h"
+#include "llcompressedtexturecache.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
@@ -335,6 +338,9 @@ const char *VFS_INDEX_FILE_BASE = "index.db2.x.";
 
 static std::string gWindowTitle;
 
+// Set with VolumeParamsTraceFile
+static llofstream sVolumeParamsTrace;
+
 LLAppViewer::LLUpdaterInfo *LLAppViewer::sUpdaterInfo = NULL ;
 
 void idle_afk_check()
@@ -560,7 +566,9 @@ LLAppViewer* LLAppViewer::sInstance = NULL;
 const std::string LLAppViewer::sGlobalSettingsName = "Global"; 
 
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
+LLCompressedTextureCache* LLAppViewer::sCompressedTextureCache = NULL;
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
+LLImageEncodeThread* LLAppViewer::sImageEncodeThread = NULL;
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
 
 LLAppViewer::LLAppViewer() : 
@@ -1197,10 +1205,12 @@ bool LLAppViewer::mainLoop()
 					{
 						LLFastTimer ftm(FTM_TEXTURE_CACHE);
  						work_pending += LLAppViewer::getTextureCache()->update(1); // unpauses the texture cache thread
+ 						work_pending += LLAppViewer::getCompressedTextureCache()->update(1);
 					}
 					{
 						LLFastTimer ftm(FTM_DECODE);
 	 					work_pending += LLAppViewer::getImageDecodeThread()->update(1); // unpauses the image thread
+	 					work_pending += LLAppViewer::getImageEncodeThread()->update(1);
 					}
 					{
 						LLFastTimer ftm(FTM_DECODE);
@@ -1233,7 +1243,9 @@ bool LLAppViewer::mainLoop()
 				if(!total_work_pending) //pause texture fetching threads if nothing to process.
 				{
 					LLAppViewer::getTextureCache()->pause();
+					LLAppViewer::getCompressedTextureCache()->pause();
 					LLAppViewer::getImageDecodeThread()->pause();
+					LLAppViewer::getImageEncodeThread()->pause();
 					LLAppViewer::getTextureFetch()->pause(); 
 				}
 				if(!total_io_pending) //pause file threads if nothing to process.
@@ -1475,6 +1487,7 @@ bool LLAppViewer::cleanup()
 	// Cleanup Inventory after the UI since it will delete any remaining observers
 	// (Deleted observers should have already removed themselves)
 	gInventory.cleanupInventory();
+	LLInventoryItem::cleanupClass();
 
 	llinfos << "Cleaning up Selections" << llendflush;
 	
@@ -1529,6 +1542,7 @@ bool LLAppViewer::cleanup()
 		llwarns << "Remaining references in the volume manager!" << llendflush;
 	}
 	LLPrimitive::cleanupVolumeManager();
+	sVolumeParamsTrace.close();
 
 	llinfos << "Additional Cleanup..." << llendflush;	
 	
@@ -1620,7 +1634,9 @@ bool LLAppViewer::cleanup()
 	{
 		S32 pending = 0;
 		pending += LLAppViewer::getTextureCache()->update(1); // unpauses the worker thread
+		pending += LLAppViewer::getCompressedTextureCache()->update(1);
 		pending += LLAppViewer::getImageDecodeThread()->update(1); // unpauses the image thread
+		pending += LLAppViewer::getImageEncodeThread()->update(1);
 		pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
 		pending += LLVFSThread::updateClass(0);
 		pending += LLLFSThread::updateClass(0);
@@ -1639,18 +1655,25 @@ bool LLAppViewer::cleanup()
 	// Delete workers first
 	// shotdown all worker threads before deleting them in case of co-dependencies
 	sTextureCache->shutdown();
+	sCompressedTextureCache->shutdown();
 	sTextureFetch->shutdown();
 	sImageDecodeThread->shutdown();
+	sImageEncodeThread->shutdown();
 	
 	sTextureFetch->shutDownTextureCacheThread() ;
+	sTextureFetch->shutDownCompressedCacheThread() ;
 	sTextureFetch->shutDownImageDecodeThread() ;
 
 	delete sTextureCache;
     sTextureCache = NULL;
+	delete sCompressedTextureCache;
+	sCompressedTextureCache = NULL;
 	delete sTextureFetch;
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	delete sImageEncodeThread;
+	sImageEncodeThread = NULL;
 	delete mFastTimerLogThread;
 	mFastTimerLogThread = NULL;
 	
@@ -1772,8 +1795,13 @@ bool LLAppViewer::initThreads()
 
 	// Image decoding
 	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
+	// Image encoding, for bakes and uploads
+	U32 encode_threads = llmin(gSavedSettings.getU32("ImageEncodeThreads"), (U32) 16);
+	LLAppViewer::sImageEncodeThread = new LLImageEncodeThread(encode_threads, enable_threads && true);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
-	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
+	LLAppViewer::sCompressedTextureCache = new LLCompressedTextureCache(enable_threads && true);
+	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), LLAppViewer::getCompressedTextureCache(),
+													sImageDecodeThread, enable_threads && true);
 	LLImage::initClass();
 
 	if (LLFastTimer::sLog || LLFastTimer::sMetricLog)
@@ -2291,9 +2319,24 @@ bool LLAppViewer::initConfiguration()
 	LLSplashScreen::show();
 	LLSplashScreen::update(splash_msg);
 
+	LLVolumeFaceBVH::initClass(gSysCPU.hasSSE2());
 	//LLVolumeMgr::initClass();
 	LLVolumeMgr* volume_manager = new LLVolumeMgr();
 	volume_manager->useMutex();	// LLApp and LLMutex magic must be manually enabled
+	volume_manager->startThreads(gSavedSettings.getU32("VolumeBuildThreads"));
+	std::string volume_trace = gSavedSettings.getString("VolumeParamsTraceFile");
+	if (!volume_trace.empty())
+	{
+		sVolumeParamsTrace.open(volume_trace, std::ios::out | std::ios::app);
+		if (sVolumeParamsTrace.is_open())
+		{
+			volume_manager->setParamsTrace(&sVolumeParamsTrace);
+		}
+		else
+		{
+			llwarns << "Can't open volume params trace " << volume_trace << llendl;
+		}
+	}
 	LLPrimitive::setVolumeManager(volume_manager);
 
 	// Note: this is where we used to initialize gFeatureManagerp.
@@ -3280,6 +3323,11 @@ bool LLAppViewer::initCache()
 	S64 extra = LLAppViewer::getTextureCache()->initCache(LL_PATH_CACHE, texture_cache_size, texture_cache_mismatch);
 	texture_cache_size -= extra;
 
+	// The compressed tier has its own budget on top of CacheSize
+	LLCompressedTextureCache::sEnabled = gSavedSettings.getBOOL("TextureCompressedCache");
+	LLAppViewer::getCompressedTextureCache()->initCache(LL_PATH_CACHE,
+		(S64)gSavedSettings.getU32("TextureCompressedCacheSize") * MB, read_only);
+
 	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion()) ;
 
 	LLSplashScreen::update(LLTrans::getString("StartupInitializingVFS"));
@@ -3444,6 +3492,7 @@ void LLAppViewer::purgeCache()
 {
 	LL_INFOS("AppCache") << "Purging Cache and Texture Cache..." << llendl;
 	LLAppViewer::getTextureCache()->purgeCache(LL_PATH_CACHE);
+	LLAppViewer::getCompressedTextureCache()->purgeCache(LL_PATH_CACHE);
 	LLVOCache::getInstance()->removeCache(LL_PATH_CACHE);
 	std::string mask = gDirUtilp->getDirDelimiter() + "*.*";
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE,""),mask);
@@ -3651,6 +3700,7 @@ void LLAppViewer::idle()
 	LLEventTimer::updateClass();
 	LLCriticalDamp::updateInterpolants();
 	LLMortician::updateClass();
+	LLPrimitive::getVolumeManager()->update();
 	F32 dt_raw = idle_timer.getElapsedTimeAndResetF32();
 
 	// Cap out-of-control frame times
@@ -36,7 +36,9 @@ class LLCommandLineParser;
 class LLFrameTimer;
 class LLPumpIO;
 class LLTextureCache;
+class LLCompressedTextureCache;
 class LLImageDecodeThread;
+class LLImageEncodeThread;
 class LLTextureFetch;
 class LLWatchdogTimeout;
 class LLUpdaterService;
@@ -91,7 +93,9 @@ public:
     
 	// Thread accessors
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
+	static LLCompressedTextureCache* getCompressedTextureCache() { return sCompressedTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
+	static LLImageEncodeThread* getImageEncodeThread() { return sImageEncodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
 
 	static U32 getTextureCacheVersion() ;
@@ -231,7 +235,9 @@ private:
 
 	// Thread objects.
 	static LLTextureCache* sTextureCache; 
+	static LLCompressedTextureCache* sCompressedTextureCache;
 	static LLImageDecodeThread* sImageDecodeThread; 
+	static LLImageEncodeThread* sImageEncodeThread;
 	static LLTextureFetch* sTextureFetch;
 
 	S32 mNumSessions;
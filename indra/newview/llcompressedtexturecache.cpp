@@ -0,0 +1,347 @@
+/**
+ * @file llcompressedtexturecache.cpp
+ * @brief Disk cache of decoded textures as DXT blocks
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llcompressedtexturecache.h"
+
+#include "llapr.h"
+#include "llimage.h"
+
+#include <algorithm>
+
+static const char* CACHE_DIR_NAME = "texturecache_dxt";
+// Writes hold a copy of the raw image until they are compressed, so stop
+// queueing them when the thread falls this far behind.
+static const S32 MAX_PENDING_REQUESTS = 64;
+
+BOOL LLCompressedTextureCache::sEnabled = FALSE;
+LLAtomicU32 LLCompressedTextureCache::sHits;
+LLAtomicU32 LLCompressedTextureCache::sDecodesAvoided;
+
+LLCompressedTextureCache::LLCompressedTextureCache(bool threaded)
+:	LLQueuedThread("compressedtexturecache", threaded),
+	mReadOnly(TRUE),
+	mMaxSize(0),
+	mEntriesMutex(NULL),
+	mTotalSize(0),
+	mCreationMutex(NULL)
+{
+}
+
+void LLCompressedTextureCache::initCache(ELLPath location, S64 max_size, BOOL read_only)
+{
+	mReadOnly = read_only;
+	mMaxSize = max_size;
+	mCacheDirName = gDirUtilp->getExpandedFilename(location, CACHE_DIR_NAME);
+	if (!mReadOnly)
+	{
+		LLFile::mkdir(mCacheDirName);
+	}
+
+	LLMutexLock lock(&mEntriesMutex);
+	mEntries.clear();
+	mTotalSize = 0;
+
+	// the discard level of each entry is only known once it has been read
+	std::string dirname = mCacheDirName + gDirUtilp->getDirDelimiter();
+	std::string filename;
+	while (gDirUtilp->getNextFileInDir(dirname, "*.dxt", filename))
+	{
+		LLUUID id;
+		llstat stat_data;
+		if (!id.set(gDirUtilp->getBaseFileName(filename, true), FALSE) ||
+			LLFile::stat(dirname + filename, &stat_data))
+		{
+			continue;
+		}
+		Entry& entry = mEntries[id];
+		entry.mSize = (S32)stat_data.st_size;
+		entry.mTime = (U32)stat_data.st_mtime;
+		mTotalSize += entry.mSize;
+	}
+
+	if (!mReadOnly && mTotalSize > mMaxSize)
+	{
+		purgeEntries(mMaxSize * 8 / 10, NULL);
+	}
+	llinfos << "Compressed texture cache: " << mEntries.size() << " entries, "
+			<< (mTotalSize >> 20) << " of " << (mMaxSize >> 20) << " MB" << llendl;
+}
+
+void LLCompressedTextureCache::purgeCache(ELLPath location)
+{
+	std::string dirname = gDirUtilp->getExpandedFilename(location, CACHE_DIR_NAME);
+	if (LLFile::isdir(dirname))
+	{
+		gDirUtilp->deleteFilesInDir(dirname, "*.dxt");
+		LLFile::rmdir(dirname);
+	}
+
+	LLMutexLock lock(&mEntriesMutex);
+	mEntries.clear();
+	mTotalSize = 0;
+}
+
+BOOL LLCompressedTextureCache::hasEntry(const LLUUID& id, S32 discard)
+{
+	LLMutexLock lock(&mEntriesMutex);
+	entry_map_t::iterator iter = mEntries.find(id);
+	return iter != mEntries.end() && iter->second.mDiscard <= discard;
+}
+
+LLCompressedTextureCache::handle_t LLCompressedTextureCache::readFromCache(const LLUUID& id, S32 discard, U32 priority,
+																		   ReadResponder* responder)
+{
+	handle_t handle = generateHandle();
+	addRequestDeferred(new ReadRequest(handle, priority, this, id, discard, responder));
+	return handle;
+}
+
+void LLCompressedTextureCache::writeToCache(const LLUUID& id, const LLImageRaw* raw, S32 discard)
+{
+	if (mReadOnly)
+	{
+		return;
+	}
+
+	{
+		LLMutexLock lock(&mEntriesMutex);
+		entry_map_t::iterator iter = mEntries.find(id);
+		if (iter != mEntries.end() && iter->second.mDiscard != UNKNOWN_DISCARD &&
+			iter->second.mDiscard <= discard)
+		{
+			return;
+		}
+	}
+
+	{
+		LLMutexLock lock(&mCreationMutex);
+		if (getPending() + (S32)mCreationList.size() >= MAX_PENDING_REQUESTS)
+		{
+			return;
+		}
+	}
+
+	// the texture keeps using its raw image, so compress a copy
+	LLPointer<LLImageRaw> copy = new LLImageRaw(raw->getWidth(), raw->getHeight(), raw->getComponents());
+	memcpy(copy->getData(), raw->getData(), raw->getDataSize());	/* Flawfinder: ignore */
+	addRequestDeferred(new WriteRequest(generateHandle(), LLQueuedThread::PRIORITY_LOW, this, id, copy, discard));
+}
+
+void LLCompressedTextureCache::addRequestDeferred(QueuedRequest* request)
+{
+	LLMutexLock lock(&mCreationMutex);
+	mCreationList.push_back(request);
+}
+
+// MAIN THREAD
+//virtual
+S32 LLCompressedTextureCache::update(U32 max_time_ms)
+{
+	{
+		LLMutexLock lock(&mCreationMutex);
+		for (std::vector<QueuedRequest*>::iterator iter = mCreationList.begin();
+			 iter != mCreationList.end(); ++iter)
+		{
+			if (!addRequest(*iter))
+			{
+				llerrs << "request added after LLCompressedTextureCache::shutdown()" << llendl;
+			}
+		}
+		mCreationList.clear();
+	}
+	return LLQueuedThread::update(max_time_ms);
+}
+
+std::string LLCompressedTextureCache::getFileName(const LLUUID& id) const
+{
+	return mCacheDirName + gDirUtilp->getDirDelimiter() + id.asString() + ".dxt";
+}
+
+void LLCompressedTextureCache::purgeEntries(S64 max_size, LLVolatileAPRPool* pool)
+{
+	typedef std::pair<U32, LLUUID> time_id_t;
+	std::vector<time_id_t> by_time;
+	by_time.reserve(mEntries.size());
+	for (entry_map_t::iterator iter = mEntries.begin(); iter != mEntries.end(); ++iter)
+	{
+		by_time.push_back(time_id_t(iter->second.mTime, iter->first));
+	}
+	std::sort(by_time.begin(), by_time.end());
+
+	for (std::vector<time_id_t>::iterator iter = by_time.begin();
+		 iter != by_time.end() && mTotalSize > max_size; ++iter)
+	{
+		entry_map_t::iterator entry = mEntries.find(iter->second);
+		mTotalSize -= entry->second.mSize;
+		LLAPRFile::remove(getFileName(entry->first), pool);
+		mEntries.erase(entry);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLCompressedTextureCache::ReadRequest::ReadRequest(handle_t handle, U32 priority, LLCompressedTextureCache* cache,
+												   const LLUUID& id, S32 discard, ReadResponder* responder)
+:	LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+	mCache(cache),
+	mID(id),
+	mDiscard(discard),
+	mImageDiscard(-1),
+	mResponder(responder)
+{
+}
+
+bool LLCompressedTextureCache::ReadRequest::processRequest()
+{
+	std::string filename = mCache->getFileName(mID);
+	LLVolatileAPRPool* pool = mCache->getLocalAPRFilePool();
+
+	S32 file_size = LLAPRFile::size(filename, pool);
+	S32 data_size = file_size - (S32)sizeof(LLImageDXT::cache_header_t);
+	LLImageDXT::cache_header_t header;
+	BOOL valid = file_size > (S32)sizeof(header) &&
+		LLAPRFile::readEx(filename, &header, 0, sizeof(header), pool) == sizeof(header) &&
+		LLImageDXT::checkCacheHeader(header, data_size);
+
+	LLPointer<LLImageDXT> image;
+	if (valid && header.discard <= mDiscard)
+	{
+		image = new LLImageDXT();
+		U8* data = image->allocateData(data_size);
+		valid = data &&
+			LLAPRFile::readEx(filename, data, sizeof(header), data_size, pool) == data_size &&
+			image->updateCacheData();
+	}
+
+	LLMutexLock lock(&mCache->mEntriesMutex);
+	entry_map_t::iterator iter = mCache->mEntries.find(mID);
+	if (!valid)
+	{
+		if (file_size > 0)
+		{
+			llwarns << "Removing bad compressed texture cache entry " << mID << llendl;
+			LLAPRFile::remove(filename, pool);
+		}
+		if (iter != mCache->mEntries.end())
+		{
+			mCache->mTotalSize -= iter->second.mSize;
+			mCache->mEntries.erase(iter);
+		}
+		return true;
+	}
+
+	if (iter != mCache->mEntries.end())
+	{
+		iter->second.mDiscard = header.discard;
+		if (image.notNull())
+		{
+			iter->second.mTime = (U32)time(NULL);
+		}
+	}
+	if (image.notNull())
+	{
+		// hand over only the mips that were asked for
+		image->discardMips(mDiscard - header.discard);
+		mImage = image;
+		mImageDiscard = mDiscard;
+		sHits++;
+	}
+	return true;
+}
+
+void LLCompressedTextureCache::ReadRequest::finishRequest(bool completed)
+{
+	if (mResponder.notNull())
+	{
+		mResponder->completed(completed ? mImage.get() : NULL, mImageDiscard);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLCompressedTextureCache::WriteRequest::WriteRequest(handle_t handle, U32 priority, LLCompressedTextureCache* cache,
+													 const LLUUID& id, LLImageRaw* raw, S32 discard)
+:	LLQueuedThread::QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+	mCache(cache),
+	mID(id),
+	mRaw(raw),
+	mDiscard(discard)
+{
+}
+
+bool LLCompressedTextureCache::WriteRequest::processRequest()
+{
+	{
+		// an earlier request may have written a better level already
+		LLMutexLock lock(&mCache->mEntriesMutex);
+		entry_map_t::iterator iter = mCache->mEntries.find(mID);
+		if (iter != mCache->mEntries.end() && iter->second.mDiscard != UNKNOWN_DISCARD &&
+			iter->second.mDiscard <= mDiscard)
+		{
+			return true;
+		}
+	}
+
+	LLPointer<LLImageDXT> image = new LLImageDXT();
+	BOOL compressed = image->compress(mRaw);
+	mRaw = NULL;
+	if (!compressed)
+	{
+		return true;
+	}
+
+	std::string filename = mCache->getFileName(mID);
+	LLVolatileAPRPool* pool = mCache->getLocalAPRFilePool();
+	LLImageDXT::cache_header_t header;
+	LLImageDXT::initCacheHeader(header, mDiscard);
+	S32 data_size = image->getDataSize();
+
+	// a shorter file written over a longer one would keep its tail
+	LLAPRFile::remove(filename, pool);
+	BOOL written = LLAPRFile::writeEx(filename, &header, 0, sizeof(header), pool) == sizeof(header) &&
+		LLAPRFile::writeEx(filename, image->getData(), sizeof(header), data_size, pool) == data_size;
+
+	LLMutexLock lock(&mCache->mEntriesMutex);
+	Entry& entry = mCache->mEntries[mID];
+	mCache->mTotalSize -= entry.mSize;
+	if (!written)
+	{
+		LLAPRFile::remove(filename, pool);
+		mCache->mEntries.erase(mID);
+		return true;
+	}
+	entry.mDiscard = mDiscard;
+	entry.mSize = (S32)sizeof(header) + data_size;
+	entry.mTime = (U32)time(NULL);
+	mCache->mTotalSize += entry.mSize;
+	if (mCache->mTotalSize > mCache->mMaxSize)
+	{
+		mCache->purgeEntries(mCache->mMaxSize * 8 / 10, pool);
+	}
+	return true;
+}
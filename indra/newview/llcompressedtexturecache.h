@@ -0,0 +1,154 @@
+/**
+ * @file llcompressedtexturecache.h
+ * @brief Disk cache of decoded textures as DXT blocks
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLCOMPRESSEDTEXTURECACHE_H
+#define LL_LLCOMPRESSEDTEXTURECACHE_H
+
+#include "lldir.h"
+#include "llimagedxt.h"
+#include "llqueuedthread.h"
+#include "lluuid.h"
+
+#include <map>
+
+class LLImageRaw;
+
+// Second tier behind LLTextureCache: textures that were decoded from J2C
+// are compressed to DXT1 (opaque) or DXT5 (alpha) blocks with their mip
+// chain and written to disk, one file per texture holding the best discard
+// level seen. A later fetch that finds a good enough entry hands the blocks
+// straight to LLImageGL, skipping both the J2C read and the decode, and the
+// texture takes 4 to 6 times less memory on the GPU.
+//
+// Reads are requested from the texture fetch thread, writes from the main
+// thread; both run on this thread.
+class LLCompressedTextureCache : public LLQueuedThread
+{
+public:
+	class ReadResponder : public LLThreadSafeRefCount
+	{
+	protected:
+		virtual ~ReadResponder() {}
+	public:
+		// image is NULL on a miss, otherwise it holds the mips from discard
+		// down.
+		virtual void completed(LLImageDXT* image, S32 discard) = 0;
+	};
+
+	LLCompressedTextureCache(bool threaded = true);
+
+	// TextureCompressedCache
+	static BOOL sEnabled;
+	// Reads that found an entry, and fetches that skipped J2C decode thanks
+	// to one. Cleared by LLPipeline::resetFrameStats().
+	static LLAtomicU32 sHits;
+	static LLAtomicU32 sDecodesAvoided;
+
+	// Scans the cache directory and trims it to max_size bytes.
+	void initCache(ELLPath location, S64 max_size, BOOL read_only);
+	void purgeCache(ELLPath location);
+
+	// TRUE if there may be an entry of id good enough for discard.
+	BOOL hasEntry(const LLUUID& id, S32 discard);
+
+	// Reads an entry with at most discard, trimmed to discard.
+	handle_t readFromCache(const LLUUID& id, S32 discard, U32 priority, ReadResponder* responder);
+	// Compresses and stores raw, the image at discard, unless the entry
+	// already has it. raw is copied.
+	void writeToCache(const LLUUID& id, const LLImageRaw* raw, S32 discard);
+
+	/*virtual*/ S32 update(U32 max_time_ms);
+
+private:
+	class ReadRequest;
+	class WriteRequest;
+	friend class ReadRequest;
+	friend class WriteRequest;
+
+	class ReadRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~ReadRequest() {}
+	public:
+		ReadRequest(handle_t handle, U32 priority, LLCompressedTextureCache* cache,
+					const LLUUID& id, S32 discard, ReadResponder* responder);
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+	private:
+		LLCompressedTextureCache* mCache;
+		LLUUID mID;
+		S32 mDiscard;
+		LLPointer<LLImageDXT> mImage;
+		S32 mImageDiscard;
+		LLPointer<ReadResponder> mResponder;
+	};
+
+	class WriteRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~WriteRequest() {}
+	public:
+		WriteRequest(handle_t handle, U32 priority, LLCompressedTextureCache* cache,
+					 const LLUUID& id, LLImageRaw* raw, S32 discard);
+		/*virtual*/ bool processRequest();
+	private:
+		LLCompressedTextureCache* mCache;
+		LLUUID mID;
+		LLPointer<LLImageRaw> mRaw;
+		S32 mDiscard;
+	};
+
+	struct Entry
+	{
+		Entry() : mDiscard(UNKNOWN_DISCARD), mSize(0), mTime(0) {}
+		S32 mDiscard;	// UNKNOWN_DISCARD until the file has been read
+		S32 mSize;
+		U32 mTime;		// last use, seconds since 1/1/1970
+	};
+	typedef std::map<LLUUID, Entry> entry_map_t;
+
+	enum { UNKNOWN_DISCARD = -1 };
+
+	std::string getFileName(const LLUUID& id) const;
+	// Removes the least recently used entries. Call with mEntriesMutex
+	// locked; pool is NULL on the main thread.
+	void purgeEntries(S64 max_size, LLVolatileAPRPool* pool);
+
+	void addRequestDeferred(QueuedRequest* request);
+
+	std::string mCacheDirName;
+	BOOL mReadOnly;
+	S64 mMaxSize;
+
+	LLMutex mEntriesMutex;	// guards mEntries and mTotalSize
+	entry_map_t mEntries;
+	S64 mTotalSize;
+
+	LLMutex mCreationMutex;
+	std::vector<QueuedRequest*> mCreationList;
+};
+
+#endif // LL_LLCOMPRESSEDTEXTURECACHE_H
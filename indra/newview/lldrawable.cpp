@@ -1194,8 +1194,10 @@ class LLOctreeMarkNotCulled: public LLOctreeTraveler<LLDrawable>
 {
 public:
 	LLCamera* mCamera;
+	LLCullResult* mResult; // NULL to push into the pipeline's cull result
 	
-	LLOctreeMarkNotCulled(LLCamera* camera_in) : mCamera(camera_in) { }
+	LLOctreeMarkNotCulled(LLCamera* camera_in, LLCullResult* result = NULL)
+		: mCamera(camera_in), mResult(result) { }
 	
 	virtual void traverse(const LLOctreeNode<LLDrawable>* node)
 	{
@@ -1206,15 +1208,22 @@ public:
 	
 	void visit(const LLOctreeNode<LLDrawable>* branch)
 	{
-		gPipeline.markNotCulled((LLSpatialGroup*) branch->getListener(0), *mCamera);
+		if (mResult)
+		{
+			gPipeline.markNotCulled((LLSpatialGroup*) branch->getListener(0), *mCamera, *mResult);
+		}
+		else
+		{
+			gPipeline.markNotCulled((LLSpatialGroup*) branch->getListener(0), *mCamera);
+		}
 	}
 };
 
-void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>* results, BOOL for_select)
+BOOL LLSpatialBridge::checkVisible(LLCamera& camera_in)
 {
 	if (!gPipeline.hasRenderType(mDrawableType))
 	{
-		return;
+		return FALSE;
 	}
 
 
@@ -1243,7 +1252,7 @@ void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>*
 				}
 				else
 				{
-					return;
+					return FALSE;
 				}
 			}
 
@@ -1252,7 +1261,7 @@ void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>*
 				impostor ||
 				!loaded)
 			{
-				return;
+				return FALSE;
 			}
 		}
 	}
@@ -1273,9 +1282,19 @@ void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>*
 			!LLPipeline::sShadowRender && 
 			LLPipeline::calcPixelArea(center, size, camera_in) < FORCE_INVISIBLE_AREA)
 		{
-			return;
+			return FALSE;
 		}
 
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>* results, BOOL for_select)
+{
+	if (checkVisible(camera_in))
+	{
 		LLDrawable::setVisible(camera_in);
 		
 		if (for_select)
@@ -1302,6 +1321,18 @@ void LLSpatialBridge::setVisible(LLCamera& camera_in, std::vector<LLDrawable*>*
 	}
 }
 
+void LLSpatialBridge::setVisible(LLCamera& camera_in, LLCullResult& result)
+{
+	if (checkVisible(camera_in))
+	{
+		LLDrawable::setVisible(camera_in);
+
+		LLCamera trans_camera = transformCamera(camera_in);
+		LLOctreeMarkNotCulled culler(&trans_camera, &result);
+		culler.traverse(mOctree);
+	}
+}
+
 void LLSpatialBridge::updateDistance(LLCamera& camera_in, bool force_update)
 {
 	if (mDrawable == NULL)
@@ -29,6 +29,7 @@
 #include "lldrawpool.h"
 #include "llrender.h"
 #include "llfasttimer.h"
+#include "llglslshader.h"
 #include "llviewercontrol.h"
 
 #include "lldrawable.h"
@@ -458,6 +459,79 @@ void LLRenderPass::applyModelMatrix(LLDrawInfo& params)
 			glMultMatrixf((GLfloat*) params.mModelMatrix->mMatrix);
 		}
 		gPipeline.mMatrixOpCount++;
+		gPipeline.mStateChanges++;
+	}
+}
+
+void LLRenderPass::drawBatch(LLDrawInfo& params, U32 mask)
+{
+	if (params.mGroup)
+	{
+		params.mGroup->rebuildMesh();
+	}
+
+	U32 binds = LLVertexBuffer::sBindCount;
+	params.mVertexBuffer->setBuffer(mask);
+	if (LLVertexBuffer::sBindCount != binds)
+	{
+		gPipeline.mStateChanges++;
+	}
+
+	if (!params.mInstanceMatrices.empty())
+	{
+		drawInstances(params);
+		gPipeline.addTrianglesDrawn(params.mCount * (S32) params.mInstanceMatrices.size(), params.mDrawMode);
+		return;
+	}
+
+	if (params.mBatchCounts.empty())
+	{
+		params.mVertexBuffer->drawRange(params.mDrawMode, params.mStart, params.mEnd, params.mCount, params.mOffset);
+	}
+	else
+	{
+		params.mVertexBuffer->drawMultiRange(params.mDrawMode, params.mStart, params.mEnd, params.mBatchCounts, params.mBatchOffsets);
+	}
+	gPipeline.addTrianglesDrawn(params.mCount, params.mDrawMode);
+}
+
+void LLRenderPass::drawInstances(LLDrawInfo& params)
+{
+	const std::vector<const LLMatrix4*>& matrices = params.mInstanceMatrices;
+	U32 num_instances = matrices.size();
+
+	LLGLSLShader* shader = LLGLSLShader::sCurBoundShaderPtr;
+	if (gGLManager.mHasDrawInstanced && shader && shader->getUniformLocation("instance_matrix") >= 0)
+	{ //the shader moves each instance, the modelview only holds the camera
+		glLoadMatrixd(gGLModelView);
+		gGLLastMatrix = NULL;
+		gPipeline.mMatrixOpCount++;
+		shader->uniform1f("instanced", 1.f);
+
+		static LLMatrix4 instance_matrix[MAX_INSTANCES];
+		for (U32 i = 0; i < num_instances; i += MAX_INSTANCES)
+		{
+			U32 count = llmin((U32) MAX_INSTANCES, num_instances - i);
+			for (U32 j = 0; j < count; ++j)
+			{
+				instance_matrix[j] = *matrices[i + j];
+			}
+			shader->uniformMatrix4fv("instance_matrix", count, FALSE, (GLfloat*) instance_matrix[0].mMatrix);
+			params.mVertexBuffer->drawInstanced(params.mDrawMode, params.mCount, params.mOffset, count);
+		}
+
+		shader->uniform1f("instanced", 0.f);
+	}
+	else
+	{ //no instanced draws, the shared buffer is still only bound once
+		for (U32 i = 0; i < num_instances; ++i)
+		{
+			gGLLastMatrix = matrices[i];
+			glLoadMatrixd(gGLModelView);
+			glMultMatrixf((GLfloat*) matrices[i]->mMatrix);
+			gPipeline.mMatrixOpCount++;
+			params.mVertexBuffer->drawRange(params.mDrawMode, params.mStart, params.mEnd, params.mCount, params.mOffset);
+		}
 	}
 }
 
@@ -470,7 +544,12 @@ void LLRenderPass::pushBatch(LLDrawInfo& params, U32 mask, BOOL texture)
 		if (params.mTexture.notNull())
 		{
 			params.mTexture->addTextureStats(params.mVSize);
+			U32 binds = LLImageGL::sBindCount;
 			gGL.getTexUnit(0)->bind(params.mTexture, TRUE) ;
+			if (LLImageGL::sBindCount != binds)
+			{
+				gPipeline.mStateChanges++;
+			}
 			if (params.mTextureMatrix)
 			{
 				glMatrixMode(GL_TEXTURE);
@@ -486,13 +565,7 @@ void LLRenderPass::pushBatch(LLDrawInfo& params, U32 mask, BOOL texture)
 	
 	if (params.mVertexBuffer.notNull())
 	{
-		if (params.mGroup)
-		{
-			params.mGroup->rebuildMesh();
-		}
-		params.mVertexBuffer->setBuffer(mask);
-		params.mVertexBuffer->drawRange(params.mDrawMode, params.mStart, params.mEnd, params.mCount, params.mOffset);
-		gPipeline.addTrianglesDrawn(params.mCount, params.mDrawMode);
+		drawBatch(params, mask);
 	}
 
 	if (params.mTextureMatrix && texture && params.mTexture.notNull())
@@ -146,6 +146,13 @@ public:
 	void resetDrawOrders() { }
 
 	static void applyModelMatrix(LLDrawInfo& params);
+	// Binds the vertex buffer and draws params, all of its ranges at once
+	// when it is a merged batch.
+	static void drawBatch(LLDrawInfo& params, U32 mask);
+	// Draws every instance of an instanced batch, with a single instanced
+	// draw per MAX_INSTANCES when the bound shader can place them.
+	static void drawInstances(LLDrawInfo& params);
+	static const U32 MAX_INSTANCES = 32;	// size of instance_matrix[] in the object shaders
 	virtual void pushBatches(U32 type, U32 mask, BOOL texture = TRUE);
 	virtual void pushBatch(LLDrawInfo& params, U32 mask, BOOL texture);
 	virtual void renderGroup(LLSpatialGroup* group, U32 type, U32 mask, BOOL texture = TRUE);
@@ -30,6 +30,8 @@
 #include "llappviewer.h"
 #include "llagent.h"
 
+#include "llcallbacklist.h"
+#include "lleventpollbatch.h"
 #include "llhttpclient.h"
 #include "llhttpstatuscodes.h"
 #include "llsdserialize.h"
@@ -38,6 +40,8 @@
 #include "message.h"
 #include "lltrans.h"
 
+#include <deque>
+
 namespace
 {
 	// We will wait RETRY_SECONDS + (errorCount * RETRY_SECONDS_INC) before retrying after an error.
@@ -47,7 +51,7 @@ namespace
 	const F32 EVENT_POLL_ERROR_RETRY_SECONDS_INC = 5.f; // ~ half of a normal timeout.
 	const S32 MAX_EVENT_POLL_HTTP_ERRORS = 10; // ~5 minutes, by the above rules.
 
-	class LLEventPollResponder : public LLHTTPClient::Responder
+	class LLEventPollResponder : public LLEventPollBatchResponder
 	{
 	public:
 		
@@ -56,19 +60,23 @@ namespace
 		
 		void makeRequest();
 
+		LLSD getStats() const;
+
+		// Dispatches the events of all replies received since the last call,
+		// in the order they arrived.
+		static void dispatchPendingBatches(void*);
+
 	private:
 		LLEventPollResponder(const std::string&	pollURL, const LLHost& sender);
 		~LLEventPollResponder();
 
 		
 		void handleMessage(const LLSD& content);
+		void dispatchBatch(const LLEventPollBatch& batch);
 		virtual	void error(U32 status, const std::string& reason);
-		virtual	void result(const LLSD&	content);
+		/*virtual*/ void batchReceived(LLEventPollBatch::ptr_t batch);
+		/*virtual*/ void badReply(U32 status, const std::string& reason);
 
-		virtual void completedRaw(U32 status,
-									const std::string& reason,
-									const LLChannelDescriptors& channels,
-									const LLIOPipe::buffer_ptr_t& buffer);
 	private:
 
 		bool	mDone;
@@ -82,6 +90,22 @@ namespace
 		static int sCount;
 		int	mCount;
 		S32 mErrorCount;
+
+		// latency accounting for this region's poll
+		F64 mRequestTime;
+		S32 mBatchCount;
+		S32 mBinaryBatchCount;
+		S32 mEventCount;
+		S32 mBodyBytes;
+		F32 mParseSeconds;
+		F32 mMaxParseSeconds;
+		F32 mQueueSeconds;		// reply arrival to dispatch
+		F32 mMaxQueueSeconds;
+		F32 mDispatchSeconds;
+
+		typedef boost::intrusive_ptr<LLEventPollResponder> EventPollResponderPtr;
+		typedef std::deque<std::pair<EventPollResponderPtr, LLEventPollBatch::ptr_t> > batch_queue_t;
+		static batch_queue_t sPendingBatches;
 	};
 
 	class LLEventPollEventTimer : public LLEventTimer
@@ -116,19 +140,33 @@ namespace
 
 	void LLEventPollResponder::stop()
 	{
-		llinfos	<< "LLEventPollResponder::stop	<" << mCount <<	"> "
-				<< mPollURL	<< llendl;
+		if (!mDone)
+		{
+			llinfos	<< "LLEventPollResponder::stop	<" << mCount <<	"> "
+					<< mPollURL	<< " stats " << LLSDNotationStreamer(getStats()) << llendl;
+		}
 		// there should	be a way to	stop a LLHTTPClient	request	in progress
 		mDone =	true;
 	}
 
 	int	LLEventPollResponder::sCount =	0;
+	LLEventPollResponder::batch_queue_t LLEventPollResponder::sPendingBatches;
 
 	LLEventPollResponder::LLEventPollResponder(const std::string& pollURL, const LLHost& sender)
 		: mDone(false),
 		  mPollURL(pollURL),
 		  mCount(++sCount),
-		  mErrorCount(0)
+		  mErrorCount(0),
+		  mRequestTime(0.0),
+		  mBatchCount(0),
+		  mBinaryBatchCount(0),
+		  mEventCount(0),
+		  mBodyBytes(0),
+		  mParseSeconds(0.f),
+		  mMaxParseSeconds(0.f),
+		  mQueueSeconds(0.f),
+		  mMaxQueueSeconds(0.f),
+		  mDispatchSeconds(0.f)
 	{
 		//extract host and port of simulator to set as sender
 		LLViewerRegion *regionp = gAgent.getRegion();
@@ -148,33 +186,27 @@ namespace
 				 <<	mPollURL <<	llendl;
 	}
 
-	// virtual 
-	void LLEventPollResponder::completedRaw(U32 status,
-									const std::string& reason,
-									const LLChannelDescriptors& channels,
-									const LLIOPipe::buffer_ptr_t& buffer)
-	{
-		if (status == HTTP_BAD_GATEWAY)
-		{
-			// These errors are not parsable as LLSD, 
-			// which LLHTTPClient::Responder::completedRaw will try to do.
-			completed(status, reason, LLSD());
-		}
-		else
-		{
-			LLHTTPClient::Responder::completedRaw(status,reason,channels,buffer);
-		}
-	}
-
 	void LLEventPollResponder::makeRequest()
 	{
-		LLSD request;
-		request["ack"] = mAcknowledge;
-		request["done"]	= mDone;
-		
 		lldebugs <<	"LLEventPollResponder::makeRequest	<" << mCount <<	"> ack = "
 				 <<	LLSDXMLStreamer(mAcknowledge) << llendl;
-		LLHTTPClient::post(mPollURL, request, this);
+		mRequestTime = LLTimer::getTotalSeconds();
+		LLEventPollBatchResponder::post(mPollURL, mAcknowledge, mDone, this);
+	}
+
+	LLSD LLEventPollResponder::getStats() const
+	{
+		LLSD stats;
+		stats["batches"] = mBatchCount;
+		stats["binary_batches"] = mBinaryBatchCount;
+		stats["events"] = mEventCount;
+		stats["bytes"] = mBodyBytes;
+		stats["parse_seconds"] = mParseSeconds;
+		stats["max_parse_seconds"] = mMaxParseSeconds;
+		stats["mean_queue_seconds"] = mBatchCount ? mQueueSeconds / mBatchCount : 0.f;
+		stats["max_queue_seconds"] = mMaxQueueSeconds;
+		stats["dispatch_seconds"] = mDispatchSeconds;
+		return stats;
 	}
 
 	void LLEventPollResponder::handleMessage(const	LLSD& content)
@@ -186,6 +218,46 @@ namespace
 		LLMessageSystem::dispatch(msg_name, message);
 	}
 
+	void LLEventPollResponder::dispatchBatch(const LLEventPollBatch& batch)
+	{
+		const F32 queue_seconds = (F32)(LLTimer::getTotalSeconds() - batch.mReceivedTime);
+		mQueueSeconds += queue_seconds;
+		mMaxQueueSeconds = llmax(mMaxQueueSeconds, queue_seconds);
+
+		LLTimer dispatch_timer;
+		const LLSD& events = batch.getEvents();
+		LLSD::array_const_iterator i = events.beginArray();
+		LLSD::array_const_iterator end = events.endArray();
+		for	(; i !=	end; ++i)
+		{
+			if (i->has("message"))
+			{
+				handleMessage(*i);
+			}
+		}
+		mDispatchSeconds += dispatch_timer.getElapsedTimeF32();
+	}
+
+	//static
+	void LLEventPollResponder::dispatchPendingBatches(void*)
+	{
+		// Handlers may stop pollers but never receive replies, so the
+		// queue only shrinks here.
+		while (!sPendingBatches.empty())
+		{
+			EventPollResponderPtr responder = sPendingBatches.front().first;
+			LLEventPollBatch::ptr_t batch = sPendingBatches.front().second;
+			sPendingBatches.pop_front();
+
+			// events for a region we have let go of are dropped, as before
+			if (!responder->mDone)
+			{
+				responder->dispatchBatch(*batch);
+			}
+		}
+		gIdleCallbacks.deleteFunction(&LLEventPollResponder::dispatchPendingBatches);
+	}
+
 	//virtual
 	void LLEventPollResponder::error(U32 status, const	std::string& reason)
 	{
@@ -234,25 +306,25 @@ namespace
 	}
 
 	//virtual
-	void LLEventPollResponder::result(const LLSD& content)
+	void LLEventPollResponder::badReply(U32 status, const std::string& reason)
 	{
-		lldebugs <<	"LLEventPollResponder::result <" << mCount	<< ">"
-				 <<	(mDone ? " -- done"	: "") << llendl;
-		
 		if (mDone) return;
 
 		mErrorCount = 0;
+		llwarns << "received event poll with no events or id key" << llendl;
+		makeRequest();
+	}
 
-		if (!content.get("events") ||
-			!content.get("id"))
-		{
-			llwarns << "received event poll with no events or id key" << llendl;
-			makeRequest();
-			return;
-		}
+	//virtual
+	void LLEventPollResponder::batchReceived(LLEventPollBatch::ptr_t batch)
+	{
+		lldebugs <<	"LLEventPollResponder::batchReceived <" << mCount	<< ">"
+				 <<	(mDone ? " -- done"	: "") << llendl;
 		
-		mAcknowledge = content["id"];
-		LLSD events	= content["events"];
+		if (mDone) return;
+
+		mErrorCount = 0;
+		mAcknowledge = batch->getID();
 
 		if(mAcknowledge.isUndefined())
 		{
@@ -260,20 +332,29 @@ namespace
 		}
 		
 		// was llinfos but now that CoarseRegionUpdate is TCP @ 1/second, it'd be too verbose for viewer logs. -MG
-		lldebugs  << "LLEventPollResponder::completed <" <<	mCount << "> " << events.size() << "events (id "
+		lldebugs  << "LLEventPollResponder::completed <" <<	mCount << "> " << batch->getEventCount() << "events (id "
 				 <<	LLSDXMLStreamer(mAcknowledge) << ")" << llendl;
-		
-		LLSD::array_const_iterator i = events.beginArray();
-		LLSD::array_const_iterator end = events.endArray();
-		for	(; i !=	end; ++i)
+
+		++mBatchCount;
+		if (batch->isBinary())
 		{
-			if (i->has("message"))
-			{
-				handleMessage(*i);
-			}
+			++mBinaryBatchCount;
 		}
-		
+		mEventCount += batch->getEventCount();
+		mBodyBytes += batch->getBodyBytes();
+		mParseSeconds += batch->getParseSeconds();
+		mMaxParseSeconds = llmax(mMaxParseSeconds, batch->getParseSeconds());
+
+		// The reply is already parsed and acknowledged by the next poll, so
+		// put the request back in flight before any handler runs and leave
+		// dispatching to the main loop.
 		makeRequest();
+
+		if (sPendingBatches.empty())
+		{
+			gIdleCallbacks.addFunction(&LLEventPollResponder::dispatchPendingBatches);
+		}
+		sPendingBatches.push_back(std::make_pair(EventPollResponderPtr(this), batch));
 	}	
 }
 
@@ -287,3 +368,10 @@ LLEventPoll::~LLEventPoll()
 	LLEventPollResponder* event_poll_responder = dynamic_cast<LLEventPollResponder*>(responderp);
 	if (event_poll_responder) event_poll_responder->stop();
 }
+
+LLSD LLEventPoll::getStats() const
+{
+	LLHTTPClient::Responder* responderp = mImpl.get();
+	LLEventPollResponder* event_poll_responder = dynamic_cast<LLEventPollResponder*>(responderp);
+	return event_poll_responder ? event_poll_responder->getStats() : LLSD();
+}
@@ -42,6 +42,9 @@ public:
 	virtual ~LLEventPoll();
 		///< will stop polling, cancelling any poll in progress.
 
+	LLSD getStats() const;
+		///< event counts, parse times and dispatch delays for this poll.
+
 
 private:
 	LLHTTPClient::ResponderPtr mImpl;
@@ -161,6 +161,7 @@ void LLFace::init(LLDrawable* drawablep, LLViewerObject* objp)
 	mReferenceIndex = -1;
 
 	mTextureMatrix = NULL;
+	mInstanceMatrix = NULL;
 	mDrawInfo = NULL;
 
 	mFaceColor = LLColor4(1,0,0,1);
@@ -419,7 +420,11 @@ void LLFace::renderSelected(LLViewerTexture *imagep, const LLColor4& color)
 		gGL.getTexUnit(0)->bind(imagep);
 	
 		gGL.pushMatrix();
-		if (mDrawablep->isActive())
+		if (isState(INSTANCED) && mInstanceMatrix)
+		{
+			glMultMatrixf((GLfloat*)mInstanceMatrix->mMatrix);
+		}
+		else if (mDrawablep->isActive())
 		{
 			glMultMatrixf((GLfloat*)mDrawablep->getRenderMatrix().mMatrix);
 		}
@@ -870,7 +875,8 @@ static LLFastTimer::DeclareTimer FTM_FACE_GET_GEOM("Face Geom");
 BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 							   const S32 &f,
 								const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
-								const U16 &index_offset)
+								const U16 &index_offset,
+								BOOL force_rebuild)
 {
 	LLFastTimer t(FTM_FACE_GET_GEOM);
 	const LLVolumeFace &vf = volume.getVolumeFace(f);
@@ -908,7 +914,7 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 	LLStrider<LLVector3> binormals;
 	LLStrider<U16> indicesp;
 
-	BOOL full_rebuild = mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
+	BOOL full_rebuild = force_rebuild || mDrawablep->isState(LLDrawable::REBUILD_VOLUME);
 	
 	BOOL global_volume = mDrawablep->getVOVolume()->isVolumeGlobal();
 	LLVector3 scale;
@@ -67,6 +67,7 @@ public:
 		HUD_RENDER		= 0x0008,
 		USE_FACE_COLOR	= 0x0010,
 		TEXTURE_ANIM	= 0x0020, 
+		INSTANCED		= 0x0040,	// draws from a buffer shared with identical faces
 	};
 
 	static void initClass();
@@ -142,7 +143,8 @@ public:
 	BOOL getGeometryVolume(const LLVolume& volume,
 						const S32 &f,
 						const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
-						const U16 &index_offset);
+						const U16 &index_offset,
+						BOOL force_rebuild = FALSE);
 
 	// For avatar
 	U16			 getGeometryAvatar(
@@ -224,6 +226,7 @@ public:
 	F32			mLastUpdateTime;
 	F32			mLastMoveTime;
 	LLMatrix4*	mTextureMatrix;
+	const LLMatrix4* mInstanceMatrix;	// model matrix when INSTANCED, owned by the spatial group
 	LLDrawInfo* mDrawInfo;
 
 private:
@@ -525,6 +525,37 @@ void LLFolderView::filter( LLInventoryFilter& filter )
 	}
 }
 
+void LLFolderView::addLabelSuffix(const std::string& suffix)
+{
+	std::string searchable_suffix(suffix);
+	LLStringUtil::toUpper(searchable_suffix);
+	// the item showing it dirties its own filter state when its label changes
+	mLabelSuffixes.insert(searchable_suffix);
+}
+
+bool LLFolderView::labelSuffixMayMatch(const std::string& substring) const
+{
+	for (std::set<std::string>::const_iterator iter = mLabelSuffixes.begin();
+		 iter != mLabelSuffixes.end();
+		 ++iter)
+	{
+		const std::string& suffix = *iter;
+		if (suffix.find(substring) != std::string::npos)
+		{
+			return true;
+		}
+		// the match may also start in the label and run into the suffix
+		for (size_t len = 1; len < substring.size() && len <= suffix.size(); ++len)
+		{
+			if (!substring.compare(substring.size() - len, len, suffix, 0, len))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 void LLFolderView::reshape(S32 width, S32 height, BOOL called_from_parent)
 {
 	LLRect scroll_rect;
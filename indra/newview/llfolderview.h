@@ -269,6 +269,12 @@ public:
 	virtual S32	notify(const LLSD& info) ;
 	
 	bool useLabelSuffix() { return mUseLabelSuffix; }
+
+	// Label suffixes are not in the inventory search index, these track
+	// which ones are shown so a filter string that could hit them can
+	// fall back to checking every item.
+	void addLabelSuffix(const std::string& suffix);
+	bool labelSuffixMayMatch(const std::string& substring) const;
 private:
 	void updateRenamerPosition();
 
@@ -309,6 +315,7 @@ protected:
 	BOOL							mAutoSelectOverride;
 	BOOL							mNeedsAutoRename;
 	bool							mUseLabelSuffix;
+	std::set<std::string>			mLabelSuffixes;	// upper-cased
 	
 	BOOL							mDebugFilters;
 	U32								mSortOrder;
@@ -287,6 +287,10 @@ void LLFolderViewItem::refreshFromListener()
 		{
 			mLabelStyle = mListener->getLabelStyle();
 			mLabelSuffix = mListener->getLabelSuffix();
+			if (!mLabelSuffix.empty())
+			{
+				mRoot->addLabelSuffix(mLabelSuffix);
+			}
 		}
 	}
 }
@@ -1382,6 +1386,10 @@ void LLFolderViewFolder::filter( LLInventoryFilter& filter)
 		LLInventoryModelBackgroundFetch::instance().start(mListener->getUUID());
 	}
 
+	// with a filter string, folders the search index has no matches under can be
+	// skipped outright, unless the string might match an item's label suffix
+	const bool use_search_index = filter.hasFilterString() && !getRoot()->labelSuffixMayMatch(filter.getFilterSubString());
+
 	// now query children
 	for (folders_t::iterator iter = mFolders.begin();
 		 iter != mFolders.end();
@@ -1394,6 +1402,21 @@ void LLFolderViewFolder::filter( LLInventoryFilter& filter)
 			break;
 		}
 
+		if (use_search_index
+			&& folder->getCompletedFilterGeneration() < filter_generation
+			&& folder->getListener()
+			&& filter.isFolderExcludedBySearch(folder->getListener()->getUUID()))
+		{
+			if (folder->getVisible())
+			{
+				requestArrange();
+			}
+			folder->setFiltered(FALSE, filter_generation);
+			folder->setCompletedFilterGeneration(filter_generation, FALSE);
+			filter.decrementFilterCount();
+			continue;
+		}
+
 		// mMostFilteredDescendantGeneration might have been reset
 		// in which case we need to update it even for folders that
 		// don't need to be filtered anymore
@@ -0,0 +1,296 @@
+/**
+ * @file llinstancedgeometry.cpp
+ * @brief Vertex buffers shared by identical prim faces
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinstancedgeometry.h"
+
+#include "lldrawable.h"
+#include "lldrawpool.h"
+#include "llface.h"
+#include "llspatialpartition.h"
+#include "llviewerregion.h"
+#include "llvovolume.h"
+#include "pipeline.h"
+
+U32 LLInstancedGeometry::sBufferCount = 0;
+U32 LLInstancedGeometry::sInstanceCount = 0;
+S64 LLInstancedGeometry::sSharedBytes = 0;
+S64 LLInstancedGeometry::sSavedBytes = 0;
+LLInstancedGeometry::entry_map_t LLInstancedGeometry::sEntries;
+LLInstancedGeometry::group_users_t LLInstancedGeometry::sGroupUsers;
+
+LLInstancedGeometry::Key::Key(LLFace* facep, U32 mask)
+{
+	LLVOVolume* vobj = facep->getDrawable()->getVOVolume();
+	const LLTextureEntry* te = facep->getTextureEntry();
+
+	mVolume = vobj->getVolume();
+	mFace = facep->getTEOffset();
+	mMask = mask;
+	// Global state getGeometryVolume() reads
+	mRenderFlags = (LLPipeline::sRenderDeferred ? 1 : 0) |
+				   (LLPipeline::sRenderBump ? 2 : 0) |
+				   (LLPipeline::sUseTriStrips ? 4 : 0);
+	mScale = vobj->getScale();
+	mColor = te->getColor();
+	te->getScale(&mScaleS, &mScaleT);
+	te->getOffset(&mOffsetS, &mOffsetT);
+	mRotation = te->getRotation();
+	mShiny = te->getShiny();
+	mTexGen = te->getTexGen();
+}
+
+bool LLInstancedGeometry::Key::operator<(const Key& rhs) const
+{
+	if (mVolume != rhs.mVolume)
+	{
+		return mVolume.get() < rhs.mVolume.get();
+	}
+	if (mFace != rhs.mFace)
+	{
+		return mFace < rhs.mFace;
+	}
+	if (mMask != rhs.mMask)
+	{
+		return mMask < rhs.mMask;
+	}
+	if (mRenderFlags != rhs.mRenderFlags)
+	{
+		return mRenderFlags < rhs.mRenderFlags;
+	}
+	for (U32 i = 0; i < 3; i++)
+	{
+		if (mScale.mV[i] != rhs.mScale.mV[i])
+		{
+			return mScale.mV[i] < rhs.mScale.mV[i];
+		}
+	}
+	for (U32 i = 0; i < 4; i++)
+	{
+		if (mColor.mV[i] != rhs.mColor.mV[i])
+		{
+			return mColor.mV[i] < rhs.mColor.mV[i];
+		}
+	}
+	if (mScaleS != rhs.mScaleS)
+	{
+		return mScaleS < rhs.mScaleS;
+	}
+	if (mScaleT != rhs.mScaleT)
+	{
+		return mScaleT < rhs.mScaleT;
+	}
+	if (mOffsetS != rhs.mOffsetS)
+	{
+		return mOffsetS < rhs.mOffsetS;
+	}
+	if (mOffsetT != rhs.mOffsetT)
+	{
+		return mOffsetT < rhs.mOffsetT;
+	}
+	if (mRotation != rhs.mRotation)
+	{
+		return mRotation < rhs.mRotation;
+	}
+	if (mShiny != rhs.mShiny)
+	{
+		return mShiny < rhs.mShiny;
+	}
+	return mTexGen < rhs.mTexGen;
+}
+
+//static
+BOOL LLInstancedGeometry::canInstance(LLSpatialGroup* group, LLFace* facep)
+{
+	if (!LLPipeline::sRenderInstancing ||
+		group->mSpatialPartition->mPartitionType != LLViewerRegion::PARTITION_VOLUME)
+	{
+		return FALSE;
+	}
+
+	LLDrawable* drawablep = facep->getDrawable();
+	LLVOVolume* vobj = drawablep->getVOVolume();
+	LLVolume* volume = vobj ? vobj->getVolume() : NULL;
+	if (!volume || volume->isUnique() || drawablep->isActive() || drawablep->isAnimating() ||
+		vobj->isFlexible() || vobj->isSculpted() || vobj->isVolumeGlobal() || vobj->isHUDAttachment() ||
+		(vobj->mTextureAnimp && vobj->mTexAnimMode))
+	{ //moving, deforming, resculpted or animated vertices
+		return FALSE;
+	}
+
+	const LLTextureEntry* te = facep->getTextureEntry();
+	if (!te || te->getBumpmap() ||
+		facep->getPoolType() == LLDrawPool::POOL_ALPHA ||
+		facep->isState(LLFace::TEXTURE_ANIM) ||
+		facep->isAtlasInUse())
+	{ //bump offsets depend on orientation, alpha is sorted per face
+		return FALSE;
+	}
+
+	return facep->getGeomCount() > 0 && facep->getIndicesCount() > 0;
+}
+
+//static
+void LLInstancedGeometry::addUser(LLSpatialGroup* group, LLFace* facep, U32 mask)
+{
+	entry_map_t::iterator iter = sEntries.insert(std::make_pair(Key(facep, mask), Entry())).first;
+	iter->second.mUsers++;
+	sGroupUsers[group].push_back(iter);
+}
+
+//static
+void LLInstancedGeometry::removeUsers(LLSpatialGroup* group)
+{
+	group_users_t::iterator group_iter = sGroupUsers.find(group);
+	if (group_iter == sGroupUsers.end())
+	{
+		return;
+	}
+
+	std::vector<entry_map_t::iterator>& users = group_iter->second;
+	for (U32 i = 0; i < users.size(); i++)
+	{
+		llassert(users[i]->second.mUsers > 0);
+		users[i]->second.mUsers--;
+	}
+	sGroupUsers.erase(group_iter);
+}
+
+//static
+BOOL LLInstancedGeometry::setBuffer(LLFace* facep, U32 mask)
+{
+	Key key(facep, mask);
+
+	entry_map_t::iterator iter = sEntries.find(key);
+	if (iter == sEntries.end() || iter->second.mUsers < 2)
+	{
+		return FALSE;
+	}
+
+	facep->setGeomIndex(0);
+	facep->setIndicesIndex(0);
+	// Leaving the shared buffer for one of its own must rebuild the face
+	facep->mLastVertexBuffer = NULL;
+
+	Entry& entry = iter->second;
+	if (entry.mBuffer.notNull())
+	{
+		facep->mVertexBuffer = entry.mBuffer;
+		return TRUE;
+	}
+
+	LLPointer<LLVertexBuffer> buffer = new LLVertexBuffer(mask, GL_STATIC_DRAW_ARB);
+	buffer->allocateBuffer(facep->getGeomCount(), facep->getIndicesCount(), TRUE);
+	facep->mVertexBuffer = buffer;
+
+	// Scale is part of the key, so it goes in the shared vertices and
+	// instance matrices only rotate and move. Normals stay unit length.
+	const LLVector3& scale = key.mScale;
+	LLMatrix4 mat_vert;
+	mat_vert.initRows(LLVector4(scale.mV[VX], 0.f, 0.f, 0.f),
+					  LLVector4(0.f, scale.mV[VY], 0.f, 0.f),
+					  LLVector4(0.f, 0.f, scale.mV[VZ], 0.f),
+					  LLVector4(0.f, 0.f, 0.f, 1.f));
+	LLMatrix3 mat_normal;
+	mat_normal.setRows(LLVector3(1.f / scale.mV[VX], 0.f, 0.f),
+					   LLVector3(0.f, 1.f / scale.mV[VY], 0.f),
+					   LLVector3(0.f, 0.f, 1.f / scale.mV[VZ]));
+
+	facep->getGeometryVolume(*key.mVolume, key.mFace, mat_vert, mat_normal, 0, TRUE);
+	facep->mLastVertexBuffer = NULL;
+	buffer->setBuffer(0);
+
+	entry.mBuffer = buffer;
+	return TRUE;
+}
+
+//static
+void LLInstancedGeometry::getInstanceMatrix(LLFace* facep, LLMatrix4& mat)
+{
+	LLDrawable* drawablep = facep->getDrawable();
+	LLVOVolume* vobj = drawablep->getVOVolume();
+	const LLMatrix4& xform = vobj->getRelativeXform();
+	const LLVector3& scale = vobj->getScale();
+
+	// The relative transform of a static prim without its scale
+	for (U32 i = 0; i < 3; i++)
+	{
+		for (U32 j = 0; j < 3; j++)
+		{
+			mat.mMatrix[i][j] = xform.mMatrix[i][j] / scale.mV[i];
+		}
+		mat.mMatrix[i][3] = 0.f;
+	}
+	for (U32 j = 0; j < 4; j++)
+	{
+		mat.mMatrix[3][j] = xform.mMatrix[3][j];
+	}
+
+	mat *= drawablep->getRegion()->mRenderMatrix;
+}
+
+//static
+void LLInstancedGeometry::updateClass()
+{
+	sBufferCount = 0;
+	sInstanceCount = 0;
+	sSharedBytes = 0;
+	sSavedBytes = 0;
+
+	for (entry_map_t::iterator iter = sEntries.begin(); iter != sEntries.end(); )
+	{
+		entry_map_t::iterator cur = iter++;
+		LLVertexBuffer* buffer = cur->second.mBuffer;
+		S32 instances = buffer ? buffer->getNumRefs() - 1 : 0;
+		if (instances <= 0)
+		{
+			if (cur->second.mUsers == 0)
+			{
+				sEntries.erase(cur);
+			}
+			else
+			{ //faces that shared it have all moved to buffers of their own
+				cur->second.mBuffer = NULL;
+			}
+			continue;
+		}
+
+		S64 bytes = buffer->getSize() + buffer->getIndicesSize();
+		sBufferCount++;
+		sInstanceCount += instances;
+		sSharedBytes += bytes;
+		sSavedBytes += bytes * (instances - 1);
+	}
+}
+
+//static
+void LLInstancedGeometry::cleanupClass()
+{
+	sGroupUsers.clear();
+	sEntries.clear();
+	updateClass();
+}
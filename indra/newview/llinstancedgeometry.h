@@ -0,0 +1,123 @@
+/**
+ * @file llinstancedgeometry.h
+ * @brief Vertex buffers shared by identical prim faces
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINSTANCEDGEOMETRY_H
+#define LL_LLINSTANCEDGEOMETRY_H
+
+#include "llpointer.h"
+#include "llvertexbuffer.h"
+#include "llvolume.h"
+#include "v4color.h"
+
+#include <map>
+#include <vector>
+
+class LLFace;
+class LLMatrix4;
+class LLSpatialGroup;
+
+// Static prim faces with the same volume, LOD, scale and texture mapping
+// have the same vertices in object space. Rather than each copying its
+// vertices, moved to region space, into its group's vertex buffer, such
+// faces draw from one shared buffer with a model matrix of their own.
+// Fences, floor tiles and foliage repeat a few prims thousands of times.
+// A face only shares once another face has its key, unique faces are
+// cheaper copied into their group's buffers and batched there.
+class LLInstancedGeometry
+{
+public:
+	// Whether facep of a group being rebuilt can draw from a shared buffer.
+	static BOOL canInstance(LLSpatialGroup* group, LLFace* facep);
+
+	// Counts facep, which canInstance(), as a user of its key until group
+	// is rebuilt or destroyed.
+	static void addUser(LLSpatialGroup* group, LLFace* facep, U32 mask);
+
+	// Drops the users group added, for when it is rebuilt or destroyed.
+	static void removeUsers(LLSpatialGroup* group);
+
+	// Points facep at the shared buffer for its key, filling a new buffer
+	// from facep if there is none yet. Returns FALSE, leaving facep alone,
+	// if no other face uses the key.
+	static BOOL setBuffer(LLFace* facep, U32 mask);
+
+	// Takes the shared geometry of facep, scaled in object space, to agent space.
+	static void getInstanceMatrix(LLFace* facep, LLMatrix4& mat);
+
+	// Drops keys and buffers no face uses any more and counts what sharing
+	// saves. Called once a frame.
+	static void updateClass();
+
+	// Releases all buffers, for when vertex buffers are reset and on shutdown.
+	static void cleanupClass();
+
+	static U32 sBufferCount;		// shared buffers
+	static U32 sInstanceCount;		// faces drawing from them
+	static S64 sSharedBytes;		// memory of the shared buffers
+	static S64 sSavedBytes;			// memory the instances would take more copied
+
+private:
+	// Everything getGeometryVolume() bakes into the vertices besides the
+	// object's position and rotation.
+	struct Key
+	{
+		Key(LLFace* facep, U32 mask);
+
+		bool operator<(const Key& rhs) const;
+
+		LLPointer<LLVolume> mVolume;	// shared per params and LOD by LLVolumeMgr
+		S32 mFace;
+		U32 mMask;
+		U32 mRenderFlags;
+		LLVector3 mScale;
+		LLColor4 mColor;
+		F32 mScaleS;
+		F32 mScaleT;
+		F32 mOffsetS;
+		F32 mOffsetT;
+		F32 mRotation;
+		U8 mShiny;
+		U8 mTexGen;
+	};
+
+	struct Entry
+	{
+		Entry() : mUsers(0) {}
+
+		LLPointer<LLVertexBuffer> mBuffer;	// NULL until two faces use the key
+		U32 mUsers;
+	};
+
+	typedef std::map<Key, Entry> entry_map_t;
+	static entry_map_t sEntries;
+
+	// The keys each group counted users of. Entries with users are never
+	// erased, so the iterators stay valid.
+	typedef std::map<LLSpatialGroup*, std::vector<entry_map_t::iterator> > group_users_t;
+	static group_users_t sGroupUsers;
+};
+
+#endif // LL_LLINSTANCEDGEOMETRY_H
@@ -1519,7 +1519,10 @@ BOOL LLFolderBridge::isUpToDate() const
 		return FALSE;
 	}
 
-	return category->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN;
+	// A folder still in the inventory cache has no item views until
+	// it is opened.
+	return (category->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		&& !model->isCategoryPending(mUUID);
 }
 
 BOOL LLFolderBridge::isItemCopyable() const
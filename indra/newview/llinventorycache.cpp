@@ -0,0 +1,526 @@
+/**
+ * @file llinventorycache.cpp
+ * @brief Implementation of the binary inventory folder cache.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llinventorycache.h"
+
+#include "llsdserialize.h"
+#include "llviewerinventory.h"
+
+#include <set>
+#include <sstream>
+
+///----------------------------------------------------------------------------
+/// Local function declarations, constants, enums, and typedefs
+///----------------------------------------------------------------------------
+
+// Increment this if the layout of the file changes. Changes to the
+// inventory contents are covered by the model's cache version.
+const U32 INV_CACHE_FORMAT_VERSION = 1;
+const char INV_CACHE_MAGIC[4] = { 'L', 'I', 'N', 'V' };
+
+// Don't bother compacting small files.
+const S32 INV_CACHE_COMPACT_MIN_BYTES = 256 * 1024;
+
+enum
+{
+	RECORD_SECTION = 1,
+	RECORD_TOMBSTONE = 2
+};
+
+// Written in host byte order, like the texture cache entries.
+struct LLInvCacheFileHeader
+{
+	char mMagic[4];
+	U32 mFormatVersion;
+	S32 mModelVersion;
+	U32 mReserved;
+};
+
+struct LLInvCacheRecordHeader
+{
+	U32 mType;
+	S32 mVersion;
+	S32 mItemCount;
+	S32 mPayloadSize;
+	U8 mCategoryID[UUID_BYTES];
+};
+
+static S32 record_size(S32 item_count, S32 payload_size)
+{
+	return sizeof(LLInvCacheRecordHeader) + item_count * UUID_BYTES + payload_size;
+}
+
+///----------------------------------------------------------------------------
+/// Class LLInventoryCache
+///----------------------------------------------------------------------------
+
+LLInventoryCache::LLInventoryCache(const std::string& filename, S32 model_version)
+:	mFilename(filename),
+	mModelVersion(model_version),
+	mFile(NULL),
+	mLiveBytes(0),
+	mFileBytes(0)
+{
+}
+
+LLInventoryCache::~LLInventoryCache()
+{
+	close();
+}
+
+bool LLInventoryCache::open()
+{
+	close();
+	mSections.clear();
+	mLiveBytes = 0;
+	mFileBytes = 0;
+
+	mFile = LLFile::fopen(mFilename, "r+b");		/*Flawfinder: ignore*/
+	if (!mFile)
+	{
+		return false;
+	}
+
+	LLInvCacheFileHeader header;
+	if (fread(&header, sizeof(header), 1, mFile) != 1
+		|| memcmp(header.mMagic, INV_CACHE_MAGIC, sizeof(INV_CACHE_MAGIC))
+		|| header.mFormatVersion != INV_CACHE_FORMAT_VERSION
+		|| header.mModelVersion != mModelVersion)
+	{
+		llinfos << "Discarding obsolete inventory cache " << mFilename << llendl;
+		discard();
+		return false;
+	}
+
+	fseek(mFile, 0, SEEK_END);
+	const S32 file_size = (S32)ftell(mFile);
+	fseek(mFile, sizeof(header), SEEK_SET);
+
+	// Replay the log. A later record for a folder supersedes earlier ones.
+	S32 offset = sizeof(header);
+	bool damaged = false;
+	LLInvCacheRecordHeader record;
+	while (offset < file_size)
+	{
+		if (fread(&record, sizeof(record), 1, mFile) != 1
+			|| record.mItemCount < 0
+			|| record.mPayloadSize < 0
+			|| (record.mType != RECORD_SECTION && record.mType != RECORD_TOMBSTONE))
+		{
+			damaged = true;
+			break;
+		}
+		const S32 size = record_size(record.mItemCount, record.mPayloadSize);
+		if (offset + size > file_size)
+		{
+			damaged = true;
+			break;
+		}
+
+		LLUUID cat_id;
+		memcpy(cat_id.mData, record.mCategoryID, UUID_BYTES);
+		section_map_t::iterator it = mSections.find(cat_id);
+		if (it != mSections.end())
+		{
+			mLiveBytes -= it->second.mRecordSize;
+			mSections.erase(it);
+		}
+
+		if (record.mType == RECORD_SECTION)
+		{
+			Section& section = mSections[cat_id];
+			section.mVersion = record.mVersion;
+			section.mRecordOffset = offset;
+			section.mRecordSize = size;
+			section.mPayloadSize = record.mPayloadSize;
+			section.mItemIDs.resize(record.mItemCount);
+			if (record.mItemCount > 0
+				&& fread(&section.mItemIDs[0], UUID_BYTES, record.mItemCount, mFile) != (size_t)record.mItemCount)
+			{
+				mSections.erase(cat_id);
+				damaged = true;
+				break;
+			}
+			fseek(mFile, record.mPayloadSize, SEEK_CUR);
+			mLiveBytes += size;
+		}
+		offset += size;
+	}
+	mFileBytes = offset;
+
+	if (damaged)
+	{
+		// Most likely the tail of a save that did not finish. Keep the
+		// records before it and drop the rest.
+		llwarns << "Inventory cache " << mFilename << " is damaged at offset "
+				<< offset << ", keeping " << mSections.size() << " folders." << llendl;
+		if (!compact())
+		{
+			discard();
+			return false;
+		}
+	}
+
+	llinfos << "Opened inventory cache " << mFilename << " with "
+			<< mSections.size() << " folders." << llendl;
+	return true;
+}
+
+void LLInventoryCache::close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+	}
+}
+
+const LLInventoryCache::Section* LLInventoryCache::getSection(const LLUUID& cat_id) const
+{
+	section_map_t::const_iterator it = mSections.find(cat_id);
+	if (it != mSections.end())
+	{
+		return &it->second;
+	}
+	return NULL;
+}
+
+bool LLInventoryCache::loadSection(const LLUUID& cat_id, LLInventoryModel::item_array_t& items)
+{
+	const Section* section = getSection(cat_id);
+	if (!section || !mFile)
+	{
+		return false;
+	}
+	if (section->mPayloadSize == 0)
+	{
+		return true;
+	}
+
+	const S32 payload_offset = section->mRecordOffset
+		+ record_size(section->mItemIDs.size(), 0);
+	std::string payload(section->mPayloadSize, '\0');
+	if (fseek(mFile, payload_offset, SEEK_SET)
+		|| fread(&payload[0], 1, section->mPayloadSize, mFile) != (size_t)section->mPayloadSize)
+	{
+		llwarns << "Unable to read cached folder " << cat_id << " from "
+				<< mFilename << llendl;
+		return false;
+	}
+
+	LLSD item_list;
+	std::istringstream istr(payload);
+	if (LLSDSerialize::fromBinary(item_list, istr, section->mPayloadSize) == LLSDParser::PARSE_FAILURE
+		|| !item_list.isArray())
+	{
+		llwarns << "Unable to parse cached folder " << cat_id << " from "
+				<< mFilename << llendl;
+		return false;
+	}
+
+	for (LLSD::array_const_iterator it = item_list.beginArray(), end = item_list.endArray();
+		 it != end; ++it)
+	{
+		LLPointer<LLViewerInventoryItem> item = new LLViewerInventoryItem;
+		if (!item->fromLLSD(*it) || item->getUUID().isNull())
+		{
+			llwarns << "Ignoring invalid cached inventory item: " << item->getName() << llendl;
+			continue;
+		}
+		// Same as importFileLocal(), cached items are not trusted as complete.
+		item->setComplete(FALSE);
+		items.put(item);
+	}
+	return true;
+}
+
+bool LLInventoryCache::save(const LLInventoryModel::cat_array_t& categories,
+							const LLInventoryModel::item_array_t& items)
+{
+	if (!mFile && !createFile())
+	{
+		return false;
+	}
+
+	typedef std::map<LLUUID, LLInventoryModel::item_array_t> folder_items_t;
+	folder_items_t folder_items;
+	S32 count = items.count();
+	for (S32 i = 0; i < count; ++i)
+	{
+		folder_items[items[i]->getParentUUID()].put(items[i]);
+	}
+
+	// Any change to a folder bumps its version, so a section written for
+	// the current version is still good.
+	std::set<LLUUID> cached_ids;
+	const LLInventoryModel::item_array_t no_items;
+	S32 written = 0;
+	count = categories.count();
+	for (S32 i = 0; i < count; ++i)
+	{
+		const LLViewerInventoryCategory* cat = categories[i];
+		if (cat->getVersion() == LLViewerInventoryCategory::VERSION_UNKNOWN)
+		{
+			continue;
+		}
+		const LLUUID& cat_id = cat->getUUID();
+		cached_ids.insert(cat_id);
+
+		const Section* section = getSection(cat_id);
+		if (section && section->mVersion == cat->getVersion())
+		{
+			continue;
+		}
+		folder_items_t::const_iterator fit = folder_items.find(cat_id);
+		if (!writeSection(cat_id, cat->getVersion(),
+						  fit != folder_items.end() ? fit->second : no_items))
+		{
+			llwarns << "Unable to save inventory to " << mFilename << llendl;
+			discard();
+			return false;
+		}
+		++written;
+	}
+
+	uuid_vec_t stale_ids;
+	for (section_map_t::const_iterator it = mSections.begin(); it != mSections.end(); ++it)
+	{
+		if (cached_ids.find(it->first) == cached_ids.end())
+		{
+			stale_ids.push_back(it->first);
+		}
+	}
+	for (uuid_vec_t::const_iterator it = stale_ids.begin(); it != stale_ids.end(); ++it)
+	{
+		if (!writeTombstone(*it))
+		{
+			llwarns << "Unable to save inventory to " << mFilename << llendl;
+			discard();
+			return false;
+		}
+	}
+	fflush(mFile);
+
+	llinfos << "Saved " << written << " of " << cached_ids.size()
+			<< " inventory folders to " << mFilename << llendl;
+
+	if (mFileBytes > INV_CACHE_COMPACT_MIN_BYTES
+		&& mFileBytes - mLiveBytes > mLiveBytes)
+	{
+		compact();
+	}
+	return true;
+}
+
+bool LLInventoryCache::compact()
+{
+	if (!mFile)
+	{
+		return false;
+	}
+
+	std::string temp_filename(mFilename);
+	temp_filename.append(".tmp");
+	LLFILE* out = LLFile::fopen(temp_filename, "wb");		/*Flawfinder: ignore*/
+	if (!out)
+	{
+		llwarns << "Unable to compact inventory cache " << mFilename << llendl;
+		return false;
+	}
+
+	LLInvCacheFileHeader header;
+	memcpy(header.mMagic, INV_CACHE_MAGIC, sizeof(INV_CACHE_MAGIC));
+	header.mFormatVersion = INV_CACHE_FORMAT_VERSION;
+	header.mModelVersion = mModelVersion;
+	header.mReserved = 0;
+	bool ok = (fwrite(&header, sizeof(header), 1, out) == 1);
+
+	// Sections are copied verbatim, nothing is parsed.
+	std::map<LLUUID, S32> new_offsets;
+	std::vector<U8> buffer;
+	S32 offset = sizeof(header);
+	for (section_map_t::const_iterator it = mSections.begin(); ok && it != mSections.end(); ++it)
+	{
+		const Section& section = it->second;
+		buffer.resize(section.mRecordSize);
+		ok = !fseek(mFile, section.mRecordOffset, SEEK_SET)
+			&& fread(&buffer[0], 1, section.mRecordSize, mFile) == (size_t)section.mRecordSize
+			&& fwrite(&buffer[0], 1, section.mRecordSize, out) == (size_t)section.mRecordSize;
+		new_offsets[it->first] = offset;
+		offset += section.mRecordSize;
+	}
+	ok = (fclose(out) == 0) && ok;
+	if (!ok)
+	{
+		llwarns << "Unable to compact inventory cache " << mFilename << llendl;
+		LLFile::remove(temp_filename);
+		return false;
+	}
+
+	close();
+	LLFile::remove(mFilename);
+	if (LLFile::rename(temp_filename, mFilename))
+	{
+		llwarns << "Unable to replace inventory cache " << mFilename << llendl;
+		LLFile::remove(temp_filename);
+		discard();
+		return false;
+	}
+	mFile = LLFile::fopen(mFilename, "r+b");		/*Flawfinder: ignore*/
+	if (!mFile)
+	{
+		discard();
+		return false;
+	}
+
+	for (section_map_t::iterator it = mSections.begin(); it != mSections.end(); ++it)
+	{
+		it->second.mRecordOffset = new_offsets[it->first];
+	}
+	lldebugs << "Compacted inventory cache " << mFilename << " from " << mFileBytes
+			 << " to " << offset << " bytes." << llendl;
+	mFileBytes = offset;
+	mLiveBytes = offset - sizeof(header);
+	return true;
+}
+
+bool LLInventoryCache::createFile()
+{
+	close();
+	mSections.clear();
+	mLiveBytes = 0;
+	mFileBytes = 0;
+
+	mFile = LLFile::fopen(mFilename, "w+b");		/*Flawfinder: ignore*/
+	if (!mFile)
+	{
+		llwarns << "Unable to create inventory cache " << mFilename << llendl;
+		return false;
+	}
+
+	LLInvCacheFileHeader header;
+	memcpy(header.mMagic, INV_CACHE_MAGIC, sizeof(INV_CACHE_MAGIC));
+	header.mFormatVersion = INV_CACHE_FORMAT_VERSION;
+	header.mModelVersion = mModelVersion;
+	header.mReserved = 0;
+	if (fwrite(&header, sizeof(header), 1, mFile) != 1)
+	{
+		llwarns << "Unable to create inventory cache " << mFilename << llendl;
+		discard();
+		return false;
+	}
+	mFileBytes = sizeof(header);
+	return true;
+}
+
+bool LLInventoryCache::writeSection(const LLUUID& cat_id, S32 version,
+									const LLInventoryModel::item_array_t& items)
+{
+	LLSD item_list = LLSD::emptyArray();
+	uuid_vec_t item_ids;
+	item_ids.reserve(items.count());
+	for (LLInventoryModel::item_array_t::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		item_list.append((*it)->asLLSD());
+		item_ids.push_back((*it)->getUUID());
+	}
+	std::ostringstream ostr;
+	LLSDSerialize::toBinary(item_list, ostr);
+
+	Section section;
+	section.mVersion = version;
+	section.mItemIDs.swap(item_ids);
+	section.mPayloadSize = ostr.str().size();
+	if (!appendRecord(RECORD_SECTION, cat_id, version, section.mItemIDs, ostr.str(),
+					  section.mRecordOffset, section.mRecordSize))
+	{
+		return false;
+	}
+
+	section_map_t::iterator it = mSections.find(cat_id);
+	if (it != mSections.end())
+	{
+		mLiveBytes -= it->second.mRecordSize;
+	}
+	mLiveBytes += section.mRecordSize;
+	mSections[cat_id] = section;
+	return true;
+}
+
+bool LLInventoryCache::writeTombstone(const LLUUID& cat_id)
+{
+	S32 record_offset = 0;
+	S32 size = 0;
+	if (!appendRecord(RECORD_TOMBSTONE, cat_id, 0, uuid_vec_t(), std::string(),
+					  record_offset, size))
+	{
+		return false;
+	}
+	section_map_t::iterator it = mSections.find(cat_id);
+	if (it != mSections.end())
+	{
+		mLiveBytes -= it->second.mRecordSize;
+		mSections.erase(it);
+	}
+	return true;
+}
+
+bool LLInventoryCache::appendRecord(U32 type, const LLUUID& cat_id, S32 version,
+									const uuid_vec_t& item_ids, const std::string& payload,
+									S32& record_offset, S32& size)
+{
+	LLInvCacheRecordHeader record;
+	record.mType = type;
+	record.mVersion = version;
+	record.mItemCount = item_ids.size();
+	record.mPayloadSize = payload.size();
+	memcpy(record.mCategoryID, cat_id.mData, UUID_BYTES);
+
+	if (fseek(mFile, mFileBytes, SEEK_SET)
+		|| fwrite(&record, sizeof(record), 1, mFile) != 1
+		|| (!item_ids.empty()
+			&& fwrite(&item_ids[0], UUID_BYTES, item_ids.size(), mFile) != item_ids.size())
+		|| (!payload.empty()
+			&& fwrite(payload.data(), 1, payload.size(), mFile) != payload.size()))
+	{
+		return false;
+	}
+	record_offset = mFileBytes;
+	size = record_size(record.mItemCount, record.mPayloadSize);
+	mFileBytes += size;
+	return true;
+}
+
+void LLInventoryCache::discard()
+{
+	close();
+	LLFile::remove(mFilename);
+	mSections.clear();
+	mLiveBytes = 0;
+	mFileBytes = 0;
+}
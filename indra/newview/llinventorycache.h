@@ -0,0 +1,114 @@
+/**
+ * @file llinventorycache.h
+ * @brief LLInventoryCache class header file
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYCACHE_H
+#define LL_LLINVENTORYCACHE_H
+
+#include "llinventorymodel.h"
+#include "llrefcount.h"
+#include "lluuid.h"
+#include <map>
+#include <string>
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// LLInventoryCache
+//
+// Binary on-disk cache of inventory folder contents, one file per owner.
+//
+// The file is a header followed by a log of sections. Each section holds
+// the items of one folder, tagged with the folder version it was written
+// for. Saving never rewrites the file in place: a changed folder gets a new
+// section appended which supersedes the old one, and a folder that is no
+// longer cached gets a tombstone. Once superseded sections take up more
+// room than live ones the file is compacted.
+//
+// Opening the cache only reads the section headers and item ids, so the
+// inventory model can validate folder versions against the login skeleton
+// and map items to folders without parsing anything. The items of a
+// folder are only built when loadSection() is called for it.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLInventoryCache : public LLRefCount
+{
+protected:
+	~LLInventoryCache(); // ref counted
+public:
+	struct Section
+	{
+		Section() : mVersion(0), mRecordOffset(0), mRecordSize(0), mPayloadSize(0) {}
+		S32 mVersion;		// folder version the section was written for
+		S32 mRecordOffset;	// offset of the record header in the file
+		S32 mRecordSize;	// header, item ids and payload
+		S32 mPayloadSize;	// binary LLSD array of items
+		uuid_vec_t mItemIDs;
+	};
+	typedef std::map<LLUUID, Section> section_map_t;
+
+	LLInventoryCache(const std::string& filename, S32 model_version);
+
+	// Reads the section index. Returns false if there is no usable
+	// cache; a stale or damaged file is discarded.
+	bool open();
+	void close();
+
+	const std::string& getFilename() const { return mFilename; }
+	const section_map_t& getSections() const { return mSections; }
+	const Section* getSection(const LLUUID& cat_id) const;
+
+	// Parses the items cached for a folder and appends them to items.
+	bool loadSection(const LLUUID& cat_id, LLInventoryModel::item_array_t& items);
+
+	// Brings the cache in line with the given folders and items. Only
+	// folders whose version differs from their cached section are
+	// written. Cached folders not in the list are tombstoned.
+	bool save(const LLInventoryModel::cat_array_t& categories,
+			  const LLInventoryModel::item_array_t& items);
+
+	// Rewrites the file with only the live sections.
+	bool compact();
+
+	S32 getLiveBytes() const { return mLiveBytes; }
+	S32 getFileBytes() const { return mFileBytes; }
+
+private:
+	bool createFile();
+	bool writeSection(const LLUUID& cat_id, S32 version,
+					  const LLInventoryModel::item_array_t& items);
+	bool writeTombstone(const LLUUID& cat_id);
+	bool appendRecord(U32 type, const LLUUID& cat_id, S32 version,
+					  const uuid_vec_t& item_ids, const std::string& payload,
+					  S32& record_offset, S32& record_size);
+	void discard();
+
+private:
+	std::string mFilename;
+	S32 mModelVersion;
+	LLFILE* mFile;
+	section_map_t mSections;
+	S32 mLiveBytes;		// bytes held by sections in mSections
+	S32 mFileBytes;		// end of the last valid record
+};
+
+#endif // LL_LLINVENTORYCACHE_H
@@ -33,6 +33,7 @@
 #include "llfolderviewitem.h"
 #include "llinventorymodel.h"
 #include "llinventorymodelbackgroundfetch.h"
+#include "llinventorysearchindex.h"
 #include "llviewercontrol.h"
 #include "llfolderview.h"
 #include "llinventorybridge.h"
@@ -247,6 +248,21 @@ const std::string& LLInventoryFilter::getFilterSubString(BOOL trim) const
 	return mFilterSubString;
 }
 
+BOOL LLInventoryFilter::isFolderExcludedBySearch(const LLUUID& cat_id) const
+{
+	// Folders that pass regardless of the filter string can't be skipped,
+	// and neither can anything the index doesn't cover.
+	if (mFilterSubString.empty()
+		|| mFilterOps.mShowFolderState == LLInventoryFilter::SHOW_ALL_FOLDERS
+		|| !gInventory.getCategory(cat_id))
+	{
+		return FALSE;
+	}
+
+	const uuid_list_t* folders = LLInventorySearchIndex::instance().getFoldersWithMatches(mFilterSubString);
+	return folders && folders->find(cat_id) == folders->end();
+}
+
 std::string::size_type LLInventoryFilter::getStringMatchOffset() const
 {
 	return mSubStringMatchOffset;
@@ -111,6 +111,10 @@ public:
 	BOOL 				checkAgainstPermissions(const LLFolderViewItem* item) const;
 	BOOL 				checkAgainstFilterLinks(const LLFolderViewItem* item) const;
 
+	// True if the search index shows nothing in the folder can pass the
+	// filter string, so its contents don't need to be checked.
+	BOOL				isFolderExcludedBySearch(const LLUUID& cat_id) const;
+
 	std::string::size_type getStringMatchOffset() const;
 
 	// +-------------------------------------------------------------------+
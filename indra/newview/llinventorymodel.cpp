@@ -32,6 +32,7 @@
 #include "llappearancemgr.h"
 #include "llinventorypanel.h"
 #include "llinventorybridge.h"
+#include "llinventorycache.h"
 #include "llinventoryfunctions.h"
 #include "llinventoryobserver.h"
 #include "llinventorypanel.h"
@@ -63,6 +64,30 @@ BOOL LLInventoryModel::sFirstTimeInViewer2 = TRUE;
 
 //BOOL decompress_file(const char* src_filename, const char* dst_filename);
 const char CACHE_FORMAT_STRING[] = "%s.inv"; 
+const char BINARY_CACHE_FORMAT_STRING[] = "%s.invb";
+
+// get_ptr_in_map() for the hashed parent-child trees.
+template <typename K, typename T>
+inline T* get_ptr_in_map(const boost::unordered_map<K,T*>& inmap, const K& key)
+{
+	typedef typename boost::unordered_map<K,T*>::const_iterator map_iter;
+	map_iter iter = inmap.find(key);
+	if(iter == inmap.end())
+	{
+		return NULL;
+	}
+	return iter->second;
+}
+
+// Gives back the slack of an array that is not going to grow much.
+template <typename T>
+inline void trim_array(LLDynamicArray<T>* arrayp)
+{
+	if(arrayp->capacity() > arrayp->size())
+	{
+		std::vector<T>(arrayp->begin(), arrayp->end()).swap(*arrayp);
+	}
+}
 
 struct InventoryIDPtrLess
 {
@@ -72,6 +97,16 @@ struct InventoryIDPtrLess
 	}
 };
 
+// Id order, which children arrays kept while the model's maps were
+// ordered maps rather than hashed.
+struct InventoryObjectIDLess
+{
+	bool operator()(const LLInventoryObject* i1, const LLInventoryObject* i2) const
+	{
+		return (i1->getUUID() < i2->getUUID());
+	}
+};
+
 class LLCanCache : public LLInventoryCollectFunctor 
 {
 public:
@@ -97,12 +132,22 @@ bool LLCanCache::operator()(LLInventoryCategory* cat, LLInventoryItem* item)
 	{
 		// HACK: downcast
 		LLViewerInventoryCategory* c = (LLViewerInventoryCategory*)cat;
-		if(c->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		if(mModel->isCategoryPending(c->getUUID()))
+		{
+			// Never loaded, the cached copy is still good as long as
+			// the folder has not changed since.
+			if(mModel->isPendingCategoryCurrent(c))
+			{
+				mCachedCatIDs.insert(c->getUUID());
+				rv = true;
+			}
+		}
+		else if(c->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
 		{
 			S32 descendents_server = c->getDescendentCount();
 			LLInventoryModel::cat_array_t* cats;
 			LLInventoryModel::item_array_t* items;
-			mModel->getDirectDescendentsOf(
+			mModel->getLoadedDescendentsOf(
 				c->getUUID(),
 				cats,
 				items);
@@ -244,6 +289,15 @@ LLViewerInventoryItem* LLInventoryModel::getItem(const LLUUID& id) const
 	else
 	{
 		item_map_t::const_iterator iter = mItemMap.find(id);
+		if (iter == mItemMap.end() && !mPendingItems.empty())
+		{
+			pending_item_map_t::const_iterator pending_it = mPendingItems.find(id);
+			if (pending_it != mPendingItems.end())
+			{
+				loadPendingCategory(pending_it->second);
+				iter = mItemMap.find(id);
+			}
+		}
 		if (iter != mItemMap.end())
 		{
 			item = iter->second;
@@ -267,7 +321,7 @@ LLViewerInventoryCategory* LLInventoryModel::getCategory(const LLUUID& id) const
 
 S32 LLInventoryModel::getItemCount() const
 {
-	return mItemMap.size();
+	return mItemMap.size() + mPendingItems.size();
 }
 
 S32 LLInventoryModel::getCategoryCount() const
@@ -283,6 +337,15 @@ S32 LLInventoryModel::getCategoryCount() const
 void LLInventoryModel::getDirectDescendentsOf(const LLUUID& cat_id,
 											  cat_array_t*& categories,
 											  item_array_t*& items) const
+{
+	loadPendingCategory(cat_id);
+	categories = get_ptr_in_map(mParentChildCategoryTree, cat_id);
+	items = get_ptr_in_map(mParentChildItemTree, cat_id);
+}
+
+void LLInventoryModel::getLoadedDescendentsOf(const LLUUID& cat_id,
+											  cat_array_t*& categories,
+											  item_array_t*& items) const
 {
 	categories = get_ptr_in_map(mParentChildCategoryTree, cat_id);
 	items = get_ptr_in_map(mParentChildItemTree, cat_id);
@@ -317,7 +380,15 @@ void LLInventoryModel::lockDirectDescendentArrays(const LLUUID& cat_id,
 												  cat_array_t*& categories,
 												  item_array_t*& items)
 {
-	getDirectDescendentsOf(cat_id, categories, items);
+	loadPendingCategory(cat_id);
+	lockLoadedDescendentArrays(cat_id, categories, items);
+}
+
+void LLInventoryModel::lockLoadedDescendentArrays(const LLUUID& cat_id,
+												  cat_array_t*& categories,
+												  item_array_t*& items)
+{
+	getLoadedDescendentsOf(cat_id, categories, items);
 	if (categories)
 	{
 		mCategoryLock[cat_id] = true;
@@ -466,6 +537,26 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 											BOOL include_trash,
 											LLInventoryCollectFunctor& add,
 											BOOL follow_folder_links)
+{
+	collectDescendentsIf(id, cats, items, include_trash, add, follow_folder_links, true);
+}
+
+void LLInventoryModel::collectLoadedDescendentsIf(const LLUUID& id,
+												  cat_array_t& cats,
+												  item_array_t& items,
+												  BOOL include_trash,
+												  LLInventoryCollectFunctor& add)
+{
+	collectDescendentsIf(id, cats, items, include_trash, add, FALSE, false);
+}
+
+void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
+											cat_array_t& cats,
+											item_array_t& items,
+											BOOL include_trash,
+											LLInventoryCollectFunctor& add,
+											BOOL follow_folder_links,
+											bool load_pending)
 {
 	// Start with categories
 	if(!include_trash)
@@ -485,11 +576,15 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 			{
 				cats.put(cat);
 			}
-			collectDescendentsIf(cat->getUUID(), cats, items, include_trash, add);
+			collectDescendentsIf(cat->getUUID(), cats, items, include_trash, add, FALSE, load_pending);
 		}
 	}
 
 	LLViewerInventoryItem* item = NULL;
+	if(load_pending)
+	{
+		loadPendingCategory(id);
+	}
 	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
 
 	// Follow folder links recursively.  Currently never goes more
@@ -516,7 +611,7 @@ void LLInventoryModel::collectDescendentsIf(const LLUUID& id,
 						// outfit traversal.
 						cats.put(LLPointer<LLViewerInventoryCategory>(linked_cat));
 					}
-					collectDescendentsIf(linked_cat->getUUID(), cats, items, include_trash, add, FALSE);
+					collectDescendentsIf(linked_cat->getUUID(), cats, items, include_trash, add, FALSE, load_pending);
 				}
 			}
 		}
@@ -546,11 +641,12 @@ void LLInventoryModel::addChangedMaskForLinks(const LLUUID& object_id, U32 mask)
 	LLInventoryModel::cat_array_t cat_array;
 	LLInventoryModel::item_array_t item_array;
 	LLLinkedItemIDMatches is_linked_item_match(object_id);
-	collectDescendentsIf(gInventory.getRootFolderID(),
-						 cat_array,
-						 item_array,
-						 LLInventoryModel::INCLUDE_TRASH,
-						 is_linked_item_match);
+	// Links still in the inventory cache pick the change up when loaded.
+	collectLoadedDescendentsIf(gInventory.getRootFolderID(),
+							   cat_array,
+							   item_array,
+							   LLInventoryModel::INCLUDE_TRASH,
+							   is_linked_item_match);
 	if (cat_array.empty() && item_array.empty())
 	{
 		return;
@@ -643,6 +739,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 		if(old_parent_id != new_parent_id)
 		{
 			// need to update the parent-child tree
+			loadPendingCategory(new_parent_id);
 			item_array_t* item_array;
 			item_array = get_ptr_in_map(mParentChildItemTree, old_parent_id);
 			if(item_array)
@@ -673,6 +770,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 		{
 			const LLUUID category_id = findCategoryUUIDForType(LLFolderType::assetTypeToFolderType(new_item->getType()));
 			new_item->setParent(category_id);
+			loadPendingCategory(category_id);
 			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, category_id);
 			if( item_array )
 			{
@@ -698,6 +796,7 @@ U32 LLInventoryModel::updateItem(const LLViewerInventoryItem* item)
 				parent_id = findCategoryUUIDForType(LLFolderType::FT_LOST_AND_FOUND);
 				new_item->setParent(parent_id);
 			}
+			loadPendingCategory(parent_id);
 			item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, parent_id);
 			if(item_array)
 			{
@@ -775,6 +874,7 @@ LLInventoryModel::cat_array_t* LLInventoryModel::getUnlockedCatArray(const LLUUI
 
 LLInventoryModel::item_array_t* LLInventoryModel::getUnlockedItemArray(const LLUUID& id)
 {
+	loadPendingCategory(id);
 	item_array_t* item_array = get_ptr_in_map(mParentChildItemTree, id);
 	if (item_array)
 	{
@@ -802,6 +902,7 @@ void LLInventoryModel::updateCategory(const LLViewerInventoryCategory* cat)
 	if(old_cat)
 	{
 		// We already have an old category, modify it's values
+		loadPendingCategory(cat->getUUID());
 		U32 mask = LLInventoryObserver::NONE;
 		LLUUID old_parent_id = old_cat->getParentUUID();
 		LLUUID new_parent_id = cat->getParentUUID();
@@ -863,7 +964,7 @@ void LLInventoryModel::moveObject(const LLUUID& object_id, const LLUUID& cat_id)
 		return;
 	}
 
-	if((object_id == cat_id) || !is_in_map(mCategoryMap, cat_id))
+	if((object_id == cat_id) || (mCategoryMap.find(cat_id) == mCategoryMap.end()))
 	{
 		llwarns << "Could not move inventory object " << object_id << " to "
 				<< cat_id << llendl;
@@ -1055,7 +1156,7 @@ BOOL LLInventoryModel::containsObserver(LLInventoryObserver* observer) const
 
 void LLInventoryModel::idleNotifyObservers()
 {
-	if (mModifyMask == LLInventoryObserver::NONE && (mChangedItemIDs.size() == 0))
+	if (mModifyMask == LLInventoryObserver::NONE && (mChangedItemIDs.size() == 0) && mLoadedItemIDs.empty())
 	{
 		return;
 	}
@@ -1075,6 +1176,14 @@ void LLInventoryModel::notifyObservers(const std::string service_name)
 		return;
 	}
 
+	if (!mLoadedItemIDs.empty())
+	{
+		// Items read from the inventory cache since the last update.
+		mModifyMask |= LLInventoryObserver::ADD;
+		mChangedItemIDs.insert(mLoadedItemIDs.begin(), mLoadedItemIDs.end());
+		mLoadedItemIDs.clear();
+	}
+
 	mIsNotifyObservers = TRUE;
 	for (observer_list_t::iterator iter = mObservers.begin();
 		 iter != mObservers.end(); )
@@ -1224,6 +1333,7 @@ bool LLInventoryModel::fetchDescendentsOf(const LLUUID& folder_id) const
 	//{
 	//	known_descendents += items->count();
 	//}
+	loadPendingCategory(folder_id);
 	return cat->fetch();
 }
 
@@ -1240,8 +1350,10 @@ void LLInventoryModel::cache(
 	item_array_t items;
 
 	LLCanCache can_cache(this);
+	// Folders that were never opened are still good in the binary
+	// cache, don't load them just to write them back.
 	can_cache(root_cat, NULL);
-	collectDescendentsIf(
+	collectLoadedDescendentsIf(
 		parent_folder_id,
 		categories,
 		items,
@@ -1252,9 +1364,38 @@ void LLInventoryModel::cache(
 	agent_id.toString(agent_id_str);
 	std::string path(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, agent_id_str));
 	inventory_filename = llformat(CACHE_FORMAT_STRING, path.c_str());
-	saveToFile(inventory_filename, categories, items);
 	std::string gzip_filename(inventory_filename);
 	gzip_filename.append(".gz");
+
+	LLPointer<LLInventoryCache>& inv_cache = mInventoryCaches[agent_id];
+	if(inv_cache.isNull())
+	{
+		inv_cache = new LLInventoryCache(llformat(BINARY_CACHE_FORMAT_STRING, path.c_str()),
+										 sCurrentInvCacheVersion);
+		inv_cache->open();
+	}
+	if(inv_cache->save(categories, items))
+	{
+		// The text cache is only read when there is no binary one.
+		LLFile::remove(gzip_filename);
+		return;
+	}
+
+	// Fall back to the text cache. Folders that were never loaded only
+	// have their items in the binary cache, read them back from there
+	// and leave out any folder whose items can't be read.
+	cat_array_t text_categories;
+	for(cat_array_t::const_iterator it = categories.begin(); it != categories.end(); ++it)
+	{
+		LLViewerInventoryCategory* cat = (*it);
+		inventory_cache_map_t::iterator pending_it = mPendingCategories.find(cat->getUUID());
+		if((pending_it == mPendingCategories.end())
+		   || pending_it->second->loadSection(cat->getUUID(), items))
+		{
+			text_categories.put(cat);
+		}
+	}
+	saveToFile(inventory_filename, text_categories, items);
 	if(gzip_file(inventory_filename, gzip_filename))
 	{
 		lldebugs << "Successfully compressed " << inventory_filename << llendl;
@@ -1281,18 +1422,27 @@ void LLInventoryModel::addCategory(LLViewerInventoryCategory* category)
 	}
 }
 
+// This can happen if assettype enums from llassettype.h ever change.
+// For example, there is a known backwards compatibility issue in some viewer prototypes prior to when 
+// the AT_LINK enum changed from 23 to 24.
+static bool has_valid_asset_type(const LLViewerInventoryItem* item)
+{
+	if ((item->getType() == LLAssetType::AT_NONE)
+		|| LLAssetType::lookup(item->getType()) == LLAssetType::badLookup())
+	{
+		llwarns << "Got bad asset type for item [ name: " << item->getName() << " type: " << item->getType() << " inv-type: " << item->getInventoryType() << " ], ignoring." << llendl;
+		return false;
+	}
+	return true;
+}
+
 void LLInventoryModel::addItem(LLViewerInventoryItem* item)
 {
 	llassert(item);
 	if(item)
 	{
-		// This can happen if assettype enums from llassettype.h ever change.
-		// For example, there is a known backwards compatibility issue in some viewer prototypes prior to when 
-		// the AT_LINK enum changed from 23 to 24.
-		if ((item->getType() == LLAssetType::AT_NONE)
-		    || LLAssetType::lookup(item->getType()) == LLAssetType::badLookup())
+		if (!has_valid_asset_type(item))
 		{
-			llwarns << "Got bad asset type for item [ name: " << item->getName() << " type: " << item->getType() << " inv-type: " << item->getInventoryType() << " ], ignoring." << llendl;
 			return;
 		}
 
@@ -1324,6 +1474,10 @@ void LLInventoryModel::empty()
 	mCategoryMap.clear(); // remove all references (should delete entries)
 	mItemMap.clear(); // remove all references (should delete entries)
 	mLastItem = NULL;
+	mPendingCategories.clear();
+	mPendingItems.clear();
+	mLoadedItemIDs.clear();
+	mInventoryCaches.clear();
 	//mInventory.clear();
 }
 
@@ -1555,7 +1709,47 @@ bool LLInventoryModel::loadSkeleton(
 		const S32 NO_VERSION = LLViewerInventoryCategory::VERSION_UNKNOWN;
 		std::string gzip_filename(inventory_filename);
 		gzip_filename.append(".gz");
-		LLFILE* fp = LLFile::fopen(gzip_filename, "rb");
+
+		LLPointer<LLInventoryCache> inv_cache = new LLInventoryCache(llformat(BINARY_CACHE_FORMAT_STRING, path.c_str()),
+																	 sCurrentInvCacheVersion);
+		LLFILE* fp = NULL;
+		if(inv_cache->open())
+		{
+			// Only the section index has been read. Folders whose version
+			// still matches the skeleton keep their items in the cache
+			// until something asks for them.
+			mInventoryCaches[owner_id] = inv_cache;
+			for(cat_set_t::iterator it = temp_cats.begin(); it != temp_cats.end(); ++it)
+			{
+				LLViewerInventoryCategory* cat = (*it);
+				const LLUUID& cat_id = cat->getUUID();
+				const LLInventoryCache::Section* section = inv_cache->getSection(cat_id);
+				if(section && (section->mVersion == cat->getVersion()))
+				{
+					mPendingCategories[cat_id] = inv_cache;
+					for(uuid_vec_t::const_iterator item_it = section->mItemIDs.begin();
+						item_it != section->mItemIDs.end();
+						++item_it)
+					{
+						mPendingItems[*item_it] = cat_id;
+					}
+					child_counts[cat_id].mValue += section->mItemIDs.size();
+					cached_item_count += section->mItemIDs.size();
+					++cached_category_count;
+				}
+				else
+				{
+					cat->setVersion(NO_VERSION);
+				}
+				addCategory(cat);
+				++child_counts[cat->getParentUUID()];
+			}
+		}
+		else
+		{
+			inv_cache = NULL;
+			fp = LLFile::fopen(gzip_filename, "rb");
+		}
 		bool remove_inventory_file = false;
 		if(fp)
 		{
@@ -1574,7 +1768,11 @@ bool LLInventoryModel::loadSkeleton(
 			}
 		}
 		bool is_cache_obsolete = false;
-		if(loadFromFile(inventory_filename, categories, items, is_cache_obsolete))
+		if(inv_cache.notNull())
+		{
+			// Handled above.
+		}
+		else if(loadFromFile(inventory_filename, categories, items, is_cache_obsolete))
 		{
 			// We were able to find a cache of files. So, use what we
 			// found to generate a set of categories we should add. We
@@ -1735,6 +1933,96 @@ bool LLInventoryModel::loadSkeleton(
 	return rv;
 }
 
+bool LLInventoryModel::isCategoryPending(const LLUUID& cat_id) const
+{
+	return mPendingCategories.find(cat_id) != mPendingCategories.end();
+}
+
+bool LLInventoryModel::isPendingCategoryCurrent(const LLViewerInventoryCategory* cat) const
+{
+	inventory_cache_map_t::const_iterator pending_it = mPendingCategories.find(cat->getUUID());
+	if(pending_it == mPendingCategories.end())
+	{
+		return false;
+	}
+	const LLInventoryCache::Section* section = pending_it->second->getSection(cat->getUUID());
+	return section
+		&& (cat->getVersion() != LLViewerInventoryCategory::VERSION_UNKNOWN)
+		&& (section->mVersion == cat->getVersion());
+}
+
+void LLInventoryModel::loadPendingCategory(const LLUUID& cat_id) const
+{
+	if(mPendingCategories.empty())
+	{
+		return;
+	}
+	inventory_cache_map_t::iterator pending_it = mPendingCategories.find(cat_id);
+	if(pending_it == mPendingCategories.end())
+	{
+		return;
+	}
+
+	// Take the folder off the pending lists first, checking links
+	// below may load other folders.
+	LLPointer<LLInventoryCache> inv_cache = pending_it->second;
+	mPendingCategories.erase(pending_it);
+	const LLInventoryCache::Section* section = inv_cache->getSection(cat_id);
+	if(section)
+	{
+		for(uuid_vec_t::const_iterator it = section->mItemIDs.begin();
+			it != section->mItemIDs.end();
+			++it)
+		{
+			mPendingItems.erase(*it);
+		}
+	}
+
+	LLViewerInventoryCategory* cat = getCategory(cat_id);
+	item_array_t items;
+	if(!cat || !inv_cache->loadSection(cat_id, items))
+	{
+		if(cat)
+		{
+			cat->setVersion(LLViewerInventoryCategory::VERSION_UNKNOWN);
+		}
+		return;
+	}
+
+	item_array_t* itemsp = get_ptr_in_map(mParentChildItemTree, cat_id);
+	S32 bad_link_count = 0;
+	for(item_array_t::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		LLViewerInventoryItem* item = (*it);
+		// This can happen if the linked object's baseobj is removed from the cache but the linked object is still in the cache.
+		if(item->getIsBrokenLink())
+		{
+			++bad_link_count;
+			continue;
+		}
+		// As addItem(), which const accessors can't call
+		if(!has_valid_asset_type(item))
+		{
+			continue;
+		}
+		mItemMap[item->getUUID()] = item;
+		// Before buildParentChildMap() there are no arrays yet, it
+		// will pick the item up from the item map.
+		if(itemsp)
+		{
+			itemsp->put(item);
+			mLoadedItemIDs.insert(item->getUUID());
+		}
+	}
+	if(bad_link_count > 0)
+	{
+		llinfos << "Attempted to add " << bad_link_count
+				<< " cached link items without baseobj present. Invalidating "
+				<< cat->getName() << llendl;
+		cat->setVersion(LLViewerInventoryCategory::VERSION_UNKNOWN);
+	}
+}
+
 // This is a brute force method to rebuild the entire parent-child
 // relations. The overall operation has O(NlogN) performance, which
 // should be sufficient for our needs. 
@@ -1772,6 +2060,10 @@ void LLInventoryModel::buildParentChildMap()
 		}
 	}
 
+	// Callers such as findCategoryUUIDForType() take the first match
+	// among children, keep children in id order as before
+	std::sort(cats.begin(), cats.end(), InventoryObjectIDLess());
+
 	// Insert a special parent for the root - so that lookups on
 	// LLUUID::null as the parent work correctly. This is kind of a
 	// blatent wastes of space since we allocate a block of memory for
@@ -1856,6 +2148,7 @@ void LLInventoryModel::buildParentChildMap()
 			item = (*iit).second;
 			items.put(item);
 		}
+		std::sort(items.begin(), items.end(), InventoryObjectIDLess());
 	}
 	count = items.count();
 	lost = 0;
@@ -1892,6 +2185,21 @@ void LLInventoryModel::buildParentChildMap()
 			}
 		}
 	}
+	// Every array starts out with room for 32 entries, while most
+	// folders hold a few items and no subfolders at all.
+	for(parent_cat_map_t::iterator it = mParentChildCategoryTree.begin();
+		it != mParentChildCategoryTree.end();
+		++it)
+	{
+		trim_array(it->second);
+	}
+	for(parent_item_map_t::iterator it = mParentChildItemTree.begin();
+		it != mParentChildItemTree.end();
+		++it)
+	{
+		trim_array(it->second);
+	}
+
 	if(lost)
 	{
 		llwarns << "Found " << lost << " lost items." << llendl;
@@ -1936,10 +2244,18 @@ void LLInventoryModel::buildParentChildMap()
 			
 			std::string name = "My Inventory";
 			LLUUID prev_root_id = mRootFolderID;
+			// The last match wins, walk the parents in id order as before
+			uuid_vec_t parent_ids;
+			parent_ids.reserve(mParentChildCategoryTree.size());
 			for (parent_cat_map_t::const_iterator it = mParentChildCategoryTree.begin(),
 					 it_end = mParentChildCategoryTree.end(); it != it_end; ++it)
 			{
-				cat_array_t* cat_array = it->second;
+				parent_ids.push_back(it->first);
+			}
+			std::sort(parent_ids.begin(), parent_ids.end());
+			for (uuid_vec_t::const_iterator it = parent_ids.begin(); it != parent_ids.end(); ++it)
+			{
+				cat_array_t* cat_array = mParentChildCategoryTree[*it];
 				for (cat_array_t::const_iterator cat_it = cat_array->begin(),
 						 cat_it_end = cat_array->end(); cat_it != cat_it_end; ++cat_it)
 					{
@@ -36,6 +36,7 @@
 #include "llpermissionsflags.h"
 #include "llstring.h"
 #include "llmd5.h"
+#include <boost/unordered_map.hpp>
 #include <map>
 #include <set>
 #include <string>
@@ -51,6 +52,7 @@ class LLViewerInventoryItem;
 class LLViewerInventoryCategory;
 class LLMessageSystem;
 class LLInventoryCollectFunctor;
+class LLInventoryCache;
 
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -145,16 +147,52 @@ private:
 	// the inventory using several different identifiers.
 	// mInventory member data is the 'master' list of inventory, and
 	// mCategoryMap and mItemMap store uuid->object mappings. 
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryCategory> > cat_map_t;
-	typedef std::map<LLUUID, LLPointer<LLViewerInventoryItem> > item_map_t;
+	// These are hashed rather than ordered as they hold 100k+ entries for
+	// large inventories. Iterating them gives no particular order,
+	// buildParentChildMap() sorts where the order shows.
+	typedef boost::unordered_map<LLUUID, LLPointer<LLViewerInventoryCategory> > cat_map_t;
+	typedef boost::unordered_map<LLUUID, LLPointer<LLViewerInventoryItem> > item_map_t;
 	cat_map_t mCategoryMap;
-	item_map_t mItemMap;
+	// Filled in from the inventory cache as folders are first accessed,
+	// through const accessors too, see loadPendingCategory().
+	mutable item_map_t mItemMap;
 	// This last set of indices is used to map parents to children.
-	typedef std::map<LLUUID, cat_array_t*> parent_cat_map_t;
-	typedef std::map<LLUUID, item_array_t*> parent_item_map_t;
+	typedef boost::unordered_map<LLUUID, cat_array_t*> parent_cat_map_t;
+	typedef boost::unordered_map<LLUUID, item_array_t*> parent_item_map_t;
 	parent_cat_map_t mParentChildCategoryTree;
 	parent_item_map_t mParentChildItemTree;
 
+	//--------------------------------------------------------------------
+	// Cached Folders
+	//--------------------------------------------------------------------
+public:
+	// True if the folder's items are still only in the inventory cache.
+	bool isCategoryPending(const LLUUID& cat_id) const;
+	// True if the folder is pending and its cached items are for the
+	// version the folder has now.
+	bool isPendingCategoryCurrent(const LLViewerInventoryCategory* cat) const;
+	// Cached folders not loaded yet. Drops as folders load.
+	S32 getPendingCategoryCount() const { return (S32)mPendingCategories.size(); }
+private:
+	// Moves the items of a cached folder into the model. Called when the
+	// folder is fetched or changed, or one of its items is asked for.
+	// Only touches the mutable lazily loaded state.
+	void loadPendingCategory(const LLUUID& cat_id) const;
+
+	// Binary inventory caches by owner id, kept open for the session.
+	// Pending folders hold a reference too, so a cache replaced by a
+	// later login stays around until its folders are loaded.
+	typedef std::map<LLUUID, LLPointer<LLInventoryCache> > inventory_cache_map_t;
+	inventory_cache_map_t mInventoryCaches;
+	// Cached folders that have not been loaded yet, and the folder of
+	// each of their items.
+	mutable inventory_cache_map_t mPendingCategories;
+	typedef boost::unordered_map<LLUUID, LLUUID> pending_item_map_t;
+	mutable pending_item_map_t mPendingItems;
+	// Items loaded since observers were last notified, sent as added so
+	// that views get built for them.
+	mutable changed_items_t mLoadedItemIDs;
+
 	//--------------------------------------------------------------------
 	// Login
 	//--------------------------------------------------------------------
@@ -189,6 +227,11 @@ public:
 	void getDirectDescendentsOf(const LLUUID& cat_id,
 								cat_array_t*& categories,
 								item_array_t*& items) const;
+	// The same without loading a folder that is still only in the
+	// inventory cache, whose items are then missing.
+	void getLoadedDescendentsOf(const LLUUID& cat_id,
+								cat_array_t*& categories,
+								item_array_t*& items) const;
 
 	// Compute a hash of direct descendent names (for detecting child name changes)
 	LLMD5 hashDirectDescendentNames(const LLUUID& cat_id) const;
@@ -213,6 +256,23 @@ public:
 							  BOOL include_trash,
 							  LLInventoryCollectFunctor& add,
 							  BOOL follow_folder_links = FALSE);
+	// The same without loading folders that are still only in the
+	// inventory cache. Use it to look for folders, or for items that
+	// only matter once their folder has been opened.
+	void collectLoadedDescendentsIf(const LLUUID& id,
+									cat_array_t& categories,
+									item_array_t& items,
+									BOOL include_trash,
+									LLInventoryCollectFunctor& add);
+private:
+	void collectDescendentsIf(const LLUUID& id,
+							  cat_array_t& categories,
+							  item_array_t& items,
+							  BOOL include_trash,
+							  LLInventoryCollectFunctor& add,
+							  BOOL follow_folder_links,
+							  bool load_pending);
+public:
 
 	// Collect all items in inventory that are linked to item_id.
 	// Assumes item_id is itself not a linked item.
@@ -511,13 +571,19 @@ public:
 	void lockDirectDescendentArrays(const LLUUID& cat_id,
 									cat_array_t*& categories,
 									item_array_t*& items);
+	// As getLoadedDescendentsOf(), the folder is not loaded from the
+	// inventory cache.
+	void lockLoadedDescendentArrays(const LLUUID& cat_id,
+									cat_array_t*& categories,
+									item_array_t*& items);
 	void unlockDirectDescendentArrays(const LLUUID& cat_id);
 protected:
 	cat_array_t* getUnlockedCatArray(const LLUUID& id);
 	item_array_t* getUnlockedItemArray(const LLUUID& id);
 private:
-	std::map<LLUUID, bool> mCategoryLock;
-	std::map<LLUUID, bool> mItemLock;
+	typedef boost::unordered_map<LLUUID, bool> lock_map_t;
+	lock_map_t mCategoryLock;
+	lock_map_t mItemLock;
 	
 	//--------------------------------------------------------------------
 	// Debugging
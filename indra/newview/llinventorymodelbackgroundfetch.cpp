@@ -264,7 +264,7 @@ void LLInventoryModelBackgroundFetch::backgroundFetch()
 				// Add all children to queue.
 				LLInventoryModel::cat_array_t* categories;
 				LLInventoryModel::item_array_t* items;
-				gInventory.getDirectDescendentsOf(cat->getUUID(), categories, items);
+				gInventory.getLoadedDescendentsOf(cat->getUUID(), categories, items);
 				for (LLInventoryModel::cat_array_t::const_iterator it = categories->begin();
 					 it != categories->end();
 					 ++it)
@@ -578,7 +578,7 @@ void LLInventoryModelBackgroundFetch::bulkFetch(std::string url)
 			    {	
 					LLInventoryModel::cat_array_t* categories;
 					LLInventoryModel::item_array_t* items;
-					gInventory.getDirectDescendentsOf(cat->getUUID(), categories, items);
+					gInventory.getLoadedDescendentsOf(cat->getUUID(), categories, items);
 					for (LLInventoryModel::cat_array_t::const_iterator it = categories->begin();
 						 it != categories->end();
 						 ++it)
@@ -603,7 +603,9 @@ void LLInventoryPanel::buildNewViews(const LLUUID& id)
 	{
 		LLViewerInventoryCategory::cat_array_t* categories;
 		LLViewerInventoryItem::item_array_t* items;
-		mInventory->lockDirectDescendentArrays(id, categories, items);
+		// Folders still in the inventory cache get their item views
+		// once they are opened and loaded.
+		mInventory->lockLoadedDescendentArrays(id, categories, items);
 		
 		if(categories)
 		{
@@ -0,0 +1,454 @@
+/**
+ * @file llinventorysearchindex.cpp
+ * @brief Implementation of the inventory name search index.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+#include "llinventorysearchindex.h"
+
+#include "llinventorymodel.h"
+#include "llinventoryobserver.h"
+#include "lltrans.h"
+#include "llviewerinventory.h"
+
+static LLFastTimer::DeclareTimer FTM_SEARCH_INDEX_BUILD("Inventory Search Index Build");
+
+// Postings are only rewritten once at least this many are stale.
+const S32 MIN_STALE_POSTINGS = 4096;
+
+static inline U32 trigram_key(const std::string& text, size_t pos)
+{
+	return ((U32)(U8)text[pos] << 16) | ((U32)(U8)text[pos + 1] << 8) | (U32)(U8)text[pos + 2];
+}
+
+static inline S32 trigram_count(const std::string& text)
+{
+	return text.size() < 3 ? 0 : (S32)text.size() - 2;
+}
+
+// Owned by gInventory once added, which deletes its observers on shutdown.
+class LLSearchIndexObserver : public LLInventoryObserver
+{
+public:
+	/*virtual*/ void changed(U32 mask)
+	{
+		if (LLInventorySearchIndex::instanceExists())
+		{
+			LLInventorySearchIndex::instance().changed(mask);
+		}
+	}
+};
+
+LLInventorySearchIndex::LLInventorySearchIndex() :
+	mLivePostings(0),
+	mStalePostings(0),
+	mBuilt(false),
+	mRevision(0),
+	mPendingCategoryCount(0),
+	mCachedRevision(0)
+{
+	gInventory.addObserver(new LLSearchIndexObserver());
+}
+
+LLInventorySearchIndex::~LLInventorySearchIndex()
+{
+}
+
+void LLInventorySearchIndex::changed(U32 mask)
+{
+	if (!mBuilt)
+	{
+		// Nothing to keep up to date, the index is built on first lookup.
+		return;
+	}
+
+	const U32 relevant = LLInventoryObserver::LABEL | LLInventoryObserver::ADD |
+		LLInventoryObserver::REMOVE | LLInventoryObserver::STRUCTURE | LLInventoryObserver::REBUILD;
+	if (!(mask & relevant))
+	{
+		return;
+	}
+
+	const LLInventoryModel::changed_items_t& changed_items = gInventory.getChangedIDs();
+	if (changed_items.empty())
+	{
+		// Bulk change without ids, start over on the next lookup.
+		mBuilt = false;
+		return;
+	}
+
+	for (LLInventoryModel::changed_items_t::const_iterator iter = changed_items.begin();
+		 iter != changed_items.end();
+		 ++iter)
+	{
+		const LLUUID& id = *iter;
+		const LLViewerInventoryCategory* cat = gInventory.getCategory(id);
+		if (cat)
+		{
+			updateObject(cat, true);
+			continue;
+		}
+		const LLViewerInventoryItem* item = gInventory.getItem(id);
+		if (item)
+		{
+			updateObject(item, false);
+		}
+		else
+		{
+			removeObject(id);
+		}
+	}
+
+	// Moves don't change any name but do change which folders hold a match.
+	if (mask & LLInventoryObserver::STRUCTURE)
+	{
+		++mRevision;
+	}
+}
+
+bool LLInventorySearchIndex::findMatches(const std::string& substring, uuid_vec_t& matches)
+{
+	if (!mBuilt && !build())
+	{
+		return false;
+	}
+	indexLoadedFolders();
+	if (substring.empty())
+	{
+		return true;
+	}
+
+	if (substring.size() < 3)
+	{
+		// Too short for a trigram, these match a large share of the
+		// inventory anyway.
+		for (std::vector<Entry>::const_iterator iter = mEntries.begin();
+			 iter != mEntries.end();
+			 ++iter)
+		{
+			if (!iter->mText.empty() && iter->mText.find(substring) != std::string::npos)
+			{
+				matches.push_back(iter->mID);
+			}
+		}
+		return true;
+	}
+
+	// Every match contains all of the substring's trigrams, so walk the
+	// shortest posting list and check each candidate.
+	const posting_list_t* shortest = NULL;
+	for (size_t pos = 0; pos + 3 <= substring.size(); ++pos)
+	{
+		posting_map_t::const_iterator found = mPostings.find(trigram_key(substring, pos));
+		if (found == mPostings.end())
+		{
+			return true;
+		}
+		if (!shortest || found->second.size() < shortest->size())
+		{
+			shortest = &found->second;
+		}
+	}
+
+	// Postings can repeat a slot after a rename, only report it once.
+	std::vector<bool> seen(mEntries.size(), false);
+	for (posting_list_t::const_iterator iter = shortest->begin();
+		 iter != shortest->end();
+		 ++iter)
+	{
+		const S32 slot = *iter;
+		if (seen[slot])
+		{
+			continue;
+		}
+		seen[slot] = true;
+		const Entry& entry = mEntries[slot];
+		if (!entry.mText.empty() && entry.mText.find(substring) != std::string::npos)
+		{
+			matches.push_back(entry.mID);
+		}
+	}
+	return true;
+}
+
+const uuid_list_t* LLInventorySearchIndex::getFoldersWithMatches(const std::string& substring)
+{
+	if (!mBuilt && !build())
+	{
+		return NULL;
+	}
+	indexLoadedFolders();
+	if (mCachedRevision == mRevision && mCachedSubString == substring)
+	{
+		return &mCachedFolders;
+	}
+
+	uuid_vec_t matches;
+	findMatches(substring, matches);
+
+	mCachedFolders.clear();
+	for (uuid_vec_t::const_iterator iter = matches.begin();
+		 iter != matches.end();
+		 ++iter)
+	{
+		const LLInventoryObject* obj = gInventory.getObject(*iter);
+		if (!obj)
+		{
+			continue;
+		}
+		addFolderAndParents((obj->getType() == LLAssetType::AT_CATEGORY) ? obj->getUUID() : obj->getParentUUID());
+	}
+	// Anything may be in the folders not indexed yet
+	for (uuid_list_t::const_iterator iter = mPendingFolders.begin();
+		 iter != mPendingFolders.end();
+		 ++iter)
+	{
+		addFolderAndParents(*iter);
+	}
+
+	mCachedSubString = substring;
+	mCachedRevision = mRevision;
+	return &mCachedFolders;
+}
+
+void LLInventorySearchIndex::addFolderAndParents(LLUUID cat_id)
+{
+	// Stop as soon as we reach a folder another match already added.
+	while (cat_id.notNull() && mCachedFolders.insert(cat_id).second)
+	{
+		const LLViewerInventoryCategory* cat = gInventory.getCategory(cat_id);
+		if (!cat)
+		{
+			break;
+		}
+		cat_id = cat->getParentUUID();
+	}
+}
+
+bool LLInventorySearchIndex::build()
+{
+	if (!gInventory.isInventoryUsable())
+	{
+		return false;
+	}
+	LLFastTimer t(FTM_SEARCH_INDEX_BUILD);
+
+	mEntries.clear();
+	mFreeSlots.clear();
+	mSlots.clear();
+	mPostings.clear();
+	mLivePostings = 0;
+	mStalePostings = 0;
+
+	mPendingFolders.clear();
+	mPendingCategoryCount = gInventory.getPendingCategoryCount();
+
+	// Walks the tree rather than collecting descendents, which would load
+	// every folder still only in the inventory cache.
+	uuid_vec_t folders;
+	folders.push_back(gInventory.getRootFolderID());
+	folders.push_back(gInventory.getLibraryRootFolderID());
+	while (!folders.empty())
+	{
+		LLUUID cat_id = folders.back();
+		folders.pop_back();
+		const LLViewerInventoryCategory* cat = gInventory.getCategory(cat_id);
+		if (!cat)
+		{
+			continue;
+		}
+		updateObject(cat, true);
+
+		LLInventoryModel::cat_array_t* cats;
+		LLInventoryModel::item_array_t* items;
+		gInventory.getLoadedDescendentsOf(cat_id, cats, items);
+		if (cats)
+		{
+			for (LLInventoryModel::cat_array_t::const_iterator iter = cats->begin();
+				 iter != cats->end();
+				 ++iter)
+			{
+				folders.push_back((*iter)->getUUID());
+			}
+		}
+		if (gInventory.isCategoryPending(cat_id))
+		{
+			mPendingFolders.insert(cat_id);
+		}
+		else if (items)
+		{
+			for (LLInventoryModel::item_array_t::const_iterator iter = items->begin();
+				 iter != items->end();
+				 ++iter)
+			{
+				updateObject(*iter, false);
+			}
+		}
+	}
+
+	llinfos << "Indexed " << mSlots.size() << " inventory names" << llendl;
+	mBuilt = true;
+	++mRevision;
+	return true;
+}
+
+void LLInventorySearchIndex::indexLoadedFolders()
+{
+	// Only look for loaded folders when the model loaded any
+	S32 pending_count = gInventory.getPendingCategoryCount();
+	if (pending_count == mPendingCategoryCount)
+	{
+		return;
+	}
+	mPendingCategoryCount = pending_count;
+
+	for (uuid_list_t::iterator iter = mPendingFolders.begin(); iter != mPendingFolders.end(); )
+	{
+		uuid_list_t::iterator cur = iter++;
+		if (gInventory.isCategoryPending(*cur))
+		{
+			continue;
+		}
+		LLInventoryModel::cat_array_t* cats;
+		LLInventoryModel::item_array_t* items;
+		gInventory.getLoadedDescendentsOf(*cur, cats, items);
+		if (items)
+		{
+			for (LLInventoryModel::item_array_t::const_iterator item_iter = items->begin();
+				 item_iter != items->end();
+				 ++item_iter)
+			{
+				updateObject(*item_iter, false);
+			}
+		}
+		mPendingFolders.erase(cur);
+		++mRevision;
+	}
+}
+
+void LLInventorySearchIndex::updateObject(const LLInventoryObject* obj, bool is_category)
+{
+	// Match the label the folder view shows, see LLFolderViewItem::refreshFromListener().
+	std::string text = obj->getName();
+	if (is_category)
+	{
+		const LLViewerInventoryCategory* cat = static_cast<const LLViewerInventoryCategory*>(obj);
+		std::string translated;
+		if ((text == "Accessories" || LLFolderType::lookupIsProtectedType(cat->getPreferredType()))
+			&& LLTrans::findString(translated, "InvFolder " + text))
+		{
+			// Keep both names, the filter never contains a line break.
+			text.append("\n");
+			text.append(translated);
+		}
+	}
+	LLStringUtil::toUpper(text);
+
+	S32 slot;
+	slot_map_t::iterator found = mSlots.find(obj->getUUID());
+	if (found != mSlots.end())
+	{
+		slot = found->second;
+		Entry& entry = mEntries[slot];
+		if (entry.mText == text)
+		{
+			return;
+		}
+		mStalePostings += trigram_count(entry.mText);
+		mLivePostings -= trigram_count(entry.mText);
+	}
+	else
+	{
+		if (!mFreeSlots.empty())
+		{
+			slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+		}
+		else
+		{
+			slot = (S32)mEntries.size();
+			mEntries.push_back(Entry());
+		}
+		mSlots[obj->getUUID()] = slot;
+	}
+
+	Entry& entry = mEntries[slot];
+	entry.mID = obj->getUUID();
+	entry.mText = text;
+	addPostings(slot);
+	++mRevision;
+
+	if (mStalePostings > MIN_STALE_POSTINGS && mStalePostings > mLivePostings)
+	{
+		compactPostings();
+	}
+}
+
+void LLInventorySearchIndex::removeObject(const LLUUID& id)
+{
+	slot_map_t::iterator found = mSlots.find(id);
+	if (found == mSlots.end())
+	{
+		return;
+	}
+	const S32 slot = found->second;
+	mSlots.erase(found);
+
+	// The slot's postings are left behind, lookups skip free slots.
+	Entry& entry = mEntries[slot];
+	mStalePostings += trigram_count(entry.mText);
+	mLivePostings -= trigram_count(entry.mText);
+	entry.mID.setNull();
+	entry.mText.clear();
+	mFreeSlots.push_back(slot);
+	++mRevision;
+}
+
+void LLInventorySearchIndex::addPostings(S32 slot)
+{
+	const std::string& text = mEntries[slot].mText;
+	for (size_t pos = 0; pos + 3 <= text.size(); ++pos)
+	{
+		posting_list_t& postings = mPostings[trigram_key(text, pos)];
+		if (postings.empty() || postings.back() != slot)
+		{
+			postings.push_back(slot);
+		}
+	}
+	mLivePostings += trigram_count(text);
+}
+
+void LLInventorySearchIndex::compactPostings()
+{
+	mPostings.clear();
+	mLivePostings = 0;
+	mStalePostings = 0;
+	for (S32 slot = 0; slot < (S32)mEntries.size(); ++slot)
+	{
+		if (!mEntries[slot].mText.empty())
+		{
+			addPostings(slot);
+		}
+	}
+}
@@ -0,0 +1,116 @@
+/**
+ * @file llinventorysearchindex.h
+ * @brief LLInventorySearchIndex class header file
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLINVENTORYSEARCHINDEX_H
+#define LL_LLINVENTORYSEARCHINDEX_H
+
+#include "llsingleton.h"
+#include "lluuid.h"
+#include <boost/unordered_map.hpp>
+#include <string>
+#include <vector>
+
+class LLInventoryObject;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Class LLInventorySearchIndex
+//
+//   Trigram index over the upper-cased names of everything in the agent
+//   inventory and the library. It is built on first use and then kept up
+//   to date from inventory change notifications.
+//   Filter strings are upper-cased the same way, so a lookup gives the
+//   same answer as LLInventoryFilter's substring match on the name.
+//
+//   Folders still only in the inventory cache are not loaded for the
+//   index, their items are indexed once something else loads them.
+//   Until then they count as holding matches.
+//
+//   The folder view uses getFoldersWithMatches() to skip whole folders
+//   that can't contain anything passing the filter string.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+class LLInventorySearchIndex : public LLSingleton<LLInventorySearchIndex>
+{
+	friend class LLSingleton<LLInventorySearchIndex>;
+public:
+	// Called by the index's inventory observer.
+	void changed(U32 mask);
+
+	// Appends the ids of all indexed objects whose name contains
+	// substring, which must already be upper-cased. Returns false if the
+	// index isn't available yet.
+	bool findMatches(const std::string& substring, uuid_vec_t& matches);
+
+	// Folders that match substring or have a descendant that does, or
+	// may have one in a folder not loaded yet. The result is cached until
+	// the filter string or the inventory changes.
+	// Returns NULL if the index isn't available yet.
+	const uuid_list_t* getFoldersWithMatches(const std::string& substring);
+
+	S32 getEntryCount() const { return (S32)mSlots.size(); }
+
+protected:
+	LLInventorySearchIndex();
+	~LLInventorySearchIndex();
+
+private:
+	struct Entry
+	{
+		LLUUID mID;
+		std::string mText;	// upper-cased name, empty when the slot is free
+	};
+	typedef std::vector<S32> posting_list_t;
+	typedef boost::unordered_map<U32, posting_list_t> posting_map_t;
+	typedef boost::unordered_map<LLUUID, S32> slot_map_t;
+
+	bool build();
+	void indexLoadedFolders();
+	void addFolderAndParents(LLUUID cat_id);
+	void updateObject(const LLInventoryObject* obj, bool is_category);
+	void removeObject(const LLUUID& id);
+	void addPostings(S32 slot);
+	void compactPostings();
+
+private:
+	std::vector<Entry> mEntries;
+	std::vector<S32> mFreeSlots;
+	slot_map_t mSlots;
+	posting_map_t mPostings;
+	S32 mLivePostings;
+	S32 mStalePostings;
+	bool mBuilt;
+	U32 mRevision;
+
+	// Folders whose items are not indexed yet as they are still pending
+	// in the inventory model, and the model's pending count last checked.
+	uuid_list_t mPendingFolders;
+	S32 mPendingCategoryCount;
+
+	std::string mCachedSubString;
+	U32 mCachedRevision;
+	uuid_list_t mCachedFolders;
+};
+
+#endif // LL_LLINVENTORYSEARCHINDEX_H
@@ -36,6 +36,7 @@
 #include "llfloaterreg.h"
 #include "llfocusmgr.h"
 #include "lllocalcliprect.h"
+#include "llregionhandle.h"
 #include "llrender.h"
 #include "llui.h"
 #include "lltooltip.h"
@@ -73,6 +74,8 @@ const F32 MIN_DOT_RADIUS = 3.5f;
 const F32 DOT_SCALE = 0.75f;
 const F32 MIN_PICK_SCALE = 2.f;
 const S32 MOUSE_DRAG_SLOP = 2;		// How far the mouse needs to move before we think it's a drag
+const S32 MIN_OBJECT_TILE_SIZE = 16;
+const S32 MAX_OBJECT_TILE_SIZE = 256;
 
 //static
 uuid_vec_t LLNetMap::sSelected;
@@ -82,17 +85,16 @@ LLNetMap::LLNetMap (const Params & p)
 	mBackgroundColor (p.bg_color()),
 	mScale( MAP_SCALE_MID ),
 	mPixelsPerMeter( MAP_SCALE_MID / REGION_WIDTH_METERS ),
-	mObjectMapTPM(0.f),
-	mObjectMapPixels(0.f),
 	mTargetPan(0.f, 0.f),
 	mCurPan(0.f, 0.f),
 	mStartPan(0.f, 0.f),
 	mMouseDown(0, 0),
 	mPanning(false),
 	mUpdateNow(false),
-	mObjectImageCenterGlobal( gAgentCamera.getCameraPositionGlobal() ),
-	mObjectRawImagep(),
-	mObjectImagep(),
+	mObjectTileSize(0),
+	mObjectTiles(),
+	mObjectDots(),
+	mDirtyObjects(),
 	mClosestAgentToCursor(),
 	mClosestAgentAtLastRightClick(),
 	mToolTipMsg(),
@@ -127,18 +129,6 @@ void LLNetMap::setScale( F32 scale )
 	scale = llclamp(scale, MAP_SCALE_MIN, MAP_SCALE_MAX);
 	mCurPan *= scale / mScale;
 	mScale = scale;
-	
-	if (mObjectImagep.notNull())
-	{
-		F32 width = (F32)(getRect().getWidth());
-		F32 height = (F32)(getRect().getHeight());
-		F32 diameter = sqrt(width * width + height * height);
-		F32 region_widths = diameter / mScale;
-		F32 meters = region_widths * LLWorld::getInstance()->getRegionWidthInMeters();
-		F32 num_pixels = (F32)mObjectImagep->getWidth();
-		mObjectMapTPM = num_pixels / meters;
-		mObjectMapPixels = diameter;
-	}
 
 	mPixelsPerMeter = mScale / REGION_WIDTH_METERS;
 	mDotRadius = llmax(DOT_SCALE * mPixelsPerMeter, MIN_DOT_RADIUS);
@@ -162,10 +152,13 @@ void LLNetMap::draw()
 	static LLUIColor map_track_disabled_color = LLUIColorTable::instance().getColor("MapTrackDisabledColor", LLColor4::white);
 	static LLUIColor map_frustum_color = LLUIColorTable::instance().getColor("MapFrustumColor", LLColor4::white);
 	static LLUIColor map_frustum_rotating_color = LLUIColorTable::instance().getColor("MapFrustumRotatingColor", LLColor4::white);
-	
-	if (mObjectImagep.isNull())
+
+	// Restamp the objects that changed
+	if (mUpdateNow || (map_timer.getElapsedTimeF32() > 0.5f))
 	{
-		createObjectImage();
+		mUpdateNow = false;
+		updateObjectLayer();
+		map_timer.reset();
 	}
 
 	static LLUICachedControl<bool> auto_center("MiniMapAutoCenter", true);
@@ -284,52 +277,26 @@ void LLNetMap::draw()
 				}
 			}
 			gGL.setAlphaRejectSettings(LLRender::CF_DEFAULT);
-		}
-
-		// Redraw object layer periodically
-		if (mUpdateNow || (map_timer.getElapsedTimeF32() > 0.5f))
-		{
-			mUpdateNow = false;
-
-			// Locate the centre of the object layer, accounting for panning
-			LLVector3 new_center = globalPosToView(gAgentCamera.getCameraPositionGlobal());
-			new_center.mV[VX] -= mCurPan.mV[VX];
-			new_center.mV[VY] -= mCurPan.mV[VY];
-			new_center.mV[VZ] = 0.f;
-			mObjectImageCenterGlobal = viewPosToGlobal(llfloor(new_center.mV[VX]), llfloor(new_center.mV[VY]));
-
-			// Create the base texture.
-			U8 *default_texture = mObjectRawImagep->getData();
-			memset( default_texture, 0, mObjectImagep->getWidth() * mObjectImagep->getHeight() * mObjectImagep->getComponents() );
 
 			// Draw objects
-			gObjectList.renderObjectsForMap(*this);
-
-			mObjectImagep->setSubImage(mObjectRawImagep, 0, 0, mObjectImagep->getWidth(), mObjectImagep->getHeight());
-			
-			map_timer.reset();
+			tile_map_t::iterator tile_iter = mObjectTiles.find(regionp->getHandle());
+			if (tile_iter != mObjectTiles.end())
+			{
+				gGL.color4f(1.f, 1.f, 1.f, 1.f);
+				gGL.getTexUnit(0)->bind(tile_iter->second.mImagep);
+				gGL.begin(LLRender::QUADS);
+					gGL.texCoord2f(0.f, 1.f);
+					gGL.vertex2f(left, top);
+					gGL.texCoord2f(0.f, 0.f);
+					gGL.vertex2f(left, bottom);
+					gGL.texCoord2f(1.f, 0.f);
+					gGL.vertex2f(right, bottom);
+					gGL.texCoord2f(1.f, 1.f);
+					gGL.vertex2f(right, top);
+				gGL.end();
+			}
 		}
 
-		LLVector3 map_center_agent = gAgent.getPosAgentFromGlobal(mObjectImageCenterGlobal);
-		map_center_agent -= gAgentCamera.getCameraPositionAgent();
-		map_center_agent.mV[VX] *= mScale/region_width;
-		map_center_agent.mV[VY] *= mScale/region_width;
-
-		gGL.getTexUnit(0)->bind(mObjectImagep);
-		F32 image_half_width = 0.5f*mObjectMapPixels;
-		F32 image_half_height = 0.5f*mObjectMapPixels;
-
-		gGL.begin(LLRender::QUADS);
-			gGL.texCoord2f(0.f, 1.f);
-			gGL.vertex2f(map_center_agent.mV[VX] - image_half_width, image_half_height + map_center_agent.mV[VY]);
-			gGL.texCoord2f(0.f, 0.f);
-			gGL.vertex2f(map_center_agent.mV[VX] - image_half_width, map_center_agent.mV[VY] - image_half_height);
-			gGL.texCoord2f(1.f, 0.f);
-			gGL.vertex2f(image_half_width + map_center_agent.mV[VX], map_center_agent.mV[VY] - image_half_height);
-			gGL.texCoord2f(1.f, 1.f);
-			gGL.vertex2f(image_half_width + map_center_agent.mV[VX], image_half_height + map_center_agent.mV[VY]);
-		gGL.end();
-
 		gGL.popMatrix();
 
 		LLVector3d pos_global;
@@ -527,12 +494,6 @@ void LLNetMap::draw()
 
 }
 
-void LLNetMap::reshape(S32 width, S32 height, BOOL called_from_parent)
-{
-	LLUICtrl::reshape(width, height, called_from_parent);
-	createObjectImage();
-}
-
 LLVector3 LLNetMap::globalPosToView( const LLVector3d& global_pos )
 {
 	LLVector3d relative_pos_global = global_pos - gAgentCamera.getCameraPositionGlobal();
@@ -717,129 +678,289 @@ void LLNetMap::showAvatarInspector(const LLUUID& avatar_id)
 	LLFloaterReg::showInstance("inspect_avatar", params);
 }
 
-void LLNetMap::renderScaledPointGlobal( const LLVector3d& pos, const LLColor4U &color, F32 radius_meters )
+//static
+void LLNetMap::dirtyObject(LLViewerObject* objectp)
 {
-	LLVector3 local_pos;
-	local_pos.setVec( pos - mObjectImageCenterGlobal );
-
-	S32 diameter_pixels = llround(2 * radius_meters * mObjectMapTPM);
-	renderPoint( local_pos, color, diameter_pixels );
+	LLInstanceTrackerScopedGuard guard;
+	for (instance_iter iter = guard.beginInstances(); iter != guard.endInstances(); ++iter)
+	{
+		iter->mDirtyObjects.insert(objectp);
+	}
 }
 
-
-void LLNetMap::renderPoint(const LLVector3 &pos_local, const LLColor4U &color, 
-						   S32 diameter, S32 relative_height)
+//static
+void LLNetMap::removeObject(LLViewerObject* objectp)
 {
-	if (diameter <= 0)
+	LLInstanceTrackerScopedGuard guard;
+	for (instance_iter iter = guard.beginInstances(); iter != guard.endInstances(); ++iter)
 	{
-		return;
-	}
+		LLNetMap& netmap = *iter;
+		netmap.mDirtyObjects.erase(objectp);
 
-	const S32 image_width = (S32)mObjectImagep->getWidth();
-	const S32 image_height = (S32)mObjectImagep->getHeight();
-
-	S32 x_offset = llround(pos_local.mV[VX] * mObjectMapTPM + image_width / 2);
-	S32 y_offset = llround(pos_local.mV[VY] * mObjectMapTPM + image_height / 2);
+		dot_map_t::iterator dot_iter = netmap.mObjectDots.find(objectp);
+		if (dot_iter != netmap.mObjectDots.end())
+		{
+			netmap.removeDot(dot_iter);
+		}
+	}
+}
 
-	if ((x_offset < 0) || (x_offset >= image_width))
+S32 LLNetMap::getObjectTileSize() const
+{
+	// About two screen pixels per texel
+	S32 tile_size = MIN_OBJECT_TILE_SIZE;
+	while ((tile_size < MAX_OBJECT_TILE_SIZE) && (tile_size * 2 < mScale))
 	{
-		return;
+		tile_size <<= 1;
 	}
-	if ((y_offset < 0) || (y_offset >= image_height))
+	return tile_size;
+}
+
+void LLNetMap::updateObjectLayer()
+{
+	S32 tile_size = getObjectTileSize();
+	if (tile_size != mObjectTileSize)
 	{
-		return;
+		// Restamp everything at the new resolution
+		mObjectTileSize = tile_size;
+		mObjectTiles.clear();
+		mObjectDots.clear();
+		gObjectList.addObjectsToMap(*this);
 	}
 
-	U8 *datap = mObjectRawImagep->getData();
-
-	S32 neg_radius = diameter / 2;
-	S32 pos_radius = diameter - neg_radius;
-	S32 x, y;
+	updateObjectTiles();
 
-	if (relative_height > 0)
+	const F64 texels_per_meter = mObjectTileSize / LLWorld::getInstance()->getRegionWidthInMeters();
+	for (std::set<LLViewerObject*>::iterator iter = mDirtyObjects.begin(); iter != mDirtyObjects.end(); ++iter)
 	{
-		// ...point above agent
-		S32 px, py;
+		LLViewerObject* objectp = *iter;
+		ObjectDot dot;
+		LLVector3d pos_global;
+		F32 radius = 0.f;
+		BOOL on_map = gObjectList.getMapDot(objectp, pos_global, radius, dot.mColor);
+		if (on_map)
+		{
+			// A square diameter texels across, centered on the nearest texel
+			S32 diameter = llround((F32)(2.0 * radius * texels_per_meter));
+			S32 x = llfloor((F32)(pos_global.mdV[VX] * texels_per_meter) + 0.5f) - diameter / 2;
+			S32 y = llfloor((F32)(pos_global.mdV[VY] * texels_per_meter) + 0.5f) - diameter / 2;
+			dot.mRect.set(x, y + diameter, x + diameter, y);
+			on_map = diameter > 0;
+		}
 
-		// vertical line
-		px = x_offset;
-		for (y = -neg_radius; y < pos_radius; y++)
+		dot_map_t::iterator dot_iter = mObjectDots.find(objectp);
+		if (dot_iter != mObjectDots.end())
 		{
-			py = y_offset + y;
-			if ((py < 0) || (py >= image_height))
+			if (on_map && dot_iter->second.mRect == dot.mRect && dot_iter->second.mColor == dot.mColor)
 			{
+				// Moved less than a texel
 				continue;
 			}
-			S32 offset = px + py * image_width;
-			((U32*)datap)[offset] = color.mAll;
+			removeDot(dot_iter);
 		}
 
-		// top line
-		py = y_offset + pos_radius - 1;
-		for (x = -neg_radius; x < pos_radius; x++)
+		if (on_map)
 		{
-			px = x_offset + x;
-			if ((px < 0) || (px >= image_width))
-			{
-				continue;
-			}
-			S32 offset = px + py * image_width;
-			((U32*)datap)[offset] = color.mAll;
+			addDot(objectp, dot);
 		}
 	}
-	else
+	mDirtyObjects.clear();
+
+	stampDots();
+}
+
+void LLNetMap::updateObjectTiles()
+{
+	const F32 region_width = LLWorld::getInstance()->getRegionWidthInMeters();
+
+	// Tiles follow the regions we know about
+	std::set<U64> handles;
+	std::vector<ObjectTile*> new_tiles;
+	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin();
+		 iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
+	{
+		U64 handle = (*iter)->getHandle();
+		handles.insert(handle);
+		if (mObjectTiles.find(handle) != mObjectTiles.end())
+		{
+			continue;
+		}
+
+		ObjectTile& tile = mObjectTiles[handle];
+		U32 x_origin = 0;
+		U32 y_origin = 0;
+		from_region_handle(handle, &x_origin, &y_origin);
+		tile.mOriginX = llround(x_origin / region_width) * mObjectTileSize;
+		tile.mOriginY = llround(y_origin / region_width) * mObjectTileSize;
+		tile.mRawImagep = new LLImageRaw(mObjectTileSize, mObjectTileSize, 4);
+		memset(tile.mRawImagep->getData(), 0, mObjectTileSize * mObjectTileSize * 4);
+		tile.mImagep = LLViewerTextureManager::getLocalTexture(tile.mRawImagep.get(), FALSE);
+		tile.mImagep->setAddressMode(LLTexUnit::TAM_CLAMP);
+		// Picks up the edges of dots stamped into its neighbours
+		tile.mDirtyRect.set(0, mObjectTileSize, mObjectTileSize, 0);
+		new_tiles.push_back(&tile);
+	}
+
+	for (tile_map_t::iterator iter = mObjectTiles.begin(); iter != mObjectTiles.end(); )
 	{
-		// ...point level with agent
-		for (x = -neg_radius; x < pos_radius; x++)
+		if (handles.find(iter->first) == handles.end())
+		{
+			mObjectTiles.erase(iter++);
+		}
+		else
 		{
-			S32 p_x = x_offset + x;
-			if ((p_x < 0) || (p_x >= image_width))
+			++iter;
+		}
+	}
+
+	if (new_tiles.empty())
+	{
+		return;
+	}
+
+	// Dots of objects in the neighbouring regions may reach into a new tile
+	for (dot_map_t::iterator iter = mObjectDots.begin(); iter != mObjectDots.end(); ++iter)
+	{
+		for (std::vector<ObjectTile*>::iterator tile_iter = new_tiles.begin(); tile_iter != new_tiles.end(); ++tile_iter)
+		{
+			ObjectTile* tile = *tile_iter;
+			LLRect rect = iter->second.mRect;
+			rect.translate(-tile->mOriginX, -tile->mOriginY);
+			rect.intersectWith(LLRect(0, mObjectTileSize, mObjectTileSize, 0));
+			if (!rect.isEmpty())
 			{
-				continue;
+				tile->mObjects.insert(iter->first);
 			}
+		}
+	}
+}
+
+void LLNetMap::getTilesUnder(const LLRect& rect, std::vector<ObjectTile*>& tiles)
+{
+	if (!mObjectTileSize || rect.isEmpty())
+	{
+		return;
+	}
 
-			for (y = -neg_radius; y < pos_radius; y++)
+	const U32 region_width = llround(LLWorld::getInstance()->getRegionWidthInMeters());
+	for (S32 tile_y = rect.mBottom / mObjectTileSize; tile_y <= (rect.mTop - 1) / mObjectTileSize; tile_y++)
+	{
+		for (S32 tile_x = rect.mLeft / mObjectTileSize; tile_x <= (rect.mRight - 1) / mObjectTileSize; tile_x++)
+		{
+			tile_map_t::iterator iter = mObjectTiles.find(to_region_handle(tile_x * region_width, tile_y * region_width));
+			if (iter != mObjectTiles.end())
 			{
-				S32 p_y = y_offset + y;
-				if ((p_y < 0) || (p_y >= image_height))
-				{
-					continue;
-				}
-				S32 offset = p_x + p_y * image_width;
-				((U32*)datap)[offset] = color.mAll;
+				tiles.push_back(&iter->second);
 			}
 		}
 	}
 }
 
-void LLNetMap::createObjectImage()
+void LLNetMap::addDot(LLViewerObject* objectp, const ObjectDot& dot)
 {
-	// Find the size of the side of a square that surrounds the circle that surrounds getRect().
-	// ... which is, the diagonal of the rect.
-	F32 width = (F32)getRect().getWidth();
-	F32 height = (F32)getRect().getHeight();
-	S32 square_size = llround( sqrt(width*width + height*height) );
-
-	// Find the least power of two >= the minimum size.
-	const S32 MIN_SIZE = 64;
-	const S32 MAX_SIZE = 256;
-	S32 img_size = MIN_SIZE;
-	while( (img_size*2 < square_size ) && (img_size < MAX_SIZE) )
+	mObjectDots[objectp] = dot;
+
+	std::vector<ObjectTile*> tiles;
+	getTilesUnder(dot.mRect, tiles);
+	for (std::vector<ObjectTile*>::iterator iter = tiles.begin(); iter != tiles.end(); ++iter)
 	{
-		img_size <<= 1;
+		(*iter)->mObjects.insert(objectp);
 	}
+	dirtyTexels(dot.mRect);
+}
+
+void LLNetMap::removeDot(dot_map_t::iterator dot_iter)
+{
+	const LLRect rect = dot_iter->second.mRect;
 
-	if( mObjectImagep.isNull() ||
-		(mObjectImagep->getWidth() != img_size) ||
-		(mObjectImagep->getHeight() != img_size) )
+	std::vector<ObjectTile*> tiles;
+	getTilesUnder(rect, tiles);
+	for (std::vector<ObjectTile*>::iterator iter = tiles.begin(); iter != tiles.end(); ++iter)
 	{
-		mObjectRawImagep = new LLImageRaw(img_size, img_size, 4);
-		U8* data = mObjectRawImagep->getData();
-		memset( data, 0, img_size * img_size * 4 );
-		mObjectImagep = LLViewerTextureManager::getLocalTexture( mObjectRawImagep.get(), FALSE);
+		(*iter)->mObjects.erase(dot_iter->first);
+	}
+	mObjectDots.erase(dot_iter);
+	dirtyTexels(rect);
+}
+
+void LLNetMap::dirtyTexels(const LLRect& rect)
+{
+	std::vector<ObjectTile*> tiles;
+	getTilesUnder(rect, tiles);
+	for (std::vector<ObjectTile*>::iterator iter = tiles.begin(); iter != tiles.end(); ++iter)
+	{
+		ObjectTile& tile = **iter;
+		LLRect local = rect;
+		local.translate(-tile.mOriginX, -tile.mOriginY);
+		local.intersectWith(LLRect(0, mObjectTileSize, mObjectTileSize, 0));
+		if (local.isEmpty())
+		{
+			continue;
+		}
+
+		if (tile.mDirtyRect.isEmpty())
+		{
+			tile.mDirtyRect = local;
+		}
+		else
+		{
+			tile.mDirtyRect.unionWith(local);
+		}
+	}
+}
+
+void LLNetMap::stampDots()
+{
+	for (tile_map_t::iterator iter = mObjectTiles.begin(); iter != mObjectTiles.end(); ++iter)
+	{
+		ObjectTile& tile = iter->second;
+		if (tile.mDirtyRect.isEmpty())
+		{
+			continue;
+		}
+
+		// Clear the dirty texels
+		U32* datap = (U32*)tile.mRawImagep->getData();
+		for (S32 y = tile.mDirtyRect.mBottom; y < tile.mDirtyRect.mTop; y++)
+		{
+			memset(datap + y * mObjectTileSize + tile.mDirtyRect.mLeft, 0, tile.mDirtyRect.getWidth() * 4);
+		}
+
+		// Restamp the tile's dots that overlap them. The tile's set is in
+		// the same order as mObjectDots, so overlapping dots come out as
+		// they would from scratch.
+		for (std::set<LLViewerObject*>::iterator obj_iter = tile.mObjects.begin(); obj_iter != tile.mObjects.end(); ++obj_iter)
+		{
+			dot_map_t::iterator dot_iter = mObjectDots.find(*obj_iter);
+			if (dot_iter == mObjectDots.end())
+			{
+				continue;
+			}
+
+			const ObjectDot& dot = dot_iter->second;
+			LLRect rect = dot.mRect;
+			rect.translate(-tile.mOriginX, -tile.mOriginY);
+			rect.intersectWith(tile.mDirtyRect);
+			if (rect.isEmpty())
+			{
+				continue;
+			}
+
+			for (S32 y = rect.mBottom; y < rect.mTop; y++)
+			{
+				U32* rowp = datap + y * mObjectTileSize;
+				for (S32 x = rect.mLeft; x < rect.mRight; x++)
+				{
+					rowp[x] = dot.mColor.mAll;
+				}
+			}
+		}
+
+		// Upload only what changed
+		const LLRect& rect = tile.mDirtyRect;
+		tile.mImagep->setSubImage(tile.mRawImagep, rect.mLeft, rect.mBottom, rect.getWidth(), rect.getHeight());
+		tile.mDirtyRect = LLRect();
 	}
-	setScale(mScale);
-	mUpdateNow = true;
 }
 
 BOOL LLNetMap::handleMouseDown( S32 x, S32 y, MASK mask )
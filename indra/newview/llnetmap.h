@@ -28,20 +28,27 @@
 #define LL_LLNETMAP_H
 
 #include "llmath.h"
+#include "llinstancetracker.h"
 #include "lluictrl.h"
 #include "v3math.h"
 #include "v3dmath.h"
 #include "v4color.h"
+#include "v4coloru.h"
 #include "llpointer.h"
+#include "llrect.h"
+
+#include <map>
+#include <set>
+#include <vector>
 
-class LLColor4U;
 class LLCoordGL;
 class LLImageRaw;
+class LLViewerObject;
 class LLViewerTexture;
 class LLFloaterMap;
 class LLMenuGL;
 
-class LLNetMap : public LLUICtrl
+class LLNetMap : public LLUICtrl, public LLInstanceTracker<LLNetMap>
 {
 public:
 	struct Params 
@@ -72,7 +79,6 @@ public:
 	/*virtual*/ BOOL	handleMouseUp(S32 x, S32 y, MASK mask);
 	/*virtual*/ BOOL	handleHover( S32 x, S32 y, MASK mask );
 	/*virtual*/ BOOL	handleToolTip( S32 x, S32 y, MASK mask);
-	/*virtual*/ void	reshape(S32 width, S32 height, BOOL called_from_parent = TRUE);
 
 	/*virtual*/ BOOL 	postBuild();
 	/*virtual*/ BOOL	handleRightMouseDown( S32 x, S32 y, MASK mask );
@@ -81,13 +87,43 @@ public:
 
 	void			setScale( F32 scale );
 	void			setToolTipMsg(const std::string& msg) { mToolTipMsg = msg; }
-	void			renderScaledPointGlobal( const LLVector3d& pos, const LLColor4U &color, F32 radius );
 	BOOL			handleTeleport( S32 x, S32 y, MASK mask );
 
+	// The object layer only restamps objects LLViewerObjectList reports
+	// as added, moved, rescaled or removed.
+	static void		dirtyObject(LLViewerObject* objectp);
+	static void		removeObject(LLViewerObject* objectp);
+	void			addObject(LLViewerObject* objectp) { mDirtyObjects.insert(objectp); }
+
 private:
-	const LLVector3d& getObjectImageCenterGlobal()	{ return mObjectImageCenterGlobal; }
-	void 			renderPoint(const LLVector3 &pos, const LLColor4U &color, 
-								S32 diameter, S32 relative_height = 0);
+	// A region's square of the object layer
+	struct ObjectTile
+	{
+		S32 mOriginX;						// in layer texels
+		S32 mOriginY;
+		LLPointer<LLImageRaw> mRawImagep;
+		LLPointer<LLViewerTexture> mImagep;
+		LLRect mDirtyRect;					// texels to redraw and upload
+		std::set<LLViewerObject*> mObjects;	// with dots overlapping the tile
+	};
+	typedef std::map<U64, ObjectTile> tile_map_t;
+
+	// An object as last stamped, in layer texels
+	struct ObjectDot
+	{
+		LLRect mRect;
+		LLColor4U mColor;
+	};
+	typedef std::map<LLViewerObject*, ObjectDot> dot_map_t;
+
+	S32				getObjectTileSize() const;
+	void			updateObjectLayer();
+	void			updateObjectTiles();
+	void			getTilesUnder(const LLRect& rect, std::vector<ObjectTile*>& tiles);
+	void			addDot(LLViewerObject* objectp, const ObjectDot& dot);
+	void			removeDot(dot_map_t::iterator dot_iter);
+	void			dirtyTexels(const LLRect& rect);
+	void			stampDots();
 
 	LLVector3		globalPosToView(const LLVector3d& global_pos);
 	LLVector3d		viewPosToGlobal(S32 x,S32 y);
@@ -98,8 +134,6 @@ private:
 	BOOL			handleToolTipAgent(const LLUUID& avatar_id);
 	static void		showAvatarInspector(const LLUUID& avatar_id);
 
-	void			createObjectImage();
-
 	static bool		outsideSlop(S32 x, S32 y, S32 start_x, S32 start_y, S32 slop);
 
 private:
@@ -109,8 +143,6 @@ private:
 
 	F32				mScale;					// Size of a region in pixels
 	F32				mPixelsPerMeter;		// world meters to map pixels
-	F32				mObjectMapTPM;			// texels per meter on map
-	F32				mObjectMapPixels;		// Width of object map in pixels
 	F32				mDotRadius;				// Size of avatar markers
 
 	bool			mPanning;			// map is being dragged
@@ -119,9 +151,10 @@ private:
 	LLVector2		mStartPan;		// pan offset at start of drag
 	LLCoordGL		mMouseDown;			// pointer position at start of drag
 
-	LLVector3d		mObjectImageCenterGlobal;
-	LLPointer<LLImageRaw> mObjectRawImagep;
-	LLPointer<LLViewerTexture>	mObjectImagep;
+	S32				mObjectTileSize;		// layer texels per region side
+	tile_map_t		mObjectTiles;			// by region handle
+	dot_map_t		mObjectDots;
+	std::set<LLViewerObject*> mDirtyObjects;
 
 	LLUUID			mClosestAgentToCursor;
 	LLUUID			mClosestAgentAtLastRightClick;
@@ -436,7 +436,7 @@ void LLOutfitsList::refreshList(const LLUUID& category_id)
 
 	// Collect all sub-categories of a given category.
 	LLIsType is_category(LLAssetType::AT_CATEGORY);
-	gInventory.collectDescendentsIf(
+	gInventory.collectLoadedDescendentsIf(
 		category_id,
 		cat_array,
 		item_array,
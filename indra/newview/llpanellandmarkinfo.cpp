@@ -489,7 +489,7 @@ static void collectLandmarkFolders(LLInventoryModel::cat_array_t& cats)
 	// Add descendent folders of the "Landmarks" category.
 	LLInventoryModel::item_array_t items; // unused
 	LLIsType is_category(LLAssetType::AT_CATEGORY);
-	gInventory.collectDescendentsIf(
+	gInventory.collectLoadedDescendentsIf(
 		landmarks_id,
 		cats,
 		items,
@@ -0,0 +1,49 @@
+/**
+ * @file llsettingsindex.cpp
+ * @brief Typed settings addressed by generated indices instead of names
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llsettingsindex.h"
+
+LLSettingsIndex gSettingsIndex;
+
+void LLSettingsIndex::bind(LLControlGroup& group)
+{
+	mBOOLs.bind(group, gSettingBOOLNames);
+	mS32s.bind(group, gSettingS32Names);
+	mU32s.bind(group, gSettingU32Names);
+	mF32s.bind(group, gSettingF32Names);
+	mStrings.bind(group, gSettingStringNames);
+}
+
+void LLSettingsIndex::unbind()
+{
+	mBOOLs.unbind();
+	mS32s.unbind();
+	mU32s.unbind();
+	mF32s.unbind();
+	mStrings.unbind();
+}
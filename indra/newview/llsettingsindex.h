@@ -0,0 +1,68 @@
+/**
+ * @file llsettingsindex.h
+ * @brief Typed settings addressed by generated indices instead of names
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSETTINGSINDEX_H
+#define LL_LLSETTINGSINDEX_H
+
+#include "llcontrol.h"
+#include "llsettingsindices.h"	// generated from settings.xml
+
+// Copies of every Boolean, S32, U32, F32 and String setting declared in
+// settings.xml, in flat arrays indexed by the generated ESetting enums, so
+// code that reads settings every frame skips the name lookup and LLSD
+// conversion of gSavedSettings.getBOOL("Name"):
+//
+//	if (gSettingsIndex.getBOOL(SETTING_RenderUseFarClip))
+class LLSettingsIndex
+{
+public:
+	void bind(LLControlGroup& group);
+	void unbind();
+
+	BOOL getBOOL(ESettingBOOL setting) const						{ return mBOOLs.get(setting); }
+	S32 getS32(ESettingS32 setting) const							{ return mS32s.get(setting); }
+	U32 getU32(ESettingU32 setting) const							{ return mU32s.get(setting); }
+	F32 getF32(ESettingF32 setting) const							{ return mF32s.get(setting); }
+	const std::string& getString(ESettingString setting) const		{ return mStrings.get(setting); }
+
+	// Setters go through the control so listeners fire and the value saves.
+	void setBOOL(ESettingBOOL setting, BOOL value)					{ mBOOLs.set(setting, (bool)value); }
+	void setS32(ESettingS32 setting, S32 value)						{ mS32s.set(setting, value); }
+	void setU32(ESettingU32 setting, U32 value)						{ mU32s.set(setting, value); }
+	void setF32(ESettingF32 setting, F32 value)						{ mF32s.set(setting, value); }
+	void setString(ESettingString setting, const std::string& value)	{ mStrings.set(setting, value); }
+
+private:
+	LLControlIndex<bool, SETTING_BOOL_COUNT>			mBOOLs;
+	LLControlIndex<S32, SETTING_S32_COUNT>				mS32s;
+	LLControlIndex<U32, SETTING_U32_COUNT>				mU32s;
+	LLControlIndex<F32, SETTING_F32_COUNT>				mF32s;
+	LLControlIndex<std::string, SETTING_STRING_COUNT>	mStrings;
+};
+
+extern LLSettingsIndex gSettingsIndex;
+
+#endif // LL_LLSETTINGSINDEX_H
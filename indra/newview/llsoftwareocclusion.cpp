@@ -0,0 +1,514 @@
+/**
+ * @file llsoftwareocclusion.cpp
+ * @brief Spatial group occlusion tests against a small CPU depth buffer
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llsoftwareocclusion.h"
+
+#include "llcamera.h"
+#include "lldrawable.h"
+#include "lldrawpool.h"
+#include "llface.h"
+#include "llfasttimer.h"
+#include "llspatialpartition.h"
+#include "llsurface.h"
+#include "llsurfacepatch.h"
+#include "lltimer.h"
+#include "llviewercamera.h"
+#include "llviewerregion.h"
+#include "llviewerstats.h"
+#include "llvolume.h"
+#include "llvovolume.h"
+#include "llworld.h"
+
+#include <algorithm>
+
+static LLFastTimer::DeclareTimer FTM_SOFTWARE_OCCLUSION("Software Occlusion");
+
+// Box prims kept as occluders, largest on screen first.
+const U32 MAX_OCCLUDERS = 128;
+// Half the diagonal of the smallest box prim worth drawing, in meters.
+const F32 MIN_OCCLUDER_RADIUS = 4.f;
+// Padding added to group bounds, in meters.
+const F32 OCCLUDEE_PAD = 0.25f;
+// Depth of terrain boxes below the lower of the patch and sea level.
+const F32 TERRAIN_BOX_DEPTH = 1.f;
+// Polygons get a vertex from each clip plane, the near and the water plane.
+const U32 MAX_CLIPPED_VERTS = 8;
+
+S32 LLSoftwareOcclusion::sMode = LLSoftwareOcclusion::MODE_OFF;
+U32 LLSoftwareOcclusion::sCameraMask = 1 << LLViewerCamera::CAMERA_WORLD;
+
+LLSoftwareOcclusion::LLSoftwareOcclusion()
+:	mValid(FALSE),
+	mScaleX(1.f),
+	mScaleY(1.f),
+	mNear(0.1f),
+	mWaterClip(0),
+	mBuildTime(0.0)
+{
+}
+
+LLSoftwareOcclusion::~LLSoftwareOcclusion()
+{
+	clearOccluders();
+}
+
+//static
+BOOL LLSoftwareOcclusion::isEnabledFor(U32 camera_id)
+{
+	if (sMode == MODE_OFF || !(sCameraMask & (1 << camera_id)))
+	{
+		return FALSE;
+	}
+
+	// the test assumes a perspective eye, which light cameras don't have
+	return camera_id < LLViewerCamera::CAMERA_SHADOW0 ||
+		camera_id == LLViewerCamera::CAMERA_WATER0 ||
+		camera_id == LLViewerCamera::CAMERA_WATER1;
+}
+
+//static
+BOOL LLSoftwareOcclusion::replacesQueries(U32 camera_id)
+{
+	return sMode == MODE_CULL && isEnabledFor(camera_id);
+}
+
+BOOL LLSoftwareOcclusion::isBoxOccluder(LLDrawable* drawable) const
+{
+	if (drawable->isDead() || drawable->isActive() ||
+		drawable->getScale().magVec() * 0.5f < MIN_OCCLUDER_RADIUS)
+	{
+		return FALSE;
+	}
+
+	LLVOVolume* vobj = drawable->getVOVolume();
+	if (!vobj || !vobj->getVolume() || vobj->isFlexible() || vobj->isSculpted() || vobj->isAttachment())
+	{
+		return FALSE;
+	}
+
+	// only an untouched box fills its scaled unit cube
+	const LLVolumeParams& params = vobj->getVolume()->getParams();
+	const LLProfileParams& profile = params.getProfileParams();
+	const LLPathParams& path = params.getPathParams();
+	if ((profile.getCurveType() & LL_PCODE_PROFILE_MASK) != LL_PCODE_PROFILE_SQUARE ||
+		profile.getBegin() != 0.f || profile.getEnd() != 1.f || profile.getHollow() != 0.f ||
+		path.getCurveType() != LL_PCODE_PATH_LINE ||
+		path.getBegin() != 0.f || path.getEnd() != 1.f ||
+		path.getScaleX() != 1.f || path.getScaleY() != 1.f ||
+		path.getShearX() != 0.f || path.getShearY() != 0.f ||
+		path.getTwistBegin() != 0.f || path.getTwistEnd() != 0.f)
+	{
+		return FALSE;
+	}
+
+	for (S32 i = 0; i < drawable->getNumFaces(); ++i)
+	{
+		LLFace* face = drawable->getFace(i);
+		if (!face ||
+			face->getPoolType() == LLDrawPool::POOL_ALPHA ||
+			face->getPoolType() == LLDrawPool::POOL_INVISIBLE)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+void LLSoftwareOcclusion::gatherOccluders(LLCullResult& result)
+{
+	typedef std::pair<F32, LLDrawable*> candidate_t;
+	static std::vector<candidate_t> candidates;
+	candidates.clear();
+
+	const LLVector3& eye = LLViewerCamera::getInstance()->getOrigin();
+
+	for (LLCullResult::sg_list_t::iterator iter = result.beginVisibleGroups(); iter != result.endVisibleGroups(); ++iter)
+	{
+		LLSpatialGroup* group = *iter;
+		if (group->isDead() || group->mSpatialPartition->mPartitionType != LLViewerRegion::PARTITION_VOLUME)
+		{
+			continue;
+		}
+
+		for (LLSpatialGroup::element_iter i = group->getData().begin(); i != group->getData().end(); ++i)
+		{
+			LLDrawable* drawable = *i;
+			if (isBoxOccluder(drawable))
+			{
+				// sort key is minus the size on screen, so the largest come first
+				F32 dist = llmax(dist_vec(drawable->getPositionAgent(), eye), 1.f);
+				candidates.push_back(candidate_t(-drawable->getScale().magVec() / dist, drawable));
+			}
+		}
+	}
+
+	if (candidates.size() > MAX_OCCLUDERS)
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + MAX_OCCLUDERS, candidates.end());
+		candidates.resize(MAX_OCCLUDERS);
+	}
+
+	mOccluders.clear();
+	for (std::vector<candidate_t>::iterator iter = candidates.begin(); iter != candidates.end(); ++iter)
+	{
+		mOccluders.push_back(iter->second);
+	}
+}
+
+void LLSoftwareOcclusion::clearOccluders()
+{
+	mOccluders.clear();
+}
+
+void LLSoftwareOcclusion::build(LLCamera& camera, S32 water_clip, BOOL terrain)
+{
+	LLFastTimer t(FTM_SOFTWARE_OCCLUSION);
+	LLTimer timer;
+
+	mValid = FALSE;
+
+	F32 tan_half_fov = tanf(camera.getView() * 0.5f);
+	if (tan_half_fov <= 0.f || camera.getAspect() <= 0.f)
+	{
+		return;
+	}
+
+	mBuffer.clear();
+
+	mOrigin = camera.getOrigin();
+	mAxis[0] = -camera.getLeftAxis();
+	mAxis[1] = camera.getUpAxis();
+	mAxis[2] = camera.getAtAxis();
+	mScaleX = LLOcclusionBuffer::WIDTH * 0.5f / (tan_half_fov * camera.getAspect());
+	mScaleY = LLOcclusionBuffer::HEIGHT * 0.5f / tan_half_fov;
+	mNear = llmax(camera.getNear(), 0.01f);
+	mWaterClip = water_clip;
+
+	if (terrain)
+	{
+		for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin();
+			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
+		{
+			addTerrain(camera, *iter);
+		}
+	}
+
+	static const LLVector3 unit_corners[8] =
+	{
+		LLVector3(-0.5f, -0.5f, -0.5f),
+		LLVector3( 0.5f, -0.5f, -0.5f),
+		LLVector3(-0.5f,  0.5f, -0.5f),
+		LLVector3( 0.5f,  0.5f, -0.5f),
+		LLVector3(-0.5f, -0.5f,  0.5f),
+		LLVector3( 0.5f, -0.5f,  0.5f),
+		LLVector3(-0.5f,  0.5f,  0.5f),
+		LLVector3( 0.5f,  0.5f,  0.5f)
+	};
+
+	for (std::vector<LLPointer<LLDrawable> >::iterator iter = mOccluders.begin(); iter != mOccluders.end(); ++iter)
+	{
+		LLDrawable* drawable = *iter;
+		// the prim may have changed shape since it was gathered
+		if (!isBoxOccluder(drawable))
+		{
+			continue;
+		}
+
+		const LLMatrix4& mat = drawable->getWorldMatrix();
+		LLVector3 corners[8];
+		for (U32 i = 0; i < 8; ++i)
+		{
+			corners[i] = unit_corners[i] * mat;
+		}
+		rasterizeBox(corners, drawable->getRegion());
+	}
+
+	mBuffer.buildHierarchy();
+	mValid = TRUE;
+
+	mBuildTime += timer.getElapsedTimeF64();
+}
+
+void LLSoftwareOcclusion::addTerrain(LLCamera& camera, LLViewerRegion* region)
+{
+	LLSurface& land = region->getLand();
+	const S32 patches = land.getPatchesPerEdge();
+	const F32 patch_size = land.getMetersPerGrid() * land.getGridsPerPatchEdge();
+
+	for (S32 j = 0; j < patches; ++j)
+	{
+		for (S32 i = 0; i < patches; ++i)
+		{
+			LLSurfacePatch* patch = land.resolvePatchRegion((i + 0.5f) * patch_size, (j + 0.5f) * patch_size);
+			if (!patch || !patch->getHasReceivedData())
+			{
+				continue;
+			}
+
+			// Everything below the patch's lowest point is solid ground, and
+			// any ray that passes through solid ground is blocked.
+			LLVector3 min = patch->getOriginAgent();
+			min.mV[VZ] = llmin(patch->getMinZ(), 0.f) - TERRAIN_BOX_DEPTH;
+			LLVector3 max = patch->getOriginAgent() + LLVector3(patch_size, patch_size, 0.f);
+			max.mV[VZ] = patch->getMinZ();
+
+			LLVector3 center = (min + max) * 0.5f;
+			LLVector3 size = (max - min) * 0.5f;
+			if (!camera.AABBInFrustum(center, size))
+			{
+				continue;
+			}
+
+			LLVector3 corners[8];
+			for (U32 k = 0; k < 8; ++k)
+			{
+				corners[k].setVec(k & 1 ? max.mV[VX] : min.mV[VX],
+								k & 2 ? max.mV[VY] : min.mV[VY],
+								k & 4 ? max.mV[VZ] : min.mV[VZ]);
+			}
+			rasterizeBox(corners, region);
+		}
+	}
+}
+
+void LLSoftwareOcclusion::rasterizeBox(const LLVector3* corners, const LLViewerRegion* region)
+{
+	// outward facing quads
+	static const U8 faces[6][4] =
+	{
+		{ 0, 4, 6, 2 },		// -x
+		{ 1, 3, 7, 5 },		// +x
+		{ 0, 1, 5, 4 },		// -y
+		{ 2, 6, 7, 3 },		// +y
+		{ 0, 2, 3, 1 },		// -z
+		{ 4, 5, 7, 6 }		// +z
+	};
+
+	LLVector3 center;
+	for (U32 i = 0; i < 8; ++i)
+	{
+		center += corners[i];
+	}
+	center *= 0.125f;
+
+	// Only the faces towards the eye, they cover the whole silhouette. The
+	// test is done in agent space so it holds for mirrored cameras too.
+	for (U32 i = 0; i < 6; ++i)
+	{
+		LLVector3 quad[4];
+		LLVector3 face_center;
+		for (U32 j = 0; j < 4; ++j)
+		{
+			quad[j] = corners[faces[i][j]];
+			face_center += quad[j];
+		}
+		face_center *= 0.25f;
+
+		if ((mOrigin - face_center) * (face_center - center) > 0.f)
+		{
+			rasterizePolygon(quad, 4, region);
+		}
+	}
+}
+
+void LLSoftwareOcclusion::rasterizePolygon(const LLVector3* verts, U32 count, const LLViewerRegion* region)
+{
+	ClipPlane planes[2];
+	U32 plane_count = 0;
+
+	planes[plane_count].mNormal = mAxis[2];
+	planes[plane_count].mDist = -(mAxis[2] * mOrigin) - mNear;
+	plane_count++;
+
+	if (mWaterClip != 0 && region)
+	{	// the plane updateCull() gives the camera, flipped to keep what it keeps
+		planes[plane_count].mNormal.setVec(0.f, 0.f, (F32) mWaterClip);
+		planes[plane_count].mDist = -mWaterClip * region->getWaterHeight();
+		plane_count++;
+	}
+
+	LLVector3 buffer[2][MAX_CLIPPED_VERTS];
+	const LLVector3* in = verts;
+	U32 in_count = count;
+
+	for (U32 p = 0; p < plane_count; ++p)
+	{
+		const ClipPlane& plane = planes[p];
+		LLVector3* out = buffer[p & 1];
+		U32 out_count = 0;
+
+		for (U32 i = 0; i < in_count; ++i)
+		{
+			const LLVector3& a = in[i];
+			const LLVector3& b = in[(i + 1) % in_count];
+			F32 da = plane.mNormal * a + plane.mDist;
+			F32 db = plane.mNormal * b + plane.mDist;
+
+			if (da >= 0.f)
+			{
+				out[out_count++] = a;
+			}
+			if ((da >= 0.f) != (db >= 0.f))
+			{
+				out[out_count++] = a + (b - a) * (da / (da - db));
+			}
+		}
+
+		if (out_count < 3)
+		{
+			return;
+		}
+		in = out;
+		in_count = out_count;
+	}
+
+	F32 screen[MAX_CLIPPED_VERTS][3];
+	for (U32 i = 0; i < in_count; ++i)
+	{
+		F32 view[3];
+		toView(in[i], view);
+		// clipping leaves points on the near plane, keep them in front of it
+		F32 inv_depth = 1.f / llmax(view[2], mNear);
+		screen[i][0] = view[0] * inv_depth * mScaleX + LLOcclusionBuffer::WIDTH * 0.5f;
+		screen[i][1] = view[1] * inv_depth * mScaleY + LLOcclusionBuffer::HEIGHT * 0.5f;
+		screen[i][2] = inv_depth;
+	}
+
+	for (U32 i = 2; i < in_count; ++i)
+	{
+		mBuffer.rasterizeTriangle(screen[0], screen[i - 1], screen[i]);
+	}
+}
+
+void LLSoftwareOcclusion::toView(const LLVector3& p, F32* out) const
+{
+	LLVector3 v = p - mOrigin;
+	out[0] = v * mAxis[0];
+	out[1] = v * mAxis[1];
+	out[2] = v * mAxis[2];
+}
+
+BOOL LLSoftwareOcclusion::isOccluded(const LLSpatialGroup* group) const
+{
+	if (!mValid)
+	{
+		return FALSE;
+	}
+
+	const LLVector3& center = group->mBounds[0];
+	LLVector3 size = group->mBounds[1] + LLVector3(OCCLUDEE_PAD, OCCLUDEE_PAD, OCCLUDEE_PAD);
+
+	F32 min_x = F32_MAX;
+	F32 min_y = F32_MAX;
+	F32 max_x = -F32_MAX;
+	F32 max_y = -F32_MAX;
+	F32 nearest = 0.f;
+
+	// The projected corners bound the projected box, and the nearest point
+	// of a box is one of its corners.
+	for (U32 i = 0; i < 8; ++i)
+	{
+		LLVector3 corner(center.mV[VX] + (i & 1 ? size.mV[VX] : -size.mV[VX]),
+						center.mV[VY] + (i & 2 ? size.mV[VY] : -size.mV[VY]),
+						center.mV[VZ] + (i & 4 ? size.mV[VZ] : -size.mV[VZ]));
+		F32 view[3];
+		toView(corner, view);
+		if (view[2] < mNear)
+		{
+			return FALSE;
+		}
+
+		F32 inv_depth = 1.f / view[2];
+		F32 x = view[0] * inv_depth * mScaleX + LLOcclusionBuffer::WIDTH * 0.5f;
+		F32 y = view[1] * inv_depth * mScaleY + LLOcclusionBuffer::HEIGHT * 0.5f;
+		min_x = llmin(min_x, x);
+		max_x = llmax(max_x, x);
+		min_y = llmin(min_y, y);
+		max_y = llmax(max_y, y);
+		nearest = llmax(nearest, inv_depth);
+	}
+
+	return mBuffer.isRectOccluded(min_x, min_y, max_x, max_y, nearest);
+}
+
+void LLSoftwareOcclusion::Tally::clear()
+{
+	mOccluded = 0;
+	mGLOccluded = 0;
+	mFalseOccluded = 0;
+	mMissed = 0;
+}
+
+void LLSoftwareOcclusion::Tally::record(BOOL occluded, BOOL gl_occluded)
+{
+	if (occluded)
+	{
+		mOccluded++;
+	}
+	if (gl_occluded)
+	{
+		mGLOccluded++;
+	}
+	if (occluded && !gl_occluded)
+	{
+		mFalseOccluded++;
+	}
+	else if (gl_occluded && !occluded)
+	{
+		mMissed++;
+	}
+}
+
+void LLSoftwareOcclusion::Tally::add(const Tally& other)
+{
+	mOccluded += other.mOccluded;
+	mGLOccluded += other.mGLOccluded;
+	mFalseOccluded += other.mFalseOccluded;
+	mMissed += other.mMissed;
+}
+
+void LLSoftwareOcclusion::updateStats()
+{
+	LLViewerStats* stats = LLViewerStats::getInstance();
+	U32 occluded = mTally.mOccluded;
+	U32 gl_occluded = mTally.mGLOccluded;
+
+	stats->mSoftOccludedStat.addValue((F32) occluded);
+	stats->mSoftOcclusionTimeStat.addValue((F32) (mBuildTime * 1000.0));
+
+	// the comparisons only mean something while the queries run alongside
+	if (sMode == MODE_COMPARE)
+	{
+		stats->mSoftOcclusionFalseStat.addValue(occluded ? 100.f * mTally.mFalseOccluded / occluded : 0.f);
+		stats->mSoftOcclusionMissedStat.addValue(gl_occluded ? 100.f * mTally.mMissed / gl_occluded : 0.f);
+	}
+
+	mTally.clear();
+	mBuildTime = 0.0;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file llsoftwareocclusion.h
+ * @brief Spatial group occlusion tests against a small CPU depth buffer
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSOFTWAREOCCLUSION_H
+#define LL_LLSOFTWAREOCCLUSION_H
+
+#include "llocclusionbuffer.h"
+#include "llpointer.h"
+#include "v3math.h"
+
+#include <vector>
+
+class LLCamera;
+class LLCullResult;
+class LLDrawable;
+class LLSpatialGroup;
+class LLViewerRegion;
+
+// Rasterises the biggest occluders, terrain patches and large opaque box
+// prims, into an LLOcclusionBuffer from the camera position, then tests
+// spatial group bounds against it. Unlike GL occlusion queries the answer
+// is available during the same cull, with no readback.
+//
+// Occluders are conservative: a terrain patch becomes a box whose top is
+// the patch's lowest point, and the buffer never occludes with partly
+// covered texels.
+//
+// The buffer is only valid between build() and invalidate(), which
+// LLPipeline::updateCull() wraps around the partition culls. isOccluded()
+// only reads it and may be called from the cull threads.
+class LLSoftwareOcclusion
+{
+public:
+	enum
+	{
+		MODE_OFF = 0,
+		MODE_CULL,		// replaces occlusion queries for the selected cameras
+		MODE_COMPARE	// occlusion queries cull, the software test keeps stats
+	};
+
+	LLSoftwareOcclusion();
+	~LLSoftwareOcclusion();
+
+	// RenderSoftwareOcclusion and RenderSoftwareOcclusionCameras, a bit per
+	// LLViewerCamera camera ID. Light cameras are orthographic and ignored.
+	static S32 sMode;
+	static U32 sCameraMask;
+
+	static BOOL isEnabledFor(U32 camera_id);
+	// TRUE if occlusion queries are skipped for this camera.
+	static BOOL replacesQueries(U32 camera_id);
+
+	// Keeps the largest box prims from the world camera's cull result as
+	// occluders for the next frame.
+	void gatherOccluders(LLCullResult& result);
+	void clearOccluders();
+
+	// water_clip is as passed to LLPipeline::updateCull(). Occluders are
+	// clipped to the same water plane the camera culls against.
+	void build(LLCamera& camera, S32 water_clip, BOOL terrain);
+	void invalidate()					{ mValid = FALSE; }
+	BOOL isValid() const				{ return mValid; }
+
+	// TRUE if every point of the group's bounds is behind an occluder.
+	BOOL isOccluded(const LLSpatialGroup* group) const;
+
+	// Test counts for the statistics. Culls on the cull threads count into
+	// their own LLCullResult, so the threads never share one.
+	struct Tally
+	{
+		Tally() { clear(); }
+		void clear();
+		// gl_occluded is the occlusion query state of the group, which
+		// lags a frame behind.
+		void record(BOOL occluded, BOOL gl_occluded);
+		void add(const Tally& other);
+
+		U32 mOccluded;
+		U32 mGLOccluded;
+		U32 mFalseOccluded;	// occluded here, visible to the query
+		U32 mMissed;		// visible here, occluded to the query
+	};
+
+	// Main thread only.
+	void recordTest(BOOL occluded, BOOL gl_occluded)	{ mTally.record(occluded, gl_occluded); }
+	void addTally(const Tally& tally)					{ mTally.add(tally); }
+	// Adds this frame's tallies to the viewer stats and clears them.
+	void updateStats();
+
+private:
+	struct ClipPlane
+	{
+		LLVector3 mNormal;
+		F32 mDist;	// keeps points where mNormal * p + mDist >= 0
+	};
+
+	BOOL isBoxOccluder(LLDrawable* drawable) const;
+	void addTerrain(LLCamera& camera, LLViewerRegion* region);
+	// corners are indexed with bit 0 set for +x, bit 1 for +y and bit 2 for +z
+	void rasterizeBox(const LLVector3* corners, const LLViewerRegion* region);
+	void rasterizePolygon(const LLVector3* verts, U32 count, const LLViewerRegion* region);
+
+	// view space x, y and depth of an agent space point
+	void toView(const LLVector3& p, F32* out) const;
+
+	LLOcclusionBuffer mBuffer;
+	BOOL mValid;
+
+	LLVector3 mOrigin;
+	LLVector3 mAxis[3];			// right, up and forward
+	F32 mScaleX;
+	F32 mScaleY;
+	F32 mNear;
+	S32 mWaterClip;
+
+	std::vector<LLPointer<LLDrawable> > mOccluders;
+
+	Tally mTally;
+	F64 mBuildTime;
+};
+
+#endif // LL_LLSOFTWAREOCCLUSION_H
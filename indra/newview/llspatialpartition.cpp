@@ -34,6 +34,7 @@
 #include "llvolume.h"
 #include "llviewercamera.h"
 #include "llface.h"
+#include "llinstancedgeometry.h"
 #include "llviewercontrol.h"
 #include "llviewerregion.h"
 #include "llcamera.h"
@@ -299,6 +300,7 @@ LLSpatialGroup::~LLSpatialGroup()
 	LLMemType mt(LLMemType::MTYPE_SPACE_PARTITION);
 	clearDrawMap();
 	clearAtlasList() ;
+	LLInstancedGeometry::removeUsers(this);
 }
 
 BOOL LLSpatialGroup::hasAtlas(LLTextureAtlas* atlasp)
@@ -426,6 +428,114 @@ LLTextureAtlasSlot* LLSpatialGroup::getCurUpdatingSlot(LLViewerTexture* imagep,
 void LLSpatialGroup::clearDrawMap()
 {
 	mDrawMap.clear();
+	mBatchMap.clear();
+}
+
+LLSpatialGroup::draw_map_t& LLSpatialGroup::getBatchMap()
+{
+	if (mBatchMap.size() == mDrawMap.size())
+	{
+		return mBatchMap;
+	}
+
+	mBatchMap.clear();
+
+	for (draw_map_t::iterator i = mDrawMap.begin(); i != mDrawMap.end(); ++i)
+	{
+		drawmap_elem_t& batches = mBatchMap[i->first];
+		if (i->first == LLRenderPass::PASS_ALPHA)
+		{ //alpha is drawn back to front from mDrawMap, keep it as is
+			batches = i->second;
+			continue;
+		}
+
+		drawmap_elem_t sorted = i->second;
+		std::stable_sort(sorted.begin(), sorted.end(), LLDrawInfo::CompareBatchState());
+
+		for (U32 j = 0; j < sorted.size(); )
+		{
+			U32 k = j+1;
+			while (k < sorted.size() && LLDrawInfo::canBatch(*sorted[j], *sorted[k]))
+			{
+				++k;
+			}
+
+			BOOL instances = FALSE;
+			if (k == j+1)
+			{ //faces drawing the same shared buffer are instances of one another
+				while (k < sorted.size() && LLDrawInfo::canInstance(*sorted[j], *sorted[k]))
+				{
+					++k;
+				}
+				instances = k > j+1;
+			}
+
+			if (k == j+1)
+			{
+				batches.push_back(sorted[j]);
+			}
+			else if (instances)
+			{
+				LLDrawInfo& first = *sorted[j];
+				LLPointer<LLDrawInfo> batch = new LLDrawInfo(first.mStart, first.mEnd, first.mCount, first.mOffset, first.mTexture, first.mVertexBuffer,
+														first.mFullbright, first.mBump, first.mParticle, first.mPartSize);
+				batch->mGroup = first.mGroup;
+				batch->mTextureMatrix = first.mTextureMatrix;
+				batch->mModelMatrix = first.mModelMatrix;
+				batch->mGlowColor = first.mGlowColor;
+				batch->mDrawMode = first.mDrawMode;
+				batch->mInstanced = TRUE;
+				batch->mExtents[0] = first.mExtents[0];
+				batch->mExtents[1] = first.mExtents[1];
+				for (U32 l = j; l < k; ++l)
+				{
+					LLDrawInfo& params = *sorted[l];
+					batch->mVSize = llmax(batch->mVSize, params.mVSize);
+					update_min_max(batch->mExtents[0], batch->mExtents[1], params.mExtents[0]);
+					update_min_max(batch->mExtents[0], batch->mExtents[1], params.mExtents[1]);
+					batch->mInstanceMatrices.push_back(params.mModelMatrix);
+				}
+				batches.push_back(batch);
+			}
+			else
+			{
+				LLDrawInfo& first = *sorted[j];
+				U16 start = first.mStart;
+				U16 end = first.mEnd;
+				U32 count = 0;
+				for (U32 l = j; l < k; ++l)
+				{
+					start = llmin(start, sorted[l]->mStart);
+					end = llmax(end, sorted[l]->mEnd);
+					count += sorted[l]->mCount;
+				}
+
+				LLPointer<LLDrawInfo> batch = new LLDrawInfo(start, end, count, first.mOffset, first.mTexture, first.mVertexBuffer,
+														first.mFullbright, first.mBump, first.mParticle, first.mPartSize);
+				batch->mGroup = first.mGroup;
+				batch->mTextureMatrix = first.mTextureMatrix;
+				batch->mModelMatrix = first.mModelMatrix;
+				batch->mGlowColor = first.mGlowColor;
+				batch->mDrawMode = first.mDrawMode;
+				batch->mExtents[0] = first.mExtents[0];
+				batch->mExtents[1] = first.mExtents[1];
+				for (U32 l = j; l < k; ++l)
+				{
+					LLDrawInfo& params = *sorted[l];
+					batch->mVSize = llmax(batch->mVSize, params.mVSize);
+					update_min_max(batch->mExtents[0], batch->mExtents[1], params.mExtents[0]);
+					update_min_max(batch->mExtents[0], batch->mExtents[1], params.mExtents[1]);
+					batch->mBatchCounts.push_back(params.mCount);
+					batch->mBatchOffsets.push_back(params.mOffset);
+				}
+				batches.push_back(batch);
+			}
+
+			j = k;
+		}
+	}
+
+	return mBatchMap;
 }
 
 BOOL LLSpatialGroup::isRecentlyVisible() const
@@ -532,7 +642,7 @@ void validate_draw_info(LLDrawInfo& params)
 	}
 	
 	//bad indices
-	U16* indicesp = (U16*) params.mVertexBuffer->getIndicesPointer();
+	U16* indicesp = (U16*) params.mVertexBuffer->getMappedIndices();
 	if (indicesp)
 	{
 		for (U32 i = params.mOffset; i < params.mOffset+params.mCount; i++)
@@ -1506,7 +1616,14 @@ BOOL LLSpatialGroup::rebound()
 static LLFastTimer::DeclareTimer FTM_OCCLUSION_READBACK("Readback Occlusion");
 void LLSpatialGroup::checkOcclusion()
 {
-	if (LLPipeline::sUseOcclusion > 1)
+	if (LLSoftwareOcclusion::replacesQueries(LLViewerCamera::sCurCameraID))
+	{	//no queries for this camera, forget what the last ones found
+		if (isOcclusionState(OCCLUDED | QUERY_PENDING))
+		{
+			clearOcclusionState(OCCLUDED | QUERY_PENDING | DISCARD_QUERY);
+		}
+	}
+	else if (LLPipeline::sUseOcclusion > 1)
 	{
 		LLFastTimer t(FTM_OCCLUSION_READBACK);
 		LLSpatialGroup* parent = getParent();
@@ -1553,7 +1670,8 @@ void LLSpatialGroup::checkOcclusion()
 
 void LLSpatialGroup::doOcclusion(LLCamera* camera)
 {
-	if (mSpatialPartition->isOcclusionEnabled() && LLPipeline::sUseOcclusion > 1)
+	if (mSpatialPartition->isOcclusionEnabled() && LLPipeline::sUseOcclusion > 1 &&
+		!LLSoftwareOcclusion::replacesQueries(LLViewerCamera::sCurCameraID))
 	{
 		// Don't cull hole/edge water, unless we have the GL_ARB_depth_clamp extension
 		if ((mSpatialPartition->mDrawableType == LLDrawPool::POOL_VOIDWATER && !gGLManager.mHasDepthClamp) ||
@@ -1761,16 +1879,43 @@ void LLSpatialPartition::shift(const LLVector3 &offset)
 class LLOctreeCull : public LLSpatialGroup::OctreeTraveler
 {
 public:
-	LLOctreeCull(LLCamera* camera)
-		: mCamera(camera), mRes(0) { }
+	LLOctreeCull(LLCamera* camera, LLCullResult* result = NULL)
+		: mCamera(camera), mRes(0), mResult(result) { }
 
 	virtual bool earlyFail(LLSpatialGroup* group)
 	{
 		group->checkOcclusion();
 
-		if (group->mOctreeNode->getParent() &&	//never occlusion cull the root node
-		  	LLPipeline::sUseOcclusion &&			//ignore occlusion if disabled
-			group->isOcclusionState(LLSpatialGroup::OCCLUDED))
+		if (!group->mOctreeNode->getParent())
+		{	//never occlusion cull the root node
+			return false;
+		}
+
+		BOOL gl_occluded = LLPipeline::sUseOcclusion &&			//ignore occlusion if disabled
+							group->isOcclusionState(LLSpatialGroup::OCCLUDED);
+
+		LLSoftwareOcclusion& soft = gPipeline.mSoftwareOcclusion;
+		if (soft.isValid() &&
+			group->mSpatialPartition->mOcclusionEnabled &&
+			!group->mSpatialPartition->isBridge())	//bridge groups are in bridge space
+		{
+			BOOL soft_occluded = soft.isOccluded(group);
+			BOOL replaces_queries = LLSoftwareOcclusion::sMode == LLSoftwareOcclusion::MODE_CULL;
+			if (mResult)
+			{	// may be on a cull thread
+				mResult->getSoftOcclusionTally().record(soft_occluded, replaces_queries ? FALSE : gl_occluded);
+			}
+			else
+			{
+				soft.recordTest(soft_occluded, replaces_queries ? FALSE : gl_occluded);
+			}
+			if (replaces_queries)
+			{
+				return soft_occluded;
+			}
+		}
+
+		if (gl_occluded)
 		{
 			gPipeline.markOccluder(group);
 			return true;
@@ -1856,7 +2001,15 @@ public:
 		{
 			group->doOcclusion(mCamera);
 		}
-		gPipeline.markNotCulled(group, *mCamera);
+
+		if (mResult)
+		{
+			gPipeline.markNotCulled(group, *mCamera, *mResult);
+		}
+		else
+		{
+			gPipeline.markNotCulled(group, *mCamera);
+		}
 	}
 	
 	virtual void visit(const LLSpatialGroup::OctreeNode* branch) 
@@ -1873,13 +2026,14 @@ public:
 
 	LLCamera *mCamera;
 	S32 mRes;
+	LLCullResult* mResult; // NULL to push into the pipeline's cull result
 };
 
 class LLOctreeCullNoFarClip : public LLOctreeCull
 {
 public: 
-	LLOctreeCullNoFarClip(LLCamera* camera) 
-		: LLOctreeCull(camera) { }
+	LLOctreeCullNoFarClip(LLCamera* camera, LLCullResult* result = NULL) 
+		: LLOctreeCull(camera, result) { }
 
 	virtual S32 frustumCheck(const LLSpatialGroup* group)
 	{
@@ -1896,8 +2050,8 @@ public:
 class LLOctreeCullShadow : public LLOctreeCull
 {
 public:
-	LLOctreeCullShadow(LLCamera* camera)
-		: LLOctreeCull(camera) { }
+	LLOctreeCullShadow(LLCamera* camera, LLCullResult* result = NULL)
+		: LLOctreeCull(camera, result) { }
 
 	virtual S32 frustumCheck(const LLSpatialGroup* group)
 	{
@@ -2236,6 +2390,32 @@ S32 LLSpatialPartition::cull(LLCamera &camera, std::vector<LLDrawable *>* result
 	return 0;
 }
 
+void LLSpatialPartition::cull(LLCamera& camera, LLCullResult& result)
+{
+	// Runs on a cull thread: no fast timers or memory type tracking, and
+	// nothing that would issue or read back an occlusion query.
+	llassert(LLPipeline::sUseOcclusion <= 1);
+
+	LLSpatialGroup* group = (LLSpatialGroup*) mOctree->getListener(0);
+	group->rebound();
+
+	if (LLPipeline::sShadowRender)
+	{
+		LLOctreeCullShadow culler(&camera, &result);
+		culler.traverse(mOctree);
+	}
+	else if (mInfiniteFarClip || !LLPipeline::sUseFarClip)
+	{
+		LLOctreeCullNoFarClip culler(&camera, &result);
+		culler.traverse(mOctree);
+	}
+	else
+	{
+		LLOctreeCull culler(&camera, &result);
+		culler.traverse(mOctree);
+	}
+}
+
 BOOL earlyFail(LLCamera* camera, LLSpatialGroup* group)
 {
 	if (camera->getOrigin().isExactlyZero())
@@ -3392,7 +3572,8 @@ LLDrawInfo::LLDrawInfo(U16 start, U16 end, U32 count, U32 offset,
 	mGroup(NULL),
 	mFace(NULL),
 	mDistance(0.f),
-	mDrawMode(LLRender::TRIANGLES)
+	mDrawMode(LLRender::TRIANGLES),
+	mInstanced(FALSE)
 {
 	mDebugColor = (rand() << 16) + rand();
 	if (mStart >= mVertexBuffer->getRequestedVerts() ||
@@ -3408,6 +3589,72 @@ LLDrawInfo::LLDrawInfo(U16 start, U16 end, U32 count, U32 offset,
 	}
 }
 
+bool LLDrawInfo::CompareBatchState::operator()(const LLPointer<LLDrawInfo>& lhs, const LLPointer<LLDrawInfo>& rhs) const
+{
+	if (lhs->mVertexBuffer != rhs->mVertexBuffer)
+	{
+		return lhs->mVertexBuffer.get() < rhs->mVertexBuffer.get();
+	}
+	if (lhs->mTexture != rhs->mTexture)
+	{
+		return lhs->mTexture.get() < rhs->mTexture.get();
+	}
+	if (lhs->mTextureMatrix != rhs->mTextureMatrix)
+	{
+		return lhs->mTextureMatrix < rhs->mTextureMatrix;
+	}
+	if (lhs->mBump != rhs->mBump)
+	{
+		return lhs->mBump < rhs->mBump;
+	}
+	if (lhs->mFullbright != rhs->mFullbright)
+	{
+		return lhs->mFullbright < rhs->mFullbright;
+	}
+	if (lhs->mGlowColor.mV[3] != rhs->mGlowColor.mV[3])
+	{
+		return lhs->mGlowColor.mV[3] < rhs->mGlowColor.mV[3];
+	}
+	//last so instances of one shared buffer end up next to each other
+	if (lhs->mModelMatrix != rhs->mModelMatrix)
+	{
+		return lhs->mModelMatrix < rhs->mModelMatrix;
+	}
+	return lhs->mOffset < rhs->mOffset;
+}
+
+//static
+bool LLDrawInfo::canBatch(const LLDrawInfo& lhs, const LLDrawInfo& rhs)
+{
+	return lhs.mVertexBuffer == rhs.mVertexBuffer &&
+		lhs.mTexture == rhs.mTexture &&
+		lhs.mModelMatrix == rhs.mModelMatrix &&
+		lhs.mTextureMatrix == rhs.mTextureMatrix &&
+		lhs.mBump == rhs.mBump &&
+		lhs.mFullbright == rhs.mFullbright &&
+		lhs.mGlowColor == rhs.mGlowColor &&
+		lhs.mDrawMode == rhs.mDrawMode &&
+		!lhs.mParticle && !rhs.mParticle &&
+		lhs.mBatchCounts.empty() && rhs.mBatchCounts.empty();
+}
+
+//static
+bool LLDrawInfo::canInstance(const LLDrawInfo& lhs, const LLDrawInfo& rhs)
+{
+	return lhs.mInstanced && rhs.mInstanced &&
+		lhs.mVertexBuffer == rhs.mVertexBuffer &&
+		lhs.mTexture == rhs.mTexture &&
+		lhs.mTextureMatrix == rhs.mTextureMatrix &&
+		lhs.mBump == rhs.mBump &&
+		lhs.mFullbright == rhs.mFullbright &&
+		lhs.mGlowColor == rhs.mGlowColor &&
+		lhs.mDrawMode == rhs.mDrawMode &&
+		lhs.mStart == rhs.mStart &&
+		lhs.mEnd == rhs.mEnd &&
+		lhs.mCount == rhs.mCount &&
+		lhs.mOffset == rhs.mOffset;
+}
+
 LLDrawInfo::~LLDrawInfo()	
 {
 	/*if (LLSpatialGroup::sNoDelete)
@@ -3461,6 +3708,49 @@ void LLCullResult::clear()
 		mRenderMapSize[i] = 0;
 		mRenderMapEnd[i] = mRenderMap[i].begin();
 	}
+
+	mSoftOcclusionTally.clear();
+}
+
+void LLCullResult::append(LLCullResult& other)
+{
+	for (sg_list_t::iterator iter = other.beginVisibleGroups(); iter != other.endVisibleGroups(); ++iter)
+	{
+		pushVisibleGroup(*iter);
+	}
+
+	for (sg_list_t::iterator iter = other.beginAlphaGroups(); iter != other.endAlphaGroups(); ++iter)
+	{
+		pushAlphaGroup(*iter);
+	}
+
+	for (sg_list_t::iterator iter = other.beginOcclusionGroups(); iter != other.endOcclusionGroups(); ++iter)
+	{
+		pushOcclusionGroup(*iter);
+	}
+
+	for (sg_list_t::iterator iter = other.beginDrawableGroups(); iter != other.endDrawableGroups(); ++iter)
+	{
+		pushDrawableGroup(*iter);
+	}
+
+	for (drawable_list_t::iterator iter = other.beginVisibleList(); iter != other.endVisibleList(); ++iter)
+	{
+		pushDrawable(*iter);
+	}
+
+	for (bridge_list_t::iterator iter = other.beginVisibleBridge(); iter != other.endVisibleBridge(); ++iter)
+	{
+		pushBridge(*iter);
+	}
+
+	for (U32 i = 0; i < LLRenderPass::NUM_RENDER_TYPES; i++)
+	{
+		for (drawinfo_list_t::iterator iter = other.beginRenderMap(i); iter != other.endRenderMap(i); ++iter)
+		{
+			pushDrawInfo(i, *iter);
+		}
+	}
 }
 
 LLCullResult::sg_list_t::iterator LLCullResult::beginVisibleGroups()
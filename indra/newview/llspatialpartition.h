@@ -38,8 +38,10 @@
 #include "llcubemap.h"
 #include "lldrawpool.h"
 #include "llface.h"
+#include "llsoftwareocclusion.h"
 #include "llviewercamera.h"
 
+#include <deque>
 #include <queue>
 
 #define SG_STATE_INHERIT_MASK (OCCLUDED)
@@ -48,6 +50,7 @@
 class LLSpatialPartition;
 class LLSpatialBridge;
 class LLSpatialGroup;
+class LLCullResult;
 class LLTextureAtlas;
 class LLTextureAtlasSlot;
 
@@ -88,6 +91,25 @@ public:
 	F32 mDistance;
 	LLVector3 mExtents[2];
 	U32 mDrawMode;
+	BOOL mInstanced;	// draws a buffer shared with identical faces, see LLInstancedGeometry
+
+	// Set when this draw info stands for several draw infos of one group
+	// that share all render state: the index ranges to multi draw.
+	std::vector<U32> mBatchCounts;
+	std::vector<U32> mBatchOffsets;
+
+	// Set when this draw info stands for several instanced draw infos of
+	// one group that differ only in model matrix: the matrix of each.
+	std::vector<const LLMatrix4*> mInstanceMatrices;
+
+	// Orders draw infos so those that can share a draw call are adjacent.
+	struct CompareBatchState
+	{
+		bool operator()(const LLPointer<LLDrawInfo>& lhs, const LLPointer<LLDrawInfo>& rhs) const;
+	};
+
+	static bool canBatch(const LLDrawInfo& lhs, const LLDrawInfo& rhs);
+	static bool canInstance(const LLDrawInfo& lhs, const LLDrawInfo& rhs);
 
 	struct CompareTexture
 	{
@@ -243,6 +265,9 @@ public:
 	void clearState(U32 state);	
 	
 	void clearDrawMap();
+	// mDrawMap with the draw infos that can share a draw call merged,
+	// rebuilt after the draw map is cleared.
+	draw_map_t& getBatchMap();
 	void validate();
 	void checkStates();
 	void validateDrawMap();
@@ -350,6 +375,8 @@ public:
 
 	U32 mBufferUsage;
 	draw_map_t mDrawMap;
+	draw_map_t mBatchMap;
+	std::deque<LLMatrix4> mInstanceMatrices; //model matrices of faces drawing from shared buffers
 	
 	S32 mVisible[LLViewerCamera::NUM_CAMERAS];
 	F32 mDistance;
@@ -408,6 +435,9 @@ public:
 
 	BOOL visibleObjectsInFrustum(LLCamera& camera);
 	S32 cull(LLCamera &camera, std::vector<LLDrawable *>* results = NULL, BOOL for_select = FALSE); // Cull on arbitrary frustum
+	// Cull from a cull thread into result instead of the pipeline's cull
+	// result. Only for passes that issue no occlusion queries.
+	void cull(LLCamera& camera, LLCullResult& result);
 	
 	BOOL isVisible(const LLVector3& v);
 	
@@ -452,6 +482,8 @@ public:
 	virtual void updateSpatialExtents();
 	virtual void updateBinRadius();
 	virtual void setVisible(LLCamera& camera_in, std::vector<LLDrawable*>* results = NULL, BOOL for_select = FALSE);
+	// setVisible() from a cull thread, the visible groups go into result.
+	void setVisible(LLCamera& camera_in, LLCullResult& result);
 	virtual void updateDistance(LLCamera& camera_in, bool force_update);
 	virtual void makeActive();
 	virtual void move(LLDrawable *drawablep, LLSpatialGroup *curp, BOOL immediate = FALSE);
@@ -464,6 +496,9 @@ public:
 	virtual LLCamera transformCamera(LLCamera& camera);
 	
 	LLDrawable* mDrawable;
+
+private:
+	BOOL checkVisible(LLCamera& camera_in);
 };
 
 class LLCullResult 
@@ -477,6 +512,9 @@ public:
 	typedef std::vector<LLDrawInfo*> drawinfo_list_t;
 
 	void clear();
+
+	// Pushes everything in other after what is already here.
+	void append(LLCullResult& other);
 	
 	sg_list_t::iterator beginVisibleGroups();
 	sg_list_t::iterator endVisibleGroups();
@@ -514,6 +552,10 @@ public:
 	U32	getVisibleBridgeSize()		{ return mVisibleBridgeSize; }
 	U32	getRenderMapSize(U32 type)	{ return mRenderMapSize[type]; }
 
+	// Software occlusion tests made while culling into this result on a
+	// cull thread.
+	LLSoftwareOcclusion::Tally& getSoftOcclusionTally()	{ return mSoftOcclusionTally; }
+
 	void assertDrawMapsEmpty();
 
 private:
@@ -539,6 +581,7 @@ private:
 	bridge_list_t::iterator mVisibleBridgeEnd;
 	drawinfo_list_t		mRenderMap[LLRenderPass::NUM_RENDER_TYPES];
 	drawinfo_list_t::iterator mRenderMapEnd[LLRenderPass::NUM_RENDER_TYPES];
+	LLSoftwareOcclusion::Tally mSoftOcclusionTally;
 };
 
 
@@ -619,6 +662,8 @@ class LLVolumeGeometryManager: public LLGeometryManager
 	virtual void getGeometry(LLSpatialGroup* group);
 	void genDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces, BOOL distance_sort = FALSE);
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
+	void registerFacePasses(LLSpatialGroup* group, LLFace* facep, U32 mask);
+	void genInstancedDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces);
 };
 
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
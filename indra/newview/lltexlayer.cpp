@@ -29,7 +29,9 @@
 #include "lltexlayer.h"
 
 #include "llagent.h"
+#include "llappviewer.h"
 #include "llimagej2c.h"
+#include "llimageworker.h"
 #include "llimagetga.h"
 #include "llnotificationsutil.h"
 #include "llvfile.h"
@@ -101,6 +103,35 @@ LLBakedUploadData::LLBakedUploadData(const LLVOAvatarSelf* avatar,
 { 
 }
 
+//-----------------------------------------------------------------------------
+// LLBakedEncodeResponder
+// Hands an encoded bake back to its buffer, unless the buffer has since
+// moved on.
+//-----------------------------------------------------------------------------
+class LLBakedEncodeResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLBakedEncodeResponder(LLTexLayerSetBuffer* buffer, BOOL highest_lod) :
+		mBuffer(buffer),
+		mHighestLOD(highest_lod)
+	{
+	}
+
+	/*virtual*/ void completed(bool success, LLImageJ2C* image)
+	{
+		if (mBuffer)
+		{
+			mBuffer->onEncodeComplete(success, image, mHighestLOD);
+		}
+	}
+
+	void cancel() { mBuffer = NULL; }
+
+private:
+	LLTexLayerSetBuffer* mBuffer;
+	const BOOL mHighestLOD;
+};
+
 //-----------------------------------------------------------------------------
 // LLTexLayerSetBuffer
 // The composite image that a LLTexLayerSet writes to.  Each LLTexLayerSet has one.
@@ -127,6 +158,7 @@ LLTexLayerSetBuffer::LLTexLayerSetBuffer(LLTexLayerSet* const owner,
 
 LLTexLayerSetBuffer::~LLTexLayerSetBuffer()
 {
+	cancelEncode();
 	LLTexLayerSetBuffer::sGLByteCount -= getSize();
 	destroyGLTexture();
 	for( S32 order = 0; order < ORDER_COUNT; order++ )
@@ -167,6 +199,7 @@ void LLTexLayerSetBuffer::requestUpdate()
 	// If we're in the middle of uploading a baked texture, we don't care about it any more.
 	// When it's downloaded, ignore it.
 	mUploadID.setNull();
+	cancelEncode();
 }
 
 void LLTexLayerSetBuffer::requestUpload()
@@ -204,6 +237,7 @@ void LLTexLayerSetBuffer::cancelUpload()
 	mNeedsUpload = FALSE;
 	mUploadPending = FALSE;
 	mNeedsUploadTimer.pause();
+	cancelEncode();
 }
 
 void LLTexLayerSetBuffer::pushProjection() const
@@ -354,6 +388,7 @@ BOOL LLTexLayerSetBuffer::uploadInProgress() const
 BOOL LLTexLayerSetBuffer::isReadyToUpload() const
 {
 	if (!gAgentQueryManager.hasNoPendingQueries()) return FALSE; // Can't upload if there are pending queries.
+	if (mEncodeResponder.notNull()) return FALSE; // Still encoding the last bake.
 	if (isAgentAvatarValid() && !gAgentAvatarp->isUsingBakedTextures()) return FALSE; // Don't upload if avatar is using composites.
 
 	// If we requested an upload and have the final LOD ready, then upload.
@@ -455,10 +490,34 @@ void LLTexLayerSetBuffer::doUpload()
 		}
 	}
 	
-	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C;
-	compressedImage->setRate(0.f);
+	delete [] baked_color_data;
+
+	// Interim bakes are replaced by the final one soon, so trade quality
+	// for a faster encode.
+	const BOOL highest_lod = mTexLayerSet->isLocalTextureDataFinal();
+	const S32 tile_size = highest_lod ? gSavedSettings.getS32("ImageEncodeTileSize")
+									  : gSavedSettings.getS32("ImageEncodePreviewTileSize");
 	const char* comment_text = LINDEN_J2C_COMMENT_PREFIX "RGBHM"; // writes into baked_color_data. 5 channels (rgb, heightfield/alpha, mask)
-	if (compressedImage->encode(baked_image, comment_text))
+	cancelEncode();
+	mEncodeResponder = new LLBakedEncodeResponder(this, highest_lod);
+	LLAppViewer::getImageEncodeThread()->encodeImage(baked_image, comment_text, FALSE, !highest_lod,
+													 tile_size, mEncodeResponder);
+}
+
+void LLTexLayerSetBuffer::cancelEncode()
+{
+	if (mEncodeResponder.notNull())
+	{
+		mEncodeResponder->cancel();
+		mEncodeResponder = NULL;
+	}
+}
+
+// Sends the encoded bake out to the server.
+void LLTexLayerSetBuffer::onEncodeComplete(bool success, LLImageJ2C* compressedImage, BOOL highest_lod)
+{
+	mEncodeResponder = NULL;
+	if (success)
 	{
 		LLTransactionID tid;
 		tid.generate();
@@ -511,7 +570,6 @@ void LLTexLayerSetBuffer::doUpload()
 					llinfos << "Baked texture upload via Asset Store." <<  llendl;
 				}
 
-				const BOOL highest_lod = mTexLayerSet->isLocalTextureDataFinal();	
 				if (highest_lod)
 				{
 					// Sending the final LOD for the baked texture.  All done, pause 
@@ -556,8 +614,6 @@ void LLTexLayerSetBuffer::doUpload()
 		mUploadPending = FALSE;
 		llinfos << "Unable to create baked upload file (reason: failed to write file)" << llendl;
 	}
-
-	delete [] baked_color_data;
 }
 
 // Mostly bookkeeping; don't need to actually "do" anything since
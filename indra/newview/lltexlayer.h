@@ -36,11 +36,13 @@ class LLVOAvatar;
 class LLVOAvatarSelf;
 class LLImageTGA;
 class LLImageRaw;
+class LLImageJ2C;
 class LLXmlTreeNode;
 class LLTexLayerSet;
 class LLTexLayerSetInfo;
 class LLTexLayerInfo;
 class LLTexLayerSetBuffer;
+class LLBakedEncodeResponder;
 class LLWearable;
 class LLViewerVisualParam;
 
@@ -304,9 +306,14 @@ public:
 													S32 result, LLExtStat ext_status);
 protected:
 	BOOL					isReadyToUpload() const;
-	void					doUpload(); 					// Does a read back and upload.
+	void					doUpload(); 					// Does a read back and starts encoding it for upload.
 	void					conditionalRestartUploadTimer();
 private:
+	friend class LLBakedEncodeResponder;
+	void					onEncodeComplete(bool success, LLImageJ2C* image, BOOL highest_lod); // Sends the encoded read back.
+	void					cancelEncode();					// Ignores the encode in progress, if any.
+	LLPointer<LLBakedEncodeResponder> mEncodeResponder;		// The encode in progress (null if none).
+
 	BOOL					mNeedsUpload; 					// Whether we need to send our baked textures to the server
 	U32						mNumLowresUploads; 				// Number of times we've sent a lowres version of our baked textures to the server
 	BOOL					mUploadPending; 				// Whether we have received back the new baked textures
@@ -0,0 +1,446 @@
+/**
+ * @file lltexturebudget.cpp
+ * @brief Picks the discard levels of all resident textures against a memory budget
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturebudget.h"
+
+#include "llimage.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+
+// Texels of texture at discard, without mips.
+static F32 texels_at(const LLTextureBudget::Texture& texture, S32 discard)
+{
+	return (F32)llmax(texture.mFullWidth >> discard, 1) * (F32)llmax(texture.mFullHeight >> discard, 1);
+}
+
+// How sharp texture looks at discard, from 0 to 1 once every pixel has a
+// texel of its own.
+static F32 sharpness_at(const LLTextureBudget::Texture& texture, S32 discard)
+{
+	if (texture.mPixelArea <= 0.f)
+	{
+		return 1.f;
+	}
+	return llmin(1.f, sqrtf(texels_at(texture, discard) / texture.mPixelArea));
+}
+
+LLTextureBudget::Texture::Texture()
+:	mID(0),
+	mFullWidth(0),
+	mFullHeight(0),
+	mComponents(0),
+	mPixelArea(0.f),
+	mMinDiscard(0),
+	mMaxDiscard(0),
+	mCurrentDiscard(-1),
+	mTargetDiscard(0)
+{
+}
+
+LLTextureBudget::LLTextureBudget()
+:	mHysteresis(0.25f)
+{
+}
+
+// static
+S64 LLTextureBudget::getBytes(const Texture& texture, S32 discard)
+{
+	// A full mip chain adds a third
+	return (S64)texels_at(texture, discard) * texture.mComponents * 4 / 3;
+}
+
+F32 LLTextureBudget::getBenefit(const Texture& texture, S32 discard) const
+{
+	// Sharpness weighted by the area it is seen over. Going finer than a
+	// texel per pixel is worth nothing.
+	F32 benefit = texture.mPixelArea * (sharpness_at(texture, discard) - sharpness_at(texture, discard + 1));
+	if (texture.mCurrentDiscard >= 0 && discard >= texture.mCurrentDiscard)
+	{
+		// Keeping a level is worth a little even when it can't be seen, so
+		// that spare memory caches it rather than dropping it now and
+		// decoding it again when the texture comes closer.
+		const F32 KEEP_BENEFIT_PER_BYTE = 1.e-6f;
+		benefit = benefit * (1.f + mHysteresis)
+				  + KEEP_BENEFIT_PER_BYTE * (F32)(getBytes(texture, discard) - getBytes(texture, discard + 1));
+	}
+	return benefit;
+}
+
+S64 LLTextureBudget::schedule(texture_list_t& textures, S64 budget_bytes) const
+{
+	// Start every texture at its coarsest level, which it gets regardless
+	S64 total_bytes = 0;
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		Texture& texture = textures[i];
+		texture.mTargetDiscard = llmax(texture.mMaxDiscard, texture.mMinDiscard);
+		total_bytes += getBytes(texture, texture.mTargetDiscard);
+	}
+
+	// Steps to the next finer level, most benefit per byte first
+	typedef std::pair<F32, U32> step_t;
+	std::priority_queue<step_t> steps;
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		const Texture& texture = textures[i];
+		S32 discard = texture.mTargetDiscard - 1;
+		F32 benefit = discard >= texture.mMinDiscard ? getBenefit(texture, discard) : 0.f;
+		if (benefit > 0.f)
+		{
+			steps.push(step_t(benefit / (F32)(getBytes(texture, discard) - getBytes(texture, discard + 1)), i));
+		}
+	}
+
+	while (!steps.empty())
+	{
+		U32 i = steps.top().second;
+		steps.pop();
+
+		Texture& texture = textures[i];
+		S32 discard = texture.mTargetDiscard - 1;
+		S64 cost = getBytes(texture, discard) - getBytes(texture, texture.mTargetDiscard);
+		if (total_bytes + cost > budget_bytes)
+		{
+			// Its finer levels cost even more, but other textures may fit
+			continue;
+		}
+		total_bytes += cost;
+		texture.mTargetDiscard = discard;
+
+		discard--;
+		if (discard >= texture.mMinDiscard)
+		{
+			F32 benefit = getBenefit(texture, discard);
+			if (benefit > 0.f)
+			{
+				steps.push(step_t(benefit / (F32)(getBytes(texture, discard) - getBytes(texture, discard + 1)), i));
+			}
+		}
+	}
+	return total_bytes;
+}
+
+void LLTextureBudget::limitChanges(texture_list_t& textures, S64 max_upload_bytes, S64 max_delete_bytes) const
+{
+	// Benefit per byte of each change, to take uploads from the best and
+	// deletions from the least useful
+	typedef std::pair<F32, U32> change_t;
+	std::vector<change_t> uploads;
+	std::vector<change_t> deletes;
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		const Texture& texture = textures[i];
+		S32 current = texture.mCurrentDiscard;
+		S32 target = texture.mTargetDiscard;
+		if (current >= 0 && target == current)
+		{
+			continue;
+		}
+		S32 finer = current < 0 ? target : llmin(current, target);
+		S32 coarser = current < 0 ? texture.mMaxDiscard + 1 : llmax(current, target);
+		F32 benefit = texture.mPixelArea * (sharpness_at(texture, finer) - sharpness_at(texture, coarser));
+		S64 bytes = getBytes(texture, finer) - (current < 0 ? 0 : getBytes(texture, coarser));
+		F32 value = benefit / (F32)llmax(bytes, (S64)1);
+		if (current < 0 || target < current)
+		{
+			uploads.push_back(change_t(-value, i));
+		}
+		else
+		{
+			deletes.push_back(change_t(value, i));
+		}
+	}
+	std::sort(uploads.begin(), uploads.end());
+	std::sort(deletes.begin(), deletes.end());
+
+	// The first of each always goes ahead, so that no change is too big
+	// to ever happen.
+	S64 uploaded = 0;
+	for (U32 i = 0; i < uploads.size(); i++)
+	{
+		Texture& texture = textures[uploads[i].second];
+		S64 bytes = getBytes(texture, texture.mTargetDiscard)
+					- (texture.mCurrentDiscard < 0 ? 0 : getBytes(texture, texture.mCurrentDiscard));
+		if (i > 0 && uploaded + bytes > max_upload_bytes)
+		{
+			texture.mTargetDiscard = texture.mCurrentDiscard < 0 ? texture.mMaxDiscard : texture.mCurrentDiscard;
+			continue;
+		}
+		uploaded += bytes;
+	}
+
+	S64 deleted = 0;
+	for (U32 i = 0; i < deletes.size(); i++)
+	{
+		Texture& texture = textures[deletes[i].second];
+		S64 bytes = getBytes(texture, texture.mCurrentDiscard) - getBytes(texture, texture.mTargetDiscard);
+		if (i > 0 && deleted + bytes > max_delete_bytes)
+		{
+			texture.mTargetDiscard = texture.mCurrentDiscard;
+			continue;
+		}
+		deleted += bytes;
+	}
+}
+
+// static
+void LLTextureBudget::writeTrace(std::ostream& trace, U32 frame, const texture_list_t& textures)
+{
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		const Texture& texture = textures[i];
+		trace << frame << ' ' << texture.mID << ' '
+			  << texture.mFullWidth << ' ' << texture.mFullHeight << ' ' << texture.mComponents << ' '
+			  << texture.mPixelArea << ' ' << texture.mMinDiscard << ' ' << texture.mMaxDiscard << '\n';
+	}
+}
+
+// static
+bool LLTextureBudget::readTrace(std::istream& trace, U32& frame, texture_list_t& textures)
+{
+	textures.clear();
+	bool have_frame = false;
+	std::string line;
+	while (true)
+	{
+		std::streampos line_start = trace.tellg();
+		if (!std::getline(trace, line))
+		{
+			break;
+		}
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream fields(line);
+		U32 line_frame;
+		Texture texture;
+		fields >> line_frame >> texture.mID >> texture.mFullWidth >> texture.mFullHeight >> texture.mComponents
+			   >> texture.mPixelArea >> texture.mMinDiscard >> texture.mMaxDiscard;
+		if (fields.fail())
+		{
+			llwarns << "Bad texture budget trace line: " << line << llendl;
+			continue;
+		}
+		if (have_frame && line_frame != frame)
+		{
+			// The start of the next frame
+			trace.clear();
+			trace.seekg(line_start);
+			break;
+		}
+		frame = line_frame;
+		have_frame = true;
+		textures.push_back(texture);
+	}
+	return have_frame;
+}
+
+//-----------------------------------------------------------------------------
+
+LLTextureBudgetSimulation::Results::Results()
+:	mFrames(0),
+	mPeakBytes(0),
+	mFramesOverBudget(0),
+	mBytesUploaded(0),
+	mBytesDeleted(0),
+	mReversals(0),
+	mQuality(0.0)
+{
+}
+
+LLTextureBudgetSimulation::LLTextureBudgetSimulation(EPolicy policy, S64 budget_bytes,
+													 S64 max_upload_bytes, S64 max_delete_bytes)
+:	mPolicy(policy),
+	mBudgetBytes(budget_bytes),
+	mMaxUploadBytes(max_upload_bytes),
+	mMaxDeleteBytes(max_delete_bytes),
+	mGreedyBias(0.f)
+{
+}
+
+// Follows LLViewerLODTexture::processTextureStats() and the bias feedback
+// in LLViewerTexture::updateClass().
+void LLTextureBudgetSimulation::scheduleGreedy(LLTextureBudget::texture_list_t& textures, S64 resident_bytes)
+{
+	const F32 BIAS_DELTA = 0.25f;
+	const F32 LOWER_BOUND_SCALE = 0.85f;
+	if (resident_bytes >= mBudgetBytes)
+	{
+		mGreedyBias += BIAS_DELTA;
+	}
+	else if (mGreedyBias > 0.f && resident_bytes < mBudgetBytes * LOWER_BOUND_SCALE)
+	{
+		mGreedyBias -= BIAS_DELTA;
+	}
+	mGreedyBias = llclamp(mGreedyBias, 0.f, (F32)MAX_DISCARD_LEVEL);
+
+	const F32 DISCARD_SCALE = 1.1f;
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		LLTextureBudget::Texture& texture = textures[i];
+		S32 target = texture.mMaxDiscard;
+		if (texture.mPixelArea > 0.f)
+		{
+			F32 discard = logf(texels_at(texture, 0) / texture.mPixelArea) / logf(4.f);
+			discard = floorf((discard + mGreedyBias) * DISCARD_SCALE);
+			target = llclamp((S32)discard, texture.mMinDiscard, texture.mMaxDiscard);
+		}
+		// Finer data is only scaled down while the bias is up
+		if (texture.mCurrentDiscard >= 0 && target > texture.mCurrentDiscard && mGreedyBias <= 0.f)
+		{
+			target = texture.mCurrentDiscard;
+		}
+		texture.mTargetDiscard = target;
+	}
+}
+
+namespace
+{
+	struct Resident
+	{
+		S32 mDiscard;
+		S64 mBytes;
+	};
+	typedef std::map<U32, Resident> resident_map_t;
+
+	struct Change
+	{
+		U32 mFrame;
+		S32 mDirection;		// 1 finer, -1 coarser
+	};
+	typedef std::map<U32, Change> change_map_t;
+}
+
+bool LLTextureBudgetSimulation::run(std::istream& trace, Results& results)
+{
+	// A change undoing one made less than this many frames before counts
+	// as a reversal.
+	const U32 REVERSAL_FRAMES = 60;
+
+	resident_map_t resident;
+	change_map_t changes;
+
+	results = Results();
+	mGreedyBias = 0.f;
+	F64 sharpness = 0.0;
+	F64 area = 0.0;
+
+	LLTextureBudget::texture_list_t textures;
+	U32 frame = 0;
+	while (LLTextureBudget::readTrace(trace, frame, textures))
+	{
+		results.mFrames++;
+
+		S64 resident_bytes = 0;
+		for (U32 i = 0; i < textures.size(); i++)
+		{
+			LLTextureBudget::Texture& texture = textures[i];
+			resident_map_t::iterator iter = resident.find(texture.mID);
+			texture.mCurrentDiscard = iter == resident.end() ? -1 : iter->second.mDiscard;
+			resident_bytes += iter == resident.end() ? 0 : iter->second.mBytes;
+		}
+
+		if (mPolicy == POLICY_BUDGET)
+		{
+			mBudget.schedule(textures, mBudgetBytes);
+		}
+		else
+		{
+			scheduleGreedy(textures, resident_bytes);
+		}
+		mBudget.limitChanges(textures, mMaxUploadBytes, mMaxDeleteBytes);
+
+		// Apply the targets. Textures left out of the frame were unloaded.
+		resident_map_t next;
+		S64 bytes = 0;
+		for (U32 i = 0; i < textures.size(); i++)
+		{
+			const LLTextureBudget::Texture& texture = textures[i];
+			S32 from = texture.mCurrentDiscard;
+			S32 to = texture.mTargetDiscard;
+			S64 to_bytes = LLTextureBudget::getBytes(texture, to);
+			if (from != to)
+			{
+				S64 from_bytes = from < 0 ? 0 : resident[texture.mID].mBytes;
+				S32 direction = (from < 0 || to < from) ? 1 : -1;
+				if (direction > 0)
+				{
+					results.mBytesUploaded += to_bytes - from_bytes;
+				}
+				else
+				{
+					results.mBytesDeleted += from_bytes - to_bytes;
+				}
+
+				change_map_t::iterator last = changes.find(texture.mID);
+				if (last != changes.end() && last->second.mDirection == -direction
+					&& frame - last->second.mFrame <= REVERSAL_FRAMES)
+				{
+					results.mReversals++;
+				}
+				Change& change = changes[texture.mID];
+				change.mFrame = frame;
+				change.mDirection = direction;
+			}
+
+			Resident& entry = next[texture.mID];
+			entry.mDiscard = to;
+			entry.mBytes = to_bytes;
+			bytes += to_bytes;
+
+			if (texture.mPixelArea > 0.f)
+			{
+				sharpness += texture.mPixelArea * sharpness_at(texture, to);
+				area += texture.mPixelArea;
+			}
+		}
+		for (resident_map_t::iterator iter = resident.begin(); iter != resident.end(); ++iter)
+		{
+			if (next.find(iter->first) == next.end())
+			{
+				results.mBytesDeleted += iter->second.mBytes;
+			}
+		}
+		resident.swap(next);
+
+		results.mPeakBytes = llmax(results.mPeakBytes, bytes);
+		if (bytes > mBudgetBytes)
+		{
+			results.mFramesOverBudget++;
+		}
+	}
+
+	results.mQuality = area > 0.0 ? sharpness / area : 1.0;
+	return results.mFrames > 0;
+}
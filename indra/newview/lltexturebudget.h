@@ -0,0 +1,138 @@
+/**
+ * @file lltexturebudget.h
+ * @brief Picks the discard levels of all resident textures against a memory budget
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTUREBUDGET_H
+#define LL_LLTEXTUREBUDGET_H
+
+#include <iosfwd>
+#include <vector>
+
+// Chooses the discard level of every texture at once so that together they
+// fit a memory budget, rather than each texture picking its own and a
+// global bias pushing them all up and down when memory runs out.
+//
+// Each step to a finer level is an item with a cost, its extra bytes, and
+// a benefit, how much sharper the texture gets on screen. Benefits shrink
+// with every step and stop once a texel covers no more than a pixel, so
+// taking the steps with the best benefit per byte first, as long as they
+// fit, solves the knapsack. Levels a texture already has get a bonus, so
+// that small changes in coverage don't decode a texture up only to drop
+// it again.
+class LLTextureBudget
+{
+public:
+	struct Texture
+	{
+		Texture();
+
+		// Input
+		U32 mID;				// the same texture keeps its id across frames
+		S32 mFullWidth;
+		S32 mFullHeight;
+		S32 mComponents;
+		F32 mPixelArea;			// screen pixels covered, as the virtual size
+		S32 mMinDiscard;		// finest level allowed
+		S32 mMaxDiscard;		// coarsest level
+		S32 mCurrentDiscard;	// resident level, -1 for none
+
+		// Output
+		S32 mTargetDiscard;
+	};
+	typedef std::vector<Texture> texture_list_t;
+
+	LLTextureBudget();
+
+	// How much more a step to a level the texture has is worth, 0.25 being
+	// a quarter more.
+	void setHysteresis(F32 hysteresis)		{ mHysteresis = hysteresis; }
+
+	// Sets mTargetDiscard of every texture. Returns the bytes they take.
+	S64 schedule(texture_list_t& textures, S64 budget_bytes) const;
+
+	// Holds back changes to the targets beyond max_upload_bytes of new
+	// texture data and max_delete_bytes of dropped data, best changes
+	// first, so that large changes are spread over several calls.
+	void limitChanges(texture_list_t& textures, S64 max_upload_bytes, S64 max_delete_bytes) const;
+
+	// Memory of a texture at discard, with its mips.
+	static S64 getBytes(const Texture& texture, S32 discard);
+
+	// Traces are text, a line per texture per frame.
+	static void writeTrace(std::ostream& trace, U32 frame, const texture_list_t& textures);
+	// Reads the next frame. Returns false at the end of the trace.
+	static bool readTrace(std::istream& trace, U32& frame, texture_list_t& textures);
+
+private:
+	// Benefit of taking texture from discard + 1 to discard
+	F32 getBenefit(const Texture& texture, S32 discard) const;
+
+	F32 mHysteresis;
+};
+
+// Replays a recorded trace of texture stats headlessly, as if the viewer
+// applied the targets every frame, and measures how well memory was used.
+class LLTextureBudgetSimulation
+{
+public:
+	enum EPolicy
+	{
+		POLICY_BUDGET,			// LLTextureBudget
+		POLICY_GREEDY			// per texture levels and a global bias, as before it
+	};
+
+	struct Results
+	{
+		Results();
+
+		U32 mFrames;
+		S64 mPeakBytes;
+		U32 mFramesOverBudget;
+		S64 mBytesUploaded;
+		S64 mBytesDeleted;
+		U32 mReversals;			// level changes undoing one made shortly before
+		F64 mQuality;			// mean area weighted sharpness, 1 being a texel per pixel
+	};
+
+	LLTextureBudgetSimulation(EPolicy policy, S64 budget_bytes,
+							  S64 max_upload_bytes, S64 max_delete_bytes);
+
+	LLTextureBudget& getBudget()	{ return mBudget; }
+
+	// Returns false if the trace holds no frames.
+	bool run(std::istream& trace, Results& results);
+
+private:
+	void scheduleGreedy(LLTextureBudget::texture_list_t& textures, S64 resident_bytes);
+
+	LLTextureBudget mBudget;
+	EPolicy mPolicy;
+	S64 mBudgetBytes;
+	S64 mMaxUploadBytes;
+	S64 mMaxDeleteBytes;
+	F32 mGreedyBias;
+};
+
+#endif // LL_LLTEXTUREBUDGET_H
@@ -43,6 +43,7 @@
 #include "message.h"
 
 #include "llagent.h"
+#include "llcompressedtexturecache.h"
 #include "lltexturecache.h"
 #include "llviewercontrol.h"
 #include "llviewertexturelist.h"
@@ -120,6 +121,26 @@ private:
 		LLTextureFetchWorker* mWorker; // debug only (may get deleted from under us, use mFetcher/mID)
 	};
 
+	class CompressedReadResponder : public LLCompressedTextureCache::ReadResponder
+	{
+	public:
+		CompressedReadResponder(LLTextureFetch* fetcher, const LLUUID& id)
+			: mFetcher(fetcher), mID(id)
+		{
+		}
+		virtual void completed(LLImageDXT* image, S32 discard)
+		{
+			LLTextureFetchWorker* worker = mFetcher->getWorker(mID);
+			if (worker)
+			{
+				worker->callbackCompressedRead(image, discard);
+			}
+		}
+	private:
+		LLTextureFetch* mFetcher;
+		LLUUID mID;
+	};
+
 	struct Compare
 	{
 		// lhs < rhs
@@ -152,6 +173,7 @@ public:
 						   S32 imagesize, BOOL islocal);
 	void callbackCacheWrite(bool success);
 	void callbackDecoded(bool success, LLImageRaw* raw, LLImageRaw* aux);
+	void callbackCompressedRead(LLImageDXT* image, S32 discard);
 	
 	void setGetStatus(U32 status, const std::string& reason)
 	{
@@ -193,6 +215,7 @@ private:
 		// NOTE: Affects LLTextureBar::draw in lltextureview.cpp (debug hack)
 		INVALID = 0,
 		INIT,
+		LOAD_FROM_COMPRESSED_CACHE,
 		LOAD_FROM_TEXTURE_CACHE,
 		CACHE_POST,
 		LOAD_FROM_NETWORK,
@@ -224,6 +247,7 @@ private:
 	LLPointer<LLImageFormatted> mFormattedImage;
 	LLPointer<LLImageRaw> mRawImage;
 	LLPointer<LLImageRaw> mAuxImage;
+	LLPointer<LLImageDXT> mCompressedImage;	// set instead of mRawImage on a compressed cache hit
 	LLUUID mID;
 	LLHost mHost;
 	std::string mUrl;
@@ -240,6 +264,7 @@ private:
 	LLFrameTimer mFetchTimer;
 	LLTextureCache::handle_t mCacheReadHandle;
 	LLTextureCache::handle_t mCacheWriteHandle;
+	LLCompressedTextureCache::handle_t mCompressedReadHandle;
 	U8* mBuffer;
 	S32 mBufferSize;
 	S32 mRequestedSize;
@@ -256,6 +281,7 @@ private:
 	BOOL mInLocalCache;
 	bool mCanUseHTTP ;
 	bool mCanUseNET ; //can get from asset server.
+	bool mCanUseCompressed ; //the requester can take DXT data instead of raw.
 	S32 mHTTPFailCount;
 	S32 mRetryAttempt;
 	S32 mActiveCount;
@@ -372,6 +398,7 @@ private:
 const char* LLTextureFetchWorker::sStateDescs[] = {
 	"INVALID",
 	"INIT",
+	"LOAD_FROM_COMPRESSED_CACHE",
 	"LOAD_FROM_TEXTURE_CACHE",
 	"CACHE_POST",
 	"LOAD_FROM_NETWORK",
@@ -411,6 +438,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mDecodedDiscard(-1),
 	  mCacheReadHandle(LLTextureCache::nullHandle()),
 	  mCacheWriteHandle(LLTextureCache::nullHandle()),
+	  mCompressedReadHandle(LLCompressedTextureCache::nullHandle()),
 	  mBuffer(NULL),
 	  mBufferSize(0),
 	  mRequestedSize(0),
@@ -426,6 +454,7 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mHaveAllData(FALSE),
 	  mInLocalCache(FALSE),
 	  mCanUseHTTP(true),
+	  mCanUseCompressed(false),
 	  mHTTPFailCount(0),
 	  mRetryAttempt(0),
 	  mActiveCount(0),
@@ -632,6 +661,7 @@ bool LLTextureFetchWorker::doWork(S32 param)
 	if (mState == INIT)
 	{		
 		mRawImage = NULL ;
+		mCompressedImage = NULL;
 		mRequestedDiscard = -1;
 		mLoadedDiscard = -1;
 		mDecodedDiscard = -1;
@@ -649,13 +679,38 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		clearPackets(); // TODO: Shouldn't be necessary
 		mCacheReadHandle = LLTextureCache::nullHandle();
 		mCacheWriteHandle = LLTextureCache::nullHandle();
-		mState = LOAD_FROM_TEXTURE_CACHE;
+		mCompressedReadHandle = LLCompressedTextureCache::nullHandle();
+		if (mCanUseCompressed && mFetcher->mCompressedCache && LLCompressedTextureCache::sEnabled &&
+			mFetcher->mCompressedCache->hasEntry(mID, mDesiredDiscard))
+		{
+			mState = LOAD_FROM_COMPRESSED_CACHE;
+		}
+		else
+		{
+			mState = LOAD_FROM_TEXTURE_CACHE;
+		}
 		mDesiredSize = llmax(mDesiredSize, TEXTURE_CACHE_ENTRY_SIZE); // min desired size is TEXTURE_CACHE_ENTRY_SIZE
 		LL_DEBUGS("TextureFetchWorker") << mID << ": Priority: " << llformat("%8.0f",mImagePriority)
 							 << " Desired Discard: " << mDesiredDiscard << " Desired Size: " << mDesiredSize << LL_ENDL;
 		// fall through
 	}
 
+	if (mState == LOAD_FROM_COMPRESSED_CACHE && !mFetcher->mCompressedCache)
+	{
+		mState = LOAD_FROM_TEXTURE_CACHE; // shutting down
+	}
+	if (mState == LOAD_FROM_COMPRESSED_CACHE)
+	{
+		if (mCompressedReadHandle == LLCompressedTextureCache::nullHandle())
+		{
+			setPriority(LLWorkerThread::PRIORITY_LOW | mWorkPriority); // Set priority first since Responder may change it
+			CompressedReadResponder* responder = new CompressedReadResponder(mFetcher, mID);
+			mCompressedReadHandle = mFetcher->mCompressedCache->readFromCache(mID, mDesiredDiscard, mWorkPriority, responder);
+		}
+		// callbackCompressedRead() moves on to DONE or LOAD_FROM_TEXTURE_CACHE
+		return false;
+	}
+
 	if (mState == LOAD_FROM_TEXTURE_CACHE)
 	{
 		if (mCacheReadHandle == LLTextureCache::nullHandle())
@@ -1495,6 +1550,27 @@ void LLTextureFetchWorker::callbackDecoded(bool success, LLImageRaw* raw, LLImag
 	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 }
 
+void LLTextureFetchWorker::callbackCompressedRead(LLImageDXT* image, S32 discard)
+{
+	LLMutexLock lock(&mWorkMutex);
+	if (mState != LOAD_FROM_COMPRESSED_CACHE)
+	{
+		return;
+	}
+	if (image)
+	{
+		mCompressedImage = image;
+		mDecodedDiscard = discard;
+		mState = DONE;
+		LL_DEBUGS("TextureFetchWorker") << mID << ": Compressed cache hit. Discard: " << discard << LL_ENDL;
+	}
+	else
+	{
+		mState = LOAD_FROM_TEXTURE_CACHE;
+	}
+	setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 bool LLTextureFetchWorker::writeToCacheComplete()
@@ -1523,7 +1599,8 @@ bool LLTextureFetchWorker::writeToCacheComplete()
 //////////////////////////////////////////////////////////////////////////////
 // public
 
-LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded)
+LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLCompressedTextureCache* compressed_cache,
+							   LLImageDecodeThread* imagedecodethread, bool threaded)
 	: LLWorkerThread("TextureFetch", threaded),
 	  mDebugCount(0),
 	  mDebugPause(FALSE),
@@ -1532,6 +1609,7 @@ LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* image
 	  mQueueMutex(getAPRPool()),
 	  mNetworkQueueMutex(getAPRPool()),
 	  mTextureCache(cache),
+	  mCompressedCache(compressed_cache),
 	  mImageDecodeThread(imagedecodethread),
 	  mTextureBandwidth(0),
 	  mHTTPTextureBits(0),
@@ -1549,7 +1627,8 @@ LLTextureFetch::~LLTextureFetch()
 }
 
 bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http)
+								   S32 w, S32 h, S32 c, S32 desired_discard, bool needs_aux, bool can_use_http,
+								   bool can_use_compressed)
 {
 	if (mDebugPause)
 	{
@@ -1612,6 +1691,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->setImagePriority(priority);
 		worker->setDesiredDiscard(desired_discard, desired_size);
 		worker->setCanUseHTTP(can_use_http) ;
+		worker->mCanUseCompressed = can_use_compressed;
 		if (!worker->haveWork())
 		{
 			worker->mState = LLTextureFetchWorker::INIT;
@@ -1635,6 +1715,7 @@ bool LLTextureFetch::createRequest(const std::string& url, const LLUUID& id, con
 		worker->mActiveCount++;
 		worker->mNeedsAux = needs_aux;
 		worker->setCanUseHTTP(can_use_http) ;
+		worker->mCanUseCompressed = can_use_compressed;
 		worker->unlockWorkMutex();
 	}
 	
@@ -1761,7 +1842,8 @@ LLTextureFetchWorker* LLTextureFetch::getWorker(const LLUUID& id)
 
 
 bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
-										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux)
+										LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+										LLPointer<LLImageDXT>& compressed)
 {
 	bool res = false;
 	LLTextureFetchWorker* worker = getWorker(id);
@@ -1786,6 +1868,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 			discard_level = worker->mDecodedDiscard;
 			raw = worker->mRawImage;
 			aux = worker->mAuxImage;
+			compressed = worker->mCompressedImage;
 			res = true;
 			LL_DEBUGS("TextureFetch") << id << ": Request Finished. State: " << worker->mState << " Discard: " << discard_level << LL_ENDL;
 			worker->unlockWorkMutex();
@@ -1801,6 +1884,7 @@ bool LLTextureFetch::getRequestFinished(const LLUUID& id, S32& discard_level,
 				discard_level = worker->mDecodedDiscard;
 				raw = worker->mRawImage;
 				aux = worker->mAuxImage;
+				compressed = worker->mCompressedImage;
 			}
 			worker->unlockWorkMutex();
 		}
@@ -1874,6 +1958,16 @@ void LLTextureFetch::shutDownTextureCacheThread()
 	}
 }
 	
+//called in the MAIN thread after the compressed texture cache shuts down.
+void LLTextureFetch::shutDownCompressedCacheThread() 
+{
+	if(mCompressedCache)
+	{
+		llassert_always(mCompressedCache->isQuitting() || mCompressedCache->isStopped()) ;
+		mCompressedCache = NULL ;
+	}
+}
+
 //called in the MAIN thread after the ImageDecodeThread shuts down.
 void LLTextureFetch::shutDownImageDecodeThread() 
 {
@@ -38,7 +38,9 @@ class LLViewerTexture;
 class LLTextureFetchWorker;
 class HTTPGetResponder;
 class LLTextureCache;
+class LLCompressedTextureCache;
 class LLImageDecodeThread;
+class LLImageDXT;
 class LLHost;
 
 // Interface class
@@ -48,18 +50,24 @@ class LLTextureFetch : public LLWorkerThread
 	friend class HTTPGetResponder;
 	
 public:
-	LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded);
+	LLTextureFetch(LLTextureCache* cache, LLCompressedTextureCache* compressed_cache,
+				   LLImageDecodeThread* imagedecodethread, bool threaded);
 	~LLTextureFetch();
 
 	/*virtual*/ S32 update(U32 max_time_ms);	
 	void shutDownTextureCacheThread() ; //called in the main thread after the TextureCacheThread shuts down.
 	void shutDownImageDecodeThread() ;  //called in the main thread after the ImageDecodeThread shuts down.
+	void shutDownCompressedCacheThread() ; //called in the main thread after the compressed cache shuts down.
 
 	bool createRequest(const std::string& url, const LLUUID& id, const LLHost& host, F32 priority,
-					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http);
+					   S32 w, S32 h, S32 c, S32 discard, bool needs_aux, bool can_use_http,
+					   bool can_use_compressed = false);
 	void deleteRequest(const LLUUID& id, bool cancel);
+	// compressed is set instead of raw when the image came from the
+	// compressed texture cache.
 	bool getRequestFinished(const LLUUID& id, S32& discard_level,
-							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux);
+							LLPointer<LLImageRaw>& raw, LLPointer<LLImageRaw>& aux,
+							LLPointer<LLImageDXT>& compressed);
 	bool updateRequestPriority(const LLUUID& id, F32 priority);
 
 	bool receiveImageHeader(const LLHost& host, const LLUUID& id, U8 codec, U16 packets, U32 totalbytes, U16 data_size, U8* data);
@@ -111,6 +119,7 @@ private:
 	LLMutex mNetworkQueueMutex; //to protect mNetworkQueue, mHTTPTextureQueue and mCancelQueue.
 
 	LLTextureCache* mTextureCache;
+	LLCompressedTextureCache* mCompressedCache;
 	LLImageDecodeThread* mImageDecodeThread;
 	LLCurlRequest* mCurlGetRequest;
 	
@@ -43,8 +43,10 @@
 //#include "llfirstuse.h"
 #include "llhudmanager.h"
 #include "llimagebmp.h"
+#include "llinstancedgeometry.h"
 #include "llmemory.h"
 #include "llselectmgr.h"
+#include "llsettingsindex.h"
 #include "llsky.h"
 #include "llstartup.h"
 #include "lltoolfocus.h"
@@ -189,7 +191,7 @@ void display_update_camera()
 // Write some stats to llinfos
 void display_stats()
 {
-	F32 fps_log_freq = gSavedSettings.getF32("FPSLogFrequency");
+	F32 fps_log_freq = gSettingsIndex.getF32(SETTING_FPSLogFrequency);
 	if (fps_log_freq > 0.f && gRecentFPSTime.getElapsedTimeF32() >= fps_log_freq)
 	{
 		F32 fps = gRecentFrameCount / fps_log_freq;
@@ -197,7 +199,7 @@ void display_stats()
 		gRecentFrameCount = 0;
 		gRecentFPSTime.reset();
 	}
-	F32 mem_log_freq = gSavedSettings.getF32("MemoryLogFrequency");
+	F32 mem_log_freq = gSettingsIndex.getF32(SETTING_MemoryLogFrequency);
 	if (mem_log_freq > 0.f && gRecentMemoryTime.getElapsedTimeF32() >= mem_log_freq)
 	{
 		gMemoryAllocated = LLMemory::getCurrentRSS();
@@ -334,8 +336,8 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 
 	LLImageGL::updateStats(gFrameTimeSeconds);
 	
-	LLVOAvatar::sRenderName = gSavedSettings.getS32("AvatarNameTagMode");
-	LLVOAvatar::sRenderGroupTitles = (gSavedSettings.getBOOL("NameTagShowGroupTitles") && gSavedSettings.getS32("AvatarNameTagMode"));
+	LLVOAvatar::sRenderName = gSettingsIndex.getS32(SETTING_AvatarNameTagMode);
+	LLVOAvatar::sRenderGroupTitles = (gSettingsIndex.getBOOL(SETTING_NameTagShowGroupTitles) && gSettingsIndex.getS32(SETTING_AvatarNameTagMode));
 	
 	gPipeline.mBackfaceCull = TRUE;
 	gFrameCount++;
@@ -613,7 +615,7 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 		LLPipeline::sUseOcclusion = 
 				(!gUseWireframe
 				&& LLFeatureManager::getInstance()->isFeatureAvailable("UseOcclusion") 
-				&& gSavedSettings.getBOOL("UseOcclusion") 
+				&& gSettingsIndex.getBOOL(SETTING_UseOcclusion) 
 				&& gGLManager.mHasOcclusionQuery) ? 2 : 0;
 
 		if (LLPipeline::sUseOcclusion && LLPipeline::sRenderDeferred)
@@ -621,11 +623,13 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 			LLPipeline::sUseOcclusion = 3;
 		}
 
-		LLPipeline::sAutoMaskAlphaDeferred = gSavedSettings.getBOOL("RenderAutoMaskAlphaDeferred");
-		LLPipeline::sAutoMaskAlphaNonDeferred = gSavedSettings.getBOOL("RenderAutoMaskAlphaNonDeferred");
-		LLPipeline::sUseFarClip = gSavedSettings.getBOOL("RenderUseFarClip");
-		LLVOAvatar::sMaxVisible = (U32)gSavedSettings.getS32("RenderAvatarMaxVisible");
-		LLPipeline::sDelayVBUpdate = gSavedSettings.getBOOL("RenderDelayVBUpdate");
+		LLPipeline::sAutoMaskAlphaDeferred = gSettingsIndex.getBOOL(SETTING_RenderAutoMaskAlphaDeferred);
+		LLPipeline::sAutoMaskAlphaNonDeferred = gSettingsIndex.getBOOL(SETTING_RenderAutoMaskAlphaNonDeferred);
+		LLPipeline::sUseFarClip = gSettingsIndex.getBOOL(SETTING_RenderUseFarClip);
+		LLVOAvatar::sMaxVisible = (U32)gSettingsIndex.getS32(SETTING_RenderAvatarMaxVisible);
+		LLPipeline::sDelayVBUpdate = gSettingsIndex.getBOOL(SETTING_RenderDelayVBUpdate);
+		LLSoftwareOcclusion::sMode = gSettingsIndex.getS32(SETTING_RenderSoftwareOcclusion);
+		LLSoftwareOcclusion::sCameraMask = gSettingsIndex.getU32(SETTING_RenderSoftwareOcclusionCameras);
 
 		S32 occlusion = LLPipeline::sUseOcclusion;
 		if (gDepthDirty)
@@ -643,6 +647,11 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 		gPipeline.updateCull(*LLViewerCamera::getInstance(), result, water_clip);
 		stop_glerror();
 
+		if (LLSoftwareOcclusion::sMode != LLSoftwareOcclusion::MODE_OFF)
+		{
+			gPipeline.mSoftwareOcclusion.gatherOccluders(result);
+		}
+
 		LLGLState::checkStates();
 		LLGLState::checkTextureChannels();
 		LLGLState::checkClientArrays();
@@ -658,6 +667,8 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 			{
  				LLFastTimer ftm(FTM_CLIENT_COPY);
 				LLVertexBuffer::clientCopy(0.016);
+				LLVertexBuffer::updateSlabs();
+				LLInstancedGeometry::updateClass();
 			}
 
 			if (gResizeScreenTexture)
@@ -951,7 +962,7 @@ void render_hud_attachments()
 		hud_cam.setAxes(LLVector3(1,0,0), LLVector3(0,1,0), LLVector3(0,0,1));
 		LLViewerCamera::updateFrustumPlanes(hud_cam, TRUE);
 
-		bool render_particles = gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_PARTICLES) && gSavedSettings.getBOOL("RenderHUDParticles");
+		bool render_particles = gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_PARTICLES) && gSettingsIndex.getBOOL(SETTING_RenderHUDParticles);
 		
 		//only render hud objects
 		gPipeline.pushRenderTypeMask();
@@ -1277,7 +1288,7 @@ void render_ui_3d()
 	// Debugging stuff goes before the UI.
 
 	// Coordinate axes
-	if (gSavedSettings.getBOOL("ShowAxes"))
+	if (gSettingsIndex.getBOOL(SETTING_ShowAxes))
 	{
 		draw_axes();
 	}
@@ -1335,7 +1346,7 @@ void render_ui_2d()
 	}
 	
 
-	if (gSavedSettings.getBOOL("RenderUIBuffer"))
+	if (gSettingsIndex.getBOOL(SETTING_RenderUIBuffer))
 	{
 		if (LLUI::sDirty)
 		{
@@ -34,6 +34,7 @@
 #include "llinventorypanel.h"
 #include "llnotifications.h"
 #include "llnotificationsutil.h"
+#include "lltexteditor.h"
 
 // newview includes
 #include "llagent.h"
@@ -3383,6 +3384,58 @@ void handle_dump_focus()
 	llinfos << "Keyboard focus " << (ctrl ? ctrl->getName() : "(none)") << llendl;
 }
 
+// Appends a long styled chat transcript to an offscreen text editor, laying
+// it out every few lines as the chat floaters would, then resizes it, and
+// logs how long each took.
+void handle_text_append_benchmark()
+{
+	const S32 NUM_LINES = 100000;
+	const S32 LINES_PER_FRAME = 10;
+
+	LLTextEditor::Params params;
+	params.name("text_append_benchmark");
+	params.rect(LLRect(0, 400, 500, 0));
+	params.wrap(true);
+	params.read_only(true);
+	params.track_end(true);
+	params.parse_urls(false);
+	params.max_text_length(S32_MAX);
+	LLTextEditor* editor = LLUICtrlFactory::create<LLTextEditor>(params);
+
+	LLStyle::Params name_style;
+	name_style.color(LLColor4::yellow);
+	LLStyle::Params text_style;
+	text_style.color(LLColor4::white);
+
+	LLTimer timer;
+	F32 worst_frame = 0.f;
+	F32 frame_start = 0.f;
+	for (S32 i = 0; i < NUM_LINES; ++i)
+	{
+		editor->appendText(llformat("Resident %d: ", i % 50), i > 0, name_style);
+		editor->appendText("the quick brown fox jumps over the lazy dog and back again", false, text_style);
+		if (i % LINES_PER_FRAME == LINES_PER_FRAME - 1)
+		{
+			editor->getTextBoundingRect();
+			F32 now = timer.getElapsedTimeF32();
+			worst_frame = llmax(worst_frame, now - frame_start);
+			frame_start = now;
+		}
+	}
+	F32 append_time = timer.getElapsedTimeF32();
+
+	timer.reset();
+	editor->reshape(300, 400);
+	editor->getTextBoundingRect();
+	F32 resize_time = timer.getElapsedTimeF32();
+
+	llinfos << "Appended " << NUM_LINES << " lines in " << append_time << "s, slowest "
+		<< LINES_PER_FRAME << " lines " << worst_frame * 1000.f << "ms, resized in "
+		<< resize_time * 1000.f << "ms, " << editor->getLineCount() << " lines laid out" << llendl;
+
+	delete editor;
+}
+
 class LLSelfStandUp : public view_listener_t
 {
 	bool handleEvent(const LLSD& userdata)
@@ -8081,6 +8134,7 @@ void initialize_menus()
 	view_listener_t::addMenu(new LLAdvancedDumpInventory(), "Advanced.DumpInventory");
 	commit.add("Advanced.DumpTimers", boost::bind(&handle_dump_timers) );
 	commit.add("Advanced.DumpFocusHolder", boost::bind(&handle_dump_focus) );
+	commit.add("Advanced.TextAppendBenchmark", boost::bind(&handle_text_append_benchmark) );
 	view_listener_t::addMenu(new LLAdvancedPrintSelectedObjectInfo(), "Advanced.PrintSelectedObjectInfo");
 	view_listener_t::addMenu(new LLAdvancedPrintAgentInfo(), "Advanced.PrintAgentInfo");
 	view_listener_t::addMenu(new LLAdvancedPrintTextureMemoryStats(), "Advanced.PrintTextureMemoryStats");
@@ -471,6 +471,29 @@ void handle_compress_image(void*)
 	}
 }
 
+// What upload_new_resource() needs once the file to upload is written.
+struct LLUploadFileParams
+{
+	std::string mSrcFilename;
+	std::string mFilename;		// the file to upload
+	LLAssetType::EType mAssetType;
+	std::string mName;
+	std::string mDesc;
+	S32 mCompressionInfo;
+	LLFolderType::EType mDestinationFolderType;
+	LLInventoryType::EType mInvType;
+	U32 mNextOwnerPerms;
+	U32 mGroupPerms;
+	U32 mEveryonePerms;
+	std::string mDisplayName;
+	LLAssetStorage::LLStoreAssetCallback mCallback;
+	S32 mExpectedUploadCost;
+	void* mUserdata;
+};
+
+static void upload_new_resource_file(const LLUploadFileParams& params, BOOL error, std::string error_message);
+static void upload_image_file_created(const LLUploadFileParams& params, BOOL success);
+
 void upload_new_resource(const std::string& src_filename, std::string name,
 			 std::string desc, S32 compression_info,
 			 LLFolderType::EType destination_folder_type,
@@ -485,13 +508,12 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 {	
 	// Generate the temporary UUID.
 	std::string filename = gDirUtilp->getTempFilename();
-	LLTransactionID tid;
-	LLAssetID uuid;
 	
 	LLSD args;
 
 	std::string exten = gDirUtilp->getExtension(src_filename);
 	LLAssetType::EType asset_type = LLAssetType::AT_NONE;
+	U8 image_codec = IMG_CODEC_INVALID;
 	std::string error_message;
 
 	BOOL error = FALSE;
@@ -511,63 +533,23 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 	else if( exten == "bmp")
 	{
 		asset_type = LLAssetType::AT_TEXTURE;
-		if (!LLViewerTextureList::createUploadFile(src_filename,
-												 filename,
-												 IMG_CODEC_BMP ))
-		{
-			error_message = llformat( "Problem with file %s:\n\n%s\n",
-					src_filename.c_str(), LLImage::getLastError().c_str());
-			args["FILE"] = src_filename;
-			args["ERROR"] = LLImage::getLastError();
-			upload_error(error_message, "ProblemWithFile", filename, args);
-			return;
-		}
+		image_codec = IMG_CODEC_BMP;
 	}
 	else if( exten == "tga")
 	{
 		asset_type = LLAssetType::AT_TEXTURE;
-		if (!LLViewerTextureList::createUploadFile(src_filename,
-												 filename,
-												 IMG_CODEC_TGA ))
-		{
-			error_message = llformat("Problem with file %s:\n\n%s\n",
-					src_filename.c_str(), LLImage::getLastError().c_str());
-			args["FILE"] = src_filename;
-			args["ERROR"] = LLImage::getLastError();
-			upload_error(error_message, "ProblemWithFile", filename, args);
-			return;
-		}
+		image_codec = IMG_CODEC_TGA;
 	}
 	else if( exten == "jpg" || exten == "jpeg")
 	{
 		asset_type = LLAssetType::AT_TEXTURE;
-		if (!LLViewerTextureList::createUploadFile(src_filename,
-												 filename,
-												 IMG_CODEC_JPEG ))
-		{
-			error_message = llformat("Problem with file %s:\n\n%s\n",
-					src_filename.c_str(), LLImage::getLastError().c_str());
-			args["FILE"] = src_filename;
-			args["ERROR"] = LLImage::getLastError();
-			upload_error(error_message, "ProblemWithFile", filename, args);
-			return;
-		}
+		image_codec = IMG_CODEC_JPEG;
+	}
+	else if( exten == "png")
+	{
+		asset_type = LLAssetType::AT_TEXTURE;
+		image_codec = IMG_CODEC_PNG;
 	}
- 	else if( exten == "png")
- 	{
- 		asset_type = LLAssetType::AT_TEXTURE;
- 		if (!LLViewerTextureList::createUploadFile(src_filename,
- 												 filename,
- 												 IMG_CODEC_PNG ))
- 		{
- 			error_message = llformat("Problem with file %s:\n\n%s\n",
- 					src_filename.c_str(), LLImage::getLastError().c_str());
- 			args["FILE"] = src_filename;
- 			args["ERROR"] = LLImage::getLastError();
- 			upload_error(error_message, "ProblemWithFile", filename, args);
- 			return;
- 		}
- 	}
 	else if(exten == "wav")
 	{
 		asset_type = LLAssetType::AT_SOUND;  // tag it as audio
@@ -726,6 +708,41 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 		error = TRUE;;
 	}
 
+	LLUploadFileParams params;
+	params.mSrcFilename = src_filename;
+	params.mFilename = filename;
+	params.mAssetType = asset_type;
+	params.mName = name;
+	params.mDesc = desc;
+	params.mCompressionInfo = compression_info;
+	params.mDestinationFolderType = destination_folder_type;
+	params.mInvType = inv_type;
+	params.mNextOwnerPerms = next_owner_perms;
+	params.mGroupPerms = group_perms;
+	params.mEveryonePerms = everyone_perms;
+	params.mDisplayName = display_name;
+	params.mCallback = callback;
+	params.mExpectedUploadCost = expected_upload_cost;
+	params.mUserdata = userdata;
+
+	if (!error && image_codec != IMG_CODEC_INVALID)
+	{
+		// Encoding can take seconds, so it finishes on the image encode thread
+		LLViewerTextureList::createUploadFileAsync(src_filename, filename, image_codec,
+												   boost::bind(&upload_image_file_created, params, _1));
+		return;
+	}
+
+	upload_new_resource_file(params, error, error_message);
+}
+
+// Copies the file written for params into the VFS and uploads it.
+static void upload_new_resource_file(const LLUploadFileParams& params, BOOL error, std::string error_message)
+{
+	LLTransactionID tid;
+	LLAssetID uuid;
+	const std::string& filename = params.mFilename;
+
 	// gen a new transaction ID for this asset
 	tid.generate();
 
@@ -738,7 +755,7 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 		infile.open(filename, LL_APR_RB, NULL, &file_size);
 		if (infile.getFileHandle())
 		{
-			LLVFile file(gVFS, uuid, asset_type, LLVFile::WRITE);
+			LLVFile file(gVFS, uuid, params.mAssetType, LLVFile::WRITE);
 
 			file.setMaxSize(file_size);
 
@@ -758,14 +775,14 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 
 	if (!error)
 	{
-		std::string t_disp_name = display_name;
+		std::string t_disp_name = params.mDisplayName;
 		if (t_disp_name.empty())
 		{
-			t_disp_name = src_filename;
+			t_disp_name = params.mSrcFilename;
 		}
-		upload_new_resource(tid, asset_type, name, desc, compression_info, // tid
-				    destination_folder_type, inv_type, next_owner_perms, group_perms, everyone_perms,
-				    display_name, callback, expected_upload_cost, userdata);
+		upload_new_resource(tid, params.mAssetType, params.mName, params.mDesc, params.mCompressionInfo, // tid
+				    params.mDestinationFolderType, params.mInvType, params.mNextOwnerPerms, params.mGroupPerms, params.mEveryonePerms,
+				    params.mDisplayName, params.mCallback, params.mExpectedUploadCost, params.mUserdata);
 	}
 	else
 	{
@@ -781,6 +798,21 @@ void upload_new_resource(const std::string& src_filename, std::string name,
 	}
 }
 
+static void upload_image_file_created(const LLUploadFileParams& params, BOOL success)
+{
+	if (!success)
+	{
+		std::string error_message = llformat("Problem with file %s:\n\n%s\n",
+				params.mSrcFilename.c_str(), LLImage::getLastError().c_str());
+		LLSD args;
+		args["FILE"] = params.mSrcFilename;
+		args["ERROR"] = LLImage::getLastError();
+		upload_error(error_message, "ProblemWithFile", params.mFilename, args);
+		return;
+	}
+	upload_new_resource_file(params, FALSE, LLStringUtil::null);
+}
+
 void upload_done_callback(const LLUUID& uuid, void* user_data, S32 result, LLExtStat ext_status) // StoreAssetData callback (fixed)
 {
 	LLResourceData* data = (LLResourceData*)user_data;
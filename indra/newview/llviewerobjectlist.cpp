@@ -245,6 +245,7 @@ void LLViewerObjectList::processUpdateCore(LLViewerObject* objectp,
 	}
 
 	updateActive(objectp);
+	dirtyMapObject(objectp);
 
 	if (just_created) 
 	{
@@ -757,6 +758,7 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 			else
 			{
 				num_active_objects++;
+				dirtyMapObject(objectp);
 			}
 		}
 		for (std::vector<LLViewerObject*>::iterator kill_iter = kill_list.begin();
@@ -1084,83 +1086,119 @@ void LLViewerObjectList::shiftObjects(const LLVector3 &offset)
 	LLWorld::getInstance()->shiftRegions(offset);
 }
 
-void LLViewerObjectList::renderObjectsForMap(LLNetMap &netmap)
+void LLViewerObjectList::addToMap(LLViewerObject *objectp)
 {
-	LLColor4 above_water_color = LLUIColorTable::instance().getColor( "NetMapOtherOwnAboveWater" );
-	LLColor4 below_water_color = LLUIColorTable::instance().getColor( "NetMapOtherOwnBelowWater" );
-	LLColor4 you_own_above_water_color = 
+	mMapObjects.push_back(objectp);
+	LLNetMap::dirtyObject(objectp);
+}
+
+void LLViewerObjectList::removeFromMap(LLViewerObject *objectp)
+{
+	std::vector<LLPointer<LLViewerObject> >::iterator iter = std::find(mMapObjects.begin(), mMapObjects.end(), objectp);
+	if (iter != mMapObjects.end())
+	{
+		mMapObjects.erase(iter);
+	}
+	LLNetMap::removeObject(objectp);
+}
+
+void LLViewerObjectList::dirtyMapObject(LLViewerObject* objectp)
+{
+	if (objectp->isOnMap())
+	{
+		LLNetMap::dirtyObject(objectp);
+	}
+
+	// Children move with their parent without updates of their own
+	if (!objectp->isAvatar())
+	{
+		LLViewerObject::const_child_list_t& children = objectp->getChildren();
+		for (LLViewerObject::child_list_t::const_iterator iter = children.begin(); iter != children.end(); ++iter)
+		{
+			dirtyMapObject(*iter);
+		}
+	}
+}
+
+void LLViewerObjectList::addObjectsToMap(LLNetMap &netmap)
+{
+	for (vobj_list_t::iterator iter = mMapObjects.begin(); iter != mMapObjects.end(); ++iter)
+	{
+		netmap.addObject(*iter);
+	}
+}
+
+BOOL LLViewerObjectList::getMapDot(LLViewerObject* objectp, LLVector3d& pos_global, F32& radius, LLColor4U& color)
+{
+	static LLUIColor above_water_color = LLUIColorTable::instance().getColor( "NetMapOtherOwnAboveWater" );
+	static LLUIColor below_water_color = LLUIColorTable::instance().getColor( "NetMapOtherOwnBelowWater" );
+	static LLUIColor you_own_above_water_color = 
 						LLUIColorTable::instance().getColor( "NetMapYouOwnAboveWater" );
-	LLColor4 you_own_below_water_color = 
+	static LLUIColor you_own_below_water_color = 
 						LLUIColorTable::instance().getColor( "NetMapYouOwnBelowWater" );
-	LLColor4 group_own_above_water_color = 
+	static LLUIColor group_own_above_water_color = 
 						LLUIColorTable::instance().getColor( "NetMapGroupOwnAboveWater" );
-	LLColor4 group_own_below_water_color = 
+	static LLUIColor group_own_below_water_color = 
 						LLUIColorTable::instance().getColor( "NetMapGroupOwnBelowWater" );
 
-	F32 max_radius = gSavedSettings.getF32("MiniMapPrimMaxRadius");
+	static LLCachedControl<F32> max_radius(gSavedSettings, "MiniMapPrimMaxRadius");
 
-	for (vobj_list_t::iterator iter = mMapObjects.begin(); iter != mMapObjects.end(); ++iter)
+	if (objectp->isDead() || !objectp->getRegion() || objectp->isOrphaned() || objectp->isAttachment())
 	{
-		LLViewerObject* objectp = *iter;
-		if (!objectp->getRegion() || objectp->isOrphaned() || objectp->isAttachment())
-		{
-			continue;
-		}
-		const LLVector3& scale = objectp->getScale();
-		const LLVector3d pos = objectp->getPositionGlobal();
-		const F64 water_height = F64( objectp->getRegion()->getWaterHeight() );
-		// LLWorld::getInstance()->getWaterHeight();
+		return FALSE;
+	}
+	const LLVector3& scale = objectp->getScale();
+	pos_global = objectp->getPositionGlobal();
+	const F64 water_height = F64( objectp->getRegion()->getWaterHeight() );
+	// LLWorld::getInstance()->getWaterHeight();
 
-		F32 approx_radius = (scale.mV[VX] + scale.mV[VY]) * 0.5f * 0.5f * 1.3f;  // 1.3 is a fudge
+	F32 approx_radius = (scale.mV[VX] + scale.mV[VY]) * 0.5f * 0.5f * 1.3f;  // 1.3 is a fudge
 
-		// Limit the size of megaprims so they don't blot out everything on the minimap.
-		// Attempting to draw very large megaprims also causes client lag.
-		// See DEV-17370 and DEV-29869/SNOW-79 for details.
-		approx_radius = llmin(approx_radius, max_radius);
+	// Limit the size of megaprims so they don't blot out everything on the minimap.
+	// Attempting to draw very large megaprims also causes client lag.
+	// See DEV-17370 and DEV-29869/SNOW-79 for details.
+	approx_radius = llmin(approx_radius, (F32)max_radius);
 
-		LLColor4U color = above_water_color;
-		if( objectp->permYouOwner() )
+	color = above_water_color.get();
+	if( objectp->permYouOwner() )
+	{
+		const F32 MIN_RADIUS_FOR_OWNED_OBJECTS = 2.f;
+		if( approx_radius < MIN_RADIUS_FOR_OWNED_OBJECTS )
 		{
-			const F32 MIN_RADIUS_FOR_OWNED_OBJECTS = 2.f;
-			if( approx_radius < MIN_RADIUS_FOR_OWNED_OBJECTS )
-			{
-				approx_radius = MIN_RADIUS_FOR_OWNED_OBJECTS;
-			}
+			approx_radius = MIN_RADIUS_FOR_OWNED_OBJECTS;
+		}
 
-			if( pos.mdV[VZ] >= water_height )
+		if( pos_global.mdV[VZ] >= water_height )
+		{
+			if ( objectp->permGroupOwner() )
 			{
-				if ( objectp->permGroupOwner() )
-				{
-					color = group_own_above_water_color;
-				}
-				else
-				{
-				color = you_own_above_water_color;
-			}
+				color = group_own_above_water_color.get();
 			}
 			else
 			{
-				if ( objectp->permGroupOwner() )
-				{
-					color = group_own_below_water_color;
-				}
-			else
-			{
-				color = you_own_below_water_color;
+				color = you_own_above_water_color.get();
 			}
 		}
-		}
 		else
-		if( pos.mdV[VZ] < water_height )
 		{
-			color = below_water_color;
+			if ( objectp->permGroupOwner() )
+			{
+				color = group_own_below_water_color.get();
+			}
+			else
+			{
+				color = you_own_below_water_color.get();
+			}
 		}
-
-		netmap.renderScaledPointGlobal( 
-			pos, 
-			color,
-			approx_radius );
 	}
+	else
+	if( pos_global.mdV[VZ] < water_height )
+	{
+		color = below_water_color.get();
+	}
+
+	radius = approx_radius;
+	return TRUE;
 }
 
 void LLViewerObjectList::renderObjectBounds(const LLVector3 &center)
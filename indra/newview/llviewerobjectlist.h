@@ -87,7 +87,13 @@ public:
 
 	void shiftObjects(const LLVector3 &offset);
 
-	void renderObjectsForMap(LLNetMap &netmap);
+	// Hands every object on the map to a mini map to stamp.
+	void addObjectsToMap(LLNetMap &netmap);
+	// Where and how big objectp shows on the mini map, and in what colour.
+	// FALSE if it is not drawn.
+	BOOL getMapDot(LLViewerObject* objectp, LLVector3d& pos_global, F32& radius, LLColor4U& color);
+	// Tells the mini maps objectp and its children may have moved.
+	void dirtyMapObject(LLViewerObject* objectp);
 	void renderObjectBounds(const LLVector3 &center);
 
 	void addDebugBeacon(const LLVector3 &pos_agent, const std::string &string,
@@ -254,19 +260,5 @@ inline LLViewerObject *LLViewerObjectList::getObject(const S32 index)
 	return objectp;
 }
 
-inline void LLViewerObjectList::addToMap(LLViewerObject *objectp)
-{
-	mMapObjects.push_back(objectp);
-}
-
-inline void LLViewerObjectList::removeFromMap(LLViewerObject *objectp)
-{
-	std::vector<LLPointer<LLViewerObject> >::iterator iter = std::find(mMapObjects.begin(), mMapObjects.end(), objectp);
-	if (iter != mMapObjects.end())
-	{
-		mMapObjects.erase(iter);
-	}
-}
-
 
 #endif // LL_VIEWER_OBJECT_LIST_H
@@ -40,6 +40,7 @@
 #include "pipeline.h"
 #include "llspatialpartition.h"
 #include "llvovolume.h"
+#include "llv4math.h"		// for LL_VECTORIZE
 
 const F32 PART_SIM_BOX_SIDE = 16.f;
 const F32 PART_SIM_BOX_OFFSET = 0.5f*PART_SIM_BOX_SIDE;
@@ -81,16 +82,12 @@ LLViewerPart::LLViewerPart() :
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	mPartSourcep = NULL;
-
-	++LLViewerPartSim::sParticleCount2 ;
 }
 
 LLViewerPart::~LLViewerPart()
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	mPartSourcep = NULL;
-
-	--LLViewerPartSim::sParticleCount2 ;
 }
 
 void LLViewerPart::init(LLPointer<LLViewerPartSource> sourcep, LLViewerTexture *imagep, LLVPCallback cb)
@@ -110,6 +107,227 @@ void LLViewerPart::init(LLPointer<LLViewerPartSource> sourcep, LLViewerTexture *
 }
 
 
+/////////////////////////////
+//
+// LLViewerPartPool implementation
+//
+//
+
+LLViewerPartPool::LLViewerPartPool()
+:	mCount(0)
+{
+}
+
+LLViewerPartPool::~LLViewerPartPool()
+{
+	clear();
+}
+
+S32 LLViewerPartPool::add(const LLViewerPart& part)
+{
+	S32 idx = mCount++;
+	S32 padded = (mCount + 3) & ~3;
+	if ((S32)mLanes[0].size() < padded)
+	{
+		for (S32 lane = 0; lane < NUM_LANES; lane++)
+		{
+			mLanes[lane].resize(padded, 0.f);
+		}
+	}
+	mFlags.push_back(0);
+	mColor.push_back(LLColor4());
+	mScale.push_back(LLVector2());
+	mInfo.push_back(LLPartInfo());
+	set(idx, part);
+
+	++LLViewerPartSim::sParticleCount2;
+	return idx;
+}
+
+void LLViewerPartPool::remove(S32 idx)
+{
+	S32 last = --mCount;
+	if (idx != last)
+	{
+		for (S32 lane = 0; lane < NUM_LANES; lane++)
+		{
+			mLanes[lane][idx] = mLanes[lane][last];
+		}
+		mFlags[idx] = mFlags[last];
+		mColor[idx] = mColor[last];
+		mScale[idx] = mScale[last];
+		mInfo[idx] = mInfo[last];
+	}
+	mFlags.pop_back();
+	mColor.pop_back();
+	mScale.pop_back();
+	mInfo.pop_back();
+
+	--LLViewerPartSim::sParticleCount2;
+}
+
+void LLViewerPartPool::clear()
+{
+	LLViewerPartSim::sParticleCount2 -= mCount;
+	mCount = 0;
+	mFlags.clear();
+	mColor.clear();
+	mScale.clear();
+	mInfo.clear();
+}
+
+void LLViewerPartPool::get(S32 idx, LLViewerPart& part) const
+{
+	const LLPartInfo& info = mInfo[idx];
+	part.mFlags = mFlags[idx];
+	part.mMaxAge = mLanes[MAX_AGE][idx];
+	part.mStartColor = info.mStartColor;
+	part.mEndColor = info.mEndColor;
+	part.mStartScale = info.mStartScale;
+	part.mEndScale = info.mEndScale;
+	part.mPosOffset = info.mPosOffset;
+	part.mParameter = info.mParameter;
+
+	part.mPartID = info.mPartID;
+	part.mLastUpdateTime = mLanes[AGE][idx];
+	part.mSkipOffset = mLanes[SKIP_OFFSET][idx];
+	part.mVPCallback = info.mVPCallback;
+	part.mPartSourcep = info.mPartSourcep;
+	part.mImagep = info.mImagep;
+	part.mPosAgent = getPosAgent(idx);
+	part.mVelocity = getVelocity(idx);
+	part.mAccel.setVec(mLanes[ACCEL_X][idx], mLanes[ACCEL_Y][idx], mLanes[ACCEL_Z][idx]);
+	part.mColor = mColor[idx];
+	part.mScale = mScale[idx];
+}
+
+void LLViewerPartPool::set(S32 idx, const LLViewerPart& part)
+{
+	LLPartInfo& info = mInfo[idx];
+	mFlags[idx] = part.mFlags;
+	mLanes[MAX_AGE][idx] = part.mMaxAge;
+	info.mStartColor = part.mStartColor;
+	info.mEndColor = part.mEndColor;
+	info.mStartScale = part.mStartScale;
+	info.mEndScale = part.mEndScale;
+	info.mPosOffset = part.mPosOffset;
+	info.mParameter = part.mParameter;
+
+	info.mPartID = part.mPartID;
+	mLanes[AGE][idx] = part.mLastUpdateTime;
+	mLanes[SKIP_OFFSET][idx] = part.mSkipOffset;
+	info.mVPCallback = part.mVPCallback;
+	info.mPartSourcep = part.mPartSourcep;
+	info.mImagep = part.mImagep;
+	setPosAgent(idx, part.mPosAgent);
+	setVelocity(idx, part.mVelocity);
+	mLanes[ACCEL_X][idx] = part.mAccel.mV[VX];
+	mLanes[ACCEL_Y][idx] = part.mAccel.mV[VY];
+	mLanes[ACCEL_Z][idx] = part.mAccel.mV[VZ];
+	mColor[idx] = part.mColor;
+	mScale[idx] = part.mScale;
+}
+
+// Blends in the wind, moves the particles by velocity and acceleration and
+// bounces them off their floor, for particles [0, count) of the pool. The
+// scratch lanes are filled in by updateParticles(): a particle that doesn't
+// feel the wind has WIND_K 0, one that isn't integrated has STEP_DT 0 and
+// one that doesn't bounce has FLOOR_Z -F32_MAX.
+static void integrate_particles(LLViewerPartPool& parts, S32 count)
+{
+	F32* pos_x = parts.getLane(LLViewerPartPool::POS_X);
+	F32* pos_y = parts.getLane(LLViewerPartPool::POS_Y);
+	F32* pos_z = parts.getLane(LLViewerPartPool::POS_Z);
+	F32* vel_x = parts.getLane(LLViewerPartPool::VEL_X);
+	F32* vel_y = parts.getLane(LLViewerPartPool::VEL_Y);
+	F32* vel_z = parts.getLane(LLViewerPartPool::VEL_Z);
+	const F32* accel_x = parts.getLane(LLViewerPartPool::ACCEL_X);
+	const F32* accel_y = parts.getLane(LLViewerPartPool::ACCEL_Y);
+	const F32* accel_z = parts.getLane(LLViewerPartPool::ACCEL_Z);
+	const F32* step_dt = parts.getLane(LLViewerPartPool::STEP_DT);
+	const F32* wind_k = parts.getLane(LLViewerPartPool::WIND_K);
+	const F32* wind_x = parts.getLane(LLViewerPartPool::WIND_X);
+	const F32* wind_y = parts.getLane(LLViewerPartPool::WIND_Y);
+	const F32* wind_z = parts.getLane(LLViewerPartPool::WIND_Z);
+	const F32* floor_z = parts.getLane(LLViewerPartPool::FLOOR_Z);
+
+#if LL_VECTORIZE
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 reflect = _mm_set1_ps(-2.f);
+	const __m128 restitution = _mm_set1_ps(-0.75f);
+
+	// The lanes are padded, so the last batch may run past count.
+	for (S32 i = 0; i < count; i += 4)
+	{
+		__m128 k = _mm_loadu_ps(wind_k + i);
+		__m128 keep = _mm_sub_ps(one, k);
+		__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vel_x + i), keep), _mm_mul_ps(k, _mm_loadu_ps(wind_x + i)));
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vel_y + i), keep), _mm_mul_ps(k, _mm_loadu_ps(wind_y + i)));
+		__m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vel_z + i), keep), _mm_mul_ps(k, _mm_loadu_ps(wind_z + i)));
+
+		__m128 dt = _mm_loadu_ps(step_dt + i);
+		__m128 dt2 = _mm_mul_ps(_mm_mul_ps(half, dt), dt);
+		__m128 ax = _mm_loadu_ps(accel_x + i);
+		__m128 ay = _mm_loadu_ps(accel_y + i);
+		__m128 az = _mm_loadu_ps(accel_z + i);
+
+		__m128 px = _mm_add_ps(_mm_loadu_ps(pos_x + i), _mm_mul_ps(dt, vx));
+		__m128 py = _mm_add_ps(_mm_loadu_ps(pos_y + i), _mm_mul_ps(dt, vy));
+		__m128 pz = _mm_add_ps(_mm_loadu_ps(pos_z + i), _mm_mul_ps(dt, vz));
+		px = _mm_add_ps(px, _mm_mul_ps(dt2, ax));
+		py = _mm_add_ps(py, _mm_mul_ps(dt2, ay));
+		pz = _mm_add_ps(pz, _mm_mul_ps(dt2, az));
+		vx = _mm_add_ps(vx, _mm_mul_ps(ax, dt));
+		vy = _mm_add_ps(vy, _mm_mul_ps(ay, dt));
+		vz = _mm_add_ps(vz, _mm_mul_ps(az, dt));
+
+		// Bounce test, relative to the source's height
+		__m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(floor_z + i));
+		__m128 below = _mm_cmplt_ps(dz, zero);
+		pz = _mm_add_ps(pz, _mm_and_ps(below, _mm_mul_ps(reflect, dz)));
+		vz = _mm_or_ps(_mm_and_ps(below, _mm_mul_ps(vz, restitution)), _mm_andnot_ps(below, vz));
+
+		_mm_storeu_ps(pos_x + i, px);
+		_mm_storeu_ps(pos_y + i, py);
+		_mm_storeu_ps(pos_z + i, pz);
+		_mm_storeu_ps(vel_x + i, vx);
+		_mm_storeu_ps(vel_y + i, vy);
+		_mm_storeu_ps(vel_z + i, vz);
+	}
+#else
+	for (S32 i = 0; i < count; i++)
+	{
+		const F32 k = wind_k[i];
+		vel_x[i] = vel_x[i]*(1.f - k) + k*wind_x[i];
+		vel_y[i] = vel_y[i]*(1.f - k) + k*wind_y[i];
+		vel_z[i] = vel_z[i]*(1.f - k) + k*wind_z[i];
+
+		const F32 dt = step_dt[i];
+		const F32 dt2 = 0.5f*dt*dt;
+		pos_x[i] += dt*vel_x[i];
+		pos_y[i] += dt*vel_y[i];
+		pos_z[i] += dt*vel_z[i];
+		pos_x[i] += dt2*accel_x[i];
+		pos_y[i] += dt2*accel_y[i];
+		pos_z[i] += dt2*accel_z[i];
+		vel_x[i] += accel_x[i]*dt;
+		vel_y[i] += accel_y[i]*dt;
+		vel_z[i] += accel_z[i]*dt;
+
+		// Bounce test, relative to the source's height
+		F32 dz = pos_z[i] - floor_z[i];
+		if (dz < 0)
+		{
+			pos_z[i] += -2.f*dz;
+			vel_z[i] *= -0.75f;
+		}
+	}
+#endif
+}
+
+
 /////////////////////////////
 //
 // LLViewerPartGroup implementation
@@ -180,12 +398,8 @@ LLViewerPartGroup::~LLViewerPartGroup()
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	cleanup();
 	
-	S32 count = (S32) mParticles.size();
-	for(S32 i = 0 ; i < count ; i++)
-	{
-		delete mParticles[i] ;
-	}
-	mParticles.clear();
+	S32 count = mParts.size();
+	mParts.clear();
 	
 	LLViewerPartSim::decPartCount(count);
 }
@@ -231,19 +445,19 @@ BOOL LLViewerPartGroup::posInGroup(const LLVector3 &pos, const F32 desired_size)
 }
 
 
-BOOL LLViewerPartGroup::addPart(LLViewerPart* part, F32 desired_size)
+BOOL LLViewerPartGroup::addPart(const LLViewerPart& part, F32 desired_size)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 
-	if (part->mFlags & LLPartData::LL_PART_HUD && !mHud)
+	if (part.mFlags & LLPartData::LL_PART_HUD && !mHud)
 	{
 		return FALSE;
 	}
 
-	BOOL uniform_part = part->mScale.mV[0] == part->mScale.mV[1] && 
-					!(part->mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK);
+	BOOL uniform_part = part.mScale.mV[0] == part.mScale.mV[1] && 
+					!(part.mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK);
 
-	if (!posInGroup(part->mPosAgent, desired_size) ||
+	if (!posInGroup(part.mPosAgent, desired_size) ||
 		(mUniformParticles && !uniform_part) ||
 		(!mUniformParticles && uniform_part))
 	{
@@ -252,8 +466,8 @@ BOOL LLViewerPartGroup::addPart(LLViewerPart* part, F32 desired_size)
 
 	gPipeline.markRebuild(mVOPartGroupp->mDrawable, LLDrawable::REBUILD_ALL, TRUE);
 	
-	mParticles.push_back(part);
-	part->mSkipOffset=mSkippedTime;
+	S32 idx = mParts.add(part);
+	mParts.getLane(LLViewerPartPool::SKIP_OFFSET)[idx] = mSkippedTime;
 	LLViewerPartSim::incPartCount(1);
 	return TRUE;
 }
@@ -264,139 +478,173 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	F32 dt;
 	
-	LLVector3 gravity(0.f, 0.f, GRAVITY);
-
-	LLViewerPartSim::checkParticleCount(mParticles.size());
+	LLViewerPartSim::checkParticleCount(mParts.size());
 
 	LLViewerCamera* camera = LLViewerCamera::getInstance();
 	LLViewerRegion *regionp = getRegion();
-	S32 end = (S32) mParticles.size();
-	for (S32 i = 0 ; i < (S32)mParticles.size();)
+	const S32 end = mParts.size();
+
+	F32* age = mParts.getLane(LLViewerPartPool::AGE);
+	const F32* max_age = mParts.getLane(LLViewerPartPool::MAX_AGE);
+	F32* skip_offset = mParts.getLane(LLViewerPartPool::SKIP_OFFSET);
+	F32* step_dt = mParts.getLane(LLViewerPartPool::STEP_DT);
+	F32* wind_k = mParts.getLane(LLViewerPartPool::WIND_K);
+	F32* wind_x = mParts.getLane(LLViewerPartPool::WIND_X);
+	F32* wind_y = mParts.getLane(LLViewerPartPool::WIND_Y);
+	F32* wind_z = mParts.getLane(LLViewerPartPool::WIND_Z);
+	F32* floor_z = mParts.getLane(LLViewerPartPool::FLOOR_Z);
+
+	// First pass: everything that depends on the source, the callback or
+	// the region, leaving the common integration to integrate_particles().
+	LLViewerPart scratch;
+	for (S32 i = 0; i < end; i++)
 	{
-		LLVector3 a(0.f, 0.f, 0.f);
-		LLViewerPart* part = mParticles[i] ;
+		dt = lastdt + mSkippedTime - skip_offset[i];
+		skip_offset[i] = 0.f;
 
-		dt = lastdt + mSkippedTime - part->mSkipOffset;
-		part->mSkipOffset = 0.f;
+		step_dt[i] = dt;
+		wind_k[i] = 0.f;
+		wind_x[i] = wind_y[i] = wind_z[i] = 0.f;
+		floor_z[i] = -F32_MAX;
 
 		// Update current time
-		const F32 cur_time = part->mLastUpdateTime + dt;
-		const F32 frac = cur_time / part->mMaxAge;
+		const F32 cur_time = age[i] + dt;
+		const F32 frac = cur_time / max_age[i];
+
+		LLViewerPartPool::LLPartInfo& info = mParts.mInfo[i];
 
 		// "Drift" the object based on the source object
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		if (mParts.mFlags[i] & LLPartData::LL_PART_FOLLOW_SRC_MASK)
 		{
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += part->mPosOffset;
+			mParts.setPosAgent(i, info.mPartSourcep->mPosAgent + info.mPosOffset);
 		}
 
 		// Do a custom callback if we have one...
-		if (part->mVPCallback)
+		if (info.mVPCallback)
 		{
-			(*part->mVPCallback)(*part, dt);
+			mParts.get(i, scratch);
+			(*scratch.mVPCallback)(scratch, dt);
+			mParts.set(i, scratch);
 		}
 
-		if (part->mFlags & LLPartData::LL_PART_WIND_MASK)
+		const U32 flags = mParts.mFlags[i];
+
+		if (flags & LLPartData::LL_PART_WIND_MASK)
 		{
-			LLVector3 tempVel(part->mVelocity);
-			part->mVelocity *= 1.f - 0.1f*dt;
-			part->mVelocity += 0.1f*dt*regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(part->mPosAgent));
+			LLVector3 wind = regionp->mWind.getVelocity(regionp->getPosRegionFromAgent(mParts.getPosAgent(i)));
+			if (flags & LLPartData::LL_PART_TARGET_POS_MASK)
+			{
+				// Has to happen before the target blend below
+				LLVector3 vel = mParts.getVelocity(i);
+				vel *= 1.f - 0.1f*dt;
+				vel += 0.1f*dt*wind;
+				mParts.setVelocity(i, vel);
+			}
+			else
+			{
+				wind_k[i] = 0.1f*dt;
+				wind_x[i] = wind.mV[VX];
+				wind_y[i] = wind.mV[VY];
+				wind_z[i] = wind.mV[VZ];
+			}
 		}
 
 		// Now do interpolation towards a target
-		if (part->mFlags & LLPartData::LL_PART_TARGET_POS_MASK)
+		if (flags & LLPartData::LL_PART_TARGET_POS_MASK)
 		{
-			F32 remaining = part->mMaxAge - part->mLastUpdateTime;
+			F32 remaining = max_age[i] - age[i];
 			F32 step = dt / remaining;
 
 			step = llclamp(step, 0.f, 0.1f);
 			step *= 5.f;
 			// we want a velocity that will result in reaching the target in the 
 			// Interpolate towards the target.
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPosAgent;
+			LLVector3 delta_pos = info.mPartSourcep->mTargetPosAgent - mParts.getPosAgent(i);
 
 			delta_pos /= remaining;
 
-			part->mVelocity *= (1.f - step);
-			part->mVelocity += step*delta_pos;
+			LLVector3 vel = mParts.getVelocity(i);
+			vel *= (1.f - step);
+			vel += step*delta_pos;
+			mParts.setVelocity(i, vel);
 		}
 
-
-		if (part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
+		if (flags & LLPartData::LL_PART_TARGET_LINEAR_MASK)
 		{
-			LLVector3 delta_pos = part->mPartSourcep->mTargetPosAgent - part->mPartSourcep->mPosAgent;			
-			part->mPosAgent = part->mPartSourcep->mPosAgent;
-			part->mPosAgent += frac*delta_pos;
-			part->mVelocity = delta_pos;
-		}
-		else
-		{
-			// Do velocity interpolation
-			part->mPosAgent += dt*part->mVelocity;
-			part->mPosAgent += 0.5f*dt*dt*part->mAccel;
-			part->mVelocity += part->mAccel*dt;
+			LLVector3 delta_pos = info.mPartSourcep->mTargetPosAgent - info.mPartSourcep->mPosAgent;
+			LLVector3 pos = info.mPartSourcep->mPosAgent;
+			pos += frac*delta_pos;
+			mParts.setPosAgent(i, pos);
+			mParts.setVelocity(i, delta_pos);
+			// Position and velocity are final, skip the integration
+			step_dt[i] = 0.f;
+			wind_k[i] = 0.f;
 		}
 
-		// Do a bounce test
-		if (part->mFlags & LLPartData::LL_PART_BOUNCE_MASK)
+		if (flags & LLPartData::LL_PART_BOUNCE_MASK)
 		{
 			// Need to do point vs. plane check...
 			// For now, just check relative to object height...
-			F32 dz = part->mPosAgent.mV[VZ] - part->mPartSourcep->mPosAgent.mV[VZ];
-			if (dz < 0)
-			{
-				part->mPosAgent.mV[VZ] += -2.f*dz;
-				part->mVelocity.mV[VZ] *= -0.75f;
-			}
+			floor_z[i] = info.mPartSourcep->mPosAgent.mV[VZ];
 		}
 
+		// Set the last update time to now.
+		age[i] = cur_time;
+	}
+
+	// Second pass: wind, velocity, acceleration and bounce for all of them.
+	integrate_particles(mParts, end);
+
+	// Third pass: interpolation and moving the particles out that are dead
+	// or have left the group.
+	for (S32 i = 0 ; i < mParts.size();)
+	{
+		const U32 flags = mParts.mFlags[i];
+		const LLViewerPartPool::LLPartInfo& info = mParts.mInfo[i];
+		const F32 frac = age[i] / max_age[i];
 
 		// Reset the offset from the source position
-		if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
+		if (flags & LLPartData::LL_PART_FOLLOW_SRC_MASK)
 		{
-			part->mPosOffset = part->mPosAgent;
-			part->mPosOffset -= part->mPartSourcep->mPosAgent;
+			mParts.mInfo[i].mPosOffset = mParts.getPosAgent(i) - info.mPartSourcep->mPosAgent;
 		}
 
 		// Do color interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_COLOR_MASK)
+		if (flags & LLPartData::LL_PART_INTERP_COLOR_MASK)
 		{
-			part->mColor.setVec(part->mStartColor);
+			LLColor4& color = mParts.mColor[i];
+			color.setVec(info.mStartColor);
 			// note: LLColor4's v%k means multiply-alpha-only,
 			//       LLColor4's v*k means multiply-rgb-only
-			part->mColor *= 1.f - frac; // rgb*k
-			part->mColor %= 1.f - frac; // alpha*k
-			part->mColor += frac%(frac*part->mEndColor); // rgb,alpha
+			color *= 1.f - frac; // rgb*k
+			color %= 1.f - frac; // alpha*k
+			color += frac%(frac*info.mEndColor); // rgb,alpha
 		}
 
 		// Do scale interpolation
-		if (part->mFlags & LLPartData::LL_PART_INTERP_SCALE_MASK)
+		if (flags & LLPartData::LL_PART_INTERP_SCALE_MASK)
 		{
-			part->mScale.setVec(part->mStartScale);
-			part->mScale *= 1.f - frac;
-			part->mScale += frac*part->mEndScale;
+			LLVector2& scale = mParts.mScale[i];
+			scale.setVec(info.mStartScale);
+			scale *= 1.f - frac;
+			scale += frac*info.mEndScale;
 		}
 
-		// Set the last update time to now.
-		part->mLastUpdateTime = cur_time;
-
-
 		// Kill dead particles (either flagged dead, or too old)
-		if ((part->mLastUpdateTime > part->mMaxAge) || (LLViewerPart::LL_PART_DEAD_MASK == part->mFlags))
+		if ((age[i] > max_age[i]) || (LLViewerPart::LL_PART_DEAD_MASK == flags))
 		{
-			mParticles[i] = mParticles.back() ;
-			mParticles.pop_back() ;
-			delete part ;
+			mParts.remove(i);
 		}
 		else 
 		{
-			F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
-			if (!posInGroup(part->mPosAgent, desired_size))
+			LLVector3 pos = mParts.getPosAgent(i);
+			F32 desired_size = calc_desired_size(camera, pos, mParts.mScale[i]);
+			if (!posInGroup(pos, desired_size))
 			{
 				// Transfer particles between groups
-				LLViewerPartSim::getInstance()->put(part) ;
-				mParticles[i] = mParticles.back() ;
-				mParticles.pop_back() ;
+				mParts.get(i, scratch);
+				mParts.remove(i);
+				LLViewerPartSim::getInstance()->put(scratch);
 			}
 			else
 			{
@@ -405,7 +653,7 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 		}
 	}
 
-	S32 removed = end - (S32)mParticles.size();
+	S32 removed = end - mParts.size();
 	if (removed > 0)
 	{
 		// we removed one or more particles, so flag this group for update
@@ -417,7 +665,7 @@ void LLViewerPartGroup::updateParticles(const F32 lastdt)
 	}
 	
 	// Kill the viewer object if this particle group is empty
-	if (mParticles.empty())
+	if (mParts.empty())
 	{
 		gObjectList.killObject(mVOPartGroupp);
 		mVOPartGroupp = NULL;
@@ -434,9 +682,14 @@ void LLViewerPartGroup::shift(const LLVector3 &offset)
 	mMinObjPos += offset;
 	mMaxObjPos += offset;
 
-	for (S32 i = 0 ; i < (S32)mParticles.size(); i++)
+	F32* pos_x = mParts.getLane(LLViewerPartPool::POS_X);
+	F32* pos_y = mParts.getLane(LLViewerPartPool::POS_Y);
+	F32* pos_z = mParts.getLane(LLViewerPartPool::POS_Z);
+	for (S32 i = 0 ; i < mParts.size(); i++)
 	{
-		mParticles[i]->mPosAgent += offset;
+		pos_x[i] += offset.mV[VX];
+		pos_y[i] += offset.mV[VY];
+		pos_z[i] += offset.mV[VZ];
 	}
 }
 
@@ -444,11 +697,11 @@ void LLViewerPartGroup::removeParticlesByID(const U32 source_id)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 
-	for (S32 i = 0; i < (S32)mParticles.size(); i++)
+	for (S32 i = 0; i < mParts.size(); i++)
 	{
-		if(mParticles[i]->mPartSourcep->getID() == source_id)
+		if(mParts.mInfo[i].mPartSourcep->getID() == source_id)
 		{
-			mParticles[i]->mFlags = LLViewerPart::LL_PART_DEAD_MASK;
+			mParts.mFlags[i] = LLViewerPart::LL_PART_DEAD_MASK;
 		}		
 	}
 }
@@ -523,38 +776,32 @@ BOOL LLViewerPartSim::shouldAddPart()
 	return TRUE;
 }
 
-void LLViewerPartSim::addPart(LLViewerPart* part)
+void LLViewerPartSim::addPart(const LLViewerPart& part)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	if (sParticleCount < MAX_PART_COUNT)
 	{
 		put(part);
 	}
-	else
-	{
-		//delete the particle if can not add it in
-		delete part ;
-		part = NULL ;
-	}
 }
 
 
-LLViewerPartGroup *LLViewerPartSim::put(LLViewerPart* part)
+LLViewerPartGroup *LLViewerPartSim::put(const LLViewerPart& part)
 {
 	LLMemType mt(LLMemType::MTYPE_PARTICLES);
 	const F32 MAX_MAG = 1000000.f*1000000.f; // 1 million
 	LLViewerPartGroup *return_group = NULL ;
-	if (part->mPosAgent.magVecSquared() > MAX_MAG || !part->mPosAgent.isFinite())
+	if (part.mPosAgent.magVecSquared() > MAX_MAG || !part.mPosAgent.isFinite())
 	{
 #if 0 && !LL_RELEASE_FOR_DOWNLOAD
 		llwarns << "LLViewerPartSim::put Part out of range!" << llendl;
-		llwarns << part->mPosAgent << llendl;
+		llwarns << part.mPosAgent << llendl;
 #endif
 	}
 	else
 	{	
 		LLViewerCamera* camera = LLViewerCamera::getInstance();
-		F32 desired_size = calc_desired_size(camera, part->mPosAgent, part->mScale);
+		F32 desired_size = calc_desired_size(camera, part.mPosAgent, part.mScale);
 
 		S32 count = (S32) mViewerPartGroups.size();
 		for (S32 i = 0; i < count; i++)
@@ -571,15 +818,15 @@ LLViewerPartGroup *LLViewerPartSim::put(LLViewerPart* part)
 		// Create a new one...
 		if(!return_group)
 		{
-			llassert_always(part->mPosAgent.isFinite());
-			LLViewerPartGroup *groupp = createViewerPartGroup(part->mPosAgent, desired_size, part->mFlags & LLPartData::LL_PART_HUD);
-			groupp->mUniformParticles = (part->mScale.mV[0] == part->mScale.mV[1] && 
-									!(part->mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK));
+			llassert_always(part.mPosAgent.isFinite());
+			LLViewerPartGroup *groupp = createViewerPartGroup(part.mPosAgent, desired_size, part.mFlags & LLPartData::LL_PART_HUD);
+			groupp->mUniformParticles = (part.mScale.mV[0] == part.mScale.mV[1] && 
+									!(part.mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK));
 			if (!groupp->addPart(part))
 			{
 				llwarns << "LLViewerPartSim::put - Particle didn't go into its box!" << llendl;
 				llinfos << groupp->getCenterAgent() << llendl;
-				llinfos << part->mPosAgent << llendl;
+				llinfos << part.mPosAgent << llendl;
 				mViewerPartGroups.pop_back() ;
 				delete groupp;
 				groupp = NULL ;
@@ -588,12 +835,6 @@ LLViewerPartGroup *LLViewerPartSim::put(LLViewerPart* part)
 		}
 	}
 
-	if(!return_group) //failed to insert the particle
-	{
-		delete part ;
-		part = NULL ;
-	}
-
 	return return_group ;
 }
 
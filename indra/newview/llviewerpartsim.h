@@ -77,6 +77,112 @@ public:
 };
 
 
+///////////////////
+//
+// The particles of one group
+//
+// LLViewerPart is only used to describe a particle when it is emitted,
+// handed to a callback or moved between groups. While it lives in a
+// group its state is kept here, with the values integrated every frame
+// in arrays of floats (padded to a multiple of 4) so they can be updated
+// four particles at a time. Removing a particle moves the last one into
+// its slot and the arrays never shrink, so there is no allocation per
+// particle once a group has grown.
+//
+
+class LLViewerPartPool
+{
+public:
+	enum ELane
+	{
+		POS_X = 0,
+		POS_Y,
+		POS_Z,
+		VEL_X,
+		VEL_Y,
+		VEL_Z,
+		ACCEL_X,
+		ACCEL_Y,
+		ACCEL_Z,
+		AGE,
+		MAX_AGE,
+		SKIP_OFFSET,
+		// Scratch values for LLViewerPartGroup::updateParticles()
+		STEP_DT,
+		WIND_K,
+		WIND_X,
+		WIND_Y,
+		WIND_Z,
+		FLOOR_Z,
+		NUM_LANES
+	};
+
+	// Everything about a particle the integration doesn't touch.
+	struct LLPartInfo
+	{
+		LLPartInfo() : mPartID(0), mParameter(0.f), mVPCallback(NULL) {}
+
+		U32				mPartID;
+		F32				mParameter;
+		LLVPCallback	mVPCallback;
+		LLPointer<LLViewerPartSource>	mPartSourcep;
+		LLPointer<LLViewerTexture>		mImagep;
+		LLVector3		mPosOffset;
+		LLColor4		mStartColor;
+		LLColor4		mEndColor;
+		LLVector2		mStartScale;
+		LLVector2		mEndScale;
+	};
+
+	LLViewerPartPool();
+	~LLViewerPartPool();
+
+	S32 size() const						{ return mCount; }
+	bool empty() const						{ return mCount == 0; }
+
+	// Returns the index of the new particle.
+	S32 add(const LLViewerPart& part);
+	void remove(S32 idx);
+	void clear();
+
+	void get(S32 idx, LLViewerPart& part) const;
+	void set(S32 idx, const LLViewerPart& part);
+
+	// NULL until the first particle is added.
+	F32* getLane(ELane lane)				{ return mLanes[lane].empty() ? NULL : &mLanes[lane][0]; }
+	const F32* getLane(ELane lane) const	{ return mLanes[lane].empty() ? NULL : &mLanes[lane][0]; }
+
+	LLVector3 getPosAgent(S32 idx) const
+	{
+		return LLVector3(mLanes[POS_X][idx], mLanes[POS_Y][idx], mLanes[POS_Z][idx]);
+	}
+	void setPosAgent(S32 idx, const LLVector3& pos)
+	{
+		mLanes[POS_X][idx] = pos.mV[VX];
+		mLanes[POS_Y][idx] = pos.mV[VY];
+		mLanes[POS_Z][idx] = pos.mV[VZ];
+	}
+	LLVector3 getVelocity(S32 idx) const
+	{
+		return LLVector3(mLanes[VEL_X][idx], mLanes[VEL_Y][idx], mLanes[VEL_Z][idx]);
+	}
+	void setVelocity(S32 idx, const LLVector3& vel)
+	{
+		mLanes[VEL_X][idx] = vel.mV[VX];
+		mLanes[VEL_Y][idx] = vel.mV[VY];
+		mLanes[VEL_Z][idx] = vel.mV[VZ];
+	}
+
+	std::vector<U32>			mFlags;
+	std::vector<LLColor4>		mColor;
+	std::vector<LLVector2>		mScale;
+	std::vector<LLPartInfo>		mInfo;
+
+private:
+	S32 mCount;
+	std::vector<F32> mLanes[NUM_LANES];
+};
+
 
 class LLViewerPartGroup
 {
@@ -88,7 +194,7 @@ public:
 
 	void cleanup();
 
-	BOOL addPart(LLViewerPart* part, const F32 desired_size = -1.f);
+	BOOL addPart(const LLViewerPart& part, const F32 desired_size = -1.f);
 	
 	void updateParticles(const F32 lastdt);
 
@@ -96,11 +202,10 @@ public:
 
 	void shift(const LLVector3 &offset);
 
-	typedef std::vector<LLViewerPart*>  part_list_t;
-	part_list_t mParticles;
+	LLViewerPartPool mParts;
 
 	const LLVector3 &getCenterAgent() const		{ return mCenterAgent; }
-	S32 getCount() const					{ return (S32) mParticles.size(); }
+	S32 getCount() const					{ return mParts.size(); }
 	LLViewerRegion *getRegion() const		{ return mRegionp; }
 
 	void removeParticlesByID(const U32 source_id);
@@ -155,7 +260,7 @@ public:
 	}
 	F32 getRefRate() { return sParticleAdaptiveRate; }
 	F32 getBurstRate() {return sParticleBurstRate; }
-	void addPart(LLViewerPart* part);
+	void addPart(const LLViewerPart& part);
 	void updatePartBurstRate() ;
 	void clearParticlesByID(const U32 system_id);
 	void clearParticlesByOwnerID(const LLUUID& task_id);
@@ -176,7 +281,7 @@ public:
 
 protected:
 	LLViewerPartGroup *createViewerPartGroup(const LLVector3 &pos_agent, const F32 desired_size, bool hud);
-	LLViewerPartGroup *put(LLViewerPart* part);
+	LLViewerPartGroup *put(const LLViewerPart& part);
 
 	group_list_t mViewerPartGroups;
 	source_list_t mViewerPartSources;
@@ -274,33 +274,33 @@ void LLViewerPartSourceScript::update(const F32 dt)
 				continue;
 			}
 
-			LLViewerPart* part = new LLViewerPart();
+			LLViewerPart part;
 
-			part->init(this, mImagep, NULL);
-			part->mFlags = mPartSysData.mPartData.mFlags;
+			part.init(this, mImagep, NULL);
+			part.mFlags = mPartSysData.mPartData.mFlags;
 			if (!mSourceObjectp.isNull() && mSourceObjectp->isHUDAttachment())
 			{
-				part->mFlags |= LLPartData::LL_PART_HUD;
+				part.mFlags |= LLPartData::LL_PART_HUD;
 			}
-			part->mMaxAge = mPartSysData.mPartData.mMaxAge;
-			part->mStartColor = mPartSysData.mPartData.mStartColor;
-			part->mEndColor = mPartSysData.mPartData.mEndColor;
-			part->mColor = part->mStartColor;
+			part.mMaxAge = mPartSysData.mPartData.mMaxAge;
+			part.mStartColor = mPartSysData.mPartData.mStartColor;
+			part.mEndColor = mPartSysData.mPartData.mEndColor;
+			part.mColor = part.mStartColor;
 
-			part->mStartScale = mPartSysData.mPartData.mStartScale;
-			part->mEndScale = mPartSysData.mPartData.mEndScale;
-			part->mScale = part->mStartScale;
+			part.mStartScale = mPartSysData.mPartData.mStartScale;
+			part.mEndScale = mPartSysData.mPartData.mEndScale;
+			part.mScale = part.mStartScale;
 
-			part->mAccel = mPartSysData.mPartAccel;
+			part.mAccel = mPartSysData.mPartAccel;
 
 			if (mPartSysData.mPattern & LLPartSysData::LL_PART_SRC_PATTERN_DROP)
 			{
-				part->mPosAgent = mPosAgent;
-				part->mVelocity.setVec(0.f, 0.f, 0.f);
+				part.mPosAgent = mPosAgent;
+				part.mVelocity.setVec(0.f, 0.f, 0.f);
 			}
 			else if (mPartSysData.mPattern & LLPartSysData::LL_PART_SRC_PATTERN_EXPLODE)
 			{
-				part->mPosAgent = mPosAgent;
+				part.mPosAgent = mPosAgent;
 				LLVector3 part_dir_vector;
 
 				F32 mvs;
@@ -314,15 +314,15 @@ void LLViewerPartSourceScript::update(const F32 dt)
 				while ((mvs > 1.f) || (mvs < 0.01f));
 
 				part_dir_vector.normVec();
-				part->mPosAgent += mPartSysData.mBurstRadius*part_dir_vector;
-				part->mVelocity = part_dir_vector;
+				part.mPosAgent += mPartSysData.mBurstRadius*part_dir_vector;
+				part.mVelocity = part_dir_vector;
 				F32 speed = mPartSysData.mBurstSpeedMin + ll_frand(mPartSysData.mBurstSpeedMax - mPartSysData.mBurstSpeedMin);
-				part->mVelocity *= speed;
+				part.mVelocity *= speed;
 			}
 			else if (mPartSysData.mPattern & LLPartSysData::LL_PART_SRC_PATTERN_ANGLE
 				|| mPartSysData.mPattern & LLPartSysData::LL_PART_SRC_PATTERN_ANGLE_CONE)
 			{				
-				part->mPosAgent = mPosAgent;
+				part.mPosAgent = mPosAgent;
 				
 				// original implemenetation for part_dir_vector was just:					
 				LLVector3 part_dir_vector(0.0, 0.0, 1.0);
@@ -363,22 +363,22 @@ void LLViewerPartSourceScript::update(const F32 dt)
 								
 				part_dir_vector = part_dir_vector * mRotation;
 								
-				part->mPosAgent += mPartSysData.mBurstRadius*part_dir_vector;
+				part.mPosAgent += mPartSysData.mBurstRadius*part_dir_vector;
 
-				part->mVelocity = part_dir_vector;
+				part.mVelocity = part_dir_vector;
 
 				F32 speed = mPartSysData.mBurstSpeedMin + ll_frand(mPartSysData.mBurstSpeedMax - mPartSysData.mBurstSpeedMin);
-				part->mVelocity *= speed;
+				part.mVelocity *= speed;
 			}
 			else
 			{
-				part->mPosAgent = mPosAgent;
-				part->mVelocity.setVec(0.f, 0.f, 0.f);
+				part.mPosAgent = mPosAgent;
+				part.mVelocity.setVec(0.f, 0.f, 0.f);
 				//llwarns << "Unknown source pattern " << (S32)mPartSysData.mPattern << llendl;
 			}
 
-			if (part->mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK ||	// SVC-193, VWR-717
-				part->mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK) 
+			if (part.mFlags & LLPartData::LL_PART_FOLLOW_SRC_MASK ||	// SVC-193, VWR-717
+				part.mFlags & LLPartData::LL_PART_TARGET_LINEAR_MASK) 
 			{
 				mPartSysData.mBurstRadius = 0; 
 			}
@@ -569,18 +569,18 @@ void LLViewerPartSourceSpiral::update(const F32 dt)
 		{
 			mPosAgent = mSourceObjectp->getRenderPosition();
 		}
-		LLViewerPart* part = new LLViewerPart();
-		part->init(this, mImagep, updatePart);
-		part->mStartColor = mColor;
-		part->mEndColor = mColor;
-		part->mEndColor.mV[3] = 0.f;
-		part->mPosAgent = mPosAgent;
-		part->mMaxAge = 1.f;
-		part->mFlags = LLViewerPart::LL_PART_INTERP_COLOR_MASK;
-		part->mLastUpdateTime = 0.f;
-		part->mScale.mV[0] = 0.25f;
-		part->mScale.mV[1] = 0.25f;
-		part->mParameter = ll_frand(F_TWO_PI);
+		LLViewerPart part;
+		part.init(this, mImagep, updatePart);
+		part.mStartColor = mColor;
+		part.mEndColor = mColor;
+		part.mEndColor.mV[3] = 0.f;
+		part.mPosAgent = mPosAgent;
+		part.mMaxAge = 1.f;
+		part.mFlags = LLViewerPart::LL_PART_INTERP_COLOR_MASK;
+		part.mLastUpdateTime = 0.f;
+		part.mScale.mV[0] = 0.25f;
+		part.mScale.mV[1] = 0.25f;
+		part.mParameter = ll_frand(F_TWO_PI);
 
 		LLViewerPartSim::getInstance()->addPart(part);
 	}
@@ -717,25 +717,25 @@ void LLViewerPartSourceBeam::update(const F32 dt)
 			mImagep = LLViewerTextureManager::getFetchedTextureFromFile("pixiesmall.j2c");
 		}
 
-		LLViewerPart* part = new LLViewerPart();
-		part->init(this, mImagep, NULL);
+		LLViewerPart part;
+		part.init(this, mImagep, NULL);
 
-		part->mFlags = LLPartData::LL_PART_INTERP_COLOR_MASK |
+		part.mFlags = LLPartData::LL_PART_INTERP_COLOR_MASK |
 						LLPartData::LL_PART_INTERP_SCALE_MASK |
 						LLPartData::LL_PART_TARGET_POS_MASK |
 						LLPartData::LL_PART_FOLLOW_VELOCITY_MASK;
-		part->mMaxAge = 0.5f;
-		part->mStartColor = mColor;
-		part->mEndColor = part->mStartColor;
-		part->mEndColor.mV[3] = 0.4f;
-		part->mColor = part->mStartColor;
+		part.mMaxAge = 0.5f;
+		part.mStartColor = mColor;
+		part.mEndColor = part.mStartColor;
+		part.mEndColor.mV[3] = 0.4f;
+		part.mColor = part.mStartColor;
 
-		part->mStartScale = LLVector2(0.1f, 0.1f);
-		part->mEndScale = LLVector2(0.1f, 0.1f);
-		part->mScale = part->mStartScale;
+		part.mStartScale = LLVector2(0.1f, 0.1f);
+		part.mEndScale = LLVector2(0.1f, 0.1f);
+		part.mScale = part.mStartScale;
 
-		part->mPosAgent = mPosAgent;
-		part->mVelocity = mTargetPosAgent - mPosAgent;
+		part.mPosAgent = mPosAgent;
+		part.mVelocity = mTargetPosAgent - mPosAgent;
 
 		LLViewerPartSim::getInstance()->addPart(part);
 	}
@@ -834,18 +834,18 @@ void LLViewerPartSourceChat::update(const F32 dt)
 		{
 			mPosAgent = mSourceObjectp->getRenderPosition();
 		}
-		LLViewerPart* part = new LLViewerPart();
-		part->init(this, mImagep, updatePart);
-		part->mStartColor = mColor;
-		part->mEndColor = mColor;
-		part->mEndColor.mV[3] = 0.f;
-		part->mPosAgent = mPosAgent;
-		part->mMaxAge = 1.f;
-		part->mFlags = LLViewerPart::LL_PART_INTERP_COLOR_MASK;
-		part->mLastUpdateTime = 0.f;
-		part->mScale.mV[0] = 0.25f;
-		part->mScale.mV[1] = 0.25f;
-		part->mParameter = ll_frand(F_TWO_PI);
+		LLViewerPart part;
+		part.init(this, mImagep, updatePart);
+		part.mStartColor = mColor;
+		part.mEndColor = mColor;
+		part.mEndColor.mV[3] = 0.f;
+		part.mPosAgent = mPosAgent;
+		part.mMaxAge = 1.f;
+		part.mFlags = LLViewerPart::LL_PART_INTERP_COLOR_MASK;
+		part.mLastUpdateTime = 0.f;
+		part.mScale.mV[0] = 0.25f;
+		part.mScale.mV[1] = 0.25f;
+		part.mParameter = ll_frand(F_TWO_PI);
 
 		LLViewerPartSim::getInstance()->addPart(part);
 	}
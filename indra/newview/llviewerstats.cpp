@@ -219,6 +219,20 @@ LLViewerStats::LLViewerStats() :
 	mActualInKBitStat("actualinkbitstat"),
 	mActualOutKBitStat("actualoutkbitstat"),
 	mTrianglesDrawnStat("trianglesdrawnstat"),
+	mDrawCallsStat("drawcallsstat"),
+	mStateChangesStat("statechangesstat"),
+	mVBOBindsStat("vbobindsstat"),
+	mVBOSlabWasteStat("vboslabwastestat"),
+	mInstancedFacesStat("instancedfacesstat"),
+	mInstanceSavedStat("instancesavedstat"),
+	mSoftOccludedStat("softoccludedstat"),
+	mSoftOcclusionTimeStat("softocclusiontimestat"),
+	mSoftOcclusionFalseStat("softocclusionfalsestat"),
+	mSoftOcclusionMissedStat("softocclusionmissedstat"),
+	mGlyphRunHitStat("glyphrunhitstat"),
+	mCompressedTextureHitStat("compressedtexturehitstat"),
+	mDecodesAvoidedStat("decodesavoidedstat"),
+	mMapPanLatencyStat("mappanlatencystat"),
 	mSimTimeDilation("simtimedilation"),
 	mSimFPS("simfps"),
 	mSimPhysicsFPS("simphysicsfps"),
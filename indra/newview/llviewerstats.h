@@ -53,6 +53,20 @@ public:
 	LLStat mActualInKBitStat;	// From the packet ring (when faking a bad connection)
 	LLStat mActualOutKBitStat;	// From the packet ring (when faking a bad connection)
 	LLStat mTrianglesDrawnStat;
+	LLStat mDrawCallsStat;
+	LLStat mStateChangesStat;
+	LLStat mVBOBindsStat;
+	LLStat mVBOSlabWasteStat;
+	LLStat mInstancedFacesStat;
+	LLStat mInstanceSavedStat;
+	LLStat mSoftOccludedStat;
+	LLStat mSoftOcclusionTimeStat;
+	LLStat mSoftOcclusionFalseStat;	// % of software occluded groups the queries saw
+	LLStat mSoftOcclusionMissedStat;	// % of query occluded groups the software test missed
+	LLStat mGlyphRunHitStat;			// % of font glyph run lookups found in the cache
+	LLStat mCompressedTextureHitStat;	// compressed texture cache reads that hit, per frame
+	LLStat mDecodesAvoidedStat;			// textures uploaded from the compressed cache, per frame
+	LLStat mMapPanLatencyStat;			// ms from a world map pan or zoom to all its tiles drawn
 
 	// Simulator stats
 	LLStat mSimTimeDilation;
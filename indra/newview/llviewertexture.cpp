@@ -37,6 +37,7 @@
 #include "llhost.h"
 #include "llimage.h"
 #include "llimagebmp.h"
+#include "llimagedxt.h"
 #include "llimagej2c.h"
 #include "llimagetga.h"
 #include "llmemtype.h"
@@ -54,6 +55,7 @@
 #include "llviewercontrol.h"
 #include "pipeline.h"
 #include "llappviewer.h"
+#include "llcompressedtexturecache.h"
 #include "llface.h"
 #include "llviewercamera.h"
 #include "lltextureatlas.h"
@@ -1227,6 +1229,21 @@ BOOL LLViewerFetchedTexture::isForSculptOnly() const
 	return mForSculpt && !mNeedsGLTexture ;
 }
 
+BOOL LLViewerFetchedTexture::canUseCompressedCache() const
+{
+	return LLCompressedTextureCache::sEnabled &&
+		gGLManager.mHasCompressedTextures &&
+		mUseMipMaps &&
+		mUrl.compare(0, 7, "file://") != 0 &&
+		!mNeedsAux &&
+		!mForSculpt &&
+		!mForceToSaveRawImage &&
+		!mSaveRawImage &&
+		mLoadedCallbackList.empty() &&
+		mBoostLevel != LLViewerTexture::BOOST_TERRAIN &&
+		!LLViewerTexture::sUseTextureAtlas;
+}
+
 BOOL LLViewerFetchedTexture::isDeleted()  
 { 
 	return mTextureState == DELETED ; 
@@ -1313,11 +1330,12 @@ void LLViewerFetchedTexture::destroyTexture()
 void LLViewerFetchedTexture::addToCreateTexture()
 {
 	bool force_update = false ;
-	if (getComponents() != mRawImage->getComponents())
+	S32 components = mCompressedImage.notNull() ? mCompressedImage->getComponents() : mRawImage->getComponents();
+	if (getComponents() != components)
 	{
 		// We've changed the number of components, so we need to move any
 		// objects using this pool to a different pool.
-		mComponents = mRawImage->getComponents();
+		mComponents = components;
 		mGLTexturep->setComponents(mComponents) ;
 		force_update = true ;
 
@@ -1382,7 +1400,14 @@ void LLViewerFetchedTexture::addToCreateTexture()
 							destroyRawImage();
 							return ;
 						}
-						mRawImage->scale(w >> i, h >> i) ;					
+						if (mCompressedImage.notNull())
+						{
+							mCompressedImage->discardMips(i) ;
+						}
+						else
+						{
+							mRawImage->scale(w >> i, h >> i) ;
+						}
 					}
 				}
 			}
@@ -1403,6 +1428,10 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 		return FALSE;
 	}
 	mNeedsCreateTexture	= FALSE;
+	if (mCompressedImage.notNull())
+	{
+		return createCompressedTexture(usename);
+	}
 	if (mRawImage.isNull())
 	{
 		llerrs << "LLViewerTexture trying to create texture with no Raw Image" << llendl;
@@ -1468,6 +1497,13 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 		setActive() ;
 	}
 
+	// Store the fetched result before setCachedRawImage() scales it down
+	if (res && mIsRawImageValid && canUseCompressedCache() &&
+		mRawDiscardLevel <= getDesiredDiscardLevel() && LLAppViewer::getCompressedTextureCache())
+	{
+		LLAppViewer::getCompressedTextureCache()->writeToCache(mID, mRawImage, mRawDiscardLevel);
+	}
+
 	if (!mForceToSaveRawImage)
 	{
 		mNeedsAux = FALSE;
@@ -1476,6 +1512,54 @@ BOOL LLViewerFetchedTexture::createTexture(S32 usename/*= 0*/)
 	return res;
 }
 
+BOOL LLViewerFetchedTexture::createCompressedTexture(S32 usename)
+{
+	BOOL res = TRUE;
+	if (!gNoRender)
+	{
+		mOrigWidth = mFullWidth;
+		mOrigHeight = mFullHeight;
+
+		res = mGLTexturep->createCompressedGLTexture(mRawDiscardLevel, mCompressedImage, usename, mBoostLevel);
+		resetFaceAtlas() ;
+		setActive() ;
+	}
+
+	// Keep a small decoded copy, as setCachedRawImage() would, for
+	// switchToCachedImage() and late loaded callbacks.
+	if (res && (mCachedRawDiscardLevel < 0 || mCachedRawDiscardLevel > mRawDiscardLevel))
+	{
+		S32 w = mCompressedImage->getWidth() ;
+		S32 h = mCompressedImage->getHeight() ;
+		S32 i = 0 ;
+		while(((w >> i) * (h >> i)) > MAX_CACHED_RAW_IMAGE_AREA)
+		{
+			++i ;
+		}
+		if(i && (!(w >> i) || !(h >> i)))
+		{
+			--i ;
+		}
+
+		LLPointer<LLImageRaw> raw;
+		if (mCompressedImage->decompressMip(i, raw))
+		{
+			mCachedRawImage = raw ;
+			mCachedRawDiscardLevel = mRawDiscardLevel + i ;
+			mCachedRawImageReady = (!mRawDiscardLevel || ((w * h) >= MAX_CACHED_RAW_IMAGE_AREA)) ;
+		}
+	}
+
+	if (res)
+	{
+		LLCompressedTextureCache::sDecodesAvoided++;
+	}
+	mCompressedImage = NULL;
+	mRawDiscardLevel = INVALID_DISCARD_LEVEL;
+	mNeedsAux = FALSE;
+	return res;
+}
+
 // Call with 0,0 to turn this feature off.
 //virtual
 void LLViewerFetchedTexture::setKnownDrawSize(S32 width, S32 height)
@@ -1841,7 +1925,8 @@ bool LLViewerFetchedTexture::updateFetch()
 		
 		if (mRawImage.notNull()) sRawCount--;
 		if (mAuxRawImage.notNull()) sAuxCount--;
-		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage);
+		bool finished = LLAppViewer::getTextureFetch()->getRequestFinished(getID(), fetch_discard, mRawImage, mAuxRawImage,
+																		  mCompressedImage);
 		if (mRawImage.notNull()) sRawCount++;
 		if (mAuxRawImage.notNull()) sAuxCount++;
 		if (finished)
@@ -1855,6 +1940,26 @@ bool LLViewerFetchedTexture::updateFetch()
 																		mFetchPriority, mFetchDeltaTime, mRequestDeltaTime, mCanUseHTTP);
 		}
 		
+		if (mCompressedImage.notNull())
+		{
+			mRawDiscardLevel = fetch_discard;
+			if (mRawDiscardLevel >= 0 && (current_discard < 0 || mRawDiscardLevel < current_discard) &&
+				(mCompressedImage->getWidth() << mRawDiscardLevel) <= MAX_IMAGE_SIZE &&
+				(mCompressedImage->getHeight() << mRawDiscardLevel) <= MAX_IMAGE_SIZE)
+			{
+				mFullWidth = mCompressedImage->getWidth() << mRawDiscardLevel;
+				mFullHeight = mCompressedImage->getHeight() << mRawDiscardLevel;
+				setTexelsPerImage();
+				addToCreateTexture() ;
+				return TRUE ;
+			}
+			else
+			{
+				destroyRawImage();
+				return false;
+			}
+		}
+
 		// We may have data ready regardless of whether or not we are finished (e.g. waiting on write)
 		if (mRawImage.notNull())
 		{
@@ -2006,7 +2111,8 @@ bool LLViewerFetchedTexture::updateFetch()
 		// bypass texturefetch directly by pulling from LLTextureCache
 		bool fetch_request_created = false;
 		fetch_request_created = LLAppViewer::getTextureFetch()->createRequest(mUrl, getID(),getTargetHost(), decode_priority,
-																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP);
+																			  w, h, c, desired_discard, needsAux(), mCanUseHTTP,
+																			  canUseCompressedCache());
 		
 		if (fetch_request_created)
 		{
@@ -2032,7 +2138,7 @@ bool LLViewerFetchedTexture::updateFetch()
 		}
 	}
 	
-	llassert_always(mRawImage.notNull() || (!mNeedsCreateTexture && !mIsRawImageValid));
+	llassert_always(mRawImage.notNull() || mCompressedImage.notNull() || (!mNeedsCreateTexture && !mIsRawImageValid));
 	
 	return mIsFetching ? true : false;
 }
@@ -2559,6 +2665,7 @@ void LLViewerFetchedTexture::destroyRawImage()
 
 	mRawImage = NULL;
 	mAuxRawImage = NULL;
+	mCompressedImage = NULL;
 	mIsRawImageValid = FALSE;
 	mRawDiscardLevel = INVALID_DISCARD_LEVEL;
 }
@@ -2948,6 +3055,7 @@ void LLViewerLODTexture::init(bool firstinit)
 	mTexelsPerImage = 64.f*64.f;
 	mDiscardVirtualSize = 0.f;
 	mCalculatedDiscardLevel = -1.f;
+	mBudgetDiscardLevel = -1;
 }
 
 //virtual 
@@ -3030,7 +3138,24 @@ void LLViewerLODTexture::processTextureStats()
 				mCalculatedDiscardLevel = discard_level;
 			}
 		}
-		if (mBoostLevel < LLViewerTexture::BOOST_SCULPTED)
+		S32 current_discard = getDiscardLevel();
+		const bool budgeted = mBudgetDiscardLevel >= 0 && mBoostLevel < LLViewerTexture::BOOST_SCULPTED;
+		if (budgeted)
+		{
+			// The budget has already weighed this texture against all the
+			// others; a known draw size can only make it coarser.
+			if (!(mKnownDrawWidth && mKnownDrawHeight))
+			{
+				discard_level = 0.f;
+			}
+			discard_level = llmax(discard_level, (F32)mBudgetDiscardLevel);
+			// A moving camera holds back upgrades but never forces downgrades
+			if (sCameraMovingDiscardBias > 0 && current_discard >= 0 && mBudgetDiscardLevel < current_discard)
+			{
+				discard_level = llmax(discard_level, (F32)llmin(current_discard, mBudgetDiscardLevel + sCameraMovingDiscardBias));
+			}
+		}
+		else if (mBoostLevel < LLViewerTexture::BOOST_SCULPTED)
 		{
 			discard_level += sDesiredDiscardBias;
 			discard_level *= sDesiredDiscardScale; // scale
@@ -3055,8 +3180,15 @@ void LLViewerLODTexture::processTextureStats()
 		// proper action if we don't.
 		//
 
-		S32 current_discard = getDiscardLevel();
-		if (sDesiredDiscardBias > 0.0f && mBoostLevel < LLViewerTexture::BOOST_SCULPTED && current_discard >= 0)
+		if (budgeted)
+		{
+			// Drop finer data as soon as the budget gives it up
+			if (current_discard >= 0 && mDesiredDiscardLevel > current_discard)
+			{
+				scaleDown() ;
+			}
+		}
+		else if (sDesiredDiscardBias > 0.0f && mBoostLevel < LLViewerTexture::BOOST_SCULPTED && current_discard >= 0)
 		{
 			// Limit the amount of GL memory bound each frame
 			if ( BYTES_TO_MEGA_BYTES(sBoundTextureMemoryInBytes) > sMaxBoundTextureMemInMegaBytes * texmem_middle_bound_scale &&
@@ -43,6 +43,7 @@
 
 class LLFace;
 class LLImageGL ;
+class LLImageDXT;
 class LLImageRaw;
 class LLViewerObject;
 class LLViewerTexture;
@@ -398,6 +399,9 @@ public:
 	F32  calcDecodePriority() ;
 
 	BOOL needsAux() const { return mNeedsAux; }
+	// TRUE if nothing needs this texture's decoded data, so it may come
+	// from, and go to, the compressed texture cache.
+	BOOL canUseCompressedCache() const;
 
 	// Host we think might have this image, used for baked av textures.
 	void setTargetHost(LLHost host)			{ mTargetHost = host; }
@@ -487,6 +491,8 @@ private:
 	void saveRawImage() ;
 	void setCachedRawImage() ;
 
+	BOOL createCompressedTexture(S32 usename) ;
+
 	//for atlas
 	void resetFaceAtlas() ;
 	void invalidateAtlas(BOOL rebuild_geom) ;
@@ -537,6 +543,8 @@ protected:
 
 	LLPointer<LLImageRaw> mRawImage;
 	S32 mRawDiscardLevel;
+	// Set instead of mRawImage, at mRawDiscardLevel, by a compressed cache hit
+	LLPointer<LLImageDXT> mCompressedImage;
 
 	// Used ONLY for cloth meshes right now.  Make SURE you know what you're 
 	// doing if you use it for anything else! - djs
@@ -593,6 +601,10 @@ public:
 	/*virtual*/ void processTextureStats();
 	BOOL isUpdateFrozen() ;
 
+	// Level chosen by the texture budget, -1 if it doesn't manage this texture
+	void setBudgetDiscardLevel(S32 discard)		{ mBudgetDiscardLevel = discard; }
+	S32 getBudgetDiscardLevel() const			{ return mBudgetDiscardLevel; }
+
 private:
 	void init(bool firstinit) ;
 	void scaleDown() ;		
@@ -600,6 +612,7 @@ private:
 private:
 	F32 mDiscardVirtualSize;		// Virtual size used to calculate desired discard	
 	F32 mCalculatedDiscardLevel;    // Last calculated discard level
+	S32 mBudgetDiscardLevel;
 };
 
 //
@@ -57,6 +57,7 @@
 #include "llviewerstats.h"
 #include "pipeline.h"
 #include "llappviewer.h"
+#include "lltexturebudget.h"
 #include "llxuiparser.h"
 
 ////////////////////////////////////////////////////////////////////////////
@@ -82,7 +83,8 @@ LLViewerTextureList::LLViewerTextureList()
 	: mForceResetTextureStats(FALSE),
 	mUpdateStats(FALSE),
 	mMaxResidentTexMemInMegaBytes(0),
-	mMaxTotalTextureMemInMegaBytes(0)
+	mMaxTotalTextureMemInMegaBytes(0),
+	mTextureBudgetActive(FALSE)
 {
 }
 
@@ -585,6 +587,7 @@ void LLViewerTextureList::updateImages(F32 max_time)
 	LLViewerStats::getInstance()->mRawMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageRaw::sGlobalRawMemory));
 	LLViewerStats::getInstance()->mFormattedMemStat.addValue((F32)BYTES_TO_MEGA_BYTES(LLImageFormatted::sGlobalFormattedMemory));
 	
+	updateTextureBudget();
 	updateImagesDecodePriorities();
 
 	F32 total_max_time = max_time;
@@ -619,6 +622,114 @@ void LLViewerTextureList::updateImages(F32 max_time)
 	updateImagesUpdateStats();
 }
 
+static LLFastTimer::DeclareTimer FTM_TEXTURE_BUDGET("Texture Budget");
+extern F32 texmem_lower_bound_scale;
+
+void LLViewerTextureList::updateTextureBudget()
+{
+	static LLCachedControl<bool> use_budget(gSavedSettings, "TextureBudgetScheduler");
+	static LLCachedControl<F32> budget_interval(gSavedSettings, "TextureBudgetInterval");
+	static LLCachedControl<F32> max_upload_mb(gSavedSettings, "TextureBudgetMaxUploadMB");
+	static LLCachedControl<F32> max_delete_mb(gSavedSettings, "TextureBudgetMaxDeleteMB");
+	static LLCachedControl<std::string> trace_file(gSavedSettings, "TextureBudgetTraceFile");
+
+	if (!use_budget)
+	{
+		if (mTextureBudgetActive)
+		{
+			// Hand every texture back to the discard bias
+			for (image_priority_list_t::iterator iter = mImageList.begin(); iter != mImageList.end(); ++iter)
+			{
+				if ((*iter)->getType() == LLViewerTexture::LOD_TEXTURE)
+				{
+					((LLViewerLODTexture*)iter->get())->setBudgetDiscardLevel(-1);
+				}
+			}
+			mTextureBudgetActive = FALSE;
+		}
+		return;
+	}
+	if (mTextureBudgetActive && mTextureBudgetTimer.getElapsedTimeF32() < budget_interval)
+	{
+		return;
+	}
+	LLFastTimer t(FTM_TEXTURE_BUDGET);
+	mTextureBudgetTimer.reset();
+	mTextureBudgetActive = TRUE;
+
+	// Textures that must stay sharp, or can't change level, come off the top
+	std::vector<LLViewerLODTexture*> managed;
+	LLTextureBudget::texture_list_t textures;
+	S64 unmanaged_bytes = 0;
+	for (image_priority_list_t::iterator iter = mImageList.begin(); iter != mImageList.end(); ++iter)
+	{
+		LLViewerFetchedTexture* imagep = *iter;
+		S32 current_discard = imagep->hasGLTexture() ? imagep->getDiscardLevel() : -1;
+		if (imagep->getType() != LLViewerTexture::LOD_TEXTURE ||
+			!imagep->getUseDiscard() ||
+			imagep->getBoostLevel() >= LLViewerTexture::BOOST_SCULPTED ||
+			!imagep->getFullWidth() || !imagep->getFullHeight())
+		{
+			if (current_discard >= 0)
+			{
+				unmanaged_bytes += imagep->getTextureMemory();
+			}
+			continue;
+		}
+
+		LLTextureBudget::Texture texture;
+		texture.mID = imagep->getID().getCRC32();
+		texture.mFullWidth = imagep->getFullWidth();
+		texture.mFullHeight = imagep->getFullHeight();
+		texture.mComponents = llmax((S32)imagep->getComponents(), 1);
+		texture.mPixelArea = imagep->getMaxVirtualSize();
+		texture.mMinDiscard = (texture.mFullWidth > LLViewerTexture::MAX_IMAGE_SIZE_DEFAULT ||
+							   texture.mFullHeight > LLViewerTexture::MAX_IMAGE_SIZE_DEFAULT) ? 1 : 0;
+		texture.mMaxDiscard = MAX_DISCARD_LEVEL;
+		texture.mCurrentDiscard = current_discard;
+		textures.push_back(texture);
+		managed.push_back((LLViewerLODTexture*)imagep);
+	}
+
+	if (trace_file().empty())
+	{
+		if (mTextureBudgetTrace.is_open())
+		{
+			mTextureBudgetTrace.close();
+		}
+	}
+	else
+	{
+		if (trace_file() != mTextureBudgetTraceFile || !mTextureBudgetTrace.is_open())
+		{
+			if (mTextureBudgetTrace.is_open())
+			{
+				mTextureBudgetTrace.close();
+			}
+			mTextureBudgetTrace.open(trace_file(), std::ios::out | std::ios::app);
+			if (!mTextureBudgetTrace.is_open())
+			{
+				llwarns << "Can't open texture budget trace " << trace_file() << llendl;
+			}
+		}
+		if (mTextureBudgetTrace.is_open())
+		{
+			LLTextureBudget::writeTrace(mTextureBudgetTrace, gFrameCount, textures);
+		}
+	}
+	mTextureBudgetTraceFile = trace_file;
+
+	// Leave the same headroom below the limit that the discard bias does
+	S64 budget_bytes = (S64)((F64)mMaxResidentTexMemInMegaBytes * 1024 * 1024 * texmem_lower_bound_scale) - unmanaged_bytes;
+	LLTextureBudget budget;
+	budget.schedule(textures, llmax(budget_bytes, (S64)0));
+	budget.limitChanges(textures, (S64)(max_upload_mb * 1024.f * 1024.f), (S64)(max_delete_mb * 1024.f * 1024.f));
+	for (U32 i = 0; i < textures.size(); i++)
+	{
+		managed[i]->setBudgetDiscardLevel(textures[i].mTargetDiscard);
+	}
+}
+
 void LLViewerTextureList::updateImagesDecodePriorities()
 {
 	// Update the decode priority for N images each frame
@@ -937,11 +1048,9 @@ void LLViewerTextureList::decodeAllImages(F32 max_time)
 }
 
 
-BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
-										 const std::string& out_filename,
-										 const U8 codec)
+// static
+LLPointer<LLImageRaw> LLViewerTextureList::loadUploadImage(const std::string& filename, const U8 codec)
 {
-	// First, load the image.
 	LLPointer<LLImageRaw> raw_image = new LLImageRaw;
 	
 	switch (codec)
@@ -952,12 +1061,12 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 			
 			if (!bmp_image->load(filename))
 			{
-				return FALSE;
+				return NULL;
 			}
 			
 			if (!bmp_image->decode(raw_image, 0.0f))
 			{
-				return FALSE;
+				return NULL;
 			}
 		}
 			break;
@@ -967,19 +1076,19 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 			
 			if (!tga_image->load(filename))
 			{
-				return FALSE;
+				return NULL;
 			}
 			
 			if (!tga_image->decode(raw_image))
 			{
-				return FALSE;
+				return NULL;
 			}
 			
 			if(	(tga_image->getComponents() != 3) &&
 			   (tga_image->getComponents() != 4) )
 			{
 				tga_image->setLastError( "Image files with less than 3 or more than 4 components are not supported." );
-				return FALSE;
+				return NULL;
 			}
 		}
 			break;
@@ -989,12 +1098,12 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 			
 			if (!jpeg_image->load(filename))
 			{
-				return FALSE;
+				return NULL;
 			}
 			
 			if (!jpeg_image->decode(raw_image, 0.0f))
 			{
-				return FALSE;
+				return NULL;
 			}
 		}
 			break;
@@ -1004,21 +1113,25 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 			
 			if (!png_image->load(filename))
 			{
-				return FALSE;
+				return NULL;
 			}
 			
 			if (!png_image->decode(raw_image, 0.0f))
 			{
-				return FALSE;
+				return NULL;
 			}
 		}
 			break;
 		default:
-			return FALSE;
+			return NULL;
 	}
 	
-	LLPointer<LLImageJ2C> compressedImage = convertToUploadFile(raw_image);
-	
+	return raw_image;
+}
+
+// static
+BOOL LLViewerTextureList::saveUploadFile(LLImageJ2C* compressedImage, const std::string& out_filename)
+{
 	if( !compressedImage->save(out_filename) )
 	{
 		llinfos << "Couldn't create output file " << out_filename << llendl;
@@ -1036,15 +1149,77 @@ BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
 	return TRUE;
 }
 
+BOOL LLViewerTextureList::createUploadFile(const std::string& filename,
+										 const std::string& out_filename,
+										 const U8 codec)
+{
+	// First, load the image.
+	LLPointer<LLImageRaw> raw_image = loadUploadImage(filename, codec);
+	if (raw_image.isNull())
+	{
+		return FALSE;
+	}
+	
+	LLPointer<LLImageJ2C> compressedImage = convertToUploadFile(raw_image);
+	return saveUploadFile(compressedImage, out_filename);
+}
+
+class LLUploadEncodeResponder : public LLImageEncodeThread::Responder
+{
+public:
+	LLUploadEncodeResponder(const std::string& out_filename,
+							const LLViewerTextureList::upload_file_callback_t& callback) :
+		mOutFilename(out_filename),
+		mCallback(callback)
+	{
+	}
+
+	/*virtual*/ void completed(bool success, LLImageJ2C* image)
+	{
+		mCallback(success && LLViewerTextureList::saveUploadFile(image, mOutFilename));
+	}
+
+private:
+	std::string mOutFilename;
+	LLViewerTextureList::upload_file_callback_t mCallback;
+};
+
+// static
+void LLViewerTextureList::createUploadFileAsync(const std::string& filename,
+												const std::string& out_filename,
+												const U8 codec,
+												const upload_file_callback_t& callback)
+{
+	// Decoding the source is quick next to encoding it
+	LLPointer<LLImageRaw> raw_image = loadUploadImage(filename, codec);
+	if (raw_image.isNull())
+	{
+		callback(FALSE);
+		return;
+	}
+	
+	BOOL reversible = prepareUploadImage(raw_image);
+	LLAppViewer::getImageEncodeThread()->encodeImage(raw_image, LLStringUtil::null, reversible, FALSE,
+													 gSavedSettings.getS32("ImageEncodeTileSize"),
+													 new LLUploadEncodeResponder(out_filename, callback));
+}
+
 // note: modifies the argument raw_image!!!!
-LLPointer<LLImageJ2C> LLViewerTextureList::convertToUploadFile(LLPointer<LLImageRaw> raw_image)
+// Returns whether to encode it losslessly.
+BOOL LLViewerTextureList::prepareUploadImage(LLImageRaw* raw_image)
 {
 	raw_image->biasedScaleToPowerOfTwo(LLViewerFetchedTexture::MAX_IMAGE_SIZE_DEFAULT);
+	return gSavedSettings.getBOOL("LosslessJ2CUpload") &&
+		(raw_image->getWidth() * raw_image->getHeight() <= LL_IMAGE_REZ_LOSSLESS_CUTOFF * LL_IMAGE_REZ_LOSSLESS_CUTOFF);
+}
+
+// note: modifies the argument raw_image!!!!
+LLPointer<LLImageJ2C> LLViewerTextureList::convertToUploadFile(LLPointer<LLImageRaw> raw_image)
+{
 	LLPointer<LLImageJ2C> compressedImage = new LLImageJ2C();
 	compressedImage->setRate(0.f);
 	
-	if (gSavedSettings.getBOOL("LosslessJ2CUpload") &&
-		(raw_image->getWidth() * raw_image->getHeight() <= LL_IMAGE_REZ_LOSSLESS_CUTOFF * LL_IMAGE_REZ_LOSSLESS_CUTOFF))
+	if (prepareUploadImage(raw_image))
 		compressedImage->setReversible(TRUE);
 	
 	compressedImage->encode(raw_image, 0.0f);
@@ -35,6 +35,7 @@
 #include "llui.h"
 #include <list>
 #include <set>
+#include <boost/function.hpp>
 
 const U32 LL_IMAGE_REZ_LOSSLESS_CUTOFF = 128;
 
@@ -67,13 +68,24 @@ class LLViewerTextureList
 	friend class LLViewerTextureManager;
 	
 public:
+	typedef boost::function<void (BOOL success)> upload_file_callback_t;
+
 	static BOOL createUploadFile(const std::string& filename, const std::string& out_filename, const U8 codec);
+	// As createUploadFile(), encoding on the image encode thread. callback
+	// is called on the main thread, possibly before this returns.
+	static void createUploadFileAsync(const std::string& filename, const std::string& out_filename, const U8 codec,
+									  const upload_file_callback_t& callback);
 	static LLPointer<LLImageJ2C> convertToUploadFile(LLPointer<LLImageRaw> raw_image);
+	static BOOL saveUploadFile(LLImageJ2C* compressedImage, const std::string& out_filename);
 	static void processImageNotInDatabase( LLMessageSystem *msg, void **user_data );
 	static S32 calcMaxTextureRAM();
 	static void receiveImageHeader(LLMessageSystem *msg, void **user_data);
 	static void receiveImagePacket(LLMessageSystem *msg, void **user_data);
 
+private:
+	static LLPointer<LLImageRaw> loadUploadImage(const std::string& filename, const U8 codec);
+	static BOOL prepareUploadImage(LLImageRaw* raw_image);
+
 public:
 	LLViewerTextureList();
 	~LLViewerTextureList();
@@ -112,6 +124,7 @@ public:
 	static S32 getMaxVideoRamSetting(bool get_recommended = false);
 	
 private:
+	void updateTextureBudget();
 	void updateImagesDecodePriorities();
 	F32  updateImagesCreateTextures(F32 max_time);
 	F32  updateImagesFetchTextures(F32 max_time);
@@ -191,6 +204,11 @@ private:
 	S32	mMaxResidentTexMemInMegaBytes;
 	S32 mMaxTotalTextureMemInMegaBytes;
 	LLFrameTimer mForceDecodeTimer;
+
+	BOOL mTextureBudgetActive;
+	LLFrameTimer mTextureBudgetTimer;
+	std::string mTextureBudgetTraceFile;
+	llofstream mTextureBudgetTrace;
 	
 public:
 	static U32 sTextureBits;
@@ -120,9 +120,9 @@ LLDrawable* LLVOPartGroup::createDrawable(LLPipeline *pipeline)
 
 F32 LLVOPartGroup::getPartSize(S32 idx)
 {
-	if (idx < (S32) mViewerPartGroupp->mParticles.size())
+	if (idx < mViewerPartGroupp->mParts.size())
 	{
-		return mViewerPartGroupp->mParticles[idx]->mScale.mV[0];
+		return mViewerPartGroupp->mParts.mScale[idx].mV[0];
 	}
 
 	return 0.f;
@@ -181,17 +181,16 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 	F32 pixel_meter_ratio = LLViewerCamera::getInstance()->getPixelMeterRatio();
 	pixel_meter_ratio *= pixel_meter_ratio;
 
-	LLViewerPartSim::checkParticleCount(mViewerPartGroupp->mParticles.size()) ;
+	LLViewerPartPool& parts = mViewerPartGroupp->mParts;
+	LLViewerPartSim::checkParticleCount(parts.size()) ;
 
 	S32 count=0;
 	mDepth = 0.f;
 	S32 i = 0 ;
 	LLVector3 camera_agent = getCameraPosition();
-	for (i = 0 ; i < (S32)mViewerPartGroupp->mParticles.size(); i++)
+	for (i = 0 ; i < parts.size(); i++)
 	{
-		const LLViewerPart *part = mViewerPartGroupp->mParticles[i];
-
-		LLVector3 part_pos_agent(part->mPosAgent);
+		LLVector3 part_pos_agent(parts.getPosAgent(i));
 		LLVector3 at(part_pos_agent - camera_agent);
 
 		F32 camera_dist_squared = at.lengthSquared();
@@ -200,7 +199,8 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			inv_camera_dist_squared = 1.f / camera_dist_squared;
 		else
 			inv_camera_dist_squared = 1.f;
-		F32 area = part->mScale.mV[0] * part->mScale.mV[1] * inv_camera_dist_squared;
+		const LLVector2& scale = parts.mScale[i];
+		F32 area = scale.mV[0] * scale.mV[1] * inv_camera_dist_squared;
 		tot_area = llmax(tot_area, area);
  		
 		if (tot_area > max_area)
@@ -231,7 +231,7 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 		
 		facep->setViewerObject(this);
 
-		if (part->mFlags & LLPartData::LL_PART_EMISSIVE_MASK)
+		if (parts.mFlags[i] & LLPartData::LL_PART_EMISSIVE_MASK)
 		{
 			facep->setState(LLFace::FULLBRIGHT);
 		}
@@ -240,14 +240,15 @@ BOOL LLVOPartGroup::updateGeometry(LLDrawable *drawable)
 			facep->clearState(LLFace::FULLBRIGHT);
 		}
 
-		facep->mCenterLocal = part->mPosAgent;
-		facep->setFaceColor(part->mColor);
-		facep->setTexture(part->mImagep);
+		LLViewerTexture* imagep = parts.mInfo[i].mImagep;
+		facep->mCenterLocal = part_pos_agent;
+		facep->setFaceColor(parts.mColor[i]);
+		facep->setTexture(imagep);
 			
 		//check if this particle texture is replaced by a parcel media texture.
-		if(part->mImagep.notNull() && part->mImagep->hasParcelMedia()) 
+		if(imagep && imagep->hasParcelMedia()) 
 		{
-			part->mImagep->getParcelMedia()->addMediaToFace(facep) ;
+			imagep->getParcelMedia()->addMediaToFace(facep) ;
 		}
 
 		mPixelArea = tot_area * pixel_meter_ratio;
@@ -278,17 +279,16 @@ void LLVOPartGroup::getGeometry(S32 idx,
 								LLStrider<LLColor4U>& colorsp, 
 								LLStrider<U16>& indicesp)
 {
-	if (idx >= (S32) mViewerPartGroupp->mParticles.size())
+	const LLViewerPartPool& parts = mViewerPartGroupp->mParts;
+	if (idx >= parts.size())
 	{
 		return;
 	}
 
-	const LLViewerPart &part = *((LLViewerPart*) (mViewerPartGroupp->mParticles[idx]));
-
 	U32 vert_offset = mDrawable->getFace(idx)->getGeomIndex();
 
 	
-	LLVector3 part_pos_agent(part.mPosAgent);
+	LLVector3 part_pos_agent(parts.getPosAgent(idx));
 	LLVector3 camera_agent = getCameraPosition(); 
 	LLVector3 at = part_pos_agent - camera_agent;
 	LLVector3 up;
@@ -299,9 +299,9 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	up = right % at;
 	up.normalize();
 
-	if (part.mFlags & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
+	if (parts.mFlags[idx] & LLPartData::LL_PART_FOLLOW_VELOCITY_MASK)
 	{
-		LLVector3 normvel = part.mVelocity;
+		LLVector3 normvel = parts.getVelocity(idx);
 		normvel.normalize();
 		LLVector2 up_fracs;
 		up_fracs.mV[0] = normvel*right;
@@ -317,8 +317,9 @@ void LLVOPartGroup::getGeometry(S32 idx,
 		right.normalize();
 	}
 
-	right *= 0.5f*part.mScale.mV[0];
-	up *= 0.5f*part.mScale.mV[1];
+	const LLVector2& scale = parts.mScale[idx];
+	right *= 0.5f*scale.mV[0];
+	up *= 0.5f*scale.mV[1];
 
 
 	LLVector3 normal = -LLViewerCamera::getInstance()->getXAxis();
@@ -328,10 +329,11 @@ void LLVOPartGroup::getGeometry(S32 idx,
 	*verticesp++ = part_pos_agent + up + right;
 	*verticesp++ = part_pos_agent - up + right;
 
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
-	*colorsp++ = part.mColor;
+	const LLColor4U color(parts.mColor[idx]);
+	*colorsp++ = color;
+	*colorsp++ = color;
+	*colorsp++ = color;
+	*colorsp++ = color;
 
 	*texcoordsp++ = LLVector2(0.f, 1.f);
 	*texcoordsp++ = LLVector2(0.f, 0.f);
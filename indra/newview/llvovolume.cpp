@@ -48,6 +48,7 @@
 #include "llface.h"
 #include "llspatialpartition.h"
 #include "llhudmanager.h"
+#include "llinstancedgeometry.h"
 #include "llflexibleobject.h"
 #include "llsky.h"
 #include "lltexturefetch.h"
@@ -186,7 +187,8 @@ private:
 
 LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	: LLViewerObject(id, pcode, regionp),
-	  mVolumeImpl(NULL)
+	  mVolumeImpl(NULL),
+	  mPendingVolume(NULL)
 {
 	mTexAnimMode = 0;
 	mRelativeXform.setIdentity();
@@ -210,6 +212,7 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 
 LLVOVolume::~LLVOVolume()
 {
+	releasePendingVolume();
 	delete mTextureAnimp;
 	mTextureAnimp = NULL;
 	delete mVolumeImpl;
@@ -248,6 +251,8 @@ void LLVOVolume::markDead()
 		{
 			mSculptTexture->removeVolume(this);
 		}
+
+		releasePendingVolume();
 	}
 	
 	LLViewerObject::markDead();
@@ -1128,16 +1133,74 @@ BOOL LLVOVolume::calcLOD()
 
 	if (cur_detail != mLOD)
 	{
+		// Keep drawing the current LOD until the new one is built
+		if (!prepareLOD(cur_detail))
+		{
+			return FALSE;
+		}
 		mAppAngle = llround((F32) atan2( mDrawable->getRadius(), mDrawable->mDistanceWRTCamera) * RAD_TO_DEG, 0.01f);
 		mLOD = cur_detail;		
 		return TRUE;
 	}
 	else
 	{
+		if (mPendingVolume && mPendingVolume->getDetail() != LLVolumeLODGroup::getVolumeScaleFromDetail(mLOD))
+		{
+			// Came back to the current LOD before the other one was built
+			releasePendingVolume();
+		}
 		return FALSE;
 	}
 }
 
+BOOL LLVOVolume::prepareLOD(S32 detail)
+{
+	LLVolumeMgr* volume_manager = LLPrimitive::getVolumeManager();
+	LLVolume* volume = getVolume();
+	if (!volume_manager->hasThreads() || !volume || volume->isUnique() || mVolumeImpl)
+	{
+		return TRUE;
+	}
+
+	F32 volume_detail = LLVolumeLODGroup::getVolumeScaleFromDetail(detail);
+	if (mPendingVolume &&
+		(mPendingVolume->getDetail() != volume_detail || mPendingVolume->getParams() != volume->getParams()))
+	{
+		releasePendingVolume();
+	}
+
+	if (!mPendingVolume)
+	{
+		// Copy what sculpt() would use, so the new LOD comes out finished
+		LLVolume::SculptMap sculpt_map;
+		LLImageRaw* raw_image = NULL;
+		if (isSculpted() && mSculptTexture.notNull() && mSculptTexture->hasGLTexture())
+		{
+			raw_image = mSculptTexture->getCachedRawImage();
+		}
+		if (raw_image)
+		{
+			sculpt_map.mWidth = raw_image->getWidth();
+			sculpt_map.mHeight = raw_image->getHeight();
+			sculpt_map.mComponents = raw_image->getComponents();
+			sculpt_map.mLevel = llmin(mSculptTexture->getDiscardLevel(), mSculptTexture->getMaxDiscardLevel());
+			sculpt_map.mData.assign(raw_image->getData(), raw_image->getData() + raw_image->getDataSize());
+		}
+		mPendingVolume = volume_manager->refVolumeAsync(volume->getParams(), detail, raw_image ? &sculpt_map : NULL);
+	}
+
+	return mPendingVolume->isReady();
+}
+
+void LLVOVolume::releasePendingVolume()
+{
+	if (mPendingVolume)
+	{
+		LLPrimitive::getVolumeManager()->unrefVolume(mPendingVolume);
+		mPendingVolume = NULL;
+	}
+}
+
 BOOL LLVOVolume::updateLOD()
 {
 	if (mDrawable.isNull())
@@ -1451,6 +1514,7 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 			LLFastTimer ftm(FTM_GEN_VOLUME);
 			LLVolumeParams volume_params = getVolume()->getParams();
 			setVolume(volume_params, 0);
+			releasePendingVolume();
 			drawable->setState(LLDrawable::REBUILD_VOLUME);
 		}
 
@@ -1475,6 +1539,8 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 			LLFastTimer ftm(FTM_GEN_VOLUME);
 			LLVolumeParams volume_params = getVolume()->getParams();
 			setVolume(volume_params, 0);
+			// The volume holds its own reference now
+			releasePendingVolume();
 		}
 
 		new_volumep = getVolume();
@@ -3251,7 +3317,12 @@ void LLVolumeGeometryManager::registerFace(LLSpatialGroup* group, LLFace* facep,
 	const LLMatrix4* model_mat = NULL;
 
 	LLDrawable* drawable = facep->getDrawable();
-	if (drawable->isActive())
+	BOOL instanced = facep->isState(LLFace::INSTANCED);
+	if (instanced)
+	{
+		model_mat = facep->mInstanceMatrix;
+	}
+	else if (drawable->isActive())
 	{
 		model_mat = &(drawable->getRenderMatrix());
 	}
@@ -3306,6 +3377,7 @@ void LLVolumeGeometryManager::registerFace(LLSpatialGroup* group, LLFace* facep,
 		draw_vec.push_back(draw_info);
 		draw_info->mTextureMatrix = tex_mat;
 		draw_info->mModelMatrix = model_mat;
+		draw_info->mInstanced = instanced;
 		draw_info->mGlowColor.setVec(0,0,0,glow);
 		if (type == LLRenderPass::PASS_ALPHA)
 		{ //for alpha sorting
@@ -3358,6 +3430,8 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 	LLFastTimer ftm2(FTM_REBUILD_VOLUME_VB);
 
 	group->clearDrawMap();
+	group->mInstanceMatrices.clear();
+	LLInstancedGeometry::removeUsers(group);
 
 	mFaceList.clear();
 
@@ -3402,6 +3476,8 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 			//sum up face verts and indices
 			drawablep->updateFaceSize(i);
 			LLFace* facep = drawablep->getFace(i);
+			facep->clearState(LLFace::INSTANCED);
+			facep->mInstanceMatrix = NULL;
 
 			if (cur_total > max_total || facep->getIndicesCount() <= 0 || facep->getGeomCount() <= 0)
 			{
@@ -3569,6 +3645,7 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 		S32 num_mapped_veretx_buffer = LLVertexBuffer::sMappedCount ;
 
 		group->mBuilt = 1.f;
+		BOOL rekey = FALSE;
 		
 		for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
 		{
@@ -3588,7 +3665,11 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 				for (S32 i = 0; i < drawablep->getNumFaces(); ++i)
 				{
 					LLFace* face = drawablep->getFace(i);
-					if (face && face->mVertexBuffer.notNull())
+					if (face && face->isState(LLFace::INSTANCED))
+					{ //never write over a shared buffer, find the face a new one
+						rekey = TRUE;
+					}
+					else if (face && face->mVertexBuffer.notNull())
 					{
 						face->getGeometryVolume(*volume, face->getTEOffset(), 
 							vobj->getRelativeXform(), vobj->getRelativeXformInvTrans(), face->getGeomIndex());
@@ -3644,6 +3725,12 @@ void LLVolumeGeometryManager::rebuildMesh(LLSpatialGroup* group)
 		}
 
 		group->clearState(LLSpatialGroup::MESH_DIRTY | LLSpatialGroup::NEW_DRAWINFO);
+
+		if (rekey)
+		{
+			group->setState(LLSpatialGroup::GEOM_DIRTY);
+			gPipeline.markRebuild(group, TRUE);
+		}
 	}
 
 	if (group && group->isState(LLSpatialGroup::NEW_DRAWINFO))
@@ -3660,6 +3747,9 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 
 	if (!distance_sort)
 	{
+		//faces drawing from shared buffers take no room in the group's buffers
+		genInstancedDrawInfo(group, mask, faces);
+
 		//sort faces by things that break batches
 		std::sort(faces.begin(), faces.end(), LLFace::CompareBatchBreaker());
 	}
@@ -3791,142 +3881,190 @@ void LLVolumeGeometryManager::genDrawInfo(LLSpatialGroup* group, U32 mask, std::
 			index_offset += facep->getGeomCount();
 			indices_index += facep->mIndicesCount;
 
-			BOOL force_simple = facep->mPixelArea < FORCE_SIMPLE_RENDER_AREA;
-			BOOL fullbright = facep->isState(LLFace::FULLBRIGHT);
-			if ((mask & LLVertexBuffer::MAP_NORMAL) == 0)
-			{ //paranoia check to make sure GL doesn't try to read non-existant normals
-				fullbright = TRUE;
-			}
+			registerFacePasses(group, facep, mask);
+						
+			++face_iter;
+		}
 
-			const LLTextureEntry* te = facep->getTextureEntry();
+		buffer->setBuffer(0);
+	}
 
-			BOOL is_alpha = (facep->getPoolType() == LLDrawPool::POOL_ALPHA) ? TRUE : FALSE;
-		
-			if (is_alpha)
+	group->mBufferMap[mask].clear();
+	for (LLSpatialGroup::buffer_texture_map_t::iterator i = buffer_map[mask].begin(); i != buffer_map[mask].end(); ++i)
+	{
+		group->mBufferMap[mask][i->first] = i->second;
+	}
+}
+
+void LLVolumeGeometryManager::registerFacePasses(LLSpatialGroup* group, LLFace* facep, U32 mask)
+{
+	LLViewerTexture* tex = facep->getTexture();
+
+	BOOL force_simple = facep->mPixelArea < FORCE_SIMPLE_RENDER_AREA;
+	BOOL fullbright = facep->isState(LLFace::FULLBRIGHT);
+	if ((mask & LLVertexBuffer::MAP_NORMAL) == 0)
+	{ //paranoia check to make sure GL doesn't try to read non-existant normals
+		fullbright = TRUE;
+	}
+
+	const LLTextureEntry* te = facep->getTextureEntry();
+
+	BOOL is_alpha = (facep->getPoolType() == LLDrawPool::POOL_ALPHA) ? TRUE : FALSE;
+	
+	if (is_alpha)
+	{
+		// can we safely treat this as an alpha mask?
+		if (facep->canRenderAsMask())
+		{
+			if (te->getFullbright())
 			{
-				// can we safely treat this as an alpha mask?
-				if (facep->canRenderAsMask())
-				{
-					if (te->getFullbright())
-					{
-						registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_ALPHA_MASK);
-					}
-					else
-					{
-						registerFace(group, facep, LLRenderPass::PASS_ALPHA_MASK);
-					}
-				}
-				else
-				{
-					registerFace(group, facep, LLRenderPass::PASS_ALPHA);
-				}
+				registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_ALPHA_MASK);
+			}
+			else
+			{
+				registerFace(group, facep, LLRenderPass::PASS_ALPHA_MASK);
+			}
+		}
+		else
+		{
+			registerFace(group, facep, LLRenderPass::PASS_ALPHA);
+		}
 
-				if (LLPipeline::sRenderDeferred)
-				{
-					registerFace(group, facep, LLRenderPass::PASS_ALPHA_SHADOW);
+		if (LLPipeline::sRenderDeferred)
+		{
+			registerFace(group, facep, LLRenderPass::PASS_ALPHA_SHADOW);
+		}
+	}
+	else if (gPipeline.canUseVertexShaders()
+		&& group->mSpatialPartition->mPartitionType != LLViewerRegion::PARTITION_HUD 
+		&& LLPipeline::sRenderBump 
+		&& te->getShiny())
+	{ //shiny
+		if (tex->getPrimaryFormat() == GL_ALPHA)
+		{ //invisiprim+shiny
+			registerFace(group, facep, LLRenderPass::PASS_INVISI_SHINY);
+			registerFace(group, facep, LLRenderPass::PASS_INVISIBLE);
+		}
+		else if (LLPipeline::sRenderDeferred)
+		{ //deferred rendering
+			if (te->getFullbright())
+			{ //register in post deferred fullbright shiny pass
+				registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_SHINY);
+				if (te->getBumpmap())
+				{ //register in post deferred bump pass
+					registerFace(group, facep, LLRenderPass::PASS_POST_BUMP);
 				}
 			}
-			else if (gPipeline.canUseVertexShaders()
-				&& group->mSpatialPartition->mPartitionType != LLViewerRegion::PARTITION_HUD 
-				&& LLPipeline::sRenderBump 
-				&& te->getShiny())
-			{ //shiny
-				if (tex->getPrimaryFormat() == GL_ALPHA)
-				{ //invisiprim+shiny
-					registerFace(group, facep, LLRenderPass::PASS_INVISI_SHINY);
-					registerFace(group, facep, LLRenderPass::PASS_INVISIBLE);
-				}
-				else if (LLPipeline::sRenderDeferred)
-				{ //deferred rendering
-					if (te->getFullbright())
-					{ //register in post deferred fullbright shiny pass
-						registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_SHINY);
-						if (te->getBumpmap())
-						{ //register in post deferred bump pass
-							registerFace(group, facep, LLRenderPass::PASS_POST_BUMP);
-						}
-					}
-					else if (te->getBumpmap())
-					{ //register in deferred bump pass
-						registerFace(group, facep, LLRenderPass::PASS_BUMP);
-					}
-					else
-					{ //register in deferred simple pass (deferred simple includes shiny)
-						llassert(mask & LLVertexBuffer::MAP_NORMAL);
-						registerFace(group, facep, LLRenderPass::PASS_SIMPLE);
-					}
-				}
-				else if (fullbright)
-				{	//not deferred, register in standard fullbright shiny pass					
-					registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_SHINY);
-				}
-				else
-				{ //not deferred or fullbright, register in standard shiny pass
-					registerFace(group, facep, LLRenderPass::PASS_SHINY);
-				}
+			else if (te->getBumpmap())
+			{ //register in deferred bump pass
+				registerFace(group, facep, LLRenderPass::PASS_BUMP);
 			}
 			else
-			{ //not alpha and not shiny
-				if (!is_alpha && tex->getPrimaryFormat() == GL_ALPHA)
-				{ //invisiprim
-					registerFace(group, facep, LLRenderPass::PASS_INVISIBLE);
-				}
-				else if (fullbright)
-				{ //fullbright
-					registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT);
-					if (LLPipeline::sRenderDeferred && LLPipeline::sRenderBump && te->getBumpmap())
-					{ //if this is the deferred render and a bump map is present, register in post deferred bump
-						registerFace(group, facep, LLRenderPass::PASS_POST_BUMP);
-					}
-				}
-				else
-				{
-					if (LLPipeline::sRenderDeferred && LLPipeline::sRenderBump && te->getBumpmap())
-					{ //non-shiny or fullbright deferred bump
-						registerFace(group, facep, LLRenderPass::PASS_BUMP);
-					}
-					else
-					{ //all around simple
-						llassert(mask & LLVertexBuffer::MAP_NORMAL);
-						registerFace(group, facep, LLRenderPass::PASS_SIMPLE);
-					}
-				}
-				
-				//not sure why this is here -- shiny HUD attachments maybe?  -- davep 5/11/2010
-				if (!is_alpha && te->getShiny() && LLPipeline::sRenderBump)
-				{
-					registerFace(group, facep, LLRenderPass::PASS_SHINY);
-				}
+			{ //register in deferred simple pass (deferred simple includes shiny)
+				llassert(mask & LLVertexBuffer::MAP_NORMAL);
+				registerFace(group, facep, LLRenderPass::PASS_SIMPLE);
 			}
-			
-			//not sure why this is here, and looks like it might cause bump mapped objects to get rendered redundantly -- davep 5/11/2010
-			if (!is_alpha && !LLPipeline::sRenderDeferred)
-			{
-				llassert((mask & LLVertexBuffer::MAP_NORMAL) || fullbright);
-				facep->setPoolType((fullbright) ? LLDrawPool::POOL_FULLBRIGHT : LLDrawPool::POOL_SIMPLE);
-				
-				if (!force_simple && te->getBumpmap() && LLPipeline::sRenderBump)
-				{
-					registerFace(group, facep, LLRenderPass::PASS_BUMP);
-				}
+		}
+		else if (fullbright)
+		{	//not deferred, register in standard fullbright shiny pass					
+			registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT_SHINY);
+		}
+		else
+		{ //not deferred or fullbright, register in standard shiny pass
+			registerFace(group, facep, LLRenderPass::PASS_SHINY);
+		}
+	}
+	else
+	{ //not alpha and not shiny
+		if (!is_alpha && tex->getPrimaryFormat() == GL_ALPHA)
+		{ //invisiprim
+			registerFace(group, facep, LLRenderPass::PASS_INVISIBLE);
+		}
+		else if (fullbright)
+		{ //fullbright
+			registerFace(group, facep, LLRenderPass::PASS_FULLBRIGHT);
+			if (LLPipeline::sRenderDeferred && LLPipeline::sRenderBump && te->getBumpmap())
+			{ //if this is the deferred render and a bump map is present, register in post deferred bump
+				registerFace(group, facep, LLRenderPass::PASS_POST_BUMP);
 			}
-
-			if (!is_alpha && LLPipeline::sRenderGlow && te->getGlow() > 0.f)
-			{
-				registerFace(group, facep, LLRenderPass::PASS_GLOW);
+		}
+		else
+		{
+			if (LLPipeline::sRenderDeferred && LLPipeline::sRenderBump && te->getBumpmap())
+			{ //non-shiny or fullbright deferred bump
+				registerFace(group, facep, LLRenderPass::PASS_BUMP);
 			}
-						
-			++face_iter;
+			else
+			{ //all around simple
+				llassert(mask & LLVertexBuffer::MAP_NORMAL);
+				registerFace(group, facep, LLRenderPass::PASS_SIMPLE);
+			}
+		}
+		
+		//not sure why this is here -- shiny HUD attachments maybe?  -- davep 5/11/2010
+		if (!is_alpha && te->getShiny() && LLPipeline::sRenderBump)
+		{
+			registerFace(group, facep, LLRenderPass::PASS_SHINY);
+		}
+	}
+	
+	//not sure why this is here, and looks like it might cause bump mapped objects to get rendered redundantly -- davep 5/11/2010
+	if (!is_alpha && !LLPipeline::sRenderDeferred)
+	{
+		llassert((mask & LLVertexBuffer::MAP_NORMAL) || fullbright);
+		facep->setPoolType((fullbright) ? LLDrawPool::POOL_FULLBRIGHT : LLDrawPool::POOL_SIMPLE);
+		
+		if (!force_simple && te->getBumpmap() && LLPipeline::sRenderBump)
+		{
+			registerFace(group, facep, LLRenderPass::PASS_BUMP);
 		}
+	}
 
-		buffer->setBuffer(0);
+	if (!is_alpha && LLPipeline::sRenderGlow && te->getGlow() > 0.f)
+	{
+		registerFace(group, facep, LLRenderPass::PASS_GLOW);
 	}
+}
 
-	group->mBufferMap[mask].clear();
-	for (LLSpatialGroup::buffer_texture_map_t::iterator i = buffer_map[mask].begin(); i != buffer_map[mask].end(); ++i)
+void LLVolumeGeometryManager::genInstancedDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces)
+{
+	std::vector<LLFace*> copied_faces;
+	copied_faces.reserve(faces.size());
+	std::vector<LLFace*> candidates;
+
+	for (std::vector<LLFace*>::iterator iter = faces.begin(); iter != faces.end(); ++iter)
 	{
-		group->mBufferMap[mask][i->first] = i->second;
+		LLFace* facep = *iter;
+		if (LLInstancedGeometry::canInstance(group, facep))
+		{
+			LLInstancedGeometry::addUser(group, facep, mask);
+			candidates.push_back(facep);
+		}
+		else
+		{
+			copied_faces.push_back(facep);
+		}
 	}
+
+	for (std::vector<LLFace*>::iterator iter = candidates.begin(); iter != candidates.end(); ++iter)
+	{
+		LLFace* facep = *iter;
+		//draw from the buffer shared with identical faces, moved by a matrix of its own
+		if (!LLInstancedGeometry::setBuffer(facep, mask))
+		{ //unique, copy and batch it with the rest of the group
+			copied_faces.push_back(facep);
+			continue;
+		}
+
+		group->mInstanceMatrices.push_back(LLMatrix4());
+		LLInstancedGeometry::getInstanceMatrix(facep, group->mInstanceMatrices.back());
+		facep->mInstanceMatrix = &group->mInstanceMatrices.back();
+		facep->setState(LLFace::INSTANCED);
+
+		registerFacePasses(group, facep, mask);
+	}
+
+	faces.swap(copied_faces);
 }
 
 void LLGeometryManager::addGeometryCount(LLSpatialGroup* group, U32 &vertex_count, U32 &index_count)
@@ -276,6 +276,10 @@ public:
 protected:
 	S32	computeLODDetail(F32	distance, F32 radius);
 	BOOL calcLOD();
+	// Starts building detail in the background. Returns TRUE once it can
+	// be swapped in without stalling the frame.
+	BOOL prepareLOD(S32 detail);
+	void releasePendingVolume();
 	LLFace* addFace(S32 face_index);
 	void updateTEData();
 
@@ -300,6 +304,7 @@ private:
 	BOOL		mVolumeChanged;
 	F32			mVObjRadius;
 	LLVolumeInterface *mVolumeImpl;
+	LLVolume*	mPendingVolume;		// referenced with the volume manager while it builds
 	LLPointer<LLViewerFetchedTexture> mSculptTexture;
 	LLPointer<LLViewerFetchedTexture> mLightTexture;
 	media_list_t mMediaImplList;
@@ -310,12 +310,6 @@ LLSimInfo* LLWorldMap::createSimInfoFromHandle(const U64 handle)
 	return sim_info;
 }
 
-void LLWorldMap::equalizeBoostLevels()
-{
-	mWorldMipmap.equalizeBoostLevels();
-	return;
-}
-
 LLSimInfo* LLWorldMap::simInfoFromPosGlobal(const LLVector3d& pos_global)
 {
 	U64 handle = to_region_handle(pos_global);
@@ -564,8 +558,8 @@ bool LLWorldMap::isTrackingInRectangle(F64 x0, F64 y0, F64 x1, F64 y1)
 // Drop priority of all images being fetched by the map
 void LLWorldMap::dropImagePriorities()
 {
-	// Drop the download of tiles priority to nil
-	mWorldMipmap.dropBoostLevels();
+	// Drop the queued downloads of tiles
+	mWorldMipmap.dropRequests();
 	// Same for the "land for sale" tiles per region
 	for (sim_info_map_t::iterator it = mSimInfoMap.begin(); it != mSimInfoMap.end(); ++it)
 	{
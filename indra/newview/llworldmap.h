@@ -232,8 +232,9 @@ public:
 	LLVector3d getTrackedPositionGlobal() const { return mTrackingLocation; }
 
 	// World Mipmap delegation: currently used when drawing the mipmap
-	void	equalizeBoostLevels();
-	LLPointer<LLViewerFetchedTexture> getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load = true) { return mWorldMipmap.getObjectsTile(grid_x, grid_y, level, load); }
+	void	setMipmapView(F64 left, F64 bottom, F64 right, F64 top, S32 level) { mWorldMipmap.setView(left, bottom, right, top, level); }
+	void	updateMipmapTiles() { mWorldMipmap.updateTiles(); }
+	LLViewerTexture* getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load, bool& done) { return mWorldMipmap.getObjectsTile(grid_x, grid_y, level, load, done); }
 
 private:
 	bool clearItems(bool force = false);	// Clears the item lists
@@ -53,6 +53,7 @@
 #include "llviewertexture.h"
 #include "llviewertexturelist.h"
 #include "llviewerregion.h"
+#include "llviewerstats.h"
 #include "llviewerwindow.h"
 #include "lltrans.h"
 
@@ -99,6 +100,8 @@ F32 LLWorldMapView::sTargetPanY = 0.f;
 S32 LLWorldMapView::sTrackingArrowX = 0;
 S32 LLWorldMapView::sTrackingArrowY = 0;
 bool LLWorldMapView::sVisibleTilesLoaded = false;
+bool LLWorldMapView::sPanPending = false;
+LLTimer LLWorldMapView::sPanTimer;
 F32 LLWorldMapView::sMapScale = 128.f;
 
 std::map<std::string,std::string> LLWorldMapView::sStringsMap;
@@ -245,6 +248,18 @@ void LLWorldMapView::setScale( F32 scale )
 		sTargetPanX = sPanX;
 		sTargetPanY = sPanY;
 		sVisibleTilesLoaded = false;
+		startPanTimer();
+	}
+}
+
+
+// static
+void LLWorldMapView::startPanTimer()
+{
+	if (!sPanPending)
+	{
+		sPanPending = true;
+		sPanTimer.reset();
 	}
 }
 
@@ -257,6 +272,7 @@ void LLWorldMapView::translatePan( S32 delta_x, S32 delta_y )
 	sTargetPanX = sPanX;
 	sTargetPanY = sPanY;
 	sVisibleTilesLoaded = false;
+	startPanTimer();
 }
 
 
@@ -271,6 +287,7 @@ void LLWorldMapView::setPan( S32 x, S32 y, BOOL snap )
 		sPanY = sTargetPanY;
 	}
 	sVisibleTilesLoaded = false;
+	startPanTimer();
 }
 
 bool LLWorldMapView::showRegionInfo()
@@ -589,8 +606,10 @@ void LLWorldMapView::drawMipmap(S32 width, S32 height)
 {
 	// Compute the level of the mipmap to use for the current scale level
 	S32 level = LLWorldMipmap::scaleToLevel(sMapScale);
-	// Set the tile boost level so that unused tiles get to 0
-	LLWorldMap::getInstance()->equalizeBoostLevels();
+	// Tell the mipmap what we look at so that it prefetches where we are heading
+	LLVector3d pos_SW = viewPosToGlobal(0, 0);
+	LLVector3d pos_NE = viewPosToGlobal(width, height);
+	LLWorldMap::getInstance()->setMipmapView(pos_SW[VX], pos_SW[VY], pos_NE[VX], pos_NE[VY], level);
 
 	// Render whatever we already have loaded if we haven't the current level
 	// complete and use it as a background (scaled up or scaled down)
@@ -620,6 +639,16 @@ void LLWorldMapView::drawMipmap(S32 width, S32 height)
 	// Render the current level
 	sVisibleTilesLoaded = drawMipmapLevel(width, height, level);
 
+	// Time from a pan or zoom to the view being complete again
+	if (sVisibleTilesLoaded && sPanPending)
+	{
+		LLViewerStats::getInstance()->mMapPanLatencyStat.addValue(sPanTimer.getElapsedTimeF32() * 1000.f);
+		sPanPending = false;
+	}
+
+	// Start the requests of this draw and upload the tiles decoded since the last one
+	LLWorldMap::getInstance()->updateMipmapTiles();
+
 	return;
 }
 
@@ -654,62 +683,51 @@ bool LLWorldMapView::drawMipmapLevel(S32 width, S32 height, S32 level, bool load
 			LLVector3d pos_global(index_x, index_y, pos_SW[VZ]);
 			// Convert to the mipmap level coordinates for that point (i.e. which tile to we hit)
 			LLWorldMipmap::globalToMipmap(pos_global[VX], pos_global[VY], level, &grid_x, &grid_y);
-			// Get the tile. Note: NULL means that the image does not exist (so it's considered "complete" as far as fetching is concerned)
-			LLPointer<LLViewerFetchedTexture> simimage = LLWorldMap::getInstance()->getObjectsTile(grid_x, grid_y, level, load);
+			// Get the tile. Note: tiles that do not exist are "done" too as far as fetching is concerned
+			bool done = false;
+			LLViewerTexture* simimage = LLWorldMap::getInstance()->getObjectsTile(grid_x, grid_y, level, load, done);
+			if (done)
+			{
+				// Increment the number of completly fetched tiles
+				completed_tiles++;
+			}
 			if (simimage)
 			{
-				// Checks that the image has a valid texture
-				if (simimage->hasGLTexture())
-				{
-					// Increment the number of completly fetched tiles
-					completed_tiles++;
-
-					// Convert those coordinates (SW corner of the mipmap tile) into world (meters) coordinates
-					pos_global[VX] = grid_x * REGION_WIDTH_METERS;
-					pos_global[VY] = grid_y * REGION_WIDTH_METERS;
-					// Now to screen coordinates for SW corner of that tile
-					LLVector3 pos_screen = globalPosToView (pos_global);
-					F32 left   = pos_screen[VX];
-					F32 bottom = pos_screen[VY];
-					// Compute the NE corner coordinates of the tile now
-					pos_global[VX] += tile_width;
-					pos_global[VY] += tile_width;
-					pos_screen = globalPosToView (pos_global);
-					F32 right  = pos_screen[VX];
-					F32 top    = pos_screen[VY];
-
-					// Draw the tile
-					LLGLSUIDefault gls_ui;
-					gGL.getTexUnit(0)->bind(simimage.get());
-					simimage->setAddressMode(LLTexUnit::TAM_CLAMP);
-
-					gGL.setSceneBlendType(LLRender::BT_ALPHA);
-					gGL.color4f(1.f, 1.0f, 1.0f, 1.0f);
-
-					gGL.begin(LLRender::QUADS);
-						gGL.texCoord2f(0.f, 1.f);
-						gGL.vertex3f(left, top, 0.f);
-						gGL.texCoord2f(0.f, 0.f);
-						gGL.vertex3f(left, bottom, 0.f);
-						gGL.texCoord2f(1.f, 0.f);
-						gGL.vertex3f(right, bottom, 0.f);
-						gGL.texCoord2f(1.f, 1.f);
-						gGL.vertex3f(right, top, 0.f);
-					gGL.end();
+				// Convert those coordinates (SW corner of the mipmap tile) into world (meters) coordinates
+				pos_global[VX] = grid_x * REGION_WIDTH_METERS;
+				pos_global[VY] = grid_y * REGION_WIDTH_METERS;
+				// Now to screen coordinates for SW corner of that tile
+				LLVector3 pos_screen = globalPosToView (pos_global);
+				F32 left   = pos_screen[VX];
+				F32 bottom = pos_screen[VY];
+				// Compute the NE corner coordinates of the tile now
+				pos_global[VX] += tile_width;
+				pos_global[VY] += tile_width;
+				pos_screen = globalPosToView (pos_global);
+				F32 right  = pos_screen[VX];
+				F32 top    = pos_screen[VY];
+
+				// Draw the tile
+				LLGLSUIDefault gls_ui;
+				gGL.getTexUnit(0)->bind(simimage);
+				simimage->setAddressMode(LLTexUnit::TAM_CLAMP);
+
+				gGL.setSceneBlendType(LLRender::BT_ALPHA);
+				gGL.color4f(1.f, 1.0f, 1.0f, 1.0f);
+
+				gGL.begin(LLRender::QUADS);
+					gGL.texCoord2f(0.f, 1.f);
+					gGL.vertex3f(left, top, 0.f);
+					gGL.texCoord2f(0.f, 0.f);
+					gGL.vertex3f(left, bottom, 0.f);
+					gGL.texCoord2f(1.f, 0.f);
+					gGL.vertex3f(right, bottom, 0.f);
+					gGL.texCoord2f(1.f, 1.f);
+					gGL.vertex3f(right, top, 0.f);
+				gGL.end();
 #if DEBUG_DRAW_TILE
-					drawTileOutline(level, top, left, bottom, right);
+				drawTileOutline(level, top, left, bottom, right);
 #endif // DEBUG_DRAW_TILE
-				}
-				//else
-				//{
-				//	Waiting for a tile -> the level is not complete
-				//	LL_INFOS("World Map") << "Unfetched tile. level = " << level << LL_ENDL;
-				//}
-			}
-			else
-			{
-				// Unexistent tiles are counted as "completed"
-				completed_tiles++;
 			}
 			// Increment the number of tiles in that level / screen
 			total_tiles++;
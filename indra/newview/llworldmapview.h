@@ -71,6 +71,8 @@ public:
 	static void		setScale( F32 scale );
 	static void		translatePan( S32 delta_x, S32 delta_y );
 	static void		setPan( S32 x, S32 y, BOOL snap = TRUE );
+	// Time the pan latency from the first of a series of pans or zooms
+	static void		startPanTimer();
 	// Return true if the current scale level is above the threshold for accessing region info
 	static bool		showRegionInfo();
 
@@ -162,6 +164,8 @@ public:
 	static S32		sTrackingArrowX;
 	static S32		sTrackingArrowY;
 	static bool		sVisibleTilesLoaded;
+	static bool		sPanPending;		// waiting for the view to complete after a pan or zoom
+	static LLTimer	sPanTimer;
 
 	// Are we mid-pan from a user drag?
 	BOOL			mPanning;
@@ -27,16 +27,145 @@
 #include "llviewerprecompiledheaders.h"
 
 #include "llworldmipmap.h"
+#include "llappviewer.h"		// LLAppViewer::getImageDecodeThread()
+#include "llbuffer.h"
+#include "llhttpclient.h"
+#include "llhttpstatuscodes.h"
+#include "llimageworker.h"
 #include "llviewercontrol.h"		// LLControlGroup
-
-#include "llviewertexturelist.h"
+#include "llviewertexture.h"
 #include "math.h"	// log()
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
 // Turn this on to output tile stats in the standard output
 #define DEBUG_TILES_STAT 0
 
+// Decoded tiles uploaded per update, so that a burst of them doesn't stall a frame
+const S32 MAX_TILE_UPLOADS = 4;
+// Failed fetches (timeouts, server errors) after which a tile is taken as missing
+const S32 MAX_TILE_RETRIES = 3;
+// How far ahead along the pan velocity tiles are prefetched, in seconds
+const F64 PREFETCH_TIME = 0.5;
+// Base priorities: the tiles in view first, then those the pan heads to, then the next level
+const F32 VISIBLE_PRIORITY = 2.f;
+const F32 PAN_PRIORITY = 1.f;
+const F32 ZOOM_PRIORITY = 0.f;
+
+class LLMapTileDecodeResponder : public LLImageDecodeThread::Responder
+{
+public:
+	LLMapTileDecodeResponder(LLWorldMipmap::TileRequest* request) :
+		mRequest(request)
+	{
+	}
+
+	// Called on the decode thread
+	virtual void completed(bool success, LLImageRaw* raw, LLImageRaw* aux)
+	{
+		if (success && raw)
+		{
+			mRequest->mRawImage = raw;
+			mRequest->mState = LLWorldMipmap::TileRequest::DONE;
+		}
+		else
+		{
+			mRequest->mState = LLWorldMipmap::TileRequest::FAILED;
+		}
+	}
+
+private:
+	LLPointer<LLWorldMipmap::TileRequest> mRequest;
+};
+
+class LLMapTileResponder : public LLHTTPClient::Responder
+{
+	LOG_CLASS(LLMapTileResponder);
+public:
+	LLMapTileResponder(LLWorldMipmap::TileRequest* request, const std::string& url) :
+		mRequest(request),
+		mURL(url)
+	{
+	}
+
+	virtual void completedRaw(U32 status, const std::string& reason,
+							  const LLChannelDescriptors& channels,
+							  const LLIOPipe::buffer_ptr_t& buffer)
+	{
+		if (mRequest->mState == LLWorldMipmap::TileRequest::CANCELLED)
+		{
+			return;
+		}
+
+		if (status == HTTP_NOT_FOUND)
+		{
+			// Tiles of areas without regions are not on the server
+			LL_DEBUGS("World Map") << "No tile " << mURL << LL_ENDL;
+			mRequest->mState = LLWorldMipmap::TileRequest::MISSING;
+			return;
+		}
+
+		S32 size = (isGoodStatus(status) ? buffer->countAfter(channels.in(), NULL) : 0);
+		if (size <= 0)
+		{
+			// Timed out or the server had trouble, the tile is queued again
+			LL_DEBUGS("World Map") << "Failed to fetch tile " << mURL << " [" << status << "]: " << reason << LL_ENDL;
+			mRequest->mState = LLWorldMipmap::TileRequest::FAILED;
+			return;
+		}
+
+		// The map server sends JPEG, but J2C tiles decode all the same
+		U8 header[2] = { 0, 0 };
+		S32 header_size = 2;
+		buffer->readAfter(channels.in(), NULL, header, header_size);
+		bool jpeg = (header_size == 2 && header[0] == 0xFF && header[1] == 0xD8);
+		LLPointer<LLImageFormatted> image = LLImageFormatted::createFromType(jpeg ? IMG_CODEC_JPEG : IMG_CODEC_J2C);
+		U8* data = image->allocateData(size);
+		if (!data)
+		{
+			mRequest->mState = LLWorldMipmap::TileRequest::FAILED;
+			return;
+		}
+		buffer->readAfter(channels.in(), NULL, data, size);
+
+		// Ahead of the scene textures, which decode at PRIORITY_NORMAL
+		mRequest->mState = LLWorldMipmap::TileRequest::DECODING;
+		LLAppViewer::getImageDecodeThread()->decodeImage(image, LLQueuedThread::PRIORITY_HIGH, 0, FALSE,
+														 new LLMapTileDecodeResponder(mRequest));
+	}
+
+private:
+	LLPointer<LLWorldMipmap::TileRequest> mRequest;
+	std::string mURL;
+};
+
+LLWorldMipmap::Tile::Tile() :
+	mState(QUEUED),
+	mLevel(0),
+	mGridX(0),
+	mGridY(0),
+	mPriority(0.f),
+	mRetries(0),
+	mLastUsed(0),
+	mBytes(0)
+{
+}
+
 LLWorldMipmap::LLWorldMipmap() :
-	mCurrentLevel(0)
+	mCurrentLevel(0),
+	mViewLeft(0.0),
+	mViewBottom(0.0),
+	mViewRight(0.0),
+	mViewTop(0.0),
+	mViewLevel(0),
+	mVelocityX(0.0),
+	mVelocityY(0.0),
+	mZoomDirection(-1),
+	mUpdateCount(0),
+	mActiveRequests(0),
+	mLoadedBytes(0)
 {
 }
 
@@ -50,150 +179,350 @@ void LLWorldMipmap::reset()
 {
 	for (int level = 0; level < MAP_LEVELS; level++)
 	{
-		mWorldObjectsMipMap[level].clear();
+		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level];
+		for (sublevel_tiles_t::iterator iter = level_mipmap.begin(); iter != level_mipmap.end(); iter++)
+		{
+			// Let the responders know their results are not wanted any more
+			if (iter->second.mRequest.notNull())
+			{
+				iter->second.mRequest->mState = TileRequest::CANCELLED;
+			}
+		}
+		level_mipmap.clear();
+	}
+	mActiveRequests = 0;
+	mLoadedBytes = 0;
+}
+
+void LLWorldMipmap::setView(F64 left, F64 bottom, F64 right, F64 top, S32 level)
+{
+	F64 dt = mViewTimer.getElapsedTimeAndResetF64();
+	if (mViewLevel > 0 && dt > 0.0 && dt < 1.0)
+	{
+		// Average over a couple of draws, the view moves by whole pixels
+		F64 velocity_x = ((left + right) - (mViewLeft + mViewRight)) * 0.5 / dt;
+		F64 velocity_y = ((bottom + top) - (mViewBottom + mViewTop)) * 0.5 / dt;
+		mVelocityX = (mVelocityX + velocity_x) * 0.5;
+		mVelocityY = (mVelocityY + velocity_y) * 0.5;
+
+		// Keep the last direction while the scale is steady
+		F64 width = right - left;
+		F64 old_width = mViewRight - mViewLeft;
+		if (width < old_width * 0.99)
+		{
+			mZoomDirection = -1;
+		}
+		else if (width > old_width * 1.01)
+		{
+			mZoomDirection = 1;
+		}
+	}
+	else
+	{
+		// First view, or the map was hidden for a while
+		mVelocityX = 0.0;
+		mVelocityY = 0.0;
 	}
+
+	mViewLeft = left;
+	mViewBottom = bottom;
+	mViewRight = right;
+	mViewTop = top;
+	mViewLevel = level;
 }
 
-// This method should be called before each use of the mipmap (typically, before each draw), so that to let
-// the boost level of unused tiles to drop to 0 (BOOST_NONE).
-// Tiles that are accessed have had their boost level pushed to BOOST_MAP_VISIBLE so we can identify them.
-// The result of this strategy is that if a tile is not used during 2 consecutive loops, its boost level drops to 0.
-void LLWorldMipmap::equalizeBoostLevels()
+// This method should be called after each use of the mipmap (typically, after each draw).
+// Queued tiles that have not been asked for in that use are off view: their requests are dropped.
+void LLWorldMipmap::updateTiles()
 {
-#if DEBUG_TILES_STAT
-	S32 nb_missing = 0;
-	S32 nb_tiles = 0;
-	S32 nb_visible = 0;
-#endif // DEBUG_TILES_STAT
-	// For each level
+	static LLCachedControl<U32> max_requests(gSavedSettings, "MapTileMaxRequests");
+	static LLCachedControl<U32> tile_memory(gSavedSettings, "MapTileMemory");
+
+	finishRequests();
+
+	if (mViewLevel > 0)
+	{
+		F64 center_x = (mViewLeft + mViewRight) * 0.5;
+		F64 center_y = (mViewBottom + mViewTop) * 0.5;
+		F64 half_width = (mViewRight - mViewLeft) * 0.5;
+		F64 half_height = (mViewTop - mViewBottom) * 0.5;
+
+		// Where the pan is heading, with a band of tiles beyond the view
+		F64 tile_width = REGION_WIDTH_METERS * (1 << (mViewLevel - 1));
+		F64 ahead_x = center_x + mVelocityX * PREFETCH_TIME;
+		F64 ahead_y = center_y + mVelocityY * PREFETCH_TIME;
+		prefetchTiles(ahead_x - half_width - tile_width, ahead_y - half_height - tile_width,
+					  ahead_x + half_width + tile_width, ahead_y + half_height + tile_width,
+					  mViewLevel, PAN_PRIORITY);
+
+		// What the next level shows once zoomed in or out
+		S32 next_level = mViewLevel + mZoomDirection;
+		if (next_level >= 1 && next_level <= MAP_LEVELS)
+		{
+			F64 scale = (mZoomDirection < 0 ? 0.5 : 2.0);
+			prefetchTiles(center_x - half_width * scale, center_y - half_height * scale,
+						  center_x + half_width * scale, center_y + half_height * scale,
+						  next_level, ZOOM_PRIORITY);
+		}
+	}
+
+	// Collect the queue, dropping the tiles nobody asked for since the last update
+	std::vector<std::pair<F32, Tile*> > queue;
 	for (S32 level = 0; level < MAP_LEVELS; level++)
 	{
 		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level];
-		// For each tile
-		for (sublevel_tiles_t::iterator iter = level_mipmap.begin(); iter != level_mipmap.end(); iter++)
+		sublevel_tiles_t::iterator iter = level_mipmap.begin();
+		while (iter != level_mipmap.end())
 		{
-			LLPointer<LLViewerFetchedTexture> img = iter->second;
-			S32 current_boost_level = img->getBoostLevel();
-			if (current_boost_level == LLViewerTexture::BOOST_MAP_VISIBLE)
-			{
-				// If level was BOOST_MAP_VISIBLE, the tile has been used in the last draw so keep it high
-				img->setBoostLevel(LLViewerTexture::BOOST_MAP);
-			}
-			else
+			Tile& tile = iter->second;
+			if (tile.mState == Tile::QUEUED)
 			{
-				// If level was BOOST_MAP only (or anything else...), the tile wasn't used in the last draw 
-				// so we drop its boost level to BOOST_NONE.
-				img->setBoostLevel(LLViewerTexture::BOOST_NONE);
+				if (tile.mLastUsed != mUpdateCount)
+				{
+					level_mipmap.erase(iter++);
+					continue;
+				}
+				queue.push_back(std::make_pair(tile.mPriority, &tile));
 			}
-#if DEBUG_TILES_STAT
-			// Increment some stats if compile option on
-			nb_tiles++;
-			if (current_boost_level == LLViewerTexture::BOOST_MAP_VISIBLE)
-			{
-				nb_visible++;
-			}
-			if (img->isMissingAsset())
-			{
-				nb_missing++;
-			}
-#endif // DEBUG_TILES_STAT
+			++iter;
 		}
 	}
+
+	// Start the highest priority requests there is room for
+	S32 count = llmin((S32)max_requests - mActiveRequests, (S32)queue.size());
+	if (count > 0)
+	{
+		std::partial_sort(queue.begin(), queue.begin() + count, queue.end(),
+						  std::greater<std::pair<F32, Tile*> >());
+		for (S32 i = 0; i < count; i++)
+		{
+			loadObjectsTile(*queue[i].second);
+		}
+	}
+
+	evictTiles((S64)tile_memory * 1024 * 1024);
+
 #if DEBUG_TILES_STAT
-	LL_INFOS("World Map") << "LLWorldMipmap tile stats : total requested = " << nb_tiles << ", visible = " << nb_visible << ", missing = " << nb_missing << LL_ENDL;
+	LL_INFOS("World Map") << "LLWorldMipmap tile stats : queued = " << queue.size() << ", fetching = " << mActiveRequests
+						  << ", loaded = " << mLoadedBytes / 1024 << " KB" << LL_ENDL;
 #endif // DEBUG_TILES_STAT
+
+	mUpdateCount++;
 }
 
 // This method should be used when the mipmap is not actively used for a while, e.g., the map UI is hidden
-void LLWorldMipmap::dropBoostLevels()
+void LLWorldMipmap::dropRequests()
 {
-	// For each level
+	// Tiles already requested still come in, they are likely wanted again
 	for (S32 level = 0; level < MAP_LEVELS; level++)
 	{
 		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level];
-		// For each tile
-		for (sublevel_tiles_t::iterator iter = level_mipmap.begin(); iter != level_mipmap.end(); iter++)
+		sublevel_tiles_t::iterator iter = level_mipmap.begin();
+		while (iter != level_mipmap.end())
 		{
-			LLPointer<LLViewerFetchedTexture> img = iter->second;
-			img->setBoostLevel(LLViewerTexture::BOOST_NONE);
+			if (iter->second.mState == Tile::QUEUED)
+			{
+				level_mipmap.erase(iter++);
+			}
+			else
+			{
+				++iter;
+			}
 		}
 	}
 }
 
-LLPointer<LLViewerFetchedTexture> LLWorldMipmap::getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load)
+LLViewerTexture* LLWorldMipmap::getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load, bool& done)
 {
 	// Check the input data
 	llassert(level <= MAP_LEVELS);
 	llassert(level >= 1);
 
-	// If the *loading* level changed, cleared the new level from "missed" tiles
-	// so that we get a chance to reload them
-	if (load && (level != mCurrentLevel))
+	Tile* tile = NULL;
+	if (load)
 	{
-		cleanMissedTilesFromLevel(level);
-		mCurrentLevel = level;
-	}
-
-	// Build the region handle
-	U64 handle = convertGridToHandle(grid_x, grid_y);
-
-	// Check if the image is around already
-	sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level-1];
-	sublevel_tiles_t::iterator found = level_mipmap.find(handle);
-
-	// If not there and load on, go load it
-	if (found == level_mipmap.end())
-	{
-		if (load)
+		// If the *loading* level changed, cleared the new level from "missed" tiles
+		// so that we get a chance to reload them
+		if (level != mCurrentLevel)
 		{
-			// Load it 
-			LLPointer<LLViewerFetchedTexture> img = loadObjectsTile(grid_x, grid_y, level);
-			// Insert the image in the map
-			level_mipmap.insert(sublevel_tiles_t::value_type( handle, img ));
-			// Find the element again in the map (it's there now...)
-			found = level_mipmap.find(handle);
+			cleanMissedTilesFromLevel(level);
+			mCurrentLevel = level;
 		}
-		else
+
+		F64 center_x = (mViewLeft + mViewRight) * 0.5;
+		F64 center_y = (mViewBottom + mViewTop) * 0.5;
+		tile = &requestTile(grid_x, grid_y, level, getTilePriority(grid_x, grid_y, level, center_x, center_y, VISIBLE_PRIORITY));
+	}
+	else
+	{
+		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level-1];
+		sublevel_tiles_t::iterator found = level_mipmap.find(convertGridToHandle(grid_x, grid_y));
+		if (found == level_mipmap.end())
 		{
 			// Return with NULL if not found and we're not trying to load
+			done = false;
 			return NULL;
 		}
+		tile = &found->second;
+		if (tile->mState == Tile::LOADED)
+		{
+			// Drawn as a background, keep it around
+			tile->mLastUsed = mUpdateCount;
+		}
 	}
 
-	// Get the image pointer and check if this asset is missing
-	LLPointer<LLViewerFetchedTexture> img = found->second;
-	if (img->isMissingAsset())
+	done = (tile->mState == Tile::LOADED || tile->mState == Tile::MISSING);
+	return (tile->mState == Tile::LOADED ? tile->mTexture.get() : NULL);
+}
+
+F32 LLWorldMipmap::getTilePriority(U32 grid_x, U32 grid_y, S32 level, F64 center_x, F64 center_y, F32 base)
+{
+	// Distance from the tile center in tiles
+	F64 tile_width = REGION_WIDTH_METERS * (1 << (level - 1));
+	F64 dx = (grid_x * REGION_WIDTH_METERS + tile_width * 0.5 - center_x) / tile_width;
+	F64 dy = (grid_y * REGION_WIDTH_METERS + tile_width * 0.5 - center_y) / tile_width;
+	return base + 1.f / (1.f + (F32)sqrt(dx * dx + dy * dy));
+}
+
+LLWorldMipmap::Tile& LLWorldMipmap::requestTile(U32 grid_x, U32 grid_y, S32 level, F32 priority)
+{
+	sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level-1];
+	std::pair<sublevel_tiles_t::iterator, bool> found =
+		level_mipmap.insert(sublevel_tiles_t::value_type(convertGridToHandle(grid_x, grid_y), Tile()));
+	Tile& tile = found.first->second;
+	if (found.second)
 	{
-		// Return NULL if asset missing
-		return NULL;
+		tile.mLevel = level;
+		tile.mGridX = grid_x;
+		tile.mGridY = grid_y;
 	}
-	else
+	// Keep the highest priority asked for since the last update
+	if (tile.mState == Tile::QUEUED &&
+		(found.second || tile.mLastUsed != mUpdateCount || priority > tile.mPriority))
 	{
-		// Boost the tile level so to mark it's in use *if* load on
-		if (load)
+		tile.mPriority = priority;
+	}
+	tile.mLastUsed = mUpdateCount;
+	return tile;
+}
+
+void LLWorldMipmap::prefetchTiles(F64 left, F64 bottom, F64 right, F64 top, S32 level, F32 base)
+{
+	F64 center_x = (left + right) * 0.5;
+	F64 center_y = (bottom + top) * 0.5;
+	F64 tile_width = REGION_WIDTH_METERS * (1 << (level - 1));
+	left = llmax(left, 0.0);
+	bottom = llmax(bottom, 0.0);
+
+	U32 grid_x, grid_y;
+	for (F64 index_y = bottom; index_y < top + tile_width; index_y += tile_width)
+	{
+		for (F64 index_x = left; index_x < right + tile_width; index_x += tile_width)
 		{
-			img->setBoostLevel(LLViewerTexture::BOOST_MAP_VISIBLE);
+			globalToMipmap(index_x, index_y, level, &grid_x, &grid_y);
+			requestTile(grid_x, grid_y, level, getTilePriority(grid_x, grid_y, level, center_x, center_y, base));
 		}
-		return img;
 	}
 }
 
-LLPointer<LLViewerFetchedTexture> LLWorldMipmap::loadObjectsTile(U32 grid_x, U32 grid_y, S32 level)
+void LLWorldMipmap::loadObjectsTile(Tile& tile)
 {
 	// Get the grid coordinates
-	std::string imageurl = gSavedSettings.getString("CurrentMapServerURL") + llformat("map-%d-%d-%d-objects.jpg", level, grid_x, grid_y);
-
-	// DO NOT COMMIT!! DEBUG ONLY!!!
-	// Use a local jpeg for every tile to test map speed without S3 access
-	//imageurl = "file://C:\\Develop\\mapserver-distribute-3\\indra\\build-vc80\\mapserver\\relwithdebinfo\\regions\\00995\\01001\\region-995-1001-prims.jpg";
-	// END DEBUG
+	std::string imageurl = gSavedSettings.getString("CurrentMapServerURL") + llformat("map-%d-%d-%d-objects.jpg", tile.mLevel, tile.mGridX, tile.mGridY);
 	//LL_INFOS("World Map") << "LLWorldMipmap::loadObjectsTile(), URL = " << imageurl << LL_ENDL;
 
-	LLPointer<LLViewerFetchedTexture> img = LLViewerTextureManager::getFetchedTextureFromUrl(imageurl, TRUE, LLViewerTexture::BOOST_NONE, LLViewerTexture::LOD_TEXTURE);
-	img->setBoostLevel(LLViewerTexture::BOOST_MAP);
+	tile.mState = Tile::FETCHING;
+	tile.mRequest = new TileRequest;
+	mActiveRequests++;
+	fetchTile(tile.mRequest, imageurl);
+}
+
+void LLWorldMipmap::fetchTile(TileRequest* request, const std::string& url)
+{
+	LLHTTPClient::get(url, new LLMapTileResponder(request, url));
+}
 
-	// Return the smart pointer
-	return img;
+void LLWorldMipmap::finishRequests()
+{
+	S32 uploads = 0;
+	for (S32 level = 0; level < MAP_LEVELS; level++)
+	{
+		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level];
+		for (sublevel_tiles_t::iterator iter = level_mipmap.begin(); iter != level_mipmap.end(); iter++)
+		{
+			Tile& tile = iter->second;
+			if (tile.mState != Tile::FETCHING)
+			{
+				continue;
+			}
+
+			S32 state = tile.mRequest->mState;
+			if (state == TileRequest::DONE)
+			{
+				if (uploads >= MAX_TILE_UPLOADS)
+				{
+					continue;
+				}
+				uploads++;
+				LLImageRaw* raw = tile.mRequest->mRawImage;
+				tile.mTexture = LLViewerTextureManager::getLocalTexture(raw, TRUE);
+				tile.mBytes = raw->getDataSize();
+				mLoadedBytes += tile.mBytes;
+				tile.mState = Tile::LOADED;
+			}
+			else if (state == TileRequest::FAILED && ++tile.mRetries < MAX_TILE_RETRIES)
+			{
+				// Fetched again if it's still wanted, dropped like any queued tile if not
+				tile.mState = Tile::QUEUED;
+			}
+			else if (state == TileRequest::FAILED || state == TileRequest::MISSING)
+			{
+				tile.mState = Tile::MISSING;
+			}
+			else
+			{
+				continue;
+			}
+			tile.mRequest = NULL;
+			mActiveRequests--;
+		}
+	}
+}
+
+void LLWorldMipmap::evictTiles(S64 budget)
+{
+	if (mLoadedBytes <= budget)
+	{
+		return;
+	}
+
+	// Least recently drawn first
+	std::vector<std::pair<U32, std::pair<S32, U64> > > loaded;
+	for (S32 level = 0; level < MAP_LEVELS; level++)
+	{
+		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[level];
+		for (sublevel_tiles_t::iterator iter = level_mipmap.begin(); iter != level_mipmap.end(); iter++)
+		{
+			if (iter->second.mState == Tile::LOADED)
+			{
+				loaded.push_back(std::make_pair(iter->second.mLastUsed, std::make_pair(level, iter->first)));
+			}
+		}
+	}
+	std::sort(loaded.begin(), loaded.end());
+
+	for (U32 i = 0; i < loaded.size() && mLoadedBytes > budget; i++)
+	{
+		if (loaded[i].first == mUpdateCount)
+		{
+			// Everything left is in view
+			break;
+		}
+		sublevel_tiles_t& level_mipmap = mWorldObjectsMipMap[loaded[i].second.first];
+		sublevel_tiles_t::iterator found = level_mipmap.find(loaded[i].second.second);
+		mLoadedBytes -= found->second.mBytes;
+		level_mipmap.erase(found);
+	}
 }
 
 // This method is used to clean up a level from tiles marked as "missing".
@@ -218,8 +547,7 @@ void LLWorldMipmap::cleanMissedTilesFromLevel(S32 level)
 	sublevel_tiles_t::iterator it = level_mipmap.begin();
 	while (it != level_mipmap.end())
 	{
-		LLPointer<LLViewerFetchedTexture> img = it->second;
-		if (img->isMissingAsset())
+		if (it->second.mState == Tile::MISSING)
 		{
 			level_mipmap.erase(it++);
 		}
@@ -32,8 +32,12 @@
 #include "llmemory.h"			// LLPointer
 #include "indra_constants.h"	// REGION_WIDTH_UNITS
 #include "llregionhandle.h"		// to_region_handle()
+#include "llapr.h"				// LLAtomicS32
+#include "llimage.h"
+#include "llthread.h"			// LLThreadSafeRefCount
+#include "lltimer.h"
 
-class LLViewerFetchedTexture;
+class LLViewerTexture;
 
 // LLWorldMipmap : Mipmap handling of all the tiles used to render the world at any resolution.
 // This class provides a clean structured access to the hierarchy of tiles stored in the 
@@ -42,13 +46,17 @@ class LLViewerFetchedTexture;
 // structure (at least, that it exists...) but doesn't requite the caller to know the details of it.
 // IOW, you need to know that rendering levels exists as well as grid coordinates for regions, 
 // but you can ignore where those tiles are located, how to get them, etc...
-// The class API gives you back LLPointer<LLViewerFetchedTexture> per tile.
+// The class API gives you back an LLViewerTexture per loaded tile.
 
 // See llworldmipmapview.cpp for the implementation of a class who knows how to render an LLWorldMipmap.
 
 // Implementation notes:
 // - On the S3 servers, the tiles are rendered in 2 flavors: Objects and Terrain.
 // - For the moment, LLWorldMipmap implements access only to the Objects tiles.
+// - Tiles are not fetched through LLTextureFetch, where they would wait behind the scene textures.
+//   The mipmap queues its own HTTP requests by priority, has them decoded on the image decode thread
+//   ahead of scene textures, prefetches the tiles the view is heading to and keeps the tiles within
+//   a memory budget, dropping the least recently drawn first.
 class LLWorldMipmap
 {
 public:
@@ -56,17 +64,42 @@ public:
 	static const S32 MAP_LEVELS = 8;		// Number of subresolution levels computed by the mapserver
 	static const S32 MAP_TILE_SIZE = 256;	// Width in pixels of the tiles computed by the mapserver
 
+	// A tile being fetched and decoded. Shared with the HTTP and decode responders.
+	class TileRequest : public LLThreadSafeRefCount
+	{
+	public:
+		enum EState
+		{
+			FETCHING,
+			DECODING,
+			DONE,		// set by the decode thread
+			FAILED,		// idem, or the fetch failed: worth another try
+			MISSING,	// the server has no such tile
+			CANCELLED	// nobody wants the tile any more
+		};
+
+		TileRequest() : mState(FETCHING) {}
+
+		LLAtomicS32 mState;
+		LLPointer<LLImageRaw> mRawImage;	// written before mState is set to DONE
+	};
+
 	LLWorldMipmap();
-	~LLWorldMipmap();
+	virtual ~LLWorldMipmap();
 
 	// Clear up the maps and release all image handles
 	void	reset();
-	// Manage the boost levels between loops (typically draw() loops)
-	void	equalizeBoostLevels();
-	// Drop the boost levels to none (used when hiding the map)
-	void	dropBoostLevels();
-	// Get the tile smart pointer, does the loading if necessary
-	LLPointer<LLViewerFetchedTexture> getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load = true);
+	// Set the part of the world in view (global meters) and its level before each draw.
+	// The pan velocity and zoom direction used for prefetching come from successive calls.
+	void	setView(F64 left, F64 bottom, F64 right, F64 top, S32 level);
+	// Start queued requests, upload decoded tiles and evict the least recently drawn ones.
+	// Called after each draw.
+	void	updateTiles();
+	// Drop the queued requests (used when hiding the map)
+	void	dropRequests();
+	// Get the tile texture, queuing its request if load is on. Returns NULL while the tile is
+	// loading or if it is missing. done is set once the tile is loaded or known to be missing.
+	LLViewerTexture* getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load, bool& done);
 
 	// Helper functions: those are here as they depend solely on the topology of the mipmap though they don't access it
 	// Convert sim scale (given in sim width in display pixels) into a mipmap level
@@ -74,21 +107,74 @@ public:
 	// Convert world coordinates to mipmap grid coordinates at a given level
 	static void globalToMipmap(F64 global_x, F64 global_y, S32 level, U32* grid_x, U32* grid_y);
 
+protected:
+	// Send the HTTP request for a tile, the responder updates request as it goes
+	virtual void fetchTile(TileRequest* request, const std::string& url);
+
 private:
+	struct Tile
+	{
+		enum EState
+		{
+			QUEUED,
+			FETCHING,
+			LOADED,
+			MISSING
+		};
+
+		Tile();
+
+		EState mState;
+		S32 mLevel;
+		U32 mGridX;
+		U32 mGridY;
+		F32 mPriority;						// while queued, highest first
+		S32 mRetries;						// failed fetches so far
+		U32 mLastUsed;						// update count when last drawn or requested
+		LLPointer<TileRequest> mRequest;	// while fetching
+		LLPointer<LLViewerTexture> mTexture;	// once loaded
+		S32 mBytes;
+	};
+
 	// Get a handle (key) from grid coordinates
 	U64		convertGridToHandle(U32 grid_x, U32 grid_y) { return to_region_handle(grid_x * REGION_WIDTH_UNITS, grid_y * REGION_WIDTH_UNITS); }
-	// Load the relevant tile from S3
-	LLPointer<LLViewerFetchedTexture> loadObjectsTile(U32 grid_x, U32 grid_y, S32 level);
+	// Priority of a tile for a view centered on center_x, center_y: closer tiles first
+	F32		getTilePriority(U32 grid_x, U32 grid_y, S32 level, F64 center_x, F64 center_y, F32 base);
+	// Find a tile, queuing it at that priority if it's not around yet
+	Tile&	requestTile(U32 grid_x, U32 grid_y, S32 level, F32 priority);
+	// Queue the tiles of a level covering a rectangle (global meters) around its center
+	void	prefetchTiles(F64 left, F64 bottom, F64 right, F64 top, S32 level, F32 base);
+	// Send the HTTP request of the relevant tile to S3
+	void	loadObjectsTile(Tile& tile);
+	// Upload the tiles decoded since the last call, up to a few per call, and queue failed ones again
+	void	finishRequests();
+	// Drop the least recently drawn tiles beyond the memory budget
+	void	evictTiles(S64 budget);
 	// Clear a level from its "missing" tiles
 	void cleanMissedTilesFromLevel(S32 level);
 
 	// The mipmap is organized by resolution level (MAP_LEVELS of them). Each resolution level is an std::map
-	// using a region_handle as a key and storing a smart pointer to the image as a value.
-	typedef std::map<U64, LLPointer<LLViewerFetchedTexture> > sublevel_tiles_t;
+	// using a region_handle as a key and storing the tile as a value.
+	typedef std::map<U64, Tile> sublevel_tiles_t;
 	sublevel_tiles_t mWorldObjectsMipMap[MAP_LEVELS];
 //	sublevel_tiles_t mWorldTerrainMipMap[MAP_LEVELS];
 
 	S32 mCurrentLevel;		// The level last accessed by a getObjectsTile()
+
+	// The view as of the last setView()
+	F64 mViewLeft;
+	F64 mViewBottom;
+	F64 mViewRight;
+	F64 mViewTop;
+	S32 mViewLevel;
+	F64 mVelocityX;			// pan velocity in meters per second
+	F64 mVelocityY;
+	S32 mZoomDirection;		// -1 when zooming in, 1 when zooming out
+	LLTimer mViewTimer;
+
+	U32 mUpdateCount;
+	S32 mActiveRequests;	// tiles being fetched or decoded
+	S64 mLoadedBytes;		// memory of the loaded tiles
 };
 
 #endif // LL_LLWORLDMIPMAP_H
@@ -66,6 +66,7 @@
 #include "llhudmanager.h"
 #include "llhudnametag.h"
 #include "llhudtext.h"
+#include "llinstancedgeometry.h"
 #include "lllightconstants.h"
 #include "llresmgr.h"
 #include "llselectmgr.h"
@@ -100,6 +101,8 @@
 #include "llspatialpartition.h"
 #include "llmutelist.h"
 #include "lltoolpie.h"
+#include "llthreadpool.h"
+#include "llcompressedtexturecache.h"
 
 
 #ifdef _DEBUG
@@ -279,6 +282,8 @@ BOOL	LLPipeline::sTextureBindTest = FALSE;
 BOOL	LLPipeline::sRenderFrameTest = FALSE;
 BOOL	LLPipeline::sRenderAttachedLights = TRUE;
 BOOL	LLPipeline::sRenderAttachedParticles = TRUE;
+BOOL	LLPipeline::sRenderMultiDraw = TRUE;
+BOOL	LLPipeline::sRenderInstancing = FALSE;
 BOOL	LLPipeline::sRenderDeferred = FALSE;
 BOOL    LLPipeline::sAllowRebuildPriorityGroup = FALSE ;
 S32		LLPipeline::sVisibleLightCount = 0;
@@ -315,6 +320,8 @@ LLPipeline::LLPipeline() :
 	mMinBatchSize(0),
 	mMeanBatchSize(0),
 	mTrianglesDrawn(0),
+	mDrawCalls(0),
+	mStateChanges(0),
 	mNumVisibleNodes(0),
 	mVerticesRelit(0),
 	mLightingChanges(0),
@@ -327,6 +334,7 @@ LLPipeline::LLPipeline() :
 	mRenderDebugFeatureMask(0),
 	mRenderDebugMask(0),
 	mOldRenderDebugMask(0),
+	mCullThreads(NULL),
 	mLastRebuildPool(NULL),
 	mAlphaPool(NULL),
 	mSkyPool(NULL),
@@ -358,8 +366,17 @@ void LLPipeline::init()
 	sRenderBump = gSavedSettings.getBOOL("RenderObjectBump");
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
+	LLVertexBuffer::sUseSlabs = gSavedSettings.getBOOL("RenderVBOSlabs");
 	sRenderAttachedLights = gSavedSettings.getBOOL("RenderAttachedLights");
 	sRenderAttachedParticles = gSavedSettings.getBOOL("RenderAttachedParticles");
+	sRenderMultiDraw = gSavedSettings.getBOOL("RenderMultiDraw");
+	sRenderInstancing = gSavedSettings.getBOOL("RenderInstancedPrims");
+
+	U32 cull_threads = llmin(gSavedSettings.getU32("RenderCullThreads"), (U32) 16);
+	if (cull_threads > 0 && !mCullThreads)
+	{
+		mCullThreads = new LLThreadPool("Cull", cull_threads);
+	}
 
 	mInitialized = TRUE;
 	
@@ -375,6 +392,20 @@ void LLPipeline::init()
 	getPool(LLDrawPool::POOL_GLOW);
 
 	LLViewerStats::getInstance()->mTrianglesDrawnStat.reset();
+	LLViewerStats::getInstance()->mDrawCallsStat.reset();
+	LLViewerStats::getInstance()->mStateChangesStat.reset();
+	LLViewerStats::getInstance()->mVBOBindsStat.reset();
+	LLViewerStats::getInstance()->mVBOSlabWasteStat.reset();
+	LLViewerStats::getInstance()->mInstancedFacesStat.reset();
+	LLViewerStats::getInstance()->mInstanceSavedStat.reset();
+	LLViewerStats::getInstance()->mSoftOccludedStat.reset();
+	LLViewerStats::getInstance()->mSoftOcclusionTimeStat.reset();
+	LLViewerStats::getInstance()->mSoftOcclusionFalseStat.reset();
+	LLViewerStats::getInstance()->mSoftOcclusionMissedStat.reset();
+	LLViewerStats::getInstance()->mGlyphRunHitStat.reset();
+	LLViewerStats::getInstance()->mCompressedTextureHitStat.reset();
+	LLViewerStats::getInstance()->mDecodesAvoidedStat.reset();
+	LLViewerStats::getInstance()->mMapPanLatencyStat.reset();
 	resetFrameStats();
 
 	for (U32 i = 0; i < NUM_RENDER_TYPES; ++i)
@@ -424,6 +455,8 @@ void LLPipeline::cleanup()
 	mGroupQ1.clear() ;
 	mGroupQ2.clear() ;
 
+	mSoftwareOcclusion.clearOccluders();
+
 	for(pool_set_t::iterator iter = mPools.begin();
 		iter != mPools.end(); )
 	{
@@ -482,10 +515,21 @@ void LLPipeline::cleanup()
 
 	releaseGLBuffers();
 
+	LLInstancedGeometry::cleanupClass();
+
 	mFaceSelectImagep = NULL;
 
 	mMovedBridge.clear();
 
+	delete mCullThreads;
+	mCullThreads = NULL;
+	for_each(mCullJobs.begin(), mCullJobs.end(), DeletePointer());
+	mCullJobs.clear();
+	for_each(mStateSortJobs.begin(), mStateSortJobs.end(), DeletePointer());
+	mStateSortJobs.clear();
+	mStateSortList.clear();
+	mStateSortFlags.clear();
+
 	mInitialized = FALSE;
 }
 
@@ -1311,12 +1355,35 @@ void LLPipeline::resetFrameStats()
 	assertInitialized();
 
 	LLViewerStats::getInstance()->mTrianglesDrawnStat.addValue(mTrianglesDrawn/1000.f);
+	LLViewerStats::getInstance()->mDrawCallsStat.addValue(mDrawCalls);
+	LLViewerStats::getInstance()->mStateChangesStat.addValue(mStateChanges);
+	LLViewerStats::getInstance()->mVBOBindsStat.addValue(LLVertexBuffer::sFrameBindCount);
+	LLViewerStats::getInstance()->mVBOSlabWasteStat.addValue(LLVertexBuffer::sSlabWastedBytes/1024.f);
+	LLViewerStats::getInstance()->mInstancedFacesStat.addValue(LLInstancedGeometry::sInstanceCount);
+	LLViewerStats::getInstance()->mInstanceSavedStat.addValue(LLInstancedGeometry::sSavedBytes/1024.f);
+	LLVertexBuffer::sFrameBindCount = 0;
+	mSoftwareOcclusion.updateStats();
+
+	U32 glyph_run_lookups = LLFontGL::sGlyphRunHits + LLFontGL::sGlyphRunMisses;
+	if (glyph_run_lookups > 0)
+	{
+		LLViewerStats::getInstance()->mGlyphRunHitStat.addValue(LLFontGL::sGlyphRunHits * 100.f / glyph_run_lookups);
+	}
+	LLFontGL::sGlyphRunHits = 0;
+	LLFontGL::sGlyphRunMisses = 0;
+
+	LLViewerStats::getInstance()->mCompressedTextureHitStat.addValue((U32)LLCompressedTextureCache::sHits);
+	LLViewerStats::getInstance()->mDecodesAvoidedStat.addValue((U32)LLCompressedTextureCache::sDecodesAvoided);
+	LLCompressedTextureCache::sHits = 0;
+	LLCompressedTextureCache::sDecodesAvoided = 0;
 
 	if (mBatchCount > 0)
 	{
 		mMeanBatchSize = gPipeline.mTrianglesDrawn/gPipeline.mBatchCount;
 	}
 	mTrianglesDrawn = 0;
+	mDrawCalls = 0;
+	mStateChanges = 0;
 	sCompiles        = 0;
 	mVerticesRelit   = 0;
 	mLightingChanges = 0;
@@ -1566,6 +1633,87 @@ BOOL LLPipeline::getVisibleExtents(LLCamera& camera, LLVector3& min, LLVector3&
 
 static LLFastTimer::DeclareTimer FTM_CULL("Object Culling");
 
+// Culls one partition, or marks one bridge visible, into its own cull
+// result. The results are merged into sCull in job order afterwards, so
+// the pipeline sees the same lists as when culling serially.
+class LLCullJob : public LLThreadPool::Job
+{
+public:
+	LLCullJob() : mPartition(NULL), mBridge(NULL) { }
+
+	/*virtual*/ void run()
+	{
+		if (mBridge)
+		{
+			mBridge->setVisible(mCamera, mResult);
+		}
+		else
+		{
+			mPartition->cull(mCamera, mResult);
+		}
+	}
+
+	LLSpatialPartition* mPartition;
+	LLSpatialBridge* mBridge;
+	LLCamera mCamera;
+	LLCullResult mResult;
+};
+
+// Runs prepareStateSort() over a slice of mStateSortList.
+class LLStateSortJob : public LLThreadPool::Job
+{
+public:
+	LLStateSortJob()
+		: mDrawables(NULL), mFlags(NULL), mCount(0), mCamera(NULL), mHideSelected(FALSE) { }
+
+	/*virtual*/ void run()
+	{
+		for (U32 i = 0; i < mCount; ++i)
+		{
+			mFlags[i] = gPipeline.prepareStateSort(mDrawables[i], *mCamera, mHideSelected);
+		}
+	}
+
+	LLDrawable** mDrawables;
+	U8* mFlags;
+	U32 mCount;
+	LLCamera* mCamera;
+	BOOL mHideSelected;
+};
+
+BOOL LLPipeline::canCullInParallel() const
+{
+	// World camera culls issue occlusion queries and may rebuild groups
+	// from markNotCulled(), neither of which can leave the main thread.
+	return mCullThreads &&
+		sUseOcclusion <= 1 &&
+		LLViewerCamera::sCurCameraID != LLViewerCamera::CAMERA_WORLD;
+}
+
+LLCullJob* LLPipeline::getCullJob(U32 index)
+{
+	while (mCullJobs.size() <= index)
+	{
+		mCullJobs.push_back(new LLCullJob());
+	}
+	return mCullJobs[index];
+}
+
+void LLPipeline::runCullJobs(U32 count)
+{
+	LLThreadPool::job_list_t jobs(mCullJobs.begin(), mCullJobs.begin() + count);
+	mCullThreads->run(jobs);
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		LLCullResult& result = mCullJobs[i]->mResult;
+		mNumVisibleNodes += result.getVisibleGroupsSize() + result.getDrawableGroupsSize();
+		mSoftwareOcclusion.addTally(result.getSoftOcclusionTally());
+		sCull->append(result);
+		result.clear();
+	}
+}
+
 void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_clip)
 {
 	LLFastTimer t(FTM_CULL);
@@ -1607,6 +1755,17 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	LLGLDepthTest depth(GL_TRUE, GL_FALSE);
 
+	if (LLSoftwareOcclusion::isEnabledFor(LLViewerCamera::sCurCameraID) &&
+		!hasRenderType(LLPipeline::RENDER_TYPE_HUD))
+	{
+		mSoftwareOcclusion.build(camera, water_clip, hasRenderType(LLPipeline::RENDER_TYPE_TERRAIN));
+	}
+
+	// Each partition gets its own job with a copy of the camera, clip plane
+	// included, when the cull threads can take this pass.
+	BOOL parallel = canCullInParallel();
+	U32 cull_jobs = 0;
+
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
 	{
@@ -1628,7 +1787,17 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 			{
 				if (hasRenderType(part->mDrawableType))
 				{
-					part->cull(camera);
+					if (parallel)
+					{
+						LLCullJob* job = getCullJob(cull_jobs++);
+						job->mPartition = part;
+						job->mBridge = NULL;
+						job->mCamera = camera;
+					}
+					else
+					{
+						part->cull(camera);
+					}
 				}
 			}
 		}
@@ -1636,6 +1805,13 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 
 	camera.disableUserClipPlane();
 
+	if (cull_jobs > 0)
+	{
+		runCullJobs(cull_jobs);
+	}
+
+	mSoftwareOcclusion.invalidate();
+
 	if (hasRenderType(LLPipeline::RENDER_TYPE_SKY) && 
 		gSky.mVOSkyp.notNull() && 
 		gSky.mVOSkyp->mDrawable.notNull())
@@ -1674,10 +1850,18 @@ void LLPipeline::updateCull(LLCamera& camera, LLCullResult& result, S32 water_cl
 }
 
 void LLPipeline::markNotCulled(LLSpatialGroup* group, LLCamera& camera)
+{
+	if (markNotCulled(group, camera, *sCull))
+	{
+		mNumVisibleNodes++;
+	}
+}
+
+BOOL LLPipeline::markNotCulled(LLSpatialGroup* group, LLCamera& camera, LLCullResult& result)
 {
 	if (group->getData().empty())
 	{ 
-		return;
+		return FALSE;
 	}
 	
 	group->setVisible();
@@ -1691,27 +1875,27 @@ void LLPipeline::markNotCulled(LLSpatialGroup* group, LLCamera& camera)
 
 	if (group->mPixelArea < MINIMUM_PIXEL_AREA)
 	{
-		return;
+		return FALSE;
 	}
 
 	if (sMinRenderSize > 0.f && 
 			llmax(llmax(group->mBounds[1].mV[0], group->mBounds[1].mV[1]), group->mBounds[1].mV[2]) < sMinRenderSize)
 	{
-		return;
+		return FALSE;
 	}
 
 	assertInitialized();
 	
 	if (!group->mSpatialPartition->mRenderByGroup)
 	{ //render by drawable
-		sCull->pushDrawableGroup(group);
+		result.pushDrawableGroup(group);
 	}
 	else
 	{   //render by group
-		sCull->pushVisibleGroup(group);
+		result.pushVisibleGroup(group);
 	}
 
-	mNumVisibleNodes++;
+	return TRUE;
 }
 
 void LLPipeline::markOccluder(LLSpatialGroup* group)
@@ -1961,6 +2145,32 @@ void LLPipeline::updateGeom(F32 max_dtime)
 	updateMovedList(mMovedBridge);
 }
 
+// Attachments of impostored avatars are drawn into the impostor.
+static bool is_impostor_bridge(LLSpatialBridge* bridge)
+{
+	const LLDrawable* root = bridge->mDrawable;
+	llassert(root); // trying to catch a bad assumption
+	if (root && //  // this test may not be needed, see above
+	    root->getVObj()->isAttachment())
+	{
+		LLDrawable* rootparent = root->getParent();
+		if (rootparent) // this IS sometimes NULL
+		{
+			LLViewerObject *vobj = rootparent->getVObj();
+			llassert(vobj); // trying to catch a bad assumption
+			if (vobj) // this test may not be needed, see above
+			{
+				const LLVOAvatar* av = vobj->asAvatar();
+				if (av && av->isImpostor())
+				{
+					return true;
+				}
+			}
+		}
+	}
+	return false;
+}
+
 void LLPipeline::markVisible(LLDrawable *drawablep, LLCamera& camera)
 {
 	LLMemType mt(LLMemType::MTYPE_PIPELINE_MARK_VISIBLE);
@@ -1969,26 +2179,10 @@ void LLPipeline::markVisible(LLDrawable *drawablep, LLCamera& camera)
 	{
 	if (drawablep->isSpatialBridge())
 	{
-			const LLDrawable* root = ((LLSpatialBridge*) drawablep)->mDrawable;
-			llassert(root); // trying to catch a bad assumption
-			if (root && //  // this test may not be needed, see above
-			    root->getVObj()->isAttachment())
-			{
-				LLDrawable* rootparent = root->getParent();
-				if (rootparent) // this IS sometimes NULL
-				{
-					LLViewerObject *vobj = rootparent->getVObj();
-					llassert(vobj); // trying to catch a bad assumption
-					if (vobj) // this test may not be needed, see above
+		if (is_impostor_bridge((LLSpatialBridge*) drawablep))
 		{
-						const LLVOAvatar* av = vobj->asAvatar();
-			if (av && av->isImpostor())
-			{
-				return;
-			}
+			return;
 		}
-				}
-			}
 		sCull->pushBridge((LLSpatialBridge*) drawablep);
 	}
 	else
@@ -2228,6 +2422,12 @@ void LLPipeline::stateSort(LLCamera& camera, LLCullResult &result)
 	//LLVertexBuffer::unbind();
 
 	grabReferences(result);
+
+	// Bridges found below are culled on the cull threads when that is safe,
+	// the groups they make visible are merged in bridge order afterwards.
+	BOOL cull_bridges = canCullInParallel();
+	U32 bridge_jobs = 0;
+
 	for (LLCullResult::sg_list_t::iterator iter = sCull->beginDrawableGroups(); iter != sCull->endDrawableGroups(); ++iter)
 	{
 		LLSpatialGroup* group = *iter;
@@ -2241,10 +2441,39 @@ void LLPipeline::stateSort(LLCamera& camera, LLCullResult &result)
 			group->setVisible();
 			for (LLSpatialGroup::element_iter i = group->getData().begin(); i != group->getData().end(); ++i)
 			{
-				markVisible(*i, camera);
+				LLDrawable* drawablep = *i;
+				if (cull_bridges && drawablep && !drawablep->isDead() && drawablep->isSpatialBridge())
+				{
+					LLSpatialBridge* bridge = (LLSpatialBridge*) drawablep;
+					if (!is_impostor_bridge(bridge))
+					{
+						sCull->pushBridge(bridge);
+						LLCullJob* job = getCullJob(bridge_jobs++);
+						job->mPartition = NULL;
+						job->mBridge = bridge;
+						job->mCamera = camera;
+					}
+				}
+				else
+				{
+					markVisible(drawablep, camera);
+				}
 			}
 		}
 	}
+
+	if (bridge_jobs > 0)
+	{
+		runCullJobs(bridge_jobs);
+	}
+
+	mStateSortList.clear();
+
+	// The world camera also updates LOD distances here, which touches shared
+	// transforms, so it stays serial along with the bridge pass below and
+	// groups, bridges and the visible list keep their original order.
+	BOOL thread_sort = cull_bridges;
+
 	for (LLCullResult::sg_list_t::iterator iter = sCull->beginVisibleGroups(); iter != sCull->endVisibleGroups(); ++iter)
 	{
 		LLSpatialGroup* group = *iter;
@@ -2256,7 +2485,18 @@ void LLPipeline::stateSort(LLCamera& camera, LLCullResult &result)
 		else
 		{
 			group->setVisible();
-			stateSort(group, camera);
+			if (!thread_sort)
+			{
+				stateSort(group, camera);
+			}
+			else if (group->changeLOD())
+			{
+				// Prepared on the cull threads with the visible list below.
+				for (LLSpatialGroup::element_iter i = group->getData().begin(); i != group->getData().end(); ++i)
+				{
+					mStateSortList.push_back(*i);
+				}
+			}
 		}
 	}
 	
@@ -2273,6 +2513,17 @@ void LLPipeline::stateSort(LLCamera& camera, LLCullResult &result)
 			}
 		}
 	}
+	if (thread_sort)
+	{
+		LLFastTimer ftm(FTM_STATESORT_DRAWABLE);
+		for (LLCullResult::drawable_list_t::iterator iter = sCull->beginVisibleList();
+			 iter != sCull->endVisibleList(); ++iter)
+		{
+			mStateSortList.push_back(*iter);
+		}
+		stateSortDrawables(camera);
+	}
+	else
 	{
 		LLFastTimer ftm(FTM_STATESORT_DRAWABLE);
 		for (LLCullResult::drawable_list_t::iterator iter = sCull->beginVisibleList();
@@ -2317,72 +2568,159 @@ void LLPipeline::stateSort(LLSpatialBridge* bridge, LLCamera& camera)
 	}
 }
 
-void LLPipeline::stateSort(LLDrawable* drawablep, LLCamera& camera)
+void LLPipeline::stateSortDrawables(LLCamera& camera)
 {
-	LLMemType mt(LLMemType::MTYPE_PIPELINE_STATE_SORT);
-		
+	const U32 MIN_DRAWABLES_PER_JOB = 64;
+
+	U32 count = mStateSortList.size();
+	mStateSortFlags.assign(count, 0);
+
+	if (count >= MIN_DRAWABLES_PER_JOB * 2)
+	{
+		// A few jobs per thread so a slice full of alpha faces doesn't
+		// hold up the others.
+		U32 num_jobs = llclamp(count / MIN_DRAWABLES_PER_JOB, (U32) 1, (mCullThreads->getThreadCount() + 1) * 4);
+		U32 per_job = (count + num_jobs - 1) / num_jobs;
+		BOOL hide_selected = LLSelectMgr::getInstance()->mHideSelectedObjects;
+
+		while (mStateSortJobs.size() < num_jobs)
+		{
+			mStateSortJobs.push_back(new LLStateSortJob());
+		}
+
+		LLThreadPool::job_list_t jobs;
+		for (U32 start = 0; start < count; start += per_job)
+		{
+			LLStateSortJob* job = mStateSortJobs[jobs.size()];
+			job->mDrawables = &mStateSortList[start];
+			job->mFlags = &mStateSortFlags[start];
+			job->mCount = llmin(per_job, count - start);
+			job->mCamera = &camera;
+			job->mHideSelected = hide_selected;
+			jobs.push_back(job);
+		}
+
+		mCullThreads->run(jobs);
+	}
+
+	for (U32 i = 0; i < count; ++i)
+	{
+		LLDrawable* drawablep = mStateSortList[i];
+		if (!drawablep->isDead())
+		{
+			stateSort(drawablep, camera, mStateSortFlags[i]);
+		}
+	}
+
+	mStateSortList.clear();
+}
+
+U8 LLPipeline::prepareStateSort(LLDrawable* drawablep, LLCamera& camera, BOOL hide_selected)
+{
+	// Avatars update their visibility from updateLOD() and bridges cull into
+	// the pipeline's result from setVisible(), leave them to stateSort().
 	if (!drawablep
 		|| drawablep->isDead() 
+		|| drawablep->isAvatar()
+		|| drawablep->isSpatialBridge()
 		|| !hasRenderType(drawablep->getRenderType()))
 	{
-		return;
+		return 0;
 	}
-	
-	if (LLSelectMgr::getInstance()->mHideSelectedObjects)
+
+	if (hide_selected &&
+		drawablep->getVObj().notNull() &&
+		drawablep->getVObj()->isSelected())
 	{
-		if (drawablep->getVObj().notNull() &&
-			drawablep->getVObj()->isSelected())
-		{
-			return;
-		}
+		return 0;
 	}
 
-	if (drawablep->isAvatar())
-	{ //don't draw avatars beyond render distance or if we don't have a spatial group.
-		if ((drawablep->getSpatialGroup() == NULL) || 
-			(drawablep->getSpatialGroup()->mDistance > LLVOAvatar::sRenderDistance))
+	llassert(LLViewerCamera::sCurCameraID != LLViewerCamera::CAMERA_WORLD);
+
+	if (!drawablep->isState(LLDrawable::INVISIBLE|LLDrawable::FORCE_INVISIBLE))
+	{
+		drawablep->setVisible(camera, NULL, FALSE);
+	}
+	else if (drawablep->isState(LLDrawable::CLEAR_INVISIBLE))
+	{
+		// clear invisible flag here to avoid single frame glitch
+		drawablep->clearState(LLDrawable::FORCE_INVISIBLE|LLDrawable::CLEAR_INVISIBLE);
+	}
+
+	return STATE_SORT_PREPARED;
+}
+
+void LLPipeline::stateSort(LLDrawable* drawablep, LLCamera& camera, U8 prepared)
+{
+	LLMemType mt(LLMemType::MTYPE_PIPELINE_STATE_SORT);
+
+	// prepareStateSort() already did the checks and visibility below,
+	// only the face pools are left.
+	if (!(prepared & STATE_SORT_PREPARED))
+	{
+		if (!drawablep
+			|| drawablep->isDead() 
+			|| !hasRenderType(drawablep->getRenderType()))
 		{
 			return;
 		}
-
-		LLVOAvatar* avatarp = (LLVOAvatar*) drawablep->getVObj().get();
-		if (!avatarp->isVisible())
+		
+		if (LLSelectMgr::getInstance()->mHideSelectedObjects)
 		{
-			return;
+			if (drawablep->getVObj().notNull() &&
+				drawablep->getVObj()->isSelected())
+			{
+				return;
+			}
 		}
-	}
 
-	assertInitialized();
+		if (drawablep->isAvatar())
+		{ //don't draw avatars beyond render distance or if we don't have a spatial group.
+			if ((drawablep->getSpatialGroup() == NULL) || 
+				(drawablep->getSpatialGroup()->mDistance > LLVOAvatar::sRenderDistance))
+			{
+				return;
+			}
 
-	if (hasRenderType(drawablep->mRenderType))
-	{
-		if (!drawablep->isState(LLDrawable::INVISIBLE|LLDrawable::FORCE_INVISIBLE))
-		{
-			drawablep->setVisible(camera, NULL, FALSE);
+			LLVOAvatar* avatarp = (LLVOAvatar*) drawablep->getVObj().get();
+			if (!avatarp->isVisible())
+			{
+				return;
+			}
 		}
-		else if (drawablep->isState(LLDrawable::CLEAR_INVISIBLE))
+
+		assertInitialized();
+
+		if (hasRenderType(drawablep->mRenderType))
 		{
-			// clear invisible flag here to avoid single frame glitch
-			drawablep->clearState(LLDrawable::FORCE_INVISIBLE|LLDrawable::CLEAR_INVISIBLE);
+			if (!drawablep->isState(LLDrawable::INVISIBLE|LLDrawable::FORCE_INVISIBLE))
+			{
+				drawablep->setVisible(camera, NULL, FALSE);
+			}
+			else if (drawablep->isState(LLDrawable::CLEAR_INVISIBLE))
+			{
+				// clear invisible flag here to avoid single frame glitch
+				drawablep->clearState(LLDrawable::FORCE_INVISIBLE|LLDrawable::CLEAR_INVISIBLE);
+			}
 		}
-	}
 
-	if (LLViewerCamera::sCurCameraID == LLViewerCamera::CAMERA_WORLD)
-	{
-		LLSpatialGroup* group = drawablep->getSpatialGroup();
-		if (!group || group->changeLOD())
+		if (LLViewerCamera::sCurCameraID == LLViewerCamera::CAMERA_WORLD)
 		{
-			if (drawablep->isVisible())
+			LLSpatialGroup* group = drawablep->getSpatialGroup();
+			if (!group || group->changeLOD())
 			{
-				if (!drawablep->isActive())
-				{
-					bool force_update = false;
-					drawablep->updateDistance(camera, force_update);
-				}
-				else if (drawablep->isAvatar())
+				if (drawablep->isVisible())
 				{
-					bool force_update = false;
-					drawablep->updateDistance(camera, force_update); // calls vobj->updateLOD() which calls LLVOAvatar::updateVisibility()
+					if (!drawablep->isActive())
+					{
+						bool force_update = false;
+						drawablep->updateDistance(camera, force_update);
+					}
+					else if (drawablep->isAvatar())
+					{
+						bool force_update = false;
+						drawablep->updateDistance(camera, force_update); // calls vobj->updateLOD() which calls LLVOAvatar::updateVisibility()
+					}
 				}
 			}
 		}
@@ -2623,7 +2961,10 @@ void LLPipeline::postSort(LLCamera& camera)
 			group->rebuildGeom();
 		}
 
-		for (LLSpatialGroup::draw_map_t::iterator j = group->mDrawMap.begin(); j != group->mDrawMap.end(); ++j)
+		// The size filter works per draw info, so it needs the unmerged map.
+		LLSpatialGroup::draw_map_t& draw_map = (sRenderMultiDraw && sMinRenderSize <= 0.f) ? group->getBatchMap() : group->mDrawMap;
+
+		for (LLSpatialGroup::draw_map_t::iterator j = draw_map.begin(); j != draw_map.end(); ++j)
 		{
 			LLSpatialGroup::drawmap_elem_t& src_vec = j->second;	
 			if (!hasRenderType(j->first))
@@ -3540,6 +3881,7 @@ void LLPipeline::addTrianglesDrawn(S32 index_count, U32 render_type)
 
 	mTrianglesDrawn += count;
 	mBatchCount++;
+	mDrawCalls++;
 	mMaxBatchSize = llmax(mMaxBatchSize, count);
 	mMinBatchSize = llmin(mMinBatchSize, count);
 
@@ -5243,6 +5585,8 @@ void LLPipeline::resetVertexBuffers()
 	sRenderBump = gSavedSettings.getBOOL("RenderObjectBump");
 	sUseTriStrips = gSavedSettings.getBOOL("RenderUseTriStrips");
 	LLVertexBuffer::sUseStreamDraw = gSavedSettings.getBOOL("RenderUseStreamVBO");
+	LLVertexBuffer::sUseSlabs = gSavedSettings.getBOOL("RenderVBOSlabs");
+	sRenderInstancing = gSavedSettings.getBOOL("RenderInstancedPrims");
 
 	for (LLWorld::region_list_t::const_iterator iter = LLWorld::getInstance()->getRegionList().begin(); 
 			iter != LLWorld::getInstance()->getRegionList().end(); ++iter)
@@ -5262,6 +5606,8 @@ void LLPipeline::resetVertexBuffers()
 
 	gSky.resetVertexBuffers();
 
+	LLInstancedGeometry::cleanupClass();
+
 	if (LLVertexBuffer::sGLCount > 0)
 	{
 		LLVertexBuffer::cleanupClass();
@@ -39,6 +39,7 @@
 #include "llgl.h"
 #include "lldrawable.h"
 #include "llrendertarget.h"
+#include "llsoftwareocclusion.h"
 
 #include <stack>
 
@@ -54,6 +55,9 @@ class LLCubeMap;
 class LLCullResult;
 class LLVOAvatar;
 class LLGLSLShader;
+class LLThreadPool;
+class LLCullJob;
+class LLStateSortJob;
 
 typedef enum e_avatar_skinning_method
 {
@@ -143,6 +147,9 @@ public:
 	void		markOccluder(LLSpatialGroup* group);
 	void		doOcclusion(LLCamera& camera);
 	void		markNotCulled(LLSpatialGroup* group, LLCamera &camera);
+	// Pushes into result instead of the pipeline's cull result, returns TRUE
+	// if the group was pushed. Safe from a cull thread when canCullInParallel().
+	BOOL		markNotCulled(LLSpatialGroup* group, LLCamera &camera, LLCullResult& result);
 	void        markMoved(LLDrawable *drawablep, BOOL damped_motion = FALSE);
 	void        markShift(LLDrawable *drawablep);
 	void        markTextured(LLDrawable *drawablep);
@@ -214,7 +221,7 @@ public:
 	void stateSort(LLCamera& camera, LLCullResult& result);
 	void stateSort(LLSpatialGroup* group, LLCamera& camera);
 	void stateSort(LLSpatialBridge* bridge, LLCamera& camera);
-	void stateSort(LLDrawable* drawablep, LLCamera& camera);
+	void stateSort(LLDrawable* drawablep, LLCamera& camera, U8 prepared = 0);
 	void postSort(LLCamera& camera);
 	void forAllVisibleDrawables(void (*func)(LLDrawable*));
 
@@ -340,6 +347,24 @@ private:
 	BOOL updateDrawableGeom(LLDrawable* drawable, BOOL priority);
 	void assertInitializedDoError();
 	bool assertInitialized() { const bool is_init = isInit(); if (!is_init) assertInitializedDoError(); return is_init; };
+
+	// Culling on the cull threads is only safe for passes that issue no
+	// occlusion queries and never rebuild groups while culling, which
+	// leaves shadow and reflection cameras.
+	BOOL canCullInParallel() const;
+	LLCullJob* getCullJob(U32 index);
+	void runCullJobs(U32 count);
+	void stateSortDrawables(LLCamera& camera);
+
+public:
+	enum
+	{
+		STATE_SORT_PREPARED = 0x01
+	};
+
+	// The part of stateSort(LLDrawable*) that only touches the drawable,
+	// run from the cull threads. Returns STATE_SORT_* flags for stateSort().
+	U8 prepareStateSort(LLDrawable* drawablep, LLCamera& camera, BOOL hide_selected);
 	
 public:
 	enum {GPU_CLASS_MAX = 3 };
@@ -443,6 +468,8 @@ public:
 	S32						 mMinBatchSize;
 	S32						 mMeanBatchSize;
 	S32						 mTrianglesDrawn;
+	S32						 mDrawCalls;		// this frame, a multi draw counts once
+	S32						 mStateChanges;	// texture, vertex buffer and matrix changes between draws this frame
 	S32						 mNumVisibleNodes;
 	S32						 mVerticesRelit;
 
@@ -475,6 +502,8 @@ public:
 	static BOOL				sRenderFrameTest;
 	static BOOL				sRenderAttachedLights;
 	static BOOL				sRenderAttachedParticles;
+	static BOOL				sRenderMultiDraw;
+	static BOOL				sRenderInstancing;
 	static BOOL				sRenderDeferred;
 	static BOOL             sAllowRebuildPriorityGroup;
 	static S32				sVisibleLightCount;
@@ -496,6 +525,9 @@ public:
 	LLRenderTarget			mLuminanceMap;
 	LLRenderTarget			mHighlight;
 
+	//CPU occlusion buffer, rebuilt in updateCull for the cameras it's on for
+	LLSoftwareOcclusion		mSoftwareOcclusion;
+
 	//sun shadow map
 	LLRenderTarget			mShadow[6];
 	std::vector<LLVector3>	mShadowFrustPoints[4];
@@ -562,6 +594,16 @@ protected:
 	LLDrawable::drawable_vector_t mMovedBridge;
 	LLDrawable::drawable_vector_t	mShiftList;
 
+	/////////////////////////////////////////////
+	//
+	// Cull threads, NULL when RenderCullThreads is 0.
+	//
+	LLThreadPool*					mCullThreads;
+	std::vector<LLCullJob*>			mCullJobs;
+	std::vector<LLStateSortJob*>	mStateSortJobs;
+	std::vector<LLDrawable*>		mStateSortList;	// not refcounted, read by the cull threads
+	std::vector<U8>					mStateSortFlags;
+
 	/////////////////////////////////////////////
 	//
 	//
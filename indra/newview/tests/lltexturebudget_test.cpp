@@ -0,0 +1,271 @@
+/**
+ * @file lltexturebudget_test.cpp
+ * @brief Tests and trace driven simulation of the texture memory budget
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "../llviewerprecompiledheaders.h"
+
+#include "../lltexturebudget.h"
+
+#include "../test/lltut.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	LLTextureBudget::Texture make_texture(U32 id, S32 size, F32 area, S32 current = -1)
+	{
+		LLTextureBudget::Texture texture;
+		texture.mID = id;
+		texture.mFullWidth = size;
+		texture.mFullHeight = size;
+		texture.mComponents = 4;
+		texture.mPixelArea = area;
+		texture.mMinDiscard = 0;
+		texture.mMaxDiscard = MAX_DISCARD_LEVEL;
+		texture.mCurrentDiscard = current;
+		return texture;
+	}
+
+	// A camera flying along a row of textures, with the jitter in virtual
+	// size that frame to frame changes in view angle and occlusion give.
+	void write_flythrough(std::ostream& trace, U32 frames, U32 count)
+	{
+		U32 seed = 1;
+		std::vector<F32> positions(count);
+		std::vector<S32> sizes(count);
+		for (U32 i = 0; i < count; i++)
+		{
+			seed = seed * 1664525 + 1013904223;
+			positions[i] = (F32)(seed % 3000);
+			sizes[i] = 256 << ((seed >> 16) % 3);
+		}
+
+		LLTextureBudget::texture_list_t textures;
+		for (U32 frame = 0; frame < frames; frame++)
+		{
+			F32 camera = frame * 4.f;
+			textures.clear();
+			for (U32 i = 0; i < count; i++)
+			{
+				F32 distance = positions[i] - camera;
+				F32 area = 0.f;
+				if (distance > -50.f && distance < 600.f)
+				{
+					seed = seed * 1664525 + 1013904223;
+					F32 jitter = 0.8f + 0.4f * (F32)(seed >> 8) / (F32)(1 << 24);
+					area = jitter * 2.e8f / (distance * distance + 400.f);
+				}
+				textures.push_back(make_texture(i + 1, sizes[i], area));
+			}
+			LLTextureBudget::writeTrace(trace, frame, textures);
+		}
+	}
+
+	void log_results(const std::string& name, const LLTextureBudgetSimulation::Results& results)
+	{
+		llinfos << name << ": " << results.mFrames << " frames, peak "
+				<< results.mPeakBytes / (1024 * 1024) << " MB, "
+				<< results.mFramesOverBudget << " frames over budget, "
+				<< results.mBytesUploaded / (1024 * 1024) << " MB uploaded, "
+				<< results.mBytesDeleted / (1024 * 1024) << " MB deleted, "
+				<< results.mReversals << " reversals, quality " << results.mQuality << llendl;
+	}
+}
+
+namespace tut
+{
+	struct texturebudget
+	{
+	};
+	typedef test_group<texturebudget> texturebudget_t;
+	typedef texturebudget_t::object texturebudget_object_t;
+	tut::texturebudget_t tut_texturebudget("LLTextureBudget");
+
+	template<> template<>
+	void texturebudget_object_t::test<1>()
+	{
+		set_test_name("no finer than a texel per pixel");
+		LLTextureBudget budget;
+		LLTextureBudget::texture_list_t textures;
+		textures.push_back(make_texture(1, 512, 512.f * 512.f));
+		textures.push_back(make_texture(2, 512, 64.f * 64.f));
+		textures.push_back(make_texture(3, 512, 0.f));
+		S64 bytes = budget.schedule(textures, 64 * 1024 * 1024);
+
+		ensure_equals("fully visible texture at full resolution", textures[0].mTargetDiscard, 0);
+		ensure_equals("small texture at its screen size", textures[1].mTargetDiscard, 3);
+		ensure_equals("unseen texture at its coarsest", textures[2].mTargetDiscard, MAX_DISCARD_LEVEL);
+		ensure_equals("bytes", bytes, LLTextureBudget::getBytes(textures[0], 0)
+									  + LLTextureBudget::getBytes(textures[1], 3)
+									  + LLTextureBudget::getBytes(textures[2], MAX_DISCARD_LEVEL));
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<2>()
+	{
+		set_test_name("tight budgets go to the largest textures on screen");
+		LLTextureBudget budget;
+		LLTextureBudget::texture_list_t textures;
+		for (U32 i = 0; i < 8; i++)
+		{
+			textures.push_back(make_texture(i + 1, 1024, (F32)(i + 1) * 100000.f));
+		}
+		const S64 BUDGET = 8 * 1024 * 1024;
+		S64 bytes = budget.schedule(textures, BUDGET);
+
+		ensure("within budget", bytes <= BUDGET);
+		S64 total = 0;
+		for (U32 i = 0; i < textures.size(); i++)
+		{
+			total += LLTextureBudget::getBytes(textures[i], textures[i].mTargetDiscard);
+			if (i > 0)
+			{
+				ensure("larger area, finer level", textures[i].mTargetDiscard <= textures[i - 1].mTargetDiscard);
+			}
+		}
+		ensure_equals("bytes add up", total, bytes);
+		ensure("budget used", bytes > BUDGET / 2);
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<3>()
+	{
+		set_test_name("resident levels win close calls");
+		LLTextureBudget budget;
+		LLTextureBudget::texture_list_t textures;
+		// Room for one of them at full resolution; the other has 10% more area
+		textures.push_back(make_texture(1, 512, 512.f * 512.f, 0));
+		textures.push_back(make_texture(2, 512, 512.f * 512.f * 1.1f, 1));
+		const S64 BUDGET = LLTextureBudget::getBytes(textures[0], 0) + LLTextureBudget::getBytes(textures[1], 1);
+
+		budget.schedule(textures, BUDGET);
+		ensure_equals("resident texture kept", textures[0].mTargetDiscard, 0);
+		ensure_equals("other texture kept", textures[1].mTargetDiscard, 1);
+
+		budget.setHysteresis(0.f);
+		budget.schedule(textures, BUDGET);
+		ensure_equals("without hysteresis they swap", textures[0].mTargetDiscard, 1);
+		ensure_equals("without hysteresis the larger wins", textures[1].mTargetDiscard, 0);
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<4>()
+	{
+		set_test_name("changes spread over calls");
+		LLTextureBudget budget;
+		LLTextureBudget::texture_list_t textures;
+		textures.push_back(make_texture(1, 256, 256.f * 256.f, 2));
+		textures.push_back(make_texture(2, 256, 256.f * 256.f * 4.f, 2));
+		textures.push_back(make_texture(3, 256, 256.f * 256.f, 0));
+		textures.push_back(make_texture(4, 256, 256.f * 256.f, 0));
+		textures[0].mTargetDiscard = 0;
+		textures[1].mTargetDiscard = 0;
+		textures[2].mTargetDiscard = 2;
+		textures[3].mTargetDiscard = 1;
+
+		// Room for one upload, and for no deletion but the first
+		S64 upload = LLTextureBudget::getBytes(textures[0], 0) - LLTextureBudget::getBytes(textures[0], 2);
+		budget.limitChanges(textures, upload, 0);
+		ensure_equals("upload of the larger area goes ahead", textures[1].mTargetDiscard, 0);
+		ensure_equals("other upload held back", textures[0].mTargetDiscard, 2);
+		ensure("one deletion goes ahead", (textures[2].mTargetDiscard == 2) != (textures[3].mTargetDiscard == 1));
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<5>()
+	{
+		set_test_name("traces round trip");
+		std::stringstream trace;
+		write_flythrough(trace, 3, 5);
+
+		LLTextureBudget::texture_list_t textures;
+		U32 frame = 0;
+		U32 frames = 0;
+		while (LLTextureBudget::readTrace(trace, frame, textures))
+		{
+			ensure_equals("frame number", frame, frames);
+			ensure_equals("textures per frame", textures.size(), (size_t)5);
+			ensure_equals("ids", textures[4].mID, (U32)5);
+			frames++;
+		}
+		ensure_equals("frames", frames, (U32)3);
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<6>()
+	{
+		set_test_name("budget against greedy levels on a flythrough");
+		std::stringstream trace;
+		write_flythrough(trace, 600, 400);
+
+		const S64 BUDGET = 64 * 1024 * 1024;
+		const S64 UPLOAD = 4 * 1024 * 1024;
+		const S64 DELETE = 16 * 1024 * 1024;
+		LLTextureBudgetSimulation budget(LLTextureBudgetSimulation::POLICY_BUDGET, BUDGET, UPLOAD, DELETE);
+		LLTextureBudgetSimulation greedy(LLTextureBudgetSimulation::POLICY_GREEDY, BUDGET, UPLOAD, DELETE);
+		LLTextureBudgetSimulation::Results budget_results;
+		LLTextureBudgetSimulation::Results greedy_results;
+		ensure("budget ran", budget.run(trace, budget_results));
+		trace.clear();
+		trace.seekg(0);
+		ensure("greedy ran", greedy.run(trace, greedy_results));
+		log_results("budget", budget_results);
+		log_results("greedy", greedy_results);
+
+		ensure("budget stays within budget", budget_results.mPeakBytes <= BUDGET);
+		ensure("budget thrashes less", budget_results.mReversals < greedy_results.mReversals);
+		ensure("budget at least as sharp", budget_results.mQuality >= greedy_results.mQuality);
+	}
+
+	template<> template<>
+	void texturebudget_object_t::test<7>()
+	{
+		set_test_name("recorded trace");
+		// Replays a trace saved with TextureBudgetTraceFile, if given one.
+		const char* filename = getenv("LL_TEXTURE_BUDGET_TRACE");
+		if (!filename)
+		{
+			return;
+		}
+		std::ifstream trace(filename);
+		ensure("trace opened", trace.good());
+
+		const char* budget_mb = getenv("LL_TEXTURE_BUDGET_MB");
+		const S64 BUDGET = (S64)(budget_mb ? atoi(budget_mb) : 256) * 1024 * 1024;
+		LLTextureBudgetSimulation::EPolicy policies[] = { LLTextureBudgetSimulation::POLICY_BUDGET,
+														  LLTextureBudgetSimulation::POLICY_GREEDY };
+		for (U32 i = 0; i < 2; i++)
+		{
+			trace.clear();
+			trace.seekg(0);
+			LLTextureBudgetSimulation simulation(policies[i], BUDGET, BUDGET / 16, BUDGET / 4);
+			LLTextureBudgetSimulation::Results results;
+			ensure("trace has frames", simulation.run(trace, results));
+			log_results(i == 0 ? "budget" : "greedy", results);
+		}
+	}
+}
@@ -65,10 +65,11 @@ void LLWorldMapMessage::sendMapBlockRequest(U16 min_x, U16 min_y, U16 max_x, U16
 LLWorldMipmap::LLWorldMipmap() { }
 LLWorldMipmap::~LLWorldMipmap() { }
 void LLWorldMipmap::reset() { }
-void LLWorldMipmap::dropBoostLevels() { }
-void LLWorldMipmap::equalizeBoostLevels() { }
-LLPointer<LLViewerImage> LLWorldMipmap::getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load)
-{ return NULL; }
+void LLWorldMipmap::setView(F64 left, F64 bottom, F64 right, F64 top, S32 level) { }
+void LLWorldMipmap::updateTiles() { }
+void LLWorldMipmap::dropRequests() { }
+LLViewerTexture* LLWorldMipmap::getObjectsTile(U32 grid_x, U32 grid_y, S32 level, bool load, bool& done)
+{ done = true; return NULL; }
 
 // Stub other stuff
 BOOL gPacificDaylightTime;
@@ -362,16 +363,17 @@ namespace tut
 		} catch (...) {
 			fail("LLWorldMap::updateRegions() test failed");
 		}
-		// Test 6 : equalizeBoostLevels()
+		// Test 6 : updateMipmapTiles()
  		try {
- 			mWorld->equalizeBoostLevels();
+ 			mWorld->updateMipmapTiles();
  		} catch (...) {
- 			fail("LLWorldMap::equalizeBoostLevels() test failed");
+ 			fail("LLWorldMap::updateMipmapTiles() test failed");
  		}
 		// Test 7 : getObjectsTile()
 		try {
-			LLPointer<LLViewerImage> image = mWorld->getObjectsTile((U32)(X_WORLD_TEST/REGION_WIDTH_METERS), (U32)(Y_WORLD_TEST/REGION_WIDTH_METERS), 1);
-			ensure("LLWorldMap::getObjectsTile() failed", image.isNull());
+			bool done = false;
+			LLViewerTexture* image = mWorld->getObjectsTile((U32)(X_WORLD_TEST/REGION_WIDTH_METERS), (U32)(Y_WORLD_TEST/REGION_WIDTH_METERS), 1, true, done);
+			ensure("LLWorldMap::getObjectsTile() failed", image == NULL);
 		} catch (...) {
 			fail("LLWorldMap::getObjectsTile() test failed with exception");
 		}
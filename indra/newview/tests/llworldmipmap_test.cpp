@@ -1,4 +1,4 @@
-/** 
+/**
  * @file llworldmipmap_test.cpp
  * @author Merov Linden
  * @date 2009-02-03
@@ -6,21 +6,21 @@
  * $LicenseInfo:firstyear=2006&license=viewerlgpl$
  * Second Life Viewer Source Code
  * Copyright (C) 2010, Linden Research, Inc.
- * 
+ *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
  * License as published by the Free Software Foundation;
  * version 2.1 of the License only.
- * 
+ *
  * This library is distributed in the hope that it will be useful,
  * but WITHOUT ANY WARRANTY; without even the implied warranty of
  * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
  * Lesser General Public License for more details.
- * 
+ *
  * You should have received a copy of the GNU Lesser General Public
  * License along with this library; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
- * 
+ *
  * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
  * $/LicenseInfo$
  */
@@ -30,35 +30,64 @@
 // Class to test
 #include "../llworldmipmap.h"
 // Dependencies
-#include "../llviewerimagelist.h"
+#include "../llappviewer.h"
+#include "../llviewercontrol.h"
+#include "../llviewertexture.h"
+#include "llbuffer.h"
+#include "llhttpclient.h"
+#include "llimage.h"
 // Tut header
 #include "../test/lltut.h"
 
+#include <algorithm>
+
 // -------------------------------------------------------------------------------------------
 // Stubbing: Declarations required to link and run the class being tested
-// Notes: 
+// Notes:
 // * Add here stubbed implementation of the few classes and methods used in the class to be tested
 // * Add as little as possible (let the link errors guide you)
 // * Do not make any assumption as to how those classes or methods work (i.e. don't copy/paste code)
 // * A simulator for a class can be implemented here. Please comment and document thoroughly.
 
-LLViewerImageList::LLViewerImageList() { }
-LLViewerImageList::~LLViewerImageList() { }
+// Requests go through LLTestWorldMipmap::fetchTile() below, nothing is sent
+#include "boost/intrusive_ptr.hpp"
+void boost::intrusive_ptr_add_ref(LLCurl::Responder*) { }
+void boost::intrusive_ptr_release(LLCurl::Responder*) { }
+const F32 HTTP_REQUEST_EXPIRY_SECS = 0.0f;
+LLCurl::Responder::Responder() { }
+LLCurl::Responder::~Responder() { }
+void LLCurl::Responder::error(U32, const std::string&) { }
+void LLCurl::Responder::result(const LLSD&) { }
+void LLCurl::Responder::errorWithContent(U32, const std::string&, const LLSD&) { }
+void LLCurl::Responder::completedRaw(U32, const std::string&, const LLChannelDescriptors&, const LLIOPipe::buffer_ptr_t&) { }
+void LLCurl::Responder::completed(U32, const std::string&, const LLSD&) { }
+void LLCurl::Responder::completedHeader(U32, const std::string&, const LLSD&) { }
+void LLHTTPClient::get(const std::string&, ResponderPtr, const LLSD&, const F32) { }
+S32 LLBufferArray::countAfter(S32, U8*) const { return 0; }
+U8* LLBufferArray::readAfter(S32, U8*, U8*, S32&) const { return NULL; }
 
-LLViewerImageList gImageList;
+LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL;
+LLControlGroup gSavedSettings("Global");
 
-LLViewerImage* LLViewerImageList::getImageFromUrl(const std::string& url,
-												   BOOL usemipmaps,
-												   BOOL level_immediate,
-												   LLGLint internal_format,
-												   LLGLenum primary_format, 
-												   const LLUUID& force_id)
-{ return NULL; }
-void LLViewerImage::setBoostLevel(S32 level) { }
+// Tiles are never drawn, only their memory is counted
+LLPointer<LLViewerTexture> LLViewerTextureManager::getLocalTexture(const LLImageRaw* raw, BOOL usemipmaps)
+{
+	return NULL;
+}
 
 // End Stubbing
 // -------------------------------------------------------------------------------------------
 
+namespace
+{
+	const S32 TILE_BYTES = LLWorldMipmap::MAP_TILE_SIZE * LLWorldMipmap::MAP_TILE_SIZE * 4;
+
+	std::string tile_url(U32 grid_x, U32 grid_y, S32 level)
+	{
+		return llformat("map-%d-%d-%d-objects.jpg", level, grid_x, grid_y);
+	}
+}
+
 // -------------------------------------------------------------------------------------------
 // TUT
 // -------------------------------------------------------------------------------------------
@@ -70,7 +99,40 @@ namespace tut
 		// Derived test class
 		class LLTestWorldMipmap : public LLWorldMipmap
 		{
-			// Put here stubbs of virtual methods we shouldn't call all the way down
+		public:
+			// Keeps the requests for the test to complete instead of sending them
+			virtual void fetchTile(TileRequest* request, const std::string& url)
+			{
+				mURLs.push_back(url);
+				mRequests.push_back(request);
+			}
+
+			// Completes every request still fetching
+			void finishFetches(S32 state)
+			{
+				for (std::vector<LLPointer<TileRequest> >::iterator iter = mRequests.begin(); iter != mRequests.end(); ++iter)
+				{
+					TileRequest* request = *iter;
+					if (request->mState == TileRequest::FETCHING)
+					{
+						if (state == TileRequest::DONE)
+						{
+							request->mRawImage = new LLImageRaw(MAP_TILE_SIZE, MAP_TILE_SIZE, 4);
+						}
+						request->mState = state;
+					}
+				}
+			}
+
+			bool isDone(U32 grid_x, U32 grid_y)
+			{
+				bool done = false;
+				getObjectsTile(grid_x, grid_y, 1, false, done);
+				return done;
+			}
+
+			std::vector<std::string> mURLs;
+			std::vector<LLPointer<TileRequest> > mRequests;
 		};
 		// Instance to be tested
 		LLTestWorldMipmap* mMap;
@@ -78,11 +140,34 @@ namespace tut
 		// Constructor and destructor of the test wrapper
 		worldmipmap_test()
 		{
+			LLImage::initClass();
+			if (!gSavedSettings.controlExists("MapTileMaxRequests"))
+			{
+				gSavedSettings.declareU32("MapTileMaxRequests", 1, "", FALSE);
+				gSavedSettings.declareU32("MapTileMemory", 1, "", FALSE);
+				gSavedSettings.declareString("CurrentMapServerURL", "", "", FALSE);
+			}
+			gSavedSettings.setU32("MapTileMaxRequests", 1);
+			gSavedSettings.setU32("MapTileMemory", 1);
 			mMap = new LLTestWorldMipmap;
 		}
 		~worldmipmap_test()
 		{
 			delete mMap;
+			LLImage::cleanupClass();
+		}
+
+		// Asks for the tiles from (left, bottom) to (right, top) at level 1 as a draw would
+		void requestTiles(U32 left, U32 bottom, U32 right, U32 top)
+		{
+			for (U32 grid_y = bottom; grid_y <= top; grid_y++)
+			{
+				for (U32 grid_x = left; grid_x <= right; grid_x++)
+				{
+					bool done = false;
+					mMap->getObjectsTile(grid_x, grid_y, 1, true, done);
+				}
+			}
 		}
 	};
 
@@ -95,7 +180,7 @@ namespace tut
 	// Test functions
 	// Notes:
 	// * Test as many as you possibly can without requiring a full blown simulation of everything
-	// * The tests are executed in sequence so the test instance state may change between calls
+	// * Each test gets a fresh instance, but the settings are shared
 	// * Remember that you cannot test private methods with tut
 	// ---------------------------------------------------------------------------------------
 	// Test static methods
@@ -120,51 +205,136 @@ namespace tut
 		mMap->globalToMipmap(0.0, 0.0, LLWorldMipmap::MAP_LEVELS, &grid_x, &grid_y);
 		ensure("globalToMipmap() test 2 failed", (grid_x == 0) && (grid_y == 0));
 	}
-	// Test 3 : getObjectsTile()
+	// Test 3 : the tiles in view are fetched first, closest to the center first
 	template<> template<>
 	void worldmipmap_object_t::test<3>()
 	{
-		// Depends on some inline methods in LLViewerImage... Thinking about how to make this work
-		// LLPointer<LLViewerImage> img = mMap->getObjectsTile(0, 0, 1);
-		// ensure("getObjectsTile() test failed", img.isNull());
+		gSavedSettings.setU32("MapTileMaxRequests", 9);
+
+		// 3 by 3 tiles centered on tile 1, 1
+		mMap->setView(0.0, 0.0, 3.0 * REGION_WIDTH_METERS, 3.0 * REGION_WIDTH_METERS, 1);
+		requestTiles(0, 0, 2, 2);
+		mMap->updateTiles();
+
+		ensure_equals("requests capped", mMap->mURLs.size(), (size_t) 9);
+		ensure_equals("center first", mMap->mURLs[0], tile_url(1, 1, 1));
+		for (U32 grid_y = 0; grid_y <= 2; grid_y++)
+		{
+			for (U32 grid_x = 0; grid_x <= 2; grid_x++)
+			{
+				// ahead of the prefetched tiles around the view and on the next level
+				ensure("tile in view fetched", std::find(mMap->mURLs.begin(), mMap->mURLs.end(),
+														 tile_url(grid_x, grid_y, 1)) != mMap->mURLs.end());
+			}
+		}
+
+		// nothing more while they're fetching
+		requestTiles(0, 0, 2, 2);
+		mMap->updateTiles();
+		ensure_equals("no room", mMap->mURLs.size(), (size_t) 9);
 	}
-	// Test 4 : equalizeBoostLevels()
+	// Test 4 : queued tiles that leave the view are dropped
 	template<> template<>
 	void worldmipmap_object_t::test<4>()
 	{
-		try
-		{
-			mMap->equalizeBoostLevels();
-		} 
-		catch (...)
-		{
-			fail("equalizeBoostLevels() test failed");
-		}
+		requestTiles(0, 0, 1, 0);
+		mMap->updateTiles();
+		ensure_equals("one request", mMap->mURLs.size(), (size_t) 1);
+		ensure_equals("closest first", mMap->mURLs[0], tile_url(0, 0, 1));
+
+		// 1, 0 is still queued when the map moves away
+		mMap->finishFetches(LLWorldMipmap::TileRequest::DONE);
+		requestTiles(5, 5, 5, 5);
+		mMap->updateTiles();
+		ensure_equals("next request", mMap->mURLs.size(), (size_t) 2);
+		ensure_equals("tile in view", mMap->mURLs[1], tile_url(5, 5, 1));
+
+		mMap->finishFetches(LLWorldMipmap::TileRequest::DONE);
+		mMap->updateTiles();
+		ensure_equals("tile out of view dropped", mMap->mURLs.size(), (size_t) 2);
+
+		// and so are they when the map is hidden
+		requestTiles(6, 6, 6, 6);
+		mMap->dropRequests();
+		requestTiles(7, 7, 7, 7);
+		mMap->updateTiles();
+		ensure_equals("after hiding", mMap->mURLs.size(), (size_t) 3);
+		ensure_equals("tile shown again", mMap->mURLs[2], tile_url(7, 7, 1));
 	}
-	// Test 5 : dropBoostLevels()
+	// Test 5 : the least recently drawn tiles go once over the memory budget
 	template<> template<>
 	void worldmipmap_object_t::test<5>()
 	{
-		try
+		gSavedSettings.setU32("MapTileMaxRequests", 8);
+		const S32 budget_tiles = 1024 * 1024 / TILE_BYTES;
+
+		// load as many tiles as fit, at most 4 are uploaded per update
+		requestTiles(0, 0, budget_tiles - 1, 0);
+		mMap->updateTiles();
+		mMap->finishFetches(LLWorldMipmap::TileRequest::DONE);
+		for (S32 i = 0; i < (budget_tiles + 3) / 4; i++)
 		{
-			mMap->dropBoostLevels();
-		} 
-		catch (...)
+			requestTiles(0, 0, budget_tiles - 1, 0);
+			mMap->updateTiles();
+		}
+		for (S32 i = 0; i < budget_tiles; i++)
 		{
-			fail("dropBoostLevels() test failed");
+			ensure("loaded", mMap->isDone(i, 0));
+		}
+
+		// tile 0 drops out of the view while a new one comes in
+		requestTiles(1, 0, budget_tiles, 0);
+		mMap->updateTiles();
+		mMap->finishFetches(LLWorldMipmap::TileRequest::DONE);
+		requestTiles(1, 0, budget_tiles, 0);
+		mMap->updateTiles();
+
+		ensure("new tile loaded", mMap->isDone(budget_tiles, 0));
+		ensure("least recently drawn evicted", !mMap->isDone(0, 0));
+		for (S32 i = 1; i < budget_tiles; i++)
+		{
+			ensure("tile in view kept", mMap->isDone(i, 0));
 		}
 	}
-	// Test 6 : reset()
+	// Test 6 : timeouts and server errors are retried, missing tiles aren't
 	template<> template<>
 	void worldmipmap_object_t::test<6>()
 	{
-		try
-		{
-			mMap->reset();
-		} 
-		catch (...)
+		requestTiles(0, 0, 0, 0);
+		mMap->updateTiles();
+		mMap->finishFetches(LLWorldMipmap::TileRequest::FAILED);
+		requestTiles(0, 0, 0, 0);
+		mMap->updateTiles();
+		ensure_equals("failed tile fetched again", mMap->mURLs.size(), (size_t) 2);
+		ensure_equals("same tile", mMap->mURLs[1], tile_url(0, 0, 1));
+		ensure("not missing", !mMap->isDone(0, 0));
+
+		mMap->finishFetches(LLWorldMipmap::TileRequest::MISSING);
+		requestTiles(0, 0, 0, 0);
+		mMap->updateTiles();
+		ensure("missing", mMap->isDone(0, 0));
+		requestTiles(0, 0, 0, 0);
+		mMap->updateTiles();
+		ensure_equals("missing tile not fetched again", mMap->mURLs.size(), (size_t) 2);
+
+		// a tile that keeps failing is taken as missing too
+		for (S32 i = 0; i < 10; i++)
 		{
-			fail("reset() test failed");
+			requestTiles(1, 0, 1, 0);
+			mMap->updateTiles();
+			mMap->finishFetches(LLWorldMipmap::TileRequest::FAILED);
 		}
+		ensure("given up", mMap->isDone(1, 0));
+		ensure("fetched a few times", mMap->mURLs.size() > 3 && mMap->mURLs.size() < 10);
+	}
+	// Test 7 : reset()
+	template<> template<>
+	void worldmipmap_object_t::test<7>()
+	{
+		requestTiles(0, 0, 0, 0);
+		mMap->updateTiles();
+		mMap->reset();
+		ensure_equals("fetch cancelled", (S32) mMap->mRequests[0]->mState, (S32) LLWorldMipmap::TileRequest::CANCELLED);
+		ensure("tiles gone", !mMap->isDone(0, 0));
 	}
 }
@@ -0,0 +1,317 @@
+/**
+ * @file lscript_threadedcode_tut.cpp
+ * @brief Tests threaded code against the LSL2 interpreter
+ *
+ * $LicenseInfo:firstyear=2010&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "lltut.h"
+
+#include "lltimer.h"
+#include "lscript_execute.h"
+
+namespace
+{
+	const S32 GLOBALS_START = 0x80;
+	const S32 CODE_START = 0x100;
+	const U8 INT_INT = (LST_INTEGER << 4) | LST_INTEGER;
+	const U8 FLOAT_FLOAT = (LST_FLOATINGPOINT << 4) | LST_FLOATINGPOINT;
+	const U8 INT_TO_FLOAT = (LST_INTEGER << 4) | LST_FLOATINGPOINT;
+
+	// Hand assembled LSL2 image: globals, one block of code and a stack
+	// frame that RETURNs to IP 0, which finishes the script.
+	class LSOImage
+	{
+	public:
+		LSOImage() : mCode(CODE_START)
+		{
+			memset(mBuffer, 0, TOP_OF_MEMORY);
+		}
+
+		void op(LSCRIPTOpCodesEnum opcode)
+		{
+			mBuffer[mCode++] = LSCRIPTOpCodes[opcode];
+		}
+		void op(LSCRIPTOpCodesEnum opcode, S32 arg)
+		{
+			op(opcode);
+			integer2bytestream(mBuffer, mCode, arg);
+		}
+		void opFloat(LSCRIPTOpCodesEnum opcode, F32 arg)
+		{
+			op(opcode);
+			float2bytestream(mBuffer, mCode, arg);
+		}
+		void opTypes(LSCRIPTOpCodesEnum opcode, U8 types)
+		{
+			op(opcode);
+			mBuffer[mCode++] = types;
+		}
+
+		S32 here() const { return mCode; }
+
+		// Branch to an earlier offset.
+		void branch(LSCRIPTOpCodesEnum opcode, U8 type, S32 target)
+		{
+			S32 operand = forward(opcode, type);
+			integer2bytestream(mBuffer, operand, target - (operand + 4));
+		}
+		// Branch to a label() placed later, returns what to pass to it.
+		S32 forward(LSCRIPTOpCodesEnum opcode, U8 type)
+		{
+			op(opcode);
+			if (opcode != LOPC_JUMP)
+			{
+				mBuffer[mCode++] = type;
+			}
+			S32 operand = mCode;
+			mCode += 4;
+			return operand;
+		}
+		void label(S32 operand)
+		{
+			S32 offset = operand;
+			integer2bytestream(mBuffer, offset, mCode - (operand + 4));
+		}
+
+		LLScriptExecuteLSL2* load(BOOL threaded)
+		{
+			S32 frame = TOP_OF_MEMORY - 16;
+			S32 offset = frame;
+			integer2bytestream(mBuffer, offset, frame + 4);	// caller's BP
+			integer2bytestream(mBuffer, offset, 0);			// return IP
+
+			set_register(mBuffer, LREG_TM, TOP_OF_MEMORY);
+			set_register(mBuffer, LREG_IP, CODE_START);
+			set_register(mBuffer, LREG_VN, LSL2_VERSION_NUMBER);
+			set_register(mBuffer, LREG_BP, frame);
+			set_register(mBuffer, LREG_SP, frame);
+			set_register(mBuffer, LREG_GVR, GLOBALS_START);
+			set_register(mBuffer, LREG_GFR, CODE_START);
+			set_register(mBuffer, LREG_SR, CODE_START);
+			set_register(mBuffer, LREG_HR, mCode);
+			set_register(mBuffer, LREG_HP, mCode);
+
+			LLScriptExecuteLSL2* execute = new LLScriptExecuteLSL2(mBuffer, TOP_OF_MEMORY);
+			execute->setThreadedCode(threaded);
+			return execute;
+		}
+
+		U8 mBuffer[TOP_OF_MEMORY];
+		S32 mCode;
+	};
+
+	// i counts up to iterations, sum ^= i * 7 and global 0 += i.
+	void assemble_integer_loop(LSOImage& image, S32 iterations)
+	{
+		image.op(LOPC_PUSHARGE, 8);				// i at 0, sum at 4
+		S32 loop = image.here();
+		image.op(LOPC_PUSHARGI, iterations);
+		image.op(LOPC_PUSH, 0);
+		image.opTypes(LOPC_LESS, INT_INT);
+		S32 done = image.forward(LOPC_JUMPNIF, LST_INTEGER);
+		image.op(LOPC_PUSH, 4);
+		image.op(LOPC_PUSH, 0);
+		image.op(LOPC_PUSHARGI, 7);
+		image.opTypes(LOPC_MUL, INT_INT);
+		image.op(LOPC_BITXOR);
+		image.op(LOPC_LOADP, 4);
+		image.op(LOPC_PUSHG, 0);
+		image.op(LOPC_PUSH, 0);
+		image.opTypes(LOPC_ADD, INT_INT);
+		image.op(LOPC_LOADGP, 0);
+		image.op(LOPC_PUSHARGI, 1);
+		image.op(LOPC_PUSH, 0);
+		image.opTypes(LOPC_ADD, INT_INT);
+		image.op(LOPC_LOADP, 0);
+		image.branch(LOPC_JUMP, 0, loop);
+		image.label(done);
+		image.op(LOPC_RETURN);
+	}
+
+	void run_to_end(LLScriptExecuteLSL2* execute)
+	{
+		while (!execute->isFinished() && !execute->getFaults())
+		{
+			execute->resumeEventHandler(FALSE, LLUUID::null, 0.f);
+		}
+	}
+}
+
+namespace tut
+{
+	struct lscript_threadedcode_data
+	{
+		// Runs the image interpreted and threaded, the two have to end
+		// up with the same memory.
+		void ensure_same_run(LSOImage& image)
+		{
+			LLScriptExecuteLSL2* interpreted = image.load(FALSE);
+			LLScriptExecuteLSL2* threaded = image.load(TRUE);
+			run_to_end(interpreted);
+			run_to_end(threaded);
+
+			ensure_equals("instruction count", threaded->mInstructionCount, interpreted->mInstructionCount);
+			ensure_equals("faults", threaded->getFaults(), interpreted->getFaults());
+			ensure_equals("ip", get_register(threaded->mBuffer, LREG_IP), get_register(interpreted->mBuffer, LREG_IP));
+			ensure_equals("energy", threaded->getEnergy(), interpreted->getEnergy());
+			ensure("memory", memcmp(threaded->mBuffer, interpreted->mBuffer, TOP_OF_MEMORY) == 0);
+
+			delete interpreted;
+			delete threaded;
+		}
+
+		S32 getGlobal(LLScriptExecuteLSL2* execute, S32 address)
+		{
+			S32 offset = GLOBALS_START + address;
+			return bytestream2integer(execute->mBuffer, offset);
+		}
+	};
+	typedef test_group<lscript_threadedcode_data> lscript_threadedcode_test;
+	typedef lscript_threadedcode_test::object lscript_threadedcode_object;
+	tut::lscript_threadedcode_test lscript_threadedcode_testcase("lscript_threadedcode");
+
+	template<> template<>
+	void lscript_threadedcode_object::test<1>()
+	{
+		// integer loop
+		LSOImage image;
+		assemble_integer_loop(image, 100);
+
+		LLScriptExecuteLSL2* execute = image.load(TRUE);
+		run_to_end(execute);
+		ensure_equals("no faults", execute->getFaults(), 0);
+		ensure_equals("global", getGlobal(execute, 0), 4950);
+		delete execute;
+
+		ensure_same_run(image);
+	}
+
+	template<> template<>
+	void lscript_threadedcode_object::test<2>()
+	{
+		// floats, with instructions only the interpreter runs in the loop
+		LSOImage image;
+		image.op(LOPC_PUSHARGE, 8);				// f at 0, n at 4
+		image.op(LOPC_PUSHARGI, 10);
+		image.op(LOPC_LOADP, 4);
+		S32 loop = image.here();
+		image.op(LOPC_PUSHARGI, 1);
+		image.op(LOPC_PUSH, 4);
+		image.opTypes(LOPC_SUB, INT_INT);
+		image.op(LOPC_STORE, 4);				// --n, left on the stack
+		image.op(LOPC_DUP);
+		image.opTypes(LOPC_CAST, INT_TO_FLOAT);
+		image.op(LOPC_PUSH, 0);
+		image.opTypes(LOPC_ADD, FLOAT_FLOAT);
+		image.opFloat(LOPC_PUSHARGF, 0.5f);
+		image.opTypes(LOPC_MUL, FLOAT_FLOAT);
+		image.op(LOPC_LOADP, 0);				// f = (f + n) * 0.5
+		image.branch(LOPC_JUMPIF, LST_INTEGER, loop);
+		image.op(LOPC_PUSH, 0);
+		S32 done = image.forward(LOPC_JUMPNIF, LST_FLOATINGPOINT);
+		image.op(LOPC_PUSHARGI, 99);
+		image.op(LOPC_LOADGP, 0);
+		image.label(done);
+		image.op(LOPC_RETURN);
+
+		LLScriptExecuteLSL2* execute = image.load(TRUE);
+		run_to_end(execute);
+		ensure_equals("no faults", execute->getFaults(), 0);
+		ensure_equals("global", getGlobal(execute, 0), 99);
+		delete execute;
+
+		ensure_same_run(image);
+	}
+
+	template<> template<>
+	void lscript_threadedcode_object::test<3>()
+	{
+		// faults stop both at the same instruction
+		LSOImage image;
+		image.op(LOPC_PUSHARGE, 8);				// i at 0, sum at 4
+		S32 loop = image.here();
+		image.op(LOPC_PUSH, 0);
+		image.op(LOPC_PUSHARGI, 3);
+		image.opTypes(LOPC_SUB, INT_INT);
+		image.op(LOPC_PUSHARGI, 100);
+		image.opTypes(LOPC_DIV, INT_INT);		// 100 / (3 - i)
+		image.op(LOPC_PUSH, 4);
+		image.opTypes(LOPC_ADD, INT_INT);
+		image.op(LOPC_LOADP, 4);
+		image.op(LOPC_PUSHARGI, 1);
+		image.op(LOPC_PUSH, 0);
+		image.opTypes(LOPC_ADD, INT_INT);
+		image.op(LOPC_LOADP, 0);
+		image.branch(LOPC_JUMP, 0, loop);
+
+		LLScriptExecuteLSL2* execute = image.load(TRUE);
+		run_to_end(execute);
+		ensure_equals("math fault", execute->getFaults(), (S32)LSRF_MATH);
+		delete execute;
+
+		ensure_same_run(image);
+	}
+
+	template<> template<>
+	void lscript_threadedcode_object::test<4>()
+	{
+		// bytecode replaced by reset()
+		LSOImage image;
+		assemble_integer_loop(image, 10);
+		LLScriptExecuteLSL2* execute = image.load(TRUE);
+		run_to_end(execute);
+		execute->reset();
+		run_to_end(execute);
+		ensure_equals("no faults", execute->getFaults(), 0);
+		ensure_equals("global", getGlobal(execute, 0), 45);
+		delete execute;
+	}
+
+	// Opcode throughput, interpreted against threaded.
+	template<> template<>
+	void lscript_threadedcode_object::test<5>()
+	{
+		LSOImage image;
+		assemble_integer_loop(image, 200000);
+
+		LLTimer timer;
+		LLScriptExecuteLSL2* interpreted = image.load(FALSE);
+		run_to_end(interpreted);
+		F64 interpreted_time = timer.getElapsedTimeF64();
+
+		timer.reset();
+		LLScriptExecuteLSL2* threaded = image.load(TRUE);
+		run_to_end(threaded);
+		F64 threaded_time = timer.getElapsedTimeF64();
+
+		ensure_equals("instruction count", threaded->mInstructionCount, interpreted->mInstructionCount);
+		F64 instructions = (F64)interpreted->mInstructionCount;
+		llinfos << "Interpreted " << instructions / interpreted_time / 1000000.0 << "M instructions/sec, "
+				<< "threaded " << instructions / threaded_time / 1000000.0 << "M instructions/sec" << llendl;
+
+		delete interpreted;
+		delete threaded;
+	}
+}